@@ -0,0 +1,165 @@
+// FrameCapture.h and CaptureSinks.h at a double wide 1080p and a 4K frame.
+// The sinks on their own, what each costs the writer thread per frame, and the
+// whole readback, OnFrame every iteration with the writer taking what it can
+// into the shared memory ring.
+//
+// The device here has its staging already filled, its Copy and TryMap are
+// free, which a GPU copy and Map aren't.  So BM_CaptureReadback's time is the
+// render thread's own cost per frame, and its bytes per second how fast the
+// writer drains the slots into the ring, the ceiling a recorder could read at.
+// The file sinks write to /dev/null, their disk is not theirs to measure.
+
+#include "FrameCapture.h"
+#include "CaptureSinks.h"
+
+#include <benchmark/benchmark.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+
+static const uint32_t kPadding = 256;				// Staging rows are wider.
+
+class FilledCaptureDevice : public CaptureDevice
+{
+public:
+	bool CreateStaging(int count, uint32_t width, uint32_t height, uint32_t) override
+	{
+		pitch = width * 4 + kPadding;
+		staging.assign(count, std::vector<uint8_t>((size_t)pitch * height));
+		for (std::vector<uint8_t>& slot : staging)
+		{
+			for (size_t i = 0; i < slot.size(); i++)
+				slot[i] = (uint8_t)(i * 7);
+		}
+		return true;
+	}
+
+	void ReleaseStaging() override { staging.clear(); }
+	bool Copy(int) override { return true; }
+
+	CaptureMap TryMap(int slot, const uint8_t** pixels, uint32_t* rowPitch) override
+	{
+		*pixels = staging[slot].data();
+		*rowPitch = pitch;
+		return kCaptureMapReady;
+	}
+
+	void Unmap(int) override { }
+
+	uint32_t pitch = 0;
+	std::vector<std::vector<uint8_t>> staging;
+};
+
+// A pitched frame for the sinks on their own.
+struct PitchedFrame
+{
+	PitchedFrame(uint32_t width, uint32_t height)
+		: pixels((size_t)(width * 4 + kPadding) * height)
+	{
+		for (size_t i = 0; i < pixels.size(); i++)
+			pixels[i] = (uint8_t)(i * 7);
+		frame = CaptureFrame{ pixels.data(), width * 4 + kPadding, width, height, kCaptureB8G8R8A8Unorm,
+			kLayoutSideBySide, 0, 0 };
+	}
+
+	std::vector<uint8_t> pixels;
+	CaptureFrame frame;
+};
+
+// Zeroed, and aligned like CaptureRingHeader.
+struct RingMemory
+{
+	RingMemory(size_t size) : bytes(size + 64, 0) { }
+
+	void* Get()
+	{
+		return bytes.data() + (64 - (uintptr_t)bytes.data() % 64) % 64;
+	}
+
+	std::vector<uint8_t> bytes;
+};
+
+static FILE* OpenNull(const char*)
+{
+	return fopen("/dev/null", "wb");
+}
+
+static int64_t FrameBytes(const benchmark::State& state)
+{
+	return state.range(0) * state.range(1) * 4;
+}
+
+
+static void BM_RawSinkWrite(benchmark::State& state)
+{
+	PitchedFrame source((uint32_t)state.range(0), (uint32_t)state.range(1));
+	RawCaptureSink sink("frames.raw", OpenNull);
+
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(sink.Write(source.frame));
+		source.frame.index++;
+	}
+	sink.Close();
+	state.SetBytesProcessed(state.iterations() * FrameBytes(state));
+}
+BENCHMARK(BM_RawSinkWrite)->Args({ 3840, 1080 })->Args({ 3840, 2160 })->Unit(benchmark::kMillisecond);
+
+static void BM_PngSinkWrite(benchmark::State& state)
+{
+	PitchedFrame source((uint32_t)state.range(0), (uint32_t)state.range(1));
+	PngCaptureSink sink("shot", OpenNull);
+
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(sink.Write(source.frame));
+		source.frame.index++;
+	}
+	state.SetBytesProcessed(state.iterations() * FrameBytes(state));
+}
+BENCHMARK(BM_PngSinkWrite)->Args({ 3840, 1080 })->Args({ 3840, 2160 })->Unit(benchmark::kMillisecond);
+
+static void BM_MemoryRingWrite(benchmark::State& state)
+{
+	PitchedFrame source((uint32_t)state.range(0), (uint32_t)state.range(1));
+	RingMemory memory(CaptureRingSize(3, (uint64_t)FrameBytes(state)));
+	MemoryRingCaptureSink sink(memory.Get(), 3, (uint64_t)FrameBytes(state));
+
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(sink.Write(source.frame));
+		source.frame.index++;
+	}
+	state.SetBytesProcessed(state.iterations() * FrameBytes(state));
+}
+BENCHMARK(BM_MemoryRingWrite)->Args({ 3840, 1080 })->Args({ 3840, 2160 })->Unit(benchmark::kMillisecond);
+
+// The counters are per second of the run, frames the ring took and frames
+// dropped because the writer had all the slots.
+
+static void BM_CaptureReadback(benchmark::State& state)
+{
+	uint32_t width = (uint32_t)state.range(0), height = (uint32_t)state.range(1);
+	RingMemory memory(CaptureRingSize(3, (uint64_t)FrameBytes(state)));
+	FilledCaptureDevice device;
+	FrameCapture capture;
+	capture.Request(new MemoryRingCaptureSink(memory.Get(), 3, (uint64_t)FrameBytes(state)), 1);
+
+	CaptureSource source = { width, height, kCaptureB8G8R8A8Unorm, kLayoutSideBySide, 0 };
+	capture.OnFrame(&device, source);
+	for (auto _ : state)
+	{
+		source.timestamp++;
+		capture.OnFrame(&device, source);
+	}
+
+	CaptureStats stats = capture.Stats();
+	capture.Shutdown(&device);
+	state.SetBytesProcessed((int64_t)stats.bytes);
+	state.counters["written"] = benchmark::Counter((double)stats.written, benchmark::Counter::kIsRate);
+	state.counters["dropped"] = benchmark::Counter((double)stats.dropped, benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_CaptureReadback)->Args({ 3840, 1080 })->Args({ 3840, 2160 })->UseRealTime();
@@ -0,0 +1,195 @@
+// Per call cost of the things the game side does in every Present, and the VR
+// side does in every frame.  These should all be nanoseconds, anything that
+// grows to microseconds is a regression that the game's frame time will show.
+
+#include "AsyncLog.h"
+#include "FramePacer.h"
+#include "KatangaIPC.h"
+#include "KatangaStats.h"
+#include "KatangaTrace.h"
+#include "StereoDetect.h"
+
+#include <benchmark/benchmark.h>
+
+#include <memory>
+#include <vector>
+
+
+static void PublishRing(KatangaSharedDescriptor* desc)
+{
+	const uint32_t slots[kKatangaMaxSlots] = { 1, 2, 3 };
+	KatangaPublishSurface(desc, slots, kKatangaMaxSlots, 3840, 1080, 28, kLayoutSideBySide, 0);
+}
+
+
+// Game side, after each copy, Hooked_Present.
+
+static void BM_PublishFrameAndSwap(benchmark::State& state)
+{
+	KatangaSharedDescriptor desc = {};
+	PublishRing(&desc);
+	uint32_t writeSlot = 0;
+	int64_t now = 0;
+
+	for (auto _ : state)
+	{
+		KatangaPublishFrame(&desc, ++now);
+		writeSlot = KatangaSwapWriteSlot(&desc, writeSlot);
+		benchmark::DoNotOptimize(writeSlot);
+	}
+}
+BENCHMARK(BM_PublishFrameAndSwap);
+
+// VR side, each frame, TakeLatestFrame.
+
+static void BM_AcquireLatestSlot(benchmark::State& state)
+{
+	KatangaSharedDescriptor desc = {};
+	PublishRing(&desc);
+	uint32_t writeSlot = 0;
+	uint32_t readSlot = kKatangaMaxSlots - 1;
+	int64_t now = 0;
+
+	for (auto _ : state)
+	{
+		// Every other frame has something fresh, like a 45Hz game at 90Hz.
+		if ((now & 1) == 0)
+			writeSlot = KatangaSwapWriteSlot(&desc, writeSlot);
+		readSlot = KatangaAcquireLatestSlot(&desc, readSlot);
+		KatangaConsumerSampled(&desc, ++now);
+		benchmark::DoNotOptimize(readSlot);
+	}
+}
+BENCHMARK(BM_AcquireLatestSlot);
+
+// VR side, each frame, the lock free handshake instead of the setup mutex.
+
+static void BM_TryBeginEndFrame(benchmark::State& state)
+{
+	KatangaSharedDescriptor desc = {};
+
+	for (auto _ : state)
+	{
+		bool begun = KatangaTryBeginFrame(&desc);
+		benchmark::DoNotOptimize(begun);
+		KatangaEndFrame(&desc, begun ? 1 : 0);
+	}
+}
+BENCHMARK(BM_TryBeginEndFrame);
+
+// Game side, each Present, whether to copy at all.
+
+static void BM_FramePacerShouldCopy(benchmark::State& state)
+{
+	FramePacer pacer;
+	pacer.Init(10000000, 0);
+	int64_t now = 1000;
+	uint64_t sequence = 0;
+
+	for (auto _ : state)
+	{
+		// A 144Hz game against a 90Hz VR side, in 100ns ticks.
+		now += 69444;
+		int64_t sample = now - now % 111111;
+		bool copy = pacer.ShouldCopy(now, sequence, sequence, sample);
+		if (copy)
+		{
+			sequence++;
+			pacer.OnCopied(now);
+		}
+		benchmark::DoNotOptimize(copy);
+	}
+}
+BENCHMARK(BM_FramePacerShouldCopy);
+
+// Game side, each Present, with the stats page mapped.
+
+static void BM_RecordPresent(benchmark::State& state)
+{
+	// Over aligned, which C++14 new does not handle.
+	static KatangaStatsPage page;
+	int64_t now = 0;
+
+	for (auto _ : state)
+	{
+		KatangaRecordPresent(&page, now, now + 1500, now + 1700, now + 9000);
+		now += 166667;
+	}
+}
+BENCHMARK(BM_RecordPresent);
+
+// Any thread, a log line.  Timed in batches of half the ring, with the writer
+// draining it to /dev/null between batches, untimed, so this is the cost of
+// queueing a line and not of dropping one into a full ring.
+
+static void BM_AsyncLogWrite(benchmark::State& state)
+{
+	FILE* file = fopen("/dev/null", "w");
+	if (file == nullptr)
+	{
+		state.SkipWithError("no /dev/null");
+		return;
+	}
+	AsyncLog log;
+	log.Start(file);
+
+	const int kBatch = (int)AsyncLog::kSlotCount / 2;
+	wchar_t name[] = L"CreateSharedRenderTarget";
+	int frame = 0;
+	for (auto _ : state)
+	{
+		for (int i = 0; i < kBatch; i++)
+			log.WriteLiteral(L"GamePlugin: %s frame: %d, hr: 0x%x, surface: %p\n", name, frame++, 0x887A0005, &frame);
+
+		state.PauseTiming();
+		log.Flush();
+		state.ResumeTiming();
+	}
+
+	log.Stop();
+	fclose(file);
+	state.SetItemsProcessed(state.iterations() * kBatch);
+	state.counters["dropped"] = (double)log.Dropped();
+}
+BENCHMARK(BM_AsyncLogWrite);
+
+// Any thread, a per frame trace span, like the DX9 StereoCopy.
+
+static void BM_TraceSpan(benchmark::State& state)
+{
+	std::unique_ptr<KatangaTracer> tracer(new KatangaTracer());
+
+	for (auto _ : state)
+	{
+		KATANGA_TRACE_SCOPE(tracer.get(), "StereoCopy");
+	}
+}
+BENCHMARK(BM_TraceSpan);
+
+// VR side, every so often, the layout detection on a captured 1080p frame.
+
+static void BM_StereoDetectPixels(benchmark::State& state)
+{
+	// Noise in the left eye, and the same a few pixels over in the right.
+	const uint32_t width = 3840, height = 1080, eye = width / 2;
+	std::vector<uint32_t> pixels(width * height);
+	uint32_t seed = 1;
+	for (uint32_t y = 0; y < height; y++)
+	{
+		uint32_t* row = &pixels[y * width];
+		for (uint32_t x = 0; x < eye; x++)
+		{
+			seed = seed * 1664525u + 1013904223u;
+			row[x] = seed;
+		}
+		for (uint32_t x = 0; x < eye; x++)
+			row[eye + x] = row[(x + 4) % eye];
+	}
+
+	for (auto _ : state)
+	{
+		StereoDetection detection = StereoDetectPixels(pixels.data(), width, height, width * 4, kStereoBGRA8);
+		benchmark::DoNotOptimize(detection);
+	}
+}
+BENCHMARK(BM_StereoDetectPixels)->Unit(benchmark::kMicrosecond);
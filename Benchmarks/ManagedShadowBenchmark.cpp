@@ -0,0 +1,93 @@
+// ManagedShadow.h on the paths the DX9 hooks take.  A LockRect and UnlockRect
+// of a shadowed texture, with however many others in the store, the Lock of a
+// texture that isn't shadowed while some are, a region taking scattered rects
+// like a font atlas.  The uploader does nothing, so these are only the store's own costs, not UpdateSurface.
+
+#include "ManagedShadow.h"
+
+#include <benchmark/benchmark.h>
+
+#include <vector>
+
+
+class NullUploader : public ShadowUploader
+{
+public:
+	bool Upload(void*, void*, uint32_t, const ShadowRect&) override
+	{
+		return true;
+	}
+};
+
+// A store of count 512x512 textures with full mip chains.  Only the
+// addresses matter, so the textures and shadows are slots of one array.
+
+static void FillStore(ManagedShadowStore* store, std::vector<char>* objects, int count)
+{
+	uint32_t widths[10], heights[10];
+	for (uint32_t i = 0; i < 10; i++)
+		widths[i] = heights[i] = 512 >> i;
+
+	objects->assign((size_t)count * 2, 0);
+	for (int i = 0; i < count; i++)
+		store->Add(&(*objects)[i * 2], &(*objects)[i * 2 + 1], 10, widths, heights);
+}
+
+static void BM_ShadowLockUnlock(benchmark::State& state)
+{
+	ManagedShadowStore store;
+	std::vector<char> objects;
+	FillStore(&store, &objects, (int)state.range(0));
+	NullUploader uploader;
+
+	void* texture = &objects[0];
+	ShadowRect rect = { 64, 64, 128, 96 };
+	for (auto _ : state)
+	{
+		void* shadow;
+		benchmark::DoNotOptimize(store.Find(texture, &shadow));
+		store.Locked(texture, 0, &rect, false);
+		store.Find(texture, &shadow);
+		store.Unlocked(texture, 0, &uploader);
+	}
+}
+BENCHMARK(BM_ShadowLockUnlock)->Arg(1)->Arg(100)->Arg(5000)->ArgName("textures");
+
+// Every texture Lock in the game goes through this, most of them not shadowed.
+
+static void BM_ShadowLockMiss(benchmark::State& state)
+{
+	ManagedShadowStore store;
+	std::vector<char> objects;
+	FillStore(&store, &objects, (int)state.range(0));
+
+	char other;
+	for (auto _ : state)
+	{
+		void* shadow;
+		bool found = !store.Empty() && store.Find(&other, &shadow);
+		benchmark::DoNotOptimize(found);
+	}
+}
+BENCHMARK(BM_ShadowLockMiss)->Arg(0)->Arg(100)->Arg(5000)->ArgName("textures");
+
+static void BM_DirtyRegionScatter(benchmark::State& state)
+{
+	int rects = (int)state.range(0);
+	std::vector<ShadowRect> glyphs;
+	for (int i = 0; i < rects; i++)
+	{
+		uint32_t x = (uint32_t)(i * 37 % 480), y = (uint32_t)(i * 53 % 480);
+		glyphs.push_back(ShadowRect{ x, y, x + 12, y + 16 });
+	}
+
+	for (auto _ : state)
+	{
+		DirtyRegion dirty;
+		for (const ShadowRect& glyph : glyphs)
+			dirty.Add(glyph);
+		benchmark::DoNotOptimize(dirty.Area());
+	}
+	state.SetItemsProcessed((int64_t)(state.iterations() * rects));
+}
+BENCHMARK(BM_DirtyRegionScatter)->Arg(8)->Arg(64)->Arg(512)->ArgName("rects");
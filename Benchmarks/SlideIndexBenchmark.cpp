@@ -0,0 +1,69 @@
+// What a launch costs with a big Stereo Pictures folder, from SlideIndex.h:
+// opening the last index, looking every listed file up in it as the rescan
+// does, and building the file again to save it.
+
+#include "SlideIndex.h"
+
+#include <benchmark/benchmark.h>
+
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+
+// Names like the ones 3D Vision gives screenshots, already sorted.
+static std::vector<std::string> PictureNames(int count)
+{
+	std::vector<std::string> names;
+	for (int i = 0; i < count; i++)
+	{
+		char name[64];
+		snprintf(name, sizeof(name), "Witcher3_%06d_%02d.jps", i / 100, i % 100);
+		names.push_back(name);
+	}
+	return names;
+}
+
+static void SlideIndexOpen(benchmark::State& state)
+{
+	std::vector<std::string> names = PictureNames((int)state.range(0));
+	std::vector<uint8_t> bytes = BuildSlideIndex(std::vector<SlideIndexEntry>(names.size()), names);
+	SlideIndexView view;
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(view.Open(bytes.data(), bytes.size()));
+		view.Close();
+	}
+}
+BENCHMARK(SlideIndexOpen)->Arg(1000)->Arg(10000)->ArgName("pictures")->Unit(benchmark::kMicrosecond);
+
+static void SlideIndexFindAll(benchmark::State& state)
+{
+	std::vector<std::string> names = PictureNames((int)state.range(0));
+	std::vector<uint8_t> bytes = BuildSlideIndex(std::vector<SlideIndexEntry>(names.size()), names);
+	SlideIndexView view;
+	view.Open(bytes.data(), bytes.size());
+	for (auto _ : state)
+	{
+		for (const std::string& name : names)
+			benchmark::DoNotOptimize(view.Find(name));
+	}
+	state.SetItemsProcessed((int64_t)(state.iterations() * names.size()));
+}
+BENCHMARK(SlideIndexFindAll)->Arg(1000)->Arg(10000)->ArgName("pictures")->Unit(benchmark::kMicrosecond);
+
+static void SlideIndexBuild(benchmark::State& state)
+{
+	std::vector<std::string> names = PictureNames((int)state.range(0));
+	std::vector<SlideIndexEntry> entries(names.size());
+	size_t bytes = 0;
+	for (auto _ : state)
+	{
+		std::vector<uint8_t> file = BuildSlideIndex(entries, names);
+		bytes = file.size();
+		benchmark::DoNotOptimize(file.data());
+	}
+	state.SetBytesProcessed((int64_t)(state.iterations() * bytes));
+}
+BENCHMARK(SlideIndexBuild)->Arg(1000)->Arg(10000)->ArgName("pictures")->Unit(benchmark::kMicrosecond);
@@ -0,0 +1,106 @@
+// Throughput of the StereoPack.h kernels, for each level the CPU has, at the
+// eye sizes of a 1080p and a 4K game.  Bytes are what the operation reads
+// plus what it writes, so GB/s compares directly to memory bandwidth.
+
+#include "StereoPack.h"
+
+#include <benchmark/benchmark.h>
+
+#include <vector>
+
+
+struct EyeSize
+{
+	uint32_t width;
+	uint32_t height;
+};
+
+static const EyeSize kEyeSizes[] = { { 1920, 1080 }, { 3840, 2160 } };
+
+static bool HasLevel(StereoPackLevel level)
+{
+	return level <= StereoPackBestLevel();
+}
+
+// Registers the benchmark for each level and eye size, as Name/level/eye.
+
+template <class TBody>
+static void RegisterStereoPack(const char* name, TBody body)
+{
+	for (int level = kStereoPackScalar; level <= kStereoPackAVX2; level++)
+	{
+		for (int size = 0; size < 2; size++)
+		{
+			benchmark::RegisterBenchmark(name, [body, level, size](benchmark::State& state)
+			{
+				if (!HasLevel((StereoPackLevel)level))
+				{
+					state.SkipWithError("not supported on this CPU");
+					return;
+				}
+				body(state, StereoPackKernelsFor((StereoPackLevel)level), kEyeSizes[size]);
+			})->Args({ level, (int)kEyeSizes[size].height })->ArgNames({ "level", "eyeHeight" })
+				->Unit(benchmark::kMicrosecond);
+		}
+	}
+}
+
+static void SetBytes(benchmark::State& state, size_t bytesPerIteration)
+{
+	state.SetBytesProcessed((int64_t)(state.iterations() * bytesPerIteration));
+}
+
+static int RegisterAll()
+{
+	RegisterStereoPack("StereoPackPair", [](benchmark::State& state, const StereoPackKernels& k, EyeSize eye)
+	{
+		size_t eyePixels = (size_t)eye.width * eye.height;
+		std::vector<uint32_t> left(eyePixels, 1), right(eyePixels, 2), dst(2 * eyePixels);
+		for (auto _ : state)
+		{
+			StereoPackPair(k, dst.data(), 8 * eye.width, left.data(), 4 * eye.width, right.data(), 4 * eye.width,
+				eye.width, eye.height);
+			benchmark::ClobberMemory();
+		}
+		SetBytes(state, 4 * 4 * eyePixels);
+	});
+
+	RegisterStereoPack("StereoPackOverUnder", [](benchmark::State& state, const StereoPackKernels& k, EyeSize eye)
+	{
+		size_t eyePixels = (size_t)eye.width * eye.height;
+		std::vector<uint32_t> src(2 * eyePixels, 3), dst(2 * eyePixels);
+		for (auto _ : state)
+		{
+			StereoPackOverUnder(k, dst.data(), 8 * eye.width, src.data(), 4 * eye.width, eye.width, eye.height);
+			benchmark::ClobberMemory();
+		}
+		SetBytes(state, 4 * 4 * eyePixels);
+	});
+
+	RegisterStereoPack("StereoSwapEyes", [](benchmark::State& state, const StereoPackKernels& k, EyeSize eye)
+	{
+		size_t eyePixels = (size_t)eye.width * eye.height;
+		std::vector<uint32_t> image(2 * eyePixels, 4);
+		for (auto _ : state)
+		{
+			StereoSwapEyes(k, image.data(), 8 * eye.width, eye.width, eye.height);
+			benchmark::ClobberMemory();
+		}
+		SetBytes(state, 4 * 4 * eyePixels);
+	});
+
+	RegisterStereoPack("StereoExpandHalfSideBySide", [](benchmark::State& state, const StereoPackKernels& k, EyeSize eye)
+	{
+		size_t eyePixels = (size_t)eye.width * eye.height;
+		std::vector<uint32_t> src(eyePixels, 5), dst(2 * eyePixels);
+		for (auto _ : state)
+		{
+			StereoExpandHalfSideBySide(k, dst.data(), 8 * eye.width, src.data(), 4 * eye.width, eye.width / 2, eye.height);
+			benchmark::ClobberMemory();
+		}
+		SetBytes(state, 4 * 3 * eyePixels);
+	});
+	return 0;
+}
+
+static int registered = RegisterAll();
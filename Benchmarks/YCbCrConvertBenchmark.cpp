@@ -0,0 +1,74 @@
+// The slide decode's pixel work from YCbCrConvert.h, for a double wide 1080p
+// .jps, SSE2 against the scalar rows, and the halving for a smaller screen.
+// Bytes are the planes read plus the BGRA written.
+
+#include "YCbCrConvert.h"
+
+#include <benchmark/benchmark.h>
+
+#include <vector>
+
+
+static const int kWidth = 3840;
+static const int kHeight = 1080;
+
+// Arg is chromaShiftX, 0 for 4:4:4 and 1 for the 4:2:x most cameras write.
+static size_t PlaneBytes(int chromaShiftX)
+{
+	return (size_t)kWidth * kHeight + 2 * (size_t)(kWidth >> chromaShiftX) * kHeight;
+}
+
+static void YCbCrToBGRA_SSE2(benchmark::State& state)
+{
+	int chromaShiftX = (int)state.range(0);
+	std::vector<uint8_t> y((size_t)kWidth * kHeight, 100);
+	std::vector<uint8_t> cb((size_t)(kWidth >> chromaShiftX) * kHeight, 90);
+	std::vector<uint8_t> cr((size_t)(kWidth >> chromaShiftX) * kHeight, 160);
+	std::vector<uint8_t> bgra((size_t)kWidth * kHeight * 4);
+	for (auto _ : state)
+	{
+		for (int row = 0; row < kHeight; row++)
+		{
+			size_t chroma = (size_t)row * (kWidth >> chromaShiftX);
+			YCbCrRowToBGRA(&y[(size_t)row * kWidth], &cb[chroma], &cr[chroma], kWidth, chromaShiftX,
+				&bgra[(size_t)row * kWidth * 4]);
+		}
+		benchmark::ClobberMemory();
+	}
+	state.SetBytesProcessed((int64_t)(state.iterations() * (PlaneBytes(chromaShiftX) + bgra.size())));
+}
+BENCHMARK(YCbCrToBGRA_SSE2)->Arg(0)->Arg(1)->ArgName("chromaShiftX")->Unit(benchmark::kMicrosecond);
+
+static void YCbCrToBGRA_Scalar(benchmark::State& state)
+{
+	int chromaShiftX = (int)state.range(0);
+	std::vector<uint8_t> y((size_t)kWidth * kHeight, 100);
+	std::vector<uint8_t> cb((size_t)(kWidth >> chromaShiftX) * kHeight, 90);
+	std::vector<uint8_t> cr((size_t)(kWidth >> chromaShiftX) * kHeight, 160);
+	std::vector<uint8_t> bgra((size_t)kWidth * kHeight * 4);
+	for (auto _ : state)
+	{
+		for (int row = 0; row < kHeight; row++)
+		{
+			size_t chroma = (size_t)row * (kWidth >> chromaShiftX);
+			YCbCrRowToBGRAScalar(&y[(size_t)row * kWidth], &cb[chroma], &cr[chroma], 0, kWidth, chromaShiftX,
+				&bgra[(size_t)row * kWidth * 4]);
+		}
+		benchmark::ClobberMemory();
+	}
+	state.SetBytesProcessed((int64_t)(state.iterations() * (PlaneBytes(chromaShiftX) + bgra.size())));
+}
+BENCHMARK(YCbCrToBGRA_Scalar)->Arg(0)->Arg(1)->ArgName("chromaShiftX")->Unit(benchmark::kMicrosecond);
+
+static void HalveBGRA_SSE2(benchmark::State& state)
+{
+	std::vector<uint8_t> source((size_t)kWidth * kHeight * 4, 7);
+	std::vector<uint8_t> dest(source.size() / 4);
+	for (auto _ : state)
+	{
+		HalveBGRA(source.data(), kWidth, kHeight, (size_t)kWidth * 4, dest.data());
+		benchmark::ClobberMemory();
+	}
+	state.SetBytesProcessed((int64_t)(state.iterations() * (source.size() + dest.size())));
+}
+BENCHMARK(HalveBGRA_SSE2)->Unit(benchmark::kMicrosecond);
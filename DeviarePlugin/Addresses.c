@@ -38,6 +38,7 @@
 
 #include <d3d9.h>
 #include <d3d11_1.h>
+#include <dxgi1_4.h>
 
 
 // Input object must be IDirect3D9.  If it is the subclass of IDirect3D9Ex, 
@@ -52,6 +53,14 @@ LPVOID lpvtbl_CreateDevice(IDirect3D9* pDX9)
 	return pDX9->lpVtbl->CreateDevice;
 }
 
+LPVOID lpvtbl_Release_DX9(IDirect3D9* pDX9)
+{
+	if (!pDX9)
+		return NULL;
+
+	return pDX9->lpVtbl->Release;
+}
+
 
 // OK to pass in an IDirect3DDevice9Ex object, but usage here must be
 // as the subclass IDirect3DDevice9.
@@ -128,6 +137,41 @@ LPVOID lpvtbl_DrawIndexedPrimitiveUP(IDirect3DDevice9* pDX9Device)
 	return pDX9Device->lpVtbl->DrawIndexedPrimitiveUP;
 }
 
+// Lock and Unlock of textures and their level surfaces, for the managed pool
+// emulation.  Every texture and surface of the runtime shares these.
+
+LPVOID lpvtbl_LockRect_Texture(IDirect3DTexture9* pTexture)
+{
+	if (!pTexture)
+		return NULL;
+
+	return pTexture->lpVtbl->LockRect;
+}
+
+LPVOID lpvtbl_UnlockRect_Texture(IDirect3DTexture9* pTexture)
+{
+	if (!pTexture)
+		return NULL;
+
+	return pTexture->lpVtbl->UnlockRect;
+}
+
+LPVOID lpvtbl_LockRect_Surface(IDirect3DSurface9* pSurface)
+{
+	if (!pSurface)
+		return NULL;
+
+	return pSurface->lpVtbl->LockRect;
+}
+
+LPVOID lpvtbl_UnlockRect_Surface(IDirect3DSurface9* pSurface)
+{
+	if (!pSurface)
+		return NULL;
+
+	return pSurface->lpVtbl->UnlockRect;
+}
+
 
 // DX11 routines to be hooked
 
@@ -165,4 +209,12 @@ LPVOID lpvtbl_ResizeBuffers(IDXGISwapChain* pSwapChain)
 	return pSwapChain->lpVtbl->ResizeBuffers;
 }
 
+LPVOID lpvtbl_ResizeBuffers1(IDXGISwapChain3* pSwapChain)
+{
+	if (!pSwapChain)
+		return NULL;
+
+	return pSwapChain->lpVtbl->ResizeBuffers1;
+}
+
 #undef CINTERFACE
@@ -0,0 +1,581 @@
+#pragma once
+
+//-----------------------------------------------------------
+// Asynchronous log writer, shared by the game plugin and UnityNativePlugin.
+//
+// The LogInfo and Log macros used to fwprintf straight into an unbuffered FILE
+// and fflush, so any log line in Present or Reset was a synchronous disk write
+// on the game's render thread.  Now the caller only copies the format pointer
+// and the raw arguments into a slot of a fixed size ring, and a background
+// thread formats those and writes them to the file in batches.
+//
+// The ring is a bounded multi-producer, single-consumer queue, with a sequence
+// number per slot, so producers never take a lock or make a kernel call.  If
+// the ring is full, the line is dropped and counted, and the writer thread will
+// note how many were lost in the log itself.
+//
+// Arguments are kept by value, as a number, a pointer, or a copy of the text
+// for strings, because %s arguments are frequently stack buffers that are gone
+// by the time the writer gets to them.  The format is copied the same way by
+// Write.  Only WriteLiteral keeps just the pointer, and the LogInfo and Log
+// macros are the only callers of that, pasting L"" in front of the format so
+// that anything but a string literal fails to compile.  A const array can't be
+// told apart from a literal by its type, so that is not left to overloads.
+// The writer formats
+// with the same conversions as the MSVC wide printf, %s is a wide string, %S a
+// narrow one.  Text that does not fit in a slot is truncated.
+//
+// Nothing is flushed to disk synchronously, except by an explicit Flush, which
+// should only be used at FatalExit and unload.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <wchar.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+
+class AsyncLog
+{
+public:
+	// 1024 slots of about 600 bytes is a fixed 600K, allocated once at Start.
+	static const size_t kSlotCount = 1024;				// Must be power of 2.
+	static const size_t kMaxArgs = 12;
+	static const size_t kTextChars = 192;				// For all copied strings of a line.
+	static const size_t kLineChars = 512;				// Longest formatted line.
+
+	// Starts the writer thread, which owns all writes to file from here on.
+	// The file should be opened buffered, the writer flushes after each batch.
+
+	void Start(FILE* file)
+	{
+		if (slots == nullptr)
+		{
+			slots = new Slot[kSlotCount];
+			for (size_t i = 0; i < kSlotCount; i++)
+				slots[i].sequence.store(i, std::memory_order_relaxed);
+		}
+
+		logFile = file;
+		stopping.store(false);
+		writer = std::thread(&AsyncLog::WriterThread, this);
+	}
+
+	// If we get here without Stop, the process is exiting, like from FatalExit,
+	// and the writer thread has already been killed.  A joinable std::thread
+	// would call terminate, so just let it go.
+
+	~AsyncLog()
+	{
+		if (writer.joinable())
+			writer.detach();
+	}
+
+	// Writes out everything that was queued, and stops the writer thread.  The
+	// ring itself is never freed, because a late caller on some other thread
+	// could still be writing into it.  Those lines are just dropped.
+
+	void Stop()
+	{
+		if (!writer.joinable())
+			return;
+
+		stopping.store(true);
+		Wake();
+		writer.join();
+		logFile = nullptr;
+	}
+
+	// printf style, same as fwprintf.  Safe to call from any thread.  The
+	// format must be a string literal, it is kept as a pointer, see above.
+
+	template <class... Args>
+	void WriteLiteral(const wchar_t* fmt, Args... args)
+	{
+		Slot* slot;
+		size_t pos;
+		if (!Reserve(&slot, &pos))
+			return;
+
+		slot->format = fmt;
+		Encode(slot, args...);
+		slot->sequence.store(pos + 1, std::memory_order_release);
+	}
+
+	// The same, for a format that may not outlive the call, so it's copied.
+
+	template <class... Args>
+	void Write(const wchar_t* fmt, Args... args)
+	{
+		Slot* slot;
+		size_t pos;
+		if (!Reserve(&slot, &pos))
+			return;
+
+		slot->format = nullptr;
+		slot->formatOffset = CopyText(slot, fmt);
+		Encode(slot, args...);
+		slot->sequence.store(pos + 1, std::memory_order_release);
+	}
+
+	// A plain line, copied as is, with no formatting at all.
+
+	void WriteText(const wchar_t* text)
+	{
+		Slot* slot;
+		size_t pos;
+		if (!Reserve(&slot, &pos))
+			return;
+
+		slot->format = L"%s";
+		Encode(slot, text);
+		slot->sequence.store(pos + 1, std::memory_order_release);
+	}
+
+	// Blocks until everything queued before this call is on disk, or for at
+	// most a second, in case the writer thread is wedged.
+
+	void Flush()
+	{
+		if (slots == nullptr || logFile == nullptr)
+			return;
+
+		if (!writer.joinable())
+		{
+			DrainToFile();
+			return;
+		}
+
+		size_t target = enqueuePos.load();
+		Wake();
+
+		auto start = std::chrono::steady_clock::now();
+		while (written.load(std::memory_order_acquire) < target)
+		{
+			if (std::chrono::steady_clock::now() - start > std::chrono::seconds(1))
+				break;
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+
+	uint64_t Dropped() const
+	{
+		return dropped.load(std::memory_order_relaxed);
+	}
+
+	// Formats one queued line, as the writer thread does.  Public so that the
+	// tests can check the formatting without a file.
+
+	struct Slot;
+	static size_t Format(const Slot& slot, wchar_t* line, size_t lineChars);
+
+	enum ArgKind : uint32_t
+	{
+		kArgSigned,
+		kArgUnsigned,
+		kArgDouble,
+		kArgPointer,
+		kArgText,						// value.offset into the slot's text.
+		kArgMissing,
+	};
+
+	struct Arg
+	{
+		ArgKind kind;
+		union
+		{
+			int64_t i;
+			uint64_t u;
+			double d;
+			const void* p;
+			uint32_t offset;
+		} value;
+	};
+
+	struct Slot
+	{
+		std::atomic<size_t> sequence;
+		const wchar_t* format;			// Null when copied to formatOffset.
+		uint32_t formatOffset;
+		uint32_t argCount;
+		uint32_t textUsed;
+		Arg args[kMaxArgs];
+		wchar_t text[kTextChars];
+	};
+
+private:
+	// Claims the next slot, false if the ring is full.
+
+	bool Reserve(Slot** reserved, size_t* reservedPos)
+	{
+		if (slots == nullptr)
+			return false;
+
+		size_t pos = enqueuePos.load(std::memory_order_relaxed);
+		Slot* slot;
+		for (;;)
+		{
+			slot = &slots[pos & (kSlotCount - 1)];
+			size_t seq = slot->sequence.load(std::memory_order_acquire);
+			intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+			if (diff == 0)
+			{
+				if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if (diff < 0)
+			{
+				// Writer has not caught up, ring is full.
+				dropped.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			}
+			else
+			{
+				pos = enqueuePos.load(std::memory_order_relaxed);
+			}
+		}
+
+		slot->argCount = 0;
+		slot->textUsed = 0;
+		*reserved = slot;
+		*reservedPos = pos;
+		return true;
+	}
+
+	// Copies text into the slot, truncated to what is left.  Returns its offset.
+
+	template <class TChar>
+	static uint32_t CopyText(Slot* slot, const TChar* text)
+	{
+		// Already full, the last character is the null from the one before.
+		uint32_t offset = slot->textUsed;
+		if (offset >= kTextChars)
+			return kTextChars - 1;
+
+		uint32_t used = offset;
+		if (text != nullptr)
+		{
+			while (*text && used + 1 < kTextChars)
+				slot->text[used++] = (wchar_t)(typename std::make_unsigned<TChar>::type)*text++;
+		}
+		if (used < kTextChars)
+			slot->text[used++] = 0;
+		slot->textUsed = used;
+		return offset;
+	}
+
+	static void Encode(Slot*)
+	{
+	}
+
+	template <class T, class... Rest>
+	static void Encode(Slot* slot, T first, Rest... rest)
+	{
+		if (slot->argCount < kMaxArgs)
+			EncodeOne(&slot->args[slot->argCount++], slot, first);
+		Encode(slot, rest...);
+	}
+
+	template <class T>
+	static typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type
+		EncodeOne(Arg* arg, Slot*, T value)
+	{
+		typedef typename std::conditional<std::is_enum<T>::value, std::underlying_type<T>, std::common_type<T>>::type::type Integer;
+		if (std::is_signed<Integer>::value)
+		{
+			arg->kind = kArgSigned;
+			arg->value.i = (int64_t)value;
+		}
+		else
+		{
+			arg->kind = kArgUnsigned;
+			arg->value.u = (uint64_t)value;
+		}
+	}
+
+	template <class T>
+	static typename std::enable_if<std::is_floating_point<T>::value>::type
+		EncodeOne(Arg* arg, Slot*, T value)
+	{
+		arg->kind = kArgDouble;
+		arg->value.d = value;
+	}
+
+	template <class T>
+	static typename std::enable_if<!std::is_function<T>::value>::type
+		EncodeOne(Arg* arg, Slot* slot, T* value)
+	{
+		EncodePointer(arg, slot, value);
+	}
+
+	template <class T>
+	static typename std::enable_if<std::is_function<T>::value>::type
+		EncodeOne(Arg* arg, Slot*, T* value)
+	{
+		arg->kind = kArgPointer;
+		arg->value.p = (const void*)reinterpret_cast<uintptr_t>(value);
+	}
+
+	static void EncodeOne(Arg* arg, Slot*, std::nullptr_t)
+	{
+		arg->kind = kArgPointer;
+		arg->value.p = nullptr;
+	}
+
+	static void EncodePointer(Arg* arg, Slot* slot, const wchar_t* text) { EncodeText(arg, slot, text); }
+	static void EncodePointer(Arg* arg, Slot* slot, const char* text) { EncodeText(arg, slot, text); }
+	static void EncodePointer(Arg* arg, Slot*, const volatile void* pointer)
+	{
+		arg->kind = kArgPointer;
+		arg->value.p = (const void*)pointer;
+	}
+
+	template <class TChar>
+	static void EncodeText(Arg* arg, Slot* slot, const TChar* text)
+	{
+		if (text == nullptr)
+		{
+			arg->kind = kArgPointer;
+			arg->value.p = nullptr;
+			return;
+		}
+		arg->kind = kArgText;
+		arg->value.offset = CopyText(slot, text);
+	}
+
+	void Wake()
+	{
+		{
+			std::lock_guard<std::mutex> lock(wakeLock);
+			wakeRequested = true;
+		}
+		wake.notify_one();
+	}
+
+	// Wakes every 10ms, or immediately for Flush and Stop, and writes out
+	// whatever has been queued, as a single batch.
+
+	void WriterThread()
+	{
+		for (;;)
+		{
+			bool exiting = stopping.load();
+
+			DrainToFile();
+
+			if (exiting)
+				return;
+
+			std::unique_lock<std::mutex> lock(wakeLock);
+			wake.wait_for(lock, std::chrono::milliseconds(10), [this] { return wakeRequested; });
+			wakeRequested = false;
+		}
+	}
+
+	// Only ever called by the single consumer, the writer thread, or by Flush
+	// when there is no writer thread.
+
+	void DrainToFile()
+	{
+		bool any = false;
+
+		for (;;)
+		{
+			Slot* slot = &slots[dequeuePos & (kSlotCount - 1)];
+			size_t seq = slot->sequence.load(std::memory_order_acquire);
+			if (seq != dequeuePos + 1)
+				break;
+
+			Format(*slot, line, kLineChars);
+			fputws(line, logFile);
+			slot->sequence.store(dequeuePos + kSlotCount, std::memory_order_release);
+			dequeuePos++;
+			any = true;
+		}
+
+		uint64_t lost = dropped.load(std::memory_order_relaxed);
+		if (lost != droppedReported)
+		{
+			fwprintf(logFile, L"  [log] %llu lines dropped, log ring was full.\n", (unsigned long long)(lost - droppedReported));
+			droppedReported = lost;
+			any = true;
+		}
+
+		if (any)
+			fflush(logFile);
+
+		written.store(dequeuePos, std::memory_order_release);
+	}
+
+	Slot* slots = nullptr;
+	FILE* logFile = nullptr;
+
+	alignas(64) std::atomic<size_t> enqueuePos { 0 };
+	alignas(64) std::atomic<uint64_t> dropped { 0 };
+
+	// Writer thread side.
+	alignas(64) size_t dequeuePos = 0;
+	std::atomic<size_t> written { 0 };
+	uint64_t droppedReported = 0;
+	wchar_t line[kLineChars];
+
+	std::thread writer;
+	std::mutex wakeLock;
+	std::condition_variable wake;
+	bool wakeRequested = false;
+	std::atomic<bool> stopping { false };
+};
+
+
+// The printf conversions, one at a time.  Flags, width and precision are passed
+// on to swprintf as they are.  The length is what the caller's printf would
+// have read from its va_list, so the value is cut to that many bits first, and
+// then always printed as a long long.  l is 32 bits, as on Windows, I and z are
+// the size of a pointer.
+
+inline size_t AsyncLog::Format(const Slot& slot, wchar_t* line, size_t lineChars)
+{
+	const wchar_t* fmt = slot.format ? slot.format : slot.text + slot.formatOffset;
+	size_t n = 0;
+	uint32_t next = 0;
+	Arg missing = { kArgMissing, {} };
+
+	while (*fmt && n + 1 < lineChars)
+	{
+		if (*fmt != L'%')
+		{
+			line[n++] = *fmt++;
+			continue;
+		}
+
+		const wchar_t* spec = fmt++;
+		if (*fmt == L'%')
+		{
+			line[n++] = *fmt++;
+			continue;
+		}
+
+		while (*fmt && wcschr(L"-+ #0", *fmt))
+			fmt++;
+		while (*fmt >= L'0' && *fmt <= L'9')
+			fmt++;
+		if (*fmt == L'.')
+		{
+			fmt++;
+			while (*fmt >= L'0' && *fmt <= L'9')
+				fmt++;
+		}
+		size_t specChars = fmt - spec;
+
+		int bits = 32;
+		if (fmt[0] == L'h' && fmt[1] == L'h')
+			bits = 8, fmt += 2;
+		else if (fmt[0] == L'h')
+			bits = 16, fmt++;
+		else if (fmt[0] == L'l' && fmt[1] == L'l')
+			bits = 64, fmt += 2;
+		else if (fmt[0] == L'l')
+			fmt++;
+		else if (fmt[0] == L'I' && fmt[1] == L'6' && fmt[2] == L'4')
+			bits = 64, fmt += 3;
+		else if (fmt[0] == L'I' && fmt[1] == L'3' && fmt[2] == L'2')
+			fmt += 3;
+		else if (fmt[0] == L'I' || fmt[0] == L'z' || fmt[0] == L't' || fmt[0] == L'j')
+			bits = (fmt[0] == L'j') ? 64 : (int)(sizeof(void*) * 8), fmt++;
+
+		wchar_t conversion = *fmt;
+		if (conversion == 0)
+			break;
+		fmt++;
+
+		const Arg& arg = (next < slot.argCount) ? slot.args[next++] : missing;
+		uint64_t raw = (arg.kind == kArgDouble) ? (uint64_t)(int64_t)arg.value.d :
+			(arg.kind == kArgPointer) ? (uint64_t)(uintptr_t)arg.value.p :
+			(arg.kind == kArgText || arg.kind == kArgMissing) ? 0 : arg.value.u;
+		if (bits < 64)
+			raw &= (1ull << bits) - 1;
+
+		// The spec as given, up to the length, with our own length after it.
+		wchar_t format[24];
+		if (specChars > 16)
+			specChars = 16;
+		wmemcpy(format, spec, specChars);
+		wchar_t* tail = format + specChars;
+
+		wchar_t* out = line + n;
+		size_t room = lineChars - n;
+		int printed = 0;
+		switch (conversion)
+		{
+		case L'd':
+		case L'i':
+		{
+			// Sign extend from the caller's size.
+			int64_t value = (bits < 64 && (raw >> (bits - 1)) & 1) ? (int64_t)(raw | ~((1ull << bits) - 1)) : (int64_t)raw;
+			tail[0] = L'l', tail[1] = L'l', tail[2] = L'd', tail[3] = 0;
+			printed = swprintf(out, room, format, (long long)value);
+			break;
+		}
+		case L'u':
+		case L'x':
+		case L'X':
+		case L'o':
+			tail[0] = L'l', tail[1] = L'l', tail[2] = conversion, tail[3] = 0;
+			printed = swprintf(out, room, format, (unsigned long long)raw);
+			break;
+		case L'f':
+		case L'F':
+		case L'e':
+		case L'E':
+		case L'g':
+		case L'G':
+		{
+			double value = (arg.kind == kArgDouble) ? arg.value.d :
+				(arg.kind == kArgSigned) ? (double)arg.value.i : (double)raw;
+			tail[0] = conversion, tail[1] = 0;
+			printed = swprintf(out, room, format, value);
+			break;
+		}
+		case L'p':
+			tail[0] = L'p', tail[1] = 0;
+			printed = swprintf(out, room, format, (void*)(uintptr_t)raw);
+			break;
+		case L'c':
+			if (arg.kind == kArgMissing)
+				break;
+			out[0] = (wchar_t)raw;
+			printed = 1;
+			break;
+		case L's':
+		case L'S':
+		{
+			const wchar_t* text = (arg.kind == kArgText) ? slot.text + arg.value.offset :
+				(arg.kind == kArgPointer && arg.value.p == nullptr) ? L"(null)" : L"(?)";
+			while (*text && n + printed + 1 < lineChars)
+				out[printed++] = *text++;
+			break;
+		}
+		default:
+		{
+			// Unknown, copied through as it was.
+			size_t length = fmt - spec;
+			for (size_t i = 0; i < length && n + printed + 1 < lineChars; i++)
+				out[printed++] = spec[i];
+			break;
+		}
+		}
+
+		// swprintf returns negative when it does not fit, and leaves who knows
+		// what behind, so that's the end of the line.
+		if (printed < 0)
+			break;
+		n += ((size_t)printed < room) ? printed : room - 1;
+	}
+
+	line[n] = 0;
+	return n;
+}
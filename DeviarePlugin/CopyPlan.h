@@ -0,0 +1,362 @@
+#pragma once
+
+//-----------------------------------------------------------
+// How much of the game's stereo frame to copy into the shared surface.
+//
+// Both Present hooks have always copied every pixel of both eyes.  When the
+// virtual screen only covers a small part of the headset view, most of those
+// pixels are never seen, and the copy bandwidth is wasted.  The VR side can ask
+// for a half resolution copy, or for just the rectangle of each eye it can
+// see, through the copyRequest in the KatangaSharedDescriptor.
+//
+// This decides what we actually do for a request, given the eye size, the
+// format and what the device can filter, and works out the shared surface size
+// and every rectangle of the copy.  Anything it cannot do well falls back to a
+// full copy, and the VR side sees that in the published copyMode.
+//
+// The reduced copies go through a full size stereo intermediate, because the
+// stereo blit only works into a double width target of the backbuffer's size.
+// From there, each half of it is copied or filtered into the smaller surface.
+// DX9 can StretchRect with a filter, any size to any size.  DX11 has no such
+// copy, so there the intermediate gets a second mip level, GenerateMips does
+// the filtering, and level 1 is copied out.
+//
+// Changing the copy means new shared surfaces, a few ms of the game's Present
+// and a reopen on the VR side.  So a new request has to hold steady for a
+// while, it has to differ by more than a small slack from what we copy now,
+// and crops are rounded out to a coarse step, so that small head movements
+// don't keep rebuilding them.
+
+#include <stdint.h>
+
+#include "KatangaIPC.h"
+
+
+// How the device can scale the intermediate down.
+
+enum CopyScaler
+{
+	kScaleStretch,					// Any size, like a filtered StretchRect.
+	kScaleMipHalving,				// Only by half, through a generated mip level.
+};
+
+struct CopyRect
+{
+	uint32_t x;
+	uint32_t y;
+	uint32_t width;
+	uint32_t height;
+};
+
+inline bool operator==(const CopyRect& a, const CopyRect& b)
+{
+	return a.x == b.x && a.y == b.y && a.width == b.width && a.height == b.height;
+}
+
+// What we are copying from.  filterable is whether the device can do a filtered
+// scale of the format at all, the format table below is also checked.
+
+struct CopySource
+{
+	uint32_t eyeWidth;
+	uint32_t eyeHeight;
+	uint32_t format;				// DXGI_FORMAT, 0 if not known.
+	CopyScaler scaler;
+	bool filterable;
+};
+
+// Everything the Present hook needs for the copy.  The stereo image is the
+// double width intermediate, right eye in the left half like the surface.
+// half[0] and half[1] are where the left and right halves of the surface are
+// read from, in mip level readLevel of that intermediate.
+
+struct CopyPlan
+{
+	uint64_t request;				// The request this was made for.
+	KatangaCopyMode mode;			// What we are actually doing.
+
+	uint32_t eyeWidth;
+	uint32_t eyeHeight;
+	CopyRect source;				// Part of each eye that is copied, in eye pixels.
+
+	uint32_t readLevel;
+	CopyRect half[2];
+
+	uint32_t destWidth;				// Each eye, in the shared surface.
+	uint32_t destHeight;
+	uint32_t width;					// The whole shared surface.
+	uint32_t height;
+
+	// Full copies go straight from the backbuffer, the others need the intermediate.
+	bool NeedsIntermediate() const { return mode != kCopyModeFull; }
+
+	// DX11 needs the mips, DX9 filters in the StretchRect.
+	bool NeedsMips() const { return readLevel > 0; }
+
+	// Whether the copy out of the intermediate changes size.
+	bool Scales() const { return source.width != destWidth || source.height != destHeight; }
+};
+
+// Two plans that would make the same surfaces and copy the same pixels.
+inline bool SameCopy(const CopyPlan& a, const CopyPlan& b)
+{
+	return a.mode == b.mode && a.eyeWidth == b.eyeWidth && a.eyeHeight == b.eyeHeight &&
+		a.source == b.source && a.destWidth == b.destWidth && a.destHeight == b.destHeight;
+}
+
+
+// The backbuffer formats we see, DXGI_FORMAT values.  Only these are filtered,
+// anything else only gets full or cropped copies, which never blend pixels.
+// R10G10B10_XR_BIAS_A2 is a scanout only format, and cannot be a render target.
+
+struct CopyFormat
+{
+	uint32_t format;
+	uint32_t bytesPerPixel;
+	bool filterable;
+};
+
+const CopyFormat kCopyFormats[] =
+{
+	{ 10, 8, true },				// R16G16B16A16_FLOAT
+	{ 24, 4, true },				// R10G10B10A2_UNORM
+	{ 28, 4, true },				// R8G8B8A8_UNORM
+	{ 29, 4, true },				// R8G8B8A8_UNORM_SRGB
+	{ 87, 4, true },				// B8G8R8A8_UNORM
+	{ 88, 4, true },				// B8G8R8X8_UNORM
+	{ 89, 4, false },				// R10G10B10_XR_BIAS_A2_UNORM
+	{ 91, 4, true },				// B8G8R8A8_UNORM_SRGB
+};
+
+inline const CopyFormat* FindCopyFormat(uint32_t format)
+{
+	for (const CopyFormat& known : kCopyFormats)
+	{
+		if (known.format == format)
+			return &known;
+	}
+	return nullptr;
+}
+
+// Size of the shared surface, for the log.  Unknown formats are taken as 4 bytes.
+inline uint64_t CopyPlanBytes(const CopyPlan& plan, uint32_t format)
+{
+	const CopyFormat* known = FindCopyFormat(format);
+	return (uint64_t)plan.width * plan.height * (known ? known->bytesPerPixel : 4);
+}
+
+
+// Crops are rounded out to this many pixels, and a crop of nearly all of the
+// eye is not worth a smaller surface, so it's just a full copy.
+const uint32_t kCopyCropStep = 32;
+const uint32_t kCopyCropMostPercent = 90;
+
+// One axis of a crop.  The request is rounded out to whole pixels, then grown
+// to a multiple of the step around its center, and moved back inside the eye.
+
+inline void CropAxis(uint32_t start, uint32_t length, uint32_t eye, uint32_t* outStart, uint32_t* outLength)
+{
+	uint64_t first = (uint64_t)start * eye / kKatangaCropScale;
+	uint64_t last = ((uint64_t)start + length) * eye;
+	last = (last + kKatangaCropScale - 1) / kKatangaCropScale;
+	if (last > eye)
+		last = eye;
+	if (first >= last)
+		first = (last > 0) ? last - 1 : 0;
+
+	uint64_t size = last - first;
+	uint64_t rounded = (size + kCopyCropStep - 1) / kCopyCropStep * kCopyCropStep;
+	if (rounded > eye)
+		rounded = eye;
+
+	uint64_t grow = rounded - size;
+	first = (first > grow / 2) ? first - grow / 2 : 0;
+	if (first + rounded > eye)
+		first = eye - rounded;
+
+	*outStart = (uint32_t)first;
+	*outLength = (uint32_t)rounded;
+}
+
+// Fills in the plan for one copy mode.  The mode must be possible for the source.
+
+inline void LayoutCopyPlan(const CopySource& source, KatangaCopyMode mode, const CopyRect& crop, CopyPlan* plan)
+{
+	uint32_t w = source.eyeWidth;
+	uint32_t h = source.eyeHeight;
+
+	plan->mode = mode;
+	plan->eyeWidth = w;
+	plan->eyeHeight = h;
+	plan->readLevel = 0;
+
+	if (mode == kCopyModeHalf && source.scaler == kScaleMipHalving)
+	{
+		// Mip level 1 of the double width image is exactly the half size image,
+		// with the eyes meeting in its middle, because the eye width is even.
+		// With an odd height, the last row of both eyes is dropped.
+		plan->destWidth = w / 2;
+		plan->destHeight = h / 2;
+		plan->source = { 0, 0, w, plan->destHeight * 2 };
+		plan->readLevel = 1;
+		plan->half[0] = { 0, 0, w / 2, h / 2 };
+		plan->half[1] = { w / 2, 0, w / 2, h / 2 };
+	}
+	else
+	{
+		if (mode == kCopyModeHalf)
+		{
+			// Rounded up, so a filtered stretch keeps every source pixel.
+			plan->destWidth = (w + 1) / 2;
+			plan->destHeight = (h + 1) / 2;
+			plan->source = { 0, 0, w, h };
+		}
+		else
+		{
+			plan->source = (mode == kCopyModeCrop) ? crop : CopyRect{ 0, 0, w, h };
+			plan->destWidth = plan->source.width;
+			plan->destHeight = plan->source.height;
+		}
+		plan->half[0] = plan->source;
+		plan->half[1] = plan->source;
+		plan->half[1].x += w;
+	}
+
+	plan->width = plan->destWidth * 2;
+	plan->height = plan->destHeight;
+}
+
+// What we can do for a request.  Half needs a filterable format on a device that
+// can filter it, and at least 2x2 per eye.  Halving through mips also needs an
+// even eye width, otherwise the middle texel of level 1 would blend both eyes.
+// A crop needs a real rectangle, clearly smaller than the eye.
+
+inline CopyPlan PlanCopy(const CopySource& source, uint64_t request)
+{
+	uint32_t cropRequest[4];
+	KatangaCopyMode wanted = KatangaUnpackCopyRequest(request, cropRequest);
+	KatangaCopyMode mode = kCopyModeFull;
+	CopyRect crop = { 0, 0, source.eyeWidth, source.eyeHeight };
+
+	if (wanted == kCopyModeHalf)
+	{
+		const CopyFormat* known = FindCopyFormat(source.format);
+		bool filterable = source.filterable && known != nullptr && known->filterable;
+		bool bigEnough = source.eyeWidth >= 2 && source.eyeHeight >= 2;
+		bool halves = source.scaler != kScaleMipHalving || (source.eyeWidth % 2) == 0;
+		if (filterable && bigEnough && halves)
+			mode = kCopyModeHalf;
+	}
+	else if (wanted == kCopyModeCrop && cropRequest[2] > 0 && cropRequest[3] > 0 &&
+		source.eyeWidth > 0 && source.eyeHeight > 0)
+	{
+		CropAxis(cropRequest[0], cropRequest[2], source.eyeWidth, &crop.x, &crop.width);
+		CropAxis(cropRequest[1], cropRequest[3], source.eyeHeight, &crop.y, &crop.height);
+
+		uint64_t area = (uint64_t)crop.width * crop.height;
+		uint64_t eyeArea = (uint64_t)source.eyeWidth * source.eyeHeight;
+		if (area * 100 < eyeArea * kCopyCropMostPercent)
+			mode = kCopyModeCrop;
+	}
+
+	CopyPlan plan;
+	plan.request = request;
+	LayoutCopyPlan(source, mode, crop, &plan);
+	return plan;
+}
+
+
+// A crop edge has to move by more than this, in kKatangaCropScale units, for
+// two requests to differ, about 2% of the eye.  The VR side's crop follows the
+// head, and moves a little all the time.
+const uint32_t kCopyRequestSlack = kKatangaCropScale / 50;
+
+// Two requests that are the same mode, and for crops, the same rectangle give
+// or take the slack.  The crop of any other mode means nothing.
+
+inline bool SimilarCopyRequests(uint64_t a, uint64_t b)
+{
+	uint32_t cropA[4];
+	uint32_t cropB[4];
+	KatangaCopyMode modeA = KatangaUnpackCopyRequest(a, cropA);
+	KatangaCopyMode modeB = KatangaUnpackCopyRequest(b, cropB);
+	if (modeA != modeB)
+		return false;
+	if (modeA != kCopyModeCrop)
+		return true;
+
+	for (int i = 0; i < 4; i++)
+	{
+		uint32_t distance = (cropA[i] > cropB[i]) ? cropA[i] - cropB[i] : cropB[i] - cropA[i];
+		if (distance > kCopyRequestSlack)
+			return false;
+	}
+	return true;
+}
+
+
+// Keeps the plan for the current surfaces, and decides when a new request from
+// the VR side is worth new surfaces.  Begin is called at each surface creation,
+// and takes the request as it is.  Changed is called every Present, and says
+// when a request unlike the current one has held for kSettlePresents, all of
+// it within the slack of where it started, and would copy something else.
+//
+// Once it says so, it keeps saying so for as long as the request holds, until
+// the new surfaces are made and Begin takes it.  The Present hooks only make
+// them when the VR side is between frames, which can take a few Presents.
+
+class CopyModeNegotiator
+{
+public:
+	// About half a second at 90 fps.
+	static const int kSettlePresents = 45;
+
+	const CopyPlan& Begin(const CopySource& from, uint64_t request)
+	{
+		source = from;
+		plan = PlanCopy(source, request);
+		pending = request;
+		steady = 0;
+		return plan;
+	}
+
+	bool Changed(uint64_t request)
+	{
+		if (SimilarCopyRequests(request, plan.request))
+		{
+			steady = 0;
+			return false;
+		}
+
+		// Measured from the first request of the run, so a slow drift of the
+		// crop starts over once it is past the slack.
+		if (steady == 0 || !SimilarCopyRequests(request, pending))
+		{
+			pending = request;
+			steady = 0;
+		}
+		if (steady >= kSettlePresents)
+			return true;
+		if (++steady < kSettlePresents)
+			return false;
+
+		// Steady, but maybe not different in the end, like a half request for a
+		// format we can't filter.  Then just remember it, and keep the surfaces.
+		CopyPlan next = PlanCopy(source, request);
+		if (SameCopy(next, plan))
+		{
+			plan.request = request;
+			steady = 0;
+			return false;
+		}
+		return true;
+	}
+
+	const CopyPlan& Plan() const { return plan; }
+
+private:
+	CopySource source = { 0, 0, 0, kScaleStretch, false };
+	CopyPlan plan = PlanCopy(source, 0);
+	uint64_t pending = 0;
+	int steady = 0;
+};
@@ -10,9 +10,14 @@
 
 
 #include <atlbase.h>
+#include <mutex>
+#include <string>
 #include <thread>
 #include <shlobj_core.h>
 
+#include "KatangaSharedMemory.h"
+#include "VtableCache.h"
+
 
 // We need the Deviare interface though, to be able to provide the OnLoad,
 // OnFunctionCalled interfaces, and to be able to LoadCustomDLL this DLL from
@@ -34,8 +39,9 @@
 // only have a single instance of each.  Even though they aren't used in this
 // compilation unit, it is the named target of the project, so they belong here.
 
-// Always logging to Unity LocalLow file. 
+// Always logging to Unity LocalLow file, written by the gAsyncLog thread.
 FILE* LogFile;
+AsyncLog gAsyncLog;
 
 // This is automatically instantiated by C++, so the hooking library
 // is immediately available.
@@ -57,14 +63,32 @@ bool gDirectMode = false;
 // x64 games, because Windows maps these.  Unity side can always use x32 value.
 HANDLE gGameSharedHandle = NULL;
 
-HANDLE gMappedFile = NULL;
+// Where the gMappedView lives, see KatangaSharedMemory.h.
+KatangaSharedMemory* gMappedFile = nullptr;
 LPVOID gMappedView = nullptr;
-DWORD gMapSize = sizeof(UINT);
+DWORD gMapSize = sizeof(KatangaSharedDescriptor);
+
+// Typed view of the gMappedView, layout is in KatangaIPC.h.
+KatangaSharedDescriptor* gSharedDesc = nullptr;
+
+// Signaled after the descriptor changes, so the VR side does not poll for it.
+KatangaNotifyEvent gNotify;
+
+// Separate mapping for the Present timing stats, layout is in KatangaStats.h.
+HANDLE gStatsFile = NULL;
+KatangaStatsPage* gStats = nullptr;
+
+KatangaTracer gTrace;
+KatangaTracer gFrameTrace;
 
 // The Named Mutex to prevent the VR side from interfering with game side, during
 // the creation or reset of the graphic device.
 HANDLE gSetupMutex = NULL;
 
+// Capture/Release are nested, like ResizeBuffers rebuilding the shared surfaces,
+// so we only flip the setupSequence for the outermost pair.
+static int gSetupDepth = 0;
+
 
 //-----------------------------------------------------------
 
@@ -73,6 +97,11 @@ HANDLE gSetupMutex = NULL;
 // from the game side here.
 // We should be OK using a 1 second wait here, if we cannot grab the mutex from the
 // Katanga side in 1 second, something is definitely broken.
+//
+// The VR side no longer takes the mutex every frame.  It only marks itself busy
+// in the shared descriptor while drawing, so before we take the mutex, we mark
+// setup as in progress and wait for it to finish any frame it already started.
+// After that, it will see the odd setupSequence and block on the mutex instead.
 
 void CaptureSetupMutex()
 {
@@ -83,6 +112,20 @@ void CaptureSetupMutex()
 	if (gSetupMutex == NULL)
 		FatalExit(L"CaptureSetupMutex: mutex does not exist.", GetLastError());
 
+	if (gSetupDepth++ == 0 && gSharedDesc != nullptr)
+	{
+		KatangaBeginSetup(gSharedDesc);
+
+		// At most one VR frame, 11ms.  If the VR side is hung or gone, don't
+		// wait forever, the mutex below is still the real lock.  But a VR side
+		// that never clears busy is a bug, so make it stand out in the trace.
+		if (!KatangaWaitConsumerIdle(gSharedDesc, std::chrono::milliseconds(1000)))
+		{
+			LogInfo(L"  CaptureSetupMutex: VR side still busy after 1s, busy: %d, continuing.\n", gSharedDesc->consumerBusy.load());
+			gTrace.Instant("ConsumerBusyTimeout");
+		}
+	}
+
 	waitResult = WaitForSingleObject(gSetupMutex, 1000);
 	LogInfo(L"  WaitForSingleObject mutex:%p, result:0x%x\n", gSetupMutex, waitResult);
 	if (waitResult != WAIT_OBJECT_0)
@@ -90,14 +133,63 @@ void CaptureSetupMutex()
 		wchar_t info[512];
 		DWORD hr = GetLastError();
 		swprintf_s(info, _countof(info), L"CaptureSetupMutex: WaitForSingleObject failed.\nwaitResult: 0x%x, err: 0x%x\n", waitResult, hr);
-		LogInfo(info);
+		LogInfo(L"%s", info);
 		FatalExit(info, hr);
 	}
 }
 
+// Same, but for the rebuilds we choose to do, like for a new copy mode, which
+// can just as well happen a frame later.  This never waits: if the VR side is
+// mid-frame, or holds the mutex, we take back the setup mark and return false,
+// and the caller tries again next Present.  When it returns true, the caller
+// holds the mutex, and must ReleaseSetupMutex as usual.
+
+bool TryCaptureSetupMutex()
+{
+	if (gSetupMutex == NULL)
+		FatalExit(L"TryCaptureSetupMutex: mutex does not exist.", GetLastError());
+
+	// Nested inside a setup of our own, nothing to wait for.
+	if (gSetupDepth > 0)
+	{
+		CaptureSetupMutex();
+		return true;
+	}
+
+	if (gSharedDesc != nullptr)
+	{
+		KatangaBeginSetup(gSharedDesc);
+		if (!KatangaConsumerIdle(gSharedDesc))
+		{
+			KatangaEndSetup(gSharedDesc);
+			return false;
+		}
+	}
+
+	DWORD waitResult = WaitForSingleObject(gSetupMutex, 0);
+	if (waitResult == WAIT_TIMEOUT)
+	{
+		if (gSharedDesc != nullptr)
+			KatangaEndSetup(gSharedDesc);
+		return false;
+	}
+	if (waitResult != WAIT_OBJECT_0)
+	{
+		wchar_t info[512];
+		DWORD hr = GetLastError();
+		swprintf_s(info, _countof(info), L"TryCaptureSetupMutex: WaitForSingleObject failed.\nwaitResult: 0x%x, err: 0x%x\n", waitResult, hr);
+		LogInfo(L"%s", info);
+		FatalExit(info, hr);
+	}
+
+	gSetupDepth++;
+	LogInfo(L"-> TryCaptureSetupMutex mutex:%p\n", gSetupMutex);
+	return true;
+}
+
 // Release use of shared mutex, so the VR side can grab the mutex, and thus know that
 // it can fetch the shared surface and use it to draw.  Normal operation is that the
-// VR side grabs and releases the mutex for every frame, and is only blocked when
+// VR side checks the setupSequence every frame, and only falls back to the mutex when
 // we are setting up the graphics environment here, either as first run where this
 // side creates the mutex as active and locked, or when Reset/Resize is called and we grab
 // the mutex to lock out the VR side.
@@ -109,6 +201,9 @@ void ReleaseSetupMutex()
 	if (gSetupMutex == NULL)
 		FatalExit(L"ReleaseSetupMutex: mutex does not exist.", GetLastError());
 
+	if (--gSetupDepth == 0 && gSharedDesc != nullptr)
+		KatangaEndSetup(gSharedDesc);
+
 	bool ok = ReleaseMutex(gSetupMutex);
 	LogInfo(L"  ReleaseSetupMutex mutex:%p, result:%s\n", gSetupMutex, ok? L"OK" : L"FAIL");
 	if (!ok)
@@ -120,28 +215,198 @@ void ReleaseSetupMutex()
 
 void CreateFileMappedIPC()
 {
-	TCHAR szName[] = TEXT("Local\\KatangaMappedFile");
-
-	gMappedFile = CreateFileMapping(
-		INVALID_HANDLE_VALUE,			// use paging file
-		NULL,							// default security
-		PAGE_READWRITE,					// read/write access
-		0,								// maximum object size (high-order DWORD)
-		gMapSize,						// maximum object size (low-order DWORD)
-		szName);						// name of mapping object
-	if (gMappedFile == NULL)
-		FatalExit(L"OnLoad: could not CreateFileMapping for IPC", GetLastError());
-
-	gMappedView = MapViewOfFile(
-		gMappedFile,					// handle to map file object
-		FILE_MAP_ALL_ACCESS,			// read/write permission
-		0,								// No offset in file
-		0,
-		gMapSize);						// Map full buffer
-	if (gMappedView == NULL)
-		FatalExit(L"OnLoad: could not MapViewOfFile for IPC", GetLastError());
-
-	LogInfo(L"GamePlugin: Mapped file created: %p, val: 0x%x\n", gMappedView, *(UINT*)(gMappedView));
+	gMappedFile = CreateKatangaSharedMemory_Win32(KATANGA_MAPPED_FILE_NAME);
+	if (!gMappedFile->Create(gMapSize))
+		FatalExit(L"OnLoad: could not create file mapping for IPC", gMappedFile->LastError());
+	gMappedView = gMappedFile->View();
+
+	// Pagefile backed mappings are zero filled, so this starts out with a null
+	// handle and sequence 0, which the VR side treats as not ready.
+	gSharedDesc = static_cast<KatangaSharedDescriptor*>(gMappedView);
+
+	LogInfo(L"GamePlugin: Mapped file created: %p, size: %d, val: 0x%x\n", gMappedView, gMapSize, gSharedDesc->sharedHandle);
+
+	// The VR side waits for this before it even tries to open the mapping, so
+	// signal now that it exists.  Without the event, the VR side falls back to
+	// looking for the mapping on a slow timer.
+	if (gNotify.Open())
+		gNotify.Signal();
+	LogInfo(L"GamePlugin: Notify event opened: %d\n", gNotify.IsOpen());
+
+	// The stats are only informational, so if we can't make that mapping, we
+	// just run without them.
+	TCHAR szStatsName[] = KATANGA_STATS_FILE_NAME;
+
+	gStatsFile = CreateFileMapping(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 
+		0, sizeof(KatangaStatsPage), szStatsName);
+	if (gStatsFile != NULL)
+		gStats = static_cast<KatangaStatsPage*>(MapViewOfFile(gStatsFile, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(KatangaStatsPage)));
+	if (gStats != nullptr)
+	{
+		LARGE_INTEGER frequency;
+		QueryPerformanceFrequency(&frequency);
+		KatangaInitStats(gStats, 0, frequency.QuadPart);
+	}
+
+	LogInfo(L"GamePlugin: Stats file created: %p, size: %d\n", gStats, sizeof(KatangaStatsPage));
+}
+
+// --------------------------------------------------------------------------------------------------
+
+// A file in the same LocalLow folder as the log, or empty if we can't get that.
+
+static std::wstring KatangaFilePath(LPCWSTR name)
+{
+	std::wstring path;
+	wchar_t* localLowAppData = nullptr;
+	if (SUCCEEDED(SHGetKnownFolderPath(FOLDERID_LocalAppDataLow, 0, NULL, &localLowAppData)))
+		path = std::wstring(localLowAppData) + L"\\Katanga\\Katanga\\" + name;
+	CoTaskMemFree(localLowAppData);
+	return path;
+}
+
+// The vtable cache is VtableCache.txt in the same LocalLow folder as the log.
+// It's read the first time a Find*Present asks, and written back whenever a
+// dummy device found something it did not have.  Only used on the thread
+// that gets the first D3D call, but the lock is cheap.
+
+static VtableCache gVtableCache;
+static std::mutex gVtableCacheLock;
+static bool gVtableCacheLoaded = false;
+
+static std::wstring VtableCachePath()
+{
+	return KatangaFilePath(L"VtableCache.txt");
+}
+
+static void LoadVtableCache()
+{
+	if (gVtableCacheLoaded)
+		return;
+	gVtableCacheLoaded = true;
+
+	std::wstring path = VtableCachePath();
+	std::string text;
+	FILE* file = path.empty() ? nullptr : _wfsopen(path.c_str(), L"rb", _SH_DENYNO);
+	if (file != nullptr)
+	{
+		char buffer[4096];
+		size_t read;
+		while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+			text.append(buffer, read);
+		fclose(file);
+	}
+
+	size_t entries = gVtableCache.Load(text.c_str());
+	LogInfo(L"GamePlugin: Vtable cache: %s, %d entries, %d bad lines\n",
+		(file != nullptr) ? path.c_str() : L"none", (int)entries, gVtableCache.BadLines());
+}
+
+// Written to a temp file and moved over, so another game starting at the same
+// time never reads half a file.
+
+static void SaveVtableCache()
+{
+	std::wstring path = VtableCachePath();
+	if (path.empty())
+		return;
+	std::wstring temp = path + L".tmp";
+
+	std::string text = gVtableCache.Save();
+	FILE* file = _wfsopen(temp.c_str(), L"wb", _SH_DENYWR);
+	if (file == nullptr)
+		return;
+	bool written = fwrite(text.data(), 1, text.size(), file) == text.size();
+	written = (fclose(file) == 0) && written;
+
+	if (!written || !MoveFileEx(temp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING))
+	{
+		LogInfo(L"GamePlugin: Failed to save vtable cache, err: 0x%x\n", GetLastError());
+		DeleteFile(temp.c_str());
+	}
+}
+
+// Loaded from the Windows system folder, not a wrapper dll in the game folder.
+// A wrapper like 3Dmigoto or ReShade hands out its own objects, so the address
+// we want depends on how the game is set up, not on the build of the dll.
+
+bool IsSystemModule(HMODULE module)
+{
+	wchar_t path[MAX_PATH];
+	if (module == NULL || GetModuleFileName(module, path, _countof(path)) == 0)
+		return false;
+	wchar_t* name = wcsrchr(path, L'\\');
+	if (name == nullptr)
+		return false;
+	*name = L'\0';
+
+	wchar_t system[MAX_PATH];
+	if (GetSystemDirectory(system, _countof(system)) > 0 && _wcsicmp(path, system) == 0)
+		return true;
+	return GetSystemWow64Directory(system, _countof(system)) > 0 && _wcsicmp(path, system) == 0;
+}
+
+static bool GetModuleBuild(const char* moduleName, HMODULE* module, VtableModuleBuild* build)
+{
+	*module = GetModuleHandleA(moduleName);
+	if (!IsSystemModule(*module))
+		return false;
+
+	// The headers are in the first page of a loaded image.
+	return ReadModuleBuild(reinterpret_cast<const uint8_t*>(*module), 4096, moduleName, build);
+}
+
+bool CachedVtableAddresses(const char* moduleName, VtableSlotAddress* slots, int count)
+{
+	HMODULE module;
+	VtableModuleBuild build;
+	if (!GetModuleBuild(moduleName, &module, &build))
+		return false;
+
+	std::lock_guard<std::mutex> guard(gVtableCacheLock);
+	LoadVtableCache();
+
+	for (int i = 0; i < count; i++)
+	{
+		uint32_t offset;
+		if (!gVtableCache.Find(build, slots[i].slot, &offset))
+			return false;
+		slots[i].address = reinterpret_cast<uint8_t*>(module) + offset;
+	}
+	return true;
+}
+
+// The addresses a dummy device gave us.  Only those in the module itself are
+// kept.  An overlay that already replaced the vtable entry points it into its
+// own dll, which may not be there next time.
+
+void RememberVtableAddresses(const char* moduleName, const VtableSlotAddress* slots, int count)
+{
+	HMODULE module;
+	VtableModuleBuild build;
+	if (!GetModuleBuild(moduleName, &module, &build))
+		return;
+
+	std::lock_guard<std::mutex> guard(gVtableCacheLock);
+	LoadVtableCache();
+
+	bool changed = false;
+	for (int i = 0; i < count; i++)
+	{
+		HMODULE owner = NULL;
+		GetModuleHandleEx(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+			static_cast<LPCWSTR>(slots[i].address), &owner);
+		if (owner != module)
+		{
+			LogInfo(L"  %S %S at %p is outside the module, not cached\n", moduleName, slots[i].slot, slots[i].address);
+			continue;
+		}
+		uint32_t offset = (uint32_t)(static_cast<uint8_t*>(slots[i].address) - reinterpret_cast<uint8_t*>(module));
+		changed = gVtableCache.Store(build, slots[i].slot, offset) || changed;
+	}
+
+	if (changed)
+		SaveVtableCache();
 }
 
 // --------------------------------------------------------------------------------------------------
@@ -164,11 +429,45 @@ void OpenLogFile()
 	LogFile = _wfsopen(logFilePath, L"a", _SH_DENYNO);
 	if (LogFile == NULL)
 		FatalExit(L"GamePlugin:OpenLogFile unable to open log for writing.", GetLastError());
-	setvbuf(LogFile, NULL, _IONBF, 0);
+
+	// Left as a normal buffered FILE, only the log writer thread writes to it,
+	// and it flushes once per batch of lines.
+	gAsyncLog.Start(LogFile);
 
 	LogInfo(L"\nGamePlugin C++ logging enabled.\n\n");
 }
 
+// Adds our spans to the trace the VR side started, named by the game exe, so
+// the timeline shows which game it was.  The VR side could be appending at the
+// same moment, so wait a little for it if the file is busy.
+
+static void WriteTraceFile()
+{
+	std::wstring path = KatangaFilePath(L"katanga_trace.json");
+	if (path.empty())
+		return;
+
+	char exePath[MAX_PATH] = "";
+	GetModuleFileNameA(NULL, exePath, _countof(exePath));
+	const char* exeName = strrchr(exePath, '\\');
+	exeName = (exeName != nullptr) ? exeName + 1 : exePath;
+
+	FILE* file = nullptr;
+	for (int tries = 0; file == nullptr && tries < 10; tries++)
+	{
+		file = _wfsopen(path.c_str(), L"ab", _SH_DENYWR);
+		if (file == nullptr)
+			Sleep(10);
+	}
+	bool written = gTrace.Append(file, GetCurrentProcessId(), exeName) &&
+		gFrameTrace.Append(file, GetCurrentProcessId(), exeName);
+	if (file != nullptr)
+		fclose(file);
+
+	LogInfo(L"GamePlugin: Trace written: %d, %llu spans, %llu dropped, %llu frame spans, %llu dropped\n", written,
+		gTrace.Recorded(), gTrace.Dropped(), gFrameTrace.Recorded(), gFrameTrace.Dropped());
+}
+
 // --------------------------------------------------------------------------------------------------
 //
 //1) Regardless of the functionality of the plugin, the dll must export: OnLoad, OnUnload, OnHookAdded,
@@ -190,7 +489,12 @@ using namespace Deviare2;
 
 HRESULT WINAPI OnLoad()
 {
-	OpenLogFile();
+	TraceScope("OnLoad");
+
+	{
+		TraceScope("OpenLogFile");
+		OpenLogFile();
+	}
 	
 	LogInfo(L"GamePlugin::OnLoad called\n");
 
@@ -198,7 +502,10 @@ HRESULT WINAPI OnLoad()
 	// here without the Katanga side already having created it.
 	// We will grab mutex to lock their drawing, whenever we are setting up
 	// the shared surface.
-	gSetupMutex = OpenMutex(SYNCHRONIZE, false, L"KatangaSetupMutex");
+	{
+		TraceScope("OpenMutex");
+		gSetupMutex = OpenMutex(SYNCHRONIZE, false, L"KatangaSetupMutex");
+	}
 	LogInfo(L"GamePlugin: OpenMutex called: %p\n", gSetupMutex);
 	if (gSetupMutex == NULL)
 		FatalExit(L"OnLoad: could not find KatangaSetupMutex", GetLastError());
@@ -206,14 +513,23 @@ HRESULT WINAPI OnLoad()
 
 	// This is running inside the game itself, so make sure we can use
 	// COM here.
-	::CoInitialize(NULL);
+	{
+		TraceScope("CoInitialize");
+		::CoInitialize(NULL);
+	}
 
 	// Hook the NVAPI.DLL!nvapi_QueryInterface, so that we can watch
 	// for Direct Mode by games.  ToDo: DX9 variant?
-	HookNvapiSetDriverMode();
+	{
+		TraceScope("HookNvapiSetDriverMode");
+		HookNvapiSetDriverMode();
+	}
 
 	// Setup the mapped file for IPC of the shared texture
-	CreateFileMappedIPC();
+	{
+		TraceScope("CreateFileMappedIPC");
+		CreateFileMappedIPC();
+	}
 
 	return S_OK;
 }
@@ -223,11 +539,18 @@ VOID WINAPI OnUnload()
 {
 	LogInfo(L"GamePlugin::OnUnLoad called\n");
 
+	WriteTraceFile();
+
 	LogInfo(L"GamePlugin: Unmap file for %p\n", gMappedFile);
-	if (gMappedFile != NULL)
+	if (gMappedFile != nullptr)
+		gMappedFile->Close();
+	gNotify.Close();
+	if (gStatsFile != NULL)
 	{
-		UnmapViewOfFile(gMappedView);
-		CloseHandle(gMappedFile);
+		KatangaStatsPage* stats = gStats;
+		gStats = nullptr;
+		UnmapViewOfFile(stats);
+		CloseHandle(gStatsFile);
 	}
 
 	LogInfo(L"GamePlugin: ReleaseMutex for %p\n", gSetupMutex);
@@ -242,7 +565,9 @@ VOID WINAPI OnUnload()
 	::CoUninitialize();
 
 	LogInfo(L"\nGamePlugin C++ log closed.\n\n");
+	gAsyncLog.Stop();
 	fclose(LogFile);
+	LogFile = nullptr;
 
 	return;
 }
@@ -281,11 +606,20 @@ HRESULT WINAPI OnHookAdded(__in INktHookInfo *lpHookInfo, __in DWORD dwChainInde
 	// Only hook the API the game is using.
 
 	if (wcscmp(name, L"D3D11.DLL!D3D11CreateDevice") == 0)
+	{
+		TraceScope("FindAndHookDX11Present");
 		FindAndHookDX11Present();
+	}
 	if (wcscmp(name, L"D3D9.DLL!Direct3DCreate9") == 0)
+	{
+		TraceScope("HookDirect3DCreate9");
 		HookDirect3DCreate9();
+	}
 	if (wcscmp(name, L"D3D9.DLL!Direct3DCreate9Ex") == 0)
+	{
+		TraceScope("FindAndHookDX9ExPresent");
 		FindAndHookDX9ExPresent();
+	}
 
 	return S_OK;
 }
@@ -373,7 +707,8 @@ void FatalExit(LPCWSTR errorString, HRESULT code)
 	wchar_t info[512];
 
 	swprintf_s(info, _countof(info), L" Fatal Error: %s  (0x%x)\n", errorString, code);
-	LogInfo(info);
+	LogInfo(L"%s", info);
+	gAsyncLog.Flush();
 
 	MessageBox(NULL, info, L"GamePlugin: Fatal Error", MB_OK);
 	exit(1);
@@ -30,12 +30,20 @@
 
 #include <d3d9.h>
 #include <d3d11_1.h>
+#include <dxgi1_4.h>
 
 #include <exception>
 
 #include "NktHookLib.h"
 #include "nvapi.h"
 
+#include "KatangaIPC.h"
+#include "KatangaNotify.h"
+#include "KatangaStats.h"
+#include "KatangaTrace.h"
+#include "AsyncLog.h"
+#include "FramePacer.h"
+
 
 //-----------------------------------------------------------
 // Careful with this header file.  It's used for three separate
@@ -49,15 +57,20 @@
 void FatalExit(LPCWSTR errorString, HRESULT code);
 
 extern FILE* LogFile;
+extern AsyncLog gAsyncLog;
 extern bool gDirectMode;
 
+// Only copies the format and arguments into the log ring, the formatting and
+// the file write happen on the log writer thread, so this is safe in Present.
+// The format must be a string literal, use LogInfo(L"%s", buffer) for others.
 #define LogInfo(fmt, ...) \
-	do { if (LogFile) { fwprintf(LogFile, fmt, __VA_ARGS__); fflush(LogFile);} } while (0)
+	do { if (LogFile) gAsyncLog.WriteLiteral(L"" fmt, __VA_ARGS__); } while (0)
 
 // Interface to InProc side
 void ReleaseSetupMutex();
 void CreateFileMappedIPC();
 void CaptureSetupMutex();
+bool TryCaptureSetupMutex();
 
 // DX9 - InProc_DX9.cpp
 void HookDirect3DCreate9();
@@ -92,6 +105,18 @@ struct Status
 Status::Enum FindAndHookDX9ExPresent();
 Status::Enum FindAndHookDX11Present();
 
+// Vtable addresses remembered from earlier launches, see VtableCache.h.  The
+// lookup only succeeds if every slot asked for is known for the loaded build.
+struct VtableSlotAddress
+{
+	const char* slot;
+	void* address;
+};
+
+bool IsSystemModule(HMODULE module);
+bool CachedVtableAddresses(const char* moduleName, VtableSlotAddress* slots, int count);
+void RememberVtableAddresses(const char* moduleName, const VtableSlotAddress* slots, int count);
+
 
 // These need to be declared as extern "C" so that the names are not mangled.
 // They are coming from the straight C compilation unit.  All these are 
@@ -99,6 +124,7 @@ Status::Enum FindAndHookDX11Present();
 
 // DX9
 extern "C" LPVOID lpvtbl_CreateDevice(IDirect3D9* pDX9);
+extern "C" LPVOID lpvtbl_Release_DX9(IDirect3D9* pDX9);
 extern "C" LPVOID lpvtbl_CreateTexture(IDirect3DDevice9* pDX9Device);
 extern "C" LPVOID lpvtbl_CreateCubeTexture(IDirect3DDevice9* pDX9Device);
 extern "C" LPVOID lpvtbl_CreateVolumeTexture(IDirect3DDevice9* pDX9Device);
@@ -106,6 +132,10 @@ extern "C" LPVOID lpvtbl_CreateOffscreenPlainSurface(IDirect3DDevice9* pDX9Devic
 extern "C" LPVOID lpvtbl_CreateVertexBuffer(IDirect3DDevice9* pDX9Device);
 extern "C" LPVOID lpvtbl_CreateIndexBuffer(IDirect3DDevice9* pDX9Device);
 extern "C" LPVOID lpvtbl_DrawIndexedPrimitiveUP(IDirect3DDevice9* pDX9Device);
+extern "C" LPVOID lpvtbl_LockRect_Texture(IDirect3DTexture9* pTexture);
+extern "C" LPVOID lpvtbl_UnlockRect_Texture(IDirect3DTexture9* pTexture);
+extern "C" LPVOID lpvtbl_LockRect_Surface(IDirect3DSurface9* pSurface);
+extern "C" LPVOID lpvtbl_UnlockRect_Surface(IDirect3DSurface9* pSurface);
 
 extern "C" LPVOID lpvtbl_Present_DX9(IDirect3DDevice9* pDX9Device);
 extern "C" LPVOID lpvtbl_Reset(IDirect3DDevice9* pDX9Device);
@@ -116,6 +146,7 @@ extern "C" LPVOID lpvtbl_CreateSwapChainForHwnd(IDXGIFactory2* dDXGIFactory);
 
 extern "C" LPVOID lpvtbl_Present_DX11(IDXGISwapChain* pSwapChain);
 extern "C" LPVOID lpvtbl_ResizeBuffers(IDXGISwapChain* pSwapChain);
+extern "C" LPVOID lpvtbl_ResizeBuffers1(IDXGISwapChain3* pSwapChain);
 
 
 //-----------------------------------------------------------
@@ -134,3 +165,40 @@ extern HANDLE gGameSharedHandle;
 
 extern LPVOID gMappedView;
 extern DWORD gMapSize;
+extern KatangaSharedDescriptor* gSharedDesc;
+
+// Wakes the VR side, see KatangaNotify.h.
+extern KatangaNotifyEvent gNotify;
+
+// Present hook timing, null if the stats mapping could not be created.
+extern KatangaStatsPage* gStats;
+
+// Startup spans, appended to the trace file at OnUnload, see KatangaTrace.h.
+extern KatangaTracer gTrace;
+
+// Per frame spans, like the copy in Present, in their own ring so that they
+// do not push the startup spans out.  The file gets the newest of each.
+extern KatangaTracer gFrameTrace;
+
+#define TraceScope(name) KATANGA_TRACE_SCOPE(&gTrace, name)
+#define FrameTraceScope(name) KATANGA_TRACE_SCOPE(&gFrameTrace, name)
+
+inline int64_t GetTicks()
+{
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	return now.QuadPart;
+}
+
+// For both Present hooks, at each new shared surface.  An optional cap on
+// copies per second can be set with KATANGA_MAX_COPY_HZ in the environment.
+inline void InitFramePacer(FramePacer* pacer)
+{
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+	wchar_t capEnv[16] = { 0 };
+	uint32_t maxCopyHz = 0;
+	if (GetEnvironmentVariable(L"KATANGA_MAX_COPY_HZ", capEnv, _countof(capEnv)) > 0)
+		maxCopyHz = wcstoul(capEnv, nullptr, 10);
+	pacer->Init(frequency.QuadPart, maxCopyHz);
+}
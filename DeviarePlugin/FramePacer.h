@@ -0,0 +1,127 @@
+#pragma once
+
+//-----------------------------------------------------------
+// Decides, at each game Present, whether to do the stereo copy at all.
+//
+// A game running at 200+ fps would otherwise copy a full double width frame
+// every Present, when the HMD only takes one every 11ms at 90Hz.  The VR side
+// now writes back which frameSequence it last took, and when it last looked,
+// so we can tell whether the previous copy was ever used.
+//
+// The policy is:
+//  - Until the VR side has sampled at least once, always copy.
+//  - If an optional rate cap is set, never copy faster than that.
+//  - Otherwise, only copy on the last game frame before the VR side samples
+//    again, predicted from the VR side's own period.  If the previous copy is
+//    still pending, this replaces it with the newest frame, so skipping never
+//    adds latency.  If the VR side has taken everything, we allow one more
+//    frame of margin, so that it will not go without a new frame just because
+//    the game's next frame was late.
+//  - Until both periods are known, skip only while a copy is pending.
+//
+// So copies scale with the headset rate, about two per HMD frame at most,
+// instead of with the game's rate.
+//
+// Pure arithmetic on timestamps, so it can be driven by synthetic timelines.  Times are in any tick unit, normally QPC.
+
+#include <stdint.h>
+
+class FramePacer
+{
+public:
+	// maxCopyHz of 0 means no cap.
+	void Init(int64_t ticksPerSecond, uint32_t maxCopyHz)
+	{
+		minCopyInterval = (maxCopyHz > 0) ? ticksPerSecond / maxCopyHz : 0;
+		lastPresent = 0;
+		lastCopy = 0;
+		lastConsumerSample = 0;
+		gameInterval = 0;
+		consumerPeriod = 0;
+	}
+
+	// Called at every Present, with the frameSequence we last published, and
+	// what the VR side wrote back.  consumerSampleTime of 0 means it never has.
+
+	bool ShouldCopy(int64_t now, uint64_t publishedSequence, uint64_t consumedSequence, int64_t consumerSampleTime)
+	{
+		if (lastPresent != 0)
+			gameInterval = Smooth(gameInterval, now - lastPresent);
+		lastPresent = now;
+
+		if (consumerSampleTime != lastConsumerSample)
+		{
+			if (lastConsumerSample != 0 && consumerSampleTime > lastConsumerSample)
+				consumerPeriod = Smooth(consumerPeriod, consumerSampleTime - lastConsumerSample);
+			lastConsumerSample = consumerSampleTime;
+		}
+
+		if (consumerSampleTime == 0)
+			return Copy();
+
+		if (minCopyInterval != 0 && lastCopy != 0 && now - lastCopy < minCopyInterval)
+			return Skip();
+
+		bool pending = consumedSequence < publishedSequence;
+
+		if (consumerPeriod == 0 || gameInterval == 0)
+			return pending ? Skip() : Copy();
+
+		// A quarter frame of margin for jitter in the game's frame times, and a
+		// whole extra frame if the VR side would otherwise have nothing new.
+		int64_t nextSample = consumerSampleTime + consumerPeriod;
+		int64_t margin = pending ? gameInterval / 4 : gameInterval + gameInterval / 4;
+		if (now + gameInterval + margin >= nextSample)
+			return Copy();
+
+		return Skip();
+	}
+
+	// After the copy is actually issued.  Not every Copy decision results in
+	// one, keyed mutex mode can still skip, and a copy can fail.
+	void OnCopied(int64_t now)
+	{
+		lastCopy = now;
+		copies++;
+	}
+
+	// Copies that happened, from OnCopied, and Presents the pacer skipped.
+	uint64_t Copies() const { return copies; }
+	uint64_t Skips() const { return skips; }
+
+	int64_t GameInterval() const { return gameInterval; }
+	int64_t ConsumerPeriod() const { return consumerPeriod; }
+
+private:
+	// Exponential moving average, 1/8 weight for each new sample.  The first
+	// sample is taken as is.
+	static int64_t Smooth(int64_t average, int64_t sample)
+	{
+		if (average == 0)
+			return sample;
+		return average + (sample - average) / 8;
+	}
+
+	bool Copy()
+	{
+		return true;
+	}
+
+	bool Skip()
+	{
+		skips++;
+		return false;
+	}
+
+	int64_t minCopyInterval = 0;
+
+	int64_t lastPresent = 0;
+	int64_t lastCopy = 0;
+	int64_t lastConsumerSample = 0;
+
+	int64_t gameInterval = 0;
+	int64_t consumerPeriod = 0;
+
+	uint64_t copies = 0;
+	uint64_t skips = 0;
+};
@@ -0,0 +1,122 @@
+#pragma once
+
+//-----------------------------------------------------------
+// Installs a table of vtable hooks, by group, and keeps count of them.
+//
+// Each HookEntry names one call, the lpvtbl_* accessor in Addresses.c that
+// finds its address from a live object, our Hooked_ routine, and where the
+// original goes.  Install hooks every entry of the asked for groups that is
+// not already hooked, so the same table can be installed from more than one
+// place, and a group can be added later.
+//
+// For each entry we keep how long its install took, and how many times the
+// hook was called, which each Hooked_ routine reports with Called.  The calls
+// come from any game thread, so those are atomic.
+//
+// The actual hooking goes through HookBackend, which InProc_DX9 implements
+// with nktInProc, so a fake can stand in.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <chrono>
+
+
+class HookBackend
+{
+public:
+	virtual ~HookBackend() { }
+
+	// Hooks target with detour, and stores the address to call the original.
+	virtual bool Hook(void** original, void* target, void* detour) = 0;
+};
+
+template <class TObject>
+struct HookEntry
+{
+	const wchar_t* name;
+	uint32_t groups;
+	void* (*address)(TObject* object);
+	void* detour;
+	void** original;
+};
+
+
+template <class TObject, size_t N>
+class HookSet
+{
+public:
+	// table has N entries, in the order of the indexes given to Called.
+	// Returns the number of hooks that failed.
+
+	int Install(const HookEntry<TObject>* table, TObject* object, uint32_t groups, HookBackend* backend)
+	{
+		int failed = 0;
+		for (size_t i = 0; i < N; i++)
+		{
+			const HookEntry<TObject>& entry = table[i];
+			if ((entry.groups & groups) == 0 || state[i].installed)
+				continue;
+
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			void* target = (object != nullptr) ? entry.address(object) : nullptr;
+			if (!Hook(i, entry, target, backend, start))
+				failed++;
+		}
+		return failed;
+	}
+
+	// One entry, at an address we already know, like from VtableCache.h, with
+	// no object to read it from.  Later Installs then skip it.
+
+	bool InstallAt(const HookEntry<TObject>* table, size_t index, void* target, HookBackend* backend)
+	{
+		if (state[index].installed)
+			return true;
+		return Hook(index, table[index], target, backend, std::chrono::steady_clock::now());
+	}
+
+	void Called(size_t index)
+	{
+		state[index].calls.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	bool Installed(size_t index) const { return state[index].installed; }
+	int Attempts(size_t index) const { return state[index].attempts; }
+	int64_t InstallNs(size_t index) const { return state[index].installNs; }
+	uint64_t Calls(size_t index) const { return state[index].calls.load(std::memory_order_relaxed); }
+
+	size_t InstalledCount() const
+	{
+		size_t count = 0;
+		for (size_t i = 0; i < N; i++)
+		{
+			if (state[i].installed)
+				count++;
+		}
+		return count;
+	}
+
+private:
+	bool Hook(size_t i, const HookEntry<TObject>& entry, void* target, HookBackend* backend,
+		std::chrono::steady_clock::time_point start)
+	{
+		bool ok = (target != nullptr) && backend->Hook(entry.original, target, entry.detour);
+		std::chrono::steady_clock::duration took = std::chrono::steady_clock::now() - start;
+
+		state[i].installed = ok;
+		state[i].attempts++;
+		state[i].installNs = (int64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(took).count();
+		return ok;
+	}
+
+	struct State
+	{
+		bool installed = false;
+		int attempts = 0;
+		int64_t installNs = 0;
+		std::atomic<uint64_t> calls{ 0 };
+	};
+
+	State state[N];
+};
@@ -27,15 +27,111 @@
 // --------------------------------------------------------------------------------------------------
 
 #include "DeviarePlugin.h"
+#include "SwapChainCache.h"
+#include "SharedSurfaceLifecycle.h"
+#include "KatangaKeyedMutex.h"
+#include "FramePacer.h"
+#include "CopyPlan.h"
 
+#include <chrono>
 #include <thread>
 
 
-// The surface that we copy the current stereo game frame into. It is shared.
-// It starts as a Texture so that it is created stereo, and is shared 
-// via file mapped IPC.
+// The surfaces that we copy the current stereo game frame into. They are shared.
+// They start as Textures so that they are created stereo, and are shared 
+// via file mapped IPC.  There is a ring of them, so that we never copy into
+// the one the VR side is drawing from.  gGameTexture is the one to copy into
+// this frame, and is always gGameTextures[gWriteSlot].
 
+ID3D11Texture2D* gGameTextures[kKatangaMaxSlots] = { nullptr };
 ID3D11Texture2D* gGameTexture = nullptr;
+static uint32_t gWriteSlot = 0;
+
+// The device, context and back buffer desc for each swap chain we've seen
+// Present, so that Present itself does not need to fetch them every frame.
+
+typedef SwapChainStateCache<IDXGISwapChain, ID3D11Device, ID3D11DeviceContext, D3D11_TEXTURE2D_DESC> DX11SwapChainCache;
+typedef DX11SwapChainCache::Entry SwapChainState;
+
+static DX11SwapChainCache gSwapChainCache;
+
+// Attached to each cached swap chain as private data.  DXGI holds the only
+// reference, and releases it when the swap chain is destroyed, which is our
+// cue to drop its entry, and the device and context we hold for it.  That
+// runs on whichever thread makes the game's last Release, which is its render
+// thread in every game we've seen, the same one that calls Present.
+
+// {6A2C1E4B-93D7-4F5A-8B0E-2D41C7F9A316}
+static const GUID kSwapChainWatchGuid =
+	{ 0x6a2c1e4b, 0x93d7, 0x4f5a, { 0x8b, 0x0e, 0x2d, 0x41, 0xc7, 0xf9, 0xa3, 0x16 } };
+
+class SwapChainWatch : public IUnknown
+{
+public:
+	explicit SwapChainWatch(IDXGISwapChain* swapChain) : swapChain(swapChain), refs(1) {}
+
+	HRESULT __stdcall QueryInterface(REFIID riid, void** ppvObject) override
+	{
+		if (riid != __uuidof(IUnknown))
+		{
+			*ppvObject = nullptr;
+			return E_NOINTERFACE;
+		}
+		*ppvObject = this;
+		AddRef();
+		return S_OK;
+	}
+
+	ULONG __stdcall AddRef() override
+	{
+		return InterlockedIncrement(&refs);
+	}
+
+	ULONG __stdcall Release() override
+	{
+		ULONG count = InterlockedDecrement(&refs);
+		if (count == 0)
+		{
+			gSwapChainCache.Invalidate(swapChain);
+			delete this;
+		}
+		return count;
+	}
+
+private:
+	IDXGISwapChain* swapChain;
+	LONG refs;
+};
+
+// Opt in keyed mutex mode, see KatangaKeyedMutex.h.  Set KATANGA_KEYED_MUTEX=1 in
+// the environment Katanga launches the game with.  Checked at every surface
+// creation, because that's when the textures get their MiscFlags.
+
+struct DX11SlotMutexes
+{
+	IDXGIKeyedMutex* mutexes[kKatangaMaxSlots] = { nullptr };
+
+	// WAIT_TIMEOUT and WAIT_ABANDONED are both success HRESULTs, only S_OK owns it.
+	bool TryAcquire(uint32_t slot, uint64_t key) { return mutexes[slot]->AcquireSync(key, 0) == S_OK; }
+	void Release(uint32_t slot, uint64_t key) { mutexes[slot]->ReleaseSync(key); }
+};
+
+static bool gKeyedMutex = false;
+static DX11SlotMutexes gSlotMutexes;
+static KatangaKeyedProducer<DX11SlotMutexes> gProducerKeys;
+
+// Skips the stereo copy when the VR side would never see it, see InitFramePacer.
+
+static FramePacer gPacer;
+
+// What part of the game's eyes we copy, as the VR side asked, see CopyPlan.h.
+// For anything but a full copy, the stereo blit goes into gStereoTexture at
+// the full size, and from there into the smaller shared texture.  It has a
+// second mip level and gStereoView for GenerateMips, when halving.
+
+static CopyModeNegotiator gCopyModes;
+static ID3D11Texture2D* gStereoTexture = nullptr;
+static ID3D11ShaderResourceView* gStereoView = nullptr;
 
 // --------------------------------------------------------------------------------------------------
 
@@ -121,114 +217,247 @@ ID3D11Texture2D* gGameTexture = nullptr;
 //
 // This will also rewrite the global gGameSharedHandle with a new HANDLE as
 // needed, and the Unity side is expected to notice a change and setup a new
-// drawing texture as well.  This is thus polling on the Unity side, which is
-// not ideal, but it is one call here to fetch the 4 byte HANDLE every 11ms.  
-// There does not appear to be a good way for this code to notify the C# code,
-// although using a TriggerEvent with some C# interop might work.  We'll only
-// do that work if this proves to be a problem.
+// drawing texture as well.  The lifecycle bumps the descriptor generation and
+// signals gNotify at each publish and retract, so the VR side is woken for it
+// instead of polling.
+//
+// When to create, publish, retract and release is decided by the generic
+// SharedSurfaceLifecycle, this is just the DX11 part of it.  The lifecycle
+// holds the KatangaSetupMutex around all of these, except for letting go of a
+// ring replaced for a new copy mode, once the VR side has moved off it.
 
-ID3D11Device* CreateSharedTexture(IDXGISwapChain* pSwapChain)
+class DX11SharedSurfaces : public SharedSurfaceDevice<IDXGISwapChain>
+{
+public:
+	uint32_t CreateSurfaces(IDXGISwapChain* pSwapChain, uint32_t* slotHandles, uint32_t maxSlots, SharedSurfaceDesc* surfaceDesc) override;
+	void ReleaseStaleSurfaces() override;
+
+	void BeginSetup() override { CaptureSetupMutex(); }
+	void EndSetup() override { ReleaseSetupMutex(); }
+	bool TryBeginSetup() override { return TryCaptureSetupMutex(); }
+	void NotifyConsumer() override { gNotify.Signal(); }
+	int64_t Now() override { return GetTicks(); }
+
+private:
+	// Prior set of textures, kept until the new ones are published.
+	ID3D11Texture2D* oldGameTextures[kKatangaMaxSlots] = { nullptr };
+	IDXGIKeyedMutex* oldSlotMutexes[kKatangaMaxSlots] = { nullptr };
+	ID3D11Texture2D* oldStereoTexture = nullptr;
+	ID3D11ShaderResourceView* oldStereoView = nullptr;
+};
+
+static DX11SharedSurfaces gDX11Surfaces;
+static SharedSurfaceLifecycle<IDXGISwapChain> gSurfaceLifecycle(&gDX11Surfaces);
+
+uint32_t DX11SharedSurfaces::CreateSurfaces(IDXGISwapChain* pSwapChain, uint32_t* slotHandles, uint32_t maxSlots,
+	SharedSurfaceDesc* surfaceDesc)
 {
+	TraceScope("CreateSurfaces");
+
 	HRESULT hr;
 	ID3D11Device* pDevice;
 	ID3D11Texture2D* backBuffer;
 	D3D11_TEXTURE2D_DESC desc;
-	ID3D11Texture2D* oldGameTexture;
 
-	LogInfo(L"GamePlugin:DX11 CreateSharedTexture called. gGameTexture: %p, gGameSharedHandle: %p, gMappedView: %p\n", gGameTexture, gGameSharedHandle, gMappedView);
+	LogInfo(L"GamePlugin:DX11 CreateSurfaces called. gGameTexture: %p, gGameSharedHandle: %p, gMappedView: %p\n", gGameTexture, gGameSharedHandle, gMappedView);
 
-	CaptureSetupMutex();
+	// Save possible prior usage to be disposed after we recreate.
+
+	for (uint32_t i = 0; i < kKatangaMaxSlots; i++)
 	{
-		// Save possible prior usage to be disposed after we recreate.
+		oldGameTextures[i] = gGameTextures[i];
+		oldSlotMutexes[i] = gSlotMutexes.mutexes[i];
+		gSlotMutexes.mutexes[i] = nullptr;
+	}
+	oldStereoTexture = gStereoTexture;
+	oldStereoView = gStereoView;
+	gStereoTexture = nullptr;
+	gStereoView = nullptr;
 
-		oldGameTexture = gGameTexture;
+	// It's more reliable to get the pDevice of an actual D3D11Device from
+	// the swap chain directly, because bad code like UE4 can pass in a 
+	// DXGIDevice, which is not usable here.
 
-		// It's more reliable to get the pDevice of an actual D3D11Device from
-		// the swap chain directly, because bad code like UE4 can pass in a 
-		// DXGIDevice, which is not usable here.
+	hr = pSwapChain->GetDevice(__uuidof(ID3D11Device), (void**)&pDevice);
+	if (FAILED(hr)) FatalExit(L"Failed to GetDevice", hr);
 
-		hr = pSwapChain->GetDevice(__uuidof(ID3D11Device), (void**)&pDevice);
-		if (FAILED(hr)) FatalExit(L"Failed to GetDevice", hr);
+	// Using the D3D11Device we fetched above, we also want to initialize nvidia
+	// stereo so that we can fetch the stereo backbuffer during Present.
 
-		// Using the D3D11Device we fetched above, we also want to initialize nvidia
-		// stereo so that we can fetch the stereo backbuffer during Present.
+	NvAPI_Status res = NvAPI_Initialize();
+	if (res != NVAPI_OK) FatalExit(L"NVidia driver not available.\n\nFailed to NvAPI_Initialize\n", res);
 
-		NvAPI_Status res = NvAPI_Initialize();
-		if (res != NVAPI_OK) FatalExit(L"NVidia driver not available.\n\nFailed to NvAPI_Initialize\n", res);
+	res = NvAPI_Stereo_CreateHandleFromIUnknown(pDevice, &gNVAPI);
+	if (res != NVAPI_OK) FatalExit(L"3D Vision is not enabled.\n\nFailed to NvAPI_Stereo_CreateHandleFromIUnknown\n", res);
 
-		res = NvAPI_Stereo_CreateHandleFromIUnknown(pDevice, &gNVAPI);
-		if (res != NVAPI_OK) FatalExit(L"3D Vision is not enabled.\n\nFailed to NvAPI_Stereo_CreateHandleFromIUnknown\n", res);
 
+	// Now that we have a proper SwapChain from the game, let's also make a 
+	// DX11 Texture2D, so that we can snapshot the game output. 
+	//
+	// Make it exactly match the backbuffer, which ensures that the stereo copy
+	// using ReverseStereoBlit will work.
 
-		// Now that we have a proper SwapChain from the game, let's also make a 
-		// DX11 Texture2D, so that we can snapshot the game output. 
-		//
-		// Make it exactly match the backbuffer, which ensures that the stereo copy
-		// using ReverseStereoBlit will work.
+	hr = pSwapChain->GetBuffer(0, __uuidof(ID3D11Texture2D), (void**)&backBuffer);
+	if (FAILED(hr)) FatalExit(L"Fail to get backbuffer", hr);
 
-		hr = pSwapChain->GetBuffer(0, __uuidof(ID3D11Texture2D), (void**)&backBuffer);
-		if (FAILED(hr)) FatalExit(L"Fail to get backbuffer", hr);
+	backBuffer->GetDesc(&desc);
+	backBuffer->Release();
 
-		backBuffer->GetDesc(&desc);
-		backBuffer->Release();
+	// Some games like TheSurge and Dishonored2 will specify a DXGI_FORMAT_R8G8B8A8_UNORM_SRGB
+	// as their backbuffer.  This doesn't work for us because our output is going to the VR HMD,
+	// and thus we get a doubled up sRGB/gamma curve, which makes it too dark, and the in-game
+	// slider doesn't have enough range to correct.  
+	// If we get one of these sRGB formats, we are going to strip that and return the Linear
+	// version instead, so that we avoid this problem.  This allows us to use Gamma for the Unity
+	// app itself, which matches 90% of the games, and still handle these oddball games automatically.
+
+	if (desc.Format == DXGI_FORMAT_R8G8B8A8_UNORM_SRGB)
+		desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	if (desc.Format == DXGI_FORMAT_B8G8R8A8_UNORM_SRGB)
+		desc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
+
+	// The copy the VR side asked for, as far as we can do it.  Halving needs the
+	// format to take GenerateMips, which all the usual backbuffer formats do.
+
+	UINT support = 0;
+	pDevice->CheckFormatSupport(desc.Format, &support);
+	bool filterable = (support & D3D11_FORMAT_SUPPORT_MIP_AUTOGEN) && (support & D3D11_FORMAT_SUPPORT_RENDER_TARGET);
+	CopySource copySource = { desc.Width, desc.Height, (uint32_t)desc.Format, kScaleMipHalving, filterable };
+	const CopyPlan& plan = gCopyModes.Begin(copySource, KatangaReadCopyRequest(gSharedDesc));
+
+	if (plan.NeedsIntermediate())
+	{
+		D3D11_TEXTURE2D_DESC stereoDesc = desc;
+		stereoDesc.Width *= 2;
+		stereoDesc.MipLevels = plan.NeedsMips() ? 2 : 1;
+		stereoDesc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+		stereoDesc.MiscFlags = plan.NeedsMips() ? D3D11_RESOURCE_MISC_GENERATE_MIPS : 0;
+
+		hr = pDevice->CreateTexture2D(&stereoDesc, NULL, &gStereoTexture);
+		if (FAILED(hr)) FatalExit(L"Fail to create intermediate stereo Texture", hr);
+		if (plan.NeedsMips())
+		{
+			hr = pDevice->CreateShaderResourceView(gStereoTexture, NULL, &gStereoView);
+			if (FAILED(hr)) FatalExit(L"Fail to create view of intermediate stereo Texture", hr);
+		}
+	}
+
+	LogInfo(L"  Copy mode: %d, from %dx%d at %d,%d of each eye, into %dx%d, %llu bytes per frame instead of %llu\n",
+		plan.mode, plan.source.width, plan.source.height, plan.source.x, plan.source.y, plan.width, plan.height,
+		CopyPlanBytes(plan, desc.Format), CopyPlanBytes(PlanCopy(copySource, 0), desc.Format));
 
-		// Some games like TheSurge and Dishonored2 will specify a DXGI_FORMAT_R8G8B8A8_UNORM_SRGB
-		// as their backbuffer.  This doesn't work for us because our output is going to the VR HMD,
-		// and thus we get a doubled up sRGB/gamma curve, which makes it too dark, and the in-game
-		// slider doesn't have enough range to correct.  
-		// If we get one of these sRGB formats, we are going to strip that and return the Linear
-		// version instead, so that we avoid this problem.  This allows us to use Gamma for the Unity
-		// app itself, which matches 90% of the games, and still handle these oddball games automatically.
+	// This texture needs to use the Shared flag, so that we can share it to 
+	// another Device.  Because these are all DX11 objects, the share will work.
 
-		if (desc.Format == DXGI_FORMAT_R8G8B8A8_UNORM_SRGB)
-			desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-		if (desc.Format == DXGI_FORMAT_B8G8R8A8_UNORM_SRGB)
-			desc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
+	desc.Width = plan.width;						// Double width texture for stereo.
+	desc.Height = plan.height;
+	desc.BindFlags |= D3D11_BIND_SHADER_RESOURCE;	// Must add bind flag, so SRV can be created in Unity.
+	desc.MiscFlags = D3D11_RESOURCE_MISC_SHARED;	// To be shared.
 
-		// This texture needs to use the Shared flag, so that we can share it to 
-		// another Device.  Because these are all DX11 objects, the share will work.
+	wchar_t keyedEnv[8] = { 0 };
+	gKeyedMutex = GetEnvironmentVariable(L"KATANGA_KEYED_MUTEX", keyedEnv, _countof(keyedEnv)) > 0 && keyedEnv[0] == L'1';
+	if (gKeyedMutex)
+		desc.MiscFlags = D3D11_RESOURCE_MISC_SHARED_KEYEDMUTEX;
 
-		desc.Width *= 2;								// Double width texture for stereo.
-		desc.BindFlags |= D3D11_BIND_SHADER_RESOURCE;	// Must add bind flag, so SRV can be created in Unity.
-		desc.MiscFlags = D3D11_RESOURCE_MISC_SHARED;	// To be shared. maybe D3D11_RESOURCE_MISC_SHARED_KEYEDMUTEX is better
+	LogInfo(L"  Width: %d, Height: %d, Format: %d, KeyedMutex: %d\n", desc.Width, desc.Height, desc.Format, gKeyedMutex);
 
-		LogInfo(L"  Width: %d, Height: %d, Format: %d\n", desc.Width, desc.Height, desc.Format);
+	// Make the full ring of identical textures, each with its own shared HANDLE.
 
-		hr = pDevice->CreateTexture2D(&desc, NULL, &gGameTexture);
+	for (uint32_t i = 0; i < kKatangaMaxSlots; i++)
+	{
+		hr = pDevice->CreateTexture2D(&desc, NULL, &gGameTextures[i]);
 		if (FAILED(hr)) FatalExit(L"Fail to create shared stereo Texture", hr);
 
 		// Now create the HANDLE which is used to share surfaces.  This follows the model from:
 		// https://docs.microsoft.com/en-us/windows/desktop/api/d3d11/nf-d3d11-id3d11device-opensharedresource
 
 		IDXGIResource* pDXGIResource = NULL;
+		HANDLE slotHandle = NULL;
 
-		hr = gGameTexture->QueryInterface(__uuidof(IDXGIResource), (LPVOID*)&pDXGIResource);
+		hr = gGameTextures[i]->QueryInterface(__uuidof(IDXGIResource), (LPVOID*)&pDXGIResource);
 		if (FAILED(hr))	FatalExit(L"Fail to QueryInterface on shared surface", hr);
 
-		hr = pDXGIResource->GetSharedHandle(&gGameSharedHandle);
-		if (FAILED(hr) || gGameSharedHandle == NULL)	FatalExit(L"Fail to pDXGIResource->GetSharedHandle", hr);
+		hr = pDXGIResource->GetSharedHandle(&slotHandle);
+		if (FAILED(hr) || slotHandle == NULL)	FatalExit(L"Fail to pDXGIResource->GetSharedHandle", hr);
 
 		pDXGIResource->Release();
 
-		// Move that shared handle into the MappedView to IPC the Handle to Katanga.
+		if (gKeyedMutex)
+		{
+			hr = gGameTextures[i]->QueryInterface(__uuidof(IDXGIKeyedMutex), (LPVOID*)&gSlotMutexes.mutexes[i]);
+			if (FAILED(hr))	FatalExit(L"Fail to QueryInterface IDXGIKeyedMutex on shared surface", hr);
+		}
+
 		// The HANDLE is always 32 bit, even for 64 bit processes.
 		// https://docs.microsoft.com/en-us/windows/win32/winprog64/interprocess-communication
+		slotHandles[i] = PtrToUint(slotHandle);
+
+		// Slot 0 is the one that the VR side polls for to know we are ready.
+		if (i == 0)
+			gGameSharedHandle = slotHandle;
+	}
+
+	// Always start writing into slot 0, the mailbox is reset to match.
+	gWriteSlot = 0;
+	gGameTexture = gGameTextures[gWriteSlot];
+	gProducerKeys.Reset();
 
-		*(PUINT)(gMappedView) = PtrToUint(gGameSharedHandle);
+	InitFramePacer(&gPacer);
 
-		LogInfo(L"  Successfully created new shared texture: %p, new shared handle: %p, mapped: %p\n", gGameTexture, gGameSharedHandle, gMappedView);
-		
-		// If we already had created one, let the old one go.  We do it after the recreation
-		// here fills in the prior globals, to avoid possible dead structure usage in the
-		// Unity app.
+	// The lifecycle moves those shared handles into the MappedView to IPC them
+	// to Katanga.  Along with the handles, it publishes the surface description
+	// so the VR side does not need to GetDesc to know what it's getting.
 
-		LogInfo(L"  Release stale gGameTexture: %p\n", oldGameTexture);
-		if (oldGameTexture)
-			oldGameTexture->Release();
+	surfaceDesc->width = desc.Width;
+	surfaceDesc->height = desc.Height;
+	surfaceDesc->format = desc.Format;
+	surfaceDesc->layout = kLayoutSideBySide;
+	surfaceDesc->flags = gKeyedMutex ? kKatangaSurfaceKeyedMutex : 0;
+	surfaceDesc->copyMode = plan.mode;
+	surfaceDesc->copyRect[0] = (uint16_t)plan.source.x;
+	surfaceDesc->copyRect[1] = (uint16_t)plan.source.y;
+	surfaceDesc->copyRect[2] = (uint16_t)plan.source.width;
+	surfaceDesc->copyRect[3] = (uint16_t)plan.source.height;
+	surfaceDesc->eyeWidth = (uint16_t)plan.eyeWidth;
+	surfaceDesc->eyeHeight = (uint16_t)plan.eyeHeight;
+
+	if (gStats)
+		gStats->dxVersion = 11;
+
+	LogInfo(L"  Successfully created new shared textures: %p %p %p, new shared handle: %p, mapped: %p\n", 
+		gGameTextures[0], gGameTextures[1], gGameTextures[2], gGameSharedHandle, gMappedView);
+
+	// The device was only needed for NVAPI and CreateTexture2D.
+	pDevice->Release();
+
+	return kKatangaMaxSlots;
+}
+
+// If we already had created them, let the old ones go.  We do it after the recreation
+// fills in the prior globals, and they're published, to avoid possible dead structure
+// usage in the Unity app.  After a copy mode change, that is only once the Unity app
+// has taken a frame from the new ones.
+
+void DX11SharedSurfaces::ReleaseStaleSurfaces()
+{
+	for (uint32_t i = 0; i < kKatangaMaxSlots; i++)
+	{
+		LogInfo(L"  Release stale gGameTextures[%d]: %p\n", i, oldGameTextures[i]);
+		if (oldGameTextures[i])
+			oldGameTextures[i]->Release();
+		oldGameTextures[i] = nullptr;
+
+		if (oldSlotMutexes[i])
+			oldSlotMutexes[i]->Release();
+		oldSlotMutexes[i] = nullptr;
 	}
-	ReleaseSetupMutex();
-	
-	return pDevice;
+
+	if (oldStereoView)
+		oldStereoView->Release();
+	if (oldStereoTexture)
+		oldStereoTexture->Release();
+	oldStereoView = nullptr;
+	oldStereoTexture = nullptr;
 }
 
 // --------------------------------------------------------------------------------------------------
@@ -244,6 +473,57 @@ void DrawStereoOnGame(ID3D11DeviceContext* pContext, ID3D11Texture2D* surface, I
 }
 #endif
 
+// --------------------------------------------------------------------------------------------------
+// The second half of a reduced copy, from the full size gStereoTexture into the
+// shared gGameTexture.  There's no scaling copy in DX11, so halving is done by
+// GenerateMips, and level 1 is copied out.  Each half of the surface is its own
+// copy, so a crop takes the same part of both eyes.
+
+static void CopyFromStereoTexture(ID3D11DeviceContext* pContext, const CopyPlan& plan)
+{
+	if (plan.NeedsMips())
+		pContext->GenerateMips(gStereoView);
+
+	for (UINT i = 0; i < 2; i++)
+	{
+		const CopyRect& half = plan.half[i];
+		D3D11_BOX srcBox = { half.x, half.y, 0, half.x + half.width, half.y + half.height, 1 };
+		pContext->CopySubresourceRegion(gGameTexture, 0, i * plan.destWidth, 0, 0, gStereoTexture, plan.readLevel, &srcBox);
+	}
+}
+
+// --------------------------------------------------------------------------------------------------
+// First Present for a given swap chain.  Fetch the device and context that
+// Present needs and keep the references in the cache, until the swap chain
+// is destroyed.  Returns null if the device is not available, and we'll just
+// try again next frame.
+
+static SwapChainState* CacheSwapChainState(IDXGISwapChain* pSwapChain)
+{
+	HRESULT hr;
+	ID3D11Device* pDevice = nullptr;
+	ID3D11DeviceContext* pContext = nullptr;
+
+	hr = pSwapChain->GetDevice(__uuidof(ID3D11Device), (void**)&pDevice);
+	if (FAILED(hr))
+		return nullptr;
+
+	pDevice->GetImmediateContext(&pContext);
+
+	// The watch goes on first, because replacing one left from an earlier
+	// entry for this swap chain invalidates it, and that must not be this one.
+	// If DXGI won't take it, the entry just lives until it's evicted.
+	SwapChainWatch* watch = new SwapChainWatch(pSwapChain);
+	hr = pSwapChain->SetPrivateDataInterface(kSwapChainWatchGuid, watch);
+	watch->Release();
+	if (FAILED(hr))
+		LogInfo(L"GamePlugin:DX11 could not watch swap chain: %p, hr: 0x%x\n", pSwapChain, hr);
+
+	LogInfo(L"GamePlugin:DX11 cached swap chain: %p, device: %p\n", pSwapChain, pDevice);
+
+	return gSwapChainCache.Insert(pSwapChain, pDevice, pContext);
+}
+
 //-----------------------------------------------------------
 // Interface to implement the hook for IDXGISwapChain->Present
 
@@ -268,56 +548,120 @@ HRESULT (__stdcall *pOrigPresent)(IDXGISwapChain * This,
 // If we are in DirectMode, we use SetActiveEye to fetch each eye's bits, and 
 // update the double-wide stereo surface gGameTexture.  In Automatic mode, we
 // just copy the double wide stereo backbuffer directly.
+//
+// gGameTexture is our current slot in the ring, which the VR side is not
+// looking at.  Once the copy is issued, we swap it into the mailbox and take
+// whatever slot was there for next frame, so we never wait on the VR side.
 
 HRESULT __stdcall Hooked_Present(IDXGISwapChain * This,
 	/* [in] */ UINT SyncInterval,
 	/* [in] */ UINT Flags)
 {
 	HRESULT hr;
-	ID3D11Texture2D* backBuffer = nullptr;
-	D3D11_TEXTURE2D_DESC pDesc;
-	ID3D11Device* pDevice = nullptr;
-	ID3D11DeviceContext* pContext = nullptr;
+	int64_t entry = GetTicks();
+	int64_t copied = entry;
 
 	// This only happens for first device creation, because we inject into an already
 	// setup game, and thus first thing we'll see is Present.
-	if (gGameSharedHandle == NULL)
-		CreateSharedTexture(This);
+	gSurfaceLifecycle.OnPresent(This, gSharedDesc);
 
-	hr = This->GetBuffer(0, __uuidof(ID3D11Texture2D), (void**)&backBuffer);
-	if (SUCCEEDED(hr) && gGameTexture != nullptr)
+	// The VR side wants a different copy, and has for a while.  That's new
+	// surfaces, published over the old ones once the VR side is between
+	// frames, so this may take a few Presents, but never waits on it.
+	if (gSurfaceLifecycle.IsReady() && gCopyModes.Changed(KatangaReadCopyRequest(gSharedDesc)) &&
+		gSurfaceLifecycle.Replace(This, gSharedDesc))
 	{
-		backBuffer->GetDesc(&pDesc);
-		backBuffer->GetDevice(&pDevice);
-		pDevice->GetImmediateContext(&pContext);
+		LogInfo(L"GamePlugin:DX11 copy request changed: 0x%llx, deferred: %llu\n",
+			KatangaReadCopyRequest(gSharedDesc), gSurfaceLifecycle.DeferredReplaces());
+	}
+
+	// Normal frames find the device, context and backbuffer desc already in
+	// the cache.  The backbuffer itself is still fetched every frame, and only
+	// held for this frame's copy, see SwapChainCache.h.
+	SwapChainState* state = gSwapChainCache.Find(This);
+	if (state == nullptr)
+		state = CacheSwapChainState(This);
+
+	ID3D11Texture2D* backBuffer = nullptr;
+	if (state != nullptr && FAILED(This->GetBuffer(0, __uuidof(ID3D11Texture2D), (void**)&backBuffer)))
+		backBuffer = nullptr;
+
+	// The pacer skips copies the VR side would never see.  In keyed mutex mode,
+	// if the slot is not ours yet, we skip the copy rather than wait, and keep
+	// the slot for next frame.
+	uint64_t consumedSequence;
+	int64_t consumerSampleTime;
+	KatangaReadConsumerSample(gSharedDesc, &consumedSequence, &consumerSampleTime);
+
+	if (backBuffer != nullptr && gGameTexture != nullptr &&
+		gPacer.ShouldCopy(entry, KatangaReadFrameSequence(gSharedDesc), consumedSequence, consumerSampleTime) &&
+		(!gKeyedMutex || gProducerKeys.BeginCopy(&gSlotMutexes, gWriteSlot)))
+	{
+		ID3D11DeviceContext* pContext = state->context;
+		if (!state->hasBufferDesc)
+		{
+			backBuffer->GetDesc(&state->bufferDesc);
+			state->hasBufferDesc = true;
+		}
+		const D3D11_TEXTURE2D_DESC& pDesc = state->bufferDesc;
+		const CopyPlan& plan = gCopyModes.Plan();
+
+		// A full copy goes right into the shared texture, anything less through
+		// the full size intermediate.
+		ID3D11Texture2D* stereoTarget = plan.NeedsIntermediate() ? gStereoTexture : gGameTexture;
 
 		if (gDirectMode)
 		{
 			hr = NvAPI_Stereo_SetActiveEye(gNVAPI, NVAPI_STEREO_EYE_RIGHT);
-			pContext->CopySubresourceRegion(gGameTexture, 0, 0, 0, 0, backBuffer, 0, nullptr);
+			pContext->CopySubresourceRegion(stereoTarget, 0, 0, 0, 0, backBuffer, 0, nullptr);
 
 			hr = NvAPI_Stereo_SetActiveEye(gNVAPI, NVAPI_STEREO_EYE_LEFT);
-			pContext->CopySubresourceRegion(gGameTexture, 0, pDesc.Width, 0, 0, backBuffer, 0, nullptr);
+			pContext->CopySubresourceRegion(stereoTarget, 0, pDesc.Width, 0, 0, backBuffer, 0, nullptr);
 		}
 		else
 		{
 			hr = NvAPI_Stereo_ReverseStereoBlitControl(gNVAPI, true);
 
-			pContext->CopySubresourceRegion(gGameTexture, 0, 0, 0, 0, backBuffer, 0, nullptr);
+			pContext->CopySubresourceRegion(stereoTarget, 0, 0, 0, 0, backBuffer, 0, nullptr);
 
 			hr = NvAPI_Stereo_ReverseStereoBlitControl(gNVAPI, false);
 		}
 
+		if (plan.NeedsIntermediate())
+			CopyFromStereoTexture(pContext, plan);
+
 #ifdef _DEBUG
-		DrawStereoOnGame(pContext, gGameTexture, backBuffer, pDesc.Width, pDesc.Height);
+		DrawStereoOnGame(pContext, stereoTarget, backBuffer, pDesc.Width, pDesc.Height);
 #endif
-		pContext->Release();
-		pDevice->Release();
+
+		if (gKeyedMutex)
+			gProducerKeys.EndCopy(&gSlotMutexes, gWriteSlot);
+
+		// Let the VR side know there is a fresh frame, without it needing to
+		// look at the texture itself.  The sequence goes first, so that the VR
+		// side never takes this slot and reports an older sequence as seen.
+		copied = GetTicks();
+		KatangaPublishFrame(gSharedDesc, copied);
+		bool unconsumed;
+		gWriteSlot = KatangaSwapWriteSlot(gSharedDesc, gWriteSlot, &unconsumed);
+		gProducerKeys.OnSwap(unconsumed);
+		gGameTexture = gGameTextures[gWriteSlot];
+		gPacer.OnCopied(copied);
+
+		if (KatangaFrameNotifyWanted(gSharedDesc))
+			gNotify.Signal();
 	}
-	backBuffer->Release();
+
+	if (backBuffer != nullptr)
+		backBuffer->Release();
+
+	int64_t beforeOrig = GetTicks();
 
 	HRESULT hrp = pOrigPresent(This, SyncInterval, Flags);
 
+	if (gStats)
+		KatangaRecordPresent(gStats, entry, copied, beforeOrig, GetTicks());
+
 	return hrp;
 }
 
@@ -390,26 +734,29 @@ HRESULT __stdcall Hooked_ResizeBuffers(IDXGISwapChain* This,
 	/* [in] */ DXGI_FORMAT NewFormat,
 	/* [in] */ UINT SwapChainFlags)
 {
+	TraceScope("ResizeBuffers");
+
 	HRESULT hr;
 
 	LogInfo(L"GamePlugin:Hooked_ResizeBuffers called\n");
 
 	// Grab the KatangaSetupMutex, so that the VR side will be locked out of touching
-	// any shared surfaces until we rebuild the shared surface after CreateRenderedSurface.
-	CaptureSetupMutex();
+	// any shared surfaces until we rebuild the shared surface in EndResize.
+	//
+	// As soon as we know we are setting up a new resolution, we want to set the
+	// shared handle to null, to notify the VR side that this is going away.
+	// Given the async and multi-threaded nature of these pieces in different
+	// processes, it's not clear if this will work in every case. 
+	//
+	// ToDo: We might need to keep VR and game side in sync to avoid dead texture use.
+	//
+	// No good way to properly dispose of this shared handle, we cannot CloseHandle
+	// because it's not a real handle.  Microsoft.  Geez.
+
+	gSurfaceLifecycle.BeginResize(gSharedDesc);
 	{
-		// As soon as we know we are setting up a new resolution, we want to set the
-		// gGameSharedHandle to null, to notify the VR side that this is going away.
-		// Given the async and multi-threaded nature of these pieces in different
-		// processes, it's not clear if this will work in every case. 
-		//
-		// ToDo: We might need to keep VR and game side in sync to avoid dead texture use.
-		//
-		// No good way to properly dispose of this shared handle, we cannot CloseHandle
-		// because it's not a real handle.  Microsoft.  Geez.
-
 		gGameSharedHandle = NULL;
-
+		gSwapChainCache.ForgetBufferDesc(This);
 
 		LogInfo(L"  Width: %d, Height: %d, Format: %d\n", Width, Height, NewFormat);
 
@@ -417,16 +764,55 @@ HRESULT __stdcall Hooked_ResizeBuffers(IDXGISwapChain* This,
 
 		hr = pOrigResizeBuffers(This, BufferCount, Width, Height, NewFormat, SwapChainFlags);
 		if (FAILED(hr)) FatalExit(L"Failed to IDXGISwapChain->ResizeBuffers", hr);
-
-		// For this code path, don't wait for Present to rebuild shared surface. Since VR side
-		// is locked out, go ahead and create surface here.
-		CreateSharedTexture(This);
 	}
-	ReleaseSetupMutex();
+	// For this code path, don't wait for Present to rebuild shared surface. Since VR side
+	// is locked out, go ahead and create surface here.
+	gSurfaceLifecycle.EndResize(This, gSharedDesc, SUCCEEDED(hr));
+
+	LogInfo(L"  Shared surfaces created: %llu, setup lock held: %lld ticks, VR side stale: %lld ticks, keyed mutex skips: %llu\n",
+		gSurfaceLifecycle.SurfaceCreates(), gSurfaceLifecycle.LastSetupTicks(), gSurfaceLifecycle.LastStaleTicks(),
+		gProducerKeys.Skipped());
+	LogInfo(L"  Frame pacing copies: %llu, skips: %llu, game interval: %lld ticks, VR period: %lld ticks\n",
+		gPacer.Copies(), gPacer.Skips(), gPacer.GameInterval(), gPacer.ConsumerPeriod());
 
 	return hr;
 }
 
+// --------------------------------------------------------------------------------------------------
+// Interface to implement the hook for IDXGISwapChain3->ResizeBuffers1
+
+// Only there on Win10, for games that set up multiple adapter nodes.  We
+// don't rebuild the shared surfaces here, Present sees the new size next
+// frame, but the back buffer desc we keep for Present has to go.
+
+HRESULT(__stdcall *pOrigResizeBuffers1)(IDXGISwapChain3* This,
+	/* [in] */ UINT BufferCount,
+	/* [in] */ UINT Width,
+	/* [in] */ UINT Height,
+	/* [in] */ DXGI_FORMAT Format,
+	/* [in] */ UINT SwapChainFlags,
+	/* [in] */ const UINT* pCreationNodeMask,
+	/* [in] */ IUnknown* const* ppPresentQueue) = nullptr;
+
+HRESULT __stdcall Hooked_ResizeBuffers1(IDXGISwapChain3* This,
+	/* [in] */ UINT BufferCount,
+	/* [in] */ UINT Width,
+	/* [in] */ UINT Height,
+	/* [in] */ DXGI_FORMAT Format,
+	/* [in] */ UINT SwapChainFlags,
+	/* [in] */ const UINT* pCreationNodeMask,
+	/* [in] */ IUnknown* const* ppPresentQueue)
+{
+	TraceScope("ResizeBuffers1");
+
+	LogInfo(L"GamePlugin:Hooked_ResizeBuffers1 called\n");
+	LogInfo(L"  Width: %d, Height: %d, Format: %d\n", Width, Height, Format);
+
+	gSwapChainCache.ForgetBufferDesc(This);
+
+	return pOrigResizeBuffers1(This, BufferCount, Width, Height, Format, SwapChainFlags, pCreationNodeMask, ppPresentQueue);
+}
+
 // --------------------------------------------------------------------------------------------------
 // Interface for Win10 or Win7+evilUpdate variant IDXGIFactory2->CreateSwapChainForHwnd
 // Known to be used by BatmanTelltale and recent Unity games.
@@ -598,28 +984,58 @@ void HookCreateSwapChainForHwnd(IDXGIFactory2* dDXGIFactory)
 // It is common code for both that path, and the direct path from CreateSwapChain
 // or CreateSwapChainForHwnd.
 
-void HookPresent(IDXGISwapChain* pSwapChain)
+// The hooks themselves, from the swapchain's vtable, or from the vtable cache.
+
+static void HookPresentAt(void* present, void* resizeBuffers, void* resizeBuffers1)
 {
-	// This can be called multiple times by a game, so let's be sure to
-	// only hook once.
-	if (pOrigPresent == nullptr && pSwapChain != nullptr)
-	{
 #ifdef _DEBUG 
-		nktInProc.SetEnableDebugOutput(TRUE);
+	nktInProc.SetEnableDebugOutput(TRUE);
 #endif
 
-		SIZE_T hook_id;
-		DWORD dwOsErr;
+	SIZE_T hook_id;
+	DWORD dwOsErr;
 
-		dwOsErr = nktInProc.Hook(&hook_id, (void**)&pOrigPresent,
-			lpvtbl_Present_DX11(pSwapChain), Hooked_Present, 0);
-		if (FAILED(dwOsErr))
-			LogInfo(L"Failed to hook IDXGISwapChain::Present\n");
+	dwOsErr = nktInProc.Hook(&hook_id, (void**)&pOrigPresent,
+		present, Hooked_Present, 0);
+	if (FAILED(dwOsErr))
+		LogInfo(L"Failed to hook IDXGISwapChain::Present\n");
+
+	dwOsErr = nktInProc.Hook(&hook_id, (void**)&pOrigResizeBuffers,
+		resizeBuffers, Hooked_ResizeBuffers, 0);
+	if (FAILED(dwOsErr))
+		LogInfo(L"Failed to hook IDXGISwapChain::ResizeBuffers\n");
 
-		dwOsErr = nktInProc.Hook(&hook_id, (void**)&pOrigResizeBuffers,
-			lpvtbl_ResizeBuffers(pSwapChain), Hooked_ResizeBuffers, 0);
+	// Null before Win10, where there is no IDXGISwapChain3.
+	if (resizeBuffers1 != nullptr)
+	{
+		dwOsErr = nktInProc.Hook(&hook_id, (void**)&pOrigResizeBuffers1,
+			resizeBuffers1, Hooked_ResizeBuffers1, 0);
 		if (FAILED(dwOsErr))
-			LogInfo(L"Failed to hook IDXGISwapChain::ResizeBuffers\n");
+			LogInfo(L"Failed to hook IDXGISwapChain3::ResizeBuffers1\n");
+	}
+}
+
+// ResizeBuffers1 from the swap chain's vtable, if it is an IDXGISwapChain3.
+
+static void* ResizeBuffers1Address(IDXGISwapChain* pSwapChain)
+{
+	IDXGISwapChain3* pSwapChain3 = nullptr;
+	if (FAILED(pSwapChain->QueryInterface(__uuidof(IDXGISwapChain3), (void**)&pSwapChain3)))
+		return nullptr;
+
+	void* resizeBuffers1 = lpvtbl_ResizeBuffers1(pSwapChain3);
+	pSwapChain3->Release();
+	return resizeBuffers1;
+}
+
+void HookPresent(IDXGISwapChain* pSwapChain)
+{
+	// This can be called multiple times by a game, so let's be sure to
+	// only hook once.
+	if (pOrigPresent == nullptr && pSwapChain != nullptr)
+	{
+		HookPresentAt(lpvtbl_Present_DX11(pSwapChain), lpvtbl_ResizeBuffers(pSwapChain),
+			ResizeBuffers1Address(pSwapChain));
 
 		// Create Texture2D and HANDLE we'll use to share the stereo game bits across
 		// the process boundary.
@@ -746,9 +1162,33 @@ void HookNvapiSetDriverMode()
 // 
 // This is only for the DX11 games.  Should have no impact on them to hook the DX11
 // Present call.
+//
+// All that is only done once per build of dxgi.dll.  The addresses it finds are
+// kept in the vtable cache, and the next launch hooks them straight from there.
+// That is skipped for a wrapper d3d11.dll, its swapchain is not the system one.
 
 Status::Enum FindAndHookDX11Present()
 {
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	// ResizeBuffers1 is looked up on its own, because it is never cached
+	// before Win10, and that must not keep the others from being used.
+	VtableSlotAddress slots[] = { { "Present", nullptr }, { "ResizeBuffers", nullptr } };
+	VtableSlotAddress optional[] = { { "ResizeBuffers1", nullptr } };
+	if (IsSystemModule(::GetModuleHandle(KIERO_TEXT("d3d11.dll"))) &&
+		CachedVtableAddresses("dxgi.dll", slots, _countof(slots)))
+	{
+		if (!CachedVtableAddresses("dxgi.dll", optional, _countof(optional)))
+			optional[0].address = nullptr;
+		if (pOrigPresent == nullptr)
+			HookPresentAt(slots[0].address, slots[1].address, optional[0].address);
+
+		LogInfo(L"Successfully hooked DXGI::Present from the vtable cache, in %lld us\n",
+			(long long)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+
+		return Status::Success;
+	}
+
 	WNDCLASSEX windowClass;
 	windowClass.cbSize = sizeof(WNDCLASSEX);
 	windowClass.style = CS_HREDRAW | CS_VREDRAW;
@@ -845,6 +1285,17 @@ Status::Enum FindAndHookDX11Present()
 
 	HookPresent(swapChain);
 
+	if (IsSystemModule(libD3D11))
+	{
+		slots[0].address = lpvtbl_Present_DX11(swapChain);
+		slots[1].address = lpvtbl_ResizeBuffers(swapChain);
+		RememberVtableAddresses("dxgi.dll", slots, _countof(slots));
+
+		optional[0].address = ResizeBuffers1Address(swapChain);
+		if (optional[0].address != nullptr)
+			RememberVtableAddresses("dxgi.dll", optional, _countof(optional));
+	}
+
 	// Now release all the created objects, as they were just used to get us to the vtable.
 
 	swapChain->Release();
@@ -859,7 +1310,8 @@ Status::Enum FindAndHookDX11Present()
 	::DestroyWindow(window);
 	::UnregisterClass(windowClass.lpszClassName, windowClass.hInstance);
 
-	LogInfo(L"Successfully hooked DXGI::Present\n");
+	LogInfo(L"Successfully hooked DXGI::Present, in %lld us\n",
+		(long long)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
 
 	return Status::Success;
 }
@@ -12,7 +12,7 @@
 // because D3DUSAGE_MANAGED is not supported on DX9Ex.  That then leads to
 // problems with textures when locked, requiring that they be created with
 // D3DUSAGE_DYNAMIC.  But that can't be done for rendertargets or stencils.
-// Bit of a mess.
+// Bit of a mess.  Which resources actually get that is now up to PoolPolicy.h.
 
 // Here are all the creation calls that very likely need to be hooked to
 // force them D3DUSAGE_DYNAMIC.
@@ -50,6 +50,9 @@
 // cannot be used as the target, necessitating a second copy from the game.  This is
 // a second destination of the game bits, which is the final shared resource.  This
 // is OK, because we need to swap eyes for Unity, and this is where it's done.
+//
+// That may not hold for every driver, so StereoCopyPath tries the direct copy
+// at runtime, and only drops the second copy if the result is really stereo.
 
 // Overall, seriously hard to get this all working.  Multiple problems with bad
 // and misleading and missing documentation. And no sample code.  This complicated
@@ -59,8 +62,20 @@
 //-----------------------------------------------------------
 
 #include "DeviarePlugin.h"
-
+#include "StereoCopyPath.h"
+#include "CopyPlan.h"
+#include "PoolPolicy.h"
+#include "ManagedShadow.h"
+#include "HookSet.h"
+
+#include <intrin.h>
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <shlobj_core.h>
+#include <string>
 #include <thread>
+#include <vector>
 
 
 // The surface that we copy the current game frame into. It is shared
@@ -73,6 +88,48 @@ IDirect3DSurface9* gGameSurface = nullptr;
 
 IDirect3DSurface9* gSharedTarget = nullptr;
 
+// Where StereoCopyPath probes the direct copy, so the VR side never sees a
+// probe.  Shared like gSharedTarget, because that's what decides if the copy
+// comes out stereo, but its handle is never published.  Only there while
+// probing, and goes with the other surfaces.
+static IDirect3DSurface9* gProbeSurface = nullptr;
+
+// Whether Present still needs gGameSurface, decided once per game.
+static StereoCopyPath gCopyPath;
+
+// What part of the game's eyes we copy, as the VR side asked, see CopyPlan.h.
+// Anything but a full copy always goes through gGameSurface, and is filtered
+// or cropped by the second StretchRect.
+static CopyModeNegotiator gCopyModes;
+
+// Skips the stereo copy when the VR side would never see it, see InitFramePacer.
+// With the one shared surface, a skipped copy also means one less StretchRect
+// into it while the VR side may be sampling it.
+static FramePacer gPacer;
+
+// Every IDirect3DDevice9 hook, in the order of kDX9Hooks.  Present and Reset
+// are core, needed for every game.  The creation hooks are only needed once
+// we promoted the game's DX9 to DX9Ex, which is what breaks managed resources.
+
+enum DX9Hook
+{
+	kHookPresent,
+	kHookReset,
+	kHookCreateTexture,
+	kHookCreateCubeTexture,
+	kHookCreateVolumeTexture,
+	kHookCreateOffscreenPlainSurface,
+	kHookCreateVertexBuffer,
+	kHookCreateIndexBuffer,
+	kDX9HookCount
+};
+
+const uint32_t kHookGroupCore = 0x1;
+const uint32_t kHookGroupPromoted = 0x2;
+
+static HookSet<IDirect3DDevice9, kDX9HookCount> gDX9Hooks;
+static void LogDX9Hooks();
+
 
 // --------------------------------------------------------------------------------------------------
 
@@ -152,6 +209,52 @@ IDirect3DSurface9* gSharedTarget = nullptr;
 //}
 
 
+//-----------------------------------------------------------
+// The VR side is DX11, and expects a DXGI_FORMAT in the shared descriptor.
+// Only the backbuffer formats we actually see in DX9 games are mapped, anything
+// else is published as 0, unknown, and the VR side will GetDesc instead.
+
+static uint32_t DXGIFormatFromD3D9(D3DFORMAT format)
+{
+	switch (format)
+	{
+	case D3DFMT_A8R8G8B8:		return DXGI_FORMAT_B8G8R8A8_UNORM;
+	case D3DFMT_X8R8G8B8:		return DXGI_FORMAT_B8G8R8X8_UNORM;
+	case D3DFMT_A8B8G8R8:		return DXGI_FORMAT_R8G8B8A8_UNORM;
+	case D3DFMT_A2B10G10R10:	return DXGI_FORMAT_R10G10B10A2_UNORM;
+	default:					return DXGI_FORMAT_UNKNOWN;
+	}
+}
+
+//-----------------------------------------------------------
+// The intermediate stereo texture, as a surface in gGameSurface.  Only made if
+// the StereoCopyPath has not found that the direct copy works, or the copy is
+// less than full.  Always the full double width, which with a full copy is the
+// size of gSharedTarget.  That must already exist, for the format.
+
+static HRESULT CreateIntermediateSurface(IDirect3DDevice9* pDevice9)
+{
+	D3DSURFACE_DESC desc;
+	HRESULT res = gSharedTarget->GetDesc(&desc);
+	if (FAILED(res))
+		return res;
+
+	const CopyPlan& plan = gCopyModes.Plan();
+	IDirect3DTexture9* stereoCopy = nullptr;
+	res = pDevice9->CreateTexture(plan.eyeWidth * 2, plan.eyeHeight, 0, D3DUSAGE_RENDERTARGET, desc.Format, D3DPOOL_DEFAULT,
+		&stereoCopy, nullptr);
+	if (FAILED(res))
+		return res;
+
+	// The surface keeps its texture alive, so ours can go.  It used to stay,
+	// and leaked a double width texture at every Reset.
+	res = stereoCopy->GetSurfaceLevel(0, &gGameSurface);
+	stereoCopy->Release();
+
+	LogInfo(L"  Created intermediate stereo surface: %p, result: 0x%x\n", gGameSurface, res);
+	return res;
+}
+
 //-----------------------------------------------------------
 // Common code for both initial setup, and changing of the game resolution
 // via the Reset call.  When the shared gGameSharedHandle changes
@@ -180,6 +283,8 @@ IDirect3DSurface9* gSharedTarget = nullptr;
 
 void CreateSharedRenderTarget(IDirect3DDevice9* pDevice9)
 {
+	TraceScope("CreateSharedRenderTarget");
+
 	HRESULT res;
 	IDirect3DSurface9* pBackBuffer;
 	D3DSURFACE_DESC desc;
@@ -201,19 +306,19 @@ void CreateSharedRenderTarget(IDirect3DDevice9* pDevice9)
 		if (FAILED(res)) FatalExit(L"Fail to GetDesc on BackBuffer", res);
 		pBackBuffer->Release();
 
-		UINT width = desc.Width * 2;
-		UINT height = desc.Height;
-		D3DFORMAT format = desc.Format;
-		IDirect3DTexture9* stereoCopy = nullptr;
+		// The copy the VR side asked for, as far as we can do it.  Halving needs a
+		// filtered StretchRect, which most every card has.
+		D3DCAPS9 caps;
+		bool filterable = SUCCEEDED(pDevice9->GetDeviceCaps(&caps)) && (caps.StretchRectFilterCaps & D3DPTFILTERCAPS_MINFLINEAR);
+		CopySource copySource = { desc.Width, desc.Height, DXGIFormatFromD3D9(desc.Format), kScaleStretch, filterable };
+		const CopyPlan& plan = gCopyModes.Begin(copySource, KatangaReadCopyRequest(gSharedDesc));
 
-		LogInfo(L"  Width: %d, Height: %d, Format: %d\n", width, height, format);
-
-		res = pDevice9->CreateTexture(width, height, 0, D3DUSAGE_RENDERTARGET, format, D3DPOOL_DEFAULT,
-			&stereoCopy, nullptr);
-		if (FAILED(res)) FatalExit(L"Fail to create shared stereo Texture", res);
+		UINT width = plan.width;
+		UINT height = plan.height;
+		D3DFORMAT format = desc.Format;
 
-		res = stereoCopy->GetSurfaceLevel(0, &gGameSurface);
-		if (FAILED(res)) FatalExit(L"Fail to GetSurfaceLevel of stereo Texture", res);
+		LogInfo(L"  Width: %d, Height: %d, Format: %d, Copy mode: %d, from %dx%d at %d,%d of each eye\n", width, height, format,
+			plan.mode, plan.source.width, plan.source.height, plan.source.x, plan.source.y);
 
 		// Actual shared surface, as a RenderTarget. RenderTarget because that is
 		// what the Unity side is expecting.  tempSharedHandle, to avoid kicking
@@ -222,6 +327,16 @@ void CreateSharedRenderTarget(IDirect3DDevice9* pDevice9)
 			&gSharedTarget, &tempSharedHandle);
 		if (FAILED(res)) FatalExit(L"Fail to CreateRenderTarget for copy of stereo Texture", res);
 
+		// If an earlier probe found the direct copy works, there is no need for the
+		// intermediate at all, unless this copy is less than full.
+		if (gCopyPath.NeedsIntermediate(plan))
+		{
+			res = CreateIntermediateSurface(pDevice9);
+			if (FAILED(res)) FatalExit(L"Fail to create shared stereo Texture", res);
+		}
+		gCopyPath.OnNewSurfaces();
+		InitFramePacer(&gPacer);
+
 		// Everything has been setup, or cleanly re-setup, and we can now enable the
 		// VR side to kick in and use the new surfaces.
 		gGameSharedHandle = tempSharedHandle;
@@ -229,14 +344,85 @@ void CreateSharedRenderTarget(IDirect3DDevice9* pDevice9)
 		// Move that shared handle into the MappedView to IPC the Handle to Katanga.
 		// The HANDLE is always 32 bit, even for 64 bit processes.
 		// https://docs.microsoft.com/en-us/windows/win32/winprog64/interprocess-communication
-
-		*(PUINT)(gMappedView) = PtrToUint(gGameSharedHandle);
+		// DX9 only publishes the one shared surface, so there is no mailbox ring,
+		// and the VR side always samples this one.
+
+		uint32_t slotHandle = PtrToUint(gGameSharedHandle);
+		uint16_t copyRect[4] = { (uint16_t)plan.source.x, (uint16_t)plan.source.y,
+			(uint16_t)plan.source.width, (uint16_t)plan.source.height };
+		KatangaPublishCopy(gSharedDesc, plan.mode, copyRect, (uint16_t)plan.eyeWidth, (uint16_t)plan.eyeHeight);
+		KatangaPublishSurface(gSharedDesc, &slotHandle, 1,
+			width, height, DXGIFormatFromD3D9(format), kLayoutSideBySide, 0);
+		gNotify.Signal();
+		if (gStats)
+			gStats->dxVersion = 9;
 
 		LogInfo(L"  Successfully created new shared surface: %p, new shared handle: %p, mapped: %p\n", gGameSurface, gGameSharedHandle, gMappedView);
 	}
 	ReleaseSetupMutex();
 }
 
+// As soon as we know we are setting up new surfaces, we want to set the
+// gGameSharedHandle to null, to notify the VR side that this is going away.
+// Given the async and multi-threaded nature of these pieces in different
+// processes, it's not clear if this will work in every case. 
+//
+// ToDo: We might need to keep VR and game side in sync to avoid dead texture use.
+//
+// No good way to properly dispose of this shared handle, we cannot CloseHandle
+// because it's not a real handle.  Microsoft.  Geez.
+//
+// Then the surfaces themselves go, now that the null gGameSharedHandle will
+// have stalled drawing in the VR side.  Must hold the KatangaSetupMutex.
+
+static void ReleaseSharedRenderTarget()
+{
+	TraceScope("ReleaseSharedRenderTarget");
+
+	gGameSharedHandle = NULL;
+	KatangaRetractSurface(gSharedDesc);
+	gNotify.Signal();
+
+	if (gGameSurface)
+	{
+		LogInfo(L"  Release gGameSurface: %p\n", gGameSurface);
+		gGameSurface->Release();
+		gGameSurface = NULL;
+	}
+	if (gSharedTarget)
+	{
+		LogInfo(L"  Release gSharedTarget: %p\n", gSharedTarget);
+		gSharedTarget->Release();
+		gSharedTarget = NULL;
+	}
+	if (gProbeSurface)
+	{
+		gProbeSurface->Release();
+		gProbeSurface = NULL;
+	}
+}
+
+// New surfaces for the same backbuffer, like for a new copy mode.  The same
+// as a Reset, without the Reset.  Unlike a Reset, this can wait for a better
+// moment, so it never waits on the VR side.  It returns false if the VR side
+// is mid-frame, and Present tries again next time.  Otherwise the VR side is
+// locked out from before the release until the new surface is published, and
+// its next frame opens the new one, so there is nothing left to drain.
+
+static bool RecreateSharedRenderTarget(IDirect3DDevice9* pDevice9)
+{
+	if (!TryCaptureSetupMutex())
+		return false;
+
+	TraceScope("RecreateSharedRenderTarget");
+	{
+		ReleaseSharedRenderTarget();
+		CreateSharedRenderTarget(pDevice9);
+	}
+	ReleaseSetupMutex();
+	return true;
+}
+
 //-----------------------------------------------------------
 // StretchRect the stereo snapshot back onto the backbuffer so we can see what we got.
 // Keep aspect ratio intact, because we want to see if it's a stretched image.
@@ -269,6 +455,175 @@ HRESULT (__stdcall *pOrigPresent)(IDirect3DDevice9* This,
 	) = nullptr;
 
 
+// The stereo copy for StereoCopyPath, set up with the device and backbuffer for
+// each Present.  Either way, the eyes end up swapped for Unity, right eye on the
+// left half.
+
+class DX9StereoCopy : public StereoCopyDevice
+{
+public:
+	IDirect3DDevice9* device = nullptr;
+	IDirect3DSurface9* backBuffer = nullptr;
+
+	bool CopyDirect() override
+	{
+		return SUCCEEDED(StereoBlit(gSharedTarget));
+	}
+
+	bool CopyIntermediate() override
+	{
+		if (gGameSurface == nullptr && FAILED(CreateIntermediateSurface(device)))
+			return false;
+
+		if (FAILED(StereoBlit(gGameSurface)))
+		{
+			LogInfo(L"Bad StretchRect to Texture.\n");
+			return false;
+		}
+		return SUCCEEDED(device->StretchRect(gGameSurface, nullptr, gSharedTarget, nullptr, D3DTEXF_NONE));
+	}
+
+	// The stereo blit always goes to the full size intermediate, then each half
+	// of it is cropped or filtered into its half of the smaller shared target.
+
+	bool CopyPlanned(const CopyPlan& plan) override
+	{
+		if (gGameSurface == nullptr && FAILED(CreateIntermediateSurface(device)))
+			return false;
+
+		if (FAILED(StereoBlit(gGameSurface)))
+		{
+			LogInfo(L"Bad StretchRect to Texture.\n");
+			return false;
+		}
+
+		D3DTEXTUREFILTERTYPE filter = plan.Scales() ? D3DTEXF_LINEAR : D3DTEXF_NONE;
+		for (uint32_t i = 0; i < 2; i++)
+		{
+			const CopyRect& half = plan.half[i];
+			RECT srcRect = { (LONG)half.x, (LONG)half.y, (LONG)(half.x + half.width), (LONG)(half.y + half.height) };
+			RECT destRect = { (LONG)(i * plan.destWidth), 0, (LONG)((i + 1) * plan.destWidth), (LONG)plan.destHeight };
+			if (FAILED(device->StretchRect(gGameSurface, &srcRect, gSharedTarget, &destRect, filter)))
+				return false;
+		}
+		return true;
+	}
+
+	// The scratch is the same as gSharedTarget, shared the same way, so that
+	// the copy into it behaves the same.
+
+	bool ClearScratch() override
+	{
+		if (gProbeSurface == nullptr)
+		{
+			D3DSURFACE_DESC desc;
+			HANDLE probeHandle = NULL;
+			if (FAILED(gSharedTarget->GetDesc(&desc)))
+				return false;
+
+			HRESULT hr = device->CreateRenderTarget(desc.Width, desc.Height, desc.Format, D3DMULTISAMPLE_NONE, 0, true,
+				&gProbeSurface, &probeHandle);
+			if (FAILED(hr))
+			{
+				LogInfo(L"GamePlugin:DX9 could not create probe surface, hr: 0x%x\n", hr);
+				gProbeSurface = nullptr;
+				return false;
+			}
+		}
+		return SUCCEEDED(device->ColorFill(gProbeSurface, nullptr, D3DCOLOR_ARGB(0, 0, 0, 0)));
+	}
+
+	bool CopyDirectToScratch() override
+	{
+		return SUCCEEDED(StereoBlit(gProbeSurface));
+	}
+
+	// A shared surface should not be locked, so this goes through a system
+	// memory copy.  That stalls on the GPU, which is fine for a few probes.
+
+	bool ReadScratch(const uint8_t** image, int* pitch, int* width, int* height) override
+	{
+		D3DSURFACE_DESC desc;
+		if (FAILED(gProbeSurface->GetDesc(&desc)) || DXGIFormatFromD3D9(desc.Format) == DXGI_FORMAT_UNKNOWN)
+			return false;
+
+		HRESULT hr = device->CreateOffscreenPlainSurface(desc.Width, desc.Height, desc.Format, D3DPOOL_SYSTEMMEM,
+			&readback, nullptr);
+		if (FAILED(hr))
+			return false;
+
+		D3DLOCKED_RECT locked;
+		if (FAILED(device->GetRenderTargetData(gProbeSurface, readback)) ||
+			FAILED(readback->LockRect(&locked, nullptr, D3DLOCK_READONLY)))
+		{
+			readback->Release();
+			readback = nullptr;
+			return false;
+		}
+
+		*image = (const uint8_t*)locked.pBits;
+		*pitch = locked.Pitch;
+		*width = desc.Width;
+		*height = desc.Height;
+		return true;
+	}
+
+	void EndRead() override
+	{
+		readback->UnlockRect();
+		readback->Release();
+		readback = nullptr;
+	}
+
+	void ReleaseScratch() override
+	{
+		if (gProbeSurface)
+		{
+			gProbeSurface->Release();
+			gProbeSurface = nullptr;
+		}
+	}
+
+private:
+	// Both eyes of the backbuffer, side by side into dest.  In Direct Mode we
+	// copy each eye in turn, otherwise the ReverseStereoBlit does both at once.
+
+	HRESULT StereoBlit(IDirect3DSurface9* dest)
+	{
+		HRESULT hr;
+
+		if (gDirectMode)
+		{
+			D3DSURFACE_DESC pDesc;
+			RECT destRect = { 0, 0, 0, 0 };
+
+			backBuffer->GetDesc(&pDesc);
+			destRect.bottom = pDesc.Height;
+
+			NvAPI_Stereo_SetActiveEye(gNVAPI, NVAPI_STEREO_EYE_RIGHT);
+			destRect.right = pDesc.Width;
+			hr = device->StretchRect(backBuffer, nullptr, dest, &destRect, D3DTEXF_NONE);
+			if (FAILED(hr))
+				return hr;
+
+			NvAPI_Stereo_SetActiveEye(gNVAPI, NVAPI_STEREO_EYE_LEFT);
+			destRect.left = pDesc.Width;
+			destRect.right = pDesc.Width * 2;
+			return device->StretchRect(backBuffer, nullptr, dest, &destRect, D3DTEXF_NONE);
+		}
+
+		NvAPI_Stereo_ReverseStereoBlitControl(gNVAPI, true);
+		hr = device->StretchRect(backBuffer, nullptr, dest, nullptr, D3DTEXF_NONE);
+		NvAPI_Stereo_ReverseStereoBlitControl(gNVAPI, false);
+		return hr;
+	}
+
+	IDirect3DSurface9* readback = nullptr;
+};
+
+static DX9StereoCopy gStereoCopy;
+
+
 // This is it. The one we are after.  This is the hook for the DX9 Present call
 // which the game will call for every frame.  At each call, we will make a copy
 // of whatever the game drew, and that will be passed along via the shared surface
@@ -284,57 +639,80 @@ HRESULT __stdcall Hooked_Present(IDirect3DDevice9* This,
 	/* [in] */       HWND    hDestWindowOverride,
 	/* [in] */ const RGNDATA *pDirtyRegion)
 {
+	gDX9Hooks.Called(kHookPresent);
+
 	HRESULT hr;
 	IDirect3DSurface9* backBuffer;
+	int64_t entry = GetTicks();
+	int64_t copied = entry;
 
 	// This only happens for first device creation, because we inject into an already
 	// setup game, and thus first thing we'll see is Present in DX9Ex case.
 	if (gGameSharedHandle == NULL)
 		CreateSharedRenderTarget(This);
 
-	hr = This->GetBackBuffer(0, 0, D3DBACKBUFFER_TYPE_MONO, &backBuffer);
-	if (SUCCEEDED(hr) && gGameSurface != nullptr)
+	// The VR side wants a different copy, and has for a while.  That's new
+	// surfaces, as soon as the VR side is between frames.
+	else if (gCopyModes.Changed(KatangaReadCopyRequest(gSharedDesc)) && RecreateSharedRenderTarget(This))
 	{
-		if (gDirectMode)
-		{
-			D3DSURFACE_DESC pDesc;
-			RECT destRect = { 0, 0, 0, 0 };
+		LogInfo(L"GamePlugin:DX9 copy request changed: 0x%llx\n", KatangaReadCopyRequest(gSharedDesc));
+	}
 
-			backBuffer->GetDesc(&pDesc);
-			destRect.bottom = pDesc.Height;
+	// The pacer skips copies the VR side would never see, like DX11.
+	uint64_t consumedSequence;
+	int64_t consumerSampleTime;
+	KatangaReadConsumerSample(gSharedDesc, &consumedSequence, &consumerSampleTime);
 
-			hr = NvAPI_Stereo_SetActiveEye(gNVAPI, NVAPI_STEREO_EYE_RIGHT);
-			destRect.right = pDesc.Width;
-			hr = This->StretchRect(backBuffer, nullptr, gGameSurface, &destRect, D3DTEXF_NONE);
+	hr = This->GetBackBuffer(0, 0, D3DBACKBUFFER_TYPE_MONO, &backBuffer);
+	if (SUCCEEDED(hr) && gSharedTarget != nullptr &&
+		gPacer.ShouldCopy(entry, KatangaReadFrameSequence(gSharedDesc), consumedSequence, consumerSampleTime))
+	{
+		FrameTraceScope("StereoCopy");
 
-			hr = NvAPI_Stereo_SetActiveEye(gNVAPI, NVAPI_STEREO_EYE_LEFT);
-			destRect.left = pDesc.Width;
-			destRect.right = pDesc.Width * 2;
-			hr = This->StretchRect(backBuffer, nullptr, gGameSurface, &destRect, D3DTEXF_NONE);
+		KatangaCopyPath before = gCopyPath.Path();
+		const CopyPlan& plan = gCopyModes.Plan();
 
-			hr = This->StretchRect(gGameSurface, nullptr, gSharedTarget, nullptr, D3DTEXF_NONE);
-		}
-		else
+		gStereoCopy.device = This;
+		gStereoCopy.backBuffer = backBuffer;
+		bool stereoCopied = gCopyPath.Copy(&gStereoCopy, plan);
+
+		if (gCopyPath.Path() != before)
 		{
-			hr = NvAPI_Stereo_ReverseStereoBlitControl(gNVAPI, true);
+			LogInfo(L"GamePlugin:DX9 stereo copy path: %d, after %d probes, last check: %d\n",
+				gCopyPath.Path(), gCopyPath.Probes(), gCopyPath.LastCheck());
+			if (gCopyPath.Path() == kCopyPathDirect && gGameSurface != nullptr)
 			{
-				hr = This->StretchRect(backBuffer, nullptr, gGameSurface, nullptr, D3DTEXF_NONE);
-				if (FAILED(hr))
-					LogInfo(L"Bad StretchRect to Texture.\n");
-				hr = This->StretchRect(gGameSurface, nullptr, gSharedTarget, nullptr, D3DTEXF_NONE);
-
-				//			SetEvent(gFreshBits);		// Signal other thread to start StretchRect
+				gGameSurface->Release();
+				gGameSurface = nullptr;
 			}
-			hr = NvAPI_Stereo_ReverseStereoBlitControl(gNVAPI, false);
+			if (gStats)
+				gStats->copyPath = gCopyPath.Path();
+		}
+
+		// Only a frame that made it to the shared target is published, or
+		// counted as a copy by the pacer.
+		if (stereoCopied)
+		{
+			copied = GetTicks();
+			KatangaPublishFrame(gSharedDesc, copied);
+			gPacer.OnCopied(copied);
+			if (KatangaFrameNotifyWanted(gSharedDesc))
+				gNotify.Signal();
 		}
+
 #ifdef _DEBUG
-		DrawStereoOnGame(This, gSharedTarget, backBuffer);
+		DrawStereoOnGame(This, plan.NeedsIntermediate() ? gGameSurface : gSharedTarget, backBuffer);
 #endif
 	}
 	backBuffer->Release();
 
+	int64_t beforeOrig = GetTicks();
+
 	HRESULT hrp = pOrigPresent(This, pSourceRect, pDestRect, hDestWindowOverride, pDirtyRegion);
 
+	if (gStats)
+		KatangaRecordPresent(gStats, entry, copied, beforeOrig, GetTicks());
+
 	//// Sync starting next frame with VR app.
 	//DWORD object;
 	//do
@@ -362,6 +740,9 @@ HRESULT(__stdcall *pOrigReset)(IDirect3DDevice9* This,
 HRESULT __stdcall Hooked_Reset(IDirect3DDevice9* This,
 	D3DPRESENT_PARAMETERS *pPresentationParameters)
 {
+	gDX9Hooks.Called(kHookReset);
+	TraceScope("Reset");
+
 	HRESULT hr;
 	
 	LogInfo(L"GamePlugin: IDirect3DDevice9->Reset called. gGameSurface: %p, gSharedTarget: %p, gGameSharedHandle: %p\n", 
@@ -377,42 +758,27 @@ HRESULT __stdcall Hooked_Reset(IDirect3DDevice9* This,
 
 	CaptureSetupMutex();
 	{
-		// As soon as we know we are setting up a new resolution, we want to set the
-		// gGameSharedHandle to null, to notify the VR side that this is going away.
-		// Given the async and multi-threaded nature of these pieces in different
-		// processes, it's not clear if this will work in every case. 
-		//
-		// ToDo: We might need to keep VR and game side in sync to avoid dead texture use.
-		//
-		// No good way to properly dispose of this shared handle, we cannot CloseHandle
-		// because it's not a real handle.  Microsoft.  Geez.
-
-		gGameSharedHandle = NULL;
-
-		// We are also supposed to release any of our rendertargets before calling
-		// Reset, so let's go ahead and release these, now that the null gGameSharedHandle
-		// will have stalled drawing in the VR side.  
-
-		if (gGameSurface)
-		{
-			LogInfo(L"  Release gGameSurface: %p\n", gGameSurface);
-			gGameSurface->Release();
-			gGameSurface = NULL;
-		}
-		if (gSharedTarget)
-		{
-			LogInfo(L"  Release gSharedTarget: %p\n", gSharedTarget);
-			gSharedTarget->Release();
-			gSharedTarget = NULL;
-		}
+		// Notify the VR side that the surfaces are going away.  We are also supposed
+		// to release any of our rendertargets before calling Reset, so they go too.
+
+		ReleaseSharedRenderTarget();
 
 		// Fire off the Reset.  After this is called every single texture on the
 		// device will have been released, including our shared one.  Any drawing
 		// use our shared texture can thus crash the device.
 
-		hr = pOrigReset(This, pPresentationParameters);
+		LogDX9Hooks();
+
+		{
+			TraceScope("OrigReset");
+			hr = pOrigReset(This, pPresentationParameters);
+		}
 		LogInfo(L"  IDirect3DDevice9->Reset result: %d\n", hr);
 
+		// Shadowed textures need nothing here.  They are only made on a
+		// promoted device, and DX9Ex keeps DEFAULT textures and their contents
+		// across Reset, see ManagedShadow.h.
+
 		// Remove and replace the shared texture to match new setup.
 		CreateSharedRenderTarget(This);
 	}
@@ -421,6 +787,9 @@ HRESULT __stdcall Hooked_Reset(IDirect3DDevice9* This,
 	// with no further conflicts.
 	ReleaseSetupMutex();
 
+	LogInfo(L"  Frame pacing copies: %llu, skips: %llu, game interval: %lld ticks, VR period: %lld ticks\n",
+		gPacer.Copies(), gPacer.Skips(), gPacer.GameInterval(), gPacer.ConsumerPeriod());
+
 	return hr;
 }
 
@@ -468,6 +837,111 @@ HRESULT __stdcall Hooked_Reset(IDirect3DDevice9* This,
 //}
 
 
+//-----------------------------------------------------------
+// What the creation hooks below do with the pool and usage of each resource,
+// see PoolPolicy.h.  The rules are loaded once, when we hook the device.
+
+static PoolPolicy gPoolPolicy;
+static PoolCallerCounts gPoolCallers;
+
+static_assert(kPolicyPoolDefault == D3DPOOL_DEFAULT && kPolicyPoolManaged == D3DPOOL_MANAGED &&
+	kPolicyPoolSystemMem == D3DPOOL_SYSTEMMEM, "PoolPolicy.h pools do not match d3d9.h");
+static_assert(kPolicyUsageRenderTarget == D3DUSAGE_RENDERTARGET && kPolicyUsageDepthStencil == D3DUSAGE_DEPTHSTENCIL &&
+	kPolicyUsageWriteOnly == D3DUSAGE_WRITEONLY && kPolicyUsageDynamic == D3DUSAGE_DYNAMIC, "PoolPolicy.h usages do not match d3d9.h");
+
+// The profile is PoolProfiles.ini in the same LocalLow folder as the log, or
+// the file named by KATANGA_POOL_PROFILES.  No file is normal, and leaves only
+// the built in rules.
+
+static void LoadPoolProfile()
+{
+	std::wstring path;
+	wchar_t envPath[MAX_PATH];
+	if (GetEnvironmentVariable(L"KATANGA_POOL_PROFILES", envPath, _countof(envPath)) > 0)
+	{
+		path = envPath;
+	}
+	else
+	{
+		wchar_t* localLowAppData = nullptr;
+		if (SUCCEEDED(SHGetKnownFolderPath(FOLDERID_LocalAppDataLow, 0, NULL, &localLowAppData)))
+			path = std::wstring(localLowAppData) + L"\\Katanga\\Katanga\\PoolProfiles.ini";
+		CoTaskMemFree(localLowAppData);
+	}
+
+	std::string text;
+	FILE* file = path.empty() ? nullptr : _wfsopen(path.c_str(), L"rb", _SH_DENYNO);
+	if (file != nullptr)
+	{
+		char buffer[4096];
+		size_t read;
+		while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+			text.append(buffer, read);
+		fclose(file);
+	}
+
+	char exePath[MAX_PATH] = "";
+	GetModuleFileNameA(NULL, exePath, _countof(exePath));
+	const char* exeName = strrchr(exePath, '\\');
+	exeName = (exeName != nullptr) ? exeName + 1 : exePath;
+
+	int rules = gPoolPolicy.LoadProfile(text.c_str(), exeName);
+
+	LogInfo(L"  Pool profile: %s, %d rules for %S, %d bad lines, first at line %d\n",
+		(file != nullptr) ? path.c_str() : L"none", rules, exeName, gPoolPolicy.Errors(), gPoolPolicy.FirstErrorLine());
+
+	if (gStats)
+	{
+		gStats->poolProfileRules = rules;
+		gStats->poolProfileErrors = gPoolPolicy.Errors();
+	}
+}
+
+// Runs the policy for one creation call, and rewrites Pool and Usage to match.
+// Whatever the rules say, MANAGED never gets through, it is not valid on
+// DX9Ex, and render targets or depth stencils are never made dynamic.
+//
+// Returns true if the new texture needs a system memory shadow to take its
+// Locks, see CreateShadow.
+
+static bool ApplyPoolPolicy(KatangaPoolResource resource, uint64_t size, D3DFORMAT format, void* caller,
+	D3DPOOL* pool, DWORD* usage)
+{
+	PoolRequest request = { resource, (uint32_t)*pool, *usage, (uint32_t)format, size,
+		gPoolCallers.Count((uintptr_t)caller, resource) };
+	KatangaPoolAction action = gPoolPolicy.Decide(request);
+
+	bool renderOrStencil = (*usage & (D3DUSAGE_RENDERTARGET | D3DUSAGE_DEPTHSTENCIL)) != 0;
+	bool texture = (resource == kPoolTexture || resource == kPoolCubeTexture || resource == kPoolVolumeTexture);
+	bool managed = (*pool == D3DPOOL_MANAGED);
+
+	if (action == kPoolActionPassThrough && managed)
+		action = renderOrStencil ? kPoolActionShadowed : kPoolActionDynamic;
+
+	// A plain DEFAULT texture cannot be locked, so a managed one the game may
+	// lock needs the shadow.  Only 2D textures have that, cube and volume
+	// textures stay dynamic.
+	bool shadow = (action == kPoolActionShadowed && texture && managed && !renderOrStencil);
+	if (shadow && resource != kPoolTexture)
+	{
+		action = kPoolActionDynamic;
+		shadow = false;
+	}
+
+	if (action != kPoolActionPassThrough && managed)
+		*pool = D3DPOOL_DEFAULT;
+	if (action == kPoolActionDynamic && !renderOrStencil)
+		*usage |= D3DUSAGE_DYNAMIC;
+
+	if (gStats)
+		KatangaRecordPoolDecision(gStats, resource, action);
+
+	return shadow;
+}
+
+static bool CreateShadow(IDirect3DDevice9* device, IDirect3DTexture9* texture, D3DFORMAT format);
+
+
 //-----------------------------------------------------------
 // Interface to implement the hook for IDirect3DDevice9->CreateTexture
 
@@ -505,27 +979,41 @@ HRESULT __stdcall Hooked_CreateTexture(IDirect3DDevice9* This,
 	/* [out, retval] */ IDirect3DTexture9 **ppTexture,
 	/* [in] */          HANDLE            *pSharedHandle)
 {
+	gDX9Hooks.Called(kHookCreateTexture);
+
 #ifdef _DEBUG
 		LogInfo(L"GamePlugin::Hooked_CreateTexture - Levels: %d, Usage: %x, Format: %d, Pool: %d\n",
 			Levels, Usage, Format, Pool);
 #endif
 
-	// Force Managed_Pool to always be default, the only possibility on DX9Ex.
-	// D3DPOOL_SYSTEMMEM is still valid however, and should not be tweaked.
-	if (Pool == D3DPOOL_MANAGED)
-		Pool = D3DPOOL_DEFAULT;
-
-	// Any texture not used as RenderTarget or as a DepthStencil needs to be
-	// made dynamic, otherwise we get a POOL_DEFAULT error.
-	int renderOrStencil = Usage & (D3DUSAGE_RENDERTARGET | D3DUSAGE_DEPTHSTENCIL);
-	if (!renderOrStencil)
-		Usage |= D3DUSAGE_DYNAMIC;
+	// Managed_Pool is not possible on DX9Ex, and a texture made DEFAULT for
+	// that must be dynamic to be locked, or have a shadow, unless it's a
+	// RenderTarget or DepthStencil.  The policy decides which, or leaves it alone.
+	bool shadowed = ApplyPoolPolicy(kPoolTexture, (uint64_t)Width * Height, Format, _ReturnAddress(), &Pool, &Usage);
 
 	HRESULT hr = pOrigCreateTexture(This, Width, Height, Levels, Usage, Format, Pool,
 		ppTexture, pSharedHandle);
 	if (FAILED(hr))
 		LogInfo(L"Failed to call pOrigCreateTexture\n");
 
+	// Without its shadow, the game could not lock it, so make it again as
+	// dynamic.  That counts as a second decision for the same texture.
+	if (SUCCEEDED(hr) && shadowed && !CreateShadow(This, *ppTexture, Format))
+	{
+		LogInfo(L"GamePlugin: No shadow for managed texture, format: %d, made dynamic\n", Format);
+		(*ppTexture)->Release();
+		*ppTexture = nullptr;
+
+		Usage |= D3DUSAGE_DYNAMIC;
+		if (gStats)
+			KatangaRecordPoolDecision(gStats, kPoolTexture, kPoolActionDynamic);
+
+		hr = pOrigCreateTexture(This, Width, Height, Levels, Usage, Format, Pool,
+			ppTexture, pSharedHandle);
+		if (FAILED(hr))
+			LogInfo(L"Failed to call pOrigCreateTexture\n");
+	}
+
 	return hr;
 }
 
@@ -562,21 +1050,15 @@ HRESULT __stdcall Hooked_CreateCubeTexture(IDirect3DDevice9* This,
 	/* [out, retval] */ IDirect3DCubeTexture9 **ppCubeTexture,
 	/* [in] */          HANDLE                *pSharedHandle)
 {
+	gDX9Hooks.Called(kHookCreateCubeTexture);
+
 #ifdef _DEBUG
 	LogInfo(L"GamePlugin::Hooked_CreateTexture - Levels: %d, Usage: %x, Format: %d, Pool: %d\n",
 		Levels, Usage, Format, Pool);
 #endif
 
-	// Force Managed_Pool to always be default, the only possibility on DX9Ex.
-	// D3DPOOL_SYSTEMMEM is still valid however, and should not be tweaked.
-	if (Pool == D3DPOOL_MANAGED)
-		Pool = D3DPOOL_DEFAULT;
-
-	// Any texture not used as RenderTarget or as a DepthStencil needs to be
-	// made dynamic, otherwise we get a POOL_DEFAULT error.
-	int renderOrStencil = Usage & (D3DUSAGE_RENDERTARGET | D3DUSAGE_DEPTHSTENCIL);
-	if (!renderOrStencil)
-		Usage |= D3DUSAGE_DYNAMIC;
+	// Same as CreateTexture, the size counts all six faces.
+	ApplyPoolPolicy(kPoolCubeTexture, (uint64_t)EdgeLength * EdgeLength * 6, Format, _ReturnAddress(), &Pool, &Usage);
 
 	HRESULT hr = pOrigCreateCubeTexture(This, EdgeLength, Levels, Usage, Format, Pool,
 		ppCubeTexture, pSharedHandle);
@@ -625,21 +1107,15 @@ HRESULT __stdcall Hooked_CreateVolumeTexture(IDirect3DDevice9* This,
 	IDirect3DVolumeTexture9 **ppVolumeTexture,
 	HANDLE                  *pSharedHandle)
 {
+	gDX9Hooks.Called(kHookCreateVolumeTexture);
+
 #ifdef _DEBUG
 	LogInfo(L"GamePlugin::Hooked_CreateVolumeTexture - Levels: %d, Usage: %x, Format: %d, Pool: %d\n",
 		Levels, Usage, Format, Pool);
 #endif
 
-	// Force Managed_Pool to always be default, the only possibility on DX9Ex.
-	// D3DPOOL_SYSTEMMEM is still valid however, and should not be tweaked.
-	if (Pool == D3DPOOL_MANAGED)
-		Pool = D3DPOOL_DEFAULT;
-
-	// Any texture not used as RenderTarget or as a DepthStencil needs to be
-	// made dynamic, otherwise we get a POOL_DEFAULT error.
-	int renderOrStencil = Usage & (D3DUSAGE_RENDERTARGET | D3DUSAGE_DEPTHSTENCIL);
-	if (!renderOrStencil)
-		Usage |= D3DUSAGE_DYNAMIC;
+	// Same as CreateTexture.
+	ApplyPoolPolicy(kPoolVolumeTexture, (uint64_t)Width * Height * Depth, Format, _ReturnAddress(), &Pool, &Usage);
 
 	HRESULT hr = pOrigCreateVolumeTexture(This, Width, Height, Depth, Levels, Usage, Format, Pool,
 		ppVolumeTexture, pSharedHandle);
@@ -681,6 +1157,8 @@ HRESULT __stdcall Hooked_CreateOffscreenPlainSurface(IDirect3DDevice9* This,
 	IDirect3DSurface9 **ppSurface,
 	HANDLE            *pSharedHandle)
 {
+	gDX9Hooks.Called(kHookCreateOffscreenPlainSurface);
+
 #ifdef _DEBUG
 	LogInfo(L"GamePlugin::Hooked_CreateOffscreenPlainSurface - Width: %d, Height: %x, Format: %d, Pool: %d\n",
 		Width, Height, Format, Pool);
@@ -733,18 +1211,17 @@ HRESULT __stdcall Hooked_CreateVertexBuffer(IDirect3DDevice9* This,
 	/* [out, retval] */ IDirect3DVertexBuffer9 **ppVertexBuffer,
 	/* [in] */          HANDLE                 *pSharedHandle)
 {
+	gDX9Hooks.Called(kHookCreateVertexBuffer);
+
 #ifdef _DEBUG
 		LogInfo(L"GamePlugin::Hooked_CreateVertexBuffer -  Usage: %x, Pool: %d\n",
 			Usage, Pool);
 #endif
 
-	// Force Managed_Pool to always be default, the only possibility on DX9Ex.
-	// D3DPOOL_SYSTEMMEM is still valid however, and should not be tweaked.
-	if (Pool == D3DPOOL_MANAGED)
-		Pool = D3DPOOL_DEFAULT;
-
-	// Never used as Stencil or Target, so just make it dynamic because it's default pool.
-	Usage |= D3DUSAGE_DYNAMIC;
+	// Managed_Pool is not possible on DX9Ex.  Buffers can be locked in plain
+	// DEFAULT, so the policy can leave large static ones out of the dynamic
+	// path.  FVF is not a format, so vertex buffers never match on format.
+	ApplyPoolPolicy(kPoolVertexBuffer, Length, D3DFMT_UNKNOWN, _ReturnAddress(), &Pool, &Usage);
 
 	HRESULT hr = pOrigCreateVertexBuffer(This, Length, Usage, FVF, Pool,
 		ppVertexBuffer, pSharedHandle);
@@ -783,18 +1260,15 @@ HRESULT __stdcall Hooked_CreateIndexBuffer(IDirect3DDevice9* This,
 	/* [out, retval] */ IDirect3DIndexBuffer9 **ppIndexBuffer,
 	/* [in] */          HANDLE                *pSharedHandle)
 {
+	gDX9Hooks.Called(kHookCreateIndexBuffer);
+
 #ifdef _DEBUG
 		LogInfo(L"GamePlugin::Hooked_CreateIndexBuffer -  Usage: %x, Format: %d, Pool: %d\n",
 			Usage, Format, Pool);
 #endif
 
-	// Force Managed_Pool to always be default, the only possibility on DX9Ex.
-	// D3DPOOL_SYSTEMMEM is still valid however, and should not be tweaked.
-	if (Pool == D3DPOOL_MANAGED)
-		Pool = D3DPOOL_DEFAULT;
-
-	// Never used as Stencil or Target, so just make it dynamic because it's default pool.
-	Usage |= D3DUSAGE_DYNAMIC;
+	// Same as CreateVertexBuffer.
+	ApplyPoolPolicy(kPoolIndexBuffer, Length, Format, _ReturnAddress(), &Pool, &Usage);
 
 	HRESULT hr = pOrigCreateIndexBuffer(This, Length, Usage, Format, Pool,
 		ppIndexBuffer, pSharedHandle);
@@ -805,6 +1279,425 @@ HRESULT __stdcall Hooked_CreateIndexBuffer(IDirect3DDevice9* This,
 }
 
 
+//-----------------------------------------------------------
+// Managed pool emulation for 2D textures, see ManagedShadow.h.
+//
+// Each managed texture the policy puts in plain DEFAULT gets a SYSTEMMEM
+// texture of the same size and format as its shadow.  We hook LockRect and
+// UnlockRect of textures and of surfaces, and those of a shadowed texture go
+// to its shadow instead, with the dirty rects copied up with UpdateSurface at
+// Unlock.  Everything else goes straight through.
+//
+// The shadow lives as long as the game's texture, by way of a ShadowLink set
+// as its IUnknown private data.  The runtime releases that when the texture is
+// destroyed, and the link then removes the shadow.
+
+static ManagedShadowStore gShadows;
+
+// {6B1F3C52-9D0E-4A7B-8E21-5C437A901DE6}
+static const GUID kShadowLinkGuid = { 0x6b1f3c52, 0x9d0e, 0x4a7b, { 0x8e, 0x21, 0x5c, 0x43, 0x7a, 0x90, 0x1d, 0xe6 } };
+
+class ShadowLink : public IUnknown
+{
+public:
+	ShadowLink(IDirect3DTexture9* texture) : texture(texture) { }
+
+	HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** ppvObject) override
+	{
+		if (ppvObject == nullptr)
+			return E_POINTER;
+		if (riid != IID_IUnknown)
+		{
+			*ppvObject = nullptr;
+			return E_NOINTERFACE;
+		}
+		AddRef();
+		*ppvObject = this;
+		return S_OK;
+	}
+
+	ULONG STDMETHODCALLTYPE AddRef() override
+	{
+		return InterlockedIncrement(&refs);
+	}
+
+	// Not AddRef'd, the texture is going away when this gets to zero.
+	ULONG STDMETHODCALLTYPE Release() override
+	{
+		ULONG count = InterlockedDecrement(&refs);
+		if (count == 0)
+		{
+			IDirect3DTexture9* shadow = static_cast<IDirect3DTexture9*>(gShadows.Remove(texture));
+			if (shadow)
+				shadow->Release();
+			delete this;
+		}
+		return count;
+	}
+
+private:
+	IDirect3DTexture9* texture;
+	LONG refs = 1;
+};
+
+class DX9ShadowUploader : public ShadowUploader
+{
+public:
+	bool Upload(void* shadow, void* texture, uint32_t level, const ShadowRect& rect) override
+	{
+		IDirect3DTexture9* source = static_cast<IDirect3DTexture9*>(shadow);
+		IDirect3DTexture9* dest = static_cast<IDirect3DTexture9*>(texture);
+		IDirect3DSurface9* sourceSurface = nullptr;
+		IDirect3DSurface9* destSurface = nullptr;
+		IDirect3DDevice9* device = nullptr;
+
+		HRESULT hr = source->GetSurfaceLevel(level, &sourceSurface);
+		if (SUCCEEDED(hr))
+			hr = dest->GetSurfaceLevel(level, &destSurface);
+		if (SUCCEEDED(hr))
+			hr = dest->GetDevice(&device);
+		if (SUCCEEDED(hr))
+		{
+			RECT sourceRect = { (LONG)rect.left, (LONG)rect.top, (LONG)rect.right, (LONG)rect.bottom };
+			POINT destPoint = { (LONG)rect.left, (LONG)rect.top };
+			hr = device->UpdateSurface(sourceSurface, &sourceRect, destSurface, &destPoint);
+		}
+
+		if (device)
+			device->Release();
+		if (destSurface)
+			destSurface->Release();
+		if (sourceSurface)
+			sourceSurface->Release();
+
+		return SUCCEEDED(hr);
+	}
+};
+
+static DX9ShadowUploader gShadowUploader;
+
+
+// The shadow is in SYSTEMMEM, which has no use for these, and would reject
+// DISCARD.  The runtime does not need to track dirty rects for it either,
+// we upload them ourselves.
+
+static DWORD ShadowLockFlags(DWORD Flags)
+{
+	return (Flags & ~(D3DLOCK_DISCARD | D3DLOCK_NOOVERWRITE)) | D3DLOCK_NO_DIRTY_UPDATE;
+}
+
+static ShadowRect ToShadowRect(const RECT* pRect)
+{
+	ShadowRect rect = { (uint32_t)pRect->left, (uint32_t)pRect->top, (uint32_t)pRect->right, (uint32_t)pRect->bottom };
+	return rect;
+}
+
+HRESULT(__stdcall *pOrigTextureLockRect)(IDirect3DTexture9* This,
+	UINT           Level,
+	D3DLOCKED_RECT *pLockedRect,
+	const RECT     *pRect,
+	DWORD          Flags
+	) = nullptr;
+
+HRESULT(__stdcall *pOrigTextureUnlockRect)(IDirect3DTexture9* This,
+	UINT Level
+	) = nullptr;
+
+HRESULT(__stdcall *pOrigSurfaceLockRect)(IDirect3DSurface9* This,
+	D3DLOCKED_RECT *pLockedRect,
+	const RECT     *pRect,
+	DWORD          Flags
+	) = nullptr;
+
+HRESULT(__stdcall *pOrigSurfaceUnlockRect)(IDirect3DSurface9* This
+	) = nullptr;
+
+// Shared by every texture in the game, so the common case of a texture with
+// no shadow has to stay cheap.
+
+HRESULT __stdcall Hooked_TextureLockRect(IDirect3DTexture9* This,
+	UINT           Level,
+	D3DLOCKED_RECT *pLockedRect,
+	const RECT     *pRect,
+	DWORD          Flags)
+{
+	void* shadow;
+	if (gShadows.Empty() || !gShadows.Find(This, &shadow))
+		return pOrigTextureLockRect(This, Level, pLockedRect, pRect, Flags);
+
+	HRESULT hr = pOrigTextureLockRect(static_cast<IDirect3DTexture9*>(shadow), Level, pLockedRect, pRect, ShadowLockFlags(Flags));
+	if (SUCCEEDED(hr))
+	{
+		ShadowRect rect;
+		if (pRect)
+			rect = ToShadowRect(pRect);
+		gShadows.Locked(This, Level, pRect ? &rect : nullptr, (Flags & D3DLOCK_READONLY) != 0);
+	}
+	return hr;
+}
+
+HRESULT __stdcall Hooked_TextureUnlockRect(IDirect3DTexture9* This,
+	UINT Level)
+{
+	void* shadow;
+	if (gShadows.Empty() || !gShadows.Find(This, &shadow))
+		return pOrigTextureUnlockRect(This, Level);
+
+	HRESULT hr = pOrigTextureUnlockRect(static_cast<IDirect3DTexture9*>(shadow), Level);
+	if (SUCCEEDED(hr))
+		gShadows.Unlocked(This, Level, &gShadowUploader);
+	return hr;
+}
+
+// Same for a level surface of a shadowed texture, like D3DX uses.  Locking the
+// shadow's level through its texture is the same as through its surface.
+
+HRESULT __stdcall Hooked_SurfaceLockRect(IDirect3DSurface9* This,
+	D3DLOCKED_RECT *pLockedRect,
+	const RECT     *pRect,
+	DWORD          Flags)
+{
+	void* texture;
+	void* shadow;
+	uint32_t level;
+	if (gShadows.Empty() || !gShadows.FindSurface(This, &texture, &level, &shadow))
+		return pOrigSurfaceLockRect(This, pLockedRect, pRect, Flags);
+
+	HRESULT hr = pOrigTextureLockRect(static_cast<IDirect3DTexture9*>(shadow), level, pLockedRect, pRect, ShadowLockFlags(Flags));
+	if (SUCCEEDED(hr))
+	{
+		ShadowRect rect;
+		if (pRect)
+			rect = ToShadowRect(pRect);
+		gShadows.Locked(texture, level, pRect ? &rect : nullptr, (Flags & D3DLOCK_READONLY) != 0);
+	}
+	return hr;
+}
+
+HRESULT __stdcall Hooked_SurfaceUnlockRect(IDirect3DSurface9* This)
+{
+	void* texture;
+	void* shadow;
+	uint32_t level;
+	if (gShadows.Empty() || !gShadows.FindSurface(This, &texture, &level, &shadow))
+		return pOrigSurfaceUnlockRect(This);
+
+	HRESULT hr = pOrigTextureUnlockRect(static_cast<IDirect3DTexture9*>(shadow), level);
+	if (SUCCEEDED(hr))
+		gShadows.Unlocked(texture, level, &gShadowUploader);
+	return hr;
+}
+
+// Only hooked once there is a shadowed texture, so games that never have one
+// don't pay for the Lock hooks at all.
+
+static void HookShadowLocks(IDirect3DTexture9* texture)
+{
+	static std::once_flag hooked;
+	std::call_once(hooked, [texture]()
+	{
+		SIZE_T hook_id;
+		DWORD dwOsErr;
+
+		LogInfo(L"GamePlugin: Hook LockRect and UnlockRect for managed textures.\n");
+
+		dwOsErr = nktInProc.Hook(&hook_id, (void**)&pOrigTextureLockRect,
+			lpvtbl_LockRect_Texture(texture), Hooked_TextureLockRect, 0);
+		if (FAILED(dwOsErr))
+			LogInfo(L"Failed to hook IDirect3DTexture9::LockRect\n");
+
+		dwOsErr = nktInProc.Hook(&hook_id, (void**)&pOrigTextureUnlockRect,
+			lpvtbl_UnlockRect_Texture(texture), Hooked_TextureUnlockRect, 0);
+		if (FAILED(dwOsErr))
+			LogInfo(L"Failed to hook IDirect3DTexture9::UnlockRect\n");
+
+		// The surface hooks need a surface for their vtable.  Without one they
+		// stay unhooked, and CreateShadow won't shadow anything.
+		IDirect3DSurface9* surface = nullptr;
+		HRESULT hr = texture->GetSurfaceLevel(0, &surface);
+		if (FAILED(hr) || surface == nullptr)
+		{
+			LogInfo(L"Failed to GetSurfaceLevel for IDirect3DSurface9 hooks, hr: 0x%x\n", hr);
+			return;
+		}
+
+		dwOsErr = nktInProc.Hook(&hook_id, (void**)&pOrigSurfaceLockRect,
+			lpvtbl_LockRect_Surface(surface), Hooked_SurfaceLockRect, 0);
+		if (FAILED(dwOsErr))
+			LogInfo(L"Failed to hook IDirect3DSurface9::LockRect\n");
+
+		dwOsErr = nktInProc.Hook(&hook_id, (void**)&pOrigSurfaceUnlockRect,
+			lpvtbl_UnlockRect_Surface(surface), Hooked_SurfaceUnlockRect, 0);
+		if (FAILED(dwOsErr))
+			LogInfo(L"Failed to hook IDirect3DSurface9::UnlockRect\n");
+
+		surface->Release();
+	});
+}
+
+// Makes the shadow for a new DEFAULT texture that was managed.  Returns false
+// if we can't, and then the texture must not be used as shadowed.
+
+static bool CreateShadow(IDirect3DDevice9* device, IDirect3DTexture9* texture, D3DFORMAT format)
+{
+	HookShadowLocks(texture);
+	if (pOrigTextureLockRect == nullptr || pOrigTextureUnlockRect == nullptr ||
+		pOrigSurfaceLockRect == nullptr || pOrigSurfaceUnlockRect == nullptr)
+		return false;
+
+	UINT levels = texture->GetLevelCount();
+	if (levels > ManagedShadowStore::kMaxLevels)
+		return false;
+
+	D3DSURFACE_DESC desc;
+	uint32_t widths[ManagedShadowStore::kMaxLevels];
+	uint32_t heights[ManagedShadowStore::kMaxLevels];
+	for (UINT i = 0; i < levels; i++)
+	{
+		if (FAILED(texture->GetLevelDesc(i, &desc)))
+			return false;
+		widths[i] = desc.Width;
+		heights[i] = desc.Height;
+	}
+
+	IDirect3DTexture9* shadow = nullptr;
+	HRESULT hr = pOrigCreateTexture(device, widths[0], heights[0], levels, 0, format, D3DPOOL_SYSTEMMEM, &shadow, nullptr);
+	if (FAILED(hr))
+		return false;
+
+	gShadows.Add(texture, shadow, levels, widths, heights);
+	for (UINT i = 0; i < levels; i++)
+	{
+		IDirect3DSurface9* surface;
+		if (SUCCEEDED(texture->GetSurfaceLevel(i, &surface)))
+		{
+			gShadows.AddSurface(surface, texture, i);
+			surface->Release();
+		}
+	}
+
+	// The texture takes its own reference to the link, ours goes either way.  If
+	// it didn't take it, the link removes the shadow right here.
+	ShadowLink* link = new ShadowLink(texture);
+	hr = texture->SetPrivateData(kShadowLinkGuid, static_cast<IUnknown*>(link), sizeof(IUnknown*), D3DSPD_IUNKNOWN);
+	link->Release();
+
+	return SUCCEEDED(hr);
+}
+
+
+//-----------------------------------------------------------
+// The table of IDirect3DDevice9 hooks for gDX9Hooks, in DX9Hook order, each
+// with its accessor from Addresses.c.
+
+static const HookEntry<IDirect3DDevice9> kDX9Hooks[kDX9HookCount] =
+{
+	{ L"Present", kHookGroupCore, lpvtbl_Present_DX9, (void*)Hooked_Present, (void**)&pOrigPresent },
+	{ L"Reset", kHookGroupCore, lpvtbl_Reset, (void*)Hooked_Reset, (void**)&pOrigReset },
+	{ L"CreateTexture", kHookGroupPromoted, lpvtbl_CreateTexture, (void*)Hooked_CreateTexture, (void**)&pOrigCreateTexture },
+	{ L"CreateCubeTexture", kHookGroupPromoted, lpvtbl_CreateCubeTexture, (void*)Hooked_CreateCubeTexture, (void**)&pOrigCreateCubeTexture },
+	{ L"CreateVolumeTexture", kHookGroupPromoted, lpvtbl_CreateVolumeTexture, (void*)Hooked_CreateVolumeTexture, (void**)&pOrigCreateVolumeTexture },
+	{ L"CreateOffscreenPlainSurface", kHookGroupPromoted, lpvtbl_CreateOffscreenPlainSurface, (void*)Hooked_CreateOffscreenPlainSurface, (void**)&pOrigCreateOffscreenPlainSurface },
+	{ L"CreateVertexBuffer", kHookGroupPromoted, lpvtbl_CreateVertexBuffer, (void*)Hooked_CreateVertexBuffer, (void**)&pOrigCreateVertexBuffer },
+	{ L"CreateIndexBuffer", kHookGroupPromoted, lpvtbl_CreateIndexBuffer, (void*)Hooked_CreateIndexBuffer, (void**)&pOrigCreateIndexBuffer },
+};
+
+class InProcHookBackend : public HookBackend
+{
+public:
+	bool Hook(void** original, void* target, void* detour) override
+	{
+		SIZE_T hook_id;
+		DWORD dwOsErr = nktInProc.Hook(&hook_id, original, target, detour, 0);
+		return SUCCEEDED(dwOsErr);
+	}
+};
+
+static void InstallDX9Hooks(IDirect3DDevice9* pDevice9, uint32_t groups)
+{
+	InProcHookBackend backend;
+	gDX9Hooks.Install(kDX9Hooks, pDevice9, groups, &backend);
+
+	for (int i = 0; i < kDX9HookCount; i++)
+	{
+		if ((kDX9Hooks[i].groups & groups) == 0)
+			continue;
+		if (gDX9Hooks.Installed(i))
+			LogInfo(L"  Hooked IDirect3DDevice9::%s in %lld us\n", kDX9Hooks[i].name, gDX9Hooks.InstallNs(i) / 1000);
+		else
+			LogInfo(L"Failed to hook IDirect3DDevice9::%s\n", kDX9Hooks[i].name);
+	}
+}
+
+// The core hooks at the addresses the vtable cache has for this d3d9.dll, see
+// FindAndHookDX9ExPresent.  Returns false if it has nothing for this build.
+
+static bool InstallCachedDX9Hooks()
+{
+	VtableSlotAddress slots[] = { { "Present", nullptr }, { "Reset", nullptr } };
+	if (!CachedVtableAddresses("d3d9.dll", slots, _countof(slots)))
+		return false;
+
+	InProcHookBackend backend;
+	const DX9Hook hooks[] = { kHookPresent, kHookReset };
+	for (size_t i = 0; i < _countof(hooks); i++)
+	{
+		if (gDX9Hooks.InstallAt(kDX9Hooks, hooks[i], slots[i].address, &backend))
+			LogInfo(L"  Hooked IDirect3DDevice9::%s from the vtable cache\n", kDX9Hooks[hooks[i]].name);
+		else
+			LogInfo(L"Failed to hook IDirect3DDevice9::%s\n", kDX9Hooks[hooks[i]].name);
+	}
+	return true;
+}
+
+static void LogDX9Hooks()
+{
+	LogInfo(L"  DX9 hooks installed: %d of %d\n", (int)gDX9Hooks.InstalledCount(), kDX9HookCount);
+	for (int i = 0; i < kDX9HookCount; i++)
+	{
+		if (gDX9Hooks.Installed(i))
+			LogInfo(L"    %s: %llu calls\n", kDX9Hooks[i].name, gDX9Hooks.Calls(i));
+	}
+}
+
+// The IDirect3D9Ex objects we made in place of the game's IDirect3D9.  Only
+// devices created from one of those need the creation hooks.  A game that
+// asks for DX9Ex itself already creates its resources to suit.
+//
+// Each one is dropped at its last Release, see Hooked_Release_DX9, so that a
+// later IDirect3D9 the game makes at the same address is not taken for one.
+
+static std::mutex gPromotedLock;
+static std::vector<IDirect3D9*> gPromoted;
+
+static void AddPromoted(IDirect3D9* pDX9)
+{
+	std::lock_guard<std::mutex> lock(gPromotedLock);
+	gPromoted.push_back(pDX9);
+}
+
+static bool IsPromoted(IDirect3D9* pDX9)
+{
+	std::lock_guard<std::mutex> lock(gPromotedLock);
+	return std::find(gPromoted.begin(), gPromoted.end(), pDX9) != gPromoted.end();
+}
+
+// Every IDirect3D9 shares this, promoted or not, and it's rarely called.  The
+// original runs under the lock, so that no new object can be made and added
+// at the freed address before its entry is gone.
+
+ULONG(__stdcall *pOrigRelease_DX9)(IDirect3D9* This) = nullptr;
+
+ULONG __stdcall Hooked_Release_DX9(IDirect3D9* This)
+{
+	std::lock_guard<std::mutex> lock(gPromotedLock);
+	ULONG count = pOrigRelease_DX9(This);
+	if (count == 0)
+		gPromoted.erase(std::remove(gPromoted.begin(), gPromoted.end(), This), gPromoted.end());
+	return count;
+}
+
+
 //-----------------------------------------------------------
 // Interface to implement the hook for IDirect3D9->CreateDevice
 
@@ -838,6 +1731,8 @@ HRESULT __stdcall Hooked_CreateDevice(IDirect3D9* This,
 	/* [in, out] */     D3DPRESENT_PARAMETERS *pPresentationParameters,
 	/* [out, retval] */ IDirect3DDevice9      **ppReturnedDeviceInterface)
 {
+	TraceScope("CreateDevice");
+
 	HRESULT hr;
 
 	LogInfo(L"\nGamePlugin::Hooked_CreateDevice called\n");
@@ -880,54 +1775,24 @@ HRESULT __stdcall Hooked_CreateDevice(IDirect3D9* This,
 
 		LogInfo(L"  IDirect3D9->CreateDevice result: %d, device: %p\n", hr, pDevice9);
 
-		if (pOrigPresent == nullptr && SUCCEEDED(hr) && pDevice9 != nullptr)
+		// Present and Reset for any device, and the creation hooks only if we
+		// made this DX9Ex behind the game's back.  Those are the same vtable for
+		// every device, so each is only hooked once, and a later promoted device
+		// adds the creation hooks if the first one didn't need them.
+		bool firstDevice = (pOrigPresent == nullptr);
+		bool promoted = IsPromoted(This);
+		if (SUCCEEDED(hr) && pDevice9 != nullptr && gDX9Hooks.InstalledCount() < kDX9HookCount)
 		{
-			SIZE_T hook_id;
-			DWORD dwOsErr;
-
-			LogInfo(L"  Create hooks for all DX9 calls.\n");
-
-			dwOsErr = nktInProc.Hook(&hook_id, (void**)&pOrigPresent,
-				lpvtbl_Present_DX9(pDevice9), Hooked_Present, 0);
-			if (FAILED(dwOsErr))
-				LogInfo(L"Failed to hook IDirect3DDevice9::Present\n");
-
-			dwOsErr = nktInProc.Hook(&hook_id, (void**)&pOrigReset,
-				lpvtbl_Reset(pDevice9), Hooked_Reset, 0);
-			if (FAILED(dwOsErr))
-				LogInfo(L"Failed to hook IDirect3DDevice9::Reset\n");
-
-			dwOsErr = nktInProc.Hook(&hook_id, (void**)&pOrigCreateTexture,
-				lpvtbl_CreateTexture(pDevice9), Hooked_CreateTexture, 0);
-			if (FAILED(dwOsErr))
-				LogInfo(L"Failed to hook IDirect3DDevice9::CreateTexture\n");
-
-			dwOsErr = nktInProc.Hook(&hook_id, (void**)&pOrigCreateCubeTexture,
-				lpvtbl_CreateCubeTexture(pDevice9), Hooked_CreateCubeTexture, 0);
-			if (FAILED(dwOsErr))
-				LogInfo(L"Failed to hook IDirect3DDevice9::CreateCubeTexture\n");
-
-			dwOsErr = nktInProc.Hook(&hook_id, (void**)&pOrigCreateVolumeTexture,
-				lpvtbl_CreateVolumeTexture(pDevice9), Hooked_CreateVolumeTexture, 0);
-			if (FAILED(dwOsErr))
-				LogInfo(L"Failed to hook IDirect3DDevice9::CreateVolumeTexture\n");
-
-			dwOsErr = nktInProc.Hook(&hook_id, (void**)&pOrigCreateOffscreenPlainSurface,
-				lpvtbl_CreateOffscreenPlainSurface(pDevice9), Hooked_CreateOffscreenPlainSurface, 0);
-			if (FAILED(dwOsErr))
-				LogInfo(L"Failed to hook IDirect3DDevice9::CreateOffscreenPlainSurface\n");
+			LogInfo(L"  Create hooks for DX9 calls, promoted: %d\n", promoted);
 
-			dwOsErr = nktInProc.Hook(&hook_id, (void**)&pOrigCreateVertexBuffer,
-				lpvtbl_CreateVertexBuffer(pDevice9), Hooked_CreateVertexBuffer, 0);
-			if (FAILED(dwOsErr))
-				LogInfo(L"Failed to hook IDirect3DDevice9::CreateVertexBuffer\n");
-
-			dwOsErr = nktInProc.Hook(&hook_id, (void**)&pOrigCreateIndexBuffer,
-				lpvtbl_CreateIndexBuffer(pDevice9), Hooked_CreateIndexBuffer, 0);
-			if (FAILED(dwOsErr))
-				LogInfo(L"Failed to hook IDirect3DDevice9::CreateIndexBuffer\n");
+			if (promoted && !gDX9Hooks.Installed(kHookCreateTexture))
+				LoadPoolProfile();
 
+			InstallDX9Hooks(pDevice9, promoted ? (kHookGroupCore | kHookGroupPromoted) : kHookGroupCore);
+		}
 
+		if (firstDevice && SUCCEEDED(hr) && pDevice9 != nullptr)
+		{
 			NvAPI_Status res = NvAPI_Initialize();
 			if (res != NVAPI_OK) FatalExit(L"NVidia driver not available.\n\nFailed to NvAPI_Initialize\n", res);
 
@@ -1027,6 +1892,13 @@ void HookCreateDevice(IDirect3D9Ex* pDX9Ex)
 			lpvtbl_CreateDevice(pDX9Ex), Hooked_CreateDevice, 0);
 
 		if (FAILED(dwOsErr)) FatalExit(L"Failed to hook IDirect3D9::CreateDevice", dwOsErr);
+
+		// Without it we are only back to entries that are never dropped, so
+		// carry on if it fails.
+		dwOsErr = nktInProc.Hook(&hook_id, (void**)&pOrigRelease_DX9,
+			lpvtbl_Release_DX9(pDX9Ex), Hooked_Release_DX9, 0);
+		if (FAILED(dwOsErr))
+			LogInfo(L"Failed to hook IDirect3D9::Release: %d\n", dwOsErr);
 	}
 }
 
@@ -1046,6 +1918,8 @@ IDirect3D9* __stdcall Hooked_Direct3DCreate9(
 	HRESULT hr = Direct3DCreate9Ex(SDKVersion, &pDX9Ex);
 	if (FAILED(hr)) FatalExit(L"Failed Direct3DCreate9Ex", hr);
 
+	AddPromoted(pDX9Ex);
+
 	// Hook the next level of CreateDevice so that ultimately we
 	// can get to the SwapChain->Present.
 
@@ -1118,9 +1992,22 @@ void HookDirect3DCreate9()
 // not daisychain to find it.  This lets us do the late-binding approach where the game can
 // fully launch before start to create the shared texture.  Bypasses launchers, and makes it 
 // more reliable.
+//
+// Like FindAndHookDX11Present, the dummy device is only made once per build of
+// d3d9.dll, after that the addresses come from the vtable cache.
 
 Status::Enum FindAndHookDX9ExPresent()
 {
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	if (InstallCachedDX9Hooks())
+	{
+		LogInfo(L"Successfully hooked IDirect3DDevice9Ex::Present from the vtable cache, in %lld us\n",
+			(long long)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+
+		return Status::Success;
+	}
+
 	WNDCLASSEX windowClass;
 	windowClass.cbSize = sizeof(WNDCLASSEX);
 	windowClass.style = CS_HREDRAW | CS_VREDRAW;
@@ -1207,16 +2094,11 @@ Status::Enum FindAndHookDX9ExPresent()
 
 	LogInfo(L"  IDirect3D9Ex->CreateDevice result: %d, device9Ex: %p, device9: %p\n", hr, pDevice9Ex, pDevice9);
 
-	SIZE_T hook_id;
-	DWORD dwOsErr;
-	dwOsErr = nktInProc.Hook(&hook_id, (void**)&pOrigPresent,
-		lpvtbl_Present_DX9(pDevice9), Hooked_Present, 0);
-	if (FAILED(dwOsErr))
-		LogInfo(L"Failed to hook IDirect3DDevice9Ex::Present\n");
-	dwOsErr = nktInProc.Hook(&hook_id, (void**)&pOrigReset,
-		lpvtbl_Reset(pDevice9), Hooked_Reset, 0);
-	if (FAILED(dwOsErr))
-		LogInfo(L"Failed to hook IDirect3DDevice9::Reset\n");
+	// The game made its own DX9Ex, so it never had managed resources to fix.
+	InstallDX9Hooks(pDevice9, kHookGroupCore);
+
+	VtableSlotAddress slots[] = { { "Present", lpvtbl_Present_DX9(pDevice9) }, { "Reset", lpvtbl_Reset(pDevice9) } };
+	RememberVtableAddresses("d3d9.dll", slots, _countof(slots));
 
 
 	// Now release all the created objects, as they were just used to get us to the vtable.
@@ -1229,7 +2111,8 @@ Status::Enum FindAndHookDX9ExPresent()
 	::DestroyWindow(window);
 	::UnregisterClass(windowClass.lpszClassName, windowClass.hInstance);
 
-	LogInfo(L"Successfully hooked IDirect3DDevice9Ex::Present\n");
+	LogInfo(L"Successfully hooked IDirect3DDevice9Ex::Present, in %lld us\n",
+		(long long)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
 
 	return Status::Success;
 }
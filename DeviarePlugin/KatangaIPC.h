@@ -0,0 +1,483 @@
+#pragma once
+
+//-----------------------------------------------------------
+// Layout of the Local\KatangaMappedFile shared memory block.
+//
+// This header is shared between the game side GamePlugin, which creates the
+// mapping, and the UnityNativePlugin on the VR side.  It is included by both
+// projects, so it must not pull in any Windows or DirectX headers.  Only fixed
+// size types are used, so that a x32 game and the x64 Katanga app see the
+// exact same layout.
+//
+// Each field has one writer, except the mailbox:
+//   - The game side writes the surface description, handles and copy info at
+//     setup, setupSequence around each rebuild, and frameSequence,
+//     presentTimestamp and generation on every Present.
+//   - The VR side writes consumerBusy, consumedSequence, consumerSampleTime,
+//     notifyWaiters, detectedLayout, detectedConfidence and copyRequest, all in
+//     the last cache line.
+//   - Both sides swap the mailbox, see below.
+//
+// Originally the mapped file was just the 4 byte shared HANDLE.  The VR side
+// then had to OpenSharedResource and GetDesc just to know what it was drawing.
+// Now we publish the full description of the surface, and a frame sequence
+// number and timestamp for every Present, so the VR side can tell whether it
+// has a fresh frame without touching DX11 at all.
+//
+// The shared HANDLE stays as the very first 4 bytes, to match the prior layout.
+//
+// The game side can publish a ring of shared surfaces, instead of just the one.
+// It copies each frame into a slot the VR side is not using, then swaps that
+// slot into the mailbox.  The VR side swaps the mailbox for its own slot when
+// there is something fresh in it.  That way the game never waits on the HMD,
+// and the HMD always samples the newest complete frame, never one half copied.
+//
+// Every change the VR side might care about also bumps the generation, and
+// KatangaNotify.h is how the VR side is woken up to look at it.
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#define KATANGA_MAPPED_FILE_NAME L"Local\\KatangaMappedFile"
+
+// The same block for the POSIX backend in KatangaSharedMemory.h.
+#define KATANGA_SHM_NAME "/KatangaMappedFile"
+
+// 'KTNG' as little endian, so it's readable in a memory view.
+const uint32_t kKatangaMagic = 0x474E544B;
+
+// Bump this whenever the layout below changes.  The VR side will refuse to
+// use fields it does not understand, and fall back to GetDesc.
+const uint32_t kKatangaVersion = 8;
+
+// Number of shared surfaces in the ring.  Three is the minimum where neither
+// side ever has to wait, one for each side plus one in the mailbox.
+const uint32_t kKatangaMaxSlots = 3;
+
+// Set in the mailbox along with the slot index, when the game side has put a
+// new frame there that the VR side has not yet taken.
+const uint32_t kKatangaMailboxFresh = 0x4;
+const uint32_t kKatangaMailboxSlotMask = 0x3;
+
+// surfaceFlags, set by the game side at setup.
+// Slots are D3D11_RESOURCE_MISC_SHARED_KEYEDMUTEX, see KatangaKeyedMutex.h.
+const uint32_t kKatangaSurfaceKeyedMutex = 0x1;
+
+
+// How the two eyes are packed into the shared surface.  We always build a
+// double width surface in the game plugin, right eye on the left half, which
+// is cross-eyed order as expected by the sbsShader.
+
+enum KatangaStereoLayout : uint32_t
+{
+	kLayoutUnknown = 0,
+	kLayoutSideBySide = 1,				// Double width, right eye on left half.
+	kLayoutSideBySideSwapped = 2,		// Double width, left eye on left half.
+	kLayoutOverUnder = 3,				// Double height, right eye on top.
+	kLayoutMono = 4,
+};
+
+
+// How much of each eye the game side copies into the shared surface.  The VR
+// side asks for one in copyRequest, and the game side publishes what it is
+// actually doing, see CopyPlan.h.  A smaller copy means a smaller surface, the
+// layout of the eyes within it stays the same.
+
+enum KatangaCopyMode : uint32_t
+{
+	kCopyModeFull = 0,					// Every pixel of both eyes.
+	kCopyModeHalf = 1,					// Half width and height per eye, filtered.
+	kCopyModeCrop = 2,					// Only a rectangle of each eye, at full res.
+};
+
+// A crop in the copyRequest is in these units of the eye, 0 at the top left.
+const uint32_t kKatangaCropScale = 16384;
+
+
+// First cache line is written only during setup, while the game side holds the
+// KatangaSetupMutex.  Second line is the per-frame fields updated on every
+// Present.  The fields written by the VR side are in their own cache line at
+// the end, so neither side's per-frame writes bounce the other's lines.
+
+struct alignas(64) KatangaSharedDescriptor
+{
+	// The shared HANDLE is always 32 bit, even for x64 processes.  Zero means
+	// the surface is not ready, or is being rebuilt.
+	// https://docs.microsoft.com/en-us/windows/win32/winprog64/interprocess-communication
+	uint32_t sharedHandle;
+
+	uint32_t magic;
+	uint32_t version;
+
+	// Description of the shared surface, matches what GetDesc would return.
+	// Format is always a DXGI_FORMAT, even for DX9 games, 0 if not known.
+	uint32_t width;
+	uint32_t height;
+	uint32_t format;
+	uint32_t stereoLayout;
+
+	// The ring of shared surfaces, all with the same description.  slotHandles[0]
+	// is always the same as sharedHandle.  DX9 games only publish the one slot.
+	uint32_t slotCount;
+	uint32_t slotHandles[kKatangaMaxSlots];
+
+	// kKatangaSurface flags, for how the slots must be used.
+	uint32_t surfaceFlags;
+
+	// The KatangaCopyMode in effect for these surfaces, and the part of each eye
+	// that is in them, as x, y, width, height in pixels of the game's own eye
+	// size.  In Half, that part is filtered down to the smaller surface.
+	uint32_t copyMode;
+	uint16_t copyRect[4];
+	uint16_t eyeWidth;
+	uint16_t eyeHeight;
+
+	// ---- Game side writes per frame below here ----
+
+	// Incremented after every copy of the game frame into the shared surface.
+	// Timestamp is QueryPerformanceCounter ticks at that same point.
+	alignas(64) std::atomic<uint64_t> frameSequence;
+	std::atomic<int64_t> presentTimestamp;
+
+	// Seqlock style counter for setup of the shared surface.  Odd while the
+	// game side is rebuilding it in CreateSurfaces, ResizeBuffers or Reset,
+	// even when it's stable.  The VR side only needs the KatangaSetupMutex
+	// when it sees this odd, otherwise it can draw with no kernel call.
+	std::atomic<uint32_t> setupSequence;
+
+	// Slot index of the latest complete frame, or'd with kKatangaMailboxFresh
+	// if the VR side has not yet taken it.  Swapped by both sides.
+	std::atomic<uint32_t> mailbox;
+
+	// Incremented on every publish or retract of the surface, and every frame.
+	// The VR side compares it to the last one it saw, after a wakeup.
+	std::atomic<uint32_t> generation;
+
+	// ---- VR side writes only below here ----
+
+	// Non-zero from the VR side's Update until its end of frame, while it may
+	// be sampling the shared surface.  Game side will not start a rebuild
+	// until this clears.  A count, not a flag, because Unity can call Update
+	// more than once before the end of frame, and each of those begins.
+	alignas(64) std::atomic<uint32_t> consumerBusy;
+
+	// The frameSequence the VR side had seen when it last looked for a new
+	// frame, and the QueryPerformanceCounter time it did so.  The game side's
+	// FramePacer uses these to skip copies that would never be seen.  Time is
+	// zero until the VR side first samples.
+	std::atomic<uint64_t> consumedSequence;
+	std::atomic<int64_t> consumerSampleTime;
+
+	// Non-zero while the VR side wants a wakeup on every frame, not just when
+	// the surface changes.
+	std::atomic<uint32_t> notifyWaiters;
+
+	// What the VR side finds in the frames, see StereoDetect.h.  stereoLayout
+	// is how the game side packed the surface, this is what is in it, like the
+	// same image twice when 3D Vision is off.  A KatangaStereoLayout, and how
+	// sure it is from 0 to 100.  kLayoutUnknown until it has looked.
+	std::atomic<uint32_t> detectedLayout;
+	std::atomic<uint32_t> detectedConfidence;
+
+	// The KatangaCopyMode the VR side would like, packed with its crop by
+	// KatangaPackCopyRequest.  Zero is a full copy.  The game side only rebuilds
+	// for it once it has been steady for a while.
+	std::atomic<uint64_t> copyRequest;
+};
+
+static_assert(sizeof(KatangaSharedDescriptor) == 192, "KatangaSharedDescriptor must be exactly three cache lines.");
+
+
+// --------------------------------------------------------------------------
+// Writer side, only called from the game plugin.
+
+// Called during setup, with the KatangaSetupMutex held.  The handle is written
+// last, because non-zero handle is what tells the VR side to go.
+//
+// This also resets the mailbox ring.  The game side starts writing to slot 0,
+// the mailbox holds slot 1, and the VR side starts reading from slot 2.
+
+inline void KatangaPublishSurface(KatangaSharedDescriptor* desc, const uint32_t* slotHandles,
+	uint32_t slotCount, uint32_t width, uint32_t height, uint32_t format, KatangaStereoLayout layout,
+	uint32_t surfaceFlags)
+{
+	desc->magic = kKatangaMagic;
+	desc->version = kKatangaVersion;
+	desc->width = width;
+	desc->height = height;
+	desc->format = format;
+	desc->stereoLayout = layout;
+	desc->slotCount = slotCount;
+	for (uint32_t i = 0; i < kKatangaMaxSlots; i++)
+		desc->slotHandles[i] = (i < slotCount) ? slotHandles[i] : 0;
+	desc->surfaceFlags = surfaceFlags;
+	desc->mailbox.store(1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	desc->sharedHandle = slotHandles[0];
+	desc->generation.fetch_add(1);
+}
+
+// Called during setup just before KatangaPublishSurface, for the copy that the
+// new surfaces were made for.
+
+inline void KatangaPublishCopy(KatangaSharedDescriptor* desc, KatangaCopyMode mode, const uint16_t copyRect[4],
+	uint16_t eyeWidth, uint16_t eyeHeight)
+{
+	desc->copyMode = mode;
+	for (int i = 0; i < 4; i++)
+		desc->copyRect[i] = copyRect[i];
+	desc->eyeWidth = eyeWidth;
+	desc->eyeHeight = eyeHeight;
+}
+
+// Called at Resize/Reset, to notify the VR side the surface is going away.
+
+inline void KatangaRetractSurface(KatangaSharedDescriptor* desc)
+{
+	desc->sharedHandle = 0;
+	std::atomic_thread_fence(std::memory_order_release);
+	desc->generation.fetch_add(1);
+}
+
+// Called from Present, after the stereo copy into writeSlot has been issued.
+// Puts that slot in the mailbox, and returns the slot to use for the next
+// frame, which is whatever was in the mailbox.  If the VR side has not taken
+// the prior frame, that one is just dropped, it's never going to be seen, and
+// unconsumed is set if given.
+
+inline uint32_t KatangaSwapWriteSlot(KatangaSharedDescriptor* desc, uint32_t writeSlot, bool* unconsumed = nullptr)
+{
+	if (unconsumed)
+		*unconsumed = false;
+	if (desc->slotCount < kKatangaMaxSlots)
+		return 0;
+
+	uint32_t prior = desc->mailbox.exchange(writeSlot | kKatangaMailboxFresh, std::memory_order_acq_rel);
+	if (unconsumed)
+		*unconsumed = (prior & kKatangaMailboxFresh) != 0;
+	return prior & kKatangaMailboxSlotMask;
+}
+
+// Called from Present, after the stereo copy has been issued, and before
+// KatangaSwapWriteSlot, see KatangaConsumerSampled.
+
+inline void KatangaPublishFrame(KatangaSharedDescriptor* desc, int64_t timestamp)
+{
+	desc->presentTimestamp.store(timestamp, std::memory_order_relaxed);
+	desc->frameSequence.fetch_add(1, std::memory_order_release);
+	desc->generation.fetch_add(1);
+}
+
+// After KatangaPublishFrame, whether to signal the KatangaNotifyEvent.  The
+// generation was bumped first, with the same Dekker style ordering as setup, so
+// a VR side that sets notifyWaiters and then reads the generation will either
+// see this frame, or get the signal for it.  Surface changes always signal.
+
+inline bool KatangaFrameNotifyWanted(const KatangaSharedDescriptor* desc)
+{
+	return desc->notifyWaiters.load() != 0;
+}
+
+
+// Any time, zero until the VR side has asked for something.
+
+inline uint64_t KatangaReadCopyRequest(const KatangaSharedDescriptor* desc)
+{
+	return desc->copyRequest.load(std::memory_order_relaxed);
+}
+
+
+// Setup handshake with the VR side, which is a Dekker style pair of flags.
+// We mark setup in progress, then check if the VR side is mid-frame.  The VR
+// side marks itself busy, then checks for setup in progress.  Both use
+// sequentially consistent order, so at least one of them will see the other.
+// After KatangaBeginSetup, the game side waits for KatangaConsumerIdle before
+// touching the shared surface.
+
+inline void KatangaBeginSetup(KatangaSharedDescriptor* desc)
+{
+	desc->setupSequence.fetch_add(1);
+}
+
+inline bool KatangaConsumerIdle(const KatangaSharedDescriptor* desc)
+{
+	return desc->consumerBusy.load() == 0;
+}
+
+// Waits for KatangaConsumerIdle after KatangaBeginSetup, false if the VR side
+// is still busy at the timeout.  A VR frame already under way has at most about
+// 11ms left, and most of the time it is just ending, so this yields for a
+// little while, then sleeps in 1ms steps, rather than spinning a whole core.
+
+inline bool KatangaWaitConsumerIdle(const KatangaSharedDescriptor* desc, std::chrono::milliseconds timeout)
+{
+	const int kYieldRounds = 64;
+
+	auto start = std::chrono::steady_clock::now();
+	for (int round = 0; !KatangaConsumerIdle(desc); round++)
+	{
+		if (round < kYieldRounds)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+		if (std::chrono::steady_clock::now() - start > timeout)
+			return false;
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return true;
+}
+
+inline void KatangaEndSetup(KatangaSharedDescriptor* desc)
+{
+	desc->setupSequence.fetch_add(1);
+}
+
+
+// --------------------------------------------------------------------------
+// Reader side, only called from the VR side.
+
+// Try to start a frame without the KatangaSetupMutex.  Returns true if the
+// game side is not in setup, and cannot start until KatangaEndFrame.  If it
+// returns false, the game side is busy and the caller must use the mutex.
+// Only our own count is taken back on failure, so a frame that began earlier
+// and is still drawing stays busy.
+
+inline bool KatangaTryBeginFrame(KatangaSharedDescriptor* desc)
+{
+	desc->consumerBusy.fetch_add(1);
+	if ((desc->setupSequence.load() & 1) == 0)
+		return true;
+
+	desc->consumerBusy.fetch_sub(1);
+	return false;
+}
+
+// Ends the given number of frames that KatangaTryBeginFrame began.
+
+inline void KatangaEndFrame(KatangaSharedDescriptor* desc, uint32_t frames = 1)
+{
+	if (frames > 0)
+		desc->consumerBusy.fetch_sub(frames);
+}
+
+// True if the descriptor was written by a game plugin that matches this
+// layout.  If not, only the sharedHandle can be trusted.
+
+inline bool KatangaIsDescriptorValid(const KatangaSharedDescriptor* desc)
+{
+	return (desc->magic == kKatangaMagic) && (desc->version == kKatangaVersion);
+}
+
+inline uint64_t KatangaReadFrameSequence(const KatangaSharedDescriptor* desc)
+{
+	return desc->frameSequence.load(std::memory_order_acquire);
+}
+
+inline void KatangaReadConsumerSample(const KatangaSharedDescriptor* desc, uint64_t* consumedSequence, int64_t* sampleTime)
+{
+	*sampleTime = desc->consumerSampleTime.load(std::memory_order_acquire);
+	*consumedSequence = desc->consumedSequence.load(std::memory_order_relaxed);
+}
+
+// Called every VR frame, after taking the latest slot, so the game side knows
+// what we have seen.  The game side publishes the frameSequence before it puts
+// the slot in the mailbox, so whatever we read here covers the slot we took.
+
+inline void KatangaConsumerSampled(KatangaSharedDescriptor* desc, int64_t now)
+{
+	desc->consumedSequence.store(desc->frameSequence.load(std::memory_order_acquire), std::memory_order_relaxed);
+	desc->consumerSampleTime.store(now, std::memory_order_release);
+}
+
+// Now and then, from the VR side's look at a frame.  Confidence first, so a
+// reader that sees the layout sees at least as new a confidence.
+
+inline void KatangaPublishDetectedLayout(KatangaSharedDescriptor* desc, uint32_t layout, uint32_t confidence)
+{
+	desc->detectedConfidence.store(confidence, std::memory_order_relaxed);
+	desc->detectedLayout.store(layout, std::memory_order_release);
+}
+
+// The copy request is the mode in the low 4 bits, then the crop x, y, width and
+// height in 15 bits each, in kKatangaCropScale units.  One 64 bit store, so the
+// game side never sees the mode of one request with the crop of another.
+
+inline uint64_t KatangaPackCopyRequest(KatangaCopyMode mode, uint32_t x, uint32_t y, uint32_t width, uint32_t height)
+{
+	const uint32_t kField = 0x7FFF;
+	uint64_t request = mode & 0xF;
+	request |= (uint64_t)((x < kField) ? x : kField) << 4;
+	request |= (uint64_t)((y < kField) ? y : kField) << 19;
+	request |= (uint64_t)((width < kField) ? width : kField) << 34;
+	request |= (uint64_t)((height < kField) ? height : kField) << 49;
+	return request;
+}
+
+inline KatangaCopyMode KatangaUnpackCopyRequest(uint64_t request, uint32_t crop[4])
+{
+	for (int i = 0; i < 4; i++)
+		crop[i] = (uint32_t)(request >> (4 + 15 * i)) & 0x7FFF;
+	return (KatangaCopyMode)(request & 0xF);
+}
+
+inline void KatangaRequestCopy(KatangaSharedDescriptor* desc, uint64_t request)
+{
+	desc->copyRequest.store(request, std::memory_order_relaxed);
+}
+
+inline uint32_t KatangaReadGeneration(const KatangaSharedDescriptor* desc)
+{
+	return desc->generation.load();
+}
+
+inline void KatangaSetFrameNotify(KatangaSharedDescriptor* desc, bool wanted)
+{
+	desc->notifyWaiters.store(wanted ? 1 : 0);
+}
+
+// True if the game side has put a frame in the mailbox we have not taken.
+
+inline bool KatangaHasFreshSlot(const KatangaSharedDescriptor* desc)
+{
+	return (desc->mailbox.load(std::memory_order_relaxed) & kKatangaMailboxFresh) != 0;
+}
+
+// The slot of the fresh frame in the mailbox, without taking it, or
+// kKatangaMaxSlots if there is none.  For the keyed mode, which must own the
+// slot's keyed mutex before it trades for it.
+
+inline uint32_t KatangaPeekFreshSlot(const KatangaSharedDescriptor* desc)
+{
+	uint32_t mailbox = desc->mailbox.load(std::memory_order_acquire);
+	return (mailbox & kKatangaMailboxFresh) ? (mailbox & kKatangaMailboxSlotMask) : kKatangaMaxSlots;
+}
+
+// Trades readSlot for freshSlot, only if freshSlot is still the fresh one in
+// the mailbox.  False if the game side replaced it since the peek, in which
+// case the mailbox is untouched and readSlot is still ours.
+
+inline bool KatangaTradeForSlot(KatangaSharedDescriptor* desc, uint32_t readSlot, uint32_t freshSlot)
+{
+	uint32_t expected = freshSlot | kKatangaMailboxFresh;
+	return desc->mailbox.compare_exchange_strong(expected, readSlot, std::memory_order_acq_rel);
+}
+
+// Called once per VR frame, with readSlot the one we sampled last frame, which
+// should be kKatangaMaxSlots-1 right after the surfaces are opened.  If there
+// is a fresh frame in the mailbox, we trade our slot for it, otherwise we just
+// keep showing the one we have.  Returns the slot to sample this frame.
+
+inline uint32_t KatangaAcquireLatestSlot(KatangaSharedDescriptor* desc, uint32_t readSlot)
+{
+	if (desc->slotCount < kKatangaMaxSlots)
+		return 0;
+
+	if (!KatangaHasFreshSlot(desc))
+		return readSlot;
+
+	uint32_t latest = desc->mailbox.exchange(readSlot, std::memory_order_acq_rel);
+	return latest & kKatangaMailboxSlotMask;
+}
@@ -0,0 +1,195 @@
+#pragma once
+
+//-----------------------------------------------------------
+// Keyed mutex handoff of the shared surface slots, for the opt-in keyed mode.
+//
+// Normally the shared textures are plain D3D11_RESOURCE_MISC_SHARED, and the
+// only thing ordering the two devices is the mailbox, which says nothing about
+// when the GPU copy is actually done.  In keyed mode the textures are created
+// with D3D11_RESOURCE_MISC_SHARED_KEYEDMUTEX, and each slot is handed back
+// and forth with the IDXGIKeyedMutex, so the VR device's GPU work waits on the
+// game's copy, and vice versa.
+//
+// The keys follow ownership in the mailbox.  The game side acquires a slot
+// with key 0 just for the copy, and releases it with key 1.  The VR side
+// acquires key 1 when it takes the slot out of the mailbox, and releases with
+// key 0 after it trades the slot back, once nothing it drew is still queued
+// against it.  A slot that was put in the mailbox and
+// replaced before the VR side took it comes back to the game still released
+// with key 1, so the game acquires that one with key 1 instead.
+//
+// Every acquire has a zero timeout, so neither process ever blocks on the
+// other.  If the game side cannot get its slot, it skips the copy for that
+// frame and keeps the slot to try again on the next Present.
+//
+// The VR side takes the key of the fresh slot before it trades for it in the
+// mailbox, so if it cannot have the key, or the game replaces the frame in
+// between, it still holds the slot it had, and shows that again.
+//
+// Unity samples the slot on its render thread, behind the main thread, so the
+// slot the VR side trades back keeps its key until the render thread has gone
+// past the draws that use it.  Meanwhile the game side skips its copies into
+// that slot, as above, and the VR side takes no fresher one, so it never holds
+// more than two of the three.
+//
+// The handoff logic is templated over TSync, with
+//     bool TryAcquire(uint32_t slot, uint64_t key);     // Zero timeout.
+//     void Release(uint32_t slot, uint64_t key);
+// so the DX11 side wraps IDXGIKeyedMutex, and a fake can simulate both sides.
+
+#include <stdint.h>
+
+#include "KatangaIPC.h"
+
+const uint64_t kKatangaKeyGame = 0;
+const uint64_t kKatangaKeyVR = 1;
+
+
+// Game side, driven from Present.
+
+template <class TSync>
+class KatangaKeyedProducer
+{
+public:
+	// New textures start out released with key 0.
+	void Reset()
+	{
+		nextKey = kKatangaKeyGame;
+		held = false;
+	}
+
+	// Before the copy into slot.  Returns false if the frame must be skipped.
+	// The expected key is tried first, and then the other, so that a slot that
+	// somehow got out of step with the mailbox is recovered, not lost.
+
+	bool BeginCopy(TSync* sync, uint32_t slot)
+	{
+		if (held)
+			return true;
+
+		uint64_t otherKey = (nextKey == kKatangaKeyGame) ? kKatangaKeyVR : kKatangaKeyGame;
+		if (sync->TryAcquire(slot, nextKey) || sync->TryAcquire(slot, otherKey))
+		{
+			held = true;
+			return true;
+		}
+
+		skipped++;
+		return false;
+	}
+
+	// After the copy is issued, before the slot goes in the mailbox.
+	void EndCopy(TSync* sync, uint32_t slot)
+	{
+		sync->Release(slot, kKatangaKeyVR);
+		held = false;
+	}
+
+	// With the new write slot out of the mailbox, and whether the VR side never
+	// took it, in which case it is still released with key 1.
+	void OnSwap(bool unconsumed)
+	{
+		nextKey = unconsumed ? kKatangaKeyVR : kKatangaKeyGame;
+	}
+
+	uint64_t Skipped() const { return skipped; }
+
+private:
+	uint64_t nextKey = kKatangaKeyGame;
+	bool held = false;
+	uint64_t skipped = 0;
+};
+
+
+// What KatangaKeyedConsumer::TakeLatest did.
+
+enum KatangaKeyedTake
+{
+	kKeyedTakeNone,						// No fresh frame, keep the one we have.
+	kKeyedTakeTaken,					// Traded for the fresh frame, and hold it.
+	kKeyedTakeBusy,						// Its key was not released, keep ours.
+	kKeyedTakeReplaced,					// The game replaced it first, keep ours.
+};
+
+
+// VR side, driven from Unity's render thread.  The slot we hold stays held
+// while Unity samples it, and after we trade it for a fresher one, until
+// ReleaseTraded.
+
+template <class TSync>
+class KatangaKeyedConsumer
+{
+public:
+	// The first slot we are given was never written, and is not acquired.
+	void Reset()
+	{
+		held = false;
+		traded = kKatangaMaxSlots;
+	}
+
+	// At close, when the slot is not traded back.
+	void ReleaseSlot(TSync* sync, uint32_t slot)
+	{
+		ReleaseTraded(sync);
+		if (held)
+			sync->Release(slot, kKatangaKeyGame);
+		held = false;
+	}
+
+	// Trades readSlot for the fresh slot in the mailbox, if there is one and
+	// its key can be had.  The game side released it before publishing, so
+	// the key should be there.  If the game replaces the frame between our
+	// acquire and the trade, the slot goes back to it still released with key
+	// 1, like any frame we never took.  Anything but kKeyedTakeTaken leaves
+	// readSlot, and what we hold, as they were.  Nothing is taken while the
+	// last slot we traded back still has our key.
+
+	KatangaKeyedTake TakeLatest(TSync* sync, KatangaSharedDescriptor* desc, uint32_t* readSlot)
+	{
+		if (traded < kKatangaMaxSlots)
+			return kKeyedTakeNone;
+
+		uint32_t fresh = KatangaPeekFreshSlot(desc);
+		if (fresh >= kKatangaMaxSlots)
+			return kKeyedTakeNone;
+
+		if (!sync->TryAcquire(fresh, kKatangaKeyVR))
+		{
+			skipped++;
+			return kKeyedTakeBusy;
+		}
+		if (!KatangaTradeForSlot(desc, *readSlot, fresh))
+		{
+			sync->Release(fresh, kKatangaKeyVR);
+			return kKeyedTakeReplaced;
+		}
+
+		if (held)
+			traded = *readSlot;
+		held = true;
+		*readSlot = fresh;
+		return kKeyedTakeTaken;
+	}
+
+	// Gives the slot TakeLatest traded back to the game side, once no draw
+	// that samples it is still queued.
+	void ReleaseTraded(TSync* sync)
+	{
+		if (traded < kKatangaMaxSlots)
+			sync->Release(traded, kKatangaKeyGame);
+		traded = kKatangaMaxSlots;
+	}
+
+	// The slot traded back and not yet released, or kKatangaMaxSlots.
+	uint32_t Traded() const { return traded; }
+
+	// False until the first TakeLatest, while readSlot is one never written.
+	bool Held() const { return held; }
+
+	uint64_t Skipped() const { return skipped; }
+
+private:
+	bool held = false;
+	uint32_t traded = kKatangaMaxSlots;
+	uint64_t skipped = 0;
+};
@@ -0,0 +1,275 @@
+#pragma once
+
+//-----------------------------------------------------------
+// Wakeup channel from the game side to the VR side.
+//
+// The generation counter in the KatangaSharedDescriptor says that something
+// changed, this is what tells the VR side to go look, without it polling.  The
+// game side signals whenever it publishes or retracts a surface, and on frames
+// only while the VR side has set notifyWaiters, so a game running normally
+// makes no kernel call for this at all.
+//
+// On Windows it's a named auto-reset event.  Both sides use CreateEvent, which
+// opens it if the other side got there first, so it does not matter which side
+// starts first, and a signal made before the VR side waits is not lost.
+//
+// On Linux it's a word in a named shm_open object, waited on with a futex,
+// which behaves the same: created or opened by name from either process, a
+// signal sets it until one waiter takes it, and any number of signals before
+// that are the one wakeup.  Like KatangaSharedMemory_Posix.cpp, that is only
+// for the tests and tools, so that the protocol runs across real processes.
+//
+// KatangaNotifyGeneration is the VR side's count of those wakeups, which
+// Unity's threads read, or block on until it moves past one they have seen.
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#define KATANGA_NOTIFY_EVENT_NAME L"Local\\KatangaNotifyEvent"
+#define KATANGA_NOTIFY_SHM_NAME "/KatangaNotifyEvent"
+
+// Same value as INFINITE, for Wait.
+const uint32_t kKatangaNotifyInfinite = 0xFFFFFFFF;
+
+
+class KatangaNotifyEvent
+{
+public:
+	KatangaNotifyEvent() { }
+	~KatangaNotifyEvent() { Close(); }
+
+	KatangaNotifyEvent(const KatangaNotifyEvent&) = delete;
+	KatangaNotifyEvent& operator=(const KatangaNotifyEvent&) = delete;
+
+	// Creates the event, or opens it if the other side already did.  Returns
+	// false if neither worked, and then Signal and Wait do nothing.
+	bool Open();
+	void Close();
+
+#ifndef _WIN32
+	// The same with another name, so that tests don't share one.  The object
+	// stays until Remove, there is no telling which side is the last one.
+	bool Open(const char* name);
+	static void Remove(const char* name) { shm_unlink(name); }
+#endif
+
+	bool IsOpen() const;
+
+	// Wakes one Wait, now or the next time one is called.  Signals made before
+	// that collapse into the one wakeup.
+	void Signal();
+
+	// Returns true if woken by Signal, false on timeout or if not open.
+	bool Wait(uint32_t timeoutMs);
+
+private:
+#ifdef _WIN32
+	HANDLE event = NULL;
+#else
+	// 1 while signaled, 0 once a Wait took it.
+	std::atomic<uint32_t>* state = nullptr;
+#endif
+};
+
+
+// --------------------------------------------------------------------------
+// Count of wakeups on the VR side.  The watcher thread calls Advance for each
+// one, Unity's main thread just reads Current, and a C# thread pool thread can
+// block in WaitPast instead of checking every frame.
+
+class KatangaNotifyGeneration
+{
+public:
+	uint32_t Current() const
+	{
+		return generation.load();
+	}
+
+	void Advance()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			generation.fetch_add(1);
+		}
+		changed.notify_all();
+	}
+
+	// Returns the generation once it is not seenGeneration, or seenGeneration
+	// after timeoutMs, or straight away while stopped, so that nothing is left
+	// blocked in the plugin when the device goes away.
+
+	uint32_t WaitPast(uint32_t seenGeneration, uint32_t timeoutMs)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		changed.wait_for(lock, std::chrono::milliseconds(timeoutMs),
+			[&] { return stopped || generation.load() != seenGeneration; });
+		return generation.load();
+	}
+
+	void Start()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopped = false;
+	}
+
+	void Stop()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopped = true;
+		}
+		changed.notify_all();
+	}
+
+private:
+	std::atomic<uint32_t> generation { 0 };
+	std::mutex mutex;
+	std::condition_variable changed;
+	bool stopped = false;
+};
+
+
+#ifdef _WIN32
+
+inline bool KatangaNotifyEvent::Open()
+{
+	if (event == NULL)
+		event = CreateEventW(NULL, FALSE, FALSE, KATANGA_NOTIFY_EVENT_NAME);
+	return event != NULL;
+}
+
+inline void KatangaNotifyEvent::Close()
+{
+	if (event != NULL)
+		CloseHandle(event);
+	event = NULL;
+}
+
+inline bool KatangaNotifyEvent::IsOpen() const
+{
+	return event != NULL;
+}
+
+inline void KatangaNotifyEvent::Signal()
+{
+	if (event != NULL)
+		SetEvent(event);
+}
+
+inline bool KatangaNotifyEvent::Wait(uint32_t timeoutMs)
+{
+	if (event == NULL)
+		return false;
+	return WaitForSingleObject(event, timeoutMs) == WAIT_OBJECT_0;
+}
+
+#else
+
+// The futex is on the shared page itself, so it has to be the plain 32 bit
+// word that the kernel compares.
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t) && ATOMIC_INT_LOCK_FREE == 2,
+	"futex needs a lock free 32 bit atomic");
+
+inline bool KatangaNotifyEvent::Open()
+{
+	return Open(KATANGA_NOTIFY_SHM_NAME);
+}
+
+// A new object is zero filled by ftruncate, so it starts unsignaled, and if
+// both sides race to create it, the second ftruncate to the same size is a
+// no-op.
+
+inline bool KatangaNotifyEvent::Open(const char* name)
+{
+	if (state != nullptr)
+		return true;
+
+	int fd = shm_open(name, O_RDWR | O_CREAT, 0600);
+	if (fd < 0)
+		return false;
+
+	void* mapped = MAP_FAILED;
+	struct stat info;
+	if (fstat(fd, &info) == 0 &&
+		((size_t)info.st_size >= sizeof(uint32_t) || ftruncate(fd, sizeof(uint32_t)) == 0))
+	{
+		mapped = mmap(nullptr, sizeof(uint32_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	}
+	close(fd);
+	if (mapped == MAP_FAILED)
+		return false;
+
+	state = static_cast<std::atomic<uint32_t>*>(mapped);
+	return true;
+}
+
+inline void KatangaNotifyEvent::Close()
+{
+	if (state != nullptr)
+		munmap(state, sizeof(uint32_t));
+	state = nullptr;
+}
+
+inline bool KatangaNotifyEvent::IsOpen() const
+{
+	return state != nullptr;
+}
+
+// A waiter only sleeps while the word is 0, so if it was already 1 there is
+// nobody to wake.  Not FUTEX_PRIVATE_FLAG, the waiter may be another process.
+
+inline void KatangaNotifyEvent::Signal()
+{
+	if (state != nullptr && state->exchange(1) == 0)
+		syscall(SYS_futex, state, FUTEX_WAKE, 1, nullptr, nullptr, 0);
+}
+
+// Taking the 1 is the auto-reset, and only one waiter can take it.  A Signal
+// between the exchange and the sleep changes the word, so FUTEX_WAIT returns
+// at once instead of sleeping through it.
+
+inline bool KatangaNotifyEvent::Wait(uint32_t timeoutMs)
+{
+	if (state == nullptr)
+		return false;
+
+	std::chrono::steady_clock::time_point deadline =
+		std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+
+	for (;;)
+	{
+		if (state->exchange(0) == 1)
+			return true;
+
+		timespec* timeout = nullptr;
+		timespec remaining;
+		if (timeoutMs != kKatangaNotifyInfinite)
+		{
+			std::chrono::nanoseconds left = deadline - std::chrono::steady_clock::now();
+			if (left.count() <= 0)
+				return false;
+			remaining.tv_sec = (time_t)(left.count() / 1000000000);
+			remaining.tv_nsec = (long)(left.count() % 1000000000);
+			timeout = &remaining;
+		}
+		syscall(SYS_futex, state, FUTEX_WAIT, 0, timeout, nullptr, 0);
+	}
+}
+
+#endif
@@ -0,0 +1,43 @@
+#pragma once
+
+//-----------------------------------------------------------
+// The named block of shared memory that holds the KatangaSharedDescriptor.
+//
+// The game side creates it at OnLoad, and the VR side opens it once the game
+// has signalled that it exists.  On Windows it's the pagefile backed
+// Local\KatangaMappedFile, in KatangaSharedMemory_Win32.cpp.  The POSIX
+// backend in KatangaSharedMemory_Posix.cpp is a shm_open object, so that the
+// protocol in KatangaIPC.h can be run and tested across real processes on
+// Linux, with the exact same descriptor code as the plugins.
+
+#include <stddef.h>
+
+
+class KatangaSharedMemory
+{
+public:
+	virtual ~KatangaSharedMemory() { }
+
+	// Game side.  Creates the block, or opens it if it is still there from a
+	// prior run.  A new block is always zero filled.
+	virtual bool Create(size_t size) = 0;
+
+	// VR side.  Opens the block that the game side created, false if there is
+	// none yet, which is not an error.
+	virtual bool Open(size_t size) = 0;
+
+	// Unmaps the view.  The block goes away with the last process to close it.
+	virtual void Close() = 0;
+
+	// Null until Create or Open succeeds.
+	virtual void* View() = 0;
+
+	// GetLastError or errno of the last failure, for the log.
+	virtual unsigned long LastError() = 0;
+};
+
+// The factories, one per platform, with the name of the block.  Windows names
+// are like KATANGA_MAPPED_FILE_NAME, POSIX names like KATANGA_SHM_NAME.
+
+KatangaSharedMemory* CreateKatangaSharedMemory_Win32(const wchar_t* name);
+KatangaSharedMemory* CreateKatangaSharedMemory_Posix(const char* name);
@@ -0,0 +1,115 @@
+// POSIX implementation of KatangaSharedMemory, for KatangaSharedMemory.h.
+//
+// Not used by either plugin, this is what the Linux tests and tools use to
+// put a KatangaSharedDescriptor between two processes.  The creator of the
+// object is the one to shm_unlink it, like the game side owning the mapping
+// on Windows.
+
+#include "KatangaSharedMemory.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+class KatangaSharedMemory_Posix : public KatangaSharedMemory
+{
+public:
+	KatangaSharedMemory_Posix(const char* name)
+		: name(name)
+	{
+	}
+
+	~KatangaSharedMemory_Posix()
+	{
+		Close();
+	}
+
+	bool Create(size_t size) override
+	{
+		// ftruncate of a new object fills it with zeros, same as the pagefile.
+		// If it is already there, it keeps whatever it had, also the same.
+		return Map(O_RDWR | O_CREAT, size, true);
+	}
+
+	bool Open(size_t size) override
+	{
+		return Map(O_RDWR, size, false);
+	}
+
+	void Close() override
+	{
+		if (view != nullptr)
+			munmap(view, mappedSize);
+		view = nullptr;
+		mappedSize = 0;
+
+		if (created)
+			shm_unlink(name.c_str());
+		created = false;
+	}
+
+	void* View() override
+	{
+		return view;
+	}
+
+	unsigned long LastError() override
+	{
+		return error;
+	}
+
+private:
+	bool Map(int flags, size_t size, bool create)
+	{
+		Close();
+
+		int fd = shm_open(name.c_str(), flags, 0600);
+		if (fd < 0)
+		{
+			error = errno;
+			return false;
+		}
+
+		// The creator may not have sized it yet, that is the same as not there.
+		struct stat info;
+		error = 0;
+		if (fstat(fd, &info) != 0)
+			error = errno;
+		else if (create && (size_t)info.st_size < size && ftruncate(fd, (off_t)size) != 0)
+			error = errno;
+		else if (!create && (size_t)info.st_size < size)
+			error = ENOENT;
+
+		void* mapped = MAP_FAILED;
+		if (error == 0)
+		{
+			mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			if (mapped == MAP_FAILED)
+				error = errno;
+		}
+		close(fd);
+		if (mapped == MAP_FAILED)
+			return false;
+
+		view = mapped;
+		mappedSize = size;
+		created = create;
+		return true;
+	}
+
+	std::string name;
+	void* view = nullptr;
+	size_t mappedSize = 0;
+	bool created = false;
+	unsigned long error = 0;
+};
+
+
+KatangaSharedMemory* CreateKatangaSharedMemory_Posix(const char* name)
+{
+	return new KatangaSharedMemory_Posix(name);
+}
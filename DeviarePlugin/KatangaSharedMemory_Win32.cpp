@@ -0,0 +1,106 @@
+// Win32 implementation of KatangaSharedMemory, for KatangaSharedMemory.h.
+//
+// A pagefile backed mapping, which is zero filled when first created, and
+// stays around until both sides have closed it.  Also built into the
+// UnityNativePlugin, which opens the same mapping.
+
+#include "KatangaSharedMemory.h"
+
+#include <windows.h>
+#include <string>
+
+
+class KatangaSharedMemory_Win32 : public KatangaSharedMemory
+{
+public:
+	KatangaSharedMemory_Win32(const wchar_t* name)
+		: name(name)
+	{
+	}
+
+	~KatangaSharedMemory_Win32()
+	{
+		Close();
+	}
+
+	bool Create(size_t size) override
+	{
+		Close();
+
+		mapping = CreateFileMappingW(
+			INVALID_HANDLE_VALUE,			// use paging file
+			NULL,							// default security
+			PAGE_READWRITE,					// read/write access
+			0,								// maximum object size (high-order DWORD)
+			(DWORD)size,					// maximum object size (low-order DWORD)
+			name.c_str());					// name of mapping object
+		return Map(size);
+	}
+
+	bool Open(size_t size) override
+	{
+		Close();
+
+		mapping = OpenFileMappingW(
+			FILE_MAP_ALL_ACCESS,			// read/write access
+			FALSE,							// do not inherit the name
+			name.c_str());					// name of mapping object
+		return Map(size);
+	}
+
+	void Close() override
+	{
+		if (view != nullptr)
+			UnmapViewOfFile(view);
+		if (mapping != NULL)
+			CloseHandle(mapping);
+		view = nullptr;
+		mapping = NULL;
+	}
+
+	void* View() override
+	{
+		return view;
+	}
+
+	unsigned long LastError() override
+	{
+		return error;
+	}
+
+private:
+	bool Map(size_t size)
+	{
+		if (mapping == NULL)
+		{
+			error = GetLastError();
+			return false;
+		}
+
+		view = MapViewOfFile(
+			mapping,						// handle to map file object
+			FILE_MAP_ALL_ACCESS,			// read/write permission
+			0,								// No offset in file
+			0,
+			size);							// Map full buffer
+		if (view == NULL)
+		{
+			error = GetLastError();
+			CloseHandle(mapping);
+			mapping = NULL;
+			return false;
+		}
+		return true;
+	}
+
+	std::wstring name;
+	HANDLE mapping = NULL;
+	void* view = nullptr;
+	unsigned long error = 0;
+};
+
+
+KatangaSharedMemory* CreateKatangaSharedMemory_Win32(const wchar_t* name)
+{
+	return new KatangaSharedMemory_Win32(name);
+}
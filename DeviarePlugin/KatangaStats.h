@@ -0,0 +1,275 @@
+#pragma once
+
+//-----------------------------------------------------------
+// Layout of the Local\KatangaStatsFile shared memory block.
+//
+// Timing of our Present hook, so we can see how much we add to the game's
+// frame.  The game plugin records timestamps at entry to Hooked_Present,
+// after the stereo copy, just before calling the original Present, and after
+// it returns.  Those are aggregated here into fixed bucket histograms, and
+// UnityNativePlugin reads them out.
+//
+// This is a separate mapping from the KatangaMappedFile, so it does not
+// change the descriptor layout, and the VR side can ignore it entirely.
+//
+// Times are stored in raw QueryPerformanceCounter ticks, so that recording a
+// frame is only integer math.  The reader converts using tickFrequency.
+
+#include <stdint.h>
+#include <atomic>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#define KATANGA_STATS_FILE_NAME L"Local\\KatangaStatsFile"
+
+// 'KTST' as little endian.
+const uint32_t kKatangaStatsMagic = 0x5453544B;
+const uint32_t kKatangaStatsVersion = 2;
+
+
+// Log-linear buckets, like HdrHistogram.  Values below 8 ticks get their own
+// bucket, above that each power of two is split into 8 sub-buckets, so any
+// value is within 12.5% of its bucket's lower bound.  256 buckets covers up
+// to 2^34 ticks, which is far more than any frame.
+
+const uint32_t kKatangaSubBucketBits = 3;
+const uint32_t kKatangaSubBuckets = 1 << kKatangaSubBucketBits;
+const uint32_t kKatangaBucketCount = 256;
+
+// Which span of the Present hook is being measured.
+
+enum KatangaStat : uint32_t
+{
+	kStatCopy = 0,				// Entry to after the stereo copy is issued.
+	kStatHookOverhead,			// Entry to just before original Present, all our time.
+	kStatOrigPresent,			// The original Present call itself.
+	kStatFrameInterval,			// Entry to entry of the next frame.
+	kStatCount
+};
+
+// How the stereo copy gets into the shared surface, see StereoCopyPath.h.
+// DX11 always copies directly, and leaves this unknown.
+
+enum KatangaCopyPath : uint32_t
+{
+	kCopyPathUnknown = 0,			// Not decided yet, or DX11.
+	kCopyPathIntermediate = 1,		// Through gGameSurface, two StretchRect.
+	kCopyPathDirect = 2,			// Straight into the shared target.
+};
+
+// What the DX9 creation hooks did with each resource, see PoolPolicy.h.
+
+enum KatangaPoolResource : uint32_t
+{
+	kPoolTexture = 0,
+	kPoolCubeTexture,
+	kPoolVolumeTexture,
+	kPoolVertexBuffer,
+	kPoolIndexBuffer,
+	kPoolResourceCount
+};
+
+enum KatangaPoolAction : uint32_t
+{
+	kPoolActionPassThrough = 0,		// Created as the game asked.
+	kPoolActionDynamic,				// DEFAULT plus DYNAMIC.
+	kPoolActionShadowed,			// Plain DEFAULT, with a shadow for a managed texture.
+	kPoolActionCount
+};
+
+// Only written by the game side's Present thread, so updates are plain
+// load/store, with no read-modify-write.  The VR side may see a histogram
+// part way through an update, which is fine for statistics.
+
+struct KatangaHistogram
+{
+	std::atomic<uint64_t> count;
+	std::atomic<uint64_t> sumTicks;
+	std::atomic<uint64_t> maxTicks;
+	std::atomic<uint32_t> buckets[kKatangaBucketCount];
+};
+
+struct alignas(64) KatangaStatsPage
+{
+	uint32_t magic;
+	uint32_t version;
+
+	// 9 or 11, so the reader knows which Present it's looking at.
+	uint32_t dxVersion;
+
+	// KatangaCopyPath of the DX9 Present.  Was reserved, so zero, unknown, from
+	// an older game plugin.
+	uint32_t copyPath;
+
+	// QueryPerformanceFrequency of the game side, ticks per second.
+	int64_t tickFrequency;
+
+	// Entry timestamp of the last frame, for kStatFrameInterval.  Game side only.
+	int64_t lastEntryTicks;
+
+	KatangaHistogram histograms[kStatCount];
+
+	// Every pool decision, by resource and the action actually applied.  Unlike
+	// the histograms, resources are created from any game thread, so these are
+	// atomic increments.
+	std::atomic<uint64_t> poolDecisions[kPoolResourceCount][kPoolActionCount];
+
+	// Rules loaded from the game's pool profile, 0 if only the built in rules.
+	uint32_t poolProfileRules;
+	uint32_t poolProfileErrors;
+};
+
+
+// --------------------------------------------------------------------------
+
+inline uint32_t KatangaHighBit(uint64_t value)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+#if defined _M_X64
+	_BitScanReverse64(&index, value);
+#else
+	if (value >> 32)
+	{
+		_BitScanReverse(&index, (unsigned long)(value >> 32));
+		index += 32;
+	}
+	else
+	{
+		_BitScanReverse(&index, (unsigned long)value);
+	}
+#endif
+	return index;
+#else
+	return 63 - __builtin_clzll(value);
+#endif
+}
+
+inline uint32_t KatangaBucketIndex(uint64_t ticks)
+{
+	if (ticks < kKatangaSubBuckets)
+		return (uint32_t)ticks;
+
+	uint32_t high = KatangaHighBit(ticks);
+	uint32_t sub = (uint32_t)(ticks >> (high - kKatangaSubBucketBits)) & (kKatangaSubBuckets - 1);
+	uint32_t index = (high - kKatangaSubBucketBits + 1) * kKatangaSubBuckets + sub;
+
+	return (index < kKatangaBucketCount) ? index : kKatangaBucketCount - 1;
+}
+
+// Smallest value that lands in the bucket, the inverse of KatangaBucketIndex.
+
+inline uint64_t KatangaBucketLowerBound(uint32_t index)
+{
+	if (index < kKatangaSubBuckets)
+		return index;
+
+	uint32_t high = index / kKatangaSubBuckets + kKatangaSubBucketBits - 1;
+	uint64_t sub = index & (kKatangaSubBuckets - 1);
+
+	return (kKatangaSubBuckets + sub) << (high - kKatangaSubBucketBits);
+}
+
+
+// --------------------------------------------------------------------------
+// Writer side, only called from the game plugin.
+
+inline void KatangaResetHistogram(KatangaHistogram* hist)
+{
+	hist->count.store(0, std::memory_order_relaxed);
+	hist->sumTicks.store(0, std::memory_order_relaxed);
+	hist->maxTicks.store(0, std::memory_order_relaxed);
+	for (uint32_t i = 0; i < kKatangaBucketCount; i++)
+		hist->buckets[i].store(0, std::memory_order_relaxed);
+}
+
+// The mapping is only zero filled when it's first created.  If the VR side
+// still has it open from an earlier run of the game, we get that run's page
+// back, so everything is cleared here rather than trusting it.
+
+inline void KatangaInitStats(KatangaStatsPage* page, uint32_t dxVersion, int64_t tickFrequency)
+{
+	page->magic = kKatangaStatsMagic;
+	page->version = kKatangaStatsVersion;
+	page->dxVersion = dxVersion;
+	page->copyPath = kCopyPathUnknown;
+	page->tickFrequency = tickFrequency;
+	page->lastEntryTicks = 0;
+
+	for (uint32_t stat = 0; stat < kStatCount; stat++)
+		KatangaResetHistogram(&page->histograms[stat]);
+	for (uint32_t resource = 0; resource < kPoolResourceCount; resource++)
+	{
+		for (uint32_t action = 0; action < kPoolActionCount; action++)
+			page->poolDecisions[resource][action].store(0, std::memory_order_relaxed);
+	}
+	page->poolProfileRules = 0;
+	page->poolProfileErrors = 0;
+}
+
+inline void KatangaRecord(KatangaHistogram* hist, int64_t ticks)
+{
+	uint64_t value = (ticks > 0) ? (uint64_t)ticks : 0;
+	uint32_t index = KatangaBucketIndex(value);
+
+	hist->buckets[index].store(hist->buckets[index].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	hist->sumTicks.store(hist->sumTicks.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+	if (value > hist->maxTicks.load(std::memory_order_relaxed))
+		hist->maxTicks.store(value, std::memory_order_relaxed);
+	hist->count.store(hist->count.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+// Called at the end of Hooked_Present with the four timestamps.  If the frame
+// was skipped before any copy, pass copied == entry.
+
+inline void KatangaRecordPresent(KatangaStatsPage* page,
+	int64_t entry, int64_t copied, int64_t beforeOrig, int64_t afterOrig)
+{
+	KatangaRecord(&page->histograms[kStatCopy], copied - entry);
+	KatangaRecord(&page->histograms[kStatHookOverhead], beforeOrig - entry);
+	KatangaRecord(&page->histograms[kStatOrigPresent], afterOrig - beforeOrig);
+	if (page->lastEntryTicks != 0)
+		KatangaRecord(&page->histograms[kStatFrameInterval], entry - page->lastEntryTicks);
+	page->lastEntryTicks = entry;
+}
+
+
+inline void KatangaRecordPoolDecision(KatangaStatsPage* page, KatangaPoolResource resource, KatangaPoolAction action)
+{
+	page->poolDecisions[resource][action].fetch_add(1, std::memory_order_relaxed);
+}
+
+
+// --------------------------------------------------------------------------
+// Reader side.
+
+inline bool KatangaIsStatsValid(const KatangaStatsPage* page)
+{
+	return (page->magic == kKatangaStatsMagic) && (page->version == kKatangaStatsVersion) &&
+		(page->tickFrequency != 0);
+}
+
+// Value in ticks below which the given fraction, 0.0 to 1.0, of samples fall.
+// This is the lower bound of the bucket, so it reads slightly low.
+
+inline uint64_t KatangaPercentileTicks(const KatangaHistogram* hist, double fraction)
+{
+	uint64_t count = hist->count.load(std::memory_order_acquire);
+	if (count == 0)
+		return 0;
+
+	uint64_t target = (uint64_t)(fraction * (double)count);
+	if (target >= count)
+		target = count - 1;
+
+	uint64_t seen = 0;
+	for (uint32_t i = 0; i < kKatangaBucketCount; i++)
+	{
+		seen += hist->buckets[i].load(std::memory_order_relaxed);
+		if (seen > target)
+			return KatangaBucketLowerBound(i);
+	}
+	return hist->maxTicks.load(std::memory_order_relaxed);
+}
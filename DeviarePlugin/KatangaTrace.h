@@ -0,0 +1,205 @@
+#pragma once
+
+//-----------------------------------------------------------
+// Startup trace, shared by the game plugin and UnityNativePlugin.
+//
+// From OnLoad to the first shared surface on the VR side, launch goes through
+// two processes, and the log only says what happened, not how long it took.
+// So each side records named spans, with start and duration in nanoseconds,
+// into a fixed ring of kCapacity, and appends them to one trace file at unload.
+//
+// The file is the Chrome trace event format, in its JSON array form, which is
+// allowed to end without the closing bracket.  The VR side starts a fresh file
+// at OpenLogFile, and then each process only appends its own events, with its
+// own pid, so the two land in the one timeline.  Open it in chrome://tracing or
+// ui.perfetto.dev.
+//
+// Timestamps are steady_clock, which is QueryPerformanceCounter on Windows,
+// and that is the same clock in every process, so no adjusting is needed.
+//
+// Recording is lock free, any thread can add a span.  The ring keeps the newest
+// kCapacity, so it is meant for setup and other rare calls.  Per frame spans
+// go in a tracer of their own, so they cannot push the rare ones out.
+// Names must be string literals, only the pointer is kept.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+
+
+class KatangaTracer
+{
+public:
+	static const uint64_t kCapacity = 1024;				// Must be power of 2.
+
+	static int64_t Now()
+	{
+		return (int64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	// Small numbers in order of first use, easier to read in the viewer than
+	// the OS ids.
+	static uint32_t ThreadId()
+	{
+		static std::atomic<uint32_t> nextId{ 1 };
+		thread_local uint32_t id = nextId.fetch_add(1, std::memory_order_relaxed);
+		return id;
+	}
+
+	void Span(const char* name, int64_t startNs, int64_t endNs)
+	{
+		Record(name, 'X', startNs, endNs - startNs);
+	}
+
+	// A point in time, like the first Present.
+	void Instant(const char* name)
+	{
+		Record(name, 'i', Now(), 0);
+	}
+
+	uint64_t Recorded() const { return next.load(std::memory_order_relaxed); }
+	uint64_t Dropped() const
+	{
+		uint64_t recorded = Recorded();
+		return (recorded > kCapacity) ? recorded - kCapacity : 0;
+	}
+
+	// Our events as lines of the trace file, each ending with a comma, and
+	// first the process_name metadata, so the viewer can label our row.
+
+	std::string Events(uint32_t pid, const char* processName) const
+	{
+		std::string text;
+		char line[256];
+
+		snprintf(line, sizeof(line), "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%u,\"tid\":0,\"args\":{\"name\":\"", pid);
+		text += line;
+		AppendEscaped(&text, processName);
+		text += "\"}},\n";
+
+		uint64_t end = Recorded();
+		uint64_t begin = (end > kCapacity) ? end - kCapacity : 0;
+		for (uint64_t i = begin; i < end; i++)
+		{
+			Event event;
+			if (!Read(i, &event))
+				continue;
+
+			text += "{\"name\":\"";
+			AppendEscaped(&text, event.name);
+			snprintf(line, sizeof(line), "\",\"cat\":\"katanga\",\"ph\":\"%c\",\"pid\":%u,\"tid\":%u,\"ts\":%lld.%03lld",
+				event.phase, pid, event.thread, (long long)(event.startNs / 1000), (long long)(event.startNs % 1000));
+			text += line;
+			if (event.phase == 'X')
+				snprintf(line, sizeof(line), ",\"dur\":%lld.%03lld},\n", (long long)(event.durationNs / 1000), (long long)(event.durationNs % 1000));
+			else
+				snprintf(line, sizeof(line), ",\"s\":\"p\"},\n");
+			text += line;
+		}
+		return text;
+	}
+
+	// Appends our events to a trace file opened for append, with the opening
+	// bracket if the file is empty.  Returns false if the write failed.
+
+	bool Append(FILE* file, uint32_t pid, const char* processName) const
+	{
+		if (file == nullptr || fseek(file, 0, SEEK_END) != 0)
+			return false;
+		std::string text = (ftell(file) == 0) ? "[\n" : "";
+		text += Events(pid, processName);
+		return fwrite(text.data(), 1, text.size(), file) == text.size();
+	}
+
+private:
+	struct Event
+	{
+		const char* name;
+		char phase;
+		uint32_t thread;
+		int64_t startNs;
+		int64_t durationNs;
+	};
+
+	// Each slot has the index+1 of the event in it, or 0 while it is being
+	// written, so Events can skip one that changed under it.
+	struct Slot
+	{
+		std::atomic<uint64_t> sequence{ 0 };
+		std::atomic<const char*> name{ nullptr };
+		std::atomic<char> phase{ 0 };
+		std::atomic<uint32_t> thread{ 0 };
+		std::atomic<int64_t> startNs{ 0 };
+		std::atomic<int64_t> durationNs{ 0 };
+	};
+
+	void Record(const char* name, char phase, int64_t startNs, int64_t durationNs)
+	{
+		uint64_t index = next.fetch_add(1, std::memory_order_relaxed);
+		Slot& slot = slots[index & (kCapacity - 1)];
+
+		slot.sequence.store(0, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		slot.name.store(name, std::memory_order_relaxed);
+		slot.phase.store(phase, std::memory_order_relaxed);
+		slot.thread.store(ThreadId(), std::memory_order_relaxed);
+		slot.startNs.store(startNs, std::memory_order_relaxed);
+		slot.durationNs.store(durationNs, std::memory_order_relaxed);
+		slot.sequence.store(index + 1, std::memory_order_release);
+	}
+
+	bool Read(uint64_t index, Event* event) const
+	{
+		const Slot& slot = slots[index & (kCapacity - 1)];
+		if (slot.sequence.load(std::memory_order_acquire) != index + 1)
+			return false;
+		event->name = slot.name.load(std::memory_order_relaxed);
+		event->phase = slot.phase.load(std::memory_order_relaxed);
+		event->thread = slot.thread.load(std::memory_order_relaxed);
+		event->startNs = slot.startNs.load(std::memory_order_relaxed);
+		event->durationNs = slot.durationNs.load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		return slot.sequence.load(std::memory_order_relaxed) == index + 1 && event->name != nullptr;
+	}
+
+	static void AppendEscaped(std::string* text, const char* value)
+	{
+		for (; *value != '\0'; value++)
+		{
+			if (*value == '"' || *value == '\\')
+				*text += '\\';
+			if ((unsigned char)*value >= 0x20)
+				*text += *value;
+		}
+	}
+
+	Slot slots[kCapacity];
+	std::atomic<uint64_t> next{ 0 };
+};
+
+
+// Records the span from here to the end of the enclosing block.
+
+class KatangaTraceScope
+{
+public:
+	KatangaTraceScope(KatangaTracer* tracer, const char* name)
+		: tracer(tracer), name(name), start(KatangaTracer::Now()) { }
+	~KatangaTraceScope() { tracer->Span(name, start, KatangaTracer::Now()); }
+
+	KatangaTraceScope(const KatangaTraceScope&) = delete;
+	KatangaTraceScope& operator=(const KatangaTraceScope&) = delete;
+
+private:
+	KatangaTracer* tracer;
+	const char* name;
+	int64_t start;
+};
+
+#define KATANGA_TRACE_CONCAT2(a, b) a##b
+#define KATANGA_TRACE_CONCAT(a, b) KATANGA_TRACE_CONCAT2(a, b)
+#define KATANGA_TRACE_SCOPE(tracer, name) \
+	KatangaTraceScope KATANGA_TRACE_CONCAT(katangaTraceScope, __LINE__)((tracer), (name))
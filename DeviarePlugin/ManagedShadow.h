@@ -0,0 +1,357 @@
+#pragma once
+
+//-----------------------------------------------------------
+// Emulates D3DPOOL_MANAGED for textures that PoolPolicy puts in plain DEFAULT.
+//
+// DX9Ex has no managed pool, and a DEFAULT texture that is not dynamic cannot
+// be locked.  Making them all dynamic keeps Lock working, but every upload then
+// goes down the dynamic path, and a static texture lives where the GPU reads
+// it slower.  So instead, each such texture gets a SYSTEMMEM copy of the same
+// size and format, its shadow, which is what the managed pool kept for us.
+//
+// The game's Lock is redirected to the shadow, and the locked rect is recorded
+// as dirty for that level.  At the last Unlock, only the dirty rects are copied
+// up to the DEFAULT texture, and the dirty list is cleared.  Shadows are only
+// ever made on a promoted device, which is DX9Ex, and that keeps DEFAULT
+// textures and their contents across Reset, so there is nothing to restore.
+//
+// Dirty rects are rounded out to 4x4 blocks, so compressed formats get whole
+// blocks, and clamped to the level.  Each level keeps a few rects, touching or
+// overlapping rects are merged, and past kMaxRects the closest two are merged.
+//
+// The store is keyed by the game's texture, and by each of its level surfaces,
+// since games and D3DX lock both ways.  The actual copy goes through
+// ShadowUploader, which InProc_DX9 implements with UpdateSurface.
+
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+
+
+struct ShadowRect
+{
+	uint32_t left;
+	uint32_t top;
+	uint32_t right;					// Exclusive, like RECT.
+	uint32_t bottom;
+
+	uint64_t Area() const { return (uint64_t)(right - left) * (bottom - top); }
+
+	bool Touches(const ShadowRect& other) const
+	{
+		return left <= other.right && other.left <= right && top <= other.bottom && other.top <= bottom;
+	}
+
+	bool Contains(const ShadowRect& other) const
+	{
+		return left <= other.left && top <= other.top && right >= other.right && bottom >= other.bottom;
+	}
+
+	ShadowRect Union(const ShadowRect& other) const
+	{
+		ShadowRect result;
+		result.left = (left < other.left) ? left : other.left;
+		result.top = (top < other.top) ? top : other.top;
+		result.right = (right > other.right) ? right : other.right;
+		result.bottom = (bottom > other.bottom) ? bottom : other.bottom;
+		return result;
+	}
+};
+
+
+class DirtyRegion
+{
+public:
+	static const int kMaxRects = 8;
+
+	void Add(const ShadowRect& rect)
+	{
+		if (rect.right <= rect.left || rect.bottom <= rect.top)
+			return;
+
+		ShadowRect merged = rect;
+		for (int i = 0; i < count; )
+		{
+			if (rects[i].Contains(merged))
+				return;
+			if (rects[i].Touches(merged))
+			{
+				merged = merged.Union(rects[i]);
+				rects[i] = rects[--count];
+				i = 0;
+				continue;
+			}
+			i++;
+		}
+
+		if (count == kMaxRects)
+		{
+			int best = 0;
+			uint64_t bestGrowth = UINT64_MAX;
+			for (int i = 0; i < count; i++)
+			{
+				uint64_t growth = merged.Union(rects[i]).Area() - rects[i].Area();
+				if (growth < bestGrowth)
+				{
+					bestGrowth = growth;
+					best = i;
+				}
+			}
+			merged = merged.Union(rects[best]);
+			rects[best] = rects[--count];
+		}
+
+		rects[count++] = merged;
+	}
+
+	void Clear() { count = 0; }
+	bool Empty() const { return count == 0; }
+	int Count() const { return count; }
+	const ShadowRect& Rect(int i) const { return rects[i]; }
+
+	uint64_t Area() const
+	{
+		uint64_t area = 0;
+		for (int i = 0; i < count; i++)
+			area += rects[i].Area();
+		return area;
+	}
+
+private:
+	ShadowRect rects[kMaxRects];
+	int count = 0;
+};
+
+
+class ShadowUploader
+{
+public:
+	virtual ~ShadowUploader() { }
+
+	// Copies rect of level from the shadow up to the game's texture.
+	virtual bool Upload(void* shadow, void* texture, uint32_t level, const ShadowRect& rect) = 0;
+};
+
+
+// --------------------------------------------------------------------------
+
+class ManagedShadowStore
+{
+public:
+	static const uint32_t kMaxLevels = 16;
+	static const uint32_t kBlockSize = 4;
+
+	// texture and shadow are the game's DEFAULT texture and its SYSTEMMEM copy,
+	// with the size of each level.  Both start out empty, so nothing is dirty.
+
+	void Add(void* texture, void* shadow, uint32_t levels, const uint32_t* widths, const uint32_t* heights)
+	{
+		Entry entry = Entry();
+		entry.shadow = shadow;
+		entry.levels = (levels < kMaxLevels) ? levels : kMaxLevels;
+		for (uint32_t i = 0; i < entry.levels; i++)
+		{
+			entry.level[i].width = widths[i];
+			entry.level[i].height = heights[i];
+		}
+
+		std::lock_guard<std::mutex> guard(lock);
+		textures[texture] = entry;
+		count.store((uint32_t)textures.size(), std::memory_order_relaxed);
+	}
+
+	// One of the texture's level surfaces, which are owned by the texture and
+	// go away with it.
+	void AddSurface(void* surface, void* texture, uint32_t level)
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		Level* state = FindLevel(texture, level);
+		if (state == nullptr)
+			return;
+		state->surface = surface;
+		surfaces[surface] = SurfaceLevel{ texture, level };
+	}
+
+	// When the game's texture is destroyed.  Returns its shadow for the caller
+	// to release, or nullptr if it did not have one.
+	void* Remove(void* texture)
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		auto found = textures.find(texture);
+		if (found == textures.end())
+			return nullptr;
+
+		void* shadow = found->second.shadow;
+		for (uint32_t i = 0; i < found->second.levels; i++)
+		{
+			if (found->second.level[i].surface != nullptr)
+				surfaces.erase(found->second.level[i].surface);
+		}
+		textures.erase(found);
+		count.store((uint32_t)textures.size(), std::memory_order_relaxed);
+		return shadow;
+	}
+
+	// Cheap check for the Lock hooks, which see every texture in the game.
+	bool Empty() const { return count.load(std::memory_order_relaxed) == 0; }
+	uint32_t Count() const { return count.load(std::memory_order_relaxed); }
+
+	bool Find(void* texture, void** shadow)
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		auto found = textures.find(texture);
+		if (found == textures.end())
+			return false;
+		*shadow = found->second.shadow;
+		return true;
+	}
+
+	bool FindSurface(void* surface, void** texture, uint32_t* level, void** shadow)
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		auto found = surfaces.find(surface);
+		if (found == surfaces.end())
+			return false;
+		auto entry = textures.find(found->second.texture);
+		if (entry == textures.end())
+			return false;
+		*texture = found->second.texture;
+		*level = found->second.level;
+		*shadow = entry->second.shadow;
+		return true;
+	}
+
+	// After the shadow is locked.  rect of nullptr is the whole level, and a
+	// read only Lock leaves nothing dirty.
+
+	void Locked(void* texture, uint32_t level, const ShadowRect* rect, bool readOnly)
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		Level* state = FindLevel(texture, level);
+		if (state == nullptr)
+			return;
+
+		state->lockDepth++;
+		locks++;
+		if (!readOnly)
+			state->dirty.Add(BlockAligned(*state, rect));
+	}
+
+	// After the shadow is unlocked.  The last Unlock of a level uploads its
+	// dirty rects.
+	//
+	// The upload is made without holding our lock.  The runtime holds its own
+	// lock while destroying a texture, which calls Remove, so holding ours into
+	// the device would risk a deadlock with another thread.  The game can't
+	// destroy the texture it is unlocking, so the entry stays.
+
+	void Unlocked(void* texture, uint32_t level, ShadowUploader* uploader)
+	{
+		DirtyRegion pending;
+		void* shadow;
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			Level* state = FindLevel(texture, level);
+			if (state == nullptr || state->lockDepth == 0 || --state->lockDepth != 0)
+				return;
+			pending = state->dirty;
+			state->dirty.Clear();
+			shadow = textures[texture].shadow;
+		}
+
+		DirtyRegion failed = Upload(shadow, texture, level, pending, uploader);
+
+		std::lock_guard<std::mutex> guard(lock);
+		Level* state = FindLevel(texture, level);
+		for (int i = 0; state != nullptr && i < failed.Count(); i++)
+			state->dirty.Add(failed.Rect(i));
+	}
+
+	uint64_t Locks() const { return locks; }
+	uint64_t Uploads() const { return uploads.load(std::memory_order_relaxed); }
+	uint64_t UploadedTexels() const { return uploadedTexels.load(std::memory_order_relaxed); }
+	uint64_t FailedUploads() const { return failedUploads.load(std::memory_order_relaxed); }
+
+private:
+	struct Level
+	{
+		void* surface;
+		uint32_t width;
+		uint32_t height;
+		uint32_t lockDepth;
+		DirtyRegion dirty;
+	};
+
+	struct Entry
+	{
+		void* shadow;
+		uint32_t levels;
+		Level level[kMaxLevels];
+	};
+
+	struct SurfaceLevel
+	{
+		void* texture;
+		uint32_t level;
+	};
+
+	Level* FindLevel(void* texture, uint32_t level)
+	{
+		auto found = textures.find(texture);
+		if (found == textures.end() || level >= found->second.levels)
+			return nullptr;
+		return &found->second.level[level];
+	}
+
+	static ShadowRect BlockAligned(const Level& state, const ShadowRect* rect)
+	{
+		ShadowRect whole = { 0, 0, state.width, state.height };
+		if (rect == nullptr)
+			return whole;
+
+		ShadowRect aligned;
+		aligned.left = rect->left & ~(kBlockSize - 1);
+		aligned.top = rect->top & ~(kBlockSize - 1);
+		aligned.right = (rect->right + kBlockSize - 1) & ~(kBlockSize - 1);
+		aligned.bottom = (rect->bottom + kBlockSize - 1) & ~(kBlockSize - 1);
+		if (aligned.right > state.width)
+			aligned.right = state.width;
+		if (aligned.bottom > state.height)
+			aligned.bottom = state.height;
+		return aligned;
+	}
+
+	// Returns the rects that failed, which stay dirty, so the next Unlock tries
+	// them again.
+
+	DirtyRegion Upload(void* shadow, void* texture, uint32_t level, const DirtyRegion& dirty, ShadowUploader* uploader)
+	{
+		DirtyRegion failed;
+		for (int i = 0; i < dirty.Count(); i++)
+		{
+			const ShadowRect& rect = dirty.Rect(i);
+			if (uploader->Upload(shadow, texture, level, rect))
+			{
+				uploads.fetch_add(1, std::memory_order_relaxed);
+				uploadedTexels.fetch_add(rect.Area(), std::memory_order_relaxed);
+			}
+			else
+			{
+				failedUploads.fetch_add(1, std::memory_order_relaxed);
+				failed.Add(rect);
+			}
+		}
+		return failed;
+	}
+
+	std::mutex lock;
+	std::unordered_map<void*, Entry> textures;
+	std::unordered_map<void*, SurfaceLevel> surfaces;
+	std::atomic<uint32_t> count{ 0 };
+
+	uint64_t locks = 0;
+	std::atomic<uint64_t> uploads{ 0 };
+	std::atomic<uint64_t> uploadedTexels{ 0 };
+	std::atomic<uint64_t> failedUploads{ 0 };
+};
@@ -0,0 +1,469 @@
+#pragma once
+
+//-----------------------------------------------------------
+// Decides, per resource, how the DX9 creation hooks rewrite its pool and usage.
+//
+// Once the game is on DX9Ex, D3DPOOL_MANAGED is not allowed, and the hooks used
+// to turn every such resource into DEFAULT plus DYNAMIC, so that the game can
+// still Lock it.  That is right for resources the game keeps rewriting, but
+// static geometry and textures that are written once then live in memory the
+// GPU reads slower, and every Lock goes down the dynamic path.  Resources the
+// game did not ask to be managed were also made dynamic, for no reason.
+//
+// So each creation call is described by a PoolRequest, and the first matching
+// PoolRule gives its KatangaPoolAction:
+//  - PassThrough, leave the call alone.
+//  - Dynamic, DEFAULT plus DYNAMIC, the old behavior.
+//  - Shadowed, plain DEFAULT.  Buffers in DEFAULT can be locked as they are.
+//    Textures can't, so a managed 2D texture gets a system memory shadow to
+//    take its Locks, see ManagedShadow.h.  Cube and volume textures have no
+//    shadow, and stay dynamic.
+//
+// Rules come from a per-game profile file, then the [*] section of that file
+// for every game, then the built in rules, which always match.  The built in
+// rules keep everything lockable that was before:
+//  - Not managed, pass through.
+//  - Managed render targets or depth stencils, plain DEFAULT.
+//  - Managed buffers of 4K or more, plain DEFAULT, as static geometry.
+//  - Managed 2D textures, plain DEFAULT with a shadow.
+//  - Any other managed resource, DEFAULT plus DYNAMIC.
+//
+// The profile file has one rule per line, in sections per game executable:
+//
+//     # Comment
+//     [Left4Dead2.exe]
+//     texture,cube size>=262144 calls<=4 -> shadowed
+//     vertex usage=0x8 -> shadowed
+//     [*]
+//     index size<1024 -> dynamic
+//
+// The first word is the resources the rule is for, a comma list of texture,
+// cube, volume, vertex, index, or * for all.  Then any of these conditions:
+//     pool=managed|default|systemmem   format=<D3DFORMAT number>
+//     usage=<bits all set>   nousage=<bits all clear>
+//     size>=N  size<N   calls>=N  calls<=N
+// and then -> with passthrough, dynamic, or shadowed.  Numbers can be hex.
+//
+// Size is bytes for buffers, and texels of the top level for textures, all six
+// faces for a cube.  Calls is how many times the code that made this call has
+// created a resource of this kind, including this one, so a rule can tell one
+// off setup from a loop that keeps recreating.
+//
+// The D3DPOOL and D3DUSAGE values we need are copied below, and InProc_DX9
+// checks them.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <mutex>
+
+#include "KatangaStats.h"
+
+
+const uint32_t kPolicyPoolDefault = 0;			// D3DPOOL_DEFAULT
+const uint32_t kPolicyPoolManaged = 1;			// D3DPOOL_MANAGED
+const uint32_t kPolicyPoolSystemMem = 2;		// D3DPOOL_SYSTEMMEM
+
+const uint32_t kPolicyUsageRenderTarget = 0x1;	// D3DUSAGE_RENDERTARGET
+const uint32_t kPolicyUsageDepthStencil = 0x2;	// D3DUSAGE_DEPTHSTENCIL
+const uint32_t kPolicyUsageWriteOnly = 0x8;		// D3DUSAGE_WRITEONLY
+const uint32_t kPolicyUsageDynamic = 0x200;		// D3DUSAGE_DYNAMIC
+
+
+struct PoolRequest
+{
+	KatangaPoolResource resource;
+	uint32_t pool;
+	uint32_t usage;
+	uint32_t format;				// D3DFORMAT, or 0 for vertex buffers.
+	uint64_t size;
+	uint32_t calls;
+};
+
+struct PoolRule
+{
+	uint32_t resources;				// Bits of 1 << KatangaPoolResource, 0 for any.
+	uint32_t pools;					// Bits of 1 << pool, 0 for any.  Bit 31 is any pool past 30.
+	uint32_t usageAll;
+	uint32_t usageNone;
+	uint32_t format;				// 0 for any.
+	uint64_t minSize;
+	uint64_t maxSize;				// Exclusive, 0 for no limit.
+	uint32_t minCalls;
+	uint32_t maxCalls;				// Inclusive, 0 for no limit.
+	KatangaPoolAction action;
+
+	bool Matches(const PoolRequest& request) const
+	{
+		if (resources != 0 && (resources & (1u << request.resource)) == 0)
+			return false;
+		if (pools != 0 && (pools & (1u << (request.pool < 31 ? request.pool : 31))) == 0)
+			return false;
+		if ((request.usage & usageAll) != usageAll || (request.usage & usageNone) != 0)
+			return false;
+		if (format != 0 && request.format != format)
+			return false;
+		if (request.size < minSize || (maxSize != 0 && request.size >= maxSize))
+			return false;
+		if (request.calls < minCalls || (maxCalls != 0 && request.calls > maxCalls))
+			return false;
+		return true;
+	}
+};
+
+
+// --------------------------------------------------------------------------
+// How many times each call site has created each kind of resource.  The hooks
+// pass their return address.  Creation can come from any game thread, and is
+// nowhere near as hot as Present, so a lock is fine.  Once the table is full,
+// new call sites all count as first calls.
+
+class PoolCallerCounts
+{
+public:
+	static const uint32_t kCapacity = 512;
+
+	uint32_t Count(uintptr_t caller, KatangaPoolResource resource)
+	{
+		uintptr_t key = caller ^ ((uintptr_t)resource << 1) ^ 1;
+		uint32_t hash = (uint32_t)((key * 0x9E3779B1u) >> 7);
+
+		std::lock_guard<std::mutex> guard(lock);
+		for (uint32_t probe = 0; probe < kCapacity; probe++)
+		{
+			Entry& entry = entries[(hash + probe) % kCapacity];
+			if (entry.key == key)
+				return ++entry.calls;
+			if (entry.key == 0)
+			{
+				entry.key = key;
+				entry.calls = 1;
+				return 1;
+			}
+		}
+		return 1;
+	}
+
+private:
+	struct Entry
+	{
+		uintptr_t key;
+		uint32_t calls;
+	};
+
+	std::mutex lock;
+	Entry entries[kCapacity] = { };
+};
+
+
+// --------------------------------------------------------------------------
+
+class PoolPolicy
+{
+public:
+	static const int kMaxRules = 64;
+
+	PoolPolicy()
+	{
+		SetBuiltinRules();
+	}
+
+	// Replaces the profile rules with those for game from the profile text, the
+	// whole file as one string.  game is the executable name, and is matched
+	// without case.  Lines that don't parse are skipped, and counted in Errors,
+	// with the first one in FirstErrorLine.  Returns the number of rules loaded.
+
+	int LoadProfile(const char* text, const char* game)
+	{
+		profileCount = 0;
+		errors = 0;
+		firstErrorLine = 0;
+
+		PoolRule gameRules[kMaxRules];
+		PoolRule anyRules[kMaxRules];
+		int gameCount = 0, anyCount = 0;
+
+		enum { kSkip, kGame, kAny } section = kSkip;
+		int lineNumber = 0;
+
+		while (text != nullptr && *text != '\0')
+		{
+			const char* end = text + strcspn(text, "\r\n");
+			char line[256];
+			size_t length = (size_t)(end - text);
+			bool tooLong = length >= sizeof(line);
+			memcpy(line, text, tooLong ? 0 : length);
+			line[tooLong ? 0 : length] = '\0';
+			text = end + strspn(end, "\r\n");
+			lineNumber++;
+
+			char* comment = strchr(line, '#');
+			if (comment)
+				*comment = '\0';
+			char* start = Trim(line);
+
+			if (tooLong)
+			{
+				Error(lineNumber);
+			}
+			else if (*start == '\0')
+			{
+				continue;
+			}
+			else if (*start == '[')
+			{
+				char* close = strchr(start, ']');
+				if (close == nullptr)
+				{
+					Error(lineNumber);
+					section = kSkip;
+					continue;
+				}
+				*close = '\0';
+				char* name = Trim(start + 1);
+				if (strcmp(name, "*") == 0)
+					section = kAny;
+				else
+					section = (game != nullptr && SameText(name, game)) ? kGame : kSkip;
+			}
+			else if (section != kSkip)
+			{
+				PoolRule rule;
+				if (!ParseRule(start, &rule))
+					Error(lineNumber);
+				else if (section == kGame && gameCount < kMaxRules)
+					gameRules[gameCount++] = rule;
+				else if (section == kAny && anyCount < kMaxRules)
+					anyRules[anyCount++] = rule;
+				else
+					Error(lineNumber);
+			}
+		}
+
+		for (int i = 0; i < gameCount && profileCount < kMaxRules; i++)
+			profile[profileCount++] = gameRules[i];
+		for (int i = 0; i < anyCount && profileCount < kMaxRules; i++)
+			profile[profileCount++] = anyRules[i];
+
+		return profileCount;
+	}
+
+	KatangaPoolAction Decide(const PoolRequest& request) const
+	{
+		for (int i = 0; i < profileCount; i++)
+		{
+			if (profile[i].Matches(request))
+				return profile[i].action;
+		}
+		for (int i = 0; i < builtinCount; i++)
+		{
+			if (builtin[i].Matches(request))
+				return builtin[i].action;
+		}
+		return kPoolActionPassThrough;
+	}
+
+	int ProfileRules() const { return profileCount; }
+	int Errors() const { return errors; }
+	int FirstErrorLine() const { return firstErrorLine; }
+
+	// One rule from a profile line, exposed for the parser's own tests.
+
+	static bool ParseRule(const char* text, PoolRule* rule)
+	{
+		*rule = PoolRule();
+		char copy[256];
+		strncpy(copy, text, sizeof(copy) - 1);
+		copy[sizeof(copy) - 1] = '\0';
+
+		char* arrow = strstr(copy, "->");
+		if (arrow == nullptr)
+			return false;
+		*arrow = '\0';
+		if (!ParseAction(Trim(arrow + 2), &rule->action))
+			return false;
+
+		char* next = nullptr;
+		char* word = strtok_r_portable(copy, " \t", &next);
+		if (word == nullptr || !ParseResources(word, &rule->resources))
+			return false;
+
+		while ((word = strtok_r_portable(nullptr, " \t", &next)) != nullptr)
+		{
+			if (!ParseCondition(word, rule))
+				return false;
+		}
+		return true;
+	}
+
+private:
+	void SetBuiltinRules()
+	{
+		const uint32_t buffers = (1u << kPoolVertexBuffer) | (1u << kPoolIndexBuffer);
+		const uint32_t managed = 1u << kPolicyPoolManaged;
+		const uint32_t targets = kPolicyUsageRenderTarget | kPolicyUsageDepthStencil;
+
+		builtinCount = 0;
+
+		PoolRule notManaged = PoolRule();
+		notManaged.pools = ~managed;
+		notManaged.action = kPoolActionPassThrough;
+		builtin[builtinCount++] = notManaged;
+
+		PoolRule renderTarget = PoolRule();
+		renderTarget.usageAll = kPolicyUsageRenderTarget;
+		renderTarget.action = kPoolActionShadowed;
+		builtin[builtinCount++] = renderTarget;
+
+		PoolRule depthStencil = PoolRule();
+		depthStencil.usageAll = kPolicyUsageDepthStencil;
+		depthStencil.action = kPoolActionShadowed;
+		builtin[builtinCount++] = depthStencil;
+
+		PoolRule staticBuffer = PoolRule();
+		staticBuffer.resources = buffers;
+		staticBuffer.usageNone = kPolicyUsageDynamic;
+		staticBuffer.minSize = 4096;
+		staticBuffer.action = kPoolActionShadowed;
+		builtin[builtinCount++] = staticBuffer;
+
+		PoolRule managedTexture = PoolRule();
+		managedTexture.resources = 1u << kPoolTexture;
+		managedTexture.usageNone = kPolicyUsageDynamic;
+		managedTexture.action = kPoolActionShadowed;
+		builtin[builtinCount++] = managedTexture;
+
+		PoolRule rest = PoolRule();
+		rest.usageNone = targets;
+		rest.action = kPoolActionDynamic;
+		builtin[builtinCount++] = rest;
+	}
+
+	void Error(int lineNumber)
+	{
+		if (errors++ == 0)
+			firstErrorLine = lineNumber;
+	}
+
+	static char* Trim(char* text)
+	{
+		while (isspace((unsigned char)*text))
+			text++;
+		char* end = text + strlen(text);
+		while (end > text && isspace((unsigned char)end[-1]))
+			*--end = '\0';
+		return text;
+	}
+
+	static bool SameText(const char* a, const char* b)
+	{
+		for (; *a && *b; a++, b++)
+		{
+			if (tolower((unsigned char)*a) != tolower((unsigned char)*b))
+				return false;
+		}
+		return *a == *b;
+	}
+
+	// strtok_r is strtok_s in MSVC, with the same arguments.
+	static char* strtok_r_portable(char* text, const char* separators, char** next)
+	{
+#ifdef _MSC_VER
+		return strtok_s(text, separators, next);
+#else
+		return strtok_r(text, separators, next);
+#endif
+	}
+
+	static bool ParseNumber(const char* text, uint64_t* value)
+	{
+		if (*text == '\0')
+			return false;
+		char* end;
+		*value = strtoull(text, &end, 0);
+		return *end == '\0';
+	}
+
+	static bool ParseAction(const char* text, KatangaPoolAction* action)
+	{
+		if (SameText(text, "passthrough"))
+			*action = kPoolActionPassThrough;
+		else if (SameText(text, "dynamic"))
+			*action = kPoolActionDynamic;
+		else if (SameText(text, "shadowed"))
+			*action = kPoolActionShadowed;
+		else
+			return false;
+		return true;
+	}
+
+	static bool ParseResources(char* text, uint32_t* resources)
+	{
+		static const char* const names[kPoolResourceCount] = { "texture", "cube", "volume", "vertex", "index" };
+
+		*resources = 0;
+		if (strcmp(text, "*") == 0)
+			return true;
+
+		char* next = nullptr;
+		for (char* name = strtok_r_portable(text, ",", &next); name != nullptr; name = strtok_r_portable(nullptr, ",", &next))
+		{
+			uint32_t found = 0;
+			for (uint32_t i = 0; i < kPoolResourceCount; i++)
+			{
+				if (SameText(name, names[i]))
+					found = 1u << i;
+			}
+			if (found == 0)
+				return false;
+			*resources |= found;
+		}
+		return *resources != 0;
+	}
+
+	static bool ParseCondition(const char* word, PoolRule* rule)
+	{
+		static const char* const pools[] = { "default", "managed", "systemmem" };
+		uint64_t value;
+
+		if (strncmp(word, "pool=", 5) == 0)
+		{
+			for (uint32_t i = 0; i < 3; i++)
+			{
+				if (SameText(word + 5, pools[i]))
+				{
+					rule->pools |= 1u << i;
+					return true;
+				}
+			}
+			return false;
+		}
+		if (strncmp(word, "format=", 7) == 0 && ParseNumber(word + 7, &value))
+			rule->format = (uint32_t)value;
+		else if (strncmp(word, "usage=", 6) == 0 && ParseNumber(word + 6, &value))
+			rule->usageAll |= (uint32_t)value;
+		else if (strncmp(word, "nousage=", 8) == 0 && ParseNumber(word + 8, &value))
+			rule->usageNone |= (uint32_t)value;
+		else if (strncmp(word, "size>=", 6) == 0 && ParseNumber(word + 6, &value))
+			rule->minSize = value;
+		else if (strncmp(word, "size<", 5) == 0 && ParseNumber(word + 5, &value) && value > 0)
+			rule->maxSize = value;
+		else if (strncmp(word, "calls>=", 7) == 0 && ParseNumber(word + 7, &value))
+			rule->minCalls = (uint32_t)value;
+		else if (strncmp(word, "calls<=", 7) == 0 && ParseNumber(word + 7, &value) && value > 0)
+			rule->maxCalls = (uint32_t)value;
+		else
+			return false;
+		return true;
+	}
+
+	PoolRule builtin[8];
+	int builtinCount = 0;
+
+	PoolRule profile[kMaxRules];
+	int profileCount = 0;
+
+	int errors = 0;
+	int firstErrorLine = 0;
+};
@@ -0,0 +1,277 @@
+#pragma once
+
+//-----------------------------------------------------------
+// Lifecycle of the shared stereo surfaces, apart from any graphics API.
+//
+// The ordering between Present, ResizeBuffers, the setup lock and publishing
+// handles in the KatangaMappedFile is the fragile part of all this, and the
+// part that causes hung or crashed games when it's wrong.  So it lives here,
+// with only what it needs from the graphics API and the setup lock behind
+// the SharedSurfaceDevice interface.  InProc_DX11 supplies the real one, but
+// any fake device can drive the same sequence of events without a game.
+//
+// The rules are:
+//  - Surfaces are only created with the setup lock held.
+//  - The handle is retracted before the game's own resize/reset runs, and only
+//    republished once the new surfaces are complete.
+//  - The old surfaces are released only after the new ones are published, and
+//    either with the setup lock held, or once the VR side has moved off them.
+//
+// A rebuild of our own, like for a new copy mode, never waits on the VR side.
+// It only takes the setup lock if the VR side is between frames right then,
+// and otherwise tries again at a later Present.  It publishes the new ring
+// over the old one with no retract, and the old ring drains: it is released
+// once the VR side has taken a frame from the new one.
+//
+// Along the way, it counts how often we churn handles, how long we hold the
+// setup lock, and how long the VR side was left without a surface.
+
+#include <stdint.h>
+
+#include "KatangaIPC.h"
+
+
+struct SharedSurfaceDesc
+{
+	uint32_t width;
+	uint32_t height;
+	uint32_t format;					// DXGI_FORMAT
+	KatangaStereoLayout layout;
+	uint32_t flags;						// kKatangaSurface flags
+
+	// What part of the game's eyes is in the surfaces, see CopyPlan.h.
+	KatangaCopyMode copyMode;
+	uint16_t copyRect[4];
+	uint16_t eyeWidth;
+	uint16_t eyeHeight;
+};
+
+// TSource is whatever the API creates surfaces from, the IDXGISwapChain for DX11.
+
+template <class TSource>
+class SharedSurfaceDevice
+{
+public:
+	virtual ~SharedSurfaceDevice() { }
+
+	// Create a new set of shared surfaces matching the source, and return the
+	// number created, up to maxSlots, with their shared handles and description.
+	// Any prior set must be kept alive until ReleaseStaleSurfaces.
+	virtual uint32_t CreateSurfaces(TSource* source, uint32_t* slotHandles, uint32_t maxSlots, SharedSurfaceDesc* desc) = 0;
+
+	// Release the set that was replaced by the last CreateSurfaces.
+	virtual void ReleaseStaleSurfaces() = 0;
+
+	// The KatangaSetupMutex and handshake, which must allow nesting.
+	virtual void BeginSetup() = 0;
+	virtual void EndSetup() = 0;
+
+	// Same as BeginSetup, but returns false at once, holding nothing, if the
+	// VR side is mid-frame or holds the lock.
+	virtual bool TryBeginSetup() = 0;
+
+	// Wake the VR side, after the surface was published or retracted.
+	virtual void NotifyConsumer() = 0;
+
+	// Any monotonic clock, only used for the stats.
+	virtual int64_t Now() = 0;
+};
+
+
+template <class TSource>
+class SharedSurfaceLifecycle
+{
+public:
+	explicit SharedSurfaceLifecycle(SharedSurfaceDevice<TSource>* device)
+		: device(device)
+	{
+	}
+
+	bool IsReady() const
+	{
+		return ready;
+	}
+
+	// Called at the top of every Present.  The first time, and after anything
+	// we could not rebuild, this will create and publish the surfaces.  This is
+	// also where a replaced ring is let go, once it has drained.
+
+	void OnPresent(TSource* source, KatangaSharedDescriptor* shared)
+	{
+		if (!ready)
+			Rebuild(source, shared, false);
+		else if (draining)
+			ReleaseDrained(shared);
+	}
+
+	// Called before the game's own ResizeBuffers.  The setup lock is held from
+	// here until EndResize, so the VR side cannot use any surface in between.
+
+	void BeginResize(KatangaSharedDescriptor* shared)
+	{
+		BeginSetup();
+
+		ready = false;
+		KatangaRetractSurface(shared);
+		device->NotifyConsumer();
+		if (retractedAt == 0)
+			retractedAt = device->Now();
+	}
+
+	// Called after the game's ResizeBuffers.  If it failed, we leave the
+	// surfaces retracted, and the next Present will try again.
+
+	void EndResize(TSource* source, KatangaSharedDescriptor* shared, bool succeeded)
+	{
+		if (succeeded)
+			Rebuild(source, shared, false);
+
+		EndSetup();
+	}
+
+	// Called from Present, when the surfaces need to be made again for the same
+	// source, like for a new copy mode.  Nothing of the game's changes, so the
+	// VR side can go on with the old ring until it sees the new one, and we
+	// don't wait for it.  Returns false if the VR side was mid-frame, then the
+	// caller tries again next Present.
+
+	bool Replace(TSource* source, KatangaSharedDescriptor* shared)
+	{
+		if (!device->TryBeginSetup())
+		{
+			deferredReplaces++;
+			return false;
+		}
+		StartSetupTimer();
+
+		Rebuild(source, shared, true);
+
+		EndSetup();
+		return true;
+	}
+
+	// True while a replaced ring is still alive, waiting for the VR side.
+	bool IsDraining() const { return draining; }
+
+	// Number of shared handles we have created, over the life of the game.
+	uint64_t SurfaceCreates() const { return surfaceCreates; }
+
+	// Presents where Replace found the VR side mid-frame.
+	uint64_t DeferredReplaces() const { return deferredReplaces; }
+
+	// Time the setup lock was held, for the last and worst setup.
+	int64_t LastSetupTicks() const { return lastSetupTicks; }
+	int64_t MaxSetupTicks() const { return maxSetupTicks; }
+
+	// Time from retracting the handle to publishing the new one, which is the
+	// window where the VR side is showing grey.
+	int64_t LastStaleTicks() const { return lastStaleTicks; }
+
+	// A replaced ring is released after this many Presents even if the VR side
+	// never takes a frame of the new one, about a second at 60 fps.
+	static const int kDrainPresents = 60;
+
+private:
+	// A prior ring still draining goes first, the device only keeps one.  With
+	// drain, the ring replaced now is kept until the VR side has taken a frame
+	// that was published after this, see ReleaseDrained.
+
+	void Rebuild(TSource* source, KatangaSharedDescriptor* shared, bool drain)
+	{
+		BeginSetup();
+		{
+			if (draining)
+			{
+				device->ReleaseStaleSurfaces();
+				draining = false;
+			}
+
+			uint32_t slotHandles[kKatangaMaxSlots] = { 0 };
+			SharedSurfaceDesc desc = { 0, 0, 0, kLayoutUnknown, 0, kCopyModeFull, { 0 }, 0, 0 };
+
+			uint32_t count = device->CreateSurfaces(source, slotHandles, kKatangaMaxSlots, &desc);
+
+			KatangaPublishCopy(shared, desc.copyMode, desc.copyRect, desc.eyeWidth, desc.eyeHeight);
+			KatangaPublishSurface(shared, slotHandles, count, desc.width, desc.height, desc.format, desc.layout, desc.flags);
+			device->NotifyConsumer();
+			ready = true;
+			surfaceCreates += count;
+
+			if (retractedAt != 0)
+			{
+				lastStaleTicks = device->Now() - retractedAt;
+				retractedAt = 0;
+			}
+
+			if (drain)
+			{
+				draining = true;
+				drainSequence = KatangaReadFrameSequence(shared);
+				drainPresents = 0;
+			}
+			else
+			{
+				device->ReleaseStaleSurfaces();
+			}
+		}
+		EndSetup();
+	}
+
+	// The VR side samples only after it has opened whatever was published, so
+	// once it has seen a frame newer than the publish, it is off the old ring.
+
+	void ReleaseDrained(KatangaSharedDescriptor* shared)
+	{
+		uint64_t consumedSequence;
+		int64_t sampleTime;
+		KatangaReadConsumerSample(shared, &consumedSequence, &sampleTime);
+
+		if (consumedSequence > drainSequence || ++drainPresents >= kDrainPresents)
+		{
+			device->ReleaseStaleSurfaces();
+			draining = false;
+		}
+	}
+
+	// Only the outermost Begin/End pair is timed, Rebuild nests inside Resize.
+
+	void BeginSetup()
+	{
+		device->BeginSetup();
+		StartSetupTimer();
+	}
+
+	void StartSetupTimer()
+	{
+		if (setupDepth++ == 0)
+			setupStart = device->Now();
+	}
+
+	void EndSetup()
+	{
+		if (--setupDepth == 0)
+		{
+			lastSetupTicks = device->Now() - setupStart;
+			if (lastSetupTicks > maxSetupTicks)
+				maxSetupTicks = lastSetupTicks;
+		}
+		device->EndSetup();
+	}
+
+	SharedSurfaceDevice<TSource>* device;
+	bool ready = false;
+	int setupDepth = 0;
+
+	bool draining = false;
+	uint64_t drainSequence = 0;
+	int drainPresents = 0;
+
+	int64_t setupStart = 0;
+	int64_t retractedAt = 0;
+
+	uint64_t surfaceCreates = 0;
+	uint64_t deferredReplaces = 0;
+	int64_t lastSetupTicks = 0;
+	int64_t maxSetupTicks = 0;
+	int64_t lastStaleTicks = 0;
+};
@@ -0,0 +1,241 @@
+#pragma once
+
+//-----------------------------------------------------------
+// Chooses how the DX9 Present gets the stereo backbuffer into the shared target.
+//
+// The original path is two StretchRect per frame, backbuffer to the gGameSurface
+// texture, and then that to the shared gSharedTarget, because on the drivers we
+// first tried, a shared surface as the destination of the stereo copy only
+// came out mono.  That is twice the copy bandwidth for a double width surface.
+//
+// Rather than assume, we try the direct copy now and then, read it back once,
+// and look at the pixels.  Only a copy that is clearly stereo switches us to
+// the direct path for good.  A copy that fails, or is clearly mono, keeps the
+// intermediate.  Anything we can't tell, like a black loading screen or a 2D
+// menu with identical eyes, is tried again later, up to a limit.
+//
+// The probe never touches the shared target itself.  The VR side samples that
+// one surface whenever it likes, with or without a new frame published, so a
+// probe cleared to black there could show in the headset.  The probe copies to
+// a scratch surface instead, made and shared the same way, whose handle is
+// never published, and the frame itself is then copied to the shared target
+// as usual, by whichever path the probe left us on.  That's one extra copy on
+// a probe frame, for at most kMaxProbes frames.
+//
+// A copy less than full, see CopyPlan.h, always goes through the intermediate,
+// so it has nothing to probe, and leaves the path as it is.
+//
+// The graphics API is behind StereoCopyDevice, which InProc_DX9 implements for
+// IDirect3DDevice9, and any fake can stand in.
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "CopyPlan.h"
+#include "KatangaStats.h"
+
+
+enum StereoCheck
+{
+	kStereoCheckFailed,				// The copy itself failed.
+	kStereoCheckMono,				// Copied, but only one eye made it.
+	kStereoCheckInconclusive,		// Can't tell from this frame.
+	kStereoCheckStereo,
+};
+
+
+// Looks at a readback of the double width shared target, 4 bytes per pixel.
+// Only a band of sampled rows is checked, it only runs while probing.
+//
+// The top byte is ignored, it's alpha, or undefined for X8R8G8B8.  Mono shows
+// up one of two ways.  Either one half never got written, which is why the
+// scratch is cleared before the probe, or one eye was stretched across both
+// halves, so that every pixel is doubled.  In a real image, neighbors differ
+// about as often on even as on odd columns, stretched doubles only on one.
+
+inline StereoCheck ClassifyStereoCopy(const uint8_t* image, int pitch, int width, int height)
+{
+	const uint32_t kColorMask = 0x00FFFFFF;
+	const uint32_t kLitMask = 0x00E0E0E0;
+	const int kSampleRows = 32;
+
+	int half = width / 2;
+	if (half == 0 || height == 0)
+		return kStereoCheckInconclusive;
+
+	uint64_t samples = 0, litLeft = 0, litRight = 0, differing = 0;
+	uint64_t pairs = 0, evenEdges = 0, oddEdges = 0;
+
+	for (int r = 0; r < kSampleRows; r++)
+	{
+		int y = (int)(((int64_t)(2 * r + 1) * height) / (2 * kSampleRows));
+		const uint32_t* row = (const uint32_t*)(image + (size_t)y * pitch);
+
+		for (int x = 0; x < half; x++)
+		{
+			uint32_t left = row[x] & kColorMask;
+			uint32_t right = row[half + x] & kColorMask;
+			samples++;
+			if (left & kLitMask)
+				litLeft++;
+			if (right & kLitMask)
+				litRight++;
+			if (left != right)
+				differing++;
+		}
+
+		for (int x = 0; x + 2 < width; x += 2)
+		{
+			pairs++;
+			if ((row[x] ^ row[x + 1]) & kColorMask)
+				evenEdges++;
+			if ((row[x + 1] ^ row[x + 2]) & kColorMask)
+				oddEdges++;
+		}
+	}
+
+	// A lit half next to a black one, the other eye was never written.
+	bool leftLit = litLeft * 10 >= samples;
+	bool rightLit = litRight * 10 >= samples;
+	if (leftLit != rightLit && (litLeft * 100 < samples || litRight * 100 < samples))
+		return kStereoCheckMono;
+
+	// Mostly black, like a loading screen.
+	if (!leftLit || !rightLit)
+		return kStereoCheckInconclusive;
+
+	uint64_t moreEdges = (evenEdges > oddEdges) ? evenEdges : oddEdges;
+	uint64_t fewerEdges = (evenEdges > oddEdges) ? oddEdges : evenEdges;
+	if (moreEdges * 100 >= pairs && fewerEdges * 10 < moreEdges)
+		return kStereoCheckMono;
+
+	// Both eyes the same, which a 2D menu is as well.
+	if (differing * 100 < samples)
+		return kStereoCheckInconclusive;
+
+	return kStereoCheckStereo;
+}
+
+
+class StereoCopyDevice
+{
+public:
+	virtual ~StereoCopyDevice() { }
+
+	// The stereo copy of this frame straight into the shared target.
+	virtual bool CopyDirect() = 0;
+
+	// The same through the intermediate surface, with the second copy to the
+	// shared target.  Creates the intermediate if it does not have one.
+	virtual bool CopyIntermediate() = 0;
+
+	// For a copy less than full.  The stereo copy goes to the full size
+	// intermediate, and each half of it is then cropped or filtered into its
+	// half of the smaller shared target, as the plan says.
+	virtual bool CopyPlanned(const CopyPlan& plan) = 0;
+
+	// Only used while probing, on the scratch surface, never the shared target.
+	// ClearScratch makes it if there isn't one yet, and fills it with black.
+	// CopyDirectToScratch is the same copy as CopyDirect, into the scratch.
+	// ReadScratch copies it back to system memory, which stays valid until
+	// EndRead.  ReleaseScratch once probing is over.
+	virtual bool ClearScratch() = 0;
+	virtual bool CopyDirectToScratch() = 0;
+	virtual bool ReadScratch(const uint8_t** image, int* pitch, int* width, int* height) = 0;
+	virtual void EndRead() = 0;
+	virtual void ReleaseScratch() = 0;
+};
+
+
+class StereoCopyPath
+{
+public:
+	// Presents between probes that could not tell, and how many to try at all,
+	// so a game that sits in a menu gets about 10 seconds at 60 fps.
+	static const int kProbeInterval = 60;
+	static const int kMaxProbes = 10;
+
+	// Called with new surfaces.  Once decided, the path stays the same across
+	// Reset, it's a property of the driver, not of the surface.
+	void OnNewSurfaces()
+	{
+		countdown = 0;
+	}
+
+	// The copy for one frame.  Returns false if nothing got to the shared target.
+
+	bool Copy(StereoCopyDevice* device)
+	{
+		// The probe only decides the path, the frame still gets its copy below.
+		if (path == kCopyPathUnknown && countdown-- <= 0)
+		{
+			OnProbe(Probe(device));
+			if (path != kCopyPathUnknown)
+				device->ReleaseScratch();
+		}
+
+		if (path == kCopyPathDirect)
+		{
+			if (device->CopyDirect())
+				return true;
+
+			// It worked before, so something changed under us.  Don't risk it.
+			path = kCopyPathIntermediate;
+		}
+
+		return device->CopyIntermediate();
+	}
+
+	// The copy for one frame of the plan in effect.
+
+	bool Copy(StereoCopyDevice* device, const CopyPlan& plan)
+	{
+		if (plan.NeedsIntermediate())
+			return device->CopyPlanned(plan);
+		return Copy(device);
+	}
+
+	// Unknown while still probing, and the intermediate is used in the meantime.
+	KatangaCopyPath Path() const { return path; }
+
+	// Whether new surfaces need the intermediate at all.
+	bool NeedsIntermediate() const { return path != kCopyPathDirect; }
+	bool NeedsIntermediate(const CopyPlan& plan) const { return NeedsIntermediate() || plan.NeedsIntermediate(); }
+
+	int Probes() const { return probes; }
+	StereoCheck LastCheck() const { return lastCheck; }
+
+private:
+	StereoCheck Probe(StereoCopyDevice* device)
+	{
+		if (!device->ClearScratch() || !device->CopyDirectToScratch())
+			return kStereoCheckFailed;
+
+		const uint8_t* image;
+		int pitch, width, height;
+		if (!device->ReadScratch(&image, &pitch, &width, &height))
+			return kStereoCheckInconclusive;
+
+		StereoCheck result = ClassifyStereoCopy(image, pitch, width, height);
+		device->EndRead();
+		return result;
+	}
+
+	void OnProbe(StereoCheck result)
+	{
+		probes++;
+		lastCheck = result;
+
+		if (result == kStereoCheckStereo)
+			path = kCopyPathDirect;
+		else if (result != kStereoCheckInconclusive || probes >= kMaxProbes)
+			path = kCopyPathIntermediate;
+		else
+			countdown = kProbeInterval;
+	}
+
+	KatangaCopyPath path = kCopyPathUnknown;
+	int countdown = 0;
+	int probes = 0;
+	StereoCheck lastCheck = kStereoCheckInconclusive;
+};
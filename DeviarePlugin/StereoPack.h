@@ -0,0 +1,316 @@
+#pragma once
+
+//-----------------------------------------------------------
+// CPU stereo packing, for when the GPU copy cannot give us a side by side frame.
+//
+// The normal DX11 and DX9 paths get the double width stereo surface from the
+// driver, with ReverseStereoBlit or Direct Mode SetActiveEye, and copy it on
+// the GPU.  Without either of those, the eyes have to be arranged on the CPU
+// from mapped memory, and at 4K that is 64M per frame to move around, so the
+// row loops here have SSE2 and AVX2 versions, picked once at runtime.
+//
+// All of the formats we share are 32 bits per pixel, BGRA8, RGBA8, and RGB10A2,
+// and none of these operations look inside a pixel, they only move them.  So
+// every kernel works on uint32_t pixels and is format agnostic.  Half width
+// to full width is pixel doubling, not filtering, for the same reason.
+//
+// Pitches are in bytes, like D3D11_MAPPED_SUBRESOURCE::RowPitch, and widths
+// are in pixels.  Source and destination must not overlap, except for the
+// in place StereoSwapEyes.
+//
+// The scalar kernels are the reference that the SIMD ones must match exactly.
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <emmintrin.h>
+#include <immintrin.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#define STEREO_PACK_SSE2
+#define STEREO_PACK_AVX2
+#else
+#define STEREO_PACK_SSE2 __attribute__((target("sse2")))
+#define STEREO_PACK_AVX2 __attribute__((target("avx2")))
+#endif
+
+
+enum StereoPackLevel
+{
+	kStereoPackScalar = 0,
+	kStereoPackSSE2,
+	kStereoPackAVX2,
+};
+
+// One row at a time, count is in pixels.
+
+struct StereoPackKernels
+{
+	StereoPackLevel level;
+	const wchar_t* name;
+
+	// dst[i] = src[i]
+	void (*copyRow)(uint32_t* dst, const uint32_t* src, size_t count);
+
+	// a[i] <-> b[i]
+	void (*swapRow)(uint32_t* a, uint32_t* b, size_t count);
+
+	// dst[2i] = dst[2i+1] = src[i], so dst is 2*count pixels.
+	void (*doubleRow)(uint32_t* dst, const uint32_t* src, size_t count);
+};
+
+
+// --------------------------------------------------------------------------
+// Scalar reference.
+
+inline void StereoCopyRowScalar(uint32_t* dst, const uint32_t* src, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		dst[i] = src[i];
+}
+
+inline void StereoSwapRowScalar(uint32_t* a, uint32_t* b, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		uint32_t t = a[i];
+		a[i] = b[i];
+		b[i] = t;
+	}
+}
+
+inline void StereoDoubleRowScalar(uint32_t* dst, const uint32_t* src, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		dst[2 * i] = src[i];
+		dst[2 * i + 1] = src[i];
+	}
+}
+
+
+// --------------------------------------------------------------------------
+// SSE2, 4 pixels per register.  Mapped rows are only guaranteed 16 byte
+// aligned at the start of the row, and eye halves can start anywhere, so
+// these all use unaligned loads and stores.
+
+STEREO_PACK_SSE2 inline void StereoCopyRowSSE2(uint32_t* dst, const uint32_t* src, size_t count)
+{
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m128i v0 = _mm_loadu_si128((const __m128i*)(src + i));
+		__m128i v1 = _mm_loadu_si128((const __m128i*)(src + i + 4));
+		_mm_storeu_si128((__m128i*)(dst + i), v0);
+		_mm_storeu_si128((__m128i*)(dst + i + 4), v1);
+	}
+	StereoCopyRowScalar(dst + i, src + i, count - i);
+}
+
+STEREO_PACK_SSE2 inline void StereoSwapRowSSE2(uint32_t* a, uint32_t* b, size_t count)
+{
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+		__m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+		_mm_storeu_si128((__m128i*)(a + i), vb);
+		_mm_storeu_si128((__m128i*)(b + i), va);
+	}
+	StereoSwapRowScalar(a + i, b + i, count - i);
+}
+
+STEREO_PACK_SSE2 inline void StereoDoubleRowSSE2(uint32_t* dst, const uint32_t* src, size_t count)
+{
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+		_mm_storeu_si128((__m128i*)(dst + 2 * i), _mm_unpacklo_epi32(v, v));
+		_mm_storeu_si128((__m128i*)(dst + 2 * i + 4), _mm_unpackhi_epi32(v, v));
+	}
+	StereoDoubleRowScalar(dst + 2 * i, src + i, count - i);
+}
+
+
+// --------------------------------------------------------------------------
+// AVX2, 8 pixels per register.  The zeroupper at the end avoids the AVX to
+// SSE transition penalty in whatever code runs next.
+
+STEREO_PACK_AVX2 inline void StereoCopyRowAVX2(uint32_t* dst, const uint32_t* src, size_t count)
+{
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16)
+	{
+		__m256i v0 = _mm256_loadu_si256((const __m256i*)(src + i));
+		__m256i v1 = _mm256_loadu_si256((const __m256i*)(src + i + 8));
+		_mm256_storeu_si256((__m256i*)(dst + i), v0);
+		_mm256_storeu_si256((__m256i*)(dst + i + 8), v1);
+	}
+	_mm256_zeroupper();
+	StereoCopyRowScalar(dst + i, src + i, count - i);
+}
+
+STEREO_PACK_AVX2 inline void StereoSwapRowAVX2(uint32_t* a, uint32_t* b, size_t count)
+{
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256i va = _mm256_loadu_si256((const __m256i*)(a + i));
+		__m256i vb = _mm256_loadu_si256((const __m256i*)(b + i));
+		_mm256_storeu_si256((__m256i*)(a + i), vb);
+		_mm256_storeu_si256((__m256i*)(b + i), va);
+	}
+	_mm256_zeroupper();
+	StereoSwapRowScalar(a + i, b + i, count - i);
+}
+
+// The 256 bit unpacks work within each 128 bit lane, so for src s0..s7 we get
+// lo = s0 s0 s1 s1 | s4 s4 s5 s5 and hi = s2 s2 s3 s3 | s6 s6 s7 s7, and the
+// lane permutes put those back in order.
+
+STEREO_PACK_AVX2 inline void StereoDoubleRowAVX2(uint32_t* dst, const uint32_t* src, size_t count)
+{
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256i v = _mm256_loadu_si256((const __m256i*)(src + i));
+		__m256i lo = _mm256_unpacklo_epi32(v, v);
+		__m256i hi = _mm256_unpackhi_epi32(v, v);
+		_mm256_storeu_si256((__m256i*)(dst + 2 * i), _mm256_permute2x128_si256(lo, hi, 0x20));
+		_mm256_storeu_si256((__m256i*)(dst + 2 * i + 8), _mm256_permute2x128_si256(lo, hi, 0x31));
+	}
+	_mm256_zeroupper();
+	StereoDoubleRowScalar(dst + 2 * i, src + i, count - i);
+}
+
+
+// --------------------------------------------------------------------------
+// Runtime dispatch.  AVX2 needs both the CPU feature and the OS saving the
+// YMM registers, which is what the XGETBV check is for.
+
+inline StereoPackLevel StereoPackBestLevel()
+{
+#ifdef _MSC_VER
+	int info[4];
+
+	__cpuid(info, 0);
+	int maxLeaf = info[0];
+
+	__cpuid(info, 1);
+	bool sse2 = (info[3] & (1 << 26)) != 0;
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+
+	bool avx2 = false;
+	if (maxLeaf >= 7 && osxsave && avx && (_xgetbv(0) & 0x6) == 0x6)
+	{
+		__cpuidex(info, 7, 0);
+		avx2 = (info[1] & (1 << 5)) != 0;
+	}
+#else
+	__builtin_cpu_init();
+	bool sse2 = __builtin_cpu_supports("sse2");
+	bool avx2 = __builtin_cpu_supports("avx2");
+#endif
+
+	if (avx2)
+		return kStereoPackAVX2;
+	if (sse2)
+		return kStereoPackSSE2;
+	return kStereoPackScalar;
+}
+
+// A specific level, which is mostly useful to check the SIMD kernels against
+// the scalar ones.  Asking for more than the CPU has is the caller's problem.
+
+inline const StereoPackKernels& StereoPackKernelsFor(StereoPackLevel level)
+{
+	static const StereoPackKernels kernels[] =
+	{
+		{ kStereoPackScalar, L"scalar", StereoCopyRowScalar, StereoSwapRowScalar, StereoDoubleRowScalar },
+		{ kStereoPackSSE2, L"SSE2", StereoCopyRowSSE2, StereoSwapRowSSE2, StereoDoubleRowSSE2 },
+		{ kStereoPackAVX2, L"AVX2", StereoCopyRowAVX2, StereoSwapRowAVX2, StereoDoubleRowAVX2 },
+	};
+	return kernels[level];
+}
+
+// The best kernels for this CPU, detected on first use.
+
+inline const StereoPackKernels& StereoPackKernelsBest()
+{
+	static const StereoPackKernels& best = StereoPackKernelsFor(StereoPackBestLevel());
+	return best;
+}
+
+
+// --------------------------------------------------------------------------
+// Whole image operations.  These all write a double width side by side image,
+// and the caller picks which eye is first, so that kLayoutSideBySide, with the
+// right eye on the left half, is just passing the right eye as first.
+
+inline uint32_t* StereoRow(void* base, size_t pitch, uint32_t y)
+{
+	return (uint32_t*)((uint8_t*)base + y * pitch);
+}
+
+inline const uint32_t* StereoRow(const void* base, size_t pitch, uint32_t y)
+{
+	return (const uint32_t*)((const uint8_t*)base + y * pitch);
+}
+
+// Two separate eye images, each eyeWidth x height, into one 2*eyeWidth wide.
+
+inline void StereoPackPair(const StereoPackKernels& k,
+	void* dst, size_t dstPitch,
+	const void* first, size_t firstPitch,
+	const void* second, size_t secondPitch,
+	uint32_t eyeWidth, uint32_t height)
+{
+	for (uint32_t y = 0; y < height; y++)
+	{
+		uint32_t* out = StereoRow(dst, dstPitch, y);
+		k.copyRow(out, StereoRow(first, firstPitch, y), eyeWidth);
+		k.copyRow(out + eyeWidth, StereoRow(second, secondPitch, y), eyeWidth);
+	}
+}
+
+// An over/under image, 2*eyeHeight tall, into side by side.  The top eye
+// ends up on the left half, the same as kLayoutOverUnder to kLayoutSideBySide.
+
+inline void StereoPackOverUnder(const StereoPackKernels& k,
+	void* dst, size_t dstPitch,
+	const void* src, size_t srcPitch,
+	uint32_t eyeWidth, uint32_t eyeHeight)
+{
+	const void* bottom = (const uint8_t*)src + eyeHeight * srcPitch;
+	StereoPackPair(k, dst, dstPitch, src, srcPitch, bottom, srcPitch, eyeWidth, eyeHeight);
+}
+
+// Swap the left and right halves of a side by side image, in place.  This
+// converts between kLayoutSideBySide and kLayoutSideBySideSwapped.
+
+inline void StereoSwapEyes(const StereoPackKernels& k,
+	void* image, size_t pitch,
+	uint32_t eyeWidth, uint32_t height)
+{
+	for (uint32_t y = 0; y < height; y++)
+	{
+		uint32_t* row = StereoRow(image, pitch, y);
+		k.swapRow(row, row + eyeWidth, eyeWidth);
+	}
+}
+
+// A half side by side image, where each eye was squeezed into halfWidth, to
+// full side by side with each eye 2*halfWidth wide.  Doubling every pixel of
+// the whole row doubles both halves in place, so it is one call per row.
+
+inline void StereoExpandHalfSideBySide(const StereoPackKernels& k,
+	void* dst, size_t dstPitch,
+	const void* src, size_t srcPitch,
+	uint32_t halfWidth, uint32_t height)
+{
+	for (uint32_t y = 0; y < height; y++)
+		k.doubleRow(StereoRow(dst, dstPitch, y), StereoRow(src, srcPitch, y), 2 * halfWidth);
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+//-----------------------------------------------------------
+// Per swap chain cache of the objects Hooked_Present needs every frame.
+//
+// Present used to GetDevice and GetImmediateContext on every frame, and then
+// Release them again.  Those never change for a given swap chain, so we fetch
+// them once and keep our own references here, and a cache hit makes no COM
+// calls at all.
+//
+// The back buffer itself is deliberately not cached.  Any reference to it
+// makes the game's ResizeBuffers or ResizeBuffers1 fail with
+// DXGI_ERROR_INVALID_CALL, and keeps the swap chain itself alive.  So Present
+// still does a GetBuffer for buffer 0 every frame.  Its desc is only plain
+// data though, so that is kept here after the first GetDesc, and forgotten
+// from both resize hooks with ForgetBufferDesc, because those are the only
+// way its size or format can change.
+//
+// The swap chain is only the key, and is not AddRef'd, so that we never keep
+// it alive.  The caller must Invalidate the entry when the swap chain is
+// destroyed, before another one can be created at the same address.  On the
+// DX11 side that is done from private data attached to the swap chain, which
+// DXGI releases as the swap chain goes away.
+//
+// This is templated over the interface types, and only ever calls Release on
+// them, so it has no dependency on DX11 itself.  TBufferDesc is whatever the
+// back buffer's GetDesc fills in, D3D11_TEXTURE2D_DESC for DX11.
+
+template <class TSwapChain, class TDevice, class TContext, class TBufferDesc>
+class SwapChainStateCache
+{
+public:
+	// Games nearly always have just the one.  If we see more than this,
+	// the oldest entry is evicted.
+	static const int kMaxSwapChains = 4;
+
+	struct Entry
+	{
+		TSwapChain* swapChain;			// Key only, not AddRef'd.
+		TDevice* device;
+		TContext* context;
+		bool hasBufferDesc;				// Until the first frame, and after a resize.
+		TBufferDesc bufferDesc;
+	};
+
+	Entry* Find(TSwapChain* swapChain)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			if (entries[i].swapChain == swapChain)
+				return &entries[i];
+		}
+		return nullptr;
+	}
+
+	// Takes ownership of one reference on each of device and context, which
+	// are normally the ones returned by GetDevice/GetImmediateContext.
+
+	Entry* Insert(TSwapChain* swapChain, TDevice* device, TContext* context)
+	{
+		Invalidate(swapChain);
+
+		if (count == kMaxSwapChains)
+			Evict(0);
+
+		Entry* entry = &entries[count++];
+		entry->swapChain = swapChain;
+		entry->device = device;
+		entry->context = context;
+		entry->hasBufferDesc = false;
+
+		return entry;
+	}
+
+	// The swap chain is being resized, so its back buffer will not match the
+	// desc we have.  The device and context stay, they don't change.
+
+	void ForgetBufferDesc(TSwapChain* swapChain)
+	{
+		Entry* entry = Find(swapChain);
+		if (entry != nullptr)
+			entry->hasBufferDesc = false;
+	}
+
+	void Invalidate(TSwapChain* swapChain)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			if (entries[i].swapChain == swapChain)
+			{
+				Evict(i);
+				return;
+			}
+		}
+	}
+
+	void Clear()
+	{
+		while (count > 0)
+			Evict(count - 1);
+	}
+
+	int Count() const
+	{
+		return count;
+	}
+
+private:
+	// Release our references, and slide the rest down, to keep oldest first.
+
+	void Evict(int index)
+	{
+		Entry& entry = entries[index];
+		if (entry.context)
+			entry.context->Release();
+		if (entry.device)
+			entry.device->Release();
+
+		for (int i = index; i < count - 1; i++)
+			entries[i] = entries[i + 1];
+		count--;
+	}
+
+	Entry entries[kMaxSwapChains];
+	int count = 0;
+};
@@ -0,0 +1,258 @@
+#pragma once
+
+//-----------------------------------------------------------
+// Remembers where Present and friends live in each build of dxgi.dll and d3d9.dll.
+//
+// To find IDXGISwapChain::Present or IDirect3DDevice9::Present, we create a
+// window, a device and a swapchain, only to read one slot of the vtable.  That
+// costs tens to hundreds of milliseconds at game launch, and some overlays and
+// anti-cheat code do not like a second device showing up.  But the address only
+// depends on the build of the system dll it is in, so we keep it on disk, as an
+// offset from the module base, keyed by that build.  The dummy device is only
+// made when the cache has nothing for the dll that is loaded.
+//
+// A build is the module name, and from its PE header, the machine, the link
+// TimeDateStamp and the SizeOfImage.  Windows Update replaces the dll, and
+// with it those, so an old entry is just never found again.  Storing a slot
+// for a new build drops that slot's entries for older builds of the module.
+//
+// The file is text, one slot per line, after a version line:
+//
+//		KatangaVtableCache 1
+//		dxgi.dll 8664 5E3B2A1C 000F2000 Present 00012A40
+//
+// Fields are the module, then hex machine, timestamp, size, the slot name and
+// its offset.  Anything we can't read is skipped, and a different version
+// line skips the whole file, so it can always be deleted or just rebuilt.
+//
+// InProc reads the PE header straight out of the loaded module with
+// ReadModuleBuild.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+
+struct VtableModuleBuild
+{
+	char name[32];					// Lower case, like "dxgi.dll".
+	uint32_t machine;				// IMAGE_FILE_HEADER.Machine, 0x14C or 0x8664.
+	uint32_t timeDateStamp;
+	uint32_t sizeOfImage;
+
+	bool operator==(const VtableModuleBuild& other) const
+	{
+		return strcmp(name, other.name) == 0 && machine == other.machine &&
+			timeDateStamp == other.timeDateStamp && sizeOfImage == other.sizeOfImage;
+	}
+};
+
+
+// Fills in build from the PE headers at the start of a module image, of which
+// length bytes can be read.  Returns false if it does not look like a PE.
+
+inline bool ReadModuleBuild(const uint8_t* image, size_t length, const char* name, VtableModuleBuild* build)
+{
+	const uint32_t kNtHeadersOffset = 0x3C;		// IMAGE_DOS_HEADER.e_lfanew
+	const uint32_t kFileHeaderSize = 20;
+	const uint32_t kSizeOfImageOffset = 56;		// Same in PE32 and PE32+.
+
+	if (image == nullptr || length < kNtHeadersOffset + 4 || image[0] != 'M' || image[1] != 'Z')
+		return false;
+
+	uint32_t nt;
+	memcpy(&nt, image + kNtHeadersOffset, sizeof(nt));
+	if (nt > length || length - nt < 4 + kFileHeaderSize + kSizeOfImageOffset + 4)
+		return false;
+	if (memcmp(image + nt, "PE\0\0", 4) != 0)
+		return false;
+
+	uint16_t machine;
+	memcpy(&machine, image + nt + 4, sizeof(machine));
+	memcpy(&build->timeDateStamp, image + nt + 4 + 4, sizeof(build->timeDateStamp));
+	memcpy(&build->sizeOfImage, image + nt + 4 + kFileHeaderSize + kSizeOfImageOffset, sizeof(build->sizeOfImage));
+	build->machine = machine;
+
+	size_t i = 0;
+	for (; name[i] != '\0' && i < sizeof(build->name) - 1; i++)
+		build->name[i] = (name[i] >= 'A' && name[i] <= 'Z') ? (char)(name[i] - 'A' + 'a') : name[i];
+	build->name[i] = '\0';
+
+	return build->sizeOfImage != 0;
+}
+
+
+class VtableCache
+{
+public:
+	static const int kVersion = 1;
+	static const size_t kMaxEntries = 64;
+
+	// Replaces what we had with the text of the cache file.  Returns the number
+	// of entries read.
+
+	size_t Load(const char* text)
+	{
+		entries.clear();
+		badLines = 0;
+
+		int line = 0;
+		while (text != nullptr && *text != '\0')
+		{
+			const char* end = text;
+			while (*end != '\0' && *end != '\n')
+				end++;
+			std::string current(text, end - text);
+			text = (*end == '\n') ? end + 1 : end;
+
+			if (line++ == 0)
+			{
+				char header[32];
+				snprintf(header, sizeof(header), "KatangaVtableCache %d", kVersion);
+				if (current.compare(0, current.find_last_not_of(" \t\r") + 1, header) != 0)
+					break;
+				continue;
+			}
+
+			Entry entry;
+			if (!ParseLine(current.c_str(), &entry))
+			{
+				if (current.find_first_not_of(" \t\r") != std::string::npos)
+					badLines++;
+				continue;
+			}
+			if (entries.size() < kMaxEntries)
+				Put(entry);
+		}
+		return entries.size();
+	}
+
+	std::string Save() const
+	{
+		std::string text;
+		char line[160];
+		snprintf(line, sizeof(line), "KatangaVtableCache %d\n", kVersion);
+		text += line;
+		for (const Entry& entry : entries)
+		{
+			snprintf(line, sizeof(line), "%s %X %08X %08X %s %08X\n", entry.build.name, entry.build.machine,
+				entry.build.timeDateStamp, entry.build.sizeOfImage, entry.slot, entry.offset);
+			text += line;
+		}
+		return text;
+	}
+
+	// The offset of slot from the module base, if we have one for this build.
+
+	bool Find(const VtableModuleBuild& build, const char* slot, uint32_t* offset) const
+	{
+		for (const Entry& entry : entries)
+		{
+			if (entry.build == build && strcmp(entry.slot, slot) == 0)
+			{
+				*offset = entry.offset;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Returns true if that changed the cache, so it needs to be saved.
+
+	bool Store(const VtableModuleBuild& build, const char* slot, uint32_t offset)
+	{
+		Entry entry = Entry();
+		entry.build = build;
+		entry.offset = offset;
+		if (strlen(slot) >= sizeof(entry.slot) || !Valid(entry.build, offset))
+			return false;
+		memcpy(entry.slot, slot, strlen(slot) + 1);
+
+		uint32_t existing;
+		if (Find(build, slot, &existing) && existing == offset)
+			return false;
+
+		Put(entry);
+		if (entries.size() > kMaxEntries)
+			entries.erase(entries.begin());
+		return true;
+	}
+
+	size_t Count() const { return entries.size(); }
+	int BadLines() const { return badLines; }
+
+private:
+	struct Entry
+	{
+		VtableModuleBuild build;
+		char slot[32];
+		uint32_t offset;
+	};
+
+	static bool Valid(const VtableModuleBuild& build, uint32_t offset)
+	{
+		return build.name[0] != '\0' && build.sizeOfImage != 0 && offset != 0 && offset < build.sizeOfImage;
+	}
+
+	static bool ParseLine(const char* line, Entry* entry)
+	{
+		*entry = Entry();
+		return ParseWord(&line, entry->build.name, sizeof(entry->build.name)) &&
+			ParseHex(&line, &entry->build.machine) &&
+			ParseHex(&line, &entry->build.timeDateStamp) &&
+			ParseHex(&line, &entry->build.sizeOfImage) &&
+			ParseWord(&line, entry->slot, sizeof(entry->slot)) &&
+			ParseHex(&line, &entry->offset) &&
+			line[strspn(line, " \t\r")] == '\0' &&
+			Valid(entry->build, entry->offset);
+	}
+
+	static bool ParseWord(const char** line, char* word, size_t size)
+	{
+		const char* start = *line + strspn(*line, " \t");
+		size_t length = strcspn(start, " \t\r");
+		if (length == 0 || length >= size)
+			return false;
+		memcpy(word, start, length);
+		word[length] = '\0';
+		*line = start + length;
+		return true;
+	}
+
+	// strtoull, because unsigned long is 32 bits on Windows, where strtoul
+	// would clamp a value too big to 0xFFFFFFFF instead.
+
+	static bool ParseHex(const char** line, uint32_t* value)
+	{
+		char word[12];
+		char* end;
+		if (!ParseWord(line, word, sizeof(word)))
+			return false;
+		unsigned long long parsed = strtoull(word, &end, 16);
+		if (*end != '\0' || parsed > 0xFFFFFFFFull)
+			return false;
+		*value = (uint32_t)parsed;
+		return true;
+	}
+
+	// Any other build of the same module and slot is out of date.
+	void Put(const Entry& entry)
+	{
+		for (size_t i = 0; i < entries.size(); )
+		{
+			const Entry& other = entries[i];
+			if (strcmp(other.build.name, entry.build.name) == 0 && other.build.machine == entry.build.machine &&
+				strcmp(other.slot, entry.slot) == 0)
+				entries.erase(entries.begin() + i);
+			else
+				i++;
+		}
+		entries.push_back(entry);
+	}
+
+	std::vector<Entry> entries;
+	int badLines = 0;
+};
@@ -0,0 +1,224 @@
+// Tests of AsyncLog.h, through a temporary file, the same way the plugins use
+// it.  The formatting is done on the writer thread, so every line here is read
+// back from the file after Stop.
+
+#include "AsyncLog.h"
+
+#include <gtest/gtest.h>
+
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+static std::vector<std::wstring> ReadLines(FILE* file)
+{
+	std::vector<std::wstring> lines;
+	wchar_t line[AsyncLog::kLineChars + 2];
+
+	rewind(file);
+	while (fgetws(line, AsyncLog::kLineChars + 2, file))
+	{
+		std::wstring text(line);
+		if (!text.empty() && text.back() == L'\n')
+			text.pop_back();
+		lines.push_back(text);
+	}
+	return lines;
+}
+
+// Logs a single line, and reads it back.
+template <size_t N, class... Args>
+static std::wstring FormatOne(const wchar_t (&fmt)[N], Args... args)
+{
+	FILE* file = tmpfile();
+	AsyncLog log;
+	log.Start(file);
+	log.WriteLiteral(fmt, args...);
+	log.Stop();
+
+	std::vector<std::wstring> lines = ReadLines(file);
+	fclose(file);
+	return lines.empty() ? std::wstring(L"<none>") : lines[0];
+}
+
+
+TEST(AsyncLog, FormatsIntegers)
+{
+	EXPECT_EQ(FormatOne(L"%d %u %i\n", -5, 7u, (short)-3), L"-5 7 -3");
+	EXPECT_EQ(FormatOne(L"%5d|%-4d|%03d\n", 42, 7, 9), L"   42|7   |009");
+	EXPECT_EQ(FormatOne(L"%llu %lld\n", 18446744073709551615ull, -9000000000ll),
+		L"18446744073709551615 -9000000000");
+	EXPECT_EQ(FormatOne(L"%zu %IX\n", (size_t)123, (size_t)0xABC), L"123 ABC");
+}
+
+TEST(AsyncLog, HexIsMaskedToTheCallersSize)
+{
+	// An HRESULT is a negative 32 bit long on Windows, and must not come out
+	// sign extended to 64 bits.
+	int32_t hr = (int32_t)0x887A0005;
+	EXPECT_EQ(FormatOne(L"hr=0x%x\n", hr), L"hr=0x887a0005");
+	EXPECT_EQ(FormatOne(L"hr=0x%X\n", hr), L"hr=0x887A0005");
+	EXPECT_EQ(FormatOne(L"%08x\n", 0xBEEFu), L"0000beef");
+	EXPECT_EQ(FormatOne(L"%hhx\n", (int)0x1FF), L"ff");
+}
+
+TEST(AsyncLog, FormatsFloatsPointersAndChars)
+{
+	EXPECT_EQ(FormatOne(L"%.2f ms\n", 1.2345f), L"1.23 ms");
+	EXPECT_EQ(FormatOne(L"%c%c\n", L'o', 'k'), L"ok");
+
+	void* pointer = reinterpret_cast<void*>((uintptr_t)0x1234);
+	std::wstring formatted = FormatOne(L"%p\n", pointer);
+	EXPECT_NE(formatted.find(L"1234"), std::wstring::npos) << formatted;
+	EXPECT_EQ(FormatOne(L"100%%\n"), L"100%");
+}
+
+TEST(AsyncLog, FormatsStringsAsMSVCDoes)
+{
+	// In the MSVC wide printf, %s is wide and %S narrow, whatever they are.
+	EXPECT_EQ(FormatOne(L"[%s]\n", L"wide"), L"[wide]");
+	EXPECT_EQ(FormatOne(L"[%S]\n", "narrow"), L"[narrow]");
+	EXPECT_EQ(FormatOne(L"[%ls] [%hs]\n", L"ls", "hs"), L"[ls] [hs]");
+	EXPECT_EQ(FormatOne(L"[%s]\n", (const wchar_t*)nullptr), L"[(null)]");
+}
+
+TEST(AsyncLog, MissingArgumentsDoNotCrash)
+{
+	std::wstring formatted = FormatOne(L"%d %s\n", 1);
+	EXPECT_EQ(formatted.compare(0, 2, L"1 "), 0) << formatted;
+}
+
+TEST(AsyncLog, CopiesBuffersThatTheCallerReuses)
+{
+	FILE* file = tmpfile();
+	AsyncLog log;
+	log.Start(file);
+
+	// Both the format and the string argument are stack buffers, changed
+	// right after each Write, before the writer can have looked at them.
+	wchar_t format[64];
+	wchar_t name[32];
+	for (int i = 0; i < 3; i++)
+	{
+		swprintf(format, 64, L"line %d: %%d\n", i);
+		swprintf(name, 32, L"name%d", i);
+		log.Write(format, i * 10);
+		log.Write(L"arg %s\n", name);
+		wcscpy(format, L"clobbered\n");
+		wcscpy(name, L"clobbered");
+	}
+	log.Stop();
+
+	std::vector<std::wstring> lines = ReadLines(file);
+	fclose(file);
+	ASSERT_EQ(lines.size(), 6u);
+	EXPECT_EQ(lines[0], L"line 0: 0");
+	EXPECT_EQ(lines[1], L"arg name0");
+	EXPECT_EQ(lines[4], L"line 2: 20");
+	EXPECT_EQ(lines[5], L"arg name2");
+}
+
+// A const buffer has the same type as a literal, but is gone once its scope
+// ends, which is long before the writer gets to it.  This one lives in storage
+// we then reuse, so that a format kept as a pointer reads the junk after it.
+
+struct ConstFormat
+{
+	const wchar_t text[16];
+};
+
+TEST(AsyncLog, CopiesConstBuffersThatGoOutOfScope)
+{
+	FILE* file = tmpfile();
+	AsyncLog log;
+	log.Start(file);
+
+	alignas(ConstFormat) wchar_t storage[sizeof(ConstFormat) / sizeof(wchar_t)];
+	for (int i = 0; i < 3; i++)
+	{
+		{
+			ConstFormat* format = new (storage) ConstFormat{ L"const %d\n" };
+			log.Write(format->text, i);
+			format->~ConstFormat();
+		}
+		wmemset(storage, L'#', sizeof(storage) / sizeof(wchar_t) - 1);
+		storage[sizeof(storage) / sizeof(wchar_t) - 1] = 0;
+	}
+	log.Flush();
+
+	std::vector<std::wstring> lines = ReadLines(file);
+	fseek(file, 0, SEEK_END);
+	log.Stop();
+	fclose(file);
+
+	ASSERT_EQ(lines.size(), 3u);
+	EXPECT_EQ(lines[0], L"const 0");
+	EXPECT_EQ(lines[2], L"const 2");
+}
+
+TEST(AsyncLog, LongTextIsTruncated)
+{
+	std::wstring longText(AsyncLog::kTextChars * 2, L'x');
+	std::wstring formatted = FormatOne(L"%s|%s\n", longText.c_str(), L"tail");
+	EXPECT_LT(formatted.size(), (size_t)AsyncLog::kLineChars);
+	EXPECT_EQ(formatted.compare(0, 4, L"xxxx"), 0);
+}
+
+TEST(AsyncLog, FlushWritesEverythingQueued)
+{
+	FILE* file = tmpfile();
+	AsyncLog log;
+	log.Start(file);
+	for (int i = 0; i < 50; i++)
+		log.Write(L"%d\n", i);
+	log.Flush();
+
+	std::vector<std::wstring> lines = ReadLines(file);
+	fseek(file, 0, SEEK_END);
+	log.Stop();
+	fclose(file);
+
+	ASSERT_EQ(lines.size(), 50u);
+	EXPECT_EQ(lines[49], L"49");
+}
+
+TEST(AsyncLog, ManyProducersLoseNothingUncounted)
+{
+	const int kThreads = 4;
+	const int kLines = 5000;
+
+	FILE* file = tmpfile();
+	AsyncLog log;
+	log.Start(file);
+
+	std::vector<std::thread> producers;
+	for (int t = 0; t < kThreads; t++)
+	{
+		producers.emplace_back([&log, t]() {
+			for (int i = 0; i < kLines; i++)
+				log.Write(L"producer %d line %d\n", t, i);
+		});
+	}
+	for (std::thread& producer : producers)
+		producer.join();
+	log.Stop();
+
+	// Every line either made it whole, or was counted as dropped, and each
+	// drop was noted once in the log itself.
+	std::vector<std::wstring> lines = ReadLines(file);
+	fclose(file);
+
+	uint64_t written = 0;
+	for (const std::wstring& line : lines)
+	{
+		if (line.compare(0, 9, L"producer ") == 0)
+			written++;
+	}
+	EXPECT_EQ(written + log.Dropped(), (uint64_t)(kThreads * kLines));
+	if (log.Dropped() == 0)
+	{
+		EXPECT_EQ(lines.size(), written);
+	}
+}
@@ -0,0 +1,269 @@
+// Tests of CopyPlan.h, the plans made for each copy request, and when
+// CopyModeNegotiator decides a new request from the VR side is worth new
+// shared surfaces.
+
+#include "CopyPlan.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+
+
+// Taken by reference in EXPECT_EQ, which the class constant can't be.
+static const int kSettle = CopyModeNegotiator::kSettlePresents;
+
+static const CopySource kEye = { 1920, 1080, 28, kScaleMipHalving, true };
+
+// A crop of about the middle third of the eye, moved right by nudge.
+static uint64_t Crop(uint32_t nudge = 0)
+{
+	const uint32_t third = kKatangaCropScale / 3;
+	return KatangaPackCopyRequest(kCopyModeCrop, third + nudge, third, third, third);
+}
+
+static int PresentsUntilChanged(CopyModeNegotiator* modes, uint64_t request, int limit = 1000)
+{
+	for (int presents = 1; presents <= limit; presents++)
+	{
+		if (modes->Changed(request))
+			return presents;
+	}
+	return -1;
+}
+
+
+TEST(CopyPlanTest, NewRequestAfterItSettles)
+{
+	CopyModeNegotiator modes;
+	modes.Begin(kEye, 0);
+
+	uint64_t half = KatangaPackCopyRequest(kCopyModeHalf, 0, 0, 0, 0);
+	EXPECT_EQ(PresentsUntilChanged(&modes, half), kSettle);
+
+	// It stays decided until the new surfaces take it.
+	EXPECT_TRUE(modes.Changed(half));
+	EXPECT_TRUE(modes.Changed(half));
+
+	modes.Begin(kEye, half);
+	EXPECT_EQ(modes.Plan().mode, kCopyModeHalf);
+	EXPECT_FALSE(modes.Changed(half));
+}
+
+TEST(CopyPlanTest, SmallCropMovesAreNotAChange)
+{
+	CopyModeNegotiator modes;
+	modes.Begin(kEye, Crop());
+	ASSERT_EQ(modes.Plan().mode, kCopyModeCrop);
+
+	EXPECT_EQ(PresentsUntilChanged(&modes, Crop(kCopyRequestSlack)), -1);
+	EXPECT_EQ(PresentsUntilChanged(&modes, Crop(kCopyRequestSlack * 4)), kSettle);
+}
+
+// Head movement within the slack of where the run started still settles, a
+// jump past it starts the count over.
+
+TEST(CopyPlanTest, WobbleSettlesAndJumpsStartOver)
+{
+	CopyModeNegotiator modes;
+	modes.Begin(kEye, 0);
+
+	int presents = 0;
+	bool changed = false;
+	while (!changed && presents < 1000)
+	{
+		presents++;
+		changed = modes.Changed(Crop((presents % 2) ? kCopyRequestSlack : 0));
+	}
+	EXPECT_EQ(presents, kSettle);
+
+	modes.Begin(kEye, 0);
+	for (int i = 0; i < kSettle - 1; i++)
+		EXPECT_FALSE(modes.Changed(Crop()));
+	EXPECT_EQ(PresentsUntilChanged(&modes, Crop(kCopyRequestSlack * 4)), kSettle);
+}
+
+// A steady request that comes out as the same copy is remembered, and the
+// surfaces are kept.
+
+TEST(CopyPlanTest, SteadyRequestForTheSameCopyIsKept)
+{
+	CopySource unfilterable = kEye;
+	unfilterable.filterable = false;
+
+	CopyModeNegotiator modes;
+	modes.Begin(unfilterable, 0);
+
+	uint64_t half = KatangaPackCopyRequest(kCopyModeHalf, 0, 0, 0, 0);
+	EXPECT_EQ(PresentsUntilChanged(&modes, half), -1);
+	EXPECT_EQ(modes.Plan().request, half);
+	EXPECT_EQ(modes.Plan().mode, kCopyModeFull);
+}
+
+
+// ------------------------------------------------------------------------
+// Plans
+
+TEST(CopyPlanTest, RequestsPackAndUnpack)
+{
+	uint32_t crop[4];
+	uint64_t request = KatangaPackCopyRequest(kCopyModeCrop, 1, 2, kKatangaCropScale, 40000);
+	EXPECT_EQ(KatangaUnpackCopyRequest(request, crop), kCopyModeCrop);
+	EXPECT_EQ(crop[0], 1u);
+	EXPECT_EQ(crop[1], 2u);
+	EXPECT_EQ(crop[2], kKatangaCropScale);
+	EXPECT_EQ(crop[3], 0x7FFFu);					// Clamped, not into the next field.
+
+	EXPECT_EQ(KatangaUnpackCopyRequest(0, crop), kCopyModeFull);
+	EXPECT_EQ(crop[2], 0u);
+}
+
+TEST(CopyPlanTest, FullCopiesStraightFromTheBackbuffer)
+{
+	CopyPlan plan = PlanCopy(kEye, 0);
+	EXPECT_EQ(plan.mode, kCopyModeFull);
+	EXPECT_FALSE(plan.NeedsIntermediate());
+	EXPECT_FALSE(plan.NeedsMips());
+	EXPECT_FALSE(plan.Scales());
+	EXPECT_EQ(plan.width, 3840u);
+	EXPECT_EQ(plan.height, 1080u);
+	EXPECT_EQ(plan.half[0], (CopyRect{ 0, 0, 1920, 1080 }));
+	EXPECT_EQ(plan.half[1], (CopyRect{ 1920, 0, 1920, 1080 }));
+	EXPECT_EQ(CopyPlanBytes(plan, 28), 3840ull * 1080 * 4);
+	EXPECT_EQ(CopyPlanBytes(plan, 10), 3840ull * 1080 * 8);
+	EXPECT_EQ(CopyPlanBytes(plan, 0), 3840ull * 1080 * 4);
+
+	// A mode we don't know is a full copy too.
+	EXPECT_EQ(PlanCopy(kEye, 7).mode, kCopyModeFull);
+}
+
+// DX11 reads level 1 of the intermediate, where the eyes meet in the middle.
+TEST(CopyPlanTest, HalfThroughMips)
+{
+	CopyPlan plan = PlanCopy(kEye, KatangaPackCopyRequest(kCopyModeHalf, 0, 0, 0, 0));
+	EXPECT_EQ(plan.mode, kCopyModeHalf);
+	EXPECT_TRUE(plan.NeedsIntermediate());
+	EXPECT_TRUE(plan.NeedsMips());
+	EXPECT_EQ(plan.readLevel, 1u);
+	EXPECT_EQ(plan.width, 1920u);
+	EXPECT_EQ(plan.height, 540u);
+	EXPECT_EQ(plan.half[0], (CopyRect{ 0, 0, 960, 540 }));
+	EXPECT_EQ(plan.half[1], (CopyRect{ 960, 0, 960, 540 }));
+
+	// An odd height drops the last row, an odd width can't be halved at all.
+	CopySource odd = kEye;
+	odd.eyeHeight = 1081;
+	plan = PlanCopy(odd, KatangaPackCopyRequest(kCopyModeHalf, 0, 0, 0, 0));
+	EXPECT_EQ(plan.mode, kCopyModeHalf);
+	EXPECT_EQ(plan.destHeight, 540u);
+	EXPECT_EQ(plan.source, (CopyRect{ 0, 0, 1920, 1080 }));
+
+	odd.eyeWidth = 1921;
+	EXPECT_EQ(PlanCopy(odd, KatangaPackCopyRequest(kCopyModeHalf, 0, 0, 0, 0)).mode, kCopyModeFull);
+}
+
+// DX9 stretches each half, any size, rounding up.
+TEST(CopyPlanTest, HalfThroughStretch)
+{
+	CopySource stretch = { 1921, 1081, 87, kScaleStretch, true };
+	CopyPlan plan = PlanCopy(stretch, KatangaPackCopyRequest(kCopyModeHalf, 0, 0, 0, 0));
+	EXPECT_EQ(plan.mode, kCopyModeHalf);
+	EXPECT_FALSE(plan.NeedsMips());
+	EXPECT_TRUE(plan.Scales());
+	EXPECT_EQ(plan.destWidth, 961u);
+	EXPECT_EQ(plan.destHeight, 541u);
+	EXPECT_EQ(plan.width, 1922u);
+	EXPECT_EQ(plan.half[0], (CopyRect{ 0, 0, 1921, 1081 }));
+	EXPECT_EQ(plan.half[1], (CopyRect{ 1921, 0, 1921, 1081 }));
+}
+
+// Only formats we know filter well, on a device that says so, and not tiny.
+TEST(CopyPlanTest, HalfNeedsAFilterableFormat)
+{
+	const uint64_t half = KatangaPackCopyRequest(kCopyModeHalf, 0, 0, 0, 0);
+	CopySource source = kEye;
+	for (const CopyFormat& known : kCopyFormats)
+	{
+		source.format = known.format;
+		EXPECT_EQ(PlanCopy(source, half).mode, known.filterable ? kCopyModeHalf : kCopyModeFull) << known.format;
+	}
+	source.format = 2;								// R32G32B32A32_FLOAT, not in the table.
+	EXPECT_EQ(PlanCopy(source, half).mode, kCopyModeFull);
+
+	source = kEye;
+	source.filterable = false;
+	EXPECT_EQ(PlanCopy(source, half).mode, kCopyModeFull);
+
+	source = kEye;
+	source.eyeWidth = 2;
+	source.eyeHeight = 1;
+	EXPECT_EQ(PlanCopy(source, half).mode, kCopyModeFull);
+}
+
+// A crop is rounded out to the step, still covers what was asked for, and
+// stays inside the eye.
+TEST(CopyPlanTest, CropRoundsOutInsideTheEye)
+{
+	CopyPlan plan = PlanCopy(kEye, KatangaPackCopyRequest(kCopyModeCrop, 0, 0, kKatangaCropScale / 2, kKatangaCropScale / 2));
+	EXPECT_EQ(plan.mode, kCopyModeCrop);
+	EXPECT_EQ(plan.source, (CopyRect{ 0, 0, 960, 544 }));
+	EXPECT_FALSE(plan.Scales());
+	EXPECT_EQ(plan.width, 1920u);
+	EXPECT_EQ(plan.half[1], (CopyRect{ 1920, 0, 960, 544 }));
+
+	const uint32_t kStarts[] = { 0, 1, 777, 5461, 9000, 15000, kKatangaCropScale - 1 };
+	const uint32_t kLengths[] = { 1, 100, 3000, 5461, 8000 };
+	for (uint32_t start : kStarts)
+	{
+		for (uint32_t length : kLengths)
+		{
+			uint32_t x, width;
+			CropAxis(start, length, 1920, &x, &width);
+			SCOPED_TRACE(testing::Message() << start << " + " << length);
+			EXPECT_EQ(width % kCopyCropStep, 0u);
+			EXPECT_LE(x + width, 1920u);
+			uint64_t first = (uint64_t)start * 1920 / kKatangaCropScale;
+			uint64_t last = std::min<uint64_t>(((uint64_t)start + length) * 1920 / kKatangaCropScale, 1920);
+			EXPECT_LE(x, std::min<uint64_t>(first, 1919));
+			EXPECT_GE(x + width, last);
+		}
+	}
+
+	// Right up against the far edge.
+	plan = PlanCopy(kEye, KatangaPackCopyRequest(kCopyModeCrop, 16000, 16000, 300, 300));
+	EXPECT_EQ(plan.source.x + plan.source.width, 1920u);
+	EXPECT_EQ(plan.source.y + plan.source.height, 1080u);
+}
+
+// Empty, or nearly all of the eye, is a full copy.
+TEST(CopyPlanTest, CropsNotWorthIt)
+{
+	EXPECT_EQ(PlanCopy(kEye, KatangaPackCopyRequest(kCopyModeCrop, 0, 0, 0, 100)).mode, kCopyModeFull);
+	EXPECT_EQ(PlanCopy(kEye, KatangaPackCopyRequest(kCopyModeCrop, 0, 0, 100, 0)).mode, kCopyModeFull);
+	EXPECT_EQ(PlanCopy(kEye, KatangaPackCopyRequest(kCopyModeCrop, 0, 0, kKatangaCropScale, kKatangaCropScale)).mode,
+		kCopyModeFull);
+	EXPECT_EQ(PlanCopy(kEye, KatangaPackCopyRequest(kCopyModeCrop, 100, 100, 16000, 16000)).mode, kCopyModeFull);
+
+	CopySource none = kEye;
+	none.eyeWidth = 0;
+	EXPECT_EQ(PlanCopy(none, Crop()).mode, kCopyModeFull);
+
+	// An eye smaller than the step is cropped to all of it.
+	CopySource tiny = { 20, 20, 28, kScaleMipHalving, true };
+	EXPECT_EQ(PlanCopy(tiny, Crop()).mode, kCopyModeFull);
+}
+
+TEST(CopyPlanTest, SameCopy)
+{
+	// Both round out to the same 960x544.
+	const uint32_t quarter = kKatangaCropScale / 2;
+	CopyPlan a = PlanCopy(kEye, KatangaPackCopyRequest(kCopyModeCrop, 0, 0, quarter, quarter));
+	CopyPlan b = PlanCopy(kEye, KatangaPackCopyRequest(kCopyModeCrop, 0, 0, quarter - 2, quarter - 2));
+	EXPECT_NE(a.request, b.request);
+	EXPECT_TRUE(SameCopy(a, b));
+	EXPECT_FALSE(SameCopy(a, PlanCopy(kEye, Crop())));
+	EXPECT_FALSE(SameCopy(a, PlanCopy(kEye, 0)));
+
+	CopySource bigger = kEye;
+	bigger.eyeWidth = 2560;
+	EXPECT_FALSE(SameCopy(PlanCopy(kEye, 0), PlanCopy(bigger, 0)));
+}
@@ -0,0 +1,1112 @@
+// Tests of FrameCapture.h and CaptureSinks.h, with a synthetic frame source for
+// a device, whose copies can be held up like a busy GPU, and a sink that can be
+// held up or made to fail like a slow disk.
+
+#include "FrameCapture.h"
+#include "CaptureSinks.h"
+
+#include <gtest/gtest.h>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+// Taken by reference in EXPECT_EQ, which the class constant can't be.
+static const int kSlots = FrameCapture::kSlots;
+
+// Every pixel of every frame is different, so a sink that gets the wrong slot,
+// or one overwritten while it was writing, shows up.
+static uint32_t SourcePixel(int64_t frame, uint32_t x, uint32_t y)
+{
+	return (uint32_t)(frame << 20) ^ (y << 10) ^ x;
+}
+
+// The device's staging textures are plain memory, with a pitch wider than the
+// rows like the real ones.  The copy is done at once, but TryMap can be made to
+// say pending busyPolls times first.  Only ever called on the render thread,
+// like the real one, and it checks the rules FrameCapture has to keep.
+
+class SyntheticCaptureDevice : public CaptureDevice
+{
+public:
+	struct Staging
+	{
+		std::vector<uint8_t> pixels;
+		bool mapped;
+		int busy;
+	};
+
+	bool CreateStaging(int count, uint32_t width, uint32_t height, uint32_t format) override
+	{
+		EXPECT_EQ(count, kSlots);
+		EXPECT_TRUE(staging.empty());
+		creates++;
+		if (failCreate)
+			return false;
+		pitch = width * 4 + 64;
+		staging.assign(count, Staging{ std::vector<uint8_t>((size_t)pitch * height), false, 0 });
+		(void)format;
+		return true;
+	}
+
+	void ReleaseStaging() override
+	{
+		for (const Staging& slot : staging)
+			EXPECT_FALSE(slot.mapped);
+		staging.clear();
+		releases++;
+	}
+
+	bool Copy(int slot) override
+	{
+		EXPECT_LT(slot, (int)staging.size());
+		if (slot >= (int)staging.size())
+			return false;
+		EXPECT_FALSE(staging[slot].mapped) << "copy into a slot the sink may be reading";
+		if (failCopy)
+			return false;
+
+		for (uint32_t y = 0; y < height; y++)
+		{
+			uint32_t* row = reinterpret_cast<uint32_t*>(staging[slot].pixels.data() + (size_t)y * pitch);
+			for (uint32_t x = 0; x < width; x++)
+				row[x] = SourcePixel(frame, x, y);
+		}
+		staging[slot].busy = busyPolls;
+		copies++;
+		return true;
+	}
+
+	CaptureMap TryMap(int slot, const uint8_t** pixels, uint32_t* rowPitch) override
+	{
+		if (beforeMap)
+			beforeMap();
+		EXPECT_FALSE(staging[slot].mapped);
+		if (failMap)
+		{
+			failMap = false;
+			return kCaptureMapFailed;
+		}
+		if (staging[slot].busy-- > 0)
+			return kCaptureMapPending;
+		staging[slot].mapped = true;
+		*pixels = staging[slot].pixels.data();
+		*rowPitch = pitch;
+		maps++;
+		return kCaptureMapReady;
+	}
+
+	void Unmap(int slot) override
+	{
+		EXPECT_TRUE(staging[slot].mapped);
+		staging[slot].mapped = false;
+		unmaps++;
+	}
+
+	int Mapped() const
+	{
+		int count = 0;
+		for (const Staging& slot : staging)
+			count += slot.mapped ? 1 : 0;
+		return count;
+	}
+
+	// The source, what the game drew this frame.
+	uint32_t width = 64;
+	uint32_t height = 32;
+	int64_t frame = 0;
+
+	int busyPolls = 0;
+	bool failCreate = false;
+	bool failCopy = false;
+	bool failMap = false;				// Just the next one.
+	std::function<void()> beforeMap;
+
+	int creates = 0;
+	int releases = 0;
+	int copies = 0;
+	int maps = 0;
+	int unmaps = 0;
+
+	uint32_t pitch = 0;
+	std::vector<Staging> staging;
+};
+
+
+// What the sink saw, kept by the test since FrameCapture deletes the sink.
+struct SinkLog
+{
+	struct Entry
+	{
+		uint64_t index;
+		int64_t timestamp;
+		uint32_t width;
+		uint32_t height;
+		bool pixelsMatch;
+	};
+
+	std::vector<Entry> Entries()
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		return entries;
+	}
+
+	size_t Count()
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		return entries.size();
+	}
+
+	std::mutex lock;
+	std::vector<Entry> entries;
+	std::atomic<bool> hold{ false };
+	std::atomic<bool> writing{ false };
+	std::atomic<bool> fail{ false };
+	std::atomic<int> closes{ 0 };
+	std::atomic<bool> deleted{ false };
+};
+
+class RecordingSink : public CaptureSink
+{
+public:
+	RecordingSink(SinkLog* log) : log(log) { }
+	~RecordingSink() { log->deleted = true; }
+
+	bool Write(const CaptureFrame& frame) override
+	{
+		log->writing = true;
+		while (log->hold)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+		bool match = true;
+		for (uint32_t y = 0; y < frame.height && match; y++)
+		{
+			const uint32_t* row = reinterpret_cast<const uint32_t*>(frame.pixels + (size_t)y * frame.pitch);
+			for (uint32_t x = 0; x < frame.width && match; x++)
+				match = (row[x] == SourcePixel(frame.timestamp, x, y));
+		}
+		{
+			std::lock_guard<std::mutex> guard(log->lock);
+			log->entries.push_back(SinkLog::Entry{ frame.index, frame.timestamp, frame.width, frame.height, match });
+		}
+		log->writing = false;
+		return !log->fail;
+	}
+
+	void Close() override { log->closes++; }
+
+private:
+	SinkLog* log;
+};
+
+template <typename Predicate>
+static bool WaitUntil(Predicate done)
+{
+	for (int i = 0; i < 5000; i++)
+	{
+		if (done())
+			return true;
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return done();
+}
+
+// One game frame.  The timestamp is the frame number, which is what the sink
+// checks the pixels against.
+
+static void Frame(FrameCapture* capture, SyntheticCaptureDevice* device)
+{
+	CaptureSource source = { device->width, device->height, kCaptureR8G8B8A8Unorm, kLayoutSideBySide, device->frame };
+	capture->OnFrame(device, source);
+	device->frame++;
+}
+
+// Then waits for the writer to be through everything mapped so far, so the
+// next frame's Reclaim finds all of it written.
+
+static void SettledFrame(FrameCapture* capture, SyntheticCaptureDevice* device, SinkLog* log)
+{
+	Frame(capture, device);
+	int maps = device->maps;
+	EXPECT_TRUE(WaitUntil([&] { return log->Count() == (size_t)maps && !log->writing; }));
+	// Written is set after the sink returns, give it a moment.
+	std::this_thread::sleep_for(std::chrono::milliseconds(2));
+}
+
+
+// ------------------------------------------------------------------------
+// The staging ring
+
+TEST(FrameCapture, FramesReachTheSinkInOrder)
+{
+	SyntheticCaptureDevice device;
+	SinkLog log;
+	FrameCapture capture;
+	capture.Request(new RecordingSink(&log), 1);
+	EXPECT_FALSE(capture.Active());
+
+	for (int i = 0; i < 10; i++)
+		SettledFrame(&capture, &device, &log);
+	EXPECT_TRUE(capture.Active());
+	EXPECT_EQ(device.creates, 1);
+
+	// The last copy is never mapped, each frame maps the one before.
+	std::vector<SinkLog::Entry> entries = log.Entries();
+	ASSERT_EQ(entries.size(), 9u);
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		EXPECT_EQ(entries[i].index, i);
+		EXPECT_EQ(entries[i].timestamp, (int64_t)i);
+		EXPECT_EQ(entries[i].width, 64u);
+		EXPECT_EQ(entries[i].height, 32u);
+		EXPECT_TRUE(entries[i].pixelsMatch) << "frame " << i;
+	}
+
+	CaptureStats stats = capture.Stats();
+	EXPECT_EQ(stats.written, 9u);
+	EXPECT_EQ(stats.dropped, 0u);
+	EXPECT_EQ(stats.failed, 0u);
+	EXPECT_EQ(stats.bytes, 9u * 64 * 4 * 32);
+	EXPECT_GT(stats.elapsedNs, 0);
+	EXPECT_EQ(CaptureStatValue(stats, kCaptureStatWritten), 9.0);
+	EXPECT_GT(CaptureStatValue(stats, kCaptureStatMBPerSecond), 0.0);
+	EXPECT_GE(CaptureStatValue(stats, kCaptureStatWriteMs), 0.0);
+
+	// Every written slot was unmapped on the frame after, but the last one.
+	EXPECT_EQ(device.unmaps, 8);
+	EXPECT_EQ(device.Mapped(), 1);
+
+	capture.Shutdown(&device);
+	EXPECT_FALSE(capture.Active());
+	EXPECT_EQ(device.Mapped(), 0);
+	EXPECT_EQ(device.unmaps, 9);
+	EXPECT_EQ(device.releases, 2);				// Before the create too.
+	EXPECT_TRUE(device.staging.empty());
+	EXPECT_EQ(log.closes, 1);
+	EXPECT_TRUE(log.deleted);
+}
+
+TEST(FrameCapture, IntervalSkipsFrames)
+{
+	SyntheticCaptureDevice device;
+	SinkLog log;
+	FrameCapture capture;
+	capture.Request(new RecordingSink(&log), 3);
+
+	for (int i = 0; i < 10; i++)
+		SettledFrame(&capture, &device, &log);
+	capture.Shutdown(&device);
+
+	// Frames 0, 3, 6 and 9 are copied, 9 never gets mapped.
+	std::vector<SinkLog::Entry> entries = log.Entries();
+	ASSERT_EQ(entries.size(), 3u);
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		EXPECT_EQ(entries[i].index, i);
+		EXPECT_EQ(entries[i].timestamp, (int64_t)i * 3);
+		EXPECT_TRUE(entries[i].pixelsMatch);
+	}
+	EXPECT_EQ(device.copies, 4);
+	EXPECT_EQ(capture.Stats().dropped, 0u);
+}
+
+// With the sink stuck on the first frame, the ring fills and frames are
+// dropped, but OnFrame never waits and nothing the sink has is unmapped.
+
+TEST(FrameCapture, FullRingDropsFramesAndReleasesAfterTheSink)
+{
+	SyntheticCaptureDevice device;
+	SinkLog log;
+	log.hold = true;
+	FrameCapture capture;
+	capture.Request(new RecordingSink(&log), 1);
+
+	for (int i = 0; i < 6; i++)
+	{
+		auto start = std::chrono::steady_clock::now();
+		Frame(&capture, &device);
+		EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(500));
+	}
+	ASSERT_TRUE(WaitUntil([&] { return log.writing.load(); }));
+
+	// Frames 0 to 3 fill the ring and are all mapped by frame 4, 4 and 5 are
+	// dropped.
+	EXPECT_EQ(device.copies, kSlots);
+	EXPECT_EQ(device.Mapped(), kSlots);
+	EXPECT_EQ(device.unmaps, 0);
+	EXPECT_EQ(capture.Stats().dropped, 2u);
+	EXPECT_EQ(capture.Stats().written, 0u);
+
+	log.hold = false;
+	ASSERT_TRUE(WaitUntil([&] { return capture.Stats().written == (uint64_t)kSlots; }));
+
+	// The next frame unmaps all of them, and copies into one again.
+	SettledFrame(&capture, &device, &log);
+	EXPECT_EQ(device.unmaps, kSlots);
+	EXPECT_EQ(device.copies, kSlots + 1);
+	SettledFrame(&capture, &device, &log);
+	capture.Shutdown(&device);
+
+	// No gaps in the index, the drops never got one.
+	std::vector<SinkLog::Entry> entries = log.Entries();
+	ASSERT_EQ(entries.size(), 5u);
+	const int64_t kTimestamps[] = { 0, 1, 2, 3, 6 };
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		EXPECT_EQ(entries[i].index, i);
+		EXPECT_EQ(entries[i].timestamp, kTimestamps[i]);
+		EXPECT_TRUE(entries[i].pixelsMatch) << "frame " << i;
+	}
+	EXPECT_EQ(capture.Stats().dropped, 2u);
+	EXPECT_EQ(device.Mapped(), 0);
+}
+
+// Copies the GPU isn't done with are tried again each frame, oldest first, and
+// nothing is lost while there is room.
+
+TEST(FrameCapture, PendingCopiesAreMappedInOrder)
+{
+	SyntheticCaptureDevice device;
+	device.busyPolls = 1;
+	SinkLog log;
+	FrameCapture capture;
+	capture.Request(new RecordingSink(&log), 1);
+
+	Frame(&capture, &device);
+	Frame(&capture, &device);
+	EXPECT_EQ(device.maps, 0);
+	for (int i = 0; i < 18; i++)
+		SettledFrame(&capture, &device, &log);
+	capture.Shutdown(&device);
+
+	std::vector<SinkLog::Entry> entries = log.Entries();
+	ASSERT_EQ(entries.size(), 18u);
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		EXPECT_EQ(entries[i].index, i);
+		EXPECT_EQ(entries[i].timestamp, (int64_t)i);
+		EXPECT_TRUE(entries[i].pixelsMatch);
+	}
+	EXPECT_EQ(capture.Stats().dropped, 0u);
+	EXPECT_EQ(device.Mapped(), 0);
+}
+
+// ------------------------------------------------------------------------
+// Failures
+
+TEST(FrameCapture, FailedMapFreesTheSlot)
+{
+	SyntheticCaptureDevice device;
+	SinkLog log;
+	FrameCapture capture;
+	capture.Request(new RecordingSink(&log), 1);
+
+	SettledFrame(&capture, &device, &log);
+	device.failMap = true;
+	SettledFrame(&capture, &device, &log);
+	SettledFrame(&capture, &device, &log);
+
+	CaptureStats stats = capture.Stats();
+	EXPECT_EQ(stats.failed, 1u);
+	EXPECT_EQ(stats.written, 1u);
+	std::vector<SinkLog::Entry> entries = log.Entries();
+	ASSERT_EQ(entries.size(), 1u);
+	EXPECT_EQ(entries[0].index, 1u);
+
+	// The failed one is free again, the ring is still all there.
+	for (int i = 0; i < 2 * kSlots; i++)
+		SettledFrame(&capture, &device, &log);
+	EXPECT_EQ(capture.Stats().dropped, 0u);
+	capture.Shutdown(&device);
+}
+
+TEST(FrameCapture, FailedCopyTakesNoIndex)
+{
+	SyntheticCaptureDevice device;
+	device.failCopy = true;
+	SinkLog log;
+	FrameCapture capture;
+	capture.Request(new RecordingSink(&log), 1);
+
+	SettledFrame(&capture, &device, &log);
+	device.failCopy = false;
+	SettledFrame(&capture, &device, &log);
+	SettledFrame(&capture, &device, &log);
+	capture.Shutdown(&device);
+
+	EXPECT_EQ(capture.Stats().failed, 1u);
+	std::vector<SinkLog::Entry> entries = log.Entries();
+	ASSERT_EQ(entries.size(), 1u);
+	EXPECT_EQ(entries[0].index, 0u);
+	EXPECT_EQ(entries[0].timestamp, 1);
+}
+
+TEST(FrameCapture, FailedWriteStillReleasesTheSlot)
+{
+	SyntheticCaptureDevice device;
+	SinkLog log;
+	log.fail = true;
+	FrameCapture capture;
+	capture.Request(new RecordingSink(&log), 1);
+
+	for (int i = 0; i < 2 * kSlots; i++)
+		SettledFrame(&capture, &device, &log);
+
+	CaptureStats stats = capture.Stats();
+	EXPECT_EQ(stats.written, 0u);
+	EXPECT_EQ(stats.failed, (uint64_t)(2 * kSlots - 1));
+	EXPECT_EQ(stats.bytes, 0u);
+	EXPECT_EQ(stats.dropped, 0u);
+	EXPECT_EQ(device.unmaps, 2 * kSlots - 2);
+	capture.Shutdown(&device);
+	EXPECT_EQ(device.Mapped(), 0);
+}
+
+TEST(FrameCapture, FailedStagingDropsAndTriesAgain)
+{
+	SyntheticCaptureDevice device;
+	device.failCreate = true;
+	SinkLog log;
+	FrameCapture capture;
+	capture.Request(new RecordingSink(&log), 1);
+
+	SettledFrame(&capture, &device, &log);
+	CaptureStats stats = capture.Stats();
+	EXPECT_EQ(stats.failed, 1u);
+	EXPECT_EQ(stats.dropped, 1u);
+
+	device.failCreate = false;
+	SettledFrame(&capture, &device, &log);
+	SettledFrame(&capture, &device, &log);
+	EXPECT_EQ(device.creates, 2);
+	EXPECT_EQ(log.Count(), 1u);
+	capture.Shutdown(&device);
+}
+
+// ------------------------------------------------------------------------
+// Size changes
+
+TEST(FrameCapture, NewSizeRecreatesTheStaging)
+{
+	SyntheticCaptureDevice device;
+	SinkLog log;
+	FrameCapture capture;
+	capture.Request(new RecordingSink(&log), 1);
+
+	for (int i = 0; i < 3; i++)
+		SettledFrame(&capture, &device, &log);
+
+	// Frame 2 is mapped on the frame of the new size, so that one is dropped
+	// while the sink has it, and the next one gets the new staging.
+	device.width = 32;
+	device.height = 16;
+	log.hold = true;
+	Frame(&capture, &device);
+	EXPECT_EQ(capture.Stats().dropped, 1u);
+	EXPECT_EQ(device.creates, 1);
+	log.hold = false;
+	ASSERT_TRUE(WaitUntil([&] { return capture.Stats().written == 3; }));
+	SettledFrame(&capture, &device, &log);
+	SettledFrame(&capture, &device, &log);
+	EXPECT_EQ(device.creates, 2);
+	EXPECT_EQ(device.releases, 2);
+	EXPECT_EQ(capture.Stats().dropped, 1u);
+	capture.Shutdown(&device);
+
+	std::vector<SinkLog::Entry> entries = log.Entries();
+	ASSERT_EQ(entries.size(), 4u);
+	EXPECT_EQ(entries[2].width, 64u);
+	EXPECT_TRUE(entries[2].pixelsMatch);
+	EXPECT_EQ(entries[3].index, 3u);
+	EXPECT_EQ(entries[3].timestamp, 4);
+	EXPECT_EQ(entries[3].width, 32u);
+	EXPECT_EQ(entries[3].height, 16u);
+	EXPECT_TRUE(entries[3].pixelsMatch);
+}
+
+// The old staging can't go while the sink still has one of its slots.
+
+TEST(FrameCapture, NewSizeWaitsForTheSink)
+{
+	SyntheticCaptureDevice device;
+	SinkLog log;
+	log.hold = true;
+	FrameCapture capture;
+	capture.Request(new RecordingSink(&log), 1);
+
+	Frame(&capture, &device);
+	Frame(&capture, &device);
+	ASSERT_TRUE(WaitUntil([&] { return log.writing.load(); }));
+
+	device.width = 128;
+	Frame(&capture, &device);
+	EXPECT_EQ(capture.Stats().dropped, 1u);
+	EXPECT_EQ(device.creates, 1);
+
+	log.hold = false;
+	ASSERT_TRUE(WaitUntil([&] { return capture.Stats().written == 2; }));
+	SettledFrame(&capture, &device, &log);
+	SettledFrame(&capture, &device, &log);
+	EXPECT_EQ(device.creates, 2);
+	capture.Shutdown(&device);
+
+	std::vector<SinkLog::Entry> entries = log.Entries();
+	ASSERT_EQ(entries.size(), 3u);
+	EXPECT_EQ(entries[1].width, 64u);
+	EXPECT_EQ(entries[2].width, 128u);
+	EXPECT_TRUE(entries[2].pixelsMatch);
+}
+
+// A slot the writer finishes between the frame's Reclaim and the new size is
+// unmapped before its staging goes.
+
+TEST(FrameCapture, NewSizeUnmapsWhatTheSinkJustFinished)
+{
+	SyntheticCaptureDevice device;
+	device.busyPolls = 1;
+	SinkLog log;
+	FrameCapture capture;
+	capture.Request(new RecordingSink(&log), 1);
+
+	// Two copies pending, on the next frame the first maps, and by the time
+	// the second is polled the sink is through the first.
+	Frame(&capture, &device);
+	Frame(&capture, &device);
+	device.beforeMap = [&]
+	{
+		if (device.maps == 1)
+		{
+			EXPECT_TRUE(WaitUntil([&] { return capture.Stats().written == 1 && !log.writing; }));
+			std::this_thread::sleep_for(std::chrono::milliseconds(2));
+		}
+	};
+	device.width = 32;
+	Frame(&capture, &device);
+	device.beforeMap = nullptr;
+
+	EXPECT_EQ(device.creates, 2);
+	EXPECT_EQ(device.unmaps, 1);
+	EXPECT_EQ(capture.Stats().dropped, 0u);
+	SettledFrame(&capture, &device, &log);
+	SettledFrame(&capture, &device, &log);
+	capture.Shutdown(&device);
+
+	std::vector<SinkLog::Entry> entries = log.Entries();
+	ASSERT_EQ(entries.size(), 2u);
+	EXPECT_EQ(entries[1].width, 32u);
+	EXPECT_TRUE(entries[1].pixelsMatch);
+}
+
+TEST(FrameCapture, EmptySourceIsDropped)
+{
+	SyntheticCaptureDevice device;
+	device.width = 0;
+	SinkLog log;
+	FrameCapture capture;
+	capture.Request(new RecordingSink(&log), 1);
+
+	Frame(&capture, &device);
+	EXPECT_EQ(capture.Stats().dropped, 1u);
+	EXPECT_EQ(device.creates, 0);
+	EXPECT_EQ(device.copies, 0);
+	capture.Shutdown(&device);
+}
+
+// ------------------------------------------------------------------------
+// Requests
+
+TEST(FrameCapture, StopAndStartAnotherSink)
+{
+	SyntheticCaptureDevice device;
+	SinkLog first, second;
+	FrameCapture capture;
+	capture.Request(new RecordingSink(&first), 1);
+	for (int i = 0; i < 3; i++)
+		SettledFrame(&capture, &device, &first);
+
+	// Stopping only happens at the next frame.
+	capture.Request(nullptr, 1);
+	EXPECT_TRUE(capture.Active());
+	EXPECT_EQ(first.closes, 0);
+	Frame(&capture, &device);
+	EXPECT_FALSE(capture.Active());
+	EXPECT_EQ(first.closes, 1);
+	EXPECT_TRUE(first.deleted);
+	EXPECT_EQ(first.Count(), 2u);
+	EXPECT_EQ(device.releases, 2);
+	EXPECT_EQ(device.Mapped(), 0);
+
+	// A new sink starts over, from index 0.
+	device.maps = 0;
+	capture.Request(new RecordingSink(&second), 1);
+	for (int i = 0; i < 3; i++)
+		SettledFrame(&capture, &device, &second);
+	EXPECT_EQ(capture.Stats().written, 2u);
+	std::vector<SinkLog::Entry> entries = second.Entries();
+	ASSERT_EQ(entries.size(), 2u);
+	EXPECT_EQ(entries[0].index, 0u);
+	EXPECT_TRUE(entries[0].pixelsMatch);
+	capture.Shutdown(&device);
+	EXPECT_TRUE(second.deleted);
+}
+
+// A second request before the frame replaces the first, which is never used.
+
+TEST(FrameCapture, LatestRequestWins)
+{
+	SyntheticCaptureDevice device;
+	SinkLog first, second;
+	FrameCapture capture;
+	capture.Request(new RecordingSink(&first), 1);
+	capture.Request(new RecordingSink(&second), 1);
+	EXPECT_TRUE(first.deleted);
+	EXPECT_EQ(first.closes, 0);
+
+	SettledFrame(&capture, &device, &second);
+	SettledFrame(&capture, &device, &second);
+	capture.Shutdown(&device);
+	EXPECT_EQ(second.Count(), 1u);
+	EXPECT_EQ(first.Count(), 0u);
+}
+
+
+// ------------------------------------------------------------------------
+// Sinks, fed through a FrameCapture from the synthetic source.
+
+class CaptureSinkTest : public testing::Test
+{
+protected:
+	void SetUp() override
+	{
+		char pattern[] = "/tmp/KatangaCaptureXXXXXX";
+		ASSERT_NE(mkdtemp(pattern), nullptr);
+		directory = std::string(pattern) + "/";
+	}
+
+	void TearDown() override
+	{
+		for (const std::string& file : files)
+			unlink(file.c_str());
+		files.clear();
+		rmdir(directory.c_str());
+	}
+
+	std::vector<uint8_t> ReadFile(const std::string& name)
+	{
+		std::vector<uint8_t> data;
+		FILE* file = fopen((directory + name).c_str(), "rb");
+		if (file == nullptr)
+			return data;
+		uint8_t buffer[4096];
+		size_t read;
+		while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+			data.insert(data.end(), buffer, buffer + read);
+		fclose(file);
+		return data;
+	}
+
+	void Capture(CaptureSink* sink, int frames)
+	{
+		FrameCapture capture;
+		capture.Request(sink, 1);
+		for (int i = 0; i < frames; i++)
+		{
+			Frame(&capture, &device);
+			WaitUntil([&] { return capture.Stats().written + capture.Stats().failed == (uint64_t)device.maps; });
+		}
+		capture.Shutdown(&device);
+		stats = capture.Stats();
+	}
+
+	// The sinks open files by name, which are kept to clean up.
+	static FILE* Open(const char* path)
+	{
+		files.push_back(path);
+		return fopen(path, "wb");
+	}
+
+	static FILE* FailOpen(const char*)
+	{
+		return nullptr;
+	}
+
+	static std::vector<std::string> files;
+	std::string directory;
+	SyntheticCaptureDevice device;
+	CaptureStats stats;
+};
+
+std::vector<std::string> CaptureSinkTest::files;
+
+
+TEST_F(CaptureSinkTest, RawPacksRowsOfEveryFrame)
+{
+	device.width = 48;
+	device.height = 8;
+	Capture(new RawCaptureSink(directory + "frames.raw", Open), 4);
+	EXPECT_EQ(stats.written, 3u);
+
+	const size_t kRowBytes = 48 * 4;
+	std::vector<uint8_t> data = ReadFile("frames.raw");
+	ASSERT_EQ(data.size(), 3 * kRowBytes * 8);
+	for (int64_t frame = 0; frame < 3; frame++)
+	{
+		for (uint32_t y = 0; y < 8; y++)
+		{
+			const uint8_t* row = data.data() + (frame * 8 + y) * kRowBytes;
+			for (uint32_t x = 0; x < 48; x++)
+			{
+				uint32_t pixel;
+				memcpy(&pixel, row + x * 4, 4);
+				ASSERT_EQ(pixel, SourcePixel(frame, x, y)) << "frame " << frame << " at " << x << "," << y;
+			}
+		}
+	}
+
+	std::vector<uint8_t> info = ReadFile("frames.raw.txt");
+	EXPECT_EQ(std::string(info.begin(), info.end()),
+		"width=48 height=8 format=28 layout=1 bytesPerRow=192 pixel=rgba\n");
+}
+
+TEST_F(CaptureSinkTest, RawRefusesANewSize)
+{
+	RawCaptureSink sink(directory + "frames.raw", Open);
+	std::vector<uint32_t> pixels(16 * 16);
+	CaptureFrame frame = { reinterpret_cast<uint8_t*>(pixels.data()), 16 * 4, 16, 16, kCaptureB8G8R8A8Unorm, kLayoutMono, 0, 0 };
+	EXPECT_TRUE(sink.Write(frame));
+	frame.width = 8;
+	EXPECT_FALSE(sink.Write(frame));
+	frame.width = 16;
+	frame.format = kCaptureR8G8B8A8Unorm;
+	EXPECT_FALSE(sink.Write(frame));
+	frame.format = kCaptureB8G8R8A8Unorm;
+	EXPECT_TRUE(sink.Write(frame));
+	sink.Close();
+
+	EXPECT_EQ(ReadFile("frames.raw").size(), 2u * 16 * 16 * 4);
+	std::vector<uint8_t> info = ReadFile("frames.raw.txt");
+	EXPECT_NE(std::string(info.begin(), info.end()).find("pixel=bgra"), std::string::npos);
+}
+
+TEST_F(CaptureSinkTest, RawFailsWhenItCantOpen)
+{
+	RawCaptureSink sink(directory + "frames.raw", FailOpen);
+	std::vector<uint32_t> pixels(4);
+	CaptureFrame frame = { reinterpret_cast<uint8_t*>(pixels.data()), 8, 2, 2, kCaptureR8G8B8A8Unorm, kLayoutMono, 0, 0 };
+	EXPECT_FALSE(sink.Write(frame));
+	sink.Close();
+}
+
+// ------------------------------------------------------------------------
+
+// Known values, "123456789" is the CRC check string, and Adler's own example.
+TEST(PngCaptureSink, ChecksumsMatchKnownValues)
+{
+	const uint8_t* check = reinterpret_cast<const uint8_t*>("123456789");
+	EXPECT_EQ(PngCaptureSink::Crc32(0, check, 9), 0xCBF43926u);
+	EXPECT_EQ(PngCaptureSink::Crc32(PngCaptureSink::Crc32(0, check, 4), check + 4, 5), 0xCBF43926u);
+
+	const uint8_t* wikipedia = reinterpret_cast<const uint8_t*>("Wikipedia");
+	EXPECT_EQ(PngCaptureSink::Adler32(1, wikipedia, 9), 0x11E60398u);
+
+	// Past the run where the sums have to be reduced.
+	std::vector<uint8_t> ones(100000, 0xFF);
+	uint32_t a = 1, b = 0;
+	for (uint8_t byte : ones)
+	{
+		a = (a + byte) % 65521;
+		b = (b + a) % 65521;
+	}
+	EXPECT_EQ(PngCaptureSink::Adler32(1, ones.data(), ones.size()), (b << 16) | a);
+}
+
+// Reads back a PNG the sink wrote, checking every chunk's CRC, the stored
+// deflate blocks and the Adler, and returns the RGB rows with their filter
+// bytes.  Only what PngCaptureSink writes, this is no PNG decoder.
+
+static bool ReadStoredPng(const std::vector<uint8_t>& file, uint32_t* width, uint32_t* height,
+	std::vector<uint8_t>* rows, int* blocks)
+{
+	static const uint8_t kSignature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	if (file.size() < 8 || memcmp(file.data(), kSignature, 8) != 0)
+		return false;
+
+	auto get32 = [](const uint8_t* p) { return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3]; };
+	std::vector<uint8_t> zlib;
+	bool ended = false;
+	size_t at = 8;
+	while (at + 12 <= file.size() && !ended)
+	{
+		uint32_t length = get32(&file[at]);
+		if (at + 12 + length > file.size())
+			return false;
+		std::string type(file.begin() + at + 4, file.begin() + at + 8);
+		const uint8_t* data = &file[at + 8];
+		uint32_t crc = PngCaptureSink::Crc32(0, &file[at + 4], 4 + length);
+		EXPECT_EQ(get32(data + length), crc) << type;
+
+		if (type == "IHDR")
+		{
+			*width = get32(data);
+			*height = get32(data + 4);
+			EXPECT_EQ(data[8], 8);
+			EXPECT_EQ(data[9], 2);
+		}
+		else if (type == "IDAT")
+			zlib.insert(zlib.end(), data, data + length);
+		else if (type == "IEND")
+			ended = true;
+		at += 12 + length;
+	}
+	if (!ended || at != file.size() || zlib.size() < 6 || zlib[0] != 0x78 || (zlib[0] * 256 + zlib[1]) % 31 != 0)
+		return false;
+
+	rows->clear();
+	*blocks = 0;
+	size_t in = 2;
+	for (bool last = false; !last; )
+	{
+		if (in + 5 > zlib.size() || (zlib[in] & 6) != 0)
+			return false;
+		last = (zlib[in] & 1) != 0;
+		uint16_t length = (uint16_t)(zlib[in + 1] | zlib[in + 2] << 8);
+		uint16_t inverse = (uint16_t)(zlib[in + 3] | zlib[in + 4] << 8);
+		if ((uint16_t)~length != inverse || in + 5 + length > zlib.size())
+			return false;
+		rows->insert(rows->end(), zlib.begin() + in + 5, zlib.begin() + in + 5 + length);
+		in += 5 + length;
+		(*blocks)++;
+	}
+	return in + 4 == zlib.size() && get32(&zlib[in]) == PngCaptureSink::Adler32(1, rows->data(), rows->size());
+}
+
+TEST_F(CaptureSinkTest, PngHasTheFramePixels)
+{
+	// Big enough for two deflate blocks.
+	device.width = 200;
+	device.height = 120;
+	Capture(new PngCaptureSink(directory + "shot", Open), 2);
+
+	uint32_t width = 0, height = 0;
+	std::vector<uint8_t> rows;
+	int blocks;
+	ASSERT_TRUE(ReadStoredPng(ReadFile("shot000000.pns"), &width, &height, &rows, &blocks));
+	EXPECT_EQ(width, 200u);
+	EXPECT_EQ(height, 120u);
+	EXPECT_GE(blocks, 2);
+	ASSERT_EQ(rows.size(), (size_t)120 * (1 + 200 * 3));
+
+	// RGBA in, RGB out, alpha dropped.
+	for (uint32_t y = 0; y < 120; y++)
+	{
+		const uint8_t* row = &rows[y * (1 + 200 * 3)];
+		ASSERT_EQ(row[0], 0);
+		for (uint32_t x = 0; x < 200; x++)
+		{
+			uint32_t pixel = SourcePixel(0, x, y);
+			ASSERT_EQ(row[1 + x * 3], (uint8_t)pixel) << x << "," << y;
+			ASSERT_EQ(row[2 + x * 3], (uint8_t)(pixel >> 8)) << x << "," << y;
+			ASSERT_EQ(row[3 + x * 3], (uint8_t)(pixel >> 16)) << x << "," << y;
+		}
+	}
+	EXPECT_TRUE(ReadFile("shot000001.pns").empty());	// Never mapped.
+}
+
+// BGRA swapped to RGB, and the halves swapped so the right eye is on the
+// left, in a .pns.  Mono is a plain .png.
+
+TEST(PngCaptureSinkLayout, SwappedHalvesAndNames)
+{
+	static std::vector<std::string> names;
+	names.clear();
+	struct Memory
+	{
+		static FILE* Open(const char* path)
+		{
+			names.push_back(path);
+			return tmpfile();
+		}
+	};
+
+	// Four pixels, each byte says which pixel and channel it is.
+	uint8_t pixels[16];
+	for (int i = 0; i < 16; i++)
+		pixels[i] = (uint8_t)((i / 4) * 16 + i % 4);
+	CaptureFrame frame = { pixels, 16, 4, 1, kCaptureB8G8R8A8Srgb, kLayoutSideBySideSwapped, 7, 0 };
+
+	// Only the names here, the pixels are checked from real files below.
+	PngCaptureSink sink("cap", Memory::Open);
+	EXPECT_TRUE(sink.Write(frame));
+	frame.layout = kLayoutMono;
+	frame.index = 8;
+	EXPECT_TRUE(sink.Write(frame));
+	frame.layout = kLayoutSideBySide;
+	frame.index = 9;
+	EXPECT_TRUE(sink.Write(frame));
+	ASSERT_EQ(names.size(), 3u);
+	EXPECT_EQ(names[0], "cap000007.pns");
+	EXPECT_EQ(names[1], "cap000008.png");
+	EXPECT_EQ(names[2], "cap000009.pns");
+
+	frame.format = kCaptureR16G16B16A16First;
+	EXPECT_FALSE(sink.Write(frame));
+	frame.format = 89;
+	EXPECT_FALSE(sink.Write(frame));
+	frame.format = kCaptureB8G8R8X8Unorm;
+	frame.width = 0;
+	EXPECT_FALSE(sink.Write(frame));
+	EXPECT_EQ(names.size(), 3u);
+}
+
+TEST_F(CaptureSinkTest, PngSwapsHalvesAndChannels)
+{
+	uint8_t pixels[2 * 16];
+	for (int i = 0; i < 32; i++)
+		pixels[i] = (uint8_t)((i / 4) * 16 + i % 4);
+	CaptureFrame frame = { pixels, 16, 4, 2, kCaptureB8G8R8A8Unorm, kLayoutSideBySideSwapped, 3, 0 };
+	PngCaptureSink sink(directory + "eyes", Open);
+	ASSERT_TRUE(sink.Write(frame));
+
+	uint32_t width, height;
+	std::vector<uint8_t> rows;
+	int blocks;
+	ASSERT_TRUE(ReadStoredPng(ReadFile("eyes000003.pns"), &width, &height, &rows, &blocks));
+	EXPECT_EQ(blocks, 1);
+
+	// Source pixels 2, 3, 0, 1 of each row, as R G B from B G R A.
+	const uint8_t kExpected[2][13] =
+	{
+		{ 0, 0x22, 0x21, 0x20, 0x32, 0x31, 0x30, 0x02, 0x01, 0x00, 0x12, 0x11, 0x10 },
+		{ 0, 0x62, 0x61, 0x60, 0x72, 0x71, 0x70, 0x42, 0x41, 0x40, 0x52, 0x51, 0x50 },
+	};
+	ASSERT_EQ(rows.size(), sizeof(kExpected));
+	EXPECT_EQ(memcmp(rows.data(), kExpected, sizeof(kExpected)), 0);
+}
+
+TEST_F(CaptureSinkTest, PngFailsWhenItCantOpen)
+{
+	device.width = 8;
+	device.height = 8;
+	Capture(new PngCaptureSink(directory + "shot", FailOpen), 3);
+	EXPECT_EQ(device.maps, 2);
+	EXPECT_EQ(stats.written, 0u);
+	EXPECT_EQ(stats.failed, 2u);
+	EXPECT_EQ(device.unmaps, 2);
+}
+
+// ------------------------------------------------------------------------
+
+// Zeroed, and aligned like CaptureRingHeader, which new won't do before C++17.
+struct RingMemory
+{
+	RingMemory(size_t size) : bytes(size + 64, 0) { }
+
+	void* Get()
+	{
+		return bytes.data() + (64 - (uintptr_t)bytes.data() % 64) % 64;
+	}
+
+	std::vector<uint8_t> bytes;
+};
+
+TEST_F(CaptureSinkTest, MemoryRingHoldsTheLatestFrame)
+{
+	const uint32_t kRingSlots = 3;
+	const uint64_t kPixelBytes = 64 * 32 * 4;
+	RingMemory ring(CaptureRingSize(kRingSlots, kPixelBytes));
+	void* memory = ring.Get();
+
+	CaptureRingSlot info;
+	std::vector<uint8_t> pixels(kPixelBytes);
+	EXPECT_FALSE(CaptureRingRead(memory, &info, pixels.data(), pixels.size()));
+
+	FrameCapture capture;
+	capture.Request(new MemoryRingCaptureSink(memory, kRingSlots, kPixelBytes), 1);
+	for (int i = 0; i < 6; i++)
+	{
+		Frame(&capture, &device);
+		ASSERT_TRUE(WaitUntil([&] { return capture.Stats().written == (uint64_t)device.maps; }));
+		if (i == 0)
+			continue;
+
+		// Each frame, the one before it is in the ring, round the slots.
+		ASSERT_TRUE(CaptureRingRead(memory, &info, pixels.data(), pixels.size()));
+		EXPECT_EQ(info.index, (uint64_t)i - 1);
+		EXPECT_EQ(info.timestamp, i - 1);
+		EXPECT_EQ(info.width, 64u);
+		EXPECT_EQ(info.height, 32u);
+		EXPECT_EQ(info.rowBytes, 64u * 4);
+		EXPECT_EQ(info.format, (uint32_t)kCaptureR8G8B8A8Unorm);
+		EXPECT_EQ(info.layout, (uint32_t)kLayoutSideBySide);
+		for (uint32_t y = 0; y < 32; y++)
+		{
+			for (uint32_t x = 0; x < 64; x++)
+			{
+				uint32_t pixel;
+				memcpy(&pixel, &pixels[(y * 64 + x) * 4], 4);
+				ASSERT_EQ(pixel, SourcePixel(i - 1, x, y));
+			}
+		}
+	}
+
+	const CaptureRingHeader* header = static_cast<const CaptureRingHeader*>(memory);
+	EXPECT_EQ(header->magic, kCaptureRingMagic);
+	EXPECT_EQ(header->written.load(), 5u);
+
+	// Too small to read into.
+	EXPECT_FALSE(CaptureRingRead(memory, &info, pixels.data(), 100));
+
+	// Too big for the ring, the sink refuses it.
+	capture.Shutdown(&device);
+	device.maps = 0;
+	device.width = 128;
+	Capture(new MemoryRingCaptureSink(memory, kRingSlots, kPixelBytes), 3);
+	EXPECT_EQ(header->written.load(), 0u);
+	EXPECT_EQ(stats.failed, 2u);
+}
+
+// A slot being written, odd sequence, or rewritten during the copy, is no
+// frame, the reader tries again.
+
+TEST(MemoryRingCaptureSink, TornReadsAreRefused)
+{
+	const uint64_t kPixelBytes = 16;
+	RingMemory ring(CaptureRingSize(2, kPixelBytes));
+	void* memory = ring.Get();
+	MemoryRingCaptureSink sink(memory, 2, kPixelBytes);
+
+	uint8_t source[16] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16 };
+	CaptureFrame frame = { source, 8, 2, 2, kCaptureR8G8B8A8Unorm, kLayoutMono, 0, 0 };
+	ASSERT_TRUE(sink.Write(frame));
+
+	CaptureRingSlot info;
+	uint8_t pixels[16];
+	ASSERT_TRUE(CaptureRingRead(memory, &info, pixels, sizeof(pixels)));
+	EXPECT_EQ(memcmp(pixels, source, 16), 0);
+
+	const CaptureRingHeader* header = static_cast<const CaptureRingHeader*>(memory);
+	CaptureRingSlot* slot = reinterpret_cast<CaptureRingSlot*>(static_cast<uint8_t*>(memory) + sizeof(CaptureRingHeader));
+	EXPECT_EQ(slot->sequence.load(), 2u);
+	slot->sequence.store(3);
+	EXPECT_FALSE(CaptureRingRead(memory, &info, pixels, sizeof(pixels)));
+	slot->sequence.store(4);
+	EXPECT_TRUE(CaptureRingRead(memory, &info, pixels, sizeof(pixels)));
+
+	// The second frame goes in the second slot.
+	frame.index = 1;
+	ASSERT_TRUE(sink.Write(frame));
+	EXPECT_EQ(header->written.load(), 2u);
+	ASSERT_TRUE(CaptureRingRead(memory, &info, pixels, sizeof(pixels)));
+	EXPECT_EQ(info.index, 1u);
+
+	// Anything else at that address is no ring.
+	memset(memory, 0, sizeof(CaptureRingHeader));
+	EXPECT_FALSE(CaptureRingRead(memory, &info, pixels, sizeof(pixels)));
+}
@@ -0,0 +1,143 @@
+// Tests of FramePacer.h, directly on synthetic timelines, and through the
+// game and HMD rate simulation in Tools/PacingSimulation.h.
+
+#include "FramePacer.h"
+#include "PacingSimulation.h"
+
+#include <gtest/gtest.h>
+
+
+static PacingConfig Config(double gameHz, bool paced, uint32_t jitterPercent = 10)
+{
+	PacingConfig config = { gameHz, 90, 20, jitterPercent, paced, 0, 1500 };
+	return config;
+}
+
+
+TEST(FramePacer, CopiesEveryFrameUntilTheVRSideSamples)
+{
+	FramePacer pacer;
+	pacer.Init(1000000, 0);
+
+	for (int64_t now = 1000; now < 100000; now += 4000)
+		EXPECT_TRUE(pacer.ShouldCopy(now, 5, 0, 0));
+	EXPECT_EQ(pacer.Skips(), 0u);
+	EXPECT_EQ(pacer.Copies(), 0u);
+}
+
+TEST(FramePacer, CountsOnlyCopiesThatHappened)
+{
+	FramePacer pacer;
+	pacer.Init(1000000, 0);
+
+	// Every Present is a copy decision, but only every other one copies, like
+	// keyed mutex mode finding its slot busy.
+	int64_t now = 1000;
+	for (int frame = 0; frame < 10; frame++, now += 4000)
+	{
+		ASSERT_TRUE(pacer.ShouldCopy(now, frame, frame, 0));
+		if (frame % 2 == 0)
+			pacer.OnCopied(now);
+	}
+	EXPECT_EQ(pacer.Copies(), 5u);
+	EXPECT_EQ(pacer.Skips(), 0u);
+}
+
+TEST(FramePacer, RateCapHoldsCopiesBack)
+{
+	FramePacer pacer;
+	pacer.Init(1000000, 50);
+
+	// 250 fps, with the VR side taking everything, so only the cap skips.
+	int copies = 0;
+	int64_t now = 1000;
+	for (int frame = 0; frame < 250; frame++, now += 4000)
+	{
+		if (pacer.ShouldCopy(now, frame, frame, now - 1000))
+		{
+			pacer.OnCopied(now);
+			copies++;
+		}
+	}
+	EXPECT_LE(copies, 51);
+	EXPECT_GE(copies, 45);
+	EXPECT_EQ(pacer.Copies(), (uint64_t)copies);
+}
+
+TEST(FramePacer, PendingCopyWaitsForTheNextSample)
+{
+	FramePacer pacer;
+	pacer.Init(1000000, 0);
+
+	// Learn a 4ms game and an 11ms VR side, with the VR side up to date.
+	int64_t sample = 0;
+	for (int64_t now = 1000; now < 50000; now += 4000)
+	{
+		if (now - sample >= 11000)
+			sample = now;
+		pacer.ShouldCopy(now, 10, 10, sample);
+	}
+
+	// A copy the VR side has not taken, with its next sample 10ms away, is
+	// not replaced yet.  Close to that sample, it is, with the newer frame.
+	EXPECT_FALSE(pacer.ShouldCopy(sample + 1000, 11, 10, sample));
+	EXPECT_TRUE(pacer.ShouldCopy(sample + 9000, 11, 10, sample));
+}
+
+
+TEST(PacingSimulation, NeverTears)
+{
+	for (double gameHz : { 30.0, 45.0, 60.0, 90.0, 144.0, 240.0 })
+	{
+		for (bool paced : { false, true })
+		{
+			PacingReport report = SimulatePacing(Config(gameHz, paced));
+			EXPECT_GT(report.hmdFrames, 0u) << gameHz;
+			EXPECT_EQ(report.torn, 0u) << gameHz << " Hz, paced " << paced;
+		}
+	}
+}
+
+TEST(PacingSimulation, SlowGamesCopyEveryFrame)
+{
+	for (double gameHz : { 45.0, 60.0 })
+	{
+		PacingReport paced = SimulatePacing(Config(gameHz, true));
+		// Copies are counted when they finish, so the last one may not be.
+		EXPECT_GE(paced.copies + 1, paced.presents) << gameHz;
+		EXPECT_EQ(paced.stale, 0u) << gameHz;
+		EXPECT_EQ(paced.dropped, 0u) << gameHz;
+
+		// And every game frame is shown, some of them twice.
+		EXPECT_GT(paced.repeats, 0u) << gameHz;
+		EXPECT_NEAR((double)(paced.hmdFrames - paced.repeats), (double)paced.presents, paced.presents * 0.01) << gameHz;
+	}
+}
+
+TEST(PacingSimulation, FastGamesCopyLessWithoutGoingStale)
+{
+	PacingReport unpaced = SimulatePacing(Config(240, false));
+	PacingReport paced = SimulatePacing(Config(240, true));
+
+	EXPECT_GT(unpaced.CopiesPerHmdFrame(), 2.5);
+	EXPECT_LT(paced.CopiesPerHmdFrame(), 2.0);
+	EXPECT_LT(paced.dropped, unpaced.dropped / 2 + unpaced.dropped / 4);
+
+	// Held back frames cost at most a little latency, now and then.  With 10%
+	// jitter, the game's last frame before a sample is sometimes later than
+	// predicted, and that is a few percent of HMD frames.
+	EXPECT_LT(paced.stale, paced.hmdFrames / 20);
+	EXPECT_LT(paced.AverageLatencyMs(), unpaced.AverageLatencyMs() + 0.5);
+}
+
+TEST(PacingSimulation, SameConfigSameReport)
+{
+	PacingReport first = SimulatePacing(Config(144, true, 20));
+	PacingReport second = SimulatePacing(Config(144, true, 20));
+
+	EXPECT_EQ(first.presents, second.presents);
+	EXPECT_EQ(first.copies, second.copies);
+	EXPECT_EQ(first.stale, second.stale);
+	EXPECT_EQ(first.dropped, second.dropped);
+	EXPECT_EQ(first.totalLatency, second.totalLatency);
+}
@@ -0,0 +1,226 @@
+// Tests of HookSet.h, with a fake object whose slots are the addresses to hook,
+// and a mock backend that records every Hook instead of nktInProc.
+
+#include "HookSet.h"
+
+#include <gtest/gtest.h>
+
+#include <set>
+#include <thread>
+#include <vector>
+
+
+// Stands in for a COM object, the lpvtbl_* accessors read its slots.
+struct FakeObject
+{
+	void* slots[4];
+};
+
+static void* SlotA(FakeObject* object) { return object->slots[0]; }
+static void* SlotB(FakeObject* object) { return object->slots[1]; }
+static void* SlotC(FakeObject* object) { return object->slots[2]; }
+static void* SlotD(FakeObject* object) { return object->slots[3]; }
+
+const uint32_t kGroupCore = 0x1;
+const uint32_t kGroupExtra = 0x2;
+
+// The detours and originals, only their addresses matter.
+static int sDetours[4];
+static void* sOriginals[4];
+
+static const HookEntry<FakeObject> kTable[] =
+{
+	{ L"A", kGroupCore, SlotA, &sDetours[0], &sOriginals[0] },
+	{ L"B", kGroupCore, SlotB, &sDetours[1], &sOriginals[1] },
+	{ L"C", kGroupExtra, SlotC, &sDetours[2], &sOriginals[2] },
+	{ L"D", kGroupCore | kGroupExtra, SlotD, &sDetours[3], &sOriginals[3] },
+};
+
+typedef HookSet<FakeObject, 4> FakeHookSet;
+
+class MockBackend : public HookBackend
+{
+public:
+	struct Call
+	{
+		void** original;
+		void* target;
+		void* detour;
+	};
+
+	bool Hook(void** original, void* target, void* detour) override
+	{
+		calls.push_back(Call{ original, target, detour });
+		if (failing.count(target))
+			return false;
+		*original = target;
+		return true;
+	}
+
+	std::vector<Call> calls;
+	std::set<void*> failing;
+};
+
+class HookSetTest : public testing::Test
+{
+protected:
+	void SetUp() override
+	{
+		for (int i = 0; i < 4; i++)
+		{
+			object.slots[i] = &targets[i];
+			sOriginals[i] = nullptr;
+		}
+	}
+
+	FakeObject object;
+	int targets[4];
+	MockBackend backend;
+	FakeHookSet hooks;
+};
+
+
+// ------------------------------------------------------------------------
+// Install
+
+TEST_F(HookSetTest, InstallsOnlyTheAskedForGroups)
+{
+	EXPECT_EQ(hooks.Install(kTable, &object, kGroupCore, &backend), 0);
+
+	ASSERT_EQ(backend.calls.size(), 3u);
+	EXPECT_EQ(backend.calls[0].target, &targets[0]);
+	EXPECT_EQ(backend.calls[0].detour, &sDetours[0]);
+	EXPECT_EQ(backend.calls[0].original, &sOriginals[0]);
+	EXPECT_EQ(backend.calls[1].target, &targets[1]);
+	EXPECT_EQ(backend.calls[2].target, &targets[3]);
+
+	EXPECT_TRUE(hooks.Installed(0));
+	EXPECT_TRUE(hooks.Installed(1));
+	EXPECT_FALSE(hooks.Installed(2));
+	EXPECT_TRUE(hooks.Installed(3));
+	EXPECT_EQ(hooks.InstalledCount(), 3u);
+	EXPECT_EQ(sOriginals[0], &targets[0]);
+	EXPECT_EQ(sOriginals[2], nullptr);
+}
+
+TEST_F(HookSetTest, InstallingAgainOnlyAddsWhatIsMissing)
+{
+	hooks.Install(kTable, &object, kGroupCore, &backend);
+	backend.calls.clear();
+
+	// The same groups from a second device, nothing to do.
+	EXPECT_EQ(hooks.Install(kTable, &object, kGroupCore, &backend), 0);
+	EXPECT_TRUE(backend.calls.empty());
+
+	// A later promoted device adds its group, D is already in.
+	EXPECT_EQ(hooks.Install(kTable, &object, kGroupCore | kGroupExtra, &backend), 0);
+	ASSERT_EQ(backend.calls.size(), 1u);
+	EXPECT_EQ(backend.calls[0].target, &targets[2]);
+	EXPECT_EQ(hooks.InstalledCount(), 4u);
+	for (size_t i = 0; i < 4; i++)
+		EXPECT_EQ(hooks.Attempts(i), 1);
+}
+
+TEST_F(HookSetTest, FailedHooksAreCountedAndTriedAgain)
+{
+	backend.failing.insert(&targets[1]);
+
+	EXPECT_EQ(hooks.Install(kTable, &object, kGroupCore, &backend), 1);
+	EXPECT_FALSE(hooks.Installed(1));
+	EXPECT_EQ(hooks.Attempts(1), 1);
+	EXPECT_EQ(hooks.InstalledCount(), 2u);
+
+	backend.failing.clear();
+	backend.calls.clear();
+	EXPECT_EQ(hooks.Install(kTable, &object, kGroupCore, &backend), 0);
+	ASSERT_EQ(backend.calls.size(), 1u);
+	EXPECT_EQ(backend.calls[0].target, &targets[1]);
+	EXPECT_TRUE(hooks.Installed(1));
+	EXPECT_EQ(hooks.Attempts(1), 2);
+}
+
+// No address to hook is a failure, without asking the backend.
+
+TEST_F(HookSetTest, NoAddressFailsWithoutHooking)
+{
+	object.slots[0] = nullptr;
+	EXPECT_EQ(hooks.Install(kTable, &object, kGroupCore, &backend), 1);
+	EXPECT_FALSE(hooks.Installed(0));
+	EXPECT_EQ(backend.calls.size(), 2u);
+
+	FakeHookSet fresh;
+	backend.calls.clear();
+	EXPECT_EQ(fresh.Install(kTable, nullptr, kGroupCore | kGroupExtra, &backend), 4);
+	EXPECT_TRUE(backend.calls.empty());
+	EXPECT_EQ(fresh.InstalledCount(), 0u);
+	EXPECT_EQ(fresh.Attempts(2), 1);
+}
+
+TEST_F(HookSetTest, InstallTimeIsKept)
+{
+	hooks.Install(kTable, &object, kGroupCore, &backend);
+
+	EXPECT_GE(hooks.InstallNs(0), 0);
+	EXPECT_EQ(hooks.InstallNs(2), 0);
+}
+
+// ------------------------------------------------------------------------
+// InstallAt
+
+TEST_F(HookSetTest, InstallAtAKnownAddress)
+{
+	int cached;
+	EXPECT_TRUE(hooks.InstallAt(kTable, 0, &cached, &backend));
+
+	ASSERT_EQ(backend.calls.size(), 1u);
+	EXPECT_EQ(backend.calls[0].target, &cached);
+	EXPECT_EQ(backend.calls[0].detour, &sDetours[0]);
+	EXPECT_TRUE(hooks.Installed(0));
+
+	// Then the device comes along, and the cached one is not hooked twice.
+	backend.calls.clear();
+	hooks.Install(kTable, &object, kGroupCore, &backend);
+	ASSERT_EQ(backend.calls.size(), 2u);
+	EXPECT_EQ(backend.calls[0].target, &targets[1]);
+	EXPECT_EQ(backend.calls[1].target, &targets[3]);
+}
+
+TEST_F(HookSetTest, InstallAtSkipsInstalledAndFailsWithoutAnAddress)
+{
+	hooks.Install(kTable, &object, kGroupCore, &backend);
+	backend.calls.clear();
+
+	int cached;
+	EXPECT_TRUE(hooks.InstallAt(kTable, 0, &cached, &backend));
+	EXPECT_TRUE(backend.calls.empty());
+
+	EXPECT_FALSE(hooks.InstallAt(kTable, 2, nullptr, &backend));
+	EXPECT_TRUE(backend.calls.empty());
+	EXPECT_FALSE(hooks.Installed(2));
+	EXPECT_EQ(hooks.Attempts(2), 1);
+}
+
+// ------------------------------------------------------------------------
+// Called
+
+TEST_F(HookSetTest, CallsAreCountedFromAnyThread)
+{
+	const int kThreads = 4;
+	const int kCallsEach = 10000;
+
+	std::vector<std::thread> threads;
+	for (int t = 0; t < kThreads; t++)
+	{
+		threads.emplace_back([this, t]
+		{
+			for (int i = 0; i < kCallsEach; i++)
+				hooks.Called(t % 2);
+		});
+	}
+	for (std::thread& thread : threads)
+		thread.join();
+
+	EXPECT_EQ(hooks.Calls(0), (uint64_t)kThreads / 2 * kCallsEach);
+	EXPECT_EQ(hooks.Calls(1), (uint64_t)kThreads / 2 * kCallsEach);
+	EXPECT_EQ(hooks.Calls(2), 0u);
+}
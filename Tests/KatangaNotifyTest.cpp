@@ -0,0 +1,258 @@
+// Tests of KatangaNotify.h, the POSIX event between threads and between two
+// real processes, and the VR side's generation count that C# waits on.
+
+#include "KatangaNotify.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <sys/wait.h>
+#include <unistd.h>
+
+
+// Each test gets its own event, so parallel ctest runs don't share one, and
+// removes it after, since nothing else will.
+
+class NamedEvent
+{
+public:
+	explicit NamedEvent(const char* test)
+		: name(std::string("/KatangaNotifyTest_") + test + "_" + std::to_string(getpid()))
+	{
+		KatangaNotifyEvent::Remove(name.c_str());
+	}
+	~NamedEvent() { KatangaNotifyEvent::Remove(name.c_str()); }
+
+	const char* Name() const { return name.c_str(); }
+
+private:
+	std::string name;
+};
+
+static int64_t MillisecondsSince(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+// ------------------------------------------------------------------------
+// KatangaNotifyEvent
+
+TEST(KatangaNotify, NotOpenDoesNothing)
+{
+	KatangaNotifyEvent event;
+
+	EXPECT_FALSE(event.IsOpen());
+	event.Signal();
+	EXPECT_FALSE(event.Wait(0));
+}
+
+// The game side signals when it creates the mapping, which is usually before
+// the VR side is waiting, or has even opened the event.
+
+TEST(KatangaNotify, SignalBeforeWaitIsNotLost)
+{
+	NamedEvent named("Early");
+	KatangaNotifyEvent game;
+	ASSERT_TRUE(game.Open(named.Name()));
+	game.Signal();
+
+	KatangaNotifyEvent vr;
+	ASSERT_TRUE(vr.Open(named.Name()));
+	EXPECT_TRUE(vr.Wait(0));
+}
+
+TEST(KatangaNotify, SignalsCollapseIntoOneWakeup)
+{
+	NamedEvent named("Collapse");
+	KatangaNotifyEvent game, vr;
+	ASSERT_TRUE(game.Open(named.Name()));
+	ASSERT_TRUE(vr.Open(named.Name()));
+
+	for (int i = 0; i < 5; i++)
+		game.Signal();
+
+	EXPECT_TRUE(vr.Wait(0));
+	EXPECT_FALSE(vr.Wait(0));
+
+	// And it is armed again for the next one.
+	game.Signal();
+	EXPECT_TRUE(vr.Wait(0));
+}
+
+TEST(KatangaNotify, WaitTimesOut)
+{
+	NamedEvent named("Timeout");
+	KatangaNotifyEvent vr;
+	ASSERT_TRUE(vr.Open(named.Name()));
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	EXPECT_FALSE(vr.Wait(50));
+	EXPECT_GE(MillisecondsSince(start), 50);
+}
+
+TEST(KatangaNotify, SignalWakesABlockedWait)
+{
+	NamedEvent named("Blocked");
+	KatangaNotifyEvent game, vr;
+	ASSERT_TRUE(game.Open(named.Name()));
+	ASSERT_TRUE(vr.Open(named.Name()));
+
+	std::thread signaler([&game]
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		game.Signal();
+	});
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	EXPECT_TRUE(vr.Wait(kKatangaNotifyInfinite));
+	EXPECT_LT(MillisecondsSince(start), 5000);
+	signaler.join();
+}
+
+// Two waiters on the one signal, as when our own StopNotifyWatcher races the
+// game side.  Only one of them is woken.
+
+TEST(KatangaNotify, OnlyOneWaiterTakesASignal)
+{
+	NamedEvent named("OneWaiter");
+	KatangaNotifyEvent game, first, second;
+	ASSERT_TRUE(game.Open(named.Name()));
+	ASSERT_TRUE(first.Open(named.Name()));
+	ASSERT_TRUE(second.Open(named.Name()));
+
+	game.Signal();
+
+	bool firstWoke = false, secondWoke = false;
+	std::thread a([&] { firstWoke = first.Wait(100); });
+	std::thread b([&] { secondWoke = second.Wait(100); });
+	a.join();
+	b.join();
+
+	EXPECT_NE(firstWoke, secondWoke);
+}
+
+TEST(KatangaNotify, NamesAreSeparate)
+{
+	NamedEvent namedA("SeparateA"), namedB("SeparateB");
+	KatangaNotifyEvent a, b;
+	ASSERT_TRUE(a.Open(namedA.Name()));
+	ASSERT_TRUE(b.Open(namedB.Name()));
+
+	a.Signal();
+	EXPECT_FALSE(b.Wait(0));
+	EXPECT_TRUE(a.Wait(0));
+}
+
+// The game side in a forked child, which opens the event by name and signals
+// it, once before and once while the parent VR side is blocked in Wait.
+
+TEST(KatangaNotify, SignalsAcrossProcesses)
+{
+	NamedEvent named("Process");
+	KatangaNotifyEvent vr;
+	ASSERT_TRUE(vr.Open(named.Name()));
+
+	pid_t child = fork();
+	ASSERT_GE(child, 0);
+	if (child == 0)
+	{
+		KatangaNotifyEvent game;
+		if (!game.Open(named.Name()))
+			_exit(1);
+		game.Signal();
+		std::this_thread::sleep_for(std::chrono::milliseconds(200));
+		game.Signal();
+		_exit(0);
+	}
+
+	EXPECT_TRUE(vr.Wait(5000));
+	EXPECT_TRUE(vr.Wait(5000));
+
+	int status = 0;
+	ASSERT_EQ(waitpid(child, &status, 0), child);
+	EXPECT_TRUE(WIFEXITED(status));
+	EXPECT_EQ(WEXITSTATUS(status), 0);
+}
+
+// ------------------------------------------------------------------------
+// KatangaNotifyGeneration
+
+TEST(KatangaNotify, GenerationWaitReturnsAtOnceIfAlreadyPast)
+{
+	KatangaNotifyGeneration generation;
+	generation.Advance();
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	EXPECT_EQ(generation.WaitPast(0, 5000), 1u);
+	EXPECT_LT(MillisecondsSince(start), 1000);
+}
+
+TEST(KatangaNotify, GenerationWaitTimesOutWithTheSeenOne)
+{
+	KatangaNotifyGeneration generation;
+	generation.Advance();
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	EXPECT_EQ(generation.WaitPast(1, 50), 1u);
+	EXPECT_GE(MillisecondsSince(start), 50);
+}
+
+// Only a move past the generation the caller saw wakes it, as C# passes the
+// one it last acted on.
+
+TEST(KatangaNotify, GenerationGatedWake)
+{
+	NamedEvent named("Gated");
+	KatangaNotifyEvent game, vr;
+	ASSERT_TRUE(game.Open(named.Name()));
+	ASSERT_TRUE(vr.Open(named.Name()));
+
+	// The watcher thread of RenderAPI_D3D11, counting wakeups.
+	KatangaNotifyGeneration generation;
+	std::atomic<bool> stop { false };
+	std::thread watcher([&]
+	{
+		while (!stop.load())
+		{
+			if (vr.Wait(kKatangaNotifyInfinite))
+				generation.Advance();
+		}
+	});
+
+	uint32_t seen = generation.Current();
+	uint32_t woken = seen;
+	std::thread waiter([&] { woken = generation.WaitPast(seen, 5000); });
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	game.Signal();
+	waiter.join();
+	EXPECT_EQ(woken, seen + 1);
+
+	stop.store(true);
+	game.Signal();
+	watcher.join();
+}
+
+TEST(KatangaNotify, StopReleasesGenerationWaiters)
+{
+	KatangaNotifyGeneration generation;
+
+	uint32_t woken = 99;
+	std::thread waiter([&] { woken = generation.WaitPast(0, 60000); });
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	generation.Stop();
+	waiter.join();
+
+	EXPECT_EQ(woken, 0u);
+	EXPECT_LT(MillisecondsSince(start), 5000);
+
+	// Stopped waits don't block at all, until started again.
+	EXPECT_EQ(generation.WaitPast(0, 60000), 0u);
+	generation.Start();
+	EXPECT_EQ(generation.WaitPast(0, 20), 0u);
+}
@@ -0,0 +1,266 @@
+// Tests of KatangaStats.h, recording known sample sets into a page on the
+// stack instead of the Local\KatangaStatsFile mapping.
+
+#include "KatangaStats.h"
+
+#include <gtest/gtest.h>
+
+
+static const int64_t kFrequency = 10000000;
+
+// Every value from first to last, once each.
+
+static void RecordRange(KatangaHistogram* hist, int64_t first, int64_t last)
+{
+	for (int64_t ticks = first; ticks <= last; ticks++)
+		KatangaRecord(hist, ticks);
+}
+
+
+// ------------------------------------------------------------------------
+// Buckets
+
+TEST(KatangaStats, SmallValuesGetTheirOwnBucket)
+{
+	for (uint64_t ticks = 0; ticks < kKatangaSubBuckets; ticks++)
+	{
+		EXPECT_EQ(KatangaBucketIndex(ticks), ticks);
+		EXPECT_EQ(KatangaBucketLowerBound((uint32_t)ticks), ticks);
+	}
+}
+
+TEST(KatangaStats, BucketBoundaries)
+{
+	// 8 to 15 are still one per bucket, then each power of two is split in 8.
+	EXPECT_EQ(KatangaBucketIndex(8), 8u);
+	EXPECT_EQ(KatangaBucketIndex(15), 15u);
+	EXPECT_EQ(KatangaBucketIndex(16), 16u);
+	EXPECT_EQ(KatangaBucketIndex(17), 16u);
+	EXPECT_EQ(KatangaBucketIndex(18), 17u);
+	EXPECT_EQ(KatangaBucketIndex(31), 23u);
+	EXPECT_EQ(KatangaBucketIndex(32), 24u);
+
+	EXPECT_EQ(KatangaBucketLowerBound(17), 18u);
+	EXPECT_EQ(KatangaBucketLowerBound(24), 32u);
+
+	// A 60Hz frame at the usual 10MHz QueryPerformanceFrequency.
+	EXPECT_EQ(KatangaBucketLowerBound(KatangaBucketIndex(166667)), 163840u);
+}
+
+TEST(KatangaStats, EveryValueIsWithinItsBucket)
+{
+	// Every bucket edge up to the top one, and either side of it.
+	for (uint32_t index = 1; index < kKatangaBucketCount; index++)
+	{
+		uint64_t lower = KatangaBucketLowerBound(index);
+		ASSERT_GT(lower, KatangaBucketLowerBound(index - 1));
+		ASSERT_EQ(KatangaBucketIndex(lower), index);
+		ASSERT_EQ(KatangaBucketIndex(lower - 1), index - 1);
+
+		// And never more than 12.5% above the lower bound.
+		uint64_t last = lower - 1;
+		uint64_t previous = KatangaBucketLowerBound(index - 1);
+		ASSERT_LE((last - previous) * kKatangaSubBuckets, previous + kKatangaSubBuckets);
+	}
+}
+
+TEST(KatangaStats, HugeValuesLandInTheLastBucket)
+{
+	uint32_t last = kKatangaBucketCount - 1;
+
+	EXPECT_EQ(KatangaBucketIndex(KatangaBucketLowerBound(last)), last);
+	EXPECT_EQ(KatangaBucketIndex(1ull << 34), last);
+	EXPECT_EQ(KatangaBucketIndex(1ull << 40), last);
+	EXPECT_EQ(KatangaBucketIndex(~0ull), last);
+}
+
+// ------------------------------------------------------------------------
+// Recording and percentiles
+
+TEST(KatangaStats, RecordCountsSumsAndMax)
+{
+	KatangaStatsPage page;
+	KatangaInitStats(&page, 11, kFrequency);
+	KatangaHistogram* hist = &page.histograms[kStatCopy];
+
+	RecordRange(hist, 1, 100);
+
+	EXPECT_EQ(hist->count.load(), 100u);
+	EXPECT_EQ(hist->sumTicks.load(), 5050u);
+	EXPECT_EQ(hist->maxTicks.load(), 100u);
+
+	uint64_t total = 0;
+	for (uint32_t i = 0; i < kKatangaBucketCount; i++)
+		total += hist->buckets[i].load();
+	EXPECT_EQ(total, 100u);
+	EXPECT_EQ(hist->buckets[KatangaBucketIndex(50)].load(), 4u);
+}
+
+TEST(KatangaStats, NegativeTicksCountAsZero)
+{
+	KatangaStatsPage page;
+	KatangaInitStats(&page, 11, kFrequency);
+	KatangaHistogram* hist = &page.histograms[kStatCopy];
+
+	KatangaRecord(hist, -5);
+
+	EXPECT_EQ(hist->count.load(), 1u);
+	EXPECT_EQ(hist->sumTicks.load(), 0u);
+	EXPECT_EQ(hist->buckets[0].load(), 1u);
+}
+
+TEST(KatangaStats, PercentilesOfAKnownSet)
+{
+	KatangaStatsPage page;
+	KatangaInitStats(&page, 11, kFrequency);
+	KatangaHistogram* hist = &page.histograms[kStatCopy];
+
+	RecordRange(hist, 1, 100);
+
+	// Lower bounds of the buckets holding the 1st, 51st, 91st and 100th samples.
+	EXPECT_EQ(KatangaPercentileTicks(hist, 0.0), 1u);
+	EXPECT_EQ(KatangaPercentileTicks(hist, 0.5), 48u);
+	EXPECT_EQ(KatangaPercentileTicks(hist, 0.9), 88u);
+	EXPECT_EQ(KatangaPercentileTicks(hist, 1.0), 96u);
+
+	// Past the end is the same as the last sample.
+	EXPECT_EQ(KatangaPercentileTicks(hist, 2.0), 96u);
+}
+
+TEST(KatangaStats, PercentilesReadLowByLessThanABucket)
+{
+	KatangaStatsPage page;
+	KatangaInitStats(&page, 11, kFrequency);
+	KatangaHistogram* hist = &page.histograms[kStatOrigPresent];
+
+	// Mostly 60Hz frames, with one slow one in a hundred.
+	for (int i = 0; i < 99; i++)
+		KatangaRecord(hist, 166667);
+	KatangaRecord(hist, 500000);
+
+	uint64_t median = KatangaPercentileTicks(hist, 0.5);
+	EXPECT_LE(median, 166667u);
+	EXPECT_GT(median * 9 / 8, 166667u);
+
+	EXPECT_EQ(KatangaPercentileTicks(hist, 0.99), KatangaBucketLowerBound(KatangaBucketIndex(500000)));
+}
+
+TEST(KatangaStats, EmptyHistogramIsZero)
+{
+	KatangaStatsPage page;
+	KatangaInitStats(&page, 11, kFrequency);
+
+	EXPECT_EQ(KatangaPercentileTicks(&page.histograms[kStatCopy], 0.5), 0u);
+	EXPECT_EQ(KatangaPercentileTicks(&page.histograms[kStatCopy], 1.0), 0u);
+}
+
+TEST(KatangaStats, OverflowKeepsTheRealMax)
+{
+	KatangaStatsPage page;
+	KatangaInitStats(&page, 11, kFrequency);
+	KatangaHistogram* hist = &page.histograms[kStatFrameInterval];
+
+	// A frame that took hours, as when the game was paused in a debugger.
+	int64_t huge = 1ll << 40;
+	KatangaRecord(hist, 100);
+	KatangaRecord(hist, huge);
+
+	EXPECT_EQ(hist->buckets[kKatangaBucketCount - 1].load(), 1u);
+	EXPECT_EQ(hist->maxTicks.load(), (uint64_t)huge);
+	EXPECT_EQ(hist->sumTicks.load(), (uint64_t)huge + 100);
+
+	// The percentile is clamped to the last bucket, only the max has it exactly.
+	EXPECT_EQ(KatangaPercentileTicks(hist, 1.0), KatangaBucketLowerBound(kKatangaBucketCount - 1));
+	EXPECT_LT(KatangaPercentileTicks(hist, 1.0), (uint64_t)huge);
+}
+
+// ------------------------------------------------------------------------
+// Present and reset
+
+TEST(KatangaStats, RecordPresentSplitsTheFrame)
+{
+	KatangaStatsPage page;
+	KatangaInitStats(&page, 11, kFrequency);
+
+	KatangaRecordPresent(&page, 1000, 1500, 1700, 9000);
+
+	EXPECT_EQ(page.histograms[kStatCopy].sumTicks.load(), 500u);
+	EXPECT_EQ(page.histograms[kStatHookOverhead].sumTicks.load(), 700u);
+	EXPECT_EQ(page.histograms[kStatOrigPresent].sumTicks.load(), 7300u);
+
+	// No interval until the second frame.
+	EXPECT_EQ(page.histograms[kStatFrameInterval].count.load(), 0u);
+
+	KatangaRecordPresent(&page, 167667, 167667, 167800, 170000);
+
+	EXPECT_EQ(page.histograms[kStatFrameInterval].count.load(), 1u);
+	EXPECT_EQ(page.histograms[kStatFrameInterval].sumTicks.load(), 166667u);
+	EXPECT_EQ(page.histograms[kStatCopy].count.load(), 2u);
+}
+
+TEST(KatangaStats, InitValidatesThePage)
+{
+	KatangaStatsPage page;
+	page.magic = 0;
+	page.tickFrequency = kFrequency;
+
+	EXPECT_FALSE(KatangaIsStatsValid(&page));
+
+	KatangaInitStats(&page, 9, kFrequency);
+	EXPECT_TRUE(KatangaIsStatsValid(&page));
+	EXPECT_EQ(page.dxVersion, 9u);
+
+	KatangaInitStats(&page, 9, 0);
+	EXPECT_FALSE(KatangaIsStatsValid(&page));
+}
+
+// A game restarted while the VR side still has the mapping open gets the
+// last run's page back, which must not carry over into the new run.
+
+TEST(KatangaStats, InitResetsAnEarlierRun)
+{
+	KatangaStatsPage page;
+	KatangaInitStats(&page, 9, kFrequency);
+
+	KatangaRecordPresent(&page, 1000, 1500, 1700, 9000);
+	KatangaRecordPresent(&page, 2000, 2500, 2700, 1ll << 40);
+	KatangaRecordPoolDecision(&page, kPoolTexture, kPoolActionShadowed);
+	page.copyPath = kCopyPathDirect;
+	page.poolProfileRules = 3;
+	page.poolProfileErrors = 1;
+
+	KatangaInitStats(&page, 11, kFrequency);
+
+	for (uint32_t stat = 0; stat < kStatCount; stat++)
+	{
+		const KatangaHistogram& hist = page.histograms[stat];
+		EXPECT_EQ(hist.count.load(), 0u);
+		EXPECT_EQ(hist.sumTicks.load(), 0u);
+		EXPECT_EQ(hist.maxTicks.load(), 0u);
+		for (uint32_t i = 0; i < kKatangaBucketCount; i++)
+			ASSERT_EQ(hist.buckets[i].load(), 0u);
+	}
+	EXPECT_EQ(page.poolDecisions[kPoolTexture][kPoolActionShadowed].load(), 0u);
+	EXPECT_EQ(page.copyPath, (uint32_t)kCopyPathUnknown);
+	EXPECT_EQ(page.poolProfileRules, 0u);
+	EXPECT_EQ(page.poolProfileErrors, 0u);
+	EXPECT_EQ(page.dxVersion, 11u);
+
+	// And the first frame after it has no interval back to the old run.
+	KatangaRecordPresent(&page, 5000, 5000, 5000, 5000);
+	EXPECT_EQ(page.histograms[kStatFrameInterval].count.load(), 0u);
+}
+
+TEST(KatangaStats, PoolDecisionsAreCountedByResourceAndAction)
+{
+	KatangaStatsPage page;
+	KatangaInitStats(&page, 9, kFrequency);
+
+	KatangaRecordPoolDecision(&page, kPoolTexture, kPoolActionDynamic);
+	KatangaRecordPoolDecision(&page, kPoolTexture, kPoolActionDynamic);
+	KatangaRecordPoolDecision(&page, kPoolVertexBuffer, kPoolActionPassThrough);
+
+	EXPECT_EQ(page.poolDecisions[kPoolTexture][kPoolActionDynamic].load(), 2u);
+	EXPECT_EQ(page.poolDecisions[kPoolVertexBuffer][kPoolActionPassThrough].load(), 1u);
+	EXPECT_EQ(page.poolDecisions[kPoolIndexBuffer][kPoolActionDynamic].load(), 0u);
+}
@@ -0,0 +1,453 @@
+// Tests of KatangaTrace.h, reading the Chrome trace JSON it writes back in with
+// a small parser, for nested spans, the ring, and two sides in one file.
+
+#include "KatangaTrace.h"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <thread>
+#include <vector>
+
+
+// Taken by reference in EXPECT_EQ, which the class constant can't be.
+static const uint64_t kCapacity = KatangaTracer::kCapacity;
+
+// Just enough JSON for the trace file.  Numbers are kept as their text too,
+// so timestamps can be checked to the nanosecond.
+
+struct JsonValue
+{
+	enum Type { kNull, kBool, kNumber, kString, kArray, kObject };
+
+	Type type = kNull;
+	bool boolean = false;
+	double number = 0;
+	std::string text;
+	std::vector<JsonValue> items;
+	std::vector<std::pair<std::string, JsonValue>> members;
+
+	const JsonValue* Get(const char* key) const
+	{
+		for (const auto& member : members)
+		{
+			if (member.first == key)
+				return &member.second;
+		}
+		return nullptr;
+	}
+
+	std::string String(const char* key) const
+	{
+		const JsonValue* value = Get(key);
+		return (value != nullptr && value->type == kString) ? value->text : "<missing>";
+	}
+
+	// Microseconds with three decimals, as nanoseconds.
+	int64_t Nanoseconds(const char* key) const
+	{
+		const JsonValue* value = Get(key);
+		if (value == nullptr || value->type != kNumber)
+			return -1;
+		size_t dot = value->text.find('.');
+		if (dot == std::string::npos || value->text.size() - dot != 4)
+			return -1;
+		return std::stoll(value->text.substr(0, dot)) * 1000 + std::stoll(value->text.substr(dot + 1));
+	}
+};
+
+class JsonReader
+{
+public:
+	explicit JsonReader(const std::string& text) : at(text.c_str()) { }
+
+	bool ParseDocument(JsonValue* value)
+	{
+		if (!Parse(value))
+			return false;
+		SkipSpace();
+		return *at == '\0';
+	}
+
+private:
+	void SkipSpace()
+	{
+		while (*at == ' ' || *at == '\t' || *at == '\r' || *at == '\n')
+			at++;
+	}
+
+	bool Literal(const char* word)
+	{
+		size_t length = strlen(word);
+		if (strncmp(at, word, length) != 0)
+			return false;
+		at += length;
+		return true;
+	}
+
+	bool ParseString(std::string* text)
+	{
+		if (*at++ != '"')
+			return false;
+		for (; *at != '"'; at++)
+		{
+			if ((unsigned char)*at < 0x20)
+				return false;
+			if (*at == '\\')
+			{
+				at++;
+				if (*at != '"' && *at != '\\' && *at != '/')
+					return false;
+			}
+			*text += *at;
+		}
+		at++;
+		return true;
+	}
+
+	bool Parse(JsonValue* value)
+	{
+		SkipSpace();
+		if (*at == '{')
+		{
+			value->type = JsonValue::kObject;
+			at++;
+			SkipSpace();
+			if (*at == '}')
+				return at++, true;
+			for (;;)
+			{
+				std::pair<std::string, JsonValue> member;
+				SkipSpace();
+				if (!ParseString(&member.first))
+					return false;
+				SkipSpace();
+				if (*at++ != ':' || !Parse(&member.second))
+					return false;
+				value->members.push_back(member);
+				SkipSpace();
+				if (*at == '}')
+					return at++, true;
+				if (*at++ != ',')
+					return false;
+			}
+		}
+		if (*at == '[')
+		{
+			value->type = JsonValue::kArray;
+			at++;
+			SkipSpace();
+			if (*at == ']')
+				return at++, true;
+			for (;;)
+			{
+				JsonValue item;
+				if (!Parse(&item))
+					return false;
+				value->items.push_back(item);
+				SkipSpace();
+				if (*at == ']')
+					return at++, true;
+				if (*at++ != ',')
+					return false;
+			}
+		}
+		if (*at == '"')
+		{
+			value->type = JsonValue::kString;
+			return ParseString(&value->text);
+		}
+		if (Literal("true"))
+		{
+			value->type = JsonValue::kBool;
+			value->boolean = true;
+			return true;
+		}
+		if (Literal("false"))
+		{
+			value->type = JsonValue::kBool;
+			return true;
+		}
+		if (Literal("null"))
+			return true;
+
+		char* end;
+		value->number = strtod(at, &end);
+		if (end == at)
+			return false;
+		value->type = JsonValue::kNumber;
+		value->text.assign(at, end - at);
+		at = end;
+		return true;
+	}
+
+	const char* at;
+};
+
+// The file as the viewer reads it, which allows the array to end on a comma
+// without its bracket.  Our parser doesn't, so that is closed off first.
+
+static bool ParseTraceFile(std::string text, JsonValue* trace)
+{
+	size_t last = text.find_last_not_of(" \r\n");
+	if (last != std::string::npos && text[last] == ',')
+		text.erase(last);
+	text += "]";
+	return JsonReader(text).ParseDocument(trace) && trace->type == JsonValue::kArray;
+}
+
+static std::string ReadFile(FILE* file)
+{
+	std::string text;
+	char buffer[4096];
+	rewind(file);
+	size_t read;
+	while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+		text.append(buffer, read);
+	return text;
+}
+
+// The non metadata events of one process, in file order.
+static std::vector<const JsonValue*> EventsOf(const JsonValue& trace, uint32_t pid)
+{
+	std::vector<const JsonValue*> events;
+	for (const JsonValue& event : trace.items)
+	{
+		const JsonValue* eventPid = event.Get("pid");
+		if (event.String("ph") != "M" && eventPid != nullptr && eventPid->number == pid)
+			events.push_back(&event);
+	}
+	return events;
+}
+
+static const JsonValue* Find(const std::vector<const JsonValue*>& events, const char* name)
+{
+	for (const JsonValue* event : events)
+	{
+		if (event->String("name") == name)
+			return event;
+	}
+	return nullptr;
+}
+
+static std::unique_ptr<KatangaTracer> NewTracer()
+{
+	return std::unique_ptr<KatangaTracer>(new KatangaTracer());
+}
+
+
+// ------------------------------------------------------------------------
+// The events
+
+TEST(KatangaTrace, SpanAndInstantFormat)
+{
+	std::unique_ptr<KatangaTracer> tracer = NewTracer();
+	tracer->Span("OpenMutex", 1000000123, 1000250456);
+
+	JsonValue trace;
+	ASSERT_TRUE(ParseTraceFile("[\n" + tracer->Events(42, "Game.exe"), &trace));
+	ASSERT_EQ(trace.items.size(), 2u);
+
+	const JsonValue& meta = trace.items[0];
+	EXPECT_EQ(meta.String("name"), "process_name");
+	EXPECT_EQ(meta.String("ph"), "M");
+	EXPECT_EQ(meta.Get("pid")->number, 42);
+	ASSERT_NE(meta.Get("args"), nullptr);
+	EXPECT_EQ(meta.Get("args")->String("name"), "Game.exe");
+
+	const JsonValue& span = trace.items[1];
+	EXPECT_EQ(span.String("name"), "OpenMutex");
+	EXPECT_EQ(span.String("cat"), "katanga");
+	EXPECT_EQ(span.String("ph"), "X");
+	EXPECT_EQ(span.Get("pid")->number, 42);
+	EXPECT_EQ(span.Get("tid")->number, KatangaTracer::ThreadId());
+	EXPECT_EQ(span.Nanoseconds("ts"), 1000000123);
+	EXPECT_EQ(span.Nanoseconds("dur"), 250333);
+}
+
+TEST(KatangaTrace, InstantHasProcessScope)
+{
+	std::unique_ptr<KatangaTracer> tracer = NewTracer();
+	int64_t before = KatangaTracer::Now();
+	tracer->Instant("FirstPresent");
+	int64_t after = KatangaTracer::Now();
+
+	JsonValue trace;
+	ASSERT_TRUE(ParseTraceFile("[\n" + tracer->Events(7, "Game.exe"), &trace));
+	std::vector<const JsonValue*> events = EventsOf(trace, 7);
+	ASSERT_EQ(events.size(), 1u);
+
+	EXPECT_EQ(events[0]->String("ph"), "i");
+	EXPECT_EQ(events[0]->String("s"), "p");
+	EXPECT_EQ(events[0]->Get("dur"), nullptr);
+	EXPECT_GE(events[0]->Nanoseconds("ts"), before);
+	EXPECT_LE(events[0]->Nanoseconds("ts"), after);
+}
+
+// Like OnLoad with its steps inside, the viewer stacks them by time.
+
+TEST(KatangaTrace, NestedScopesNestInTime)
+{
+	std::unique_ptr<KatangaTracer> tracer = NewTracer();
+	{
+		KATANGA_TRACE_SCOPE(tracer.get(), "OnLoad");
+		{
+			KATANGA_TRACE_SCOPE(tracer.get(), "OpenLogFile");
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		{
+			KATANGA_TRACE_SCOPE(tracer.get(), "OpenMutex");
+			KATANGA_TRACE_SCOPE(tracer.get(), "CreateMutex");
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+
+	JsonValue trace;
+	ASSERT_TRUE(ParseTraceFile("[\n" + tracer->Events(1, "Game.exe"), &trace));
+	std::vector<const JsonValue*> events = EventsOf(trace, 1);
+	ASSERT_EQ(events.size(), 4u);
+
+	// Recorded as each ends, innermost first.
+	EXPECT_EQ(events[0]->String("name"), "OpenLogFile");
+	EXPECT_EQ(events[1]->String("name"), "CreateMutex");
+	EXPECT_EQ(events[2]->String("name"), "OpenMutex");
+	EXPECT_EQ(events[3]->String("name"), "OnLoad");
+
+	auto inside = [](const JsonValue* inner, const JsonValue* outer)
+	{
+		return inner->Nanoseconds("ts") >= outer->Nanoseconds("ts") &&
+			inner->Nanoseconds("ts") + inner->Nanoseconds("dur") <= outer->Nanoseconds("ts") + outer->Nanoseconds("dur");
+	};
+	const JsonValue* onLoad = events[3];
+	EXPECT_TRUE(inside(events[0], onLoad));
+	EXPECT_TRUE(inside(events[1], events[2]));
+	EXPECT_TRUE(inside(events[2], onLoad));
+	EXPECT_FALSE(inside(events[0], events[2]));
+	EXPECT_GE(events[0]->Nanoseconds("dur"), 1000000);
+
+	for (const JsonValue* event : events)
+		EXPECT_EQ(event->Get("tid")->number, onLoad->Get("tid")->number);
+}
+
+TEST(KatangaTrace, ThreadsGetTheirOwnIds)
+{
+	std::unique_ptr<KatangaTracer> tracer = NewTracer();
+	tracer->Span("Main", 1000, 2000);
+	std::thread other([&tracer] { tracer->Span("Other", 1500, 1800); });
+	other.join();
+
+	JsonValue trace;
+	ASSERT_TRUE(ParseTraceFile("[\n" + tracer->Events(1, "Game.exe"), &trace));
+	std::vector<const JsonValue*> events = EventsOf(trace, 1);
+	ASSERT_EQ(events.size(), 2u);
+	EXPECT_NE(Find(events, "Main")->Get("tid")->number, Find(events, "Other")->Get("tid")->number);
+}
+
+TEST(KatangaTrace, NamesAreEscaped)
+{
+	std::unique_ptr<KatangaTracer> tracer = NewTracer();
+	tracer->Span("Say \"hi\" \\ bye\n", 0, 1000);
+
+	JsonValue trace;
+	ASSERT_TRUE(ParseTraceFile("[\n" + tracer->Events(1, "C:\\Games\\\"Odd\".exe"), &trace));
+	EXPECT_EQ(trace.items[0].Get("args")->String("name"), "C:\\Games\\\"Odd\".exe");
+	EXPECT_EQ(trace.items[1].String("name"), "Say \"hi\" \\ bye");
+}
+
+// ------------------------------------------------------------------------
+// The ring
+
+TEST(KatangaTrace, RingKeepsTheNewest)
+{
+	static const char* const kNames[] = { "Even", "Odd" };
+	std::unique_ptr<KatangaTracer> tracer = NewTracer();
+
+	for (uint64_t i = 0; i < kCapacity + 10; i++)
+		tracer->Span(kNames[i % 2], (int64_t)i * 1000, (int64_t)i * 1000 + 500);
+
+	EXPECT_EQ(tracer->Recorded(), kCapacity + 10);
+	EXPECT_EQ(tracer->Dropped(), 10u);
+
+	JsonValue trace;
+	ASSERT_TRUE(ParseTraceFile("[\n" + tracer->Events(1, "Game.exe"), &trace));
+	std::vector<const JsonValue*> events = EventsOf(trace, 1);
+	ASSERT_EQ(events.size(), kCapacity);
+	EXPECT_EQ(events.front()->Nanoseconds("ts"), 10000);
+	EXPECT_EQ(events.back()->Nanoseconds("ts"), (int64_t)(kCapacity + 9) * 1000);
+	for (size_t i = 1; i < events.size(); i++)
+		ASSERT_GT(events[i]->Nanoseconds("ts"), events[i - 1]->Nanoseconds("ts"));
+}
+
+TEST(KatangaTrace, EmptyTracerHasOnlyItsName)
+{
+	std::unique_ptr<KatangaTracer> tracer = NewTracer();
+	EXPECT_EQ(tracer->Dropped(), 0u);
+
+	JsonValue trace;
+	ASSERT_TRUE(ParseTraceFile("[\n" + tracer->Events(1, "Game.exe"), &trace));
+	ASSERT_EQ(trace.items.size(), 1u);
+	EXPECT_EQ(trace.items[0].String("ph"), "M");
+}
+
+// ------------------------------------------------------------------------
+// The file
+
+// The VR side starts the file, then the game appends its setup and frame
+// tracers, as at unload, and all of it is one timeline.
+
+TEST(KatangaTrace, TwoSidesMergeIntoOneFile)
+{
+	std::unique_ptr<KatangaTracer> vr = NewTracer(), game = NewTracer(), frames = NewTracer();
+	vr->Span("OpenLogFile", 1000000, 1200000);
+	vr->Span("WaitForSurface", 1200000, 9000000);
+	game->Span("OnLoad", 2000000, 3000000);
+	game->Span("OpenMutex", 2100000, 2200000);
+	frames->Span("Present", 8000000, 8016000);
+
+	FILE* file = tmpfile();
+	ASSERT_NE(file, nullptr);
+	ASSERT_TRUE(vr->Append(file, 100, "Katanga.exe"));
+	ASSERT_TRUE(game->Append(file, 200, "Game.exe"));
+	ASSERT_TRUE(frames->Append(file, 200, "Game.exe"));
+	std::string text = ReadFile(file);
+	fclose(file);
+
+	// Only the first one opens the array.
+	EXPECT_EQ(text.compare(0, 2, "[\n"), 0);
+	EXPECT_EQ(text.find('[', 1), std::string::npos);
+
+	JsonValue trace;
+	ASSERT_TRUE(ParseTraceFile(text, &trace));
+	ASSERT_EQ(trace.items.size(), 8u);
+
+	std::vector<const JsonValue*> vrEvents = EventsOf(trace, 100);
+	std::vector<const JsonValue*> gameEvents = EventsOf(trace, 200);
+	ASSERT_EQ(vrEvents.size(), 2u);
+	ASSERT_EQ(gameEvents.size(), 3u);
+	EXPECT_NE(Find(vrEvents, "WaitForSurface"), nullptr);
+	EXPECT_NE(Find(gameEvents, "Present"), nullptr);
+	EXPECT_EQ(Find(vrEvents, "OnLoad"), nullptr);
+
+	// The game's launch falls inside the VR side's wait, on the shared clock.
+	const JsonValue* wait = Find(vrEvents, "WaitForSurface");
+	const JsonValue* onLoad = Find(gameEvents, "OnLoad");
+	EXPECT_GT(onLoad->Nanoseconds("ts"), wait->Nanoseconds("ts"));
+	EXPECT_LT(onLoad->Nanoseconds("ts") + onLoad->Nanoseconds("dur"), wait->Nanoseconds("ts") + wait->Nanoseconds("dur"));
+
+	int names = 0;
+	for (const JsonValue& event : trace.items)
+	{
+		if (event.String("ph") == "M")
+		{
+			names++;
+			EXPECT_EQ(event.Get("args")->String("name"), event.Get("pid")->number == 100 ? "Katanga.exe" : "Game.exe");
+		}
+	}
+	EXPECT_EQ(names, 3);
+}
+
+TEST(KatangaTrace, AppendNeedsAFile)
+{
+	std::unique_ptr<KatangaTracer> tracer = NewTracer();
+	EXPECT_FALSE(tracer->Append(nullptr, 1, "Game.exe"));
+}
@@ -0,0 +1,231 @@
+// Tests of the keyed mutex handoff in KatangaKeyedMutex.h, with a fake keyed
+// mutex per slot that follows the IDXGIKeyedMutex rules: a slot can only be
+// acquired with the key it was last released with, and by one side at a time.
+
+#include "KatangaKeyedMutex.h"
+
+#include <gtest/gtest.h>
+
+#include <functional>
+
+
+enum Side { kNobody = -1, kGame = 0, kVR = 1 };
+
+struct KeyedSlots
+{
+	int owner[kKatangaMaxSlots] = { kNobody, kNobody, kNobody };
+	uint64_t releasedKey[kKatangaMaxSlots] = { kKatangaKeyGame, kKatangaKeyGame, kKatangaKeyGame };
+	int errors = 0;
+};
+
+// One side's view, the TSync for the producer or consumer.
+struct FakeSync
+{
+	KeyedSlots* slots;
+	Side side;
+	std::function<void()> beforeAcquire;
+	bool refuse = false;
+
+	bool TryAcquire(uint32_t slot, uint64_t key)
+	{
+		if (beforeAcquire)
+			beforeAcquire();
+		if (refuse || slots->owner[slot] != kNobody || slots->releasedKey[slot] != key)
+			return false;
+		slots->owner[slot] = side;
+		return true;
+	}
+
+	void Release(uint32_t slot, uint64_t key)
+	{
+		if (slots->owner[slot] != side)
+			slots->errors++;
+		slots->owner[slot] = kNobody;
+		slots->releasedKey[slot] = key;
+	}
+};
+
+// The game side of Hooked_Present, one copy.
+struct Game
+{
+	KatangaSharedDescriptor* desc;
+	FakeSync sync;
+	KatangaKeyedProducer<FakeSync> keys;
+	uint32_t writeSlot = 0;
+
+	bool Present()
+	{
+		if (!keys.BeginCopy(&sync, writeSlot))
+			return false;
+		keys.EndCopy(&sync, writeSlot);
+		KatangaPublishFrame(desc, 1);
+		bool unconsumed;
+		writeSlot = KatangaSwapWriteSlot(desc, writeSlot, &unconsumed);
+		keys.OnSwap(unconsumed);
+		return true;
+	}
+};
+
+class KeyedMutexTest : public ::testing::Test
+{
+protected:
+	void SetUp() override
+	{
+		const uint32_t handles[kKatangaMaxSlots] = { 1, 2, 3 };
+		KatangaPublishSurface(&desc, handles, kKatangaMaxSlots, 64, 32, 28, kLayoutSideBySide, kKatangaSurfaceKeyedMutex);
+		game.desc = &desc;
+		game.sync = { &slots, kGame, nullptr, false };
+		game.keys.Reset();
+		vrSync = { &slots, kVR, nullptr, false };
+		vrKeys.Reset();
+	}
+
+	KatangaSharedDescriptor desc = {};
+	KeyedSlots slots;
+	Game game;
+	FakeSync vrSync;
+	KatangaKeyedConsumer<FakeSync> vrKeys;
+	uint32_t readSlot = kKatangaMaxSlots - 1;
+};
+
+
+TEST_F(KeyedMutexTest, TakesEachFreshFrame)
+{
+	EXPECT_EQ(vrKeys.TakeLatest(&vrSync, &desc, &readSlot), kKeyedTakeNone);
+	EXPECT_FALSE(vrKeys.Held());
+
+	for (int frame = 0; frame < 20; frame++)
+	{
+		vrKeys.ReleaseTraded(&vrSync);
+		ASSERT_TRUE(game.Present());
+		uint32_t fresh = KatangaPeekFreshSlot(&desc);
+		ASSERT_EQ(vrKeys.TakeLatest(&vrSync, &desc, &readSlot), kKeyedTakeTaken);
+		EXPECT_EQ(readSlot, fresh);
+		EXPECT_EQ(slots.owner[readSlot], kVR);
+	}
+	EXPECT_EQ(slots.errors, 0);
+	EXPECT_EQ(game.keys.Skipped(), 0u);
+}
+
+TEST_F(KeyedMutexTest, BusyKeyKeepsTheHeldSlot)
+{
+	ASSERT_TRUE(game.Present());
+	ASSERT_EQ(vrKeys.TakeLatest(&vrSync, &desc, &readSlot), kKeyedTakeTaken);
+	uint32_t held = readSlot;
+
+	ASSERT_TRUE(game.Present());
+	vrSync.refuse = true;
+	EXPECT_EQ(vrKeys.TakeLatest(&vrSync, &desc, &readSlot), kKeyedTakeBusy);
+
+	// Still ours, and the fresh frame is still in the mailbox for next time.
+	EXPECT_EQ(readSlot, held);
+	EXPECT_EQ(slots.owner[held], kVR);
+	EXPECT_TRUE(vrKeys.Held());
+	EXPECT_TRUE(KatangaHasFreshSlot(&desc));
+	EXPECT_EQ(vrKeys.Skipped(), 1u);
+
+	vrSync.refuse = false;
+	EXPECT_EQ(vrKeys.TakeLatest(&vrSync, &desc, &readSlot), kKeyedTakeTaken);
+	EXPECT_NE(readSlot, held);
+	EXPECT_EQ(vrKeys.Traded(), held);
+	vrKeys.ReleaseTraded(&vrSync);
+	EXPECT_EQ(slots.owner[held], kNobody);
+	EXPECT_EQ(slots.errors, 0);
+}
+
+TEST_F(KeyedMutexTest, TradedSlotIsKeptUntilReleased)
+{
+	ASSERT_TRUE(game.Present());
+	ASSERT_EQ(vrKeys.TakeLatest(&vrSync, &desc, &readSlot), kKeyedTakeTaken);
+	uint32_t first = readSlot;
+	ASSERT_TRUE(game.Present());
+	ASSERT_EQ(vrKeys.TakeLatest(&vrSync, &desc, &readSlot), kKeyedTakeTaken);
+
+	// Unity may still have draws queued that sample the first slot.
+	EXPECT_EQ(vrKeys.Traded(), first);
+	EXPECT_EQ(slots.owner[first], kVR);
+
+	// The game side gets it back out of the mailbox, but cannot copy into it.
+	ASSERT_TRUE(game.Present());
+	EXPECT_EQ(game.writeSlot, first);
+	EXPECT_FALSE(game.Present());
+	EXPECT_EQ(game.keys.Skipped(), 1u);
+
+	// Nor do we take the fresh frame, that would be all three slots.
+	EXPECT_EQ(vrKeys.TakeLatest(&vrSync, &desc, &readSlot), kKeyedTakeNone);
+
+	vrKeys.ReleaseTraded(&vrSync);
+	EXPECT_EQ(vrKeys.Traded(), kKatangaMaxSlots);
+	EXPECT_TRUE(game.Present());
+	EXPECT_EQ(vrKeys.TakeLatest(&vrSync, &desc, &readSlot), kKeyedTakeTaken);
+	EXPECT_EQ(slots.errors, 0);
+}
+
+TEST_F(KeyedMutexTest, FrameReplacedBeforeTheTradeIsHandedBack)
+{
+	ASSERT_TRUE(game.Present());
+	ASSERT_EQ(vrKeys.TakeLatest(&vrSync, &desc, &readSlot), kKeyedTakeTaken);
+	uint32_t held = readSlot;
+	ASSERT_TRUE(game.Present());
+	uint32_t replaced = KatangaPeekFreshSlot(&desc);
+
+	// The game side's next Present lands between our acquire and the trade.
+	// It can't have the slot we just acquired, so it skips a copy, but it must
+	// get it back untouched, released for an unconsumed frame.
+	bool presented = true;
+	vrSync.beforeAcquire = [&]() { vrSync.beforeAcquire = nullptr; presented = game.Present(); };
+	EXPECT_EQ(vrKeys.TakeLatest(&vrSync, &desc, &readSlot), kKeyedTakeReplaced);
+
+	EXPECT_TRUE(presented);
+	EXPECT_EQ(readSlot, held);
+	EXPECT_EQ(slots.owner[held], kVR);
+	EXPECT_EQ(slots.owner[replaced], kNobody);
+	EXPECT_EQ(slots.releasedKey[replaced], kKatangaKeyVR);
+
+	// The newer frame is taken next time.
+	uint32_t newer = KatangaPeekFreshSlot(&desc);
+	EXPECT_EQ(vrKeys.TakeLatest(&vrSync, &desc, &readSlot), kKeyedTakeTaken);
+	EXPECT_EQ(readSlot, newer);
+	EXPECT_EQ(slots.errors, 0);
+}
+
+TEST_F(KeyedMutexTest, NoSlotIsEverOwnedTwice)
+{
+	uint32_t seed = 7;
+	for (int step = 0; step < 5000; step++)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		switch ((seed >> 16) % 5)
+		{
+			case 0:
+			case 1:
+				game.Present();
+				break;
+			case 2:
+				vrSync.refuse = ((seed >> 8) % 8) == 0;
+				vrKeys.TakeLatest(&vrSync, &desc, &readSlot);
+				vrSync.refuse = false;
+				break;
+			case 3:
+				vrSync.beforeAcquire = [&]() { vrSync.beforeAcquire = nullptr; game.Present(); };
+				vrKeys.TakeLatest(&vrSync, &desc, &readSlot);
+				vrSync.beforeAcquire = nullptr;
+				break;
+			case 4:
+				vrKeys.ReleaseTraded(&vrSync);
+				break;
+		}
+
+		// What the VR side samples is its own, and never the game's write slot.
+		if (vrKeys.Held())
+		{
+			ASSERT_EQ(slots.owner[readSlot], kVR) << "step " << step;
+		}
+		if (vrKeys.Traded() < kKatangaMaxSlots)
+		{
+			ASSERT_EQ(slots.owner[vrKeys.Traded()], kVR) << "step " << step;
+		}
+		ASSERT_NE(readSlot, game.writeSlot) << "step " << step;
+	}
+	EXPECT_EQ(slots.errors, 0);
+}
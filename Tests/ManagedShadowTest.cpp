@@ -0,0 +1,362 @@
+// Tests of ManagedShadow.h, the dirty rects, and the store with a fake uploader
+// that records every copy instead of the DX9 UpdateSurface.
+
+#include "ManagedShadow.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+
+// Taken by reference in EXPECT_EQ, which the class constants can't be.
+static const int kMaxRects = DirtyRegion::kMaxRects;
+static const uint32_t kMaxLevels = ManagedShadowStore::kMaxLevels;
+
+static ShadowRect Rect(uint32_t left, uint32_t top, uint32_t right, uint32_t bottom)
+{
+	return ShadowRect{ left, top, right, bottom };
+}
+
+static bool operator==(const ShadowRect& a, const ShadowRect& b)
+{
+	return a.left == b.left && a.top == b.top && a.right == b.right && a.bottom == b.bottom;
+}
+
+static std::ostream& operator<<(std::ostream& out, const ShadowRect& rect)
+{
+	return out << "(" << rect.left << "," << rect.top << ")-(" << rect.right << "," << rect.bottom << ")";
+}
+
+class RecordingUploader : public ShadowUploader
+{
+public:
+	struct Copy
+	{
+		void* shadow;
+		void* texture;
+		uint32_t level;
+		ShadowRect rect;
+	};
+
+	bool Upload(void* shadow, void* texture, uint32_t level, const ShadowRect& rect) override
+	{
+		copies.push_back(Copy{ shadow, texture, level, rect });
+		return !failing;
+	}
+
+	std::vector<Copy> copies;
+	bool failing = false;
+};
+
+// Fake objects, only their addresses matter.
+static int sTexture, sOtherTexture, sShadow, sOtherShadow;
+static int sSurfaces[4];
+
+// A 256x128 texture with its mip chain down to 32x16.
+
+static void AddTexture(ManagedShadowStore* store, void* texture = &sTexture, void* shadow = &sShadow)
+{
+	const uint32_t widths[] = { 256, 128, 64, 32 };
+	const uint32_t heights[] = { 128, 64, 32, 16 };
+	store->Add(texture, shadow, 4, widths, heights);
+}
+
+
+// ------------------------------------------------------------------------
+// ShadowRect and DirtyRegion
+
+TEST(ManagedShadow, RectBasics)
+{
+	ShadowRect a = Rect(0, 0, 10, 10);
+
+	EXPECT_EQ(a.Area(), 100u);
+	EXPECT_TRUE(a.Touches(Rect(10, 0, 20, 10)));
+	EXPECT_TRUE(a.Touches(Rect(5, 5, 6, 6)));
+	EXPECT_FALSE(a.Touches(Rect(11, 0, 20, 10)));
+	EXPECT_TRUE(a.Contains(Rect(2, 2, 10, 10)));
+	EXPECT_FALSE(a.Contains(Rect(2, 2, 11, 10)));
+	EXPECT_EQ(a.Union(Rect(20, 5, 30, 40)), Rect(0, 0, 30, 40));
+}
+
+TEST(ManagedShadow, EmptyRectsAreNotDirty)
+{
+	DirtyRegion dirty;
+	dirty.Add(Rect(5, 5, 5, 10));
+	dirty.Add(Rect(5, 5, 10, 5));
+	dirty.Add(Rect(10, 10, 5, 5));
+
+	EXPECT_TRUE(dirty.Empty());
+}
+
+TEST(ManagedShadow, ContainedRectsAddNothing)
+{
+	DirtyRegion dirty;
+	dirty.Add(Rect(0, 0, 64, 64));
+	dirty.Add(Rect(8, 8, 16, 16));
+	dirty.Add(Rect(0, 0, 64, 64));
+
+	ASSERT_EQ(dirty.Count(), 1);
+	EXPECT_EQ(dirty.Rect(0), Rect(0, 0, 64, 64));
+}
+
+TEST(ManagedShadow, TouchingRectsMerge)
+{
+	DirtyRegion dirty;
+	dirty.Add(Rect(0, 0, 16, 16));
+	dirty.Add(Rect(32, 0, 48, 16));
+	EXPECT_EQ(dirty.Count(), 2);
+
+	// Bridges the two, so all three become one.
+	dirty.Add(Rect(16, 0, 32, 16));
+	ASSERT_EQ(dirty.Count(), 1);
+	EXPECT_EQ(dirty.Rect(0), Rect(0, 0, 48, 16));
+	EXPECT_EQ(dirty.Area(), 48u * 16);
+}
+
+TEST(ManagedShadow, FullRegionMergesTheClosestPair)
+{
+	DirtyRegion dirty;
+
+	// A row of separate 4x4 rects, 8 apart.
+	for (int i = 0; i < kMaxRects; i++)
+		dirty.Add(Rect(i * 12, 0, i * 12 + 4, 4));
+	ASSERT_EQ(dirty.Count(), kMaxRects);
+
+	// Just past the last one, so that is the cheapest to grow.
+	dirty.Add(Rect(kMaxRects * 12 - 2, 0, kMaxRects * 12 + 2, 4));
+
+	EXPECT_EQ(dirty.Count(), kMaxRects);
+	bool found = false;
+	for (int i = 0; i < dirty.Count(); i++)
+		found |= dirty.Rect(i) == Rect((kMaxRects - 1) * 12, 0, kMaxRects * 12 + 2, 4);
+	EXPECT_TRUE(found);
+
+	// Never loses any dirty area.
+	for (int i = 0; i <= kMaxRects; i++)
+	{
+		ShadowRect added = Rect(i * 12, 0, i * 12 + 2, 4);
+		bool covered = false;
+		for (int r = 0; r < dirty.Count(); r++)
+			covered |= dirty.Rect(r).Contains(added);
+		EXPECT_TRUE(covered) << added;
+	}
+}
+
+// ------------------------------------------------------------------------
+// Adding and finding
+
+TEST(ManagedShadow, FindsTexturesAndSurfaces)
+{
+	ManagedShadowStore store;
+	EXPECT_TRUE(store.Empty());
+
+	AddTexture(&store);
+	store.AddSurface(&sSurfaces[2], &sTexture, 2);
+
+	EXPECT_FALSE(store.Empty());
+	EXPECT_EQ(store.Count(), 1u);
+
+	void* shadow = nullptr;
+	ASSERT_TRUE(store.Find(&sTexture, &shadow));
+	EXPECT_EQ(shadow, &sShadow);
+	EXPECT_FALSE(store.Find(&sOtherTexture, &shadow));
+
+	void* texture = nullptr;
+	uint32_t level = 99;
+	ASSERT_TRUE(store.FindSurface(&sSurfaces[2], &texture, &level, &shadow));
+	EXPECT_EQ(texture, &sTexture);
+	EXPECT_EQ(level, 2u);
+	EXPECT_EQ(shadow, &sShadow);
+	EXPECT_FALSE(store.FindSurface(&sSurfaces[1], &texture, &level, &shadow));
+}
+
+TEST(ManagedShadow, SurfacesNeedAKnownLevel)
+{
+	ManagedShadowStore store;
+	AddTexture(&store);
+
+	store.AddSurface(&sSurfaces[0], &sOtherTexture, 0);
+	store.AddSurface(&sSurfaces[1], &sTexture, 4);
+
+	void* texture;
+	uint32_t level;
+	void* shadow;
+	EXPECT_FALSE(store.FindSurface(&sSurfaces[0], &texture, &level, &shadow));
+	EXPECT_FALSE(store.FindSurface(&sSurfaces[1], &texture, &level, &shadow));
+}
+
+TEST(ManagedShadow, RemoveHandsBackTheShadow)
+{
+	ManagedShadowStore store;
+	AddTexture(&store);
+	AddTexture(&store, &sOtherTexture, &sOtherShadow);
+	store.AddSurface(&sSurfaces[0], &sTexture, 0);
+
+	EXPECT_EQ(store.Remove(&sTexture), &sShadow);
+	EXPECT_EQ(store.Count(), 1u);
+
+	void* texture;
+	uint32_t level;
+	void* shadow;
+	EXPECT_FALSE(store.Find(&sTexture, &shadow));
+	EXPECT_FALSE(store.FindSurface(&sSurfaces[0], &texture, &level, &shadow));
+
+	// Only once.
+	EXPECT_EQ(store.Remove(&sTexture), nullptr);
+	EXPECT_EQ(store.Remove(&sOtherTexture), &sOtherShadow);
+	EXPECT_TRUE(store.Empty());
+}
+
+TEST(ManagedShadow, LevelsPastTheLimitAreDropped)
+{
+	uint32_t widths[kMaxLevels + 4], heights[kMaxLevels + 4];
+	for (uint32_t i = 0; i < kMaxLevels + 4; i++)
+		widths[i] = heights[i] = 1;
+
+	ManagedShadowStore store;
+	store.Add(&sTexture, &sShadow, kMaxLevels + 4, widths, heights);
+	store.AddSurface(&sSurfaces[0], &sTexture, kMaxLevels - 1);
+	store.AddSurface(&sSurfaces[1], &sTexture, kMaxLevels);
+
+	void* texture;
+	uint32_t level;
+	void* shadow;
+	EXPECT_TRUE(store.FindSurface(&sSurfaces[0], &texture, &level, &shadow));
+	EXPECT_FALSE(store.FindSurface(&sSurfaces[1], &texture, &level, &shadow));
+}
+
+// ------------------------------------------------------------------------
+// Lock and Unlock
+
+TEST(ManagedShadow, UnlockUploadsTheLockedRect)
+{
+	ManagedShadowStore store;
+	RecordingUploader uploader;
+	AddTexture(&store);
+
+	ShadowRect rect = Rect(16, 8, 48, 24);
+	store.Locked(&sTexture, 0, &rect, false);
+	EXPECT_TRUE(uploader.copies.empty());
+	store.Unlocked(&sTexture, 0, &uploader);
+
+	ASSERT_EQ(uploader.copies.size(), 1u);
+	EXPECT_EQ(uploader.copies[0].shadow, &sShadow);
+	EXPECT_EQ(uploader.copies[0].texture, &sTexture);
+	EXPECT_EQ(uploader.copies[0].level, 0u);
+	EXPECT_EQ(uploader.copies[0].rect, rect);
+	EXPECT_EQ(store.Locks(), 1u);
+	EXPECT_EQ(store.Uploads(), 1u);
+	EXPECT_EQ(store.UploadedTexels(), 32u * 16);
+
+	// And it is clean after.
+	store.Locked(&sTexture, 0, &rect, true);
+	store.Unlocked(&sTexture, 0, &uploader);
+	EXPECT_EQ(uploader.copies.size(), 1u);
+}
+
+TEST(ManagedShadow, RectsAreRoundedToBlocksAndClamped)
+{
+	ManagedShadowStore store;
+	RecordingUploader uploader;
+	AddTexture(&store);
+
+	// Level 3 is 32x16.
+	ShadowRect rect = Rect(5, 3, 30, 15);
+	store.Locked(&sTexture, 3, &rect, false);
+	store.Unlocked(&sTexture, 3, &uploader);
+
+	rect = Rect(29, 13, 40, 20);
+	store.Locked(&sTexture, 3, &rect, false);
+	store.Unlocked(&sTexture, 3, &uploader);
+
+	ASSERT_EQ(uploader.copies.size(), 2u);
+	EXPECT_EQ(uploader.copies[0].rect, Rect(4, 0, 32, 16));
+	EXPECT_EQ(uploader.copies[1].rect, Rect(28, 12, 32, 16));
+}
+
+TEST(ManagedShadow, WholeLevelLock)
+{
+	ManagedShadowStore store;
+	RecordingUploader uploader;
+	AddTexture(&store);
+
+	store.Locked(&sTexture, 1, nullptr, false);
+	store.Unlocked(&sTexture, 1, &uploader);
+
+	ASSERT_EQ(uploader.copies.size(), 1u);
+	EXPECT_EQ(uploader.copies[0].level, 1u);
+	EXPECT_EQ(uploader.copies[0].rect, Rect(0, 0, 128, 64));
+}
+
+TEST(ManagedShadow, NestedLocksUploadAtTheLastUnlock)
+{
+	ManagedShadowStore store;
+	RecordingUploader uploader;
+	AddTexture(&store);
+
+	ShadowRect first = Rect(0, 0, 16, 16), second = Rect(128, 64, 160, 96);
+	store.Locked(&sTexture, 0, &first, false);
+	store.Locked(&sTexture, 0, &second, false);
+	store.Unlocked(&sTexture, 0, &uploader);
+	EXPECT_TRUE(uploader.copies.empty());
+
+	store.Unlocked(&sTexture, 0, &uploader);
+	EXPECT_EQ(uploader.copies.size(), 2u);
+
+	// An extra Unlock does nothing.
+	store.Unlocked(&sTexture, 0, &uploader);
+	EXPECT_EQ(uploader.copies.size(), 2u);
+}
+
+TEST(ManagedShadow, LevelsAreSeparate)
+{
+	ManagedShadowStore store;
+	RecordingUploader uploader;
+	AddTexture(&store);
+
+	store.Locked(&sTexture, 0, nullptr, false);
+	store.Locked(&sTexture, 2, nullptr, false);
+	store.Unlocked(&sTexture, 2, &uploader);
+
+	ASSERT_EQ(uploader.copies.size(), 1u);
+	EXPECT_EQ(uploader.copies[0].level, 2u);
+}
+
+TEST(ManagedShadow, UnknownTexturesAndLevelsAreIgnored)
+{
+	ManagedShadowStore store;
+	RecordingUploader uploader;
+	AddTexture(&store);
+
+	store.Locked(&sOtherTexture, 0, nullptr, false);
+	store.Unlocked(&sOtherTexture, 0, &uploader);
+	store.Locked(&sTexture, 4, nullptr, false);
+	store.Unlocked(&sTexture, 4, &uploader);
+
+	EXPECT_TRUE(uploader.copies.empty());
+	EXPECT_EQ(store.Locks(), 0u);
+}
+
+TEST(ManagedShadow, FailedUploadsStayDirty)
+{
+	ManagedShadowStore store;
+	RecordingUploader uploader;
+	AddTexture(&store);
+
+	ShadowRect rect = Rect(0, 0, 16, 16);
+	uploader.failing = true;
+	store.Locked(&sTexture, 0, &rect, false);
+	store.Unlocked(&sTexture, 0, &uploader);
+	EXPECT_EQ(store.FailedUploads(), 1u);
+	EXPECT_EQ(store.Uploads(), 0u);
+
+	// Tried again at the next Unlock, even a read only one.
+	uploader.failing = false;
+	uploader.copies.clear();
+	store.Locked(&sTexture, 0, nullptr, true);
+	store.Unlocked(&sTexture, 0, &uploader);
+
+	ASSERT_EQ(uploader.copies.size(), 1u);
+	EXPECT_EQ(uploader.copies[0].rect, rect);
+	EXPECT_EQ(store.Uploads(), 1u);
+}
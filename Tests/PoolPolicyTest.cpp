@@ -0,0 +1,402 @@
+// Tests of PoolPolicy.h, the built in rules, the PoolProfiles.ini parser with
+// good and malformed profiles, which rules win, and the per caller counts.
+
+#include "PoolPolicy.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+
+// Taken by reference in EXPECT_EQ, which the class constants can't be.
+static const int kMaxRules = PoolPolicy::kMaxRules;
+
+static const uint32_t kFormatA8R8G8B8 = 21;
+static const uint32_t kFormatDXT1 = 0x31545844;
+
+static PoolRequest Request(KatangaPoolResource resource, uint32_t pool, uint32_t usage, uint64_t size,
+	uint32_t calls = 1, uint32_t format = kFormatA8R8G8B8)
+{
+	PoolRequest request;
+	request.resource = resource;
+	request.pool = pool;
+	request.usage = usage;
+	request.format = (resource == kPoolVertexBuffer) ? 0 : format;
+	request.size = size;
+	request.calls = calls;
+	return request;
+}
+
+static PoolRequest ManagedTexture(uint64_t size = 256 * 256)
+{
+	return Request(kPoolTexture, kPolicyPoolManaged, 0, size);
+}
+
+
+// ------------------------------------------------------------------------
+// Built in rules
+
+TEST(PoolPolicy, NotManagedPassesThrough)
+{
+	PoolPolicy policy;
+
+	for (uint32_t resource = 0; resource < kPoolResourceCount; resource++)
+	{
+		KatangaPoolResource kind = (KatangaPoolResource)resource;
+		EXPECT_EQ(policy.Decide(Request(kind, kPolicyPoolDefault, 0, 65536)), kPoolActionPassThrough);
+		EXPECT_EQ(policy.Decide(Request(kind, kPolicyPoolSystemMem, 0, 65536)), kPoolActionPassThrough);
+		EXPECT_EQ(policy.Decide(Request(kind, kPolicyPoolDefault, kPolicyUsageDynamic, 65536)), kPoolActionPassThrough);
+	}
+
+	// D3DPOOL_SCRATCH, and anything past the mask.
+	EXPECT_EQ(policy.Decide(Request(kPoolTexture, 3, 0, 65536)), kPoolActionPassThrough);
+	EXPECT_EQ(policy.Decide(Request(kPoolTexture, 40, 0, 65536)), kPoolActionPassThrough);
+}
+
+TEST(PoolPolicy, ManagedTargetsArePlainDefault)
+{
+	PoolPolicy policy;
+
+	EXPECT_EQ(policy.Decide(Request(kPoolTexture, kPolicyPoolManaged, kPolicyUsageRenderTarget, 65536)), kPoolActionShadowed);
+	EXPECT_EQ(policy.Decide(Request(kPoolCubeTexture, kPolicyPoolManaged, kPolicyUsageRenderTarget, 65536)), kPoolActionShadowed);
+	EXPECT_EQ(policy.Decide(Request(kPoolTexture, kPolicyPoolManaged, kPolicyUsageDepthStencil, 65536)), kPoolActionShadowed);
+}
+
+TEST(PoolPolicy, ManagedBuffersBySize)
+{
+	PoolPolicy policy;
+
+	EXPECT_EQ(policy.Decide(Request(kPoolVertexBuffer, kPolicyPoolManaged, 0, 4096)), kPoolActionShadowed);
+	EXPECT_EQ(policy.Decide(Request(kPoolIndexBuffer, kPolicyPoolManaged, kPolicyUsageWriteOnly, 1 << 20)), kPoolActionShadowed);
+	EXPECT_EQ(policy.Decide(Request(kPoolVertexBuffer, kPolicyPoolManaged, 0, 4095)), kPoolActionDynamic);
+	EXPECT_EQ(policy.Decide(Request(kPoolIndexBuffer, kPolicyPoolManaged, 0, 64)), kPoolActionDynamic);
+
+	// Asked for dynamic, which it keeps.
+	EXPECT_EQ(policy.Decide(Request(kPoolVertexBuffer, kPolicyPoolManaged, kPolicyUsageDynamic, 1 << 20)), kPoolActionDynamic);
+}
+
+TEST(PoolPolicy, ManagedTexturesByKind)
+{
+	PoolPolicy policy;
+
+	EXPECT_EQ(policy.Decide(ManagedTexture()), kPoolActionShadowed);
+	EXPECT_EQ(policy.Decide(ManagedTexture(1)), kPoolActionShadowed);
+	EXPECT_EQ(policy.Decide(Request(kPoolTexture, kPolicyPoolManaged, kPolicyUsageDynamic, 65536)), kPoolActionDynamic);
+
+	// No shadow for these.
+	EXPECT_EQ(policy.Decide(Request(kPoolCubeTexture, kPolicyPoolManaged, 0, 6 * 65536)), kPoolActionDynamic);
+	EXPECT_EQ(policy.Decide(Request(kPoolVolumeTexture, kPolicyPoolManaged, 0, 65536)), kPoolActionDynamic);
+}
+
+// ------------------------------------------------------------------------
+// ParseRule
+
+TEST(PoolPolicy, ParsesEveryCondition)
+{
+	PoolRule rule;
+	ASSERT_TRUE(PoolPolicy::ParseRule("texture,cube pool=managed pool=systemmem format=0x31545844 usage=0x8 nousage=512 "
+		"size>=4096 size<0x100000 calls>=2 calls<=10 -> shadowed", &rule));
+
+	EXPECT_EQ(rule.resources, (1u << kPoolTexture) | (1u << kPoolCubeTexture));
+	EXPECT_EQ(rule.pools, (1u << kPolicyPoolManaged) | (1u << kPolicyPoolSystemMem));
+	EXPECT_EQ(rule.format, kFormatDXT1);
+	EXPECT_EQ(rule.usageAll, kPolicyUsageWriteOnly);
+	EXPECT_EQ(rule.usageNone, kPolicyUsageDynamic);
+	EXPECT_EQ(rule.minSize, 4096u);
+	EXPECT_EQ(rule.maxSize, 0x100000u);
+	EXPECT_EQ(rule.minCalls, 2u);
+	EXPECT_EQ(rule.maxCalls, 10u);
+	EXPECT_EQ(rule.action, kPoolActionShadowed);
+}
+
+TEST(PoolPolicy, ParsesTheShortestRules)
+{
+	PoolRule rule;
+
+	ASSERT_TRUE(PoolPolicy::ParseRule("* -> passthrough", &rule));
+	EXPECT_EQ(rule.resources, 0u);
+	EXPECT_EQ(rule.action, kPoolActionPassThrough);
+
+	ASSERT_TRUE(PoolPolicy::ParseRule("\tVERTEX->Dynamic", &rule));
+	EXPECT_EQ(rule.resources, 1u << kPoolVertexBuffer);
+	EXPECT_EQ(rule.action, kPoolActionDynamic);
+	EXPECT_EQ(rule.pools, 0u);
+	EXPECT_EQ(rule.minSize, 0u);
+}
+
+TEST(PoolPolicy, RejectsMalformedRules)
+{
+	const char* bad[] =
+	{
+		"",
+		"texture",
+		"texture shadowed",
+		"-> shadowed",
+		"texture -> ",
+		"texture -> sometimes",
+		"textures -> shadowed",
+		"texture pool=local -> shadowed",
+		"texture format= -> shadowed",
+		"texture usage=8x -> shadowed",
+		"texture size>4096 -> shadowed",
+		"texture size<0 -> shadowed",
+		"texture calls<=0 -> shadowed",
+		"texture calls>2 -> shadowed",
+		"texture color=red -> shadowed",
+	};
+
+	for (const char* text : bad)
+	{
+		PoolRule rule;
+		EXPECT_FALSE(PoolPolicy::ParseRule(text, &rule)) << "\"" << text << "\"";
+	}
+}
+
+TEST(PoolPolicy, RuleMatchesOnlyInsideItsLimits)
+{
+	PoolRule rule;
+	ASSERT_TRUE(PoolPolicy::ParseRule("texture pool=managed usage=0x8 nousage=0x200 size>=100 size<200 calls>=2 calls<=3 -> dynamic", &rule));
+
+	PoolRequest inside = Request(kPoolTexture, kPolicyPoolManaged, kPolicyUsageWriteOnly, 100, 2);
+	EXPECT_TRUE(rule.Matches(inside));
+
+	PoolRequest request = inside;
+	request.size = 199;
+	request.calls = 3;
+	EXPECT_TRUE(rule.Matches(request));
+
+	request = inside;
+	request.size = 200;
+	EXPECT_FALSE(rule.Matches(request));
+	request.size = 99;
+	EXPECT_FALSE(rule.Matches(request));
+
+	request = inside;
+	request.calls = 1;
+	EXPECT_FALSE(rule.Matches(request));
+	request.calls = 4;
+	EXPECT_FALSE(rule.Matches(request));
+
+	request = inside;
+	request.usage = 0;
+	EXPECT_FALSE(rule.Matches(request));
+	request.usage = kPolicyUsageWriteOnly | kPolicyUsageDynamic;
+	EXPECT_FALSE(rule.Matches(request));
+
+	request = inside;
+	request.pool = kPolicyPoolDefault;
+	EXPECT_FALSE(rule.Matches(request));
+
+	request = inside;
+	request.resource = kPoolCubeTexture;
+	EXPECT_FALSE(rule.Matches(request));
+}
+
+// ------------------------------------------------------------------------
+// LoadProfile
+
+static const char* kProfile =
+	"# Katanga pool profile\r\n"
+	"\r\n"
+	"[Left4Dead2.exe]\r\n"
+	"texture size>=1048576 -> dynamic\r\n"
+	"vertex -> passthrough   # trailing comment\r\n"
+	"[OtherGame.exe]\r\n"
+	"* -> passthrough\r\n"
+	"[*]\r\n"
+	"texture -> passthrough\r\n"
+	"index size<1024 -> dynamic\r\n";
+
+TEST(PoolPolicy, LoadsOnlyTheGameAndAnySections)
+{
+	PoolPolicy policy;
+
+	EXPECT_EQ(policy.LoadProfile(kProfile, "left4dead2.EXE"), 4);
+	EXPECT_EQ(policy.ProfileRules(), 4);
+	EXPECT_EQ(policy.Errors(), 0);
+	EXPECT_EQ(policy.FirstErrorLine(), 0);
+
+	EXPECT_EQ(policy.LoadProfile(kProfile, "Portal2.exe"), 2);
+	EXPECT_EQ(policy.LoadProfile(kProfile, nullptr), 2);
+}
+
+// The game's own rules, then [*], then the built in ones, and the first match
+// wins, wherever the sections are in the file.
+
+TEST(PoolPolicy, GameRulesBeatAnyRulesBeatBuiltins)
+{
+	PoolPolicy policy;
+	policy.LoadProfile(kProfile, "Left4Dead2.exe");
+
+	EXPECT_EQ(policy.Decide(ManagedTexture(2048 * 2048)), kPoolActionDynamic);
+	EXPECT_EQ(policy.Decide(ManagedTexture(256 * 256)), kPoolActionPassThrough);
+	EXPECT_EQ(policy.Decide(Request(kPoolVertexBuffer, kPolicyPoolManaged, 0, 65536)), kPoolActionPassThrough);
+	EXPECT_EQ(policy.Decide(Request(kPoolIndexBuffer, kPolicyPoolManaged, 0, 512)), kPoolActionDynamic);
+
+	// Nothing in the profile, so the built in rules.
+	EXPECT_EQ(policy.Decide(Request(kPoolIndexBuffer, kPolicyPoolManaged, 0, 8192)), kPoolActionShadowed);
+	EXPECT_EQ(policy.Decide(Request(kPoolCubeTexture, kPolicyPoolManaged, 0, 65536)), kPoolActionDynamic);
+}
+
+TEST(PoolPolicy, AnySectionFirstInTheFileStillComesSecond)
+{
+	const char* profile =
+		"[*]\n"
+		"texture -> dynamic\n"
+		"[Game.exe]\n"
+		"texture -> passthrough\n";
+
+	PoolPolicy policy;
+	ASSERT_EQ(policy.LoadProfile(profile, "Game.exe"), 2);
+	EXPECT_EQ(policy.Decide(ManagedTexture()), kPoolActionPassThrough);
+
+	ASSERT_EQ(policy.LoadProfile(profile, "Else.exe"), 1);
+	EXPECT_EQ(policy.Decide(ManagedTexture()), kPoolActionDynamic);
+}
+
+TEST(PoolPolicy, SectionsCanRepeat)
+{
+	const char* profile =
+		"[Game.exe]\n"
+		"texture size<16 -> dynamic\n"
+		"[*]\n"
+		"vertex -> dynamic\n"
+		"[Game.exe]\n"
+		"texture -> passthrough\n";
+
+	PoolPolicy policy;
+	ASSERT_EQ(policy.LoadProfile(profile, "Game.exe"), 3);
+	EXPECT_EQ(policy.Decide(ManagedTexture(8)), kPoolActionDynamic);
+	EXPECT_EQ(policy.Decide(ManagedTexture(64)), kPoolActionPassThrough);
+}
+
+TEST(PoolPolicy, MalformedLinesAreSkippedAndCounted)
+{
+	const char* profile =
+		"# Lines outside a section are ignored\n"
+		"texture -> dynamic\n"
+		"[Game.exe]\n"
+		"texture -> shadowed\n"
+		"texture size>=huge -> dynamic\n"
+		"vertex -> passthrough\n"
+		"index -> never\n"
+		"   \t  \n"
+		"cube -> dynamic\n";
+
+	PoolPolicy policy;
+	EXPECT_EQ(policy.LoadProfile(profile, "Game.exe"), 3);
+	EXPECT_EQ(policy.Errors(), 2);
+	EXPECT_EQ(policy.FirstErrorLine(), 5);
+
+	// The rules around the bad ones still load.
+	EXPECT_EQ(policy.Decide(Request(kPoolVertexBuffer, kPolicyPoolManaged, 0, 65536)), kPoolActionPassThrough);
+	EXPECT_EQ(policy.Decide(Request(kPoolIndexBuffer, kPolicyPoolManaged, 0, 65536)), kPoolActionShadowed);
+}
+
+TEST(PoolPolicy, UnclosedSectionSkipsItsRules)
+{
+	const char* profile =
+		"[Game.exe\n"
+		"texture -> passthrough\n"
+		"[*]\n"
+		"vertex -> passthrough\n";
+
+	PoolPolicy policy;
+	EXPECT_EQ(policy.LoadProfile(profile, "Game.exe"), 1);
+	EXPECT_EQ(policy.Errors(), 1);
+	EXPECT_EQ(policy.FirstErrorLine(), 1);
+	EXPECT_EQ(policy.Decide(ManagedTexture()), kPoolActionShadowed);
+}
+
+TEST(PoolPolicy, OverlongLineIsAnError)
+{
+	std::string profile = "[*]\n";
+	profile += "texture -> passthrough " + std::string(300, ' ') + "\n";
+	profile += "vertex -> passthrough\n";
+
+	PoolPolicy policy;
+	EXPECT_EQ(policy.LoadProfile(profile.c_str(), "Game.exe"), 1);
+	EXPECT_EQ(policy.Errors(), 1);
+	EXPECT_EQ(policy.FirstErrorLine(), 2);
+	EXPECT_EQ(policy.Decide(ManagedTexture()), kPoolActionShadowed);
+}
+
+TEST(PoolPolicy, RulesPastTheLimitAreErrors)
+{
+	std::string profile = "[*]\n";
+	for (int i = 0; i < kMaxRules + 3; i++)
+		profile += "texture calls>=" + std::to_string(i + 1) + " -> dynamic\n";
+
+	PoolPolicy policy;
+	EXPECT_EQ(policy.LoadProfile(profile.c_str(), "Game.exe"), kMaxRules);
+	EXPECT_EQ(policy.Errors(), 3);
+	EXPECT_EQ(policy.FirstErrorLine(), kMaxRules + 2);
+}
+
+TEST(PoolPolicy, ReloadingReplacesTheProfile)
+{
+	PoolPolicy policy;
+	policy.LoadProfile("[*]\ntexture -> dynamic\nbad\n", "Game.exe");
+	ASSERT_EQ(policy.Errors(), 1);
+
+	EXPECT_EQ(policy.LoadProfile("", "Game.exe"), 0);
+	EXPECT_EQ(policy.Errors(), 0);
+	EXPECT_EQ(policy.FirstErrorLine(), 0);
+	EXPECT_EQ(policy.Decide(ManagedTexture()), kPoolActionShadowed);
+
+	EXPECT_EQ(policy.LoadProfile(nullptr, "Game.exe"), 0);
+}
+
+// A texture the game keeps recreating from the one call site, where only the
+// first few are worth the shadow.
+
+TEST(PoolPolicy, CallsRuleSeesTheCallerCounts)
+{
+	PoolPolicy policy;
+	policy.LoadProfile("[*]\ntexture calls>=4 -> dynamic\n", "Game.exe");
+
+	PoolCallerCounts counts;
+	const uintptr_t loop = 0x401000, setup = 0x402000;
+
+	for (uint32_t i = 1; i <= 3; i++)
+	{
+		uint32_t calls = counts.Count(loop, kPoolTexture);
+		ASSERT_EQ(calls, i);
+		EXPECT_EQ(policy.Decide(Request(kPoolTexture, kPolicyPoolManaged, 0, 65536, calls)), kPoolActionShadowed);
+	}
+	uint32_t calls = counts.Count(loop, kPoolTexture);
+	EXPECT_EQ(policy.Decide(Request(kPoolTexture, kPolicyPoolManaged, 0, 65536, calls)), kPoolActionDynamic);
+
+	calls = counts.Count(setup, kPoolTexture);
+	EXPECT_EQ(calls, 1u);
+	EXPECT_EQ(policy.Decide(Request(kPoolTexture, kPolicyPoolManaged, 0, 65536, calls)), kPoolActionShadowed);
+}
+
+// ------------------------------------------------------------------------
+// PoolCallerCounts
+
+TEST(PoolPolicy, CallerCountsArePerResource)
+{
+	PoolCallerCounts counts;
+
+	EXPECT_EQ(counts.Count(0x401000, kPoolTexture), 1u);
+	EXPECT_EQ(counts.Count(0x401000, kPoolTexture), 2u);
+	EXPECT_EQ(counts.Count(0x401000, kPoolVertexBuffer), 1u);
+	EXPECT_EQ(counts.Count(0x401004, kPoolTexture), 1u);
+	EXPECT_EQ(counts.Count(0x401000, kPoolTexture), 3u);
+}
+
+TEST(PoolPolicy, FullCallerTableCountsNewCallersAsFirst)
+{
+	PoolCallerCounts counts;
+	const uint32_t capacity = PoolCallerCounts::kCapacity;
+
+	for (uint32_t i = 0; i < capacity; i++)
+		ASSERT_EQ(counts.Count(0x400000 + i * 16, kPoolTexture), 1u);
+
+	EXPECT_EQ(counts.Count(0x900000, kPoolTexture), 1u);
+	EXPECT_EQ(counts.Count(0x900000, kPoolTexture), 1u);
+
+	// The ones already in keep counting.
+	EXPECT_EQ(counts.Count(0x400000, kPoolTexture), 2u);
+}
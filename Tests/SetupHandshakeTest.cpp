@@ -0,0 +1,199 @@
+// Stress test of the setup handshake in KatangaIPC.h, between two processes
+// over KatangaSharedMemory_Posix.cpp.
+//
+// The parent is the game side, and rebuilds the surface as fast as it can,
+// like a game being dragged around in windowed mode.  It writes the setup
+// fields one at a time, with yields in between, so any reader that got in
+// mid-rebuild would see a mix.  The forked child is the VR side, which begins
+// frames with KatangaTryBeginFrame, and sometimes begins twice per frame the
+// way Unity calls Update.  Inside a frame, the descriptor must be whole, and
+// must not change until the frame ends.
+
+#include "KatangaIPC.h"
+#include "KatangaSharedMemory.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <sys/wait.h>
+#include <unistd.h>
+
+
+static const uint32_t kResizes = 400;
+
+struct SurfaceSnapshot
+{
+	uint32_t handle;
+	uint32_t width;
+	uint32_t height;
+	uint32_t slots[kKatangaMaxSlots];
+};
+
+static SurfaceSnapshot ReadSurface(const KatangaSharedDescriptor* desc)
+{
+	SurfaceSnapshot snapshot;
+	snapshot.handle = desc->sharedHandle;
+	snapshot.width = desc->width;
+	snapshot.height = desc->height;
+	for (uint32_t i = 0; i < kKatangaMaxSlots; i++)
+		snapshot.slots[i] = desc->slotHandles[i];
+	return snapshot;
+}
+
+// What PublishSurface below writes, all from the one handle.
+static bool Whole(const SurfaceSnapshot& snapshot)
+{
+	uint32_t handle = snapshot.slots[0];
+	return snapshot.width == handle * 2 && snapshot.height == handle + 1 &&
+		snapshot.slots[1] == handle + 1 && snapshot.slots[2] == handle + 2;
+}
+
+static bool Same(const SurfaceSnapshot& a, const SurfaceSnapshot& b)
+{
+	return a.handle == b.handle && a.width == b.width && a.height == b.height &&
+		a.slots[0] == b.slots[0] && a.slots[1] == b.slots[1] && a.slots[2] == b.slots[2];
+}
+
+// Slowly, so a reader that is not locked out will see it half done.
+static void PublishSurface(KatangaSharedDescriptor* desc, uint32_t handle)
+{
+	desc->width = handle * 2;
+	std::this_thread::yield();
+	desc->height = handle + 1;
+	for (uint32_t i = 0; i < kKatangaMaxSlots; i++)
+	{
+		std::this_thread::yield();
+		desc->slotHandles[i] = handle + i;
+	}
+	std::atomic_thread_fence(std::memory_order_release);
+	desc->sharedHandle = handle;
+}
+
+struct ConsumerResult
+{
+	uint32_t frames;
+	uint32_t torn;
+	uint32_t changed;
+};
+
+static ConsumerResult ConsumeFrames(KatangaSharedDescriptor* desc)
+{
+	ConsumerResult result = {};
+	auto start = std::chrono::steady_clock::now();
+
+	for (uint32_t frame = 0; KatangaReadFrameSequence(desc) < kResizes; frame++)
+	{
+		if (std::chrono::steady_clock::now() - start > std::chrono::seconds(30))
+			break;
+
+		uint32_t begun = 0;
+		if (KatangaTryBeginFrame(desc))
+			begun++;
+
+		// Every third frame has a second Update before the end of frame.  If
+		// that one is locked out, it must not end the frame that began.
+		if (frame % 3 == 0 && KatangaTryBeginFrame(desc))
+			begun++;
+
+		if (begun == 0)
+		{
+			// The real VR side would wait on the mutex, here just try again.
+			std::this_thread::yield();
+			continue;
+		}
+
+		SurfaceSnapshot first = ReadSurface(desc);
+		for (int draw = 0; draw < 4; draw++)
+			std::this_thread::yield();
+		SurfaceSnapshot last = ReadSurface(desc);
+
+		result.frames++;
+		if (first.handle != 0 && !Whole(first))
+			result.torn++;
+		if (!Same(first, last))
+			result.changed++;
+
+		KatangaEndFrame(desc, begun);
+	}
+	return result;
+}
+
+
+TEST(SetupHandshake, NoTornDescriptorAcrossProcesses)
+{
+	std::string name = std::string("/KatangaHandshake_") + std::to_string(getpid());
+	std::unique_ptr<KatangaSharedMemory> game(CreateKatangaSharedMemory_Posix(name.c_str()));
+	ASSERT_TRUE(game->Create(sizeof(KatangaSharedDescriptor) + sizeof(ConsumerResult)));
+	auto desc = static_cast<KatangaSharedDescriptor*>(game->View());
+	auto shared = reinterpret_cast<ConsumerResult*>(desc + 1);
+
+	PublishSurface(desc, 16);
+
+	pid_t child = fork();
+	ASSERT_GE(child, 0);
+	if (child == 0)
+	{
+		std::unique_ptr<KatangaSharedMemory> vr(CreateKatangaSharedMemory_Posix(name.c_str()));
+		if (!vr->Open(sizeof(KatangaSharedDescriptor) + sizeof(ConsumerResult)))
+			_exit(1);
+		auto vrDesc = static_cast<KatangaSharedDescriptor*>(vr->View());
+		*reinterpret_cast<ConsumerResult*>(vrDesc + 1) = ConsumeFrames(vrDesc);
+		_exit(0);
+	}
+
+	uint32_t timeouts = 0;
+	for (uint32_t resize = 1; resize <= kResizes; resize++)
+	{
+		KatangaBeginSetup(desc);
+		if (!KatangaWaitConsumerIdle(desc, std::chrono::milliseconds(1000)))
+			timeouts++;
+
+		KatangaRetractSurface(desc);
+		PublishSurface(desc, 16 + resize * 8);
+		KatangaEndSetup(desc);
+
+		// A few game frames between each rebuild.
+		KatangaPublishFrame(desc, resize);
+		std::this_thread::sleep_for(std::chrono::microseconds(100));
+	}
+
+	int status = 0;
+	ASSERT_EQ(waitpid(child, &status, 0), child);
+	ASSERT_TRUE(WIFEXITED(status));
+	ASSERT_EQ(WEXITSTATUS(status), 0);
+
+	EXPECT_EQ(timeouts, 0u);
+	EXPECT_GT(shared->frames, 0u);
+	EXPECT_EQ(shared->torn, 0u);
+	EXPECT_EQ(shared->changed, 0u);
+	EXPECT_EQ(desc->consumerBusy.load(), 0u);
+}
+
+
+// The nested Update case on its own, in one process.
+
+TEST(SetupHandshake, LockedOutSecondBeginKeepsFrameBusy)
+{
+	KatangaSharedDescriptor desc = {};
+
+	ASSERT_TRUE(KatangaTryBeginFrame(&desc));
+	KatangaBeginSetup(&desc);
+	EXPECT_FALSE(KatangaTryBeginFrame(&desc));
+
+	// The first frame is still drawing, so the game side must still wait.
+	EXPECT_FALSE(KatangaConsumerIdle(&desc));
+	EXPECT_FALSE(KatangaWaitConsumerIdle(&desc, std::chrono::milliseconds(5)));
+
+	KatangaEndFrame(&desc, 1);
+	EXPECT_TRUE(KatangaConsumerIdle(&desc));
+	EXPECT_TRUE(KatangaWaitConsumerIdle(&desc, std::chrono::milliseconds(5)));
+	KatangaEndSetup(&desc);
+
+	ASSERT_TRUE(KatangaTryBeginFrame(&desc));
+	ASSERT_TRUE(KatangaTryBeginFrame(&desc));
+	KatangaEndFrame(&desc, 2);
+	EXPECT_TRUE(KatangaConsumerIdle(&desc));
+}
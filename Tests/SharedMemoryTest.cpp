@@ -0,0 +1,190 @@
+// Tests of KatangaSharedMemory_Posix.cpp, and of the KatangaSharedDescriptor
+// between two real processes.  The parent is the game side, which creates the
+// block, and a forked child is the VR side, which opens it by name.
+
+#include "KatangaIPC.h"
+#include "KatangaSharedMemory.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <sys/wait.h>
+#include <unistd.h>
+
+
+// Each test gets its own name, so parallel ctest runs don't share a block.
+static std::string TestName(const char* test)
+{
+	return std::string("/KatangaTest_") + test + "_" + std::to_string(getpid());
+}
+
+static bool TimedOut(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::steady_clock::now() - start > std::chrono::seconds(10);
+}
+
+
+TEST(SharedMemory, CreateIsZeroFilled)
+{
+	std::unique_ptr<KatangaSharedMemory> game(CreateKatangaSharedMemory_Posix(TestName("Zero").c_str()));
+	ASSERT_TRUE(game->Create(sizeof(KatangaSharedDescriptor)));
+
+	const uint8_t* bytes = static_cast<const uint8_t*>(game->View());
+	for (size_t i = 0; i < sizeof(KatangaSharedDescriptor); i++)
+		ASSERT_EQ(bytes[i], 0) << "at " << i;
+
+	auto desc = static_cast<KatangaSharedDescriptor*>(game->View());
+	EXPECT_EQ(desc->sharedHandle, 0u);
+	EXPECT_FALSE(KatangaIsDescriptorValid(desc));
+}
+
+TEST(SharedMemory, OpenBeforeCreateFails)
+{
+	std::string name = TestName("Missing");
+	std::unique_ptr<KatangaSharedMemory> vr(CreateKatangaSharedMemory_Posix(name.c_str()));
+	EXPECT_FALSE(vr->Open(sizeof(KatangaSharedDescriptor)));
+	EXPECT_EQ(vr->View(), nullptr);
+	EXPECT_NE(vr->LastError(), 0u);
+
+	// And again once the game side closes it, the creator unlinks the name.
+	std::unique_ptr<KatangaSharedMemory> game(CreateKatangaSharedMemory_Posix(name.c_str()));
+	ASSERT_TRUE(game->Create(sizeof(KatangaSharedDescriptor)));
+	EXPECT_TRUE(vr->Open(sizeof(KatangaSharedDescriptor)));
+	vr->Close();
+	game->Close();
+	EXPECT_FALSE(vr->Open(sizeof(KatangaSharedDescriptor)));
+}
+
+TEST(SharedMemory, BothViewsSeeTheSameDescriptor)
+{
+	std::string name = TestName("Views");
+	std::unique_ptr<KatangaSharedMemory> game(CreateKatangaSharedMemory_Posix(name.c_str()));
+	std::unique_ptr<KatangaSharedMemory> vr(CreateKatangaSharedMemory_Posix(name.c_str()));
+	ASSERT_TRUE(game->Create(sizeof(KatangaSharedDescriptor)));
+	ASSERT_TRUE(vr->Open(sizeof(KatangaSharedDescriptor)));
+
+	auto gameDesc = static_cast<KatangaSharedDescriptor*>(game->View());
+	auto vrDesc = static_cast<KatangaSharedDescriptor*>(vr->View());
+	ASSERT_NE(static_cast<void*>(gameDesc), static_cast<void*>(vrDesc));
+
+	const uint32_t slots[kKatangaMaxSlots] = { 0x100, 0x104, 0x108 };
+	KatangaPublishSurface(gameDesc, slots, kKatangaMaxSlots, 3840, 1080, 28, kLayoutSideBySide, 0);
+	EXPECT_TRUE(KatangaIsDescriptorValid(vrDesc));
+	EXPECT_EQ(vrDesc->sharedHandle, 0x100u);
+	EXPECT_EQ(vrDesc->width, 3840u);
+
+	KatangaRequestCopy(vrDesc, KatangaPackCopyRequest(kCopyModeHalf, 0, 0, 0, 0));
+	uint32_t crop[4];
+	EXPECT_EQ(KatangaUnpackCopyRequest(KatangaReadCopyRequest(gameDesc), crop), kCopyModeHalf);
+}
+
+
+// The game side rebuilds the surfaces over and over, with frames in between,
+// and the VR side reads the descriptor the way RenderAPI_D3D11 does.  Whenever
+// it sees a stable setupSequence around its reads, everything it read has to
+// be from the one surface, and frames can only go forward.
+
+static const uint32_t kSurfaces = 100;
+static const uint32_t kFramesPerSurface = 20;
+
+static void PublishTestSurface(KatangaSharedDescriptor* desc, uint32_t handle)
+{
+	const uint32_t slots[kKatangaMaxSlots] = { handle, handle + 1, handle + 2 };
+	KatangaPublishSurface(desc, slots, kKatangaMaxSlots, handle * 2, handle + 1, 28, kLayoutSideBySide, 0);
+}
+
+// Child process, returns the number of failures as its exit code.
+static int ReadDescriptorsInChild(const std::string& name)
+{
+	std::unique_ptr<KatangaSharedMemory> vr(CreateKatangaSharedMemory_Posix(name.c_str()));
+	auto start = std::chrono::steady_clock::now();
+	while (!vr->Open(sizeof(KatangaSharedDescriptor)))
+	{
+		if (TimedOut(start))
+			return 100;
+		std::this_thread::yield();
+	}
+	auto desc = static_cast<KatangaSharedDescriptor*>(vr->View());
+
+	// Tell the game side we're here, through a field only we write.
+	KatangaRequestCopy(desc, KatangaPackCopyRequest(kCopyModeCrop, 1, 2, 3, 4));
+
+	int failures = 0;
+	uint64_t lastFrame = 0;
+	uint32_t stableReads = 0;
+	while (KatangaReadFrameSequence(desc) < (uint64_t)kSurfaces * kFramesPerSurface)
+	{
+		if (TimedOut(start))
+			return failures + 101;
+
+		uint64_t frame = KatangaReadFrameSequence(desc);
+		if (frame < lastFrame)
+			failures++;
+		lastFrame = frame;
+
+		uint32_t before = desc->setupSequence.load();
+		if (before & 1)
+			continue;
+
+		uint32_t handle = desc->sharedHandle;
+		uint32_t width = desc->width;
+		uint32_t height = desc->height;
+		uint32_t lastSlot = desc->slotHandles[kKatangaMaxSlots - 1];
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (desc->setupSequence.load() != before || handle == 0)
+			continue;
+
+		stableReads++;
+		if (width != handle * 2 || height != handle + 1 || lastSlot != handle + 2)
+			failures++;
+	}
+
+	// Must have seen at least some of it, or the test did nothing.
+	if (stableReads == 0)
+		failures++;
+	return failures;
+}
+
+TEST(SharedMemory, DescriptorAcrossProcesses)
+{
+	std::string name = TestName("Processes");
+	std::unique_ptr<KatangaSharedMemory> game(CreateKatangaSharedMemory_Posix(name.c_str()));
+	ASSERT_TRUE(game->Create(sizeof(KatangaSharedDescriptor)));
+	auto desc = static_cast<KatangaSharedDescriptor*>(game->View());
+
+	pid_t child = fork();
+	ASSERT_GE(child, 0);
+	if (child == 0)
+		_exit(ReadDescriptorsInChild(name));
+
+	auto start = std::chrono::steady_clock::now();
+	while (KatangaReadCopyRequest(desc) == 0 && !TimedOut(start))
+		std::this_thread::yield();
+	uint32_t crop[4];
+	EXPECT_EQ(KatangaUnpackCopyRequest(KatangaReadCopyRequest(desc), crop), kCopyModeCrop);
+	EXPECT_EQ(crop[3], 4u);
+
+	for (uint32_t surface = 1; surface <= kSurfaces; surface++)
+	{
+		KatangaBeginSetup(desc);
+		KatangaRetractSurface(desc);
+		PublishTestSurface(desc, surface * 16);
+		KatangaEndSetup(desc);
+
+		for (uint32_t frame = 0; frame < kFramesPerSurface; frame++)
+		{
+			// Sleep, not yield, so the child gets to run even on one core.
+			KatangaPublishFrame(desc, frame);
+			std::this_thread::sleep_for(std::chrono::microseconds(20));
+		}
+	}
+
+	int status = 0;
+	ASSERT_EQ(waitpid(child, &status, 0), child);
+	ASSERT_TRUE(WIFEXITED(status));
+	EXPECT_EQ(WEXITSTATUS(status), 0);
+	EXPECT_EQ(desc->setupSequence.load(), kSurfaces * 2);
+}
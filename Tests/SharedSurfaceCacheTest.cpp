@@ -0,0 +1,119 @@
+// Tests of SharedSurfaceCache.h, with fake textures and views that count
+// their references instead of the D3D11 ones.
+
+#include "SharedSurfaceCache.h"
+
+#include <gtest/gtest.h>
+
+
+struct FakeSurface
+{
+	void Release() { refs--; }
+
+	int refs = 1;
+};
+
+typedef SharedSurfaceCache<FakeSurface, FakeSurface> TestCache;
+
+// What CreateSharedSurface does for one ring, opening whatever is not already
+// open.  Returns how many were found in the cache.
+
+static int OpenRing(TestCache& cache, const uint32_t* handles, int count,
+	FakeSurface* textures, FakeSurface* views)
+{
+	cache.Retain(handles, count);
+
+	int found = 0;
+	for (int i = 0; i < count; i++)
+	{
+		SharedSurfaceKey key = { handles[i], 1920, 1080, 28 };
+		FakeSurface* texture;
+		FakeSurface* view;
+		if (cache.Find(key, &texture, &view))
+		{
+			EXPECT_EQ(texture, &textures[i]);
+			EXPECT_EQ(view, &views[i]);
+			found++;
+			continue;
+		}
+		cache.Insert(key, &textures[i], &views[i]);
+	}
+	return found;
+}
+
+
+TEST(SharedSurfaceCacheTest, SameRingAgainIsAllHits)
+{
+	TestCache cache;
+	uint32_t ring[3] = { 0x100, 0x104, 0x108 };
+	FakeSurface textures[3], views[3];
+
+	EXPECT_EQ(OpenRing(cache, ring, 3, textures, views), 0);
+	EXPECT_EQ(OpenRing(cache, ring, 3, textures, views), 3);
+	EXPECT_EQ(cache.Count(), 3);
+	EXPECT_EQ(cache.Evictions(), 0u);
+	for (int i = 0; i < 3; i++)
+		EXPECT_EQ(textures[i].refs, 1);
+}
+
+// A rebuild publishes new handles, and the old ring must be let go then,
+// not kept open until the cache happens to fill.
+
+TEST(SharedSurfaceCacheTest, NewRingReleasesTheOldOne)
+{
+	TestCache cache;
+	uint32_t oldRing[3] = { 0x100, 0x104, 0x108 };
+	uint32_t newRing[3] = { 0x200, 0x204, 0x208 };
+	FakeSurface oldTextures[3], oldViews[3];
+	FakeSurface newTextures[3], newViews[3];
+
+	OpenRing(cache, oldRing, 3, oldTextures, oldViews);
+	EXPECT_EQ(OpenRing(cache, newRing, 3, newTextures, newViews), 0);
+
+	EXPECT_EQ(cache.Count(), 3);
+	EXPECT_EQ(cache.Evictions(), 3u);
+	for (int i = 0; i < 3; i++)
+	{
+		EXPECT_EQ(oldTextures[i].refs, 0);
+		EXPECT_EQ(oldViews[i].refs, 0);
+		EXPECT_EQ(newTextures[i].refs, 1);
+		EXPECT_EQ(newViews[i].refs, 1);
+	}
+}
+
+// An older game plugin only publishes slot 0, anything else open goes.
+
+TEST(SharedSurfaceCacheTest, RetainKeepsOnlyPublishedHandles)
+{
+	TestCache cache;
+	uint32_t ring[3] = { 0x100, 0x104, 0x108 };
+	FakeSurface textures[3], views[3];
+
+	OpenRing(cache, ring, 3, textures, views);
+	cache.Retain(ring, 1);
+
+	EXPECT_EQ(cache.Count(), 1);
+	EXPECT_EQ(textures[0].refs, 1);
+	EXPECT_EQ(textures[1].refs, 0);
+	EXPECT_EQ(textures[2].refs, 0);
+
+	cache.Retain(nullptr, 0);
+	EXPECT_EQ(cache.Count(), 0);
+	EXPECT_EQ(views[0].refs, 0);
+}
+
+TEST(SharedSurfaceCacheTest, ClearReleasesEverything)
+{
+	FakeSurface textures[3], views[3];
+	{
+		TestCache cache;
+		uint32_t ring[3] = { 0x100, 0x104, 0x108 };
+		OpenRing(cache, ring, 3, textures, views);
+		cache.Clear();
+		EXPECT_EQ(cache.Count(), 0);
+		for (int i = 0; i < 3; i++)
+			EXPECT_EQ(textures[i].refs, 0);
+	}
+	for (int i = 0; i < 3; i++)
+		EXPECT_EQ(views[i].refs, 0);
+}
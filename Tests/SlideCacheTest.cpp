@@ -0,0 +1,477 @@
+// Tests of SlideCache.h, with a fake decoder whose images are filled with the
+// file name's tag, and whose decodes of chosen files hold until let go, to
+// catch the workers in the middle of one.
+
+#include "SlideCache.h"
+#include "YCbCrConvert.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+// Taken by reference in EXPECT_EQ, which the class constant can't be.
+static const int kMaxWorkers = SlideCache::kMaxWorkers;
+
+// Every image is 16x8, or half that when the screen allows, so each is 512
+// bytes full size.
+const size_t kSlideBytes = 16 * 8 * 4;
+
+class FakeSlideDecoder : public SlideDecoder
+{
+public:
+	// What the test sees, since the cache owns the decoder.
+	struct Log
+	{
+		std::mutex lock;
+		std::vector<std::string> decoded;		// In the order they began.
+		std::set<std::string> held;
+		std::set<std::string> failing;
+		std::atomic<int> inside{ 0 };
+		std::atomic<int> begins{ 0 };
+		std::atomic<int> ends{ 0 };
+		uint32_t maxWidth = 0;
+		uint32_t maxHeight = 0;
+
+		std::vector<std::string> Decoded()
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			return decoded;
+		}
+
+		void Hold(const std::string& path)
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			held.insert(path);
+		}
+
+		void Release(const std::string& path)
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			held.erase(path);
+		}
+	};
+
+	FakeSlideDecoder(Log* log) : log(log) { }
+
+	void BeginThread() override { log->begins++; }
+	void EndThread() override { log->ends++; }
+
+	bool Decode(const std::string& path, uint32_t maxWidth, uint32_t maxHeight, SlideImage* image) override
+	{
+		{
+			std::lock_guard<std::mutex> guard(log->lock);
+			log->decoded.push_back(path);
+			log->maxWidth = maxWidth;
+			log->maxHeight = maxHeight;
+		}
+		log->inside++;
+		for (;;)
+		{
+			{
+				std::lock_guard<std::mutex> guard(log->lock);
+				if (log->held.count(path) == 0)
+					break;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		log->inside--;
+
+		std::lock_guard<std::mutex> guard(log->lock);
+		if (log->failing.count(path) != 0)
+			return false;
+		int halvings = SlideHalvings(16, 8, maxWidth, maxHeight);
+		image->sourceWidth = 16;
+		image->sourceHeight = 8;
+		image->width = 16 >> halvings;
+		image->height = 8 >> halvings;
+		image->pixels.assign((size_t)image->width * image->height * 4, Tag(path));
+		return true;
+	}
+
+	// The pixels say which file they came from.
+	static uint8_t Tag(const std::string& path)
+	{
+		uint8_t tag = 0;
+		for (char c : path)
+			tag = (uint8_t)(tag * 31 + c);
+		return tag;
+	}
+
+private:
+	Log* log;
+};
+
+// The cache only detaches its workers when destroyed, for the plugin's static
+// one at process exit.  A test's cache has to stop them, even when an ASSERT
+// leaves early, or they wait on a condition variable that is gone.
+class StoppingSlideCache : public SlideCache
+{
+public:
+	~StoppingSlideCache() { Stop(); }
+};
+
+static std::vector<std::string> Files(const char* prefix, int count)
+{
+	std::vector<std::string> files;
+	for (int i = 0; i < count; i++)
+		files.push_back(prefix + std::to_string(i));
+	return files;
+}
+
+template <typename Predicate>
+static bool WaitUntil(Predicate done)
+{
+	for (int i = 0; i < 5000; i++)
+	{
+		if (done())
+			return true;
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return done();
+}
+
+// Once the workers have nothing left, and are not inside a decode.
+static bool Idle(SlideCache* cache, FakeSlideDecoder::Log* log, size_t decodes)
+{
+	return WaitUntil([&]
+	{
+		SlideCacheStats stats = cache->Stats();
+		return log->Decoded().size() == decodes && stats.decoded + stats.failed == decodes && log->inside == 0;
+	});
+}
+
+
+// ------------------------------------------------------------------------
+// Prefetch
+
+TEST(SlideCache, ShowDecodesTheWindowNearestFirst)
+{
+	FakeSlideDecoder::Log log;
+	StoppingSlideCache cache;
+	cache.Start(new FakeSlideDecoder(&log), 1, 2, 1, 1 << 20, 0, 0);
+	cache.SetFiles(Files("slide", 10));
+	EXPECT_EQ(cache.FileCount(), 10);
+
+	cache.Show(5);
+	ASSERT_TRUE(Idle(&cache, &log, 4));
+	EXPECT_EQ(log.Decoded(), (std::vector<std::string>{ "slide5", "slide6", "slide4", "slide7" }));
+
+	for (int index : { 4, 5, 6, 7 })
+	{
+		std::shared_ptr<const SlideImage> image = cache.Get(index);
+		ASSERT_TRUE(image != nullptr) << index;
+		EXPECT_EQ(image->width, 16u);
+		EXPECT_EQ(image->pixels[0], FakeSlideDecoder::Tag("slide" + std::to_string(index)));
+	}
+	EXPECT_TRUE(cache.Get(3) == nullptr);
+	EXPECT_TRUE(cache.Get(8) == nullptr);
+
+	SlideCacheStats stats = cache.Stats();
+	EXPECT_EQ(stats.hits, 4u);
+	EXPECT_EQ(stats.misses, 2u);
+	EXPECT_EQ(stats.decoded, 4u);
+	EXPECT_EQ(stats.count, 4u);
+	EXPECT_EQ(stats.bytes, 4 * kSlideBytes);
+	EXPECT_GT(stats.decodeNs, 0);
+}
+
+// The list wraps both ways, and indexes past the end are the same slides.
+TEST(SlideCache, WindowWrapsAround)
+{
+	FakeSlideDecoder::Log log;
+	StoppingSlideCache cache;
+	cache.Start(new FakeSlideDecoder(&log), 1, 1, 2, 1 << 20, 0, 0);
+	cache.SetFiles(Files("slide", 10));
+
+	cache.Show(10);
+	ASSERT_TRUE(Idle(&cache, &log, 4));
+	EXPECT_EQ(log.Decoded(), (std::vector<std::string>{ "slide0", "slide1", "slide9", "slide8" }));
+	EXPECT_TRUE(cache.Get(-1) != nullptr);
+	EXPECT_TRUE(cache.Get(11) != nullptr);
+
+	// Moving on only decodes what's new in the window.
+	cache.Show(1);
+	ASSERT_TRUE(Idle(&cache, &log, 5));
+	EXPECT_EQ(log.Decoded().back(), "slide2");
+}
+
+TEST(SlideCache, GetNeverWaitsButWaitDoes)
+{
+	FakeSlideDecoder::Log log;
+	log.Hold("slide0");
+	StoppingSlideCache cache;
+	cache.Start(new FakeSlideDecoder(&log), 1, 0, 0, 1 << 20, 0, 0);
+	cache.SetFiles(Files("slide", 3));
+	cache.Show(0);
+	ASSERT_TRUE(WaitUntil([&] { return log.inside == 1; }));
+
+	EXPECT_TRUE(cache.Get(0) == nullptr);
+	auto start = std::chrono::steady_clock::now();
+	EXPECT_TRUE(cache.Wait(0, 30) == nullptr);
+	EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(25));
+
+	// A slide nobody queued isn't waited for.
+	start = std::chrono::steady_clock::now();
+	EXPECT_TRUE(cache.Wait(1, 5000) == nullptr);
+	EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(1000));
+
+	std::thread release([&]
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		log.Release("slide0");
+	});
+	std::shared_ptr<const SlideImage> image = cache.Wait(0, 5000);
+	release.join();
+	ASSERT_TRUE(image != nullptr);
+	EXPECT_EQ(image->pixels[0], FakeSlideDecoder::Tag("slide0"));
+	EXPECT_EQ(cache.Stats().misses, 3u);
+}
+
+// Skipping ahead replaces the queue, what was skipped is never decoded.
+TEST(SlideCache, SkippingDropsTheOldQueue)
+{
+	FakeSlideDecoder::Log log;
+	log.Hold("slide0");
+	StoppingSlideCache cache;
+	cache.Start(new FakeSlideDecoder(&log), 1, 2, 0, 1 << 20, 0, 0);
+	cache.SetFiles(Files("slide", 20));
+
+	cache.Show(0);
+	ASSERT_TRUE(WaitUntil([&] { return log.inside == 1; }));
+	cache.Show(10);
+	log.Release("slide0");
+	ASSERT_TRUE(Idle(&cache, &log, 4));
+	EXPECT_EQ(log.Decoded(), (std::vector<std::string>{ "slide0", "slide10", "slide11", "slide12" }));
+
+	// The one already decoding still went in, it may be shown again.
+	EXPECT_TRUE(cache.Get(0) != nullptr);
+}
+
+TEST(SlideCache, FailedSlidesAreNotRetried)
+{
+	FakeSlideDecoder::Log log;
+	log.failing.insert("slide1");
+	StoppingSlideCache cache;
+	cache.Start(new FakeSlideDecoder(&log), 2, 1, 0, 1 << 20, 0, 0);
+	cache.SetFiles(Files("slide", 4));
+
+	cache.Show(1);
+	ASSERT_TRUE(Idle(&cache, &log, 2));
+	EXPECT_TRUE(cache.Get(1) == nullptr);
+	EXPECT_TRUE(cache.Wait(1, 5000) == nullptr);
+	cache.Show(1);
+	cache.Show(0);
+	ASSERT_TRUE(Idle(&cache, &log, 3));
+
+	SlideCacheStats stats = cache.Stats();
+	EXPECT_EQ(stats.failed, 1u);
+	EXPECT_EQ(stats.decoded, 2u);
+	EXPECT_EQ(stats.count, 3u);					// The failure is kept.
+	EXPECT_EQ(stats.bytes, 2 * kSlideBytes);
+}
+
+TEST(SlideCache, DecoderGetsTheScreenSize)
+{
+	FakeSlideDecoder::Log log;
+	StoppingSlideCache cache;
+	cache.Start(new FakeSlideDecoder(&log), 1, 0, 0, 1 << 20, 8, 4);
+	cache.SetFiles(Files("slide", 1));
+	cache.Show(0);
+	std::shared_ptr<const SlideImage> image = cache.Wait(0, 5000);
+
+	ASSERT_TRUE(image != nullptr);
+	EXPECT_EQ(log.maxWidth, 8u);
+	EXPECT_EQ(log.maxHeight, 4u);
+	EXPECT_EQ(image->width, 8u);
+	EXPECT_EQ(image->sourceWidth, 16u);
+	EXPECT_EQ(cache.Stats().bytes, kSlideBytes / 4);
+}
+
+// ------------------------------------------------------------------------
+// Eviction
+
+// Room for three.  Moving the window away pushes out the old slides, least
+// recently used first, and keeps the new ones.
+
+TEST(SlideCache, EvictsOutsideTheWindowFirst)
+{
+	FakeSlideDecoder::Log log;
+	StoppingSlideCache cache;
+	cache.Start(new FakeSlideDecoder(&log), 1, 1, 0, 3 * kSlideBytes, 0, 0);
+	cache.SetFiles(Files("slide", 10));
+
+	cache.Show(0);
+	ASSERT_TRUE(Idle(&cache, &log, 2));
+	cache.Get(0);
+
+	// 0 and 1 are out of the window, 0 was used last, so 1 goes.
+	cache.Show(2);
+	ASSERT_TRUE(Idle(&cache, &log, 4));
+	SlideCacheStats stats = cache.Stats();
+	EXPECT_EQ(stats.count, 3u);
+	EXPECT_EQ(stats.evicted, 1u);
+
+	// Then 0, then 2, which is now out too, and 3 is the one left.
+	cache.Show(5);
+	ASSERT_TRUE(Idle(&cache, &log, 6));
+	stats = cache.Stats();
+	EXPECT_EQ(stats.count, 3u);
+	EXPECT_EQ(stats.bytes, 3 * kSlideBytes);
+	EXPECT_EQ(stats.evicted, 3u);
+	EXPECT_TRUE(cache.Get(5) != nullptr);
+	EXPECT_TRUE(cache.Get(6) != nullptr);
+	EXPECT_TRUE(cache.Get(3) != nullptr);
+	EXPECT_TRUE(cache.Get(0) == nullptr);
+	EXPECT_TRUE(cache.Get(1) == nullptr);
+	EXPECT_TRUE(cache.Get(2) == nullptr);
+}
+
+// A window bigger than the cache keeps the nearest slides, and never the
+// current one goes, even when it alone is over.
+
+TEST(SlideCache, EvictsTheFarthestInTheWindow)
+{
+	FakeSlideDecoder::Log log;
+	StoppingSlideCache cache;
+	cache.Start(new FakeSlideDecoder(&log), 1, 3, 0, 2 * kSlideBytes, 0, 0);
+	cache.SetFiles(Files("slide", 10));
+
+	cache.Show(0);
+	ASSERT_TRUE(Idle(&cache, &log, 4));
+	EXPECT_TRUE(cache.Get(0) != nullptr);
+	EXPECT_TRUE(cache.Get(1) != nullptr);
+	EXPECT_TRUE(cache.Get(2) == nullptr);
+	EXPECT_TRUE(cache.Get(3) == nullptr);
+	EXPECT_EQ(cache.Stats().bytes, 2 * kSlideBytes);
+
+	FakeSlideDecoder::Log tiny;
+	StoppingSlideCache small;
+	small.Start(new FakeSlideDecoder(&tiny), 1, 1, 0, kSlideBytes / 2, 0, 0);
+	small.SetFiles(Files("slide", 10));
+	small.Show(4);
+	ASSERT_TRUE(Idle(&small, &tiny, 2));
+	EXPECT_TRUE(small.Get(4) != nullptr);
+	EXPECT_EQ(small.Stats().count, 1u);
+}
+
+// An evicted image the caller still has stays good.
+TEST(SlideCache, HeldImagesOutliveEviction)
+{
+	FakeSlideDecoder::Log log;
+	StoppingSlideCache cache;
+	cache.Start(new FakeSlideDecoder(&log), 1, 0, 0, kSlideBytes, 0, 0);
+	cache.SetFiles(Files("slide", 10));
+
+	cache.Show(0);
+	std::shared_ptr<const SlideImage> held = cache.Wait(0, 5000);
+	ASSERT_TRUE(held != nullptr);
+	cache.Show(1);
+	ASSERT_TRUE(cache.Wait(1, 5000) != nullptr);
+	EXPECT_TRUE(cache.Get(0) == nullptr);
+	EXPECT_EQ(held->pixels.size(), kSlideBytes);
+	EXPECT_EQ(held->pixels.back(), FakeSlideDecoder::Tag("slide0"));
+}
+
+// ------------------------------------------------------------------------
+// SetFiles and Stop
+
+// A decode of the old list that finishes after SetFiles is thrown away, and
+// the same index is decoded again from the new file, by another worker while
+// the old one is still going.
+
+TEST(SlideCache, SetFilesDropsDecodesInFlight)
+{
+	FakeSlideDecoder::Log log;
+	log.Hold("old0");
+	StoppingSlideCache cache;
+	cache.Start(new FakeSlideDecoder(&log), 2, 0, 0, 1 << 20, 0, 0);
+	cache.SetFiles(Files("old", 3));
+	cache.Show(0);
+	ASSERT_TRUE(WaitUntil([&] { return log.inside == 1; }));
+
+	cache.SetFiles(Files("new", 3));
+	EXPECT_EQ(cache.Stats().count, 0u);
+	cache.Show(0);
+	std::shared_ptr<const SlideImage> image = cache.Wait(0, 5000);
+	ASSERT_TRUE(image != nullptr);
+	EXPECT_EQ(image->pixels[0], FakeSlideDecoder::Tag("new0"));
+
+	log.Release("old0");
+	ASSERT_TRUE(Idle(&cache, &log, 2));
+	image = cache.Get(0);
+	ASSERT_TRUE(image != nullptr);
+	EXPECT_EQ(image->pixels[0], FakeSlideDecoder::Tag("new0"));
+
+	SlideCacheStats stats = cache.Stats();
+	EXPECT_EQ(stats.decoded, 2u);
+	EXPECT_EQ(stats.count, 1u);
+	EXPECT_EQ(stats.bytes, kSlideBytes);
+}
+
+// With one worker the new list waits for the old decode, which must not take
+// the new one's place in flight or in the cache.
+
+TEST(SlideCache, SetFilesWithOneWorker)
+{
+	FakeSlideDecoder::Log log;
+	log.Hold("old0");
+	StoppingSlideCache cache;
+	cache.Start(new FakeSlideDecoder(&log), 1, 1, 0, 1 << 20, 0, 0);
+	cache.SetFiles(Files("old", 3));
+	cache.Show(0);
+	ASSERT_TRUE(WaitUntil([&] { return log.inside == 1; }));
+
+	cache.SetFiles(Files("new", 3));
+	cache.Show(0);
+	log.Release("old0");
+	ASSERT_TRUE(Idle(&cache, &log, 3));
+	EXPECT_EQ(log.Decoded(), (std::vector<std::string>{ "old0", "new0", "new1" }));
+	EXPECT_EQ(cache.Get(0)->pixels[0], FakeSlideDecoder::Tag("new0"));
+	EXPECT_EQ(cache.Stats().count, 2u);
+
+	// An empty list has nothing.
+	cache.SetFiles(std::vector<std::string>());
+	cache.Show(0);
+	EXPECT_TRUE(cache.Get(0) == nullptr);
+	EXPECT_TRUE(cache.Wait(0, 5000) == nullptr);
+	EXPECT_EQ(cache.FileCount(), 0);
+}
+
+TEST(SlideCache, StopWaitsForTheWorkersAndEmpties)
+{
+	FakeSlideDecoder::Log log;
+	log.Hold("slide0");
+	StoppingSlideCache cache;
+	cache.Start(new FakeSlideDecoder(&log), 99, 2, 2, 1 << 20, 0, 0);
+	ASSERT_TRUE(WaitUntil([&] { return log.begins == kMaxWorkers; }));
+	cache.SetFiles(Files("slide", 10));
+	cache.Show(0);
+	ASSERT_TRUE(WaitUntil([&] { return log.inside == 1 && cache.Stats().decoded == 4; }));
+
+	std::thread release([&]
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		log.Release("slide0");
+	});
+	cache.Stop();
+	release.join();
+	EXPECT_EQ(log.inside, 0);
+	EXPECT_EQ(log.ends, kMaxWorkers);
+	EXPECT_EQ(cache.Stats().count, 0u);
+	EXPECT_EQ(cache.Stats().bytes, 0u);
+
+	// And starts again with the list it had.
+	FakeSlideDecoder::Log again;
+	cache.Start(new FakeSlideDecoder(&again), 0, 0, 0, 1 << 20, 0, 0);
+	ASSERT_TRUE(WaitUntil([&] { return again.begins == 1; }));
+	cache.Show(3);
+	ASSERT_TRUE(cache.Wait(3, 5000) != nullptr);
+	cache.Stop();
+	EXPECT_EQ(again.ends, 1);
+}
@@ -0,0 +1,673 @@
+// Tests of SlideIndex.h, the file format through SlideIndexView, and the
+// indexer against a folder and index file kept in memory, with a fake decoder
+// that makes flat or striped pictures, fails on request, and can be held in
+// the middle of a decode.
+
+#include "SlideIndex.h"
+#include "YCbCrConvert.h"
+
+#include <gtest/gtest.h>
+
+#include <stdio.h>
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+// What both fakes share, and outlives them, since the indexer owns them.
+struct FakeSlideFolder
+{
+	std::mutex lock;
+
+	// The folder.
+	std::vector<SlideIndexFile> files;
+	bool listFails = false;
+	std::atomic<bool> listHeld{ false };	// List waits until it's cleared.
+
+	// The index file, if hasIndex.
+	std::vector<uint8_t> index;
+	bool hasIndex = false;
+	bool readOnly = false;
+	int mapped = 0;							// Mapped and not unmapped yet.
+
+	// The pictures, by name, and what the decoder did.
+	struct Picture
+	{
+		uint32_t width = 2048;
+		uint32_t height = 512;
+		uint32_t bgra = 0xFF404040;			// Flat, or the left eye of it.
+		uint32_t rightBgra = 0;				// Right half of side by side, if set.
+		bool stripes = false;				// Same vertical stripes in both halves.
+	};
+	std::map<std::string, Picture> pictures;
+	std::set<std::string> failing;
+	std::set<std::string> held;
+	std::vector<std::string> decoded;
+	std::atomic<int> inside{ 0 };
+	uint32_t maxWidth = 0;
+	uint32_t maxHeight = 0;
+
+	void Add(const std::string& name, uint64_t modified, uint64_t size = 1000)
+	{
+		SlideIndexFile file;
+		file.name = name;
+		file.modified = modified;
+		file.size = size;
+		files.push_back(file);
+	}
+
+	void Touch(const std::string& name, uint64_t modified)
+	{
+		for (SlideIndexFile& file : files)
+		{
+			if (file.name == name)
+				file.modified = modified;
+		}
+	}
+
+	void Remove(const std::string& name)
+	{
+		for (size_t i = 0; i < files.size(); i++)
+		{
+			if (files[i].name == name)
+				files.erase(files.begin() + i);
+		}
+	}
+
+	std::vector<std::string> Decoded()
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		return decoded;
+	}
+
+	void Release(const std::string& name)
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		held.erase(name);
+	}
+};
+
+static const char kFolder[] = "/pictures/";
+
+class FakeSlideIndexStore : public SlideIndexStore
+{
+public:
+	FakeSlideIndexStore(FakeSlideFolder* folder) : folder(folder) { }
+
+	~FakeSlideIndexStore()
+	{
+		Unmap();
+	}
+
+	bool List(std::vector<SlideIndexFile>* files) override
+	{
+		while (folder->listHeld)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		std::lock_guard<std::mutex> guard(folder->lock);
+		*files = folder->files;
+		return !folder->listFails;
+	}
+
+	std::string FullPath(const std::string& name) override
+	{
+		return kFolder + name;
+	}
+
+	// A copy, which Unmap scribbles over, so a view left on it reads junk.
+	bool Map(const uint8_t** data, size_t* size) override
+	{
+		Unmap();
+		std::lock_guard<std::mutex> guard(folder->lock);
+		if (!folder->hasIndex)
+			return false;
+		mapping = folder->index;
+		folder->mapped++;
+		*data = mapping.data();
+		*size = mapping.size();
+		return true;
+	}
+
+	void Unmap() override
+	{
+		if (mapping.empty())
+			return;
+		std::lock_guard<std::mutex> guard(folder->lock);
+		memset(mapping.data(), 0xCD, mapping.size());
+		mapping.clear();
+		folder->mapped--;
+	}
+
+	bool Save(const std::vector<uint8_t>& bytes) override
+	{
+		std::lock_guard<std::mutex> guard(folder->lock);
+		EXPECT_EQ(folder->mapped, 0);
+		if (folder->readOnly)
+			return false;
+		folder->index = bytes;
+		folder->hasIndex = true;
+		return true;
+	}
+
+private:
+	FakeSlideFolder* folder;
+	std::vector<uint8_t> mapping;
+};
+
+class FakeIndexDecoder : public SlideDecoder
+{
+public:
+	FakeIndexDecoder(FakeSlideFolder* folder) : folder(folder) { }
+
+	bool Decode(const std::string& path, uint32_t maxWidth, uint32_t maxHeight, SlideImage* image) override
+	{
+		EXPECT_EQ(path.compare(0, strlen(kFolder), kFolder), 0) << path;
+		std::string name = path.substr(strlen(kFolder));
+		{
+			std::lock_guard<std::mutex> guard(folder->lock);
+			folder->decoded.push_back(name);
+			folder->maxWidth = maxWidth;
+			folder->maxHeight = maxHeight;
+		}
+		folder->inside++;
+		for (;;)
+		{
+			{
+				std::lock_guard<std::mutex> guard(folder->lock);
+				if (folder->held.count(name) == 0)
+					break;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		folder->inside--;
+
+		std::lock_guard<std::mutex> guard(folder->lock);
+		if (folder->failing.count(name) != 0)
+			return false;
+		FakeSlideFolder::Picture picture = folder->pictures[name];
+		int halvings = SlideHalvings(picture.width, picture.height, maxWidth, maxHeight);
+		image->sourceWidth = picture.width;
+		image->sourceHeight = picture.height;
+		image->width = picture.width >> halvings;
+		image->height = picture.height >> halvings;
+		image->pixels.resize((size_t)image->width * image->height * 4);
+
+		uint32_t* pixels = reinterpret_cast<uint32_t*>(image->pixels.data());
+		for (uint32_t y = 0; y < image->height; y++)
+		{
+			for (uint32_t x = 0; x < image->width; x++)
+			{
+				uint32_t color = picture.bgra;
+				if (picture.rightBgra != 0 && x >= image->width / 2)
+					color = picture.rightBgra;
+				if (picture.stripes && (x % 64) < 32)
+					color = 0xFFE0E0E0;
+				pixels[(size_t)y * image->width + x] = color;
+			}
+		}
+		return true;
+	}
+
+private:
+	FakeSlideFolder* folder;
+};
+
+// The indexer only detaches its thread when destroyed, for the plugin's static
+// one at process exit.  A test's has to stop it, even when an ASSERT leaves
+// early.
+class StoppingSlideIndexer : public SlideIndexer
+{
+public:
+	~StoppingSlideIndexer() { Stop(); }
+
+	void Start(FakeSlideFolder* folder)
+	{
+		SlideIndexer::Start(new FakeSlideIndexStore(folder), new FakeIndexDecoder(folder));
+	}
+};
+
+template <typename Predicate>
+static bool WaitUntil(Predicate done)
+{
+	for (int i = 0; i < 5000; i++)
+	{
+		if (done())
+			return true;
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return done();
+}
+
+static bool Scanned(SlideIndexer* indexer)
+{
+	return WaitUntil([&] { return !indexer->Stats().scanning; });
+}
+
+static std::vector<std::string> Paths(SlideIndexer* indexer)
+{
+	std::vector<std::string> paths;
+	std::vector<int> entries;
+	indexer->Paths(&paths, &entries);
+	return paths;
+}
+
+// The file as the folder has it now.
+static SlideIndexEntry SavedEntry(FakeSlideFolder* folder, const std::string& name)
+{
+	SlideIndexView view;
+	EXPECT_TRUE(view.Open(folder->index.data(), folder->index.size()));
+	int found = view.Find(name);
+	EXPECT_GE(found, 0) << name;
+	return (found >= 0) ? view.Entry(found) : SlideIndexEntry();
+}
+
+static uint16_t Rgb565(uint32_t bgra)
+{
+	uint32_t blue = bgra & 0xFF, green = (bgra >> 8) & 0xFF, red = (bgra >> 16) & 0xFF;
+	return (uint16_t)(((red >> 3) << 11) | ((green >> 2) << 5) | (blue >> 3));
+}
+
+
+// ------------------------------------------------------------------------
+// File format
+
+TEST(SlideIndexView, BuildsAndFinds)
+{
+	std::vector<std::string> names = { "a.jps", "ab.jps", "b.jps", "\xC3\xA9t\xC3\xA9.jps" };
+	std::vector<SlideIndexEntry> entries(names.size());
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		entries[i].modified = 100 + i;
+		entries[i].width = (uint32_t)i;
+	}
+	std::vector<uint8_t> bytes = BuildSlideIndex(entries, names);
+
+	SlideIndexView view;
+	ASSERT_TRUE(view.Open(bytes.data(), bytes.size()));
+	ASSERT_EQ(view.Count(), 4u);
+	for (uint32_t i = 0; i < view.Count(); i++)
+	{
+		EXPECT_EQ(view.Name(i), names[i]);
+		EXPECT_EQ(view.Find(names[i]), (int)i);
+		EXPECT_EQ(view.Entry(i).modified, 100 + i);
+		EXPECT_EQ(view.Entry(i).width, i);
+	}
+	EXPECT_EQ(view.Find("a"), -1);
+	EXPECT_EQ(view.Find("aa.jps"), -1);
+	EXPECT_EQ(view.Find("c.jps"), -1);
+	EXPECT_EQ(view.Find(""), -1);
+
+	std::vector<uint8_t> none = BuildSlideIndex(std::vector<SlideIndexEntry>(), std::vector<std::string>());
+	ASSERT_TRUE(view.Open(none.data(), none.size()));
+	EXPECT_EQ(view.Count(), 0u);
+	EXPECT_EQ(view.Find("a.jps"), -1);
+}
+
+// Anything off in the header or the names is refused, not read past.
+TEST(SlideIndexView, RefusesBadFiles)
+{
+	std::vector<SlideIndexEntry> entries(2);
+	std::vector<uint8_t> good = BuildSlideIndex(entries, { "one.jps", "two.jps" });
+	SlideIndexView view;
+	ASSERT_TRUE(view.Open(good.data(), good.size()));
+
+	EXPECT_FALSE(view.Open(nullptr, 0));
+	EXPECT_FALSE(view.Open(good.data(), sizeof(SlideIndexHeader) - 1));
+	EXPECT_FALSE(view.Open(good.data(), good.size() - 1));
+	EXPECT_EQ(view.Count(), 0u);
+
+	auto withHeader = [&](void (*change)(SlideIndexHeader*))
+	{
+		std::vector<uint8_t> bad = good;
+		change(reinterpret_cast<SlideIndexHeader*>(bad.data()));
+		return view.Open(bad.data(), bad.size());
+	};
+	EXPECT_FALSE(withHeader([](SlideIndexHeader* h) { h->magic++; }));
+	EXPECT_FALSE(withHeader([](SlideIndexHeader* h) { h->version++; }));
+	EXPECT_FALSE(withHeader([](SlideIndexHeader* h) { h->entrySize -= 8; }));
+	EXPECT_FALSE(withHeader([](SlideIndexHeader* h) { h->count++; }));
+	EXPECT_FALSE(withHeader([](SlideIndexHeader* h) { h->count = 0xFFFFFFFF; }));
+	EXPECT_FALSE(withHeader([](SlideIndexHeader* h) { h->namesOffset = 0xFFFFFFFFFFFFFFF0ull; }));
+	EXPECT_FALSE(withHeader([](SlideIndexHeader* h) { h->namesBytes++; }));
+
+	std::vector<uint8_t> bad = good;
+	SlideIndexEntry* second = reinterpret_cast<SlideIndexEntry*>(bad.data() + sizeof(SlideIndexHeader)) + 1;
+	second->nameLength = 0xFFFFFFFF;
+	EXPECT_FALSE(view.Open(bad.data(), bad.size()));
+	second->nameLength = 8;
+	EXPECT_FALSE(view.Open(bad.data(), bad.size()));
+}
+
+TEST(SlideIndex, LayoutForName)
+{
+	EXPECT_EQ(SlideLayoutForName("a.jps"), (uint32_t)kLayoutSideBySide);
+	EXPECT_EQ(SlideLayoutForName("A.JPS"), (uint32_t)kLayoutSideBySide);
+	EXPECT_EQ(SlideLayoutForName("a.Pns"), (uint32_t)kLayoutSideBySide);
+	EXPECT_EQ(SlideLayoutForName("a.jpg"), (uint32_t)kLayoutMono);
+	EXPECT_EQ(SlideLayoutForName("jps"), (uint32_t)kLayoutMono);
+	EXPECT_EQ(SlideLayoutForName("a.jps.png"), (uint32_t)kLayoutMono);
+}
+
+// One eye only, averaged, and pictures smaller than the thumbnail still fill it.
+TEST(SlideIndex, ThumbnailIsOneEye)
+{
+	SlideImage image;
+	image.width = 64;
+	image.height = 8;
+	image.pixels.resize(64 * 8 * 4);
+	uint32_t* pixels = reinterpret_cast<uint32_t*>(image.pixels.data());
+	for (uint32_t y = 0; y < 8; y++)
+	{
+		for (uint32_t x = 0; x < 64; x++)
+			pixels[y * 64 + x] = (y < 4) ? ((x < 32) ? 0xFFFF0000 : 0xFF0000FF) : ((x < 32) ? 0xFF00FF00 : 0xFFFFFFFF);
+	}
+
+	uint16_t thumbnail[kSlideThumbWidth * kSlideThumbHeight];
+	MakeSlideThumbnail(image, kLayoutSideBySide, thumbnail);
+	EXPECT_EQ(thumbnail[0], Rgb565(0xFFFF0000));
+	EXPECT_EQ(thumbnail[kSlideThumbWidth - 1], Rgb565(0xFFFF0000));
+	EXPECT_EQ(thumbnail[(kSlideThumbHeight - 1) * kSlideThumbWidth], Rgb565(0xFF00FF00));
+
+	MakeSlideThumbnail(image, kLayoutOverUnder, thumbnail);
+	EXPECT_EQ(thumbnail[0], Rgb565(0xFFFF0000));
+	EXPECT_EQ(thumbnail[kSlideThumbWidth - 1], Rgb565(0xFF0000FF));
+	EXPECT_EQ(thumbnail[(kSlideThumbHeight - 1) * kSlideThumbWidth], Rgb565(0xFFFF0000));
+
+	// Mono is the whole picture, and a 64 wide one is two pixels a cell.
+	MakeSlideThumbnail(image, kLayoutMono, thumbnail);
+	EXPECT_EQ(thumbnail[kSlideThumbWidth - 1], Rgb565(0xFF0000FF));
+	EXPECT_EQ(thumbnail[kSlideThumbHeight * kSlideThumbWidth - 1], Rgb565(0xFFFFFFFF));
+}
+
+
+// ------------------------------------------------------------------------
+// Indexer
+
+// No index yet.  The list is there after the first save, all pending, and
+// then every picture gets its size, layout and thumbnail.
+
+TEST(SlideIndexer, FirstScanIndexesEverything)
+{
+	FakeSlideFolder folder;
+	folder.Add("c.jps", 3);
+	folder.Add("a.jps", 1);
+	folder.Add("b.jps", 2);
+	folder.pictures["b.jps"].bgra = 0xFF2080C0;
+
+	StoppingSlideIndexer indexer;
+	indexer.Start(&folder);
+	ASSERT_TRUE(Scanned(&indexer));
+
+	EXPECT_EQ(Paths(&indexer), (std::vector<std::string>{ "/pictures/a.jps", "/pictures/b.jps", "/pictures/c.jps" }));
+	SlideIndexEntry entry;
+	ASSERT_TRUE(indexer.Entry(1, &entry));
+	EXPECT_EQ(entry.width, 2048u);
+	EXPECT_EQ(entry.height, 512u);
+	EXPECT_EQ(entry.modified, 2u);
+	EXPECT_EQ(entry.size, 1000u);
+	EXPECT_EQ(entry.flags, 0u);
+	EXPECT_EQ(entry.layout, (uint32_t)kLayoutSideBySide);	// Flat says nothing, the name does.
+	EXPECT_EQ(entry.thumbnail[0], Rgb565(0xFF2080C0));
+	EXPECT_FALSE(indexer.Entry(3, &entry));
+	EXPECT_FALSE(indexer.Entry(-1, &entry));
+
+	// Small, just enough for StereoDetect's grid.
+	EXPECT_EQ(folder.maxWidth, (uint32_t)kStereoGridWidth * 2);
+	EXPECT_EQ(folder.maxHeight, (uint32_t)kStereoGridHeight * 2);
+
+	SlideIndexStats stats = indexer.Stats();
+	EXPECT_EQ(stats.listed, 3u);
+	EXPECT_EQ(stats.unchanged, 0u);
+	EXPECT_EQ(stats.decoded, 3u);
+	EXPECT_EQ(stats.failed, 0u);
+	EXPECT_EQ(stats.saves, 2u);							// The list, then the rest.
+	EXPECT_EQ(SavedEntry(&folder, "c.jps").flags, 0u);
+
+	indexer.Stop();
+	EXPECT_EQ(folder.mapped, 0);
+	EXPECT_EQ(indexer.Count(), 0);
+}
+
+// The list from the last launch is there before the scan, and only changed
+// and new pictures are decoded.
+
+TEST(SlideIndexer, NextLaunchOnlyDecodesChanges)
+{
+	FakeSlideFolder folder;
+	folder.Add("a.jps", 1);
+	folder.Add("b.jps", 2);
+	folder.Add("c.jps", 3);
+	{
+		StoppingSlideIndexer first;
+		first.Start(&folder);
+		ASSERT_TRUE(Scanned(&first));
+	}
+
+	folder.Touch("b.jps", 20);
+	folder.Remove("c.jps");
+	folder.Add("d.jps", 4);
+	folder.decoded.clear();
+	folder.held.insert("b.jps");
+	folder.listHeld = true;
+
+	StoppingSlideIndexer indexer;
+	indexer.Start(&folder);
+	uint32_t opened = indexer.Generation();
+	EXPECT_EQ(Paths(&indexer), (std::vector<std::string>{ "/pictures/a.jps", "/pictures/b.jps", "/pictures/c.jps" }));
+	EXPECT_TRUE(indexer.Stats().scanning);
+
+	folder.listHeld = false;
+	ASSERT_TRUE(WaitUntil([&] { return folder.inside == 1; }));
+	EXPECT_NE(indexer.Generation(), opened);
+	EXPECT_EQ(Paths(&indexer), (std::vector<std::string>{ "/pictures/a.jps", "/pictures/b.jps", "/pictures/d.jps" }));
+	SlideIndexEntry entry;
+	ASSERT_TRUE(indexer.Entry(1, &entry));
+	EXPECT_EQ(entry.flags, (uint32_t)kSlidePending);
+	EXPECT_EQ(entry.modified, 20u);
+
+	folder.Release("b.jps");
+	ASSERT_TRUE(Scanned(&indexer));
+	EXPECT_EQ(folder.Decoded(), (std::vector<std::string>{ "b.jps", "d.jps" }));
+	SlideIndexStats stats = indexer.Stats();
+	EXPECT_EQ(stats.unchanged, 1u);
+	EXPECT_EQ(stats.decoded, 2u);
+
+	// Nothing changed, nothing decoded or saved, and the list is the same one.
+	indexer.Stop();
+	folder.decoded.clear();
+	folder.listHeld = true;
+	indexer.Start(&folder);
+	opened = indexer.Generation();
+	folder.listHeld = false;
+	ASSERT_TRUE(Scanned(&indexer));
+	EXPECT_TRUE(folder.Decoded().empty());
+	EXPECT_EQ(indexer.Stats().unchanged, 3u);
+	EXPECT_EQ(indexer.Stats().saves, 0u);
+	EXPECT_EQ(indexer.Generation(), opened);
+}
+
+// A picture that does not decode is left out of the list, and stays out
+// without being tried again.
+
+TEST(SlideIndexer, FailedPicturesAreLeftOut)
+{
+	FakeSlideFolder folder;
+	folder.Add("a.jps", 1);
+	folder.Add("broken.jps", 2);
+	folder.Add("c.jps", 3);
+	folder.failing.insert("broken.jps");
+
+	StoppingSlideIndexer indexer;
+	indexer.Start(&folder);
+	ASSERT_TRUE(Scanned(&indexer));
+	EXPECT_EQ(indexer.Count(), 3);
+	std::vector<std::string> paths;
+	std::vector<int> entries;
+	indexer.Paths(&paths, &entries);
+	EXPECT_EQ(paths, (std::vector<std::string>{ "/pictures/a.jps", "/pictures/c.jps" }));
+	EXPECT_EQ(entries, (std::vector<int>{ 0, 2 }));
+	EXPECT_EQ(indexer.Stats().failed, 1u);
+	EXPECT_EQ(SavedEntry(&folder, "broken.jps").flags, (uint32_t)kSlideFailed);
+
+	indexer.Stop();
+	folder.decoded.clear();
+	indexer.Start(&folder);
+	ASSERT_TRUE(Scanned(&indexer));
+	EXPECT_TRUE(folder.Decoded().empty());
+	EXPECT_EQ(Paths(&indexer).size(), 2u);
+
+	// Replaced with one that does.
+	folder.failing.clear();
+	folder.Touch("broken.jps", 9);
+	indexer.Stop();
+	indexer.Start(&folder);
+	ASSERT_TRUE(Scanned(&indexer));
+	EXPECT_EQ(folder.Decoded(), (std::vector<std::string>{ "broken.jps" }));
+	EXPECT_EQ(Paths(&indexer).size(), 3u);
+}
+
+// Stopping midway finishes the picture being decoded and saves, and the next
+// launch carries on from the ones still pending.
+
+TEST(SlideIndexer, StopMidwayKeepsWhatWasDone)
+{
+	FakeSlideFolder folder;
+	folder.Add("a.jps", 1);
+	folder.Add("b.jps", 2);
+	folder.Add("c.jps", 3);
+	folder.held.insert("b.jps");
+
+	StoppingSlideIndexer indexer;
+	indexer.Start(&folder);
+	ASSERT_TRUE(WaitUntil([&] { return folder.inside == 1; }));
+
+	std::thread release([&]
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		folder.Release("b.jps");
+	});
+	indexer.Stop();
+	release.join();
+	EXPECT_EQ(folder.Decoded(), (std::vector<std::string>{ "a.jps", "b.jps" }));
+	EXPECT_EQ(SavedEntry(&folder, "a.jps").flags, 0u);
+	EXPECT_EQ(SavedEntry(&folder, "b.jps").flags, 0u);
+	EXPECT_EQ(SavedEntry(&folder, "c.jps").flags, (uint32_t)kSlidePending);
+
+	folder.decoded.clear();
+	indexer.Start(&folder);
+	ASSERT_TRUE(Scanned(&indexer));
+	EXPECT_EQ(folder.Decoded(), (std::vector<std::string>{ "c.jps" }));
+	EXPECT_EQ(indexer.Stats().unchanged, 2u);
+	EXPECT_EQ(SavedEntry(&folder, "c.jps").flags, 0u);
+}
+
+// Saves every kSaveEvery pictures, so a quit loses no more than that.
+TEST(SlideIndexer, SavesAsItGoes)
+{
+	FakeSlideFolder folder;
+	const uint32_t count = SlideIndexer::kSaveEvery * 2 + 10;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "%04u.jps", i);
+		folder.Add(name, i);
+		folder.pictures[name].width = 64;
+		folder.pictures[name].height = 16;
+	}
+
+	StoppingSlideIndexer indexer;
+	indexer.Start(&folder);
+	ASSERT_TRUE(Scanned(&indexer));
+	EXPECT_EQ(indexer.Stats().decoded, count);
+	EXPECT_EQ(indexer.Stats().saves, 4u);
+	EXPECT_EQ(indexer.Count(), (int)count);
+}
+
+// A folder we can't write to still gets its index, from memory.
+TEST(SlideIndexer, ReadOnlyFolderIndexesInMemory)
+{
+	FakeSlideFolder folder;
+	folder.Add("a.jps", 1);
+	folder.Add("b.jps", 2);
+	folder.readOnly = true;
+
+	StoppingSlideIndexer indexer;
+	indexer.Start(&folder);
+	ASSERT_TRUE(Scanned(&indexer));
+	EXPECT_EQ(indexer.Stats().saves, 0u);
+	EXPECT_FALSE(folder.hasIndex);
+	ASSERT_EQ(Paths(&indexer).size(), 2u);
+	SlideIndexEntry entry;
+	ASSERT_TRUE(indexer.Entry(1, &entry));
+	EXPECT_EQ(entry.width, 2048u);
+	EXPECT_EQ(entry.flags, 0u);
+}
+
+// An index that doesn't check out is as good as none.
+TEST(SlideIndexer, BadIndexIsRebuilt)
+{
+	FakeSlideFolder folder;
+	folder.Add("a.jps", 1);
+	folder.hasIndex = true;
+	folder.index.assign(100, 0x5A);
+
+	StoppingSlideIndexer indexer;
+	indexer.Start(&folder);
+	ASSERT_TRUE(Scanned(&indexer));
+	EXPECT_EQ(folder.Decoded(), (std::vector<std::string>{ "a.jps" }));
+	EXPECT_EQ(SavedEntry(&folder, "a.jps").width, 2048u);
+}
+
+// A folder that can't be listed keeps the last index as it was.
+TEST(SlideIndexer, UnlistableFolderKeepsTheIndex)
+{
+	FakeSlideFolder folder;
+	folder.Add("a.jps", 1);
+	{
+		StoppingSlideIndexer first;
+		first.Start(&folder);
+		ASSERT_TRUE(Scanned(&first));
+	}
+	std::vector<uint8_t> saved = folder.index;
+	folder.listFails = true;
+	folder.files.clear();
+
+	StoppingSlideIndexer indexer;
+	indexer.Start(&folder);
+	ASSERT_TRUE(Scanned(&indexer));
+	EXPECT_EQ(Paths(&indexer), (std::vector<std::string>{ "/pictures/a.jps" }));
+	EXPECT_EQ(folder.index, saved);
+}
+
+// The pixels win over the name when StereoDetect is sure, and the thumbnail
+// is of one eye of whatever layout that is.
+
+TEST(SlideIndexer, DetectedLayoutWinsOverTheName)
+{
+	FakeSlideFolder folder;
+	folder.Add("mono.jps", 1);
+	folder.pictures["mono.jps"].stripes = true;
+	folder.Add("pair.jps", 2);
+	folder.pictures["pair.jps"].bgra = 0xFFC00000;
+	folder.pictures["pair.jps"].rightBgra = 0xFF0000C0;
+
+	StoppingSlideIndexer indexer;
+	indexer.Start(&folder);
+	ASSERT_TRUE(Scanned(&indexer));
+
+	SlideIndexEntry entry;
+	ASSERT_TRUE(indexer.Entry(0, &entry));
+	EXPECT_EQ(entry.layout, (uint32_t)kLayoutMono);
+	EXPECT_EQ(entry.thumbnail[0], Rgb565(0xFFE0E0E0));
+	EXPECT_EQ(entry.thumbnail[kSlideThumbWidth - 1], Rgb565(0xFF404040));
+
+	ASSERT_TRUE(indexer.Entry(1, &entry));
+	EXPECT_EQ(entry.layout, (uint32_t)kLayoutSideBySide);
+	for (int i = 0; i < kSlideThumbWidth * kSlideThumbHeight; i++)
+		ASSERT_EQ(entry.thumbnail[i], Rgb565(0xFFC00000)) << i;
+}
@@ -0,0 +1,103 @@
+// Tests of StagingArena.h, with StagingPages that count what was allocated
+// and freed, instead of the VirtualAlloc ones of the D3D11 side.
+
+#include "StagingArena.h"
+
+#include <gtest/gtest.h>
+
+#include <stdlib.h>
+#include <map>
+
+
+class CountingPages : public StagingPages
+{
+public:
+	void* Allocate(size_t bytes) override
+	{
+		if (failNext)
+		{
+			failNext = false;
+			return nullptr;
+		}
+		void* pages = malloc(bytes);
+		live[pages] = bytes;
+		allocated++;
+		return pages;
+	}
+
+	void Free(void* pages, size_t bytes) override
+	{
+		auto found = live.find(pages);
+		ASSERT_NE(found, live.end());
+		EXPECT_EQ(found->second, bytes);
+		live.erase(found);
+		free(pages);
+	}
+
+	std::map<void*, size_t> live;
+	int allocated = 0;
+	bool failNext = false;
+};
+
+
+TEST(StagingArena, ReusesOneBufferWithoutReallocating)
+{
+	CountingPages pages;
+	StagingArena arena(&pages);
+
+	void* buffer = arena.Acquire(4096);
+	ASSERT_NE(buffer, nullptr);
+
+	for (int frame = 0; frame < 10; frame++)
+		EXPECT_EQ(arena.Acquire(4096), buffer);
+
+	EXPECT_EQ(pages.allocated, 1);
+	EXPECT_EQ(pages.live.size(), 1u);
+	EXPECT_EQ(arena.Allocations(), 1u);
+	EXPECT_EQ(arena.Size(), 4096u);
+}
+
+TEST(StagingArena, NewSizeFreesTheOldBuffer)
+{
+	CountingPages pages;
+	StagingArena arena(&pages);
+
+	arena.Acquire(4096);
+	EXPECT_EQ(pages.live.size(), 1u);
+
+	ASSERT_NE(arena.Acquire(8192), nullptr);
+	EXPECT_EQ(pages.live.size(), 1u);
+	EXPECT_EQ(pages.live.begin()->second, 8192u);
+	EXPECT_EQ(arena.Size(), 8192u);
+	EXPECT_EQ(pages.allocated, 2);
+}
+
+TEST(StagingArena, FailedAllocationIsTriedAgain)
+{
+	CountingPages pages;
+	StagingArena arena(&pages);
+
+	pages.failNext = true;
+	EXPECT_EQ(arena.Acquire(4096), nullptr);
+	EXPECT_EQ(arena.Allocations(), 0u);
+
+	void* buffer = arena.Acquire(4096);
+	EXPECT_NE(buffer, nullptr);
+	EXPECT_EQ(arena.Acquire(4096), buffer);
+	EXPECT_EQ(arena.Allocations(), 1u);
+}
+
+TEST(StagingArena, ReleaseAndDestructorFreeEverything)
+{
+	CountingPages pages;
+	{
+		StagingArena arena(&pages);
+		arena.Acquire(4096);
+		arena.Release();
+		EXPECT_TRUE(pages.live.empty());
+		EXPECT_EQ(arena.Size(), 0u);
+
+		arena.Acquire(1024);
+	}
+	EXPECT_TRUE(pages.live.empty());
+}
@@ -0,0 +1,517 @@
+// Tests of StereoCopyPath.h, with a fake StereoCopyDevice that records every
+// call, and hands back made up readbacks of the probe's scratch surface instead
+// of the DX9 one.
+
+#include "StereoCopyPath.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+
+// Taken by reference in EXPECT_EQ, which the class constants can't be.
+static const int kProbeInterval = StereoCopyPath::kProbeInterval;
+static const int kMaxProbes = StereoCopyPath::kMaxProbes;
+
+static const CopySource kEye = { 1920, 1080, 28, kScaleStretch, true };
+
+static const int kImageWidth = 256;
+static const int kImageHeight = 64;
+
+enum FakeImage
+{
+	kImageStereo,					// Two different eyes.
+	kImageOneEye,					// The right half never written.
+	kImageDoubled,					// One eye stretched across both halves.
+	kImageBlack,
+	kImageSameEyes,					// Like a 2D menu.
+};
+
+// Lit noise, so neighbors almost always differ, with a seed per eye.
+
+static uint32_t Noise(uint32_t x, uint32_t y, uint32_t seed)
+{
+	uint32_t h = x * 0x9E3779B1u ^ y * 0x85EBCA77u ^ seed * 0xC2B2AE3Du;
+	h ^= h >> 15;
+	h *= 0x2C1B3C6Du;
+	h ^= h >> 13;
+	return 0xFF808080u | (h & 0x007F7F7F);
+}
+
+static std::vector<uint32_t> MakeImage(FakeImage kind)
+{
+	const int half = kImageWidth / 2;
+	std::vector<uint32_t> image((size_t)kImageWidth * kImageHeight, 0);
+
+	for (int y = 0; y < kImageHeight; y++)
+	{
+		uint32_t* row = &image[(size_t)y * kImageWidth];
+		for (int x = 0; x < half; x++)
+		{
+			switch (kind)
+			{
+			case kImageStereo:
+				row[x] = Noise(x, y, 1);
+				row[half + x] = Noise(x, y, 2);
+				break;
+			case kImageOneEye:
+				row[x] = Noise(x, y, 1);
+				break;
+			case kImageDoubled:
+				row[x] = Noise(x / 2, y, 1);
+				row[half + x] = Noise((half + x) / 2, y, 1);
+				break;
+			case kImageBlack:
+				break;
+			case kImageSameEyes:
+				row[x] = row[half + x] = Noise(x, y, 1);
+				break;
+			}
+		}
+	}
+	return image;
+}
+
+
+class RecordingCopyDevice : public StereoCopyDevice
+{
+public:
+	bool CopyDirect() override
+	{
+		calls.push_back("Direct");
+		return directWorks;
+	}
+
+	bool CopyIntermediate() override
+	{
+		calls.push_back("Intermediate");
+		return intermediateWorks;
+	}
+
+	bool CopyPlanned(const CopyPlan& plan) override
+	{
+		calls.push_back("Planned");
+		plans.push_back(plan);
+		return intermediateWorks;
+	}
+
+	bool ClearScratch() override
+	{
+		calls.push_back("Clear");
+		scratch = true;
+		return clearWorks;
+	}
+
+	bool CopyDirectToScratch() override
+	{
+		calls.push_back("ScratchDirect");
+		EXPECT_TRUE(scratch);
+		return directWorks;
+	}
+
+	bool ReadScratch(const uint8_t** data, int* pitch, int* width, int* height) override
+	{
+		calls.push_back("Read");
+		if (!readWorks)
+			return false;
+
+		pixels = MakeImage(image);
+		*data = (const uint8_t*)pixels.data();
+		*pitch = kImageWidth * 4;
+		*width = kImageWidth;
+		*height = kImageHeight;
+		reading = true;
+		return true;
+	}
+
+	void EndRead() override
+	{
+		calls.push_back("EndRead");
+		EXPECT_TRUE(reading);
+		reading = false;
+	}
+
+	void ReleaseScratch() override
+	{
+		calls.push_back("Release");
+		EXPECT_FALSE(reading);
+		scratch = false;
+	}
+
+	// The calls since the last Take, space separated.
+	std::string Take()
+	{
+		std::string joined;
+		for (const char* call : calls)
+		{
+			if (!joined.empty())
+				joined += ' ';
+			joined += call;
+		}
+		calls.clear();
+		return joined;
+	}
+
+	FakeImage image = kImageStereo;
+	bool directWorks = true;
+	bool intermediateWorks = true;
+	bool clearWorks = true;
+	bool readWorks = true;
+
+	std::vector<const char*> calls;
+	std::vector<CopyPlan> plans;
+	bool reading = false;
+	bool scratch = false;
+
+private:
+	std::vector<uint32_t> pixels;
+};
+
+static CopyPlan Plan(KatangaCopyMode mode)
+{
+	const uint32_t third = kKatangaCropScale / 3;
+	uint64_t request = 0;
+	if (mode == kCopyModeHalf)
+		request = KatangaPackCopyRequest(kCopyModeHalf, 0, 0, 0, 0);
+	else if (mode == kCopyModeCrop)
+		request = KatangaPackCopyRequest(kCopyModeCrop, third, third, third, third);
+	return PlanCopy(kEye, request);
+}
+
+static std::string Frames(StereoCopyPath* path, RecordingCopyDevice* device, int count)
+{
+	CopyPlan full = Plan(kCopyModeFull);
+	for (int i = 0; i < count; i++)
+		EXPECT_TRUE(path->Copy(device, full));
+	return device->Take();
+}
+
+
+// ------------------------------------------------------------------------
+// ClassifyStereoCopy
+
+TEST(StereoCopyPath, ClassifiesTheReadbacks)
+{
+	struct { FakeImage image; StereoCheck expected; } cases[] =
+	{
+		{ kImageStereo, kStereoCheckStereo },
+		{ kImageOneEye, kStereoCheckMono },
+		{ kImageDoubled, kStereoCheckMono },
+		{ kImageBlack, kStereoCheckInconclusive },
+		{ kImageSameEyes, kStereoCheckInconclusive },
+	};
+
+	for (const auto& c : cases)
+	{
+		std::vector<uint32_t> image = MakeImage(c.image);
+		EXPECT_EQ(ClassifyStereoCopy((const uint8_t*)image.data(), kImageWidth * 4, kImageWidth, kImageHeight), c.expected)
+			<< "image " << c.image;
+	}
+}
+
+TEST(StereoCopyPath, EmptyReadbackIsInconclusive)
+{
+	uint32_t pixel = 0xFFFFFFFF;
+	EXPECT_EQ(ClassifyStereoCopy((const uint8_t*)&pixel, 4, 1, 1), kStereoCheckInconclusive);
+	EXPECT_EQ(ClassifyStereoCopy((const uint8_t*)&pixel, 8, 2, 0), kStereoCheckInconclusive);
+}
+
+// ------------------------------------------------------------------------
+// Probing with a full copy
+
+TEST(StereoCopyPath, StereoProbeSwitchesToDirect)
+{
+	StereoCopyPath path;
+	RecordingCopyDevice device;
+
+	EXPECT_EQ(path.Path(), kCopyPathUnknown);
+	EXPECT_TRUE(path.NeedsIntermediate());
+
+	// The probe goes to the scratch, and the frame itself straight to the
+	// shared target, now that we know that works.
+	EXPECT_EQ(Frames(&path, &device, 1), "Clear ScratchDirect Read EndRead Release Direct");
+	EXPECT_EQ(path.Path(), kCopyPathDirect);
+	EXPECT_EQ(path.LastCheck(), kStereoCheckStereo);
+	EXPECT_EQ(path.Probes(), 1);
+	EXPECT_FALSE(path.NeedsIntermediate());
+
+	EXPECT_EQ(Frames(&path, &device, 3), "Direct Direct Direct");
+}
+
+TEST(StereoCopyPath, MonoProbesKeepTheIntermediate)
+{
+	FakeImage monos[] = { kImageOneEye, kImageDoubled };
+
+	for (FakeImage mono : monos)
+	{
+		StereoCopyPath path;
+		RecordingCopyDevice device;
+		device.image = mono;
+
+		EXPECT_EQ(Frames(&path, &device, 1), "Clear ScratchDirect Read EndRead Release Intermediate");
+		EXPECT_EQ(path.Path(), kCopyPathIntermediate);
+		EXPECT_EQ(path.LastCheck(), kStereoCheckMono);
+
+		// Decided, so never probed again.
+		EXPECT_EQ(Frames(&path, &device, 2 * kProbeInterval).find("Clear"), std::string::npos);
+		EXPECT_EQ(path.Probes(), 1);
+	}
+}
+
+TEST(StereoCopyPath, FailedDirectCopyKeepsTheIntermediate)
+{
+	StereoCopyPath path;
+	RecordingCopyDevice device;
+	device.directWorks = false;
+
+	EXPECT_EQ(Frames(&path, &device, 1), "Clear ScratchDirect Release Intermediate");
+	EXPECT_EQ(path.Path(), kCopyPathIntermediate);
+	EXPECT_EQ(path.LastCheck(), kStereoCheckFailed);
+}
+
+TEST(StereoCopyPath, FailedClearSkipsTheDirectCopy)
+{
+	StereoCopyPath path;
+	RecordingCopyDevice device;
+	device.clearWorks = false;
+
+	EXPECT_EQ(Frames(&path, &device, 1), "Clear Release Intermediate");
+	EXPECT_EQ(path.Path(), kCopyPathIntermediate);
+	EXPECT_EQ(path.LastCheck(), kStereoCheckFailed);
+}
+
+// A readback that fails can't tell us anything, and has nothing to end.
+
+TEST(StereoCopyPath, FailedReadIsTriedAgain)
+{
+	StereoCopyPath path;
+	RecordingCopyDevice device;
+	device.readWorks = false;
+
+	EXPECT_EQ(Frames(&path, &device, 1), "Clear ScratchDirect Read Intermediate");
+	EXPECT_EQ(path.Path(), kCopyPathUnknown);
+	EXPECT_EQ(path.LastCheck(), kStereoCheckInconclusive);
+	EXPECT_FALSE(device.reading);
+	EXPECT_TRUE(device.scratch);
+}
+
+TEST(StereoCopyPath, InconclusiveProbesRetryThenGiveUp)
+{
+	StereoCopyPath path;
+	RecordingCopyDevice device;
+	device.image = kImageBlack;
+
+	// The scratch is kept between probes, and only goes with the last one.
+	for (int probe = 1; probe <= kMaxProbes; probe++)
+	{
+		ASSERT_EQ(Frames(&path, &device, 1), (probe < kMaxProbes) ? "Clear ScratchDirect Read EndRead Intermediate" :
+			"Clear ScratchDirect Read EndRead Release Intermediate");
+		ASSERT_EQ(path.Probes(), probe);
+		ASSERT_EQ(device.scratch, probe < kMaxProbes);
+
+		if (probe < kMaxProbes)
+		{
+			ASSERT_EQ(path.Path(), kCopyPathUnknown);
+			for (int frame = 0; frame < kProbeInterval; frame++)
+				ASSERT_EQ(Frames(&path, &device, 1), "Intermediate");
+		}
+	}
+
+	EXPECT_EQ(path.Path(), kCopyPathIntermediate);
+	EXPECT_EQ(path.LastCheck(), kStereoCheckInconclusive);
+	EXPECT_EQ(Frames(&path, &device, 2 * kProbeInterval).find("Clear"), std::string::npos);
+	EXPECT_EQ(path.Probes(), kMaxProbes);
+}
+
+// A 2D menu first, then the game proper.
+
+TEST(StereoCopyPath, LaterStereoFrameSwitchesToDirect)
+{
+	StereoCopyPath path;
+	RecordingCopyDevice device;
+	device.image = kImageSameEyes;
+
+	Frames(&path, &device, 1 + kProbeInterval);
+	EXPECT_EQ(path.Path(), kCopyPathUnknown);
+
+	device.image = kImageStereo;
+	EXPECT_EQ(Frames(&path, &device, 1), "Clear ScratchDirect Read EndRead Release Direct");
+	EXPECT_EQ(path.Path(), kCopyPathDirect);
+	EXPECT_EQ(path.Probes(), 2);
+}
+
+TEST(StereoCopyPath, NewSurfacesProbeAtOnce)
+{
+	StereoCopyPath path;
+	RecordingCopyDevice device;
+	device.image = kImageBlack;
+
+	Frames(&path, &device, 1);
+	EXPECT_EQ(Frames(&path, &device, 1), "Intermediate");
+
+	path.OnNewSurfaces();
+	EXPECT_EQ(Frames(&path, &device, 1), "Clear ScratchDirect Read EndRead Intermediate");
+	EXPECT_EQ(path.Probes(), 2);
+}
+
+TEST(StereoCopyPath, DecidedPathSurvivesNewSurfaces)
+{
+	StereoCopyPath path;
+	RecordingCopyDevice device;
+
+	Frames(&path, &device, 1);
+	path.OnNewSurfaces();
+
+	EXPECT_EQ(Frames(&path, &device, 1), "Direct");
+	EXPECT_EQ(path.Probes(), 1);
+}
+
+// The VR side samples the shared target whenever it likes, so a probe frame
+// must put exactly one whole frame there, and the probe itself nothing at all.
+
+TEST(StereoCopyPath, ProbesNeverTouchTheSharedTarget)
+{
+	FakeImage images[] = { kImageStereo, kImageOneEye, kImageDoubled, kImageBlack, kImageSameEyes };
+
+	for (FakeImage image : images)
+	{
+		StereoCopyPath path;
+		RecordingCopyDevice device;
+		device.image = image;
+
+		std::string calls = Frames(&path, &device, 1);
+		std::string last = calls.substr(calls.rfind(' ') + 1);
+		std::string probe = calls.substr(0, calls.rfind(' '));
+
+		EXPECT_TRUE(last == "Direct" || last == "Intermediate") << calls;
+		EXPECT_EQ(probe.find(" Direct"), std::string::npos) << calls;
+		EXPECT_EQ(probe.find("Intermediate"), std::string::npos) << calls;
+	}
+}
+
+// A stereo probe that the shared target then doesn't take, the frame still
+// gets there through the intermediate.
+
+TEST(StereoCopyPath, DirectThatFailsAfterTheProbeFallsBack)
+{
+	class SharedFailsDevice : public RecordingCopyDevice
+	{
+	public:
+		bool CopyDirect() override
+		{
+			calls.push_back("Direct");
+			return false;
+		}
+	};
+
+	StereoCopyPath path;
+	SharedFailsDevice device;
+
+	EXPECT_TRUE(path.Copy(&device, Plan(kCopyModeFull)));
+	EXPECT_EQ(device.Take(), "Clear ScratchDirect Read EndRead Release Direct Intermediate");
+	EXPECT_EQ(path.Path(), kCopyPathIntermediate);
+}
+
+TEST(StereoCopyPath, DirectThatStopsWorkingFallsBack)
+{
+	StereoCopyPath path;
+	RecordingCopyDevice device;
+
+	Frames(&path, &device, 1);
+	ASSERT_EQ(path.Path(), kCopyPathDirect);
+
+	device.directWorks = false;
+	EXPECT_EQ(Frames(&path, &device, 1), "Direct Intermediate");
+	EXPECT_EQ(path.Path(), kCopyPathIntermediate);
+	EXPECT_TRUE(path.NeedsIntermediate());
+
+	// For good, even once it works again.
+	device.directWorks = true;
+	EXPECT_EQ(Frames(&path, &device, 1), "Intermediate");
+}
+
+TEST(StereoCopyPath, FailedIntermediateCopyIsReported)
+{
+	StereoCopyPath path;
+	RecordingCopyDevice device;
+	device.image = kImageOneEye;
+	device.intermediateWorks = false;
+
+	EXPECT_FALSE(path.Copy(&device, Plan(kCopyModeFull)));
+	EXPECT_FALSE(path.Copy(&device, Plan(kCopyModeHalf)));
+}
+
+// ------------------------------------------------------------------------
+// Every KatangaCopyMode
+
+// Only a full copy can go direct, the others are always planned through the
+// intermediate, without probing, and whatever path was decided is kept.
+
+TEST(StereoCopyPath, EveryCopyMode)
+{
+	KatangaCopyMode modes[] = { kCopyModeFull, kCopyModeHalf, kCopyModeCrop };
+	KatangaCopyPath paths[] = { kCopyPathUnknown, kCopyPathDirect, kCopyPathIntermediate };
+
+	for (KatangaCopyMode mode : modes)
+	{
+		for (KatangaCopyPath decided : paths)
+		{
+			SCOPED_TRACE(testing::Message() << "mode " << mode << ", path " << decided);
+
+			StereoCopyPath path;
+			RecordingCopyDevice device;
+			if (decided != kCopyPathUnknown)
+			{
+				device.image = (decided == kCopyPathDirect) ? kImageStereo : kImageOneEye;
+				Frames(&path, &device, 1);
+				ASSERT_EQ(path.Path(), decided);
+				device.image = kImageStereo;
+			}
+			int probes = path.Probes();
+
+			CopyPlan plan = Plan(mode);
+			ASSERT_EQ(plan.mode, mode);
+			EXPECT_TRUE(path.Copy(&device, plan));
+
+			std::string calls = device.Take();
+			if (mode == kCopyModeFull)
+			{
+				const char* expected = (decided == kCopyPathUnknown) ? "Clear ScratchDirect Read EndRead Release Direct" :
+					(decided == kCopyPathDirect) ? "Direct" : "Intermediate";
+				EXPECT_EQ(calls, expected);
+				EXPECT_TRUE(device.plans.empty());
+				EXPECT_EQ(path.NeedsIntermediate(plan), path.Path() != kCopyPathDirect);
+			}
+			else
+			{
+				EXPECT_EQ(calls, "Planned");
+				ASSERT_EQ(device.plans.size(), 1u);
+				EXPECT_TRUE(SameCopy(device.plans[0], plan));
+				EXPECT_EQ(path.Path(), decided);
+				EXPECT_EQ(path.Probes(), probes);
+				EXPECT_TRUE(path.NeedsIntermediate(plan));
+			}
+		}
+	}
+}
+
+// Back to a full copy from a smaller one, the probe that was put off happens.
+
+TEST(StereoCopyPath, ProbesOnceBackToFull)
+{
+	StereoCopyPath path;
+	RecordingCopyDevice device;
+	CopyPlan half = Plan(kCopyModeHalf);
+
+	for (int frame = 0; frame < 3; frame++)
+		path.Copy(&device, half);
+	EXPECT_EQ(device.Take(), "Planned Planned Planned");
+
+	EXPECT_EQ(Frames(&path, &device, 2), "Clear ScratchDirect Read EndRead Release Direct Direct");
+	EXPECT_EQ(path.Path(), kCopyPathDirect);
+
+	// And a smaller copy after that still goes through the intermediate.
+	path.Copy(&device, half);
+	EXPECT_EQ(device.Take(), "Planned");
+}
@@ -0,0 +1,407 @@
+// Tests of StereoDetect.h, on made up scenes of random blocks, seen by two
+// eyes with some parallax and packed every way we know, and in each pixel
+// format the VR side can hand it.  Then on real screenshots, from the grids in
+// Fixtures, which Tools/StereoGrids made from two of the .jps that ship in
+// UnityScreenApp/Stereo Pictures.
+
+#include "StereoDetect.h"
+
+#include <gtest/gtest.h>
+
+#include <stdint.h>
+#include <string.h>
+
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+
+// Luma of a scene of 8x8 blocks, as seen from an eye moved parallax pixels to
+// the left, so everything in it is that much further right.  Behind the
+// screen, the right eye is the one with the positive parallax.
+
+static uint8_t SceneLuma(uint32_t seed, int x, int y)
+{
+	uint32_t hash = seed ^ ((uint32_t)(x >> 3) * 0x9E3779B1u) ^ ((uint32_t)(y >> 3) * 0x85EBCA77u);
+	hash ^= hash >> 15;
+	hash *= 0x2C1B3C6Du;
+	hash ^= hash >> 12;
+	return (uint8_t)(32 + hash % 192);
+}
+
+struct Picture
+{
+	uint32_t width;
+	uint32_t height;
+	std::vector<uint8_t> luma;
+
+	uint8_t& At(uint32_t x, uint32_t y) { return luma[(size_t)y * width + x]; }
+};
+
+static Picture Blank(uint32_t width, uint32_t height)
+{
+	Picture picture = { width, height, std::vector<uint8_t>((size_t)width * height, 0) };
+	return picture;
+}
+
+// Draws one eye of the scene into picture at (left, top).
+static void DrawEye(Picture* picture, uint32_t left, uint32_t top, uint32_t width, uint32_t height,
+	uint32_t seed, int parallax)
+{
+	for (uint32_t y = 0; y < height; y++)
+	{
+		for (uint32_t x = 0; x < width; x++)
+			picture->At(left + x, top + y) = SceneLuma(seed, (int)x - parallax + 64, (int)y);
+	}
+}
+
+// Right eye on the left half, like everything of ours.
+static Picture SideBySide(uint32_t eyeWidth, uint32_t eyeHeight, int parallax, uint32_t seed = 1)
+{
+	Picture picture = Blank(2 * eyeWidth, eyeHeight);
+	DrawEye(&picture, 0, 0, eyeWidth, eyeHeight, seed, parallax);
+	DrawEye(&picture, eyeWidth, 0, eyeWidth, eyeHeight, seed, 0);
+	return picture;
+}
+
+static Picture SideBySideSwapped(uint32_t eyeWidth, uint32_t eyeHeight, int parallax, uint32_t seed = 1)
+{
+	Picture picture = Blank(2 * eyeWidth, eyeHeight);
+	DrawEye(&picture, 0, 0, eyeWidth, eyeHeight, seed, 0);
+	DrawEye(&picture, eyeWidth, 0, eyeWidth, eyeHeight, seed, parallax);
+	return picture;
+}
+
+// Right eye on top.
+static Picture OverUnder(uint32_t eyeWidth, uint32_t eyeHeight, int parallax, uint32_t seed = 1)
+{
+	Picture picture = Blank(eyeWidth, 2 * eyeHeight);
+	DrawEye(&picture, 0, 0, eyeWidth, eyeHeight, seed, parallax);
+	DrawEye(&picture, 0, eyeHeight, eyeWidth, eyeHeight, seed, 0);
+	return picture;
+}
+
+static Picture Mono(uint32_t width, uint32_t height, uint32_t seed = 1)
+{
+	Picture picture = Blank(width, height);
+	DrawEye(&picture, 0, 0, width, height, seed, 0);
+	return picture;
+}
+
+// Gray in BGRA, so each format below has the same luma.
+static std::vector<uint8_t> ToBGRA(const Picture& picture)
+{
+	std::vector<uint8_t> pixels(picture.luma.size() * 4);
+	for (size_t i = 0; i < picture.luma.size(); i++)
+	{
+		memset(&pixels[i * 4], picture.luma[i], 3);
+		pixels[i * 4 + 3] = 255;
+	}
+	return pixels;
+}
+
+static StereoDetection Detect(const Picture& picture)
+{
+	std::vector<uint8_t> pixels = ToBGRA(picture);
+	return StereoDetectPixels(pixels.data(), picture.width, picture.height, (size_t)picture.width * 4, kStereoBGRA8);
+}
+
+static uint16_t FloatToHalf(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	if (value == 0.0f)
+		return 0;
+	uint32_t exponent = ((bits >> 23) & 0xFF) - 112;
+	return (uint16_t)((exponent << 10) | ((bits >> 13) & 0x3FF));
+}
+
+
+// ------------------------------------------------------------------------
+// Layouts
+
+TEST(StereoDetect, SideBySide)
+{
+	StereoDetection found = Detect(SideBySide(960, 540, 12));
+	EXPECT_EQ(found.layout, (uint32_t)kLayoutSideBySide);
+	EXPECT_GT(found.confidence, kStereoSureConfidence);
+	EXPECT_GT(found.sideBySide, found.overUnder);
+
+	// 12 pixels of a 960 eye, in cells of 128 across an eye.
+	EXPECT_NEAR(found.shift, -12.0f * 128 / 960, 0.5f);
+}
+
+TEST(StereoDetect, SideBySideSwapped)
+{
+	StereoDetection found = Detect(SideBySideSwapped(960, 540, 12));
+	EXPECT_EQ(found.layout, (uint32_t)kLayoutSideBySideSwapped);
+	EXPECT_GT(found.confidence, kStereoSureConfidence);
+	EXPECT_NEAR(found.shift, 12.0f * 128 / 960, 0.5f);
+}
+
+TEST(StereoDetect, OverUnder)
+{
+	StereoDetection found = Detect(OverUnder(1920, 540, 12));
+	EXPECT_EQ(found.layout, (uint32_t)kLayoutOverUnder);
+	EXPECT_GT(found.confidence, kStereoSureConfidence);
+	EXPECT_GT(found.overUnder, found.sideBySide);
+}
+
+TEST(StereoDetect, MonoPicture)
+{
+	StereoDetection found = Detect(Mono(1920, 1080));
+	EXPECT_EQ(found.layout, (uint32_t)kLayoutMono);
+	EXPECT_GT(found.confidence, kStereoSureConfidence);
+	EXPECT_LT(found.sideBySide, kStereoMatchLow);
+	EXPECT_LT(found.overUnder, kStereoMatchLow);
+}
+
+// A game with 3D Vision off gives us the same picture in both halves.
+TEST(StereoDetect, SameImageTwiceIsMono)
+{
+	StereoDetection found = Detect(SideBySide(960, 540, 0));
+	EXPECT_EQ(found.layout, (uint32_t)kLayoutMono);
+	EXPECT_EQ(found.confidence, 100u);
+
+	found = Detect(OverUnder(1920, 540, 0));
+	EXPECT_EQ(found.layout, (uint32_t)kLayoutMono);
+	EXPECT_EQ(found.confidence, 100u);
+}
+
+// Nothing to go on, like a black loading screen, is unknown and not mono.
+TEST(StereoDetect, FlatIsUnknown)
+{
+	Picture black = Blank(1920, 1080);
+	StereoDetection found = Detect(black);
+	EXPECT_EQ(found.layout, (uint32_t)kLayoutUnknown);
+	EXPECT_EQ(found.confidence, 0u);
+
+	Picture gray = Blank(1920, 1080);
+	memset(gray.luma.data(), 128, gray.luma.size());
+	EXPECT_EQ(Detect(gray).layout, (uint32_t)kLayoutUnknown);
+}
+
+// Almost no parallax, everything at the screen, says nothing about the order,
+// which stays the usual one.
+TEST(StereoDetect, NoParallaxKeepsTheUsualOrder)
+{
+	Picture picture = SideBySide(960, 540, 0);
+	for (size_t i = 0; i < picture.luma.size(); i += 7)
+		picture.luma[i] = (uint8_t)(picture.luma[i] ^ 0x10);
+	StereoDetection found = Detect(picture);
+	EXPECT_EQ(found.layout, (uint32_t)kLayoutSideBySide);
+	EXPECT_NEAR(found.shift, 0.0f, kStereoMinShift);
+}
+
+// The grid is the same cost at any size, and sees the same at each.
+TEST(StereoDetect, AnySize)
+{
+	const uint32_t kEyes[][2] = { { 640, 360 }, { 1280, 720 }, { 1920, 1080 }, { 3840, 2160 } };
+	for (const uint32_t* eye : kEyes)
+	{
+		int parallax = (int)eye[0] / 80;
+		EXPECT_EQ(Detect(SideBySide(eye[0], eye[1], parallax)).layout, (uint32_t)kLayoutSideBySide) << eye[0];
+		EXPECT_EQ(Detect(SideBySideSwapped(eye[0], eye[1], parallax)).layout, (uint32_t)kLayoutSideBySideSwapped) << eye[0];
+		EXPECT_EQ(Detect(OverUnder(eye[0], eye[1], parallax)).layout, (uint32_t)kLayoutOverUnder) << eye[0];
+	}
+}
+
+// Different scenes in the two halves are not a pair.
+TEST(StereoDetect, UnrelatedHalvesAreMono)
+{
+	Picture picture = Blank(1920, 1080);
+	DrawEye(&picture, 0, 0, 960, 1080, 1, 0);
+	DrawEye(&picture, 960, 0, 960, 1080, 2, 0);
+	EXPECT_EQ(Detect(picture).layout, (uint32_t)kLayoutMono);
+}
+
+
+// ------------------------------------------------------------------------
+// Real pictures
+
+// Each .jps as it is, side by side, its two eyes stacked over under, and one
+// eye alone, as a 2D picture.
+static const char* kFixturePictures[] = { "witcher3001", "MassEffect003" };
+
+static bool LoadGrid(const std::string& name, StereoGrid* grid)
+{
+	std::string path = std::string(KATANGA_FIXTURES) + "/" + name + ".grid";
+	FILE* file = fopen(path.c_str(), "rb");
+	if (file == nullptr)
+		return false;
+	bool read = fread(grid->luma, sizeof(grid->luma), 1, file) == 1;
+	fclose(file);
+	return read;
+}
+
+TEST(StereoDetect, RealSideBySide)
+{
+	for (const char* picture : kFixturePictures)
+	{
+		StereoGrid grid;
+		ASSERT_TRUE(LoadGrid(std::string(picture) + "_sbs", &grid)) << picture;
+
+		StereoDetection found = StereoDetect(grid);
+		EXPECT_EQ(found.layout, (uint32_t)kLayoutSideBySide) << picture;
+		EXPECT_GE(found.confidence, kStereoSureConfidence) << picture;
+		EXPECT_LT(found.shift, 0.0f) << picture;
+	}
+}
+
+// The same screenshot with its halves the other way around.
+TEST(StereoDetect, RealSideBySideSwapped)
+{
+	for (const char* picture : kFixturePictures)
+	{
+		StereoGrid grid;
+		ASSERT_TRUE(LoadGrid(std::string(picture) + "_sbs", &grid)) << picture;
+
+		const int half = kStereoGridWidth / 2;
+		for (int y = 0; y < kStereoGridHeight; y++)
+		{
+			uint8_t right[kStereoGridWidth / 2];
+			memcpy(right, grid.luma[y], half);
+			memmove(grid.luma[y], grid.luma[y] + half, half);
+			memcpy(grid.luma[y] + half, right, half);
+		}
+
+		StereoDetection found = StereoDetect(grid);
+		EXPECT_EQ(found.layout, (uint32_t)kLayoutSideBySideSwapped) << picture;
+		EXPECT_GE(found.confidence, kStereoSureConfidence) << picture;
+	}
+}
+
+TEST(StereoDetect, RealOverUnder)
+{
+	for (const char* picture : kFixturePictures)
+	{
+		StereoGrid grid;
+		ASSERT_TRUE(LoadGrid(std::string(picture) + "_ou", &grid)) << picture;
+
+		StereoDetection found = StereoDetect(grid);
+		EXPECT_EQ(found.layout, (uint32_t)kLayoutOverUnder) << picture;
+		EXPECT_GE(found.confidence, kStereoSureConfidence) << picture;
+		EXPECT_GT(found.overUnder, found.sideBySide) << picture;
+	}
+}
+
+TEST(StereoDetect, RealMono)
+{
+	for (const char* picture : kFixturePictures)
+	{
+		StereoGrid grid;
+		ASSERT_TRUE(LoadGrid(std::string(picture) + "_mono", &grid)) << picture;
+
+		StereoDetection found = StereoDetect(grid);
+		EXPECT_EQ(found.layout, (uint32_t)kLayoutMono) << picture;
+		EXPECT_GE(found.confidence, kStereoSureConfidence) << picture;
+	}
+}
+
+
+// ------------------------------------------------------------------------
+// Sampling
+
+TEST(StereoDetect, HalfToFloat)
+{
+	EXPECT_EQ(StereoHalfToFloat(0x0000), 0.0f);
+	EXPECT_EQ(StereoHalfToFloat(0x3C00), 1.0f);
+	EXPECT_EQ(StereoHalfToFloat(0x3800), 0.5f);
+	EXPECT_EQ(StereoHalfToFloat(0x4000), 2.0f);
+	EXPECT_EQ(StereoHalfToFloat(0x7BFF), 65504.0f);
+	EXPECT_EQ(StereoHalfToFloat(0x7C00), 65504.0f);			// Infinity.
+	EXPECT_EQ(StereoHalfToFloat(0xBC00), 0.0f);				// Negative.
+	EXPECT_EQ(StereoHalfToFloat(0x0001), 1.0f / (1 << 24));	// Denormal.
+	EXPECT_EQ(StereoHalfToFloat(FloatToHalf(0.25f)), 0.25f);
+
+	EXPECT_EQ(StereoLinearToByte(-1.0f), 0);
+	EXPECT_EQ(StereoLinearToByte(0.5f), 128);
+	EXPECT_EQ(StereoLinearToByte(1.0f), 255);
+	EXPECT_EQ(StereoLinearToByte(20.0f), 255);
+}
+
+TEST(StereoDetect, PixelLumaOfEachFormat)
+{
+	const uint8_t bgra[] = { 10, 20, 30, 255 };
+	const uint8_t rgba[] = { 30, 20, 10, 255 };
+	EXPECT_EQ(StereoPixelLuma(bgra, 0, kStereoBGRA8), (2 * 30 + 5 * 20 + 10) >> 3);
+	EXPECT_EQ(StereoPixelLuma(rgba, 0, kStereoRGBA8), (2 * 30 + 5 * 20 + 10) >> 3);
+
+	// The wider formats only look at green.
+	const uint16_t half[] = { 0, 0, 0, 0, 0x7C00, FloatToHalf(0.5f), 0, 0x3C00 };
+	EXPECT_EQ(StereoPixelLuma(reinterpret_cast<const uint8_t*>(half), 1, kStereoRGBA16Float), 128);
+	const uint16_t unorm[] = { 0xFFFF, 0x8000, 0xFFFF, 0xFFFF };
+	EXPECT_EQ(StereoPixelLuma(reinterpret_cast<const uint8_t*>(unorm), 0, kStereoRGBA16Unorm), 128);
+	const float full[] = { 1.0f, 0.25f, 1.0f, 1.0f };
+	EXPECT_EQ(StereoPixelLuma(reinterpret_cast<const uint8_t*>(full), 0, kStereoRGBA32Float), 64);
+}
+
+// The same picture as 8 bit, half float, unorm and float pixels detects the
+// same, pitch padding and all.
+TEST(StereoDetect, EveryFormatAgrees)
+{
+	Picture picture = SideBySideSwapped(640, 360, 8);
+	const size_t pixels = picture.luma.size();
+	const uint32_t padding = 16;
+
+	const size_t samples = (size_t)(picture.width + padding) * picture.height * 4;
+	std::vector<uint8_t> rgba8(samples, 0xEE);
+	std::vector<uint16_t> half(samples, 0x7C00);
+	std::vector<uint16_t> unorm(samples, 0xFFFF);
+	std::vector<float> full(samples, 9.0f);
+	for (size_t i = 0; i < pixels; i++)
+	{
+		size_t x = i % picture.width, y = i / picture.width;
+		size_t at = (y * (picture.width + padding) + x) * 4;
+		uint8_t luma = picture.luma[i];
+		rgba8[at] = rgba8[at + 1] = rgba8[at + 2] = luma;
+		half[at + 1] = FloatToHalf(luma / 255.0f);
+		unorm[at + 1] = (uint16_t)(luma * 257);
+		full[at + 1] = luma / 255.0f;
+	}
+
+	StereoDetection bgra = Detect(picture);
+	size_t pitch = (size_t)(picture.width + padding) * 4;
+	StereoDetection found[] =
+	{
+		StereoDetectPixels(rgba8.data(), picture.width, picture.height, pitch, kStereoRGBA8),
+		StereoDetectPixels(half.data(), picture.width, picture.height, pitch * 2, kStereoRGBA16Float),
+		StereoDetectPixels(unorm.data(), picture.width, picture.height, pitch * 2, kStereoRGBA16Unorm),
+		StereoDetectPixels(full.data(), picture.width, picture.height, pitch * 4, kStereoRGBA32Float),
+	};
+	for (const StereoDetection& each : found)
+	{
+		EXPECT_EQ(each.layout, (uint32_t)kLayoutSideBySideSwapped);
+		EXPECT_NEAR(each.shift, bgra.shift, 0.1f);
+		EXPECT_NEAR(each.sideBySide, bgra.sideBySide, 0.02f);
+	}
+}
+
+// Every cell is the average of the pixels it samples, here a picture whose
+// columns count up, so each cell is its own column.
+TEST(StereoDetect, GridSamplesAcrossEachCell)
+{
+	const uint32_t width = kStereoGridWidth * kStereoCellColumns;
+	const uint32_t height = kStereoGridHeight * kStereoCellRows;
+	std::vector<uint8_t> pixels((size_t)width * height * 4);
+	for (uint32_t y = 0; y < height; y++)
+	{
+		for (uint32_t x = 0; x < width; x++)
+			memset(&pixels[((size_t)y * width + x) * 4], (x / kStereoCellColumns) & 0xFF, 4);
+	}
+
+	StereoGrid grid;
+	StereoSampleGrid(pixels.data(), width, height, (size_t)width * 4, kStereoBGRA8, &grid);
+	for (int cy = 0; cy < kStereoGridHeight; cy++)
+	{
+		for (int cx = 0; cx < kStereoGridWidth; cx++)
+			ASSERT_EQ(grid.luma[cy][cx], cx) << cx << ", " << cy;
+	}
+
+	// Smaller than the grid, pixels are just repeated.
+	uint8_t tiny[2 * 4] = { 0, 0, 0, 0, 200, 200, 200, 200 };
+	StereoSampleGrid(tiny, 2, 1, 8, kStereoBGRA8, &grid);
+	EXPECT_EQ(grid.luma[0][0], 0);
+	EXPECT_EQ(grid.luma[kStereoGridHeight - 1][kStereoGridWidth - 1], 200);
+}
@@ -0,0 +1,68 @@
+// The SIMD kernels in StereoPack.h must match the scalar reference exactly,
+// for every length, including the tails that do not fill a register.
+
+#include "StereoPack.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+
+static std::vector<uint32_t> Noise(size_t count, uint32_t seed)
+{
+	std::vector<uint32_t> pixels(count);
+	for (uint32_t& pixel : pixels)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		pixel = seed;
+	}
+	return pixels;
+}
+
+TEST(StereoPack, KernelsMatchScalar)
+{
+	const StereoPackKernels& scalar = StereoPackKernelsFor(kStereoPackScalar);
+
+	for (int level = kStereoPackSSE2; level <= StereoPackBestLevel(); level++)
+	{
+		const StereoPackKernels& k = StereoPackKernelsFor((StereoPackLevel)level);
+		for (size_t count = 0; count < 70; count++)
+		{
+			std::vector<uint32_t> src = Noise(count, (uint32_t)count + 1);
+
+			std::vector<uint32_t> expected(2 * count + 1, 7), actual(2 * count + 1, 7);
+			scalar.copyRow(expected.data(), src.data(), count);
+			k.copyRow(actual.data(), src.data(), count);
+			EXPECT_EQ(actual, expected) << "copy, level " << level << ", count " << count;
+
+			scalar.doubleRow(expected.data(), src.data(), count);
+			k.doubleRow(actual.data(), src.data(), count);
+			EXPECT_EQ(actual, expected) << "double, level " << level << ", count " << count;
+
+			std::vector<uint32_t> a1 = Noise(count, 3), b1 = Noise(count, 4);
+			std::vector<uint32_t> a2 = a1, b2 = b1;
+			scalar.swapRow(a1.data(), b1.data(), count);
+			k.swapRow(a2.data(), b2.data(), count);
+			EXPECT_EQ(a2, a1) << "swap, level " << level << ", count " << count;
+			EXPECT_EQ(b2, b1) << "swap, level " << level << ", count " << count;
+		}
+	}
+}
+
+TEST(StereoPack, OverUnderPutsTheTopEyeOnTheLeft)
+{
+	const uint32_t eyeWidth = 5, eyeHeight = 3;
+	std::vector<uint32_t> src(eyeWidth * eyeHeight * 2);
+	for (uint32_t y = 0; y < 2 * eyeHeight; y++)
+		for (uint32_t x = 0; x < eyeWidth; x++)
+			src[y * eyeWidth + x] = (y << 8) | x;
+
+	std::vector<uint32_t> dst(src.size());
+	StereoPackOverUnder(StereoPackKernelsBest(), dst.data(), 8 * eyeWidth, src.data(), 4 * eyeWidth, eyeWidth, eyeHeight);
+
+	for (uint32_t y = 0; y < eyeHeight; y++)
+	{
+		EXPECT_EQ(dst[y * 2 * eyeWidth], y << 8);
+		EXPECT_EQ(dst[y * 2 * eyeWidth + eyeWidth + 1], ((y + eyeHeight) << 8) | 1);
+	}
+}
@@ -0,0 +1,165 @@
+// Tests of the trace replay in Tools/SurfaceReplay.h, which drives
+// SharedSurfaceLifecycle.h with a fake device.
+
+#include "SurfaceReplay.h"
+
+#include <gtest/gtest.h>
+
+#include <stdio.h>
+#include <string.h>
+
+
+static bool Parse(const char* text, std::vector<ReplayEvent>* events, std::string* error)
+{
+	FILE* file = fmemopen((void*)text, strlen(text), "r");
+	bool parsed = ParseReplayTrace(file, events, error);
+	fclose(file);
+	return parsed;
+}
+
+static ReplayReport Replay(const char* text, int64_t createMicros = 500)
+{
+	std::vector<ReplayEvent> events;
+	std::string error;
+	EXPECT_TRUE(Parse(text, &events, &error)) << error;
+	return ReplaySurfaceTrace(events, createMicros);
+}
+
+
+TEST(SurfaceReplay, ExpandsRunsInTimeOrder)
+{
+	std::vector<ReplayEvent> events;
+	std::string error;
+	ASSERT_TRUE(Parse(
+		"# comment\n"
+		"0 presents 3 1000 640 480\n"
+		"1500 resize 800 600   # trailing comment\n"
+		"0 vrframes 2 2000 100\n", &events, &error)) << error;
+
+	ASSERT_EQ(events.size(), 6u);
+	EXPECT_EQ(events[0].kind, kReplayPresent);
+	EXPECT_EQ(events[1].kind, kReplayVRFrame);
+	EXPECT_EQ(events[2].time, 1000);
+	EXPECT_EQ(events[3].kind, kReplayResize);
+	EXPECT_EQ(events[3].width, 800u);
+	EXPECT_EQ(events[4].time, 2000);
+	EXPECT_EQ(events[5].time, 2000);
+}
+
+TEST(SurfaceReplay, RejectsBadLines)
+{
+	std::vector<ReplayEvent> events;
+	std::string error;
+	EXPECT_FALSE(Parse("0 present 640 480\n10 resize 0 480\n", &events, &error));
+	EXPECT_NE(error.find("line 2"), std::string::npos) << error;
+	EXPECT_FALSE(Parse("0 explode\n", &events, &error));
+	EXPECT_FALSE(Parse("-5 present 640 480\n", &events, &error));
+}
+
+TEST(SurfaceReplay, EachRebuildIsOneNewSetOfHandles)
+{
+	ReplayReport report = Replay(
+		"0 presents 10 16667 1280 720\n"
+		"50000 resize 1920 1080\n"
+		"90000 reset 2560 1440\n"
+		"120000 recreate\n");
+
+	EXPECT_EQ(report.violations, 0u);
+	EXPECT_EQ(report.rebuilds, 3u);
+	EXPECT_EQ(report.surfaceCreates, 4u * kKatangaMaxSlots);
+	EXPECT_EQ(report.peakAlive, 2u * kKatangaMaxSlots);
+
+	// The recreate publishes over the old ring, with no grey window.
+	EXPECT_EQ(report.staleWindows, 2u);
+	EXPECT_EQ(report.maxSetupMicros, 500 * (int64_t)kKatangaMaxSlots);
+	EXPECT_EQ(report.presentsWithoutSurface, 0u);
+}
+
+TEST(SurfaceReplay, FailedResizeStaysStaleUntilThePresentAfter)
+{
+	ReplayReport report = Replay(
+		"0 present 1280 720\n"
+		"10000 resize-fail\n"
+		"60000 present 1280 720\n", 0);
+
+	EXPECT_EQ(report.violations, 0u);
+	EXPECT_EQ(report.staleWindows, 1u);
+	EXPECT_EQ(report.maxStaleMicros, 50000);
+}
+
+TEST(SurfaceReplay, SetupWaitsOutTheVRFrame)
+{
+	ReplayReport report = Replay(
+		"0 present 1280 720\n"
+		"10000 vrframe 4000\n"
+		"11000 resize 1920 1080\n"
+		"11500 vrframe 4000\n", 0);
+
+	// The resize waits for the frame begun at 10ms, and the one at 11.5ms
+	// would have begun before that was over, but after the lock was taken.
+	EXPECT_EQ(report.waitedForVRMicros, 3000);
+	EXPECT_EQ(report.vrLockedOut, 1u);
+	EXPECT_EQ(report.violations, 0u);
+}
+
+// A recreate is ours to time, so instead of waiting out the VR frame, it goes
+// at the first Present after it.
+
+TEST(SurfaceReplay, RecreateWaitsForAPresentBetweenVRFrames)
+{
+	ReplayReport report = Replay(
+		"0 present 1280 720\n"
+		"10000 vrframe 4000\n"
+		"11000 recreate\n"
+		"12000 present 1280 720\n"
+		"16000 present 1280 720\n"
+		"20000 vrframe 4000\n", 0);
+
+	EXPECT_EQ(report.deferredReplaces, 2u);
+	EXPECT_EQ(report.waitedForVRMicros, 0);
+	EXPECT_EQ(report.vrLockedOut, 0u);
+	EXPECT_EQ(report.surfaceCreates, 2u * kKatangaMaxSlots);
+	EXPECT_EQ(report.staleWindows, 0u);
+	EXPECT_EQ(report.presentsWithoutSurface, 0u);
+	EXPECT_EQ(report.violations, 0u);
+}
+
+// The ring that was replaced stays alive until the VR side has taken a frame
+// of the new one, or the lifecycle gives up on it.
+
+TEST(SurfaceReplay, ReplacedRingDrainsAfterTheVRSideMovesOn)
+{
+	KatangaSharedDescriptor shared = {};
+	ReplayDevice device(0, &shared);
+	SharedSurfaceLifecycle<ReplaySource> lifecycle(&device);
+	ReplaySource source = { 1280, 720 };
+
+	lifecycle.OnPresent(&source, &shared);
+	uint32_t oldHandle = shared.sharedHandle;
+	KatangaPublishFrame(&shared, 0);
+	KatangaConsumerSampled(&shared, 0);
+
+	ASSERT_TRUE(lifecycle.Replace(&source, &shared));
+	EXPECT_NE(shared.sharedHandle, oldHandle);
+	EXPECT_TRUE(lifecycle.IsDraining());
+
+	// A new frame, but the VR side has not looked yet.
+	KatangaPublishFrame(&shared, 1);
+	lifecycle.OnPresent(&source, &shared);
+	EXPECT_TRUE(device.IsAlive(oldHandle));
+
+	KatangaConsumerSampled(&shared, 2);
+	lifecycle.OnPresent(&source, &shared);
+	EXPECT_FALSE(lifecycle.IsDraining());
+	EXPECT_FALSE(device.IsAlive(oldHandle));
+
+	// With no VR side at all, it's let go after kDrainPresents.
+	oldHandle = shared.sharedHandle;
+	ASSERT_TRUE(lifecycle.Replace(&source, &shared));
+	for (int i = 1; i < SharedSurfaceLifecycle<ReplaySource>::kDrainPresents; i++)
+		lifecycle.OnPresent(&source, &shared);
+	EXPECT_TRUE(device.IsAlive(oldHandle));
+	lifecycle.OnPresent(&source, &shared);
+	EXPECT_FALSE(device.IsAlive(oldHandle));
+	EXPECT_EQ(device.Violations(), 0u);
+}
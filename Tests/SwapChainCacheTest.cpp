@@ -0,0 +1,362 @@
+// Tests of SwapChainCache.h, with fake swap chains, devices and contexts that
+// count every AddRef and Release, instead of the DX11 ones.
+
+#include "SwapChainCache.h"
+
+#include <gtest/gtest.h>
+
+
+class CountingObject
+{
+public:
+	unsigned long AddRef()
+	{
+		addRefs++;
+		return ++refs;
+	}
+
+	unsigned long Release()
+	{
+		releases++;
+		return --refs;
+	}
+
+	int refs = 1;
+	int addRefs = 0;
+	int releases = 0;
+};
+
+class FakeSwapChain : public CountingObject {};
+class FakeDevice : public CountingObject {};
+class FakeContext : public CountingObject {};
+
+struct FakeDesc
+{
+	unsigned width;
+	unsigned height;
+};
+
+typedef SwapChainStateCache<FakeSwapChain, FakeDevice, FakeContext, FakeDesc> FakeCache;
+
+static const int kMaxSwapChains = FakeCache::kMaxSwapChains;
+
+// What CacheSwapChainState does with the real ones, GetDevice and
+// GetImmediateContext both hand back a reference the cache then owns.
+
+static FakeCache::Entry* CacheFetched(FakeCache& cache, FakeSwapChain* swapChain, FakeDevice* device, FakeContext* context)
+{
+	device->AddRef();
+	context->AddRef();
+	return cache.Insert(swapChain, device, context);
+}
+
+
+// ------------------------------------------------------------------------
+// Find and Insert
+
+TEST(SwapChainCache, FindsNothingWhenEmpty)
+{
+	FakeCache cache;
+	FakeSwapChain swapChain;
+
+	EXPECT_EQ(cache.Find(&swapChain), nullptr);
+	EXPECT_EQ(cache.Count(), 0);
+}
+
+TEST(SwapChainCache, FindsWhatWasInserted)
+{
+	FakeCache cache;
+	FakeSwapChain swapChain;
+	FakeDevice device;
+	FakeContext context;
+
+	FakeCache::Entry* inserted = CacheFetched(cache, &swapChain, &device, &context);
+
+	FakeCache::Entry* found = cache.Find(&swapChain);
+	ASSERT_EQ(found, inserted);
+	EXPECT_EQ(found->device, &device);
+	EXPECT_EQ(found->context, &context);
+	EXPECT_EQ(cache.Count(), 1);
+}
+
+TEST(SwapChainCache, NeverTakesAReferenceOnTheSwapChain)
+{
+	FakeCache cache;
+	FakeSwapChain swapChain;
+	FakeDevice device;
+	FakeContext context;
+
+	CacheFetched(cache, &swapChain, &device, &context);
+	cache.Find(&swapChain);
+	cache.Invalidate(&swapChain);
+
+	EXPECT_EQ(swapChain.addRefs, 0);
+	EXPECT_EQ(swapChain.releases, 0);
+}
+
+TEST(SwapChainCache, RepeatedLookupsMakeNoRefCountCalls)
+{
+	FakeCache cache;
+	FakeSwapChain swapChain;
+	FakeDevice device;
+	FakeContext context;
+
+	CacheFetched(cache, &swapChain, &device, &context);
+	int deviceAddRefs = device.addRefs;
+	int contextAddRefs = context.addRefs;
+
+	// A thousand Presents worth of cache hits.
+	for (int frame = 0; frame < 1000; frame++)
+		ASSERT_NE(cache.Find(&swapChain), nullptr);
+
+	EXPECT_EQ(device.addRefs, deviceAddRefs);
+	EXPECT_EQ(device.releases, 0);
+	EXPECT_EQ(context.addRefs, contextAddRefs);
+	EXPECT_EQ(context.releases, 0);
+	EXPECT_EQ(swapChain.addRefs + swapChain.releases, 0);
+}
+
+TEST(SwapChainCache, InsertingAgainReplacesTheEntry)
+{
+	FakeCache cache;
+	FakeSwapChain swapChain;
+	FakeDevice oldDevice, newDevice;
+	FakeContext oldContext, newContext;
+
+	CacheFetched(cache, &swapChain, &oldDevice, &oldContext);
+	CacheFetched(cache, &swapChain, &newDevice, &newContext);
+
+	EXPECT_EQ(cache.Count(), 1);
+	EXPECT_EQ(cache.Find(&swapChain)->device, &newDevice);
+	EXPECT_EQ(oldDevice.refs, 1);
+	EXPECT_EQ(oldContext.refs, 1);
+	EXPECT_EQ(newDevice.refs, 2);
+}
+
+TEST(SwapChainCache, EvictsTheOldestWhenFull)
+{
+	FakeCache cache;
+	FakeSwapChain swapChains[kMaxSwapChains + 1];
+	FakeDevice devices[kMaxSwapChains + 1];
+	FakeContext contexts[kMaxSwapChains + 1];
+
+	for (int i = 0; i <= kMaxSwapChains; i++)
+		CacheFetched(cache, &swapChains[i], &devices[i], &contexts[i]);
+
+	EXPECT_EQ(cache.Count(), kMaxSwapChains);
+	EXPECT_EQ(cache.Find(&swapChains[0]), nullptr);
+	EXPECT_EQ(devices[0].refs, 1);
+	EXPECT_EQ(contexts[0].refs, 1);
+	for (int i = 1; i <= kMaxSwapChains; i++)
+	{
+		ASSERT_NE(cache.Find(&swapChains[i]), nullptr);
+		EXPECT_EQ(cache.Find(&swapChains[i])->device, &devices[i]);
+		EXPECT_EQ(devices[i].refs, 2);
+	}
+}
+
+// ------------------------------------------------------------------------
+// The back buffer desc
+
+// What Hooked_Present does, GetDesc only when the entry has none.
+
+static const FakeDesc& PresentDesc(FakeCache::Entry* entry, const FakeDesc& backBuffer, int* getDescs)
+{
+	if (!entry->hasBufferDesc)
+	{
+		entry->bufferDesc = backBuffer;
+		entry->hasBufferDesc = true;
+		(*getDescs)++;
+	}
+	return entry->bufferDesc;
+}
+
+TEST(SwapChainCache, NewEntryHasNoBufferDesc)
+{
+	FakeCache cache;
+	FakeSwapChain swapChain;
+	FakeDevice device;
+	FakeContext context;
+
+	EXPECT_FALSE(CacheFetched(cache, &swapChain, &device, &context)->hasBufferDesc);
+}
+
+TEST(SwapChainCache, BufferDescIsFetchedOnlyOnce)
+{
+	FakeCache cache;
+	FakeSwapChain swapChain;
+	FakeDevice device;
+	FakeContext context;
+	FakeDesc backBuffer = { 1920, 1080 };
+	int getDescs = 0;
+
+	CacheFetched(cache, &swapChain, &device, &context);
+	for (int frame = 0; frame < 1000; frame++)
+		PresentDesc(cache.Find(&swapChain), backBuffer, &getDescs);
+
+	EXPECT_EQ(getDescs, 1);
+	EXPECT_EQ(cache.Find(&swapChain)->bufferDesc.width, 1920u);
+}
+
+TEST(SwapChainCache, ResizeForgetsTheBufferDesc)
+{
+	FakeCache cache;
+	FakeSwapChain swapChain;
+	FakeDevice device;
+	FakeContext context;
+	FakeDesc before = { 1920, 1080 };
+	FakeDesc after = { 2560, 1440 };
+	int getDescs = 0;
+
+	CacheFetched(cache, &swapChain, &device, &context);
+	PresentDesc(cache.Find(&swapChain), before, &getDescs);
+
+	cache.ForgetBufferDesc(&swapChain);
+	const FakeDesc& desc = PresentDesc(cache.Find(&swapChain), after, &getDescs);
+
+	EXPECT_EQ(getDescs, 2);
+	EXPECT_EQ(desc.width, 2560u);
+	EXPECT_EQ(desc.height, 1440u);
+}
+
+// The device and context don't change with a resize, so they stay.
+
+TEST(SwapChainCache, ResizeKeepsTheDeviceAndContext)
+{
+	FakeCache cache;
+	FakeSwapChain swapChain;
+	FakeDevice device;
+	FakeContext context;
+
+	FakeCache::Entry* entry = CacheFetched(cache, &swapChain, &device, &context);
+	entry->hasBufferDesc = true;
+	cache.ForgetBufferDesc(&swapChain);
+
+	EXPECT_EQ(cache.Count(), 1);
+	EXPECT_EQ(cache.Find(&swapChain)->device, &device);
+	EXPECT_EQ(device.releases, 0);
+	EXPECT_EQ(context.releases, 0);
+}
+
+TEST(SwapChainCache, ResizeForgetsOnlyThatSwapChain)
+{
+	FakeCache cache;
+	FakeSwapChain resized, other, unknown;
+	FakeDevice device;
+	FakeContext firstContext, secondContext;
+
+	CacheFetched(cache, &resized, &device, &firstContext)->hasBufferDesc = true;
+	CacheFetched(cache, &other, &device, &secondContext)->hasBufferDesc = true;
+
+	cache.ForgetBufferDesc(&resized);
+	cache.ForgetBufferDesc(&unknown);
+
+	EXPECT_FALSE(cache.Find(&resized)->hasBufferDesc);
+	EXPECT_TRUE(cache.Find(&other)->hasBufferDesc);
+}
+
+// A new swap chain at a reused address must not pick up the old one's desc.
+
+TEST(SwapChainCache, InsertingAgainForgetsTheBufferDesc)
+{
+	FakeCache cache;
+	FakeSwapChain swapChain;
+	FakeDevice device;
+	FakeContext context;
+
+	CacheFetched(cache, &swapChain, &device, &context)->hasBufferDesc = true;
+
+	EXPECT_FALSE(CacheFetched(cache, &swapChain, &device, &context)->hasBufferDesc);
+}
+
+// ------------------------------------------------------------------------
+// Invalidate and Clear
+
+TEST(SwapChainCache, InvalidateReleasesOnlyThatEntry)
+{
+	FakeCache cache;
+	FakeSwapChain first, second;
+	FakeDevice device;
+	FakeContext firstContext, secondContext;
+
+	// Two swap chains on the one device, as with a game and its tool window.
+	CacheFetched(cache, &first, &device, &firstContext);
+	CacheFetched(cache, &second, &device, &secondContext);
+
+	cache.Invalidate(&first);
+
+	EXPECT_EQ(cache.Find(&first), nullptr);
+	ASSERT_NE(cache.Find(&second), nullptr);
+	EXPECT_EQ(cache.Find(&second)->context, &secondContext);
+	EXPECT_EQ(device.refs, 2);
+	EXPECT_EQ(firstContext.refs, 1);
+	EXPECT_EQ(secondContext.refs, 2);
+}
+
+TEST(SwapChainCache, InvalidateOfAnUnknownSwapChainDoesNothing)
+{
+	FakeCache cache;
+	FakeSwapChain cached, unknown;
+	FakeDevice device;
+	FakeContext context;
+
+	CacheFetched(cache, &cached, &device, &context);
+	cache.Invalidate(&unknown);
+
+	EXPECT_EQ(cache.Count(), 1);
+	EXPECT_EQ(device.releases, 0);
+}
+
+// A released swap chain must not leave state for the next one the game makes,
+// which is free to land at the same address.
+
+TEST(SwapChainCache, InvalidatedAddressCanBeReused)
+{
+	FakeCache cache;
+	FakeSwapChain swapChain;
+	FakeDevice oldDevice, newDevice;
+	FakeContext oldContext, newContext;
+
+	CacheFetched(cache, &swapChain, &oldDevice, &oldContext);
+	cache.Invalidate(&swapChain);
+
+	EXPECT_EQ(cache.Find(&swapChain), nullptr);
+	EXPECT_EQ(oldDevice.refs, 1);
+
+	CacheFetched(cache, &swapChain, &newDevice, &newContext);
+	EXPECT_EQ(cache.Find(&swapChain)->device, &newDevice);
+}
+
+TEST(SwapChainCache, ClearReleasesEverything)
+{
+	FakeCache cache;
+	FakeSwapChain swapChains[3];
+	FakeDevice devices[3];
+	FakeContext contexts[3];
+
+	for (int i = 0; i < 3; i++)
+		CacheFetched(cache, &swapChains[i], &devices[i], &contexts[i]);
+
+	cache.Clear();
+
+	EXPECT_EQ(cache.Count(), 0);
+	for (int i = 0; i < 3; i++)
+	{
+		EXPECT_EQ(cache.Find(&swapChains[i]), nullptr);
+		EXPECT_EQ(devices[i].refs, 1);
+		EXPECT_EQ(contexts[i].refs, 1);
+		EXPECT_EQ(devices[i].addRefs, devices[i].releases);
+		EXPECT_EQ(contexts[i].addRefs, contexts[i].releases);
+	}
+}
+
+TEST(SwapChainCache, NullReferencesAreSkipped)
+{
+	FakeCache cache;
+	FakeSwapChain swapChain;
+
+	cache.Insert(&swapChain, nullptr, nullptr);
+	cache.Clear();
+
+	EXPECT_EQ(cache.Count(), 0);
+}
@@ -0,0 +1,159 @@
+// The fast PlasmaGenerator in TextureGenerator.h against the reference one,
+// which it must match to within an output level or so, at several sizes and
+// with the rows handed out in different bands.
+
+#include "TextureGenerator.h"
+
+#include <gtest/gtest.h>
+
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+
+
+static const unsigned char kGuard = 0xCD;
+
+// The image with rowPitch bytes per row, of which only width * 4 are the
+// generator's to write, the rest stay kGuard.  Rows are generated in bands of
+// tileRows, out of order, as the RowPool threads might take them.
+
+static std::vector<unsigned char> Generate(TextureGenerator* generator, int width, int height, int rowPitch,
+	int tileRows, float time)
+{
+	std::vector<unsigned char> image((size_t)rowPitch * height, kGuard);
+	generator->BeginFrame(width, height, time);
+
+	int tiles = (height + tileRows - 1) / tileRows;
+	for (int tile = tiles - 1; tile >= 0; tile--)
+	{
+		int rowBegin = tile * tileRows;
+		generator->GenerateRows(image.data(), rowPitch, rowBegin, std::min(rowBegin + tileRows, height));
+	}
+	return image;
+}
+
+static std::vector<unsigned char> Generate(TextureGenerator* generator, int width, int height, float time)
+{
+	return Generate(generator, width, height, width * 4, height / 2 + 1, time);
+}
+
+static int WorstDifference(const std::vector<unsigned char>& expected, const std::vector<unsigned char>& actual)
+{
+	int worst = 0;
+	for (size_t i = 0; i < expected.size(); i++)
+	{
+		int difference = abs(expected[i] - actual[i]);
+		if (difference > worst)
+			worst = difference;
+	}
+	return worst;
+}
+
+
+TEST(TextureGenerator, PlasmaMatchesTheReference)
+{
+	const int width = 259, height = 67;
+	PlasmaReferenceGenerator reference;
+	PlasmaGenerator fast;
+
+	for (float time : { 0.0f, 1.3f, 250.7f })
+	{
+		std::vector<unsigned char> expected = Generate(&reference, width, height, time);
+		std::vector<unsigned char> actual = Generate(&fast, width, height, time);
+
+		EXPECT_LE(WorstDifference(expected, actual), 1) << "time " << time;
+	}
+}
+
+// Every remainder of the 4 pixel groups, single rows and columns, and a
+// sizable square, so the tables and the tail store are all exercised.
+
+TEST(TextureGenerator, PlasmaMatchesTheReferenceAtEverySize)
+{
+	struct Size { int width; int height; };
+	const Size sizes[] = { { 1, 1 }, { 2, 9 }, { 3, 1 }, { 4, 4 }, { 5, 3 }, { 7, 16 }, { 64, 1 }, { 1, 64 },
+		{ 130, 33 }, { 512, 512 } };
+
+	PlasmaReferenceGenerator reference;
+	PlasmaGenerator fast;
+
+	for (const Size& size : sizes)
+	{
+		std::vector<unsigned char> expected = Generate(&reference, size.width, size.height, 3.7f);
+		std::vector<unsigned char> actual = Generate(&fast, size.width, size.height, 3.7f);
+
+		EXPECT_LE(WorstDifference(expected, actual), 1) << size.width << " x " << size.height;
+	}
+}
+
+// A Unity texture's row pitch may be wider than the image, and the last group
+// of 4 must not spill into the padding.
+
+TEST(TextureGenerator, PlasmaStaysInsideTheRow)
+{
+	const int height = 11;
+	PlasmaGenerator fast;
+
+	for (int width = 1; width <= 9; width++)
+	{
+		const int rowPitch = width * 4 + 16;
+		std::vector<unsigned char> image = Generate(&fast, width, height, rowPitch, 4, 0.5f);
+
+		for (int y = 0; y < height; y++)
+		{
+			for (int i = width * 4; i < rowPitch; i++)
+				ASSERT_EQ(image[(size_t)y * rowPitch + i], kGuard) << "width " << width << ", row " << y;
+		}
+	}
+}
+
+// The RowPool's 16 row tiles, single rows, and the whole image at once must
+// all give the same image, whatever order the bands come in.
+
+TEST(TextureGenerator, BandsDoNotChangeTheImage)
+{
+	const int width = 101, height = 70;
+	PlasmaGenerator fast;
+
+	std::vector<unsigned char> whole = Generate(&fast, width, height, width * 4, height, 9.25f);
+	for (int tileRows : { 1, 3, 16, 69 })
+		EXPECT_EQ(Generate(&fast, width, height, width * 4, tileRows, 9.25f), whole) << "tiles of " << tileRows;
+}
+
+// The same generator is reused when Unity's texture changes size, so the per
+// frame tables must follow, both up and down.
+
+TEST(TextureGenerator, PlasmaFollowsSizeChanges)
+{
+	PlasmaReferenceGenerator reference;
+	PlasmaGenerator fast;
+
+	for (int width : { 40, 333, 17, 200 })
+	{
+		int height = width / 2 + 1;
+		std::vector<unsigned char> expected = Generate(&reference, width, height, 42.0f);
+		std::vector<unsigned char> actual = Generate(&fast, width, height, 42.0f);
+
+		EXPECT_LE(WorstDifference(expected, actual), 1) << width << " x " << height;
+	}
+}
+
+// Every channel carries the same level, and the level actually moves with
+// time rather than being stuck.
+
+TEST(TextureGenerator, PlasmaIsGreyAndAnimated)
+{
+	const int width = 64, height = 32;
+	PlasmaGenerator fast;
+
+	std::vector<unsigned char> first = Generate(&fast, width, height, 0.0f);
+	std::vector<unsigned char> later = Generate(&fast, width, height, 0.4f);
+
+	for (size_t pixel = 0; pixel < first.size(); pixel += 4)
+	{
+		ASSERT_EQ(first[pixel], first[pixel + 1]);
+		ASSERT_EQ(first[pixel], first[pixel + 2]);
+		ASSERT_EQ(first[pixel], first[pixel + 3]);
+	}
+	EXPECT_NE(first, later);
+}
@@ -0,0 +1,350 @@
+// Tests of VtableCache.h, the cache file text and its entries, and reading the
+// build of a module from PE headers made up in memory.
+
+#include "VtableCache.h"
+
+#include <gtest/gtest.h>
+
+
+// Taken by reference in EXPECT_EQ, which the class constant can't be.
+static const size_t kMaxEntries = VtableCache::kMaxEntries;
+
+static VtableModuleBuild Build(const char* name, uint32_t timeDateStamp = 0x5E3B2A1C, uint32_t sizeOfImage = 0x000F2000,
+	uint32_t machine = 0x8664)
+{
+	VtableModuleBuild build = VtableModuleBuild();
+	strncpy(build.name, name, sizeof(build.name) - 1);
+	build.machine = machine;
+	build.timeDateStamp = timeDateStamp;
+	build.sizeOfImage = sizeOfImage;
+	return build;
+}
+
+// The headers of a module as the loader maps them, with the NT headers at
+// 0x80 like the linker puts them.
+
+static const uint32_t kNtHeaders = 0x80;
+
+static std::vector<uint8_t> ModuleImage(uint16_t machine, uint32_t timeDateStamp, uint32_t sizeOfImage)
+{
+	std::vector<uint8_t> image(0x400, 0);
+	image[0] = 'M';
+	image[1] = 'Z';
+	memcpy(&image[0x3C], &kNtHeaders, 4);
+	memcpy(&image[kNtHeaders], "PE\0\0", 4);
+	memcpy(&image[kNtHeaders + 4], &machine, 2);
+	memcpy(&image[kNtHeaders + 8], &timeDateStamp, 4);
+	memcpy(&image[kNtHeaders + 4 + 20 + 56], &sizeOfImage, 4);
+	return image;
+}
+
+
+// ------------------------------------------------------------------------
+// Load and Save
+
+TEST(VtableCache, SaveAndLoadRoundTrip)
+{
+	VtableCache cache;
+	EXPECT_TRUE(cache.Store(Build("dxgi.dll"), "Present", 0x12A40));
+	EXPECT_TRUE(cache.Store(Build("dxgi.dll"), "ResizeBuffers", 0x13B00));
+	EXPECT_TRUE(cache.Store(Build("d3d9.dll", 0x4A5BDA3F, 0x1C0000, 0x14C), "Reset", 0x9F10));
+
+	std::string text = cache.Save();
+	EXPECT_EQ(text,
+		"KatangaVtableCache 1\n"
+		"dxgi.dll 8664 5E3B2A1C 000F2000 Present 00012A40\n"
+		"dxgi.dll 8664 5E3B2A1C 000F2000 ResizeBuffers 00013B00\n"
+		"d3d9.dll 14C 4A5BDA3F 001C0000 Reset 00009F10\n");
+
+	VtableCache loaded;
+	EXPECT_EQ(loaded.Load(text.c_str()), 3u);
+	EXPECT_EQ(loaded.BadLines(), 0);
+	EXPECT_EQ(loaded.Save(), text);
+
+	uint32_t offset = 0;
+	ASSERT_TRUE(loaded.Find(Build("d3d9.dll", 0x4A5BDA3F, 0x1C0000, 0x14C), "Reset", &offset));
+	EXPECT_EQ(offset, 0x9F10u);
+}
+
+TEST(VtableCache, LoadsWindowsLineEndingsAndNoLastNewline)
+{
+	VtableCache cache;
+	EXPECT_EQ(cache.Load("KatangaVtableCache 1\r\n"
+		"dxgi.dll 8664 5E3B2A1C 000F2000 Present 00012A40\r\n"
+		"\r\n"
+		"dxgi.dll\t8664 5E3B2A1C 000F2000   ResizeBuffers 13b00"), 2u);
+	EXPECT_EQ(cache.BadLines(), 0);
+
+	uint32_t offset;
+	ASSERT_TRUE(cache.Find(Build("dxgi.dll"), "ResizeBuffers", &offset));
+	EXPECT_EQ(offset, 0x13B00u);
+}
+
+// Only this version's file is read, anything else is as good as no file.
+
+TEST(VtableCache, OtherVersionSkipsTheFile)
+{
+	const char* texts[] =
+	{
+		"KatangaVtableCache 2\ndxgi.dll 8664 5E3B2A1C 000F2000 Present 00012A40\n",
+		"KatangaVtableCache 1 extra\ndxgi.dll 8664 5E3B2A1C 000F2000 Present 00012A40\n",
+		"dxgi.dll 8664 5E3B2A1C 000F2000 Present 00012A40\n",
+		"",
+	};
+
+	for (const char* text : texts)
+	{
+		VtableCache cache;
+		cache.Store(Build("d3d9.dll"), "Present", 0x100);
+
+		EXPECT_EQ(cache.Load(text), 0u) << text;
+		EXPECT_EQ(cache.Count(), 0u);
+		EXPECT_EQ(cache.BadLines(), 0);
+	}
+
+	VtableCache cache;
+	EXPECT_EQ(cache.Load(nullptr), 0u);
+}
+
+TEST(VtableCache, BadLinesAreCountedAndSkipped)
+{
+	VtableCache cache;
+	EXPECT_EQ(cache.Load("KatangaVtableCache 1\n"
+		"dxgi.dll 8664 5E3B2A1C 000F2000 Present 00012A40\n"
+		"dxgi.dll 8664 5E3B2A1C 000F2000 Present\n"				// No offset.
+		"dxgi.dll 8664 5E3B2A1C 000F2000 Present 00012A40 more\n"
+		"dxgi.dll 8664 5E3B2Z1C 000F2000 Present 00012A40\n"	// Not hex.
+		"dxgi.dll 8664 15E3B2A1C 000F2000 Present 00012A40\n"	// Past 32 bits.
+		"dxgi.dll 8664 5E3B2A1C 000F2000 Present 0\n"			// No offset at all.
+		"a_module_name_much_longer_than_32.dll 8664 5E3B2A1C 000F2000 Present 00012A40\n"
+		"   \t\n"
+		"d3d9.dll 14C 4A5BDA3F 001C0000 Reset 00009F10\n"), 2u);
+
+	EXPECT_EQ(cache.BadLines(), 6);
+
+	uint32_t offset;
+	EXPECT_TRUE(cache.Find(Build("dxgi.dll"), "Present", &offset));
+	EXPECT_TRUE(cache.Find(Build("d3d9.dll", 0x4A5BDA3F, 0x1C0000, 0x14C), "Reset", &offset));
+}
+
+TEST(VtableCache, LoadingAgainStartsOver)
+{
+	VtableCache cache;
+	cache.Load("KatangaVtableCache 1\nbad\ndxgi.dll 8664 5E3B2A1C 000F2000 Present 00012A40\n");
+	ASSERT_EQ(cache.BadLines(), 1);
+
+	EXPECT_EQ(cache.Load("KatangaVtableCache 1\nd3d9.dll 14C 4A5BDA3F 001C0000 Reset 00009F10\n"), 1u);
+	EXPECT_EQ(cache.BadLines(), 0);
+
+	uint32_t offset;
+	EXPECT_FALSE(cache.Find(Build("dxgi.dll"), "Present", &offset));
+}
+
+// ------------------------------------------------------------------------
+// Offsets outside the module
+
+TEST(VtableCache, OffsetPastTheImageIsRejected)
+{
+	VtableCache cache;
+	VtableModuleBuild build = Build("dxgi.dll", 0x5E3B2A1C, 0x1000);
+
+	EXPECT_FALSE(cache.Store(build, "Present", 0x1000));
+	EXPECT_FALSE(cache.Store(build, "Present", 0xFFFFFFFF));
+	EXPECT_FALSE(cache.Store(build, "Present", 0));
+	EXPECT_TRUE(cache.Store(build, "Present", 0xFFF));
+	EXPECT_EQ(cache.Count(), 1u);
+
+	EXPECT_EQ(cache.Load("KatangaVtableCache 1\n"
+		"dxgi.dll 8664 5E3B2A1C 00001000 Present 00001000\n"
+		"dxgi.dll 8664 5E3B2A1C 00000000 Present 00000100\n"
+		"dxgi.dll 8664 5E3B2A1C 00001000 Present 00000FFF\n"), 1u);
+	EXPECT_EQ(cache.BadLines(), 2);
+}
+
+TEST(VtableCache, StoreRejectsBadBuildsAndSlots)
+{
+	VtableCache cache;
+
+	EXPECT_FALSE(cache.Store(Build(""), "Present", 0x100));
+	EXPECT_FALSE(cache.Store(Build("dxgi.dll", 0x5E3B2A1C, 0), "Present", 0x100));
+	EXPECT_FALSE(cache.Store(Build("dxgi.dll"), "ASlotNameLongerThanThirtyTwoChars", 0x100));
+	EXPECT_EQ(cache.Count(), 0u);
+}
+
+// ------------------------------------------------------------------------
+// Store
+
+TEST(VtableCache, StoringTheSameIsNoChange)
+{
+	VtableCache cache;
+	EXPECT_TRUE(cache.Store(Build("dxgi.dll"), "Present", 0x12A40));
+	EXPECT_FALSE(cache.Store(Build("dxgi.dll"), "Present", 0x12A40));
+	EXPECT_TRUE(cache.Store(Build("dxgi.dll"), "Present", 0x12A50));
+
+	uint32_t offset;
+	ASSERT_TRUE(cache.Find(Build("dxgi.dll"), "Present", &offset));
+	EXPECT_EQ(offset, 0x12A50u);
+	EXPECT_EQ(cache.Count(), 1u);
+}
+
+// After a Windows Update, the new build's entry replaces the old one, but only
+// for that slot, and not for the other machine's copy of the dll.
+
+TEST(VtableCache, NewBuildEvictsTheOlderOne)
+{
+	VtableCache cache;
+	VtableModuleBuild old = Build("dxgi.dll", 0x5E3B2A1C, 0xF2000);
+	VtableModuleBuild updated = Build("dxgi.dll", 0x6012ABCD, 0xF4000);
+	VtableModuleBuild wow64 = Build("dxgi.dll", 0x5E3B2A1C, 0xC8000, 0x14C);
+
+	cache.Store(old, "Present", 0x12A40);
+	cache.Store(old, "ResizeBuffers", 0x13B00);
+	cache.Store(wow64, "Present", 0x9000);
+	cache.Store(Build("d3d9.dll"), "Present", 0x8000);
+
+	EXPECT_TRUE(cache.Store(updated, "Present", 0x12C00));
+
+	uint32_t offset;
+	EXPECT_FALSE(cache.Find(old, "Present", &offset));
+	EXPECT_TRUE(cache.Find(updated, "Present", &offset));
+	EXPECT_TRUE(cache.Find(old, "ResizeBuffers", &offset));
+	EXPECT_TRUE(cache.Find(wow64, "Present", &offset));
+	EXPECT_TRUE(cache.Find(Build("d3d9.dll"), "Present", &offset));
+	EXPECT_EQ(cache.Count(), 4u);
+}
+
+TEST(VtableCache, LoadKeepsTheLastBuildInTheFile)
+{
+	VtableCache cache;
+	EXPECT_EQ(cache.Load("KatangaVtableCache 1\n"
+		"dxgi.dll 8664 5E3B2A1C 000F2000 Present 00012A40\n"
+		"dxgi.dll 8664 6012ABCD 000F4000 Present 00012C00\n"), 1u);
+
+	uint32_t offset;
+	EXPECT_TRUE(cache.Find(Build("dxgi.dll", 0x6012ABCD, 0xF4000), "Present", &offset));
+	EXPECT_EQ(offset, 0x12C00u);
+}
+
+TEST(VtableCache, FindNeedsTheExactBuild)
+{
+	VtableCache cache;
+	cache.Store(Build("dxgi.dll"), "Present", 0x12A40);
+
+	uint32_t offset = 0;
+	EXPECT_FALSE(cache.Find(Build("dxgi.dll", 0x5E3B2A1D), "Present", &offset));
+	EXPECT_FALSE(cache.Find(Build("dxgi.dll", 0x5E3B2A1C, 0xF3000), "Present", &offset));
+	EXPECT_FALSE(cache.Find(Build("dxgi.dll", 0x5E3B2A1C, 0xF2000, 0x14C), "Present", &offset));
+	EXPECT_FALSE(cache.Find(Build("dxgi.dll"), "Reset", &offset));
+	EXPECT_EQ(offset, 0u);
+}
+
+// ------------------------------------------------------------------------
+// Trimming
+
+TEST(VtableCache, StoreDropsTheOldestPastTheLimit)
+{
+	VtableCache cache;
+	char slot[32];
+	for (size_t i = 0; i <= kMaxEntries; i++)
+	{
+		snprintf(slot, sizeof(slot), "Slot%zu", i);
+		ASSERT_TRUE(cache.Store(Build("dxgi.dll"), slot, 0x100 + (uint32_t)i));
+	}
+
+	EXPECT_EQ(cache.Count(), kMaxEntries);
+	uint32_t offset;
+	EXPECT_FALSE(cache.Find(Build("dxgi.dll"), "Slot0", &offset));
+	EXPECT_TRUE(cache.Find(Build("dxgi.dll"), "Slot1", &offset));
+	snprintf(slot, sizeof(slot), "Slot%zu", kMaxEntries);
+	EXPECT_TRUE(cache.Find(Build("dxgi.dll"), slot, &offset));
+}
+
+TEST(VtableCache, LoadStopsAtTheLimit)
+{
+	std::string text = "KatangaVtableCache 1\n";
+	char line[96];
+	for (size_t i = 0; i < kMaxEntries + 10; i++)
+	{
+		snprintf(line, sizeof(line), "dxgi.dll 8664 5E3B2A1C 000F2000 Slot%zu %08X\n", i, 0x100 + (uint32_t)i);
+		text += line;
+	}
+
+	VtableCache cache;
+	EXPECT_EQ(cache.Load(text.c_str()), kMaxEntries);
+	EXPECT_EQ(cache.BadLines(), 0);
+
+	uint32_t offset;
+	EXPECT_TRUE(cache.Find(Build("dxgi.dll"), "Slot0", &offset));
+	snprintf(line, sizeof(line), "Slot%zu", kMaxEntries);
+	EXPECT_FALSE(cache.Find(Build("dxgi.dll"), line, &offset));
+}
+
+// ------------------------------------------------------------------------
+// ReadModuleBuild
+
+TEST(VtableCache, ReadsTheBuildFromPEHeaders)
+{
+	std::vector<uint8_t> image = ModuleImage(0x8664, 0x5E3B2A1C, 0xF2000);
+
+	VtableModuleBuild build;
+	ASSERT_TRUE(ReadModuleBuild(image.data(), image.size(), "DXGI.dll", &build));
+	EXPECT_STREQ(build.name, "dxgi.dll");
+	EXPECT_EQ(build.machine, 0x8664u);
+	EXPECT_EQ(build.timeDateStamp, 0x5E3B2A1Cu);
+	EXPECT_EQ(build.sizeOfImage, 0xF2000u);
+	EXPECT_TRUE(build == Build("dxgi.dll"));
+}
+
+TEST(VtableCache, LongModuleNamesAreCut)
+{
+	std::vector<uint8_t> image = ModuleImage(0x14C, 1, 0x1000);
+
+	VtableModuleBuild build;
+	ASSERT_TRUE(ReadModuleBuild(image.data(), image.size(), "A_Module_Name_Longer_Than_The_Field.dll", &build));
+	EXPECT_EQ(strlen(build.name), sizeof(build.name) - 1);
+	EXPECT_EQ(strncmp(build.name, "a_module_name_longer_than_the_f", sizeof(build.name) - 1), 0);
+}
+
+TEST(VtableCache, RejectsWhatIsNotAPEImage)
+{
+	VtableModuleBuild build;
+	std::vector<uint8_t> image = ModuleImage(0x8664, 0x5E3B2A1C, 0xF2000);
+
+	EXPECT_FALSE(ReadModuleBuild(nullptr, 0x400, "dxgi.dll", &build));
+
+	std::vector<uint8_t> notMZ = image;
+	notMZ[0] = 'Z';
+	EXPECT_FALSE(ReadModuleBuild(notMZ.data(), notMZ.size(), "dxgi.dll", &build));
+
+	std::vector<uint8_t> notPE = image;
+	notPE[kNtHeaders + 1] = 'X';
+	EXPECT_FALSE(ReadModuleBuild(notPE.data(), notPE.size(), "dxgi.dll", &build));
+
+	std::vector<uint8_t> noSize = ModuleImage(0x8664, 0x5E3B2A1C, 0);
+	EXPECT_FALSE(ReadModuleBuild(noSize.data(), noSize.size(), "dxgi.dll", &build));
+
+	std::vector<uint8_t> text(0x400, 'x');
+	EXPECT_FALSE(ReadModuleBuild(text.data(), text.size(), "dxgi.dll", &build));
+}
+
+TEST(VtableCache, RejectsTruncatedHeaders)
+{
+	VtableModuleBuild build;
+	std::vector<uint8_t> image = ModuleImage(0x8664, 0x5E3B2A1C, 0xF2000);
+
+	// Just enough for SizeOfImage, and one byte short of it.
+	size_t needed = kNtHeaders + 4 + 20 + 56 + 4;
+	EXPECT_TRUE(ReadModuleBuild(image.data(), needed, "dxgi.dll", &build));
+	EXPECT_FALSE(ReadModuleBuild(image.data(), needed - 1, "dxgi.dll", &build));
+
+	// Short of even e_lfanew.
+	EXPECT_FALSE(ReadModuleBuild(image.data(), 0x3F, "dxgi.dll", &build));
+	EXPECT_FALSE(ReadModuleBuild(image.data(), 2, "dxgi.dll", &build));
+
+	// e_lfanew pointing past the end, or close enough to wrap.
+	uint32_t farAway = 0x10000, wrapping = 0xFFFFFFF0;
+	memcpy(&image[0x3C], &farAway, 4);
+	EXPECT_FALSE(ReadModuleBuild(image.data(), image.size(), "dxgi.dll", &build));
+	memcpy(&image[0x3C], &wrapping, 4);
+	EXPECT_FALSE(ReadModuleBuild(image.data(), image.size(), "dxgi.dll", &build));
+}
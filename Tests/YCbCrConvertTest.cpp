@@ -0,0 +1,212 @@
+// Tests of YCbCrConvert.h, against the JFIF conversion done in doubles, and
+// the SSE2 rows against the scalar ones they have to match to the byte.
+
+#include "YCbCrConvert.h"
+
+#include <gtest/gtest.h>
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+
+// The JFIF equations as written, for what each pixel should be, give or take
+// the fixed point rounding.
+static void ReferencePixel(int y, int cb, int cr, int* b, int* g, int* r)
+{
+	auto clamp = [](double value) { return (int)fmin(fmax(floor(value + 0.5), 0.0), 255.0); };
+	*r = clamp(y + 1.402 * (cr - 128));
+	*g = clamp(y - 0.344136 * (cb - 128) - 0.714136 * (cr - 128));
+	*b = clamp(y + 1.772 * (cb - 128));
+}
+
+static std::vector<uint8_t> RandomBytes(size_t count, unsigned seed)
+{
+	std::vector<uint8_t> bytes(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		seed = seed * 1103515245 + 12345;
+		bytes[i] = (uint8_t)(seed >> 16);
+	}
+	return bytes;
+}
+
+
+// ------------------------------------------------------------------------
+// YCbCr to BGRA
+
+TEST(YCbCrConvert, KnownColors)
+{
+	struct Known
+	{
+		uint8_t y, cb, cr;
+		uint8_t b, g, r;
+	};
+	const Known kColors[] =
+	{
+		{ 0, 128, 128, 0, 0, 0 },
+		{ 255, 128, 128, 255, 255, 255 },
+		{ 128, 128, 128, 128, 128, 128 },
+		{ 76, 85, 255, 0, 0, 254 },				// Red.
+		{ 150, 44, 21, 1, 255, 0 },				// Green.
+		{ 29, 255, 107, 254, 0, 0 },			// Blue.
+		{ 255, 0, 0, 28, 255, 76 },				// Clamped both ways.
+	};
+
+	for (const Known& color : kColors)
+	{
+		uint8_t out[4];
+		YCbCrToBGRAPixel(color.y, color.cb, color.cr, out);
+		EXPECT_EQ(out[0], color.b) << (int)color.y << " " << (int)color.cb << " " << (int)color.cr;
+		EXPECT_EQ(out[1], color.g) << (int)color.y << " " << (int)color.cb << " " << (int)color.cr;
+		EXPECT_EQ(out[2], color.r) << (int)color.y << " " << (int)color.cb << " " << (int)color.cr;
+		EXPECT_EQ(out[3], 255);
+	}
+}
+
+// Every Y, Cb and Cr there is, a row of all the Y values for each chroma pair,
+// through the SSE2 row.  Within one of the doubles, and exactly the scalar.
+
+TEST(YCbCrConvert, EveryValueMatchesTheReference)
+{
+	uint8_t luma[256], blue[256], red[256];
+	for (int i = 0; i < 256; i++)
+		luma[i] = (uint8_t)i;
+	uint8_t simd[256 * 4], scalar[256 * 4];
+
+	int worst = 0, off = 0;
+	for (int cb = 0; cb < 256; cb++)
+	{
+		for (int cr = 0; cr < 256; cr++)
+		{
+			memset(blue, cb, sizeof(blue));
+			memset(red, cr, sizeof(red));
+			YCbCrRowToBGRA(luma, blue, red, 256, 0, simd);
+			YCbCrRowToBGRAScalar(luma, blue, red, 0, 256, 0, scalar);
+			ASSERT_EQ(memcmp(simd, scalar, sizeof(simd)), 0) << "cb " << cb << " cr " << cr;
+
+			for (int y = 0; y < 256; y++)
+			{
+				int b, g, r;
+				ReferencePixel(y, cb, cr, &b, &g, &r);
+				int error = std::max(std::max(abs(simd[y * 4] - b), abs(simd[y * 4 + 1] - g)), abs(simd[y * 4 + 2] - r));
+				worst = std::max(worst, error);
+				off += (error != 0) ? 1 : 0;
+				EXPECT_EQ(simd[y * 4 + 3], 255);
+			}
+		}
+	}
+	EXPECT_LE(worst, 1);
+	// Fourteen bits is plenty, nearly all land on the rounded double.  The few
+	// that don't are halves that the coefficients' own rounding tips over.
+	EXPECT_LT(off, 256 * 256 * 256 / 200);
+}
+
+// Random rows of every width up to a few vectors, so every tail length, at
+// full and half width chroma.
+
+TEST(YCbCrConvert, RowsMatchTheScalarAtEveryWidth)
+{
+	std::vector<uint8_t> luma = RandomBytes(80, 1);
+	std::vector<uint8_t> blue = RandomBytes(80, 2);
+	std::vector<uint8_t> red = RandomBytes(80, 3);
+
+	for (int chromaShiftX = 0; chromaShiftX <= 1; chromaShiftX++)
+	{
+		for (int width = 0; width <= 80; width++)
+		{
+			std::vector<uint8_t> simd(width * 4 + 4, 0xCD), scalar(width * 4 + 4, 0xCD);
+			YCbCrRowToBGRA(luma.data(), blue.data(), red.data(), width, chromaShiftX, simd.data());
+			YCbCrRowToBGRAScalar(luma.data(), blue.data(), red.data(), 0, width, chromaShiftX, scalar.data());
+			ASSERT_EQ(simd, scalar) << "width " << width << " shift " << chromaShiftX;
+
+			// Nothing past the row.
+			EXPECT_EQ(simd[width * 4], 0xCD);
+		}
+	}
+}
+
+// Half width chroma, each sample is the pixel pair's.
+TEST(YCbCrConvert, HalfWidthChromaCoversTwoPixels)
+{
+	const int kWidth = 37;
+	std::vector<uint8_t> luma = RandomBytes(kWidth, 4);
+	std::vector<uint8_t> blue = RandomBytes((kWidth + 1) / 2, 5);
+	std::vector<uint8_t> red = RandomBytes((kWidth + 1) / 2, 6);
+
+	std::vector<uint8_t> bgra(kWidth * 4);
+	YCbCrRowToBGRA(luma.data(), blue.data(), red.data(), kWidth, 1, bgra.data());
+	for (int x = 0; x < kWidth; x++)
+	{
+		uint8_t expected[4];
+		YCbCrToBGRAPixel(luma[x], blue[x / 2], red[x / 2], expected);
+		ASSERT_EQ(memcmp(&bgra[x * 4], expected, 4), 0) << "x " << x;
+	}
+}
+
+// ------------------------------------------------------------------------
+// Halving
+
+TEST(YCbCrConvert, HalvingsStillCoverTheScreen)
+{
+	EXPECT_EQ(SlideHalvings(3840, 2160, 0, 0), 0);
+	EXPECT_EQ(SlideHalvings(3840, 2160, 1920, 1080), 1);
+	EXPECT_EQ(SlideHalvings(3840, 2160, 1921, 1080), 0);
+	EXPECT_EQ(SlideHalvings(3840, 2160, 1000, 1000), 1);
+	EXPECT_EQ(SlideHalvings(3840, 2160, 100, 100), 4);
+	EXPECT_EQ(SlideHalvings(4000, 2000, 0, 500), 2);		// Only the height limits.
+	EXPECT_EQ(SlideHalvings(4000, 2000, 1000, 0), 2);
+	EXPECT_EQ(SlideHalvings(4, 4, 1, 1), 2);
+	EXPECT_EQ(SlideHalvings(1, 1, 1, 1), 0);
+}
+
+// The same 2x2 box, rows averaged first then columns, rounding up each time.
+static void ReferenceHalve(const uint8_t* source, uint32_t width, uint32_t height, size_t pitch, uint8_t* dest)
+{
+	for (uint32_t y = 0; y < height / 2; y++)
+	{
+		for (uint32_t x = 0; x < width / 2; x++)
+		{
+			for (int c = 0; c < 4; c++)
+			{
+				const uint8_t* top = source + (size_t)(2 * y) * pitch + x * 8 + c;
+				const uint8_t* bottom = top + pitch;
+				int left = (top[0] + bottom[0] + 1) >> 1;
+				int right = (top[4] + bottom[4] + 1) >> 1;
+				dest[((size_t)y * (width / 2) + x) * 4 + c] = (uint8_t)((left + right + 1) >> 1);
+			}
+		}
+	}
+}
+
+TEST(YCbCrConvert, HalveMatchesTheBoxAtEverySize)
+{
+	for (uint32_t width = 1; width <= 21; width++)
+	{
+		for (uint32_t height = 1; height <= 5; height++)
+		{
+			size_t pitch = width * 4 + 12;
+			std::vector<uint8_t> source = RandomBytes(pitch * height, width * 10 + height);
+			std::vector<uint8_t> halved((width / 2) * (height / 2) * 4 + 4, 0xCD);
+			std::vector<uint8_t> reference(halved.size(), 0xCD);
+
+			HalveBGRA(source.data(), width, height, pitch, halved.data());
+			ReferenceHalve(source.data(), width, height, pitch, reference.data());
+			ASSERT_EQ(halved, reference) << width << "x" << height;
+		}
+	}
+}
+
+TEST(YCbCrConvert, HalveInPlace)
+{
+	const uint32_t kWidth = 30, kHeight = 9;
+	std::vector<uint8_t> image = RandomBytes(kWidth * kHeight * 4, 7);
+	std::vector<uint8_t> reference(15 * 4 * 4);
+	ReferenceHalve(image.data(), kWidth, kHeight, kWidth * 4, reference.data());
+
+	HalveBGRA(image.data(), kWidth, kHeight, kWidth * 4, image.data());
+	EXPECT_EQ(memcmp(image.data(), reference.data(), reference.size()), 0);
+}
@@ -0,0 +1,206 @@
+#pragma once
+
+//-----------------------------------------------------------
+// Deterministic simulation of the game and HMD sides of the shared surface.
+//
+// The game presents at its own rate, and FramePacer.h decides which of those
+// frames are copied.  A copied frame goes into the write slot, and once the
+// copy is done, the slot is swapped into the mailbox with KatangaIPC.h, the
+// same calls as Hooked_Present.  The HMD samples at its own rate, takes the
+// newest slot with KatangaAcquireLatestSlot, and writes back what it saw with
+// KatangaConsumerSampled, like TakeLatestFrame.
+//
+// Time is in microseconds, with an optional jitter on the game's frame times
+// from a fixed seed, so every run of the same config gives the same report.
+//
+// The report counts:
+//  - torn:     HMD samples of a slot the game side still owns for writing.
+//              The ring is meant to make this impossible.
+//  - repeats:  HMD frames showing the same game frame as the one before.
+//              Expected whenever the game is slower than the HMD.
+//  - stale:    HMD frames showing an older game frame than the newest one that
+//              could have been copied in time.  That's what pacing risks.
+//  - dropped:  copies replaced in the mailbox before the HMD took them, so the
+//              copy was wasted.  That's what pacing is meant to avoid.
+
+#include <stdint.h>
+
+#include "FramePacer.h"
+#include "KatangaIPC.h"
+
+
+struct PacingConfig
+{
+	double gameHz;
+	double hmdHz;
+	double seconds;
+	uint32_t jitterPercent;				// Of the game's frame time, either way.
+	bool paced;							// False copies every Present.
+	uint32_t maxCopyHz;					// The pacer's optional cap, 0 for none.
+	int64_t copyMicros;					// How long each copy keeps its slot.
+};
+
+struct PacingReport
+{
+	uint64_t presents;
+	uint64_t copies;
+	uint64_t hmdFrames;
+	uint64_t torn;
+	uint64_t repeats;
+	uint64_t stale;
+	uint64_t dropped;
+	int64_t totalLatency;				// Present to HMD sample, of each shown frame.
+
+	double CopiesPerHmdFrame() const { return hmdFrames ? (double)copies / hmdFrames : 0; }
+	double AverageLatencyMs() const { return hmdFrames ? totalLatency / 1000.0 / hmdFrames : 0; }
+};
+
+
+class PacingSimulation
+{
+public:
+	explicit PacingSimulation(const PacingConfig& config)
+		: config(config)
+	{
+		const uint32_t slots[kKatangaMaxSlots] = { 1, 2, 3 };
+		KatangaPublishSurface(&desc, slots, kKatangaMaxSlots, 3840, 1080, 28, kLayoutSideBySide, 0);
+		pacer.Init(kTicksPerSecond, config.maxCopyHz);
+	}
+
+	PacingReport Run()
+	{
+		int64_t end = (int64_t)(config.seconds * kTicksPerSecond);
+		int64_t hmdPeriod = (int64_t)(kTicksPerSecond / config.hmdHz);
+
+		// Both start a little in, so that neither side's first time is zero,
+		// which the descriptor treats as never.
+		int64_t nextPresent = 1000;
+		int64_t nextSample = 1000 + hmdPeriod / 3;
+
+		while (nextPresent < end || nextSample < end)
+		{
+			// A copy that is done goes into the mailbox before anything else.
+			if (copying && copyDone <= nextPresent && copyDone <= nextSample)
+			{
+				FinishCopy();
+				continue;
+			}
+
+			if (nextPresent <= nextSample)
+			{
+				Present(nextPresent);
+				nextPresent += NextGameInterval();
+			}
+			else
+			{
+				Sample(nextSample);
+				nextSample += hmdPeriod;
+			}
+		}
+		return report;
+	}
+
+private:
+	static const int64_t kTicksPerSecond = 1000000;
+
+	int64_t NextGameInterval()
+	{
+		int64_t interval = (int64_t)(kTicksPerSecond / config.gameHz);
+		if (config.jitterPercent == 0)
+			return interval;
+
+		// Numerical Recipes LCG, plenty for jitter.
+		seed = seed * 1664525u + 1013904223u;
+		int64_t range = interval * config.jitterPercent / 100;
+		return interval - range + (int64_t)((seed >> 8) % (uint32_t)(2 * range + 1));
+	}
+
+	void Present(int64_t now)
+	{
+		report.presents++;
+		presentTimes[report.presents % kHistory] = now;
+
+		// Still copying the last one, the real game side's copy would be queued
+		// behind it on the GPU.  Simplest to not copy this frame at all.
+		if (copying)
+			return;
+
+		uint64_t consumedSequence;
+		int64_t consumerSampleTime;
+		KatangaReadConsumerSample(&desc, &consumedSequence, &consumerSampleTime);
+		if (config.paced &&
+			!pacer.ShouldCopy(now, KatangaReadFrameSequence(&desc), consumedSequence, consumerSampleTime))
+			return;
+
+		copying = true;
+		copyDone = now + config.copyMicros;
+		slotFrame[writeSlot] = report.presents;
+		slotPresent[writeSlot] = now;
+	}
+
+	void FinishCopy()
+	{
+		copying = false;
+		report.copies++;
+		KatangaPublishFrame(&desc, copyDone);
+
+		bool unconsumed;
+		writeSlot = KatangaSwapWriteSlot(&desc, writeSlot, &unconsumed);
+		if (unconsumed)
+			report.dropped++;
+		pacer.OnCopied(copyDone);
+	}
+
+	void Sample(int64_t now)
+	{
+		readSlot = KatangaAcquireLatestSlot(&desc, readSlot);
+		KatangaConsumerSampled(&desc, now);
+
+		uint64_t frame = slotFrame[readSlot];
+		if (frame == 0)
+			return;								// Nothing copied yet.
+
+		report.hmdFrames++;
+		if (readSlot == writeSlot)
+			report.torn++;
+		if (frame == lastShown)
+			report.repeats++;
+		lastShown = frame;
+		report.totalLatency += now - slotPresent[readSlot];
+
+		// The newest frame that was presented early enough to have been copied
+		// by now.  Anything newer than what we show is a frame pacing held back.
+		uint64_t newest = report.presents;
+		while (newest > frame && newest + kHistory > report.presents &&
+			presentTimes[newest % kHistory] + config.copyMicros > now)
+			newest--;
+		if (newest > frame)
+			report.stale++;
+	}
+
+	static const uint64_t kHistory = 64;
+
+	PacingConfig config;
+	PacingReport report = {};
+	KatangaSharedDescriptor desc = {};
+	FramePacer pacer;
+	uint32_t seed = 12345;
+
+	// Game side.  Slots start in the state KatangaPublishSurface leaves them.
+	uint32_t writeSlot = 0;
+	bool copying = false;
+	int64_t copyDone = 0;
+	uint64_t slotFrame[kKatangaMaxSlots] = {};
+	int64_t slotPresent[kKatangaMaxSlots] = {};
+	int64_t presentTimes[kHistory] = {};
+
+	// HMD side.
+	uint32_t readSlot = kKatangaMaxSlots - 1;
+	uint64_t lastShown = 0;
+};
+
+inline PacingReport SimulatePacing(const PacingConfig& config)
+{
+	PacingSimulation simulation(config);
+	return simulation.Run();
+}
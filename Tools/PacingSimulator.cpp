@@ -0,0 +1,50 @@
+// Prints the PacingSimulation.h report for the usual game rates against an
+// HMD, with and without the FramePacer.
+//
+//     PacingSimulator [hmdHz] [seconds] [jitterPercent]
+//
+// Defaults to a 90Hz HMD for 60 seconds, with 10% jitter on the game frames.
+
+#include "PacingSimulation.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <initializer_list>
+
+
+int main(int argc, char* argv[])
+{
+	double hmdHz = (argc > 1) ? atof(argv[1]) : 90;
+	double seconds = (argc > 2) ? atof(argv[2]) : 60;
+	uint32_t jitter = (argc > 3) ? (uint32_t)atoi(argv[3]) : 10;
+	if (hmdHz <= 0 || seconds <= 0 || jitter >= 100)
+	{
+		fprintf(stderr, "usage: %s [hmdHz] [seconds] [jitterPercent]\n", argv[0]);
+		return 2;
+	}
+
+	const double kGameRates[] = { 30, 45, 60, 90, 144, 240 };
+
+	printf("HMD %.0f Hz, %.0f s, %u%% jitter\n\n", hmdHz, seconds, jitter);
+	printf("%8s %6s %9s %9s %10s %8s %8s %8s %8s %10s\n",
+		"game Hz", "paced", "presents", "copies", "copies/HMD", "torn", "repeats", "stale", "dropped", "latency ms");
+
+	uint64_t torn = 0;
+	for (double gameHz : kGameRates)
+	{
+		for (bool paced : { false, true })
+		{
+			PacingConfig config = { gameHz, hmdHz, seconds, jitter, paced, 0, 1500 };
+			PacingReport report = SimulatePacing(config);
+			torn += report.torn;
+
+			printf("%8.0f %6s %9llu %9llu %10.2f %8llu %8llu %8llu %8llu %10.2f\n",
+				gameHz, paced ? "yes" : "no", (unsigned long long)report.presents, (unsigned long long)report.copies,
+				report.CopiesPerHmdFrame(), (unsigned long long)report.torn, (unsigned long long)report.repeats,
+				(unsigned long long)report.stale, (unsigned long long)report.dropped, report.AverageLatencyMs());
+		}
+	}
+
+	// Tearing is the one thing that must never happen.
+	return (torn == 0) ? 0 : 1;
+}
@@ -0,0 +1,168 @@
+// Makes the real picture fixtures for StereoDetectTest, from a .jps.  Those
+// are the StereoGrid each layout of the picture samples down to, so the tests
+// need no jpeg decoder, only the 32K luma grid per layout.
+//
+//     StereoGrids <picture.jps> [outputPrefix]
+//
+// A .jps is side by side, right eye on the left half, the way Katanga wants it.
+// Its two eyes are also stacked into over under, and one eye alone stands in
+// for a 2D picture.  Each is sampled and detected, and the result printed.  If
+// outputPrefix is given, the grids go to outputPrefix_sbs.grid, _ou.grid and
+// _mono.grid, as raw bytes, top row first.
+
+#include "StereoDetect.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+extern "C"
+{
+#include <jpeglib.h>
+}
+
+
+struct Picture
+{
+	uint32_t width = 0;
+	uint32_t height = 0;
+	std::vector<uint8_t> bgra;
+
+	uint8_t* Pixel(uint32_t x, uint32_t y) { return &bgra[((size_t)y * width + x) * 4]; }
+};
+
+static bool DecodeJpeg(const char* path, Picture* picture)
+{
+	FILE* file = fopen(path, "rb");
+	if (file == nullptr)
+		return false;
+
+	jpeg_decompress_struct decoder;
+	jpeg_error_mgr errors;
+	decoder.err = jpeg_std_error(&errors);
+	jpeg_create_decompress(&decoder);
+	jpeg_stdio_src(&decoder, file);
+	jpeg_read_header(&decoder, TRUE);
+	decoder.out_color_space = JCS_RGB;
+	jpeg_start_decompress(&decoder);
+
+	picture->width = decoder.output_width;
+	picture->height = decoder.output_height;
+	picture->bgra.resize((size_t)picture->width * picture->height * 4);
+
+	std::vector<uint8_t> rgb((size_t)picture->width * 3);
+	while (decoder.output_scanline < decoder.output_height)
+	{
+		uint32_t y = decoder.output_scanline;
+		JSAMPROW row = rgb.data();
+		jpeg_read_scanlines(&decoder, &row, 1);
+		for (uint32_t x = 0; x < picture->width; x++)
+		{
+			uint8_t* pixel = picture->Pixel(x, y);
+			pixel[0] = rgb[x * 3 + 2];
+			pixel[1] = rgb[x * 3 + 1];
+			pixel[2] = rgb[x * 3];
+			pixel[3] = 0xFF;
+		}
+	}
+
+	jpeg_finish_decompress(&decoder);
+	jpeg_destroy_decompress(&decoder);
+	fclose(file);
+	return true;
+}
+
+// One eye of the side by side picture, 0 for the left half.
+
+static Picture Eye(Picture& pair, int half)
+{
+	Picture eye;
+	eye.width = pair.width / 2;
+	eye.height = pair.height;
+	eye.bgra.resize((size_t)eye.width * eye.height * 4);
+	for (uint32_t y = 0; y < eye.height; y++)
+		memcpy(eye.Pixel(0, y), pair.Pixel(half * eye.width, y), (size_t)eye.width * 4);
+	return eye;
+}
+
+// The same eyes, right eye on top.
+
+static Picture OverUnder(Picture& pair)
+{
+	Picture right = Eye(pair, 0);
+	Picture left = Eye(pair, 1);
+
+	Picture stacked;
+	stacked.width = right.width;
+	stacked.height = right.height * 2;
+	stacked.bgra = right.bgra;
+	stacked.bgra.insert(stacked.bgra.end(), left.bgra.begin(), left.bgra.end());
+	return stacked;
+}
+
+static const char* LayoutName(uint32_t layout)
+{
+	switch (layout)
+	{
+	case kLayoutSideBySide:			return "side by side";
+	case kLayoutSideBySideSwapped:	return "side by side, swapped";
+	case kLayoutOverUnder:			return "over under";
+	case kLayoutMono:				return "mono";
+	default:						return "unknown";
+	}
+}
+
+static bool Report(const char* name, Picture& picture, const char* prefix, const char* suffix)
+{
+	StereoGrid grid;
+	StereoSampleGrid(picture.bgra.data(), picture.width, picture.height, (size_t)picture.width * 4, kStereoBGRA8, &grid);
+	StereoDetection detection = StereoDetect(grid);
+
+	printf("  %-6s %5ux%-5u %-22s confidence %3u, side by side %.3f, over under %.3f, shift %.2f\n",
+		name, picture.width, picture.height, LayoutName(detection.layout), detection.confidence,
+		detection.sideBySide, detection.overUnder, detection.shift);
+
+	if (prefix == nullptr)
+		return true;
+
+	std::string path = std::string(prefix) + suffix;
+	FILE* file = fopen(path.c_str(), "wb");
+	if (file == nullptr || fwrite(grid.luma, sizeof(grid.luma), 1, file) != 1)
+	{
+		fprintf(stderr, "cannot write %s\n", path.c_str());
+		if (file)
+			fclose(file);
+		return false;
+	}
+	fclose(file);
+	return true;
+}
+
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "usage: %s <picture.jps> [outputPrefix]\n", argv[0]);
+		return 2;
+	}
+	const char* prefix = (argc > 2) ? argv[2] : nullptr;
+
+	Picture pair;
+	if (!DecodeJpeg(argv[1], &pair))
+	{
+		fprintf(stderr, "%s: cannot open %s\n", argv[0], argv[1]);
+		return 2;
+	}
+
+	Picture overUnder = OverUnder(pair);
+	Picture mono = Eye(pair, 1);
+
+	printf("%s\n", argv[1]);
+	bool written = Report("sbs", pair, prefix, "_sbs.grid") &&
+		Report("ou", overUnder, prefix, "_ou.grid") &&
+		Report("mono", mono, prefix, "_mono.grid");
+	return written ? 0 : 1;
+}
@@ -0,0 +1,70 @@
+// Replays a trace of Present, ResizeBuffers and Reset events through the
+// shared surface lifecycle, see SurfaceReplay.h for the trace format, and
+// prints the handle churn, setup lock hold time and stale windows.
+//
+//     SurfaceReplay <trace> [createMicros] [maxSetupMs]
+//
+// createMicros is what each fake surface takes to make, 500 by default.  If
+// maxSetupMs is given, any setup holding the lock longer than that fails the
+// run, as does breaking any of the lifecycle's rules.
+
+#include "SurfaceReplay.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "usage: %s <trace> [createMicros] [maxSetupMs]\n", argv[0]);
+		return 2;
+	}
+	int64_t createMicros = (argc > 2) ? atoll(argv[2]) : 500;
+	double maxSetupMs = (argc > 3) ? atof(argv[3]) : 0;
+
+	FILE* file = fopen(argv[1], "r");
+	if (file == nullptr)
+	{
+		fprintf(stderr, "%s: cannot open %s\n", argv[0], argv[1]);
+		return 2;
+	}
+	std::vector<ReplayEvent> events;
+	std::string error;
+	bool parsed = ParseReplayTrace(file, &events, &error);
+	fclose(file);
+	if (!parsed)
+	{
+		fprintf(stderr, "%s: %s\n", argv[1], error.c_str());
+		return 2;
+	}
+
+	ReplayReport report = ReplaySurfaceTrace(events, createMicros);
+
+	printf("%s, %zu events, %lld us per surface\n\n", argv[1], events.size(), (long long)createMicros);
+	printf("  presents              %10llu\n", (unsigned long long)report.presents);
+	printf("  without surface       %10llu\n", (unsigned long long)report.presentsWithoutSurface);
+	printf("  rebuilds              %10llu\n", (unsigned long long)report.rebuilds);
+	printf("  recreates deferred    %10llu\n", (unsigned long long)report.deferredReplaces);
+	printf("  handles created       %10llu\n", (unsigned long long)report.surfaceCreates);
+	printf("  most alive at once    %10u\n", report.peakAlive);
+	printf("  setup lock, avg ms    %10.3f\n", report.AverageSetupMs());
+	printf("  setup lock, max ms    %10.3f\n", report.maxSetupMicros / 1000.0);
+	printf("  waiting on VR, ms     %10.3f\n", report.waitedForVRMicros / 1000.0);
+	printf("  VR frames             %10llu\n", (unsigned long long)report.vrFrames);
+	printf("  VR frames locked out  %10llu\n", (unsigned long long)report.vrLockedOut);
+	printf("  stale windows         %10llu\n", (unsigned long long)report.staleWindows);
+	printf("  stale, avg ms         %10.3f\n", report.AverageStaleMs());
+	printf("  stale, max ms         %10.3f\n", report.maxStaleMicros / 1000.0);
+	printf("  rule violations       %10llu\n", (unsigned long long)report.violations);
+
+	if (report.violations != 0)
+		return 1;
+	if (maxSetupMs > 0 && report.maxSetupMicros / 1000.0 > maxSetupMs)
+	{
+		printf("\nSetup held the lock for %.3f ms, more than %.3f ms\n", report.maxSetupMicros / 1000.0, maxSetupMs);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,424 @@
+#pragma once
+
+//-----------------------------------------------------------
+// Replays a recorded sequence of game and VR side events through
+// SharedSurfaceLifecycle.h, with an in-memory fake of the graphics device and
+// the setup lock, so a change to the resize path can be measured without a
+// game, and shows up as a number instead of a hang.
+//
+// The trace is text, one event per line, in microseconds from the start.  Any
+// order, they are sorted by time, and '#' starts a comment.
+//
+//     <us> present <width> <height>           Present, with the backbuffer size.
+//     <us> resize <width> <height>            ResizeBuffers to the new size.
+//     <us> resize-fail                        ResizeBuffers that failed.
+//     <us> reset <width> <height>             DX9 Reset, the same sequence.
+//     <us> recreate                           New copy mode, same backbuffer.
+//     <us> vrframe <busyUs>                   VR side frame, busy for busyUs.
+//     <us> presents <count> <periodUs> <width> <height>
+//     <us> vrframes <count> <periodUs> <busyUs>
+//
+// The last two are runs of the ones above, so a trace can say a minute of
+// 60Hz presents in one line.
+//
+// The fake device takes createMicros of its clock for each surface it makes,
+// and the setup lock waits out a VR frame that is still busy, like
+// KatangaWaitConsumerIdle.  A VR frame that would begin while the game side
+// is in setup is locked out until it ends, like KatangaTryBeginFrame.  Each
+// Present with a surface publishes a frame, and each VR frame samples it.
+//
+// A recreate is SharedSurfaceLifecycle::Replace, which does not wait for a
+// busy VR frame, and is tried again at each Present until it gets through.
+//
+// Besides the lifecycle's own numbers, it checks the rules at the top of
+// SharedSurfaceLifecycle.h as it goes: surfaces only made with the lock held,
+// and only released with it or once they are no longer published, the
+// published handles always ones that are still alive, and never more than the
+// new set and the one it replaces alive at once.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "SharedSurfaceLifecycle.h"
+
+
+enum ReplayEventKind
+{
+	kReplayPresent,
+	kReplayResize,
+	kReplayResizeFail,
+	kReplayReset,
+	kReplayRecreate,
+	kReplayVRFrame,
+};
+
+struct ReplayEvent
+{
+	int64_t time;
+	ReplayEventKind kind;
+	uint32_t width;
+	uint32_t height;
+	int64_t busy;						// VR frames only.
+};
+
+// Parses a trace as above, expanding the runs.  On a bad line, returns false
+// with the line number and what was wrong in error.
+
+inline bool ParseReplayTrace(FILE* file, std::vector<ReplayEvent>* events, std::string* error)
+{
+	char line[256];
+	for (int lineNumber = 1; fgets(line, sizeof(line), file); lineNumber++)
+	{
+		char* comment = strchr(line, '#');
+		if (comment != nullptr)
+			*comment = '\0';
+
+		long long time = 0, count = 0, period = 0, busy = 0;
+		unsigned width = 0, height = 0;
+		char name[32] = "";
+		int fields = sscanf(line, "%lld %31s", &time, name);
+		if (fields <= 0)
+			continue;
+
+		const char* args = line;
+		for (int skip = 0; skip < 2 && *args; skip++)
+		{
+			args += strspn(args, " \t");
+			args += strcspn(args, " \t\r\n");
+		}
+
+		bool ok = (fields == 2 && time >= 0);
+		bool sized = (strcmp(name, "present") == 0 || strcmp(name, "resize") == 0 || strcmp(name, "reset") == 0);
+		ReplayEvent event = { time, kReplayPresent, 0, 0, 0 };
+		if (!ok)
+		{
+			strcpy(name, "?");
+		}
+		else if (sized)
+		{
+			event.kind = (strcmp(name, "present") == 0) ? kReplayPresent :
+				(strcmp(name, "resize") == 0) ? kReplayResize : kReplayReset;
+			ok = sscanf(args, "%u %u", &width, &height) == 2 && width > 0 && height > 0;
+			event.width = width;
+			event.height = height;
+			events->push_back(event);
+		}
+		else if (strcmp(name, "resize-fail") == 0 || strcmp(name, "recreate") == 0)
+		{
+			event.kind = (strcmp(name, "recreate") == 0) ? kReplayRecreate : kReplayResizeFail;
+			events->push_back(event);
+		}
+		else if (strcmp(name, "vrframe") == 0)
+		{
+			event.kind = kReplayVRFrame;
+			ok = sscanf(args, "%lld", &busy) == 1 && busy >= 0;
+			event.busy = busy;
+			events->push_back(event);
+		}
+		else if (strcmp(name, "presents") == 0)
+		{
+			ok = sscanf(args, "%lld %lld %u %u", &count, &period, &width, &height) == 4 &&
+				count > 0 && period > 0 && width > 0 && height > 0;
+			for (long long i = 0; ok && i < count; i++)
+			{
+				ReplayEvent present = { time + i * period, kReplayPresent, width, height, 0 };
+				events->push_back(present);
+			}
+		}
+		else if (strcmp(name, "vrframes") == 0)
+		{
+			ok = sscanf(args, "%lld %lld %lld", &count, &period, &busy) == 3 && count > 0 && period > 0 && busy >= 0;
+			for (long long i = 0; ok && i < count; i++)
+			{
+				ReplayEvent frame = { time + i * period, kReplayVRFrame, 0, 0, busy };
+				events->push_back(frame);
+			}
+		}
+		else
+		{
+			ok = false;
+		}
+
+		if (!ok)
+		{
+			*error = "line " + std::to_string(lineNumber) + ": bad event '" + name + "'";
+			return false;
+		}
+	}
+
+	// Stable, so events at the same time stay in the order they were written.
+	std::stable_sort(events->begin(), events->end(),
+		[](const ReplayEvent& a, const ReplayEvent& b) { return a.time < b.time; });
+	return true;
+}
+
+
+// The backbuffer, all the fake device needs of it.
+
+struct ReplaySource
+{
+	uint32_t width;
+	uint32_t height;
+};
+
+class ReplayDevice : public SharedSurfaceDevice<ReplaySource>
+{
+public:
+	ReplayDevice(int64_t createMicros, const KatangaSharedDescriptor* shared)
+		: createMicros(createMicros), shared(shared)
+	{
+	}
+
+	uint32_t CreateSurfaces(ReplaySource* source, uint32_t* slotHandles, uint32_t maxSlots, SharedSurfaceDesc* desc) override
+	{
+		if (setupDepth == 0)
+			violations++;
+
+		// A set that was never released is a leak.
+		if (staleCount != 0)
+			violations++;
+		staleFirst = liveFirst;
+		staleCount = liveCount;
+
+		liveFirst = nextHandle;
+		liveCount = maxSlots;
+		for (uint32_t i = 0; i < maxSlots; i++)
+			slotHandles[i] = nextHandle++;
+		now += createMicros * maxSlots;
+
+		uint32_t alive = liveCount + staleCount;
+		if (alive > peakAlive)
+			peakAlive = alive;
+
+		desc->width = source->width * 2;
+		desc->height = source->height;
+		desc->format = 28;						// DXGI_FORMAT_R8G8B8A8_UNORM
+		desc->layout = kLayoutSideBySide;
+		return maxSlots;
+	}
+
+	void ReleaseStaleSurfaces() override
+	{
+		if (setupDepth == 0 && shared->sharedHandle >= staleFirst && shared->sharedHandle < staleFirst + staleCount)
+			violations++;
+		staleCount = 0;
+	}
+
+	// Waits out a VR frame that began before the lock was taken.
+	void BeginSetup() override
+	{
+		if (setupDepth++ == 0 && vrBusyUntil > now)
+		{
+			waitedForVR += vrBusyUntil - now;
+			now = vrBusyUntil;
+		}
+	}
+
+	void EndSetup() override
+	{
+		setupDepth--;
+	}
+
+	bool TryBeginSetup() override
+	{
+		if (setupDepth == 0 && vrBusyUntil > now)
+			return false;
+		setupDepth++;
+		return true;
+	}
+
+	void NotifyConsumer() override
+	{
+		notifies++;
+	}
+
+	int64_t Now() override
+	{
+		return now;
+	}
+
+	// Replay side.
+
+	void AdvanceTo(int64_t time)
+	{
+		if (time > now)
+			now = time;
+	}
+
+	// A VR frame wanting to begin at time.  The game side holds the lock only
+	// inside one event, so if our clock is past it, setup was in the way.
+	// Returns when it began.
+	int64_t VRFrame(int64_t time, int64_t busy)
+	{
+		if (now > time)
+			vrLockedOut++;
+		int64_t begin = std::max(time, now);
+		vrBusyUntil = begin + busy;
+		return begin;
+	}
+
+	bool IsAlive(uint32_t handle) const
+	{
+		return (handle >= liveFirst && handle < liveFirst + liveCount) ||
+			(handle >= staleFirst && handle < staleFirst + staleCount);
+	}
+
+	uint32_t PeakAlive() const { return peakAlive; }
+	uint64_t Violations() const { return violations; }
+	uint64_t Notifies() const { return notifies; }
+	uint64_t VRLockedOut() const { return vrLockedOut; }
+	int64_t WaitedForVR() const { return waitedForVR; }
+
+private:
+	int64_t createMicros;
+	const KatangaSharedDescriptor* shared;
+	int64_t now = 0;
+	int setupDepth = 0;
+
+	uint32_t nextHandle = 0x100;
+	uint32_t liveFirst = 0;
+	uint32_t liveCount = 0;
+	uint32_t staleFirst = 0;
+	uint32_t staleCount = 0;
+	uint32_t peakAlive = 0;
+
+	int64_t vrBusyUntil = 0;
+	uint64_t vrLockedOut = 0;
+	int64_t waitedForVR = 0;
+	uint64_t violations = 0;
+	uint64_t notifies = 0;
+};
+
+
+struct ReplayReport
+{
+	uint64_t presents;
+	uint64_t rebuilds;					// Resizes, resets and recreates.
+	uint64_t deferredReplaces;			// Presents a recreate had to wait for.
+	uint64_t setups;					// Times the setup lock was taken.
+	uint64_t surfaceCreates;			// Handles made, the churn.
+	uint64_t vrFrames;
+	uint64_t vrLockedOut;
+	uint64_t violations;
+	uint32_t peakAlive;					// Most surfaces alive at once.
+
+	int64_t totalSetupMicros;			// Setup lock held, over all setups.
+	int64_t maxSetupMicros;
+	int64_t waitedForVRMicros;			// Of that, waiting on VR frames.
+
+	uint64_t staleWindows;				// Retractions, each a grey window on the HMD.
+	int64_t totalStaleMicros;
+	int64_t maxStaleMicros;
+	uint64_t presentsWithoutSurface;	// Frames the VR side never got.
+
+	double AverageSetupMs() const { return setups ? totalSetupMicros / 1000.0 / setups : 0; }
+	double AverageStaleMs() const { return staleWindows ? totalStaleMicros / 1000.0 / staleWindows : 0; }
+};
+
+inline ReplayReport ReplaySurfaceTrace(const std::vector<ReplayEvent>& events, int64_t createMicros)
+{
+	ReplayReport report = {};
+	KatangaSharedDescriptor shared = {};
+	ReplayDevice device(createMicros, &shared);
+	SharedSurfaceLifecycle<ReplaySource> lifecycle(&device);
+	ReplaySource source = { 0, 0 };
+
+	uint64_t lastCreates = 0;
+	bool retracted = false;
+	bool replacing = false;
+
+	for (const ReplayEvent& event : events)
+	{
+		device.AdvanceTo(event.time);
+		bool setup = true;
+
+		switch (event.kind)
+		{
+			case kReplayPresent:
+				report.presents++;
+				source.width = event.width;
+				source.height = event.height;
+				lifecycle.OnPresent(&source, &shared);
+				if (replacing && lifecycle.IsReady())
+					replacing = !lifecycle.Replace(&source, &shared);
+				if (shared.sharedHandle == 0)
+					report.presentsWithoutSurface++;
+				else
+					KatangaPublishFrame(&shared, device.Now());
+				setup = (lifecycle.SurfaceCreates() != lastCreates);
+				break;
+
+			case kReplayResize:
+			case kReplayReset:
+			case kReplayResizeFail:
+			{
+				report.rebuilds++;
+				bool succeeded = (event.kind != kReplayResizeFail);
+				if (succeeded)
+				{
+					source.width = event.width;
+					source.height = event.height;
+				}
+				lifecycle.BeginResize(&shared);
+				retracted = true;
+				lifecycle.EndResize(&source, &shared, succeeded);
+				break;
+			}
+
+			case kReplayRecreate:
+				report.rebuilds++;
+				replacing = lifecycle.IsReady() && !lifecycle.Replace(&source, &shared);
+				setup = (lifecycle.SurfaceCreates() != lastCreates);
+				break;
+
+			case kReplayVRFrame:
+			{
+				report.vrFrames++;
+				int64_t begin = device.VRFrame(event.time, event.busy);
+				if (shared.sharedHandle != 0)
+					KatangaConsumerSampled(&shared, begin);
+				setup = false;
+				break;
+			}
+		}
+
+		if (setup)
+		{
+			report.setups++;
+			report.totalSetupMicros += lifecycle.LastSetupTicks();
+		}
+
+		// The lifecycle only measures a stale window when it closes.
+		if (retracted && shared.sharedHandle != 0)
+		{
+			retracted = false;
+			int64_t lastStale = lifecycle.LastStaleTicks();
+			report.staleWindows++;
+			report.totalStaleMicros += lastStale;
+			report.maxStaleMicros = std::max(report.maxStaleMicros, lastStale);
+		}
+		lastCreates = lifecycle.SurfaceCreates();
+
+		// Whatever is published must still be alive.
+		for (uint32_t i = 0; shared.sharedHandle != 0 && i < shared.slotCount; i++)
+		{
+			if (!device.IsAlive(shared.slotHandles[i]))
+				report.violations++;
+		}
+	}
+
+	report.surfaceCreates = lifecycle.SurfaceCreates();
+	report.deferredReplaces = lifecycle.DeferredReplaces();
+	report.maxSetupMicros = lifecycle.MaxSetupTicks();
+	report.waitedForVRMicros = device.WaitedForVR();
+	report.vrLockedOut = device.VRLockedOut();
+	report.peakAlive = device.PeakAlive();
+	report.violations += device.Violations();
+	if (report.peakAlive > 2 * kKatangaMaxSlots)
+		report.violations++;
+	return report;
+}
@@ -0,0 +1,479 @@
+#pragma once
+
+//-----------------------------------------------------------
+// Where FrameCapture sends the frames.  All of them run on its writer thread.
+//
+// RawCaptureSink appends the bare pixels of every frame to one file, rows
+// packed with no pitch, which is what a video encoder takes as rawvideo.  A
+// small .txt next to it gives the size and format to tell the encoder.
+//
+// PngCaptureSink writes each frame to its own numbered file, as a stereo .pns
+// for side by side frames, right eye on the left like a .jps, which is what
+// 3D Vision Photo Viewer and most stereo tools read.  A .jps would need a JPEG
+// encoder we don't have, PNG only needs zlib's stored blocks, CRC and Adler,
+// so it's written with no compression and no dependencies.  Anything else is
+// a plain .png.  Only 8 bit RGBA and BGRA formats, alpha is dropped.
+//
+// MemoryRingCaptureSink writes into a ring of frames in memory the caller
+// provides, for RenderAPI_D3D11 a named file mapping, so that a recorder or
+// streamer in another process can read the latest frame with no copy through
+// us.  Each slot has a seqlock style sequence, the layout is CaptureRingHeader.
+//
+// Files are opened through a CaptureOpenFunc, so Windows can use wide paths.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "FrameCapture.h"
+#include "../DeviarePlugin/KatangaIPC.h"
+
+
+// What StartCapture takes, and the name of the shared memory for the ring.
+enum CaptureSinkType
+{
+	kCaptureSinkRaw = 0,
+	kCaptureSinkPng = 1,
+	kCaptureSinkSharedMemory = 2,
+};
+
+#define KATANGA_CAPTURE_RING_NAME L"Local\\KatangaCaptureRing"
+
+
+// Opens a file for binary writing, path is UTF-8.
+typedef FILE* (*CaptureOpenFunc)(const char* path);
+
+inline FILE* CaptureOpenFile(const char* path)
+{
+	return fopen(path, "wb");
+}
+
+
+// 89 is R10G10B10_XR_BIAS_A2, in between the BGRA ones.
+inline bool CaptureIs8Bit(uint32_t format)
+{
+	return (format >= kCaptureR8G8B8A8Typeless && format <= kCaptureR8G8B8A8Srgb) ||
+		(format >= kCaptureB8G8R8A8Unorm && format <= kCaptureB8G8R8X8Srgb && format != 89);
+}
+
+inline bool CaptureIsBGR(uint32_t format)
+{
+	return format >= kCaptureB8G8R8A8Unorm;
+}
+
+
+// --------------------------------------------------------------------------
+
+class RawCaptureSink : public CaptureSink
+{
+public:
+	RawCaptureSink(const std::string& path, CaptureOpenFunc open = CaptureOpenFile)
+		: path(path), open(open) { }
+
+	bool Write(const CaptureFrame& frame) override
+	{
+		size_t rowBytes = (size_t)frame.width * CaptureBytesPerPixel(frame.format);
+		if (file == nullptr)
+		{
+			if (!Begin(frame, rowBytes))
+				return false;
+		}
+		else if (frame.width != width || frame.height != height || frame.format != format)
+		{
+			// The file has no framing, a new size would garble the rest.
+			return false;
+		}
+
+		for (uint32_t y = 0; y < frame.height; y++)
+		{
+			if (fwrite(frame.pixels + (size_t)y * frame.pitch, 1, rowBytes, file) != rowBytes)
+				return false;
+		}
+		return true;
+	}
+
+	void Close() override
+	{
+		if (file != nullptr)
+			fclose(file);
+		file = nullptr;
+	}
+
+private:
+	bool Begin(const CaptureFrame& frame, size_t rowBytes)
+	{
+		file = open(path.c_str());
+		if (file == nullptr)
+			return false;
+		width = frame.width;
+		height = frame.height;
+		format = frame.format;
+
+		// Big enough to batch many rows per actual write.
+		setvbuf(file, nullptr, _IOFBF, 4 * 1024 * 1024);
+
+		FILE* info = open((path + ".txt").c_str());
+		if (info != nullptr)
+		{
+			fprintf(info, "width=%u height=%u format=%u layout=%u bytesPerRow=%u pixel=%s\n",
+				width, height, format, frame.layout, (uint32_t)rowBytes,
+				!CaptureIs8Bit(format) ? "other" : CaptureIsBGR(format) ? "bgra" : "rgba");
+			fclose(info);
+		}
+		return true;
+	}
+
+	std::string path;
+	CaptureOpenFunc open;
+	FILE* file = nullptr;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint32_t format = 0;
+};
+
+
+// --------------------------------------------------------------------------
+
+class PngCaptureSink : public CaptureSink
+{
+public:
+	// Files are prefix + frame number + .pns or .png.
+	PngCaptureSink(const std::string& prefix, CaptureOpenFunc open = CaptureOpenFile)
+		: prefix(prefix), open(open) { }
+
+	bool Write(const CaptureFrame& frame) override
+	{
+		if (!CaptureIs8Bit(frame.format) || frame.width == 0 || frame.height == 0)
+			return false;
+
+		bool stereo = (frame.layout == kLayoutSideBySide || frame.layout == kLayoutSideBySideSwapped);
+		char name[32];
+		snprintf(name, sizeof(name), "%06llu.%s", (unsigned long long)frame.index, stereo ? "pns" : "png");
+
+		FILE* file = open((prefix + name).c_str());
+		if (file == nullptr)
+			return false;
+		bool ok = WritePng(file, frame, frame.layout == kLayoutSideBySideSwapped);
+		ok = (fclose(file) == 0) && ok;
+		return ok;
+	}
+
+	static uint32_t Crc32(uint32_t crc, const uint8_t* data, size_t length)
+	{
+		static const CrcTable table;
+		crc = ~crc;
+		for (size_t i = 0; i < length; i++)
+			crc = table.entries[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+		return ~crc;
+	}
+
+	static uint32_t Adler32(uint32_t adler, const uint8_t* data, size_t length)
+	{
+		const uint32_t kBase = 65521;
+		const size_t kMaxRun = 5552;			// Longest run with no overflow.
+		uint32_t a = adler & 0xFFFF, b = adler >> 16;
+		while (length > 0)
+		{
+			size_t run = (length < kMaxRun) ? length : kMaxRun;
+			length -= run;
+			for (size_t i = 0; i < run; i++)
+			{
+				a += *data++;
+				b += a;
+			}
+			a %= kBase;
+			b %= kBase;
+		}
+		return (b << 16) | a;
+	}
+
+private:
+	struct CrcTable
+	{
+		uint32_t entries[256];
+
+		CrcTable()
+		{
+			for (uint32_t n = 0; n < 256; n++)
+			{
+				uint32_t c = n;
+				for (int k = 0; k < 8; k++)
+					c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+				entries[n] = c;
+			}
+		}
+	};
+
+	// Each stored deflate block is its own IDAT chunk, so the image streams
+	// out with only one block of memory, and the file ends with an empty final
+	// block and the Adler of everything.
+
+	static const size_t kBlockBytes = 65535;
+
+	bool WritePng(FILE* file, const CaptureFrame& frame, bool swapHalves)
+	{
+		static const uint8_t kSignature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+		if (fwrite(kSignature, 1, sizeof(kSignature), file) != sizeof(kSignature))
+			return false;
+
+		uint8_t header[13];
+		Put32(header, frame.width);
+		Put32(header + 4, frame.height);
+		header[8] = 8;					// Bits per channel.
+		header[9] = 2;					// RGB.
+		header[10] = header[11] = header[12] = 0;
+		if (!Chunk(file, "IHDR", header, sizeof(header)))
+			return false;
+
+		block.clear();
+		block.reserve(kBlockBytes);
+		adler = 1;
+		firstBlock = true;
+
+		row.resize(1 + (size_t)frame.width * 3);
+		for (uint32_t y = 0; y < frame.height; y++)
+		{
+			ConvertRow(frame, y, swapHalves);
+			if (!Deflate(file, row.data(), row.size()))
+				return false;
+		}
+		if (!Flush(file, true))
+			return false;
+
+		return Chunk(file, "IEND", nullptr, 0);
+	}
+
+	// Filter type 0, then RGB.
+	void ConvertRow(const CaptureFrame& frame, uint32_t y, bool swapHalves)
+	{
+		const uint8_t* source = frame.pixels + (size_t)y * frame.pitch;
+		bool bgr = CaptureIsBGR(frame.format);
+		uint32_t half = frame.width / 2;
+
+		uint8_t* out = row.data();
+		*out++ = 0;
+		for (uint32_t x = 0; x < frame.width; x++)
+		{
+			uint32_t from = !swapHalves ? x : (x < half) ? x + half : x - half;
+			const uint8_t* pixel = source + (size_t)from * 4;
+			out[0] = bgr ? pixel[2] : pixel[0];
+			out[1] = pixel[1];
+			out[2] = bgr ? pixel[0] : pixel[2];
+			out += 3;
+		}
+	}
+
+	bool Deflate(FILE* file, const uint8_t* data, size_t length)
+	{
+		adler = Adler32(adler, data, length);
+		while (length > 0)
+		{
+			size_t room = kBlockBytes - block.size();
+			size_t take = (length < room) ? length : room;
+			block.insert(block.end(), data, data + take);
+			data += take;
+			length -= take;
+			if (block.size() == kBlockBytes && !Flush(file, false))
+				return false;
+		}
+		return true;
+	}
+
+	bool Flush(FILE* file, bool last)
+	{
+		std::vector<uint8_t>& chunk = chunkData;
+		chunk.clear();
+		if (firstBlock)
+		{
+			chunk.push_back(0x78);		// Deflate, 32K window.
+			chunk.push_back(0x01);		// No preset dictionary, check bits.
+			firstBlock = false;
+		}
+
+		uint16_t length = (uint16_t)block.size();
+		chunk.push_back(last ? 1 : 0);
+		chunk.push_back((uint8_t)(length & 0xFF));
+		chunk.push_back((uint8_t)(length >> 8));
+		chunk.push_back((uint8_t)(~length & 0xFF));
+		chunk.push_back((uint8_t)((uint16_t)~length >> 8));
+		chunk.insert(chunk.end(), block.begin(), block.end());
+		block.clear();
+
+		if (last)
+		{
+			uint8_t check[4];
+			Put32(check, adler);
+			chunk.insert(chunk.end(), check, check + 4);
+		}
+		return Chunk(file, "IDAT", chunk.data(), chunk.size());
+	}
+
+	static void Put32(uint8_t* out, uint32_t value)
+	{
+		out[0] = (uint8_t)(value >> 24);
+		out[1] = (uint8_t)(value >> 16);
+		out[2] = (uint8_t)(value >> 8);
+		out[3] = (uint8_t)value;
+	}
+
+	static bool Chunk(FILE* file, const char* type, const uint8_t* data, size_t length)
+	{
+		uint8_t prefix[8];
+		Put32(prefix, (uint32_t)length);
+		memcpy(prefix + 4, type, 4);
+		uint32_t crc = Crc32(0, prefix + 4, 4);
+		crc = Crc32(crc, data, length);
+		uint8_t suffix[4];
+		Put32(suffix, crc);
+
+		return fwrite(prefix, 1, 8, file) == 8 &&
+			(length == 0 || fwrite(data, 1, length, file) == length) &&
+			fwrite(suffix, 1, 4, file) == 4;
+	}
+
+	std::string prefix;
+	CaptureOpenFunc open;
+
+	std::vector<uint8_t> row;
+	std::vector<uint8_t> block;
+	std::vector<uint8_t> chunkData;
+	uint32_t adler = 1;
+	bool firstBlock = true;
+};
+
+
+// --------------------------------------------------------------------------
+// The shared ring.  The header, then slotCount slots of slotStride bytes, each
+// a CaptureRingSlot followed by the pixels, rows packed.  written counts the
+// frames, the latest is in slot (written - 1) % slotCount.  A slot's sequence
+// is odd while we are writing it, a reader copies the frame out and keeps it
+// only if the sequence was the same even number before and after.
+
+const uint32_t kCaptureRingMagic = 0x5041434B;		// "KCAP" in memory.
+const uint32_t kCaptureRingVersion = 1;
+
+struct alignas(64) CaptureRingHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t slotCount;
+	uint32_t slotStride;
+	uint64_t pixelBytes;			// Room for pixels in each slot.
+	std::atomic<uint64_t> written;
+};
+
+struct alignas(64) CaptureRingSlot
+{
+	std::atomic<uint64_t> sequence;
+	uint32_t width;
+	uint32_t height;
+	uint32_t rowBytes;
+	uint32_t format;
+	uint32_t layout;
+	uint32_t reserved;
+	uint64_t index;
+	int64_t timestamp;
+};
+
+inline size_t CaptureRingSize(uint32_t slotCount, uint64_t pixelBytes)
+{
+	size_t stride = (size_t)((sizeof(CaptureRingSlot) + pixelBytes + 63) & ~(uint64_t)63);
+	return sizeof(CaptureRingHeader) + stride * slotCount;
+}
+
+// Copies out the latest frame, if it fits in pixels.  Returns false if there
+// is none yet, or it was overwritten while we copied, then just try again.
+
+inline bool CaptureRingRead(const void* memory, CaptureRingSlot* info, uint8_t* pixels, size_t size)
+{
+	const CaptureRingHeader* header = static_cast<const CaptureRingHeader*>(memory);
+	if (header->magic != kCaptureRingMagic || header->version != kCaptureRingVersion || header->slotCount == 0)
+		return false;
+	uint64_t written = header->written.load(std::memory_order_acquire);
+	if (written == 0)
+		return false;
+
+	const uint8_t* base = static_cast<const uint8_t*>(memory) + sizeof(CaptureRingHeader) +
+		(size_t)((written - 1) % header->slotCount) * header->slotStride;
+	const CaptureRingSlot* slot = reinterpret_cast<const CaptureRingSlot*>(base);
+
+	uint64_t before = slot->sequence.load(std::memory_order_acquire);
+	if (before & 1)
+		return false;
+	info->width = slot->width;
+	info->height = slot->height;
+	info->rowBytes = slot->rowBytes;
+	info->format = slot->format;
+	info->layout = slot->layout;
+	info->index = slot->index;
+	info->timestamp = slot->timestamp;
+	size_t bytes = (size_t)info->rowBytes * info->height;
+	if (bytes > size || bytes > header->pixelBytes)
+		return false;
+	memcpy(pixels, base + sizeof(CaptureRingSlot), bytes);
+	std::atomic_thread_fence(std::memory_order_acquire);
+	return slot->sequence.load(std::memory_order_relaxed) == before;
+}
+
+class MemoryRingCaptureSink : public CaptureSink
+{
+public:
+	// memory must be at least CaptureRingSize(slotCount, pixelBytes), zeroed,
+	// and stay valid until this sink is gone.
+
+	MemoryRingCaptureSink(void* memory, uint32_t slotCount, uint64_t pixelBytes)
+		: memory(static_cast<uint8_t*>(memory))
+	{
+		header = new (memory) CaptureRingHeader();
+		header->slotCount = slotCount;
+		header->slotStride = (uint32_t)((CaptureRingSize(1, pixelBytes) - sizeof(CaptureRingHeader)));
+		header->pixelBytes = pixelBytes;
+		for (uint32_t i = 0; i < slotCount; i++)
+			new (Slot(i)) CaptureRingSlot();
+		header->version = kCaptureRingVersion;
+		std::atomic_thread_fence(std::memory_order_release);
+		header->magic = kCaptureRingMagic;
+	}
+
+	bool Write(const CaptureFrame& frame) override
+	{
+		size_t rowBytes = (size_t)frame.width * CaptureBytesPerPixel(frame.format);
+		if (rowBytes * frame.height > header->pixelBytes || header->slotCount == 0)
+			return false;
+
+		uint64_t count = header->written.load(std::memory_order_relaxed);
+		CaptureRingSlot* slot = Slot((uint32_t)(count % header->slotCount));
+
+		uint64_t sequence = slot->sequence.load(std::memory_order_relaxed);
+		slot->sequence.store(sequence + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		slot->width = frame.width;
+		slot->height = frame.height;
+		slot->rowBytes = (uint32_t)rowBytes;
+		slot->format = frame.format;
+		slot->layout = frame.layout;
+		slot->index = frame.index;
+		slot->timestamp = frame.timestamp;
+		uint8_t* pixels = reinterpret_cast<uint8_t*>(slot) + sizeof(CaptureRingSlot);
+		for (uint32_t y = 0; y < frame.height; y++)
+			memcpy(pixels + y * rowBytes, frame.pixels + (size_t)y * frame.pitch, rowBytes);
+
+		slot->sequence.store(sequence + 2, std::memory_order_release);
+		header->written.store(count + 1, std::memory_order_release);
+		return true;
+	}
+
+private:
+	CaptureRingSlot* Slot(uint32_t i)
+	{
+		return reinterpret_cast<CaptureRingSlot*>(memory + sizeof(CaptureRingHeader) + (size_t)i * header->slotStride);
+	}
+
+	uint8_t* memory;
+	CaptureRingHeader* header;
+};
@@ -0,0 +1,482 @@
+#pragma once
+
+//-----------------------------------------------------------
+// Reads game frames back to the CPU, for recording, screenshots or streaming,
+// without ever waiting on the GPU.
+//
+// The game frame only exists as a shared texture.  Copying it to a staging
+// texture and mapping that right away would stall the render thread until the
+// GPU got through the copy, which is most of a frame.  So there is a ring of
+// kSlots staging textures.  Each captured frame is copied into a free one, and
+// on the following frames we try to map it with DO_NOT_WAIT, oldest first,
+// until the GPU is done with it.
+//
+// A mapped slot is handed as is to the writer thread, which gives the mapped
+// memory straight to the CaptureSink, so frames are never copied on the CPU
+// before the sink.  When the sink is done, the render thread unmaps the slot on
+// its next frame, and it is free again.  If no slot is free, because the sink
+// can't keep up, that frame is dropped and counted, the game is never held up.
+//
+// Map and Unmap are on the immediate context, which belongs to Unity's render
+// thread, so OnFrame and Shutdown must only be called there.  Request can come
+// from any thread, and is picked up at the next OnFrame.
+//
+// The graphics API is behind CaptureDevice, which RenderAPI_D3D11 implements,
+// so a synthetic frame source can stand in.  The sinks are in CaptureSinks.h.
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+
+// The few DXGI_FORMAT values we need to tell apart, from dxgiformat.h.
+enum CaptureFormat : uint32_t
+{
+	kCaptureR32G32B32A32Float = 2,
+	kCaptureR16G16B16A16First = 9,		// TYPELESS through SINT.
+	kCaptureR16G16B16A16Last = 14,
+	kCaptureR8G8B8A8Typeless = 27,
+	kCaptureR8G8B8A8Unorm = 28,
+	kCaptureR8G8B8A8Srgb = 29,
+	kCaptureB8G8R8A8Unorm = 87,
+	kCaptureB8G8R8X8Unorm = 88,
+	kCaptureB8G8R8A8Typeless = 90,
+	kCaptureB8G8R8A8Srgb = 91,
+	kCaptureB8G8R8X8Typeless = 92,
+	kCaptureB8G8R8X8Srgb = 93,
+};
+
+inline uint32_t CaptureBytesPerPixel(uint32_t format)
+{
+	if (format == kCaptureR32G32B32A32Float)
+		return 16;
+	if (format >= kCaptureR16G16B16A16First && format <= kCaptureR16G16B16A16Last)
+		return 8;
+	return 4;
+}
+
+
+// One captured frame.  pixels stays valid only until the sink's Write returns.
+struct CaptureFrame
+{
+	const uint8_t* pixels;
+	uint32_t pitch;
+	uint32_t width;
+	uint32_t height;
+	uint32_t format;				// DXGI_FORMAT of the game surface.
+	uint32_t layout;				// KatangaStereoLayout.
+	uint64_t index;					// Counts captured frames, from 0.
+	int64_t timestamp;				// QueryPerformanceCounter ticks at the copy.
+};
+
+class CaptureSink
+{
+public:
+	virtual ~CaptureSink() { }
+
+	// Called on the writer thread only, one frame at a time, in order.
+	virtual bool Write(const CaptureFrame& frame) = 0;
+	virtual void Close() { }
+};
+
+
+enum CaptureMap
+{
+	kCaptureMapPending,				// GPU still busy with the copy.
+	kCaptureMapReady,
+	kCaptureMapFailed,
+};
+
+class CaptureDevice
+{
+public:
+	virtual ~CaptureDevice() { }
+
+	// Makes count staging copies of the current source, dropping any old ones.
+	virtual bool CreateStaging(int count, uint32_t width, uint32_t height, uint32_t format) = 0;
+	virtual void ReleaseStaging() = 0;
+
+	// Queues the GPU copy of the current source into a staging slot.
+	virtual bool Copy(int slot) = 0;
+
+	// Maps a slot without waiting, and stays mapped until Unmap.
+	virtual CaptureMap TryMap(int slot, const uint8_t** pixels, uint32_t* pitch) = 0;
+	virtual void Unmap(int slot) = 0;
+};
+
+
+// What the source looks like this frame.
+struct CaptureSource
+{
+	uint32_t width;
+	uint32_t height;
+	uint32_t format;
+	uint32_t layout;
+	int64_t timestamp;
+};
+
+struct CaptureStats
+{
+	uint64_t written;				// Frames the sink took.
+	uint64_t dropped;				// No free slot, or waiting to resize.
+	uint64_t failed;				// Copy, Map or the sink failed.
+	uint64_t bytes;					// Pixel bytes handed to the sink.
+	int64_t writeNs;				// Time spent in the sink.
+	int64_t elapsedNs;				// Since the capture started.
+};
+
+// For GetCaptureStat.
+enum CaptureStat
+{
+	kCaptureStatWritten,
+	kCaptureStatDropped,
+	kCaptureStatFailed,
+	kCaptureStatMBPerSecond,		// Into the sink, since the start.
+	kCaptureStatWriteMs,			// Average sink time per frame.
+	kCaptureStatCount
+};
+
+inline double CaptureStatValue(const CaptureStats& stats, int stat)
+{
+	switch (stat)
+	{
+	case kCaptureStatWritten: return (double)stats.written;
+	case kCaptureStatDropped: return (double)stats.dropped;
+	case kCaptureStatFailed: return (double)stats.failed;
+	case kCaptureStatMBPerSecond:
+		return (stats.elapsedNs > 0) ? (double)stats.bytes / (1024.0 * 1024.0) * 1e9 / (double)stats.elapsedNs : 0;
+	case kCaptureStatWriteMs:
+		return (stats.written > 0) ? (double)stats.writeNs / 1e6 / (double)stats.written : 0;
+	default: return 0;
+	}
+}
+
+
+class FrameCapture
+{
+public:
+	// Two frames in flight on the GPU, two with the sink, is enough for the
+	// GPU to always finish a copy before we come back to map it.
+	static const int kSlots = 4;
+
+	FrameCapture() { }
+
+	// Same as RowPool, a joinable std::thread at process exit would terminate.
+	~FrameCapture()
+	{
+		if (writer.joinable())
+			writer.detach();
+	}
+
+	FrameCapture(const FrameCapture&) = delete;
+	FrameCapture& operator=(const FrameCapture&) = delete;
+
+	// Starts capturing every interval'th frame into sink, which we then own, or
+	// stops with a nullptr sink.  Any thread, takes effect at the next OnFrame.
+
+	void Request(CaptureSink* sink, uint32_t interval)
+	{
+		std::lock_guard<std::mutex> guard(requestLock);
+		delete pendingSink;
+		pendingSink = sink;
+		pendingInterval = (interval > 0) ? interval : 1;
+		requested.store(true, std::memory_order_release);
+	}
+
+	bool Active() const { return sink != nullptr; }
+
+	// Once per frame on the render thread.  The device's source is what gets
+	// copied, source only describes it.
+
+	void OnFrame(CaptureDevice* device, const CaptureSource& source)
+	{
+		if (requested.load(std::memory_order_acquire))
+			ApplyRequest(device);
+		if (sink == nullptr)
+			return;
+
+		Reclaim(device);
+		PollCopies(device);
+
+		if (frameCount++ % interval != 0)
+			return;
+
+		if (!EnsureStaging(device, source))
+		{
+			dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+
+		int slot = -1;
+		for (int i = 0; i < kSlots && slot < 0; i++)
+		{
+			if (slots[i].state.load(std::memory_order_acquire) == kSlotFree)
+				slot = i;
+		}
+		if (slot < 0)
+		{
+			dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		if (!device->Copy(slot))
+		{
+			failed.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+
+		Slot& copied = slots[slot];
+		copied.frame = CaptureFrame{ nullptr, 0, source.width, source.height, source.format, source.layout,
+			captureCount++, source.timestamp };
+		copied.copySequence = ++copySequence;
+		copied.state.store(kSlotCopied, std::memory_order_relaxed);
+	}
+
+	// At device shutdown, on the render thread.  Whatever the sink already has
+	// is still written out.
+
+	void Shutdown(CaptureDevice* device)
+	{
+		Request(nullptr, 1);
+		ApplyRequest(device);
+	}
+
+	CaptureStats Stats() const
+	{
+		CaptureStats stats;
+		stats.written = written.load(std::memory_order_relaxed);
+		stats.dropped = dropped.load(std::memory_order_relaxed);
+		stats.failed = failed.load(std::memory_order_relaxed);
+		stats.bytes = bytes.load(std::memory_order_relaxed);
+		stats.writeNs = writeNs.load(std::memory_order_relaxed);
+		int64_t started = startedNs.load(std::memory_order_relaxed);
+		stats.elapsedNs = (started != 0) ? Now() - started : 0;
+		return stats;
+	}
+
+private:
+	enum SlotState
+	{
+		kSlotFree,
+		kSlotCopied,				// Copy queued, waiting for the GPU.
+		kSlotWriting,				// Mapped, owned by the writer thread.
+		kSlotWritten,				// Writer done, needs Unmap.
+	};
+
+	struct Slot
+	{
+		std::atomic<int> state{ kSlotFree };
+		CaptureFrame frame;
+		uint64_t copySequence = 0;
+	};
+
+	static int64_t Now()
+	{
+		return (int64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	void ApplyRequest(CaptureDevice* device)
+	{
+		CaptureSink* next;
+		uint32_t nextInterval;
+		{
+			std::lock_guard<std::mutex> guard(requestLock);
+			next = pendingSink;
+			nextInterval = pendingInterval;
+			pendingSink = nullptr;
+			requested.store(false, std::memory_order_relaxed);
+		}
+
+		StopSink(device);
+		if (next == nullptr)
+			return;
+
+		sink = next;
+		interval = nextInterval;
+		frameCount = 0;
+		captureCount = 0;
+		written.store(0, std::memory_order_relaxed);
+		dropped.store(0, std::memory_order_relaxed);
+		failed.store(0, std::memory_order_relaxed);
+		bytes.store(0, std::memory_order_relaxed);
+		writeNs.store(0, std::memory_order_relaxed);
+		startedNs.store(Now(), std::memory_order_relaxed);
+
+		stopping = false;
+		writer = std::thread(&FrameCapture::WriterThread, this);
+	}
+
+	// Lets the writer finish what it has, then unmaps everything.
+	void StopSink(CaptureDevice* device)
+	{
+		if (sink == nullptr)
+			return;
+
+		{
+			std::lock_guard<std::mutex> guard(queueLock);
+			stopping = true;
+		}
+		queueReady.notify_one();
+		writer.join();
+
+		for (Slot& slot : slots)
+		{
+			if (slot.state.load(std::memory_order_acquire) == kSlotWritten)
+				device->Unmap((int)(&slot - slots));
+			slot.state.store(kSlotFree, std::memory_order_relaxed);
+		}
+		device->ReleaseStaging();
+		stagedWidth = stagedHeight = stagedFormat = 0;
+
+		sink->Close();
+		delete sink;
+		sink = nullptr;
+	}
+
+	void Reclaim(CaptureDevice* device)
+	{
+		for (int i = 0; i < kSlots; i++)
+		{
+			if (slots[i].state.load(std::memory_order_acquire) == kSlotWritten)
+			{
+				device->Unmap(i);
+				slots[i].state.store(kSlotFree, std::memory_order_relaxed);
+			}
+		}
+	}
+
+	// Oldest copy first.  Once one is still pending, the later ones are too.
+	void PollCopies(CaptureDevice* device)
+	{
+		for (;;)
+		{
+			int oldest = -1;
+			for (int i = 0; i < kSlots; i++)
+			{
+				if (slots[i].state.load(std::memory_order_relaxed) == kSlotCopied &&
+					(oldest < 0 || slots[i].copySequence < slots[oldest].copySequence))
+					oldest = i;
+			}
+			if (oldest < 0)
+				return;
+
+			Slot& slot = slots[oldest];
+			CaptureMap result = device->TryMap(oldest, &slot.frame.pixels, &slot.frame.pitch);
+			if (result == kCaptureMapPending)
+				return;
+			if (result == kCaptureMapFailed)
+			{
+				failed.fetch_add(1, std::memory_order_relaxed);
+				slot.state.store(kSlotFree, std::memory_order_relaxed);
+				continue;
+			}
+
+			slot.state.store(kSlotWriting, std::memory_order_relaxed);
+			{
+				std::lock_guard<std::mutex> guard(queueLock);
+				queue.push_back(oldest);
+			}
+			queueReady.notify_one();
+		}
+	}
+
+	// A new size or format needs new staging textures, but not while the
+	// writer still has any of the old ones.  Copies not mapped yet are lost.
+	// The writer can finish one after Reclaim, which still needs its Unmap.
+	bool EnsureStaging(CaptureDevice* device, const CaptureSource& source)
+	{
+		if (source.width == stagedWidth && source.height == stagedHeight && source.format == stagedFormat)
+			return true;
+		if (source.width == 0 || source.height == 0)
+			return false;
+
+		for (Slot& slot : slots)
+		{
+			if (slot.state.load(std::memory_order_acquire) == kSlotWriting)
+				return false;
+		}
+		for (int i = 0; i < kSlots; i++)
+		{
+			if (slots[i].state.load(std::memory_order_acquire) == kSlotWritten)
+				device->Unmap(i);
+			slots[i].state.store(kSlotFree, std::memory_order_relaxed);
+		}
+
+		device->ReleaseStaging();
+		stagedWidth = stagedHeight = stagedFormat = 0;
+		if (!device->CreateStaging(kSlots, source.width, source.height, source.format))
+		{
+			failed.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+		stagedWidth = source.width;
+		stagedHeight = source.height;
+		stagedFormat = source.format;
+		return true;
+	}
+
+	void WriterThread()
+	{
+		std::unique_lock<std::mutex> lock(queueLock);
+		for (;;)
+		{
+			queueReady.wait(lock, [this] { return !queue.empty() || stopping; });
+			if (queue.empty())
+				return;
+			int index = queue.front();
+			queue.pop_front();
+			lock.unlock();
+
+			Slot& slot = slots[index];
+			int64_t start = Now();
+			bool ok = sink->Write(slot.frame);
+			writeNs.fetch_add(Now() - start, std::memory_order_relaxed);
+			if (ok)
+			{
+				written.fetch_add(1, std::memory_order_relaxed);
+				bytes.fetch_add((uint64_t)slot.frame.width * CaptureBytesPerPixel(slot.frame.format) * slot.frame.height,
+					std::memory_order_relaxed);
+			}
+			else
+			{
+				failed.fetch_add(1, std::memory_order_relaxed);
+			}
+			slot.state.store(kSlotWritten, std::memory_order_release);
+
+			lock.lock();
+		}
+	}
+
+	// Render thread only.
+	CaptureSink* sink = nullptr;
+	uint32_t interval = 1;
+	uint64_t frameCount = 0;
+	uint64_t captureCount = 0;
+	uint64_t copySequence = 0;
+	uint32_t stagedWidth = 0;
+	uint32_t stagedHeight = 0;
+	uint32_t stagedFormat = 0;
+	Slot slots[kSlots];
+
+	std::mutex requestLock;
+	std::atomic<bool> requested{ false };
+	CaptureSink* pendingSink = nullptr;
+	uint32_t pendingInterval = 1;
+
+	std::thread writer;
+	std::mutex queueLock;
+	std::condition_variable queueReady;
+	std::deque<int> queue;
+	bool stopping = false;
+
+	std::atomic<uint64_t> written{ 0 };
+	std::atomic<uint64_t> dropped{ 0 };
+	std::atomic<uint64_t> failed{ 0 };
+	std::atomic<uint64_t> bytes{ 0 };
+	std::atomic<int64_t> writeNs{ 0 };
+	std::atomic<int64_t> startedNs{ 0 };
+};
@@ -42,6 +42,9 @@ public:
 
 	// These are generic APIs, not DX specific.
 	virtual ID3D11ShaderResourceView* CreateSharedSurface(HANDLE shared) = 0;
+	virtual ID3D11ShaderResourceView* GetLatestSharedSurface() = 0;
+	virtual UINT GetShownSlot() = 0;
+	virtual void TakeLatestFrame(UINT shown) = 0;
 	virtual UINT GetGameWidth() = 0;
 	virtual UINT GetGameHeight() = 0;
 	virtual DXGI_FORMAT GetGameFormat() = 0;
@@ -54,6 +57,20 @@ public:
 	virtual void OpenFileMappedIPC() = 0;
 	virtual void CloseFileMappedIPC() = 0;
 	virtual UINT GetSharedHandleIPC() = 0;
+
+	virtual UINT GetNotifyGeneration() = 0;
+	virtual UINT WaitForNotifyGeneration(UINT seenGeneration, UINT timeoutMs) = 0;
+	virtual void SetFrameNotify(bool wanted) = 0;
+
+	virtual void SetCopyRequest(int mode, float x, float y, float width, float height) = 0;
+	virtual int GetGameCopy(int* eyeWidth, int* eyeHeight, float* crop) = 0;
+
+	virtual float GetHookTiming(int stat, float percentile) = 0;
+
+	virtual bool StartCapture(int sinkType, const wchar_t* path, int interval) = 0;
+	virtual void StopCapture() = 0;
+	virtual double GetCaptureStat(int stat) = 0;
+	virtual void CaptureFrame() = 0;
 };
 
 
@@ -13,23 +13,66 @@
 #include <d3d11_1.h>
 #include "Unity/IUnityGraphicsD3D11.h"
 
+#include "../DeviarePlugin/KatangaIPC.h"
+#include "../DeviarePlugin/KatangaSharedMemory.h"
+#include "../DeviarePlugin/KatangaStats.h"
+#include "../DeviarePlugin/KatangaKeyedMutex.h"
+#include "../DeviarePlugin/KatangaNotify.h"
+#include "../DeviarePlugin/AsyncLog.h"
+#include "../DeviarePlugin/KatangaTrace.h"
+#include "SharedSurfaceCache.h"
+#include "StagingArena.h"
+#include "FrameCapture.h"
+#include "CaptureSinks.h"
+#include "StereoDetect.h"
+
 #include <stdio.h>
 #include <share.h>
 #include <time.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
 
 
 static FILE* gLogFile;
+static AsyncLog gAsyncLog;
 
+// Same async log ring as the game plugin, so logging from Update or the render
+// thread never waits on the disk.  Literal formats only, as with LogInfo.
 #define Log(fmt, ...) \
-	do { if (gLogFile) fwprintf(gLogFile, fmt, __VA_ARGS__); fflush(gLogFile); } while (0)
+	do { if (gLogFile) gAsyncLog.WriteLiteral(L"" fmt, __VA_ARGS__); } while (0)
 
-static void LogDebug(wchar_t* text)
+static void LogDebug(const wchar_t* text)
 {
 #ifdef _DEBUG 
-	Log(text);
+	if (gLogFile)
+		gAsyncLog.WriteText(text);
 #endif
 }
 
+// Our side of the startup trace, see KatangaTrace.h.  We start the trace file
+// at OpenLogFile, before the game is launched, and add ours at DestroySetupMutex,
+// the last call at quit.  The game plugin adds its own at its unload.
+static KatangaTracer gTrace;
+
+#define TraceScope(name) KATANGA_TRACE_SCOPE(&gTrace, name)
+
+// Same folder as the log, LocalLow\Katanga\Katanga.
+static std::wstring KatangaFilePath(const wchar_t* name)
+{
+	wchar_t* localLowAppData = 0;
+	SHGetKnownFolderPath(FOLDERID_LocalAppDataLow, 0, NULL, &localLowAppData);
+	std::wstring path = std::wstring(localLowAppData) + L"\\Katanga\\Katanga\\" + name;
+	CoTaskMemFree(localLowAppData);
+	return path;
+}
+
+static std::wstring TraceFilePath()
+{
+	return KatangaFilePath(L"katanga_trace.json");
+}
+
 
 
 // ----------------------------------------------------------------------
@@ -50,13 +93,222 @@ void FatalExit(LPCWSTR errorString, HRESULT code)
 	wchar_t info[512];
 
 	swprintf_s(info, _countof(info), L" Fatal Error: %s  (0x%x)\n", errorString, code);
-	Log(info);
+	Log(L"%s", info);
+	gAsyncLog.Flush();
 
 	MessageBox(NULL, info, L"Katanga:Plugin Fatal Error", MB_OK);
 	exit(1);
 }
 
 
+// ----------------------------------------------------------------------
+// The keyed mutexes of the shared slots, when the game side created them with
+// D3D11_RESOURCE_MISC_SHARED_KEYEDMUTEX.  See KatangaKeyedMutex.h.
+
+struct SlotMutexes
+{
+	IDXGIKeyedMutex* mutexes[kKatangaMaxSlots] = { nullptr };
+
+	// WAIT_TIMEOUT and WAIT_ABANDONED are both success HRESULTs, only S_OK owns it.
+	bool TryAcquire(uint32_t slot, uint64_t key) { return mutexes[slot]->AcquireSync(key, 0) == S_OK; }
+	void Release(uint32_t slot, uint64_t key) { mutexes[slot]->ReleaseSync(key); }
+};
+
+
+// ----------------------------------------------------------------------
+// Pages for the StagingArena, straight from VirtualAlloc, so they are page
+// aligned and go back to the OS as soon as the frame size changes.
+
+class VirtualAllocPages : public StagingPages
+{
+public:
+	void* Allocate(size_t bytes) override
+	{
+		return VirtualAlloc(NULL, bytes, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+	}
+
+	void Free(void* pages, size_t) override
+	{
+		VirtualFree(pages, 0, MEM_RELEASE);
+	}
+};
+
+
+// ----------------------------------------------------------------------
+// FrameCapture's view of the game frame, a ring of staging textures that the
+// current shared slot is copied into.  Render thread only, like the immediate
+// context it uses.
+
+class D3D11CaptureDevice : public CaptureDevice
+{
+public:
+	ID3D11Device* device = nullptr;
+	ID3D11Texture2D* source = nullptr;		// Set before each OnFrame.
+
+	~D3D11CaptureDevice() { ReleaseStaging(); }
+
+	bool CreateStaging(int count, uint32_t width, uint32_t height, uint32_t format) override
+	{
+		D3D11_TEXTURE2D_DESC desc = {};
+		desc.Width = width;
+		desc.Height = height;
+		desc.MipLevels = 1;
+		desc.ArraySize = 1;
+		desc.Format = (DXGI_FORMAT)format;
+		desc.SampleDesc.Count = 1;
+		desc.Usage = D3D11_USAGE_STAGING;
+		desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+
+		for (int i = 0; i < count && i < FrameCapture::kSlots; i++)
+		{
+			HRESULT hr = device->CreateTexture2D(&desc, nullptr, &staging[i]);
+			if (FAILED(hr))
+			{
+				Log(L"..Katanga:Capture cannot create %d x %d staging, format %d: 0x%x\n", width, height, format, hr);
+				ReleaseStaging();
+				return false;
+			}
+		}
+		Log(L"..Katanga:Capture staging ring %d x %d, format %d\n", width, height, format);
+		return true;
+	}
+
+	void ReleaseStaging() override
+	{
+		for (ID3D11Texture2D*& texture : staging)
+			SAFE_RELEASE(texture);
+	}
+
+	bool Copy(int slot) override
+	{
+		if (source == nullptr || staging[slot] == nullptr)
+			return false;
+
+		ID3D11DeviceContext* ctx = NULL;
+		device->GetImmediateContext(&ctx);
+		ctx->CopyResource(staging[slot], source);
+		ctx->Release();
+		return true;
+	}
+
+	// DO_NOT_WAIT gives back WAS_STILL_DRAWING while the GPU has the copy queued.
+	CaptureMap TryMap(int slot, const uint8_t** pixels, uint32_t* pitch) override
+	{
+		ID3D11DeviceContext* ctx = NULL;
+		device->GetImmediateContext(&ctx);
+		D3D11_MAPPED_SUBRESOURCE mapped;
+		HRESULT hr = ctx->Map(staging[slot], 0, D3D11_MAP_READ, D3D11_MAP_FLAG_DO_NOT_WAIT, &mapped);
+		ctx->Release();
+
+		if (hr == DXGI_ERROR_WAS_STILL_DRAWING)
+			return kCaptureMapPending;
+		if (FAILED(hr))
+		{
+			Log(L"..Katanga:Capture Map failed: 0x%x\n", hr);
+			return kCaptureMapFailed;
+		}
+		*pixels = static_cast<const uint8_t*>(mapped.pData);
+		*pitch = mapped.RowPitch;
+		return kCaptureMapReady;
+	}
+
+	void Unmap(int slot) override
+	{
+		ID3D11DeviceContext* ctx = NULL;
+		device->GetImmediateContext(&ctx);
+		ctx->Unmap(staging[slot], 0);
+		ctx->Release();
+	}
+
+private:
+	ID3D11Texture2D* staging[FrameCapture::kSlots] = { nullptr };
+};
+
+
+// The shared memory ring of CaptureSinks.h, in a named mapping that a recorder
+// or streamer can OpenFileMapping.  Sized for the game surface at the start, a
+// later resize makes frames fail until the capture is restarted.
+
+class MappedRingCaptureSink : public CaptureSink
+{
+public:
+	static const uint32_t kRingSlots = 3;
+
+	~MappedRingCaptureSink() { Close(); }
+
+	bool Open(uint64_t pixelBytes)
+	{
+		uint64_t size = CaptureRingSize(kRingSlots, pixelBytes);
+		hMapFile = CreateFileMapping(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+			(DWORD)(size >> 32), (DWORD)size, KATANGA_CAPTURE_RING_NAME);
+		if (hMapFile == NULL)
+			return false;
+		bool existed = (GetLastError() == ERROR_ALREADY_EXISTS);
+
+		pView = MapViewOfFile(hMapFile, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+		if (pView == nullptr)
+			return false;
+
+		// A reader can keep the last capture's mapping alive, reuse it if it
+		// is big enough.  New ones come zeroed.
+		if (existed)
+		{
+			MEMORY_BASIC_INFORMATION info;
+			if (VirtualQuery(pView, &info, sizeof(info)) == 0 || info.RegionSize < size)
+				return false;
+			memset(pView, 0, (size_t)size);
+		}
+
+		ring = new MemoryRingCaptureSink(pView, kRingSlots, pixelBytes);
+		return true;
+	}
+
+	bool Write(const CaptureFrame& frame) override
+	{
+		return ring->Write(frame);
+	}
+
+	void Close() override
+	{
+		delete ring;
+		ring = nullptr;
+		if (pView != nullptr)
+			UnmapViewOfFile(pView);
+		pView = nullptr;
+		if (hMapFile != NULL)
+			CloseHandle(hMapFile);
+		hMapFile = NULL;
+	}
+
+private:
+	HANDLE hMapFile = NULL;
+	LPVOID pView = nullptr;
+	MemoryRingCaptureSink* ring = nullptr;
+};
+
+// The sinks take UTF-8 paths, and hand them back to us to open.
+
+static std::string Utf8Path(const std::wstring& path)
+{
+	int length = WideCharToMultiByte(CP_UTF8, 0, path.c_str(), -1, NULL, 0, NULL, NULL);
+	if (length <= 1)
+		return std::string();
+	std::string utf8(length - 1, '\0');
+	WideCharToMultiByte(CP_UTF8, 0, path.c_str(), -1, &utf8[0], length, NULL, NULL);
+	return utf8;
+}
+
+static FILE* OpenCaptureFile(const char* path)
+{
+	int length = MultiByteToWideChar(CP_UTF8, 0, path, -1, NULL, 0);
+	if (length <= 1)
+		return nullptr;
+	std::wstring wide(length - 1, L'\0');
+	MultiByteToWideChar(CP_UTF8, 0, path, -1, &wide[0], length);
+	return _wfsopen(wide.c_str(), L"wb", _SH_DENYWR);
+}
+
+
 // ----------------------------------------------------------------------
 class RenderAPI_D3D11 : public RenderAPI
 {
@@ -75,6 +327,9 @@ public:
 	virtual void CloseLogFile();
 
 	virtual ID3D11ShaderResourceView* CreateSharedSurface(HANDLE shared);
+	virtual ID3D11ShaderResourceView* GetLatestSharedSurface();
+	virtual UINT GetShownSlot();
+	virtual void TakeLatestFrame(UINT shown);
 	virtual UINT GetGameWidth();
 	virtual UINT GetGameHeight();
 	virtual DXGI_FORMAT GetGameFormat();
@@ -88,10 +343,34 @@ public:
 	virtual void CloseFileMappedIPC();
 	virtual UINT GetSharedHandleIPC();
 
+	virtual UINT GetNotifyGeneration();
+	virtual UINT WaitForNotifyGeneration(UINT seenGeneration, UINT timeoutMs);
+	virtual void SetFrameNotify(bool wanted);
+
+	virtual void SetCopyRequest(int mode, float x, float y, float width, float height);
+	virtual int GetGameCopy(int* eyeWidth, int* eyeHeight, float* crop);
+
+	virtual float GetHookTiming(int stat, float percentile);
+
+	virtual bool StartCapture(int sinkType, const wchar_t* path, int interval);
+	virtual void StopCapture();
+	virtual double GetCaptureStat(int stat);
+	virtual void CaptureFrame();
+
 private:
 	void CreateResources();
 	void ReleaseResources();
 
+	void StartNotifyWatcher();
+	void StopNotifyWatcher();
+	void NotifyWatcher();
+
+	void EndBusyFrames();
+
+	void SetCaptureSource(UINT slot);
+
+	void DetectLayout(ID3D11Texture2D* texture);
+
 private:
 	ID3D11Device* m_Device;
 	ID3D11Buffer* m_VB; // vertex buffer
@@ -114,13 +393,101 @@ private:
 	// Mutex to avoid collisions from VR to game sides.  
 	HANDLE gSetupMutex = NULL;
 
+	// Number of times we actually own the mutex this frame, zero when the
+	// frame was started with the lock-free check of the shared descriptor.
+	int mutexOwnedCount = 0;
+
+	// Number of frames we began with KatangaTryBeginFrame since the last end
+	// of frame, each one is a count in the descriptor's consumerBusy.
+	UINT busyFrameCount = 0;
+
 	// For the file map IPC
-	HANDLE hMapFile = NULL;
+	std::unique_ptr<KatangaSharedMemory> mappedFile{ CreateKatangaSharedMemory_Win32(KATANGA_MAPPED_FILE_NAME) };
 	LPVOID pMappedView = nullptr;
-
-	// For the shared surface itself, disposed when recreated.
-	ID3D11Texture2D* pTexture2D = nullptr;
-	ID3D11ShaderResourceView* pSRView = nullptr;
+	KatangaSharedDescriptor* pSharedDesc = nullptr;
+
+	// Woken by the game side whenever the descriptor changes, see KatangaNotify.h.
+	// The watcher thread only counts wakeups, everything else stays on Unity's
+	// main thread, which compares the count to what it last acted on.
+	KatangaNotifyEvent notifyEvent;
+	std::thread notifyThread;
+	std::atomic<bool> notifyStop { false };
+	KatangaNotifyGeneration notifyGeneration;
+
+	// When we last tried to open the mapping, by notify count and by time.
+	UINT openAttemptGeneration = 0;
+	DWORD openAttemptTicks = 0;
+
+	// Last shared handle we saw, only to mark new ones in the trace.
+	UINT tracedHandle = 0;
+
+	// Whether to ask the game side for a wakeup every frame.
+	bool frameNotify = false;
+
+	// The KatangaCopyMode we'd like from the game side, packed.
+	uint64_t copyRequest = 0;
+
+	// For the game side's Present timing stats, read only.
+	HANDLE hStatsFile = NULL;
+	KatangaStatsPage* pStats = nullptr;
+
+	// For the shared surfaces themselves, borrowed from m_SurfaceCache, which
+	// holds the references.  With an older game plugin, or DX9, only slot 0 is used.
+	ID3D11Texture2D* pSlotTextures[kKatangaMaxSlots] = { nullptr };
+	ID3D11ShaderResourceView* pSlotViews[kKatangaMaxSlots] = { nullptr };
+	SharedSurfaceCache<ID3D11Texture2D, ID3D11ShaderResourceView> m_SurfaceCache;
+	UINT slotCount = 0;
+
+	// Slot we are sampling from this frame, owned by us until we trade it
+	// back into the mailbox for a fresher one.  Traded on the render thread,
+	// in TakeLatestFrame.
+	UINT readSlot = 0;
+
+	// Only when the game side set kKatangaSurfaceKeyedMutex.
+	bool keyedMutex = false;
+	SlotMutexes slotMutexes;
+	KatangaKeyedConsumer<SlotMutexes> consumerKeys;
+
+	// The ring and the descriptor are set up on the main thread, and the slots
+	// traded on the render thread, so both sides hold slotLock for that.  The
+	// main thread only reads takenSlot, what TakeLatestFrame last published,
+	// with kKatangaMaxSlots for none, and says which one it showed in shownSlot.
+	std::mutex slotLock;
+	std::atomic<UINT> takenSlot { 0 };
+	UINT shownSlot = kKatangaMaxSlots;
+
+	// Reading frames back for StartCapture, see FrameCapture.h.
+	D3D11CaptureDevice m_CaptureDevice;
+	FrameCapture m_Capture;
+
+	// The texture of the slot Unity is drawing, and its layout, for CaptureFrame
+	// on the render thread.  Set by the main thread whenever it takes a slot,
+	// with our own reference, so that CreateSharedSurface can drop the ring
+	// while a capture still has it.  Only touched under captureLock.
+	std::mutex captureLock;
+	ID3D11Texture2D* captureTexture = nullptr;
+	UINT captureLayout = kLayoutUnknown;
+
+	// What DetectLayout found, for SetCaptureSource to put in the shared
+	// descriptor.  Also under captureLock.
+	bool detectPending = false;
+	StereoDetection detectFound = {};
+
+	// Reading one frame back now and then for DetectLayout, in its own single
+	// staging texture, so it works with or without a capture running.
+	D3D11CaptureDevice m_DetectDevice;
+	UINT detectCountdown = 0;
+	bool detectCopied = false;
+	D3D11_TEXTURE2D_DESC detectDesc = {};
+	UINT detectedLayout = kLayoutUnknown;
+
+	// System memory for BeginModifyTexture, reused every frame.
+	VirtualAllocPages m_StagingPages;
+	StagingArena m_Staging{ &m_StagingPages };
+
+	// Set when BeginModifyTexture mapped a dynamic texture directly, so that
+	// EndModifyTexture knows to Unmap instead of UpdateSubresource.
+	ID3D11Texture2D* m_MappedTexture = nullptr;
 
 
 	//ID3D11Texture2D* m_SharedSurface;	// Same as DX9Ex surface
@@ -207,11 +574,24 @@ void RenderAPI_D3D11::ProcessDeviceEvent(UnityGfxDeviceEventType type, IUnityInt
 	{
 		IUnityGraphicsD3D11* d3d = interfaces->Get<IUnityGraphicsD3D11>();
 		m_Device = d3d->GetDevice();
+		m_CaptureDevice.device = m_Device;
+		m_DetectDevice.device = m_Device;
 		CreateResources();
+		StartNotifyWatcher();
 		break;
 	}
 	case kUnityGfxDeviceEventShutdown:
+		StopNotifyWatcher();
+		m_Capture.Shutdown(&m_CaptureDevice);
+		SetCaptureSource(kKatangaMaxSlots);
+		if (detectCopied)
+			m_DetectDevice.Unmap(0);
+		m_DetectDevice.ReleaseStaging();
+		detectCopied = false;
+		detectDesc = {};
+		m_SurfaceCache.Clear();
 		ReleaseResources();
+		m_Staging.Release();
 		break;
 	}
 }
@@ -327,16 +707,58 @@ void CheckDate()
 }
 
 
+// If the texture was created as Dynamic with CPU write access, we can Map it with
+// WRITE_DISCARD and have the caller write straight into the driver's memory, with
+// no copy at all.  Unity's own Texture2D is Default usage though, so normally we
+// hand out a buffer from the staging arena, and UpdateSubresource from that.
+
 void* RenderAPI_D3D11::BeginModifyTexture(void* textureHandle, int textureWidth, int textureHeight, int* outRowPitch)
 {
+	ID3D11Texture2D* d3dtex = (ID3D11Texture2D*)textureHandle;
+	assert(d3dtex);
+
+	D3D11_TEXTURE2D_DESC desc;
+	d3dtex->GetDesc(&desc);
+
+	if (desc.Usage == D3D11_USAGE_DYNAMIC && (desc.CPUAccessFlags & D3D11_CPU_ACCESS_WRITE))
+	{
+		ID3D11DeviceContext* ctx = NULL;
+		m_Device->GetImmediateContext(&ctx);
+
+		D3D11_MAPPED_SUBRESOURCE mapped;
+		HRESULT hr = ctx->Map(d3dtex, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped);
+		ctx->Release();
+		if (FAILED(hr))
+		{
+			Log(L"  BeginModifyTexture: failed to Map dynamic texture: 0x%x\n", hr);
+			return nullptr;
+		}
+
+		m_MappedTexture = d3dtex;
+		*outRowPitch = mapped.RowPitch;
+		return mapped.pData;
+	}
+
 	const int rowPitch = textureWidth * 4;
-	// Just allocate a system memory buffer here for simplicity
-	unsigned char* data = new unsigned char[rowPitch * textureHeight];
+	size_t bytes = (size_t)rowPitch * textureHeight;
+
+	if (bytes != m_Staging.Size())
+		Log(L"  BeginModifyTexture: staging arena resized to %d x %d, %zu bytes\n", textureWidth, textureHeight, bytes);
+
+	void* data = m_Staging.Acquire(bytes);
+	if (data == nullptr)
+	{
+		Log(L"  BeginModifyTexture: failed to allocate %zu bytes staging: 0x%x\n", bytes, GetLastError());
+		return nullptr;
+	}
+
 	*outRowPitch = rowPitch;
 	return data;
 }
 
 
+// The arena buffer stays ours, UpdateSubresource has already taken its copy.
+
 void RenderAPI_D3D11::EndModifyTexture(void* textureHandle, int textureWidth, int textureHeight, int rowPitch, void* dataPtr)
 {
 	ID3D11Texture2D* d3dtex = (ID3D11Texture2D*)textureHandle;
@@ -344,9 +766,16 @@ void RenderAPI_D3D11::EndModifyTexture(void* textureHandle, int textureWidth, in
 
 	ID3D11DeviceContext* ctx = NULL;
 	m_Device->GetImmediateContext(&ctx);
-	// Update texture data, and free the memory buffer
-	ctx->UpdateSubresource(d3dtex, 0, NULL, dataPtr, rowPitch, 0);
-	delete[] (unsigned char*)dataPtr;
+
+	if (m_MappedTexture == d3dtex)
+	{
+		ctx->Unmap(d3dtex, 0);
+		m_MappedTexture = nullptr;
+	}
+	else
+	{
+		ctx->UpdateSubresource(d3dtex, 0, NULL, dataPtr, rowPitch, 0);
+	}
 	ctx->Release();
 }
 
@@ -369,15 +798,23 @@ void RenderAPI_D3D11::OpenLogFile()
 	gLogFile = _wfsopen(logFilePath, L"a", _SH_DENYNO);
 	if (gLogFile == NULL)
 		FatalExit(L"Katanga:OpenLogFile unable to open log for writing.", GetLastError());
-	setvbuf(gLogFile, NULL, _IONBF, 0);
+	gAsyncLog.Start(gLogFile);
 
 	Log(L"\n..Unity Native C++ logging enabled.\n");
+
+	// Starts this session's trace, the game side appends to it.
+	FILE* trace = _wfsopen(TraceFilePath().c_str(), L"wb", _SH_DENYWR);
+	if (trace != nullptr)
+		fclose(trace);
+	gTrace.Instant("OpenLogFile");
 }
 
 void RenderAPI_D3D11::CloseLogFile()
 {
 	Log(L"\n..Unity Native C++ log closed.\n");
+	gAsyncLog.Stop();
 	fclose(gLogFile);
+	gLogFile = nullptr;
 }
 
 // ----------------------------------------------------------------------
@@ -388,9 +825,16 @@ void RenderAPI_D3D11::CloseLogFile()
 // create and manage the mutex, because it is grabbing and releasing it every frame.
 // This allows us to set this up in a simpler fashion.  The game side will grab the
 // mutex only on really rare scenarios like first start, or reset of the graphics.
+//
+// Grabbing a kernel mutex every frame at 90Hz is not free though, so once the game
+// side has published its shared descriptor, Grab/Release just set and clear a busy
+// flag in the mapped file, and check the setupSequence.  We only fall back to
+// actually waiting on the mutex when the game side is in the middle of a setup.
 
 void RenderAPI_D3D11::CreateSetupMutex()
 {
+	TraceScope("CreateSetupMutex");
+
 	Log(L"\n..Katanga:CreateSetupMutex--> ");
 
 	gSetupMutex = CreateMutex(NULL, false, L"KatangaSetupMutex");
@@ -413,6 +857,19 @@ bool RenderAPI_D3D11::GrabSetupMutex()
 	if (gSetupMutex == NULL)
 		FatalExit(L"Katanga:GrabSetupMutex called, but mutex does not exist.", GetLastError());
 
+	// Normal frame, game side is not doing setup, and now cannot start one until
+	// we ReleaseSetupMutex at end of frame.
+	if (pSharedDesc != nullptr && KatangaIsDescriptorValid(pSharedDesc))
+	{
+		if (KatangaTryBeginFrame(pSharedDesc))
+		{
+			busyFrameCount++;
+			return true;
+		}
+
+		Log(L"..Katanga:GrabSetupMutex: game side in setup, waiting on mutex.\n");
+	}
+
 	// See if we can grab the mutex immediately.  Using 1000 wait time, if we ever
 	// hit that, we should fail out.  Goal is to sync with the game side.
 
@@ -428,6 +885,8 @@ bool RenderAPI_D3D11::GrabSetupMutex()
 		return false;
 	}
 
+	mutexOwnedCount++;
+
 	return true;
 }
 
@@ -438,31 +897,50 @@ bool RenderAPI_D3D11::ReleaseSetupMutex()
 	if (gSetupMutex == NULL)
 		FatalExit(L"Katanga:ReleaseSetupMutex: Mutex released before initialized.", GetLastError());
 
-	bool ok = ReleaseMutex(gSetupMutex);
-	if (!ok)
-	{
-		DWORD hr = GetLastError();
-		if (hr == ERROR_NOT_OWNER)
-			Log(L"..Katanga:ReleaseSetupMutex: ReleaseMutex ERROR_NOT_OWNER\n");
-		else
-			Log(L"..Katanga:ReleaseSetupMutex: ReleaseMutex failed, err: 0x%x\n", hr);
-	}
+	// Always end the busy frames, the frame may have started on the fast path
+	// even if a later Grab in the same frame had to use the mutex.
+	EndBusyFrames();
 
 	// There are bugs in the Unity startup code, such that Update can be called multiple
 	// times before the EndOfFrame happens, where we release the mutex.  If we see multiple
 	// calls to capture the mutex, we can wind up locking out the game because each capture
 	// must be matched to a release.  
-	// To avoid this annoying problem, we'll do a second ReleaseMutex here, which will free
-	// up at least one of those bad locks every frame, until we get into a free running state
-	// where this second one will always return an ERROR_NOT_OWNER every time.
+	// To avoid this annoying problem, we count every successful capture, and release
+	// them all here.
 
-	ok = ReleaseMutex(gSetupMutex);
-	if (ok)
-		Log(L"..Katanga:ReleaseSetupMutex: Non fatal, double lock detected.\n");
+	if (mutexOwnedCount > 1)
+		Log(L"..Katanga:ReleaseSetupMutex: Non fatal, multiple lock detected: %d\n", mutexOwnedCount);
+
+	bool ok = true;
+	while (mutexOwnedCount > 0)
+	{
+		if (!ReleaseMutex(gSetupMutex))
+		{
+			DWORD hr = GetLastError();
+			if (hr == ERROR_NOT_OWNER)
+				Log(L"..Katanga:ReleaseSetupMutex: ReleaseMutex ERROR_NOT_OWNER\n");
+			else
+				Log(L"..Katanga:ReleaseSetupMutex: ReleaseMutex failed, err: 0x%x\n", hr);
+			ok = false;
+		}
+		mutexOwnedCount--;
+	}
 
 	return ok;
 }
 
+// Takes back every count we added to consumerBusy this frame, and only ours.
+// Unity can call Update more than once per end of frame, and clearing the
+// whole thing on the first end would let the game rebuild under a frame that
+// is still drawing.
+
+void RenderAPI_D3D11::EndBusyFrames()
+{
+	if (pSharedDesc != nullptr)
+		KatangaEndFrame(pSharedDesc, busyFrameCount);
+	busyFrameCount = 0;
+}
+
 void RenderAPI_D3D11::DestroySetupMutex()
 {
 	Log(L"\n..Katanga:DestroySetupMutex<-- %p\n\n", gSetupMutex);
@@ -470,46 +948,75 @@ void RenderAPI_D3D11::DestroySetupMutex()
 	if (gSetupMutex == NULL)
 		FatalExit(L"Katanga:DestroySetupMutex: Mutex does not exist.", GetLastError());
 
+	EndBusyFrames();
+
 	ReleaseMutex(gSetupMutex);
 	CloseHandle(gSetupMutex);
+
+	// The game side may be writing its part right now, so wait a little.
+	FILE* trace = nullptr;
+	for (int tries = 0; trace == nullptr && tries < 10; tries++)
+	{
+		trace = _wfsopen(TraceFilePath().c_str(), L"ab", _SH_DENYWR);
+		if (trace == nullptr)
+			Sleep(10);
+	}
+	bool written = gTrace.Append(trace, GetCurrentProcessId(), "Katanga");
+	if (trace != nullptr)
+		fclose(trace);
+	Log(L"..Katanga:Trace written: %d, %llu spans, %llu dropped\n", written, gTrace.Recorded(), gTrace.Dropped());
 }
 
 // ----------------------------------------------------------------------
 
 void RenderAPI_D3D11::OpenFileMappedIPC()
 {
-	TCHAR szName[] = TEXT("Local\\KatangaMappedFile");
-	DWORD mapSize = sizeof(UINT);
-
 	LogDebug(L"..Katanga:OpenFileMappedIPC\n");
 
-	hMapFile = OpenFileMapping(
-		FILE_MAP_ALL_ACCESS,   // read/write access
-		FALSE,                 // do not inherit the name
-		szName);               // name of mapping object
-	if (hMapFile == NULL)
+	// Not there yet is normal, the game may not have loaded our plugin.
+	if (!mappedFile->Open(sizeof(KatangaSharedDescriptor)))
+	{
+		if (mappedFile->LastError() != ERROR_FILE_NOT_FOUND)
+			Log(L"..Katanga:OpenFileMappedIPC: cannot map the file, err: 0x%x\n", mappedFile->LastError());
 		return;
-//		FatalExit(L"Katanga:OpenFileMappedIPC: cannot OpenFileMapping.", GetLastError());
+	}
 
-	pMappedView = MapViewOfFile(
-		hMapFile,			  // handle to file map object
-		FILE_MAP_ALL_ACCESS,  // read/write permission
-		0,					  // No offset in file
-		0,
-		mapSize);
-	if (pMappedView == NULL)
 	{
-		CloseHandle(hMapFile);
-		FatalExit(L"Katanga:OpenFileMappedIPC: cannot MapViewOfFile.", GetLastError());
+		std::lock_guard<std::mutex> lock(slotLock);
+		pMappedView = mappedFile->View();
+		pSharedDesc = static_cast<KatangaSharedDescriptor*>(pMappedView);
 	}
+	gTrace.Instant("OpenFileMappedIPC");
 
-	Log(L"..Katanga:OpenFileMappedIPC Mapped file created: %p, val: 0x%x\n", pMappedView, *(UINT*)(pMappedView));
+	// The game side may be older, with no notifyWaiters field to write.
+	if (KatangaIsDescriptorValid(pSharedDesc))
+	{
+		KatangaSetFrameNotify(pSharedDesc, frameNotify);
+		KatangaRequestCopy(pSharedDesc, copyRequest);
+	}
+
+	Log(L"..Katanga:OpenFileMappedIPC Mapped file created: %p, val: 0x%x, version: %d\n", 
+		pMappedView, pSharedDesc->sharedHandle, pSharedDesc->version);
 }
 
 void RenderAPI_D3D11::CloseFileMappedIPC()
 {
-	UnmapViewOfFile(pMappedView);
-	CloseHandle(hMapFile);
+	EndBusyFrames();
+
+	{
+		std::lock_guard<std::mutex> lock(slotLock);
+		mappedFile->Close();
+		pMappedView = nullptr;
+		pSharedDesc = nullptr;
+	}
+
+	if (pStats != nullptr)
+	{
+		UnmapViewOfFile(pStats);
+		CloseHandle(hStatsFile);
+		pStats = nullptr;
+		hStatsFile = NULL;
+	}
 }
 
 // This returns the actual shared texture handle as specified by the
@@ -520,24 +1027,423 @@ void RenderAPI_D3D11::CloseFileMappedIPC()
 // https://docs.microsoft.com/en-us/windows/win32/winprog64/interprocess-communication
 //
 // The actual texture handle is passed via IPC through the mappedfile, as the first
-// and only 4 bytes of the file.
+// 4 bytes of the KatangaSharedDescriptor.
 
 UINT RenderAPI_D3D11::GetSharedHandleIPC()
 {
 	LogDebug(L"..Katanga:GetSharedHandleIPC\n");
 
 	// Using late binding here, because the async nature of the launch startup means
-	// we never have a good idea of when it's ready.  But GetSharedHandleIPC will
-	// never be called before the OnLoad of the game plugin.
+	// we never have a good idea of when it's ready.  The game plugin signals the
+	// notify event right after its OnLoad creates the mapping, so we only try to
+	// open it after a wakeup, not on every call.  The slow retry is for when the
+	// event could not be opened, or a game plugin that never signals it.
 	if (pMappedView == nullptr)
-		OpenFileMappedIPC();
+	{
+		const DWORD kOpenRetryMs = 1000;
+
+		UINT generation = notifyGeneration.Current();
+		DWORD now = GetTickCount();
+		if (generation != openAttemptGeneration || now - openAttemptTicks >= kOpenRetryMs)
+		{
+			openAttemptGeneration = generation;
+			openAttemptTicks = now;
+			OpenFileMappedIPC();
+		}
+	}
 
 	// pMappedView can still be null, if the game has not yet fired up the pipeline,
 	// and thus Present has yet to be called.
 	if (pMappedView == nullptr)
 		return 0;
 
-	return *(PUINT)(pMappedView);
+	if (pSharedDesc->sharedHandle != tracedHandle)
+	{
+		tracedHandle = pSharedDesc->sharedHandle;
+		gTrace.Instant("SharedHandleChanged");
+	}
+
+	return pSharedDesc->sharedHandle;
+}
+
+
+// ----------------------------------------------------------------------
+// The notify watcher.  It sits in WaitForSingleObject on the notify event, and
+// counts each wakeup in notifyGeneration, which the C# side compares against
+// the last one it saw, to wait for the game side without polling the mapping.
+//
+// Started and stopped with the graphics device, which is not under the loader
+// lock like DllMain, where a join would deadlock.
+
+void RenderAPI_D3D11::StartNotifyWatcher()
+{
+	if (notifyThread.joinable())
+		return;
+
+	if (!notifyEvent.Open())
+	{
+		Log(L"..Katanga:StartNotifyWatcher cannot open notify event, err: 0x%x\n", GetLastError());
+		return;
+	}
+
+	notifyStop.store(false);
+	notifyGeneration.Start();
+	notifyThread = std::thread(&RenderAPI_D3D11::NotifyWatcher, this);
+}
+
+// The event is shared with the game side, so signaling it ourselves to wake the
+// watcher just looks like one more change to check.
+
+void RenderAPI_D3D11::StopNotifyWatcher()
+{
+	if (!notifyThread.joinable())
+		return;
+
+	notifyStop.store(true);
+	notifyEvent.Signal();
+	notifyThread.join();
+	notifyEvent.Close();
+	notifyGeneration.Stop();
+}
+
+void RenderAPI_D3D11::NotifyWatcher()
+{
+	while (!notifyStop.load())
+	{
+		if (notifyEvent.Wait(INFINITE))
+			notifyGeneration.Advance();
+	}
+}
+
+// Number of wakeups so far.  It only says that something may have changed,
+// the caller still has to look at the shared handle or the latest frame.
+
+UINT RenderAPI_D3D11::GetNotifyGeneration()
+{
+	return notifyGeneration.Current();
+}
+
+// Blocks the calling thread until the count moves past seenGeneration, and
+// returns the new count, or seenGeneration after timeoutMs.  This is for C#
+// to call from a thread pool thread, so it can wait on the game side without
+// asking again every frame.  Returns at once while the watcher is stopped.
+
+UINT RenderAPI_D3D11::WaitForNotifyGeneration(UINT seenGeneration, UINT timeoutMs)
+{
+	return notifyGeneration.WaitPast(seenGeneration, timeoutMs);
+}
+
+// With wanted, the game side also signals after every frame it publishes,
+// instead of only when the surface changes.  That costs it a SetEvent per
+// frame, so leave it off unless something is actually waiting on frames.
+
+void RenderAPI_D3D11::SetFrameNotify(bool wanted)
+{
+	frameNotify = wanted;
+	if (pSharedDesc != nullptr && KatangaIsDescriptorValid(pSharedDesc))
+		KatangaSetFrameNotify(pSharedDesc, wanted);
+}
+
+// Ask the game side to copy less than the full frame, see CopyPlan.h.  mode is
+// a KatangaCopyMode, and for a crop, the rest is the part of each eye we can
+// see, 0 to 1 from the top left.  The game side takes its time to act on it.
+
+static uint32_t CropUnits(float fraction)
+{
+	fraction = (fraction < 0.0f) ? 0.0f : (fraction > 1.0f) ? 1.0f : fraction;
+	return (uint32_t)(fraction * kKatangaCropScale + 0.5f);
+}
+
+void RenderAPI_D3D11::SetCopyRequest(int mode, float x, float y, float width, float height)
+{
+	copyRequest = KatangaPackCopyRequest((KatangaCopyMode)mode, CropUnits(x), CropUnits(y), CropUnits(width), CropUnits(height));
+	if (pSharedDesc != nullptr && KatangaIsDescriptorValid(pSharedDesc))
+		KatangaRequestCopy(pSharedDesc, copyRequest);
+}
+
+// What the game side actually did for the current surfaces.  The game's eye
+// size, and crop as the part of each eye that is in the surface, 0 to 1 from
+// the top left, so the screen can show it at the right place.  An older game
+// plugin is always a full copy.
+
+int RenderAPI_D3D11::GetGameCopy(int* eyeWidth, int* eyeHeight, float* crop)
+{
+	bool validDesc = (pSharedDesc != nullptr && KatangaIsDescriptorValid(pSharedDesc));
+	if (!validDesc || pSharedDesc->eyeWidth == 0 || pSharedDesc->eyeHeight == 0)
+	{
+		*eyeWidth = gWidth / 2;
+		*eyeHeight = gHeight;
+		crop[0] = crop[1] = 0.0f;
+		crop[2] = crop[3] = 1.0f;
+		return kCopyModeFull;
+	}
+
+	*eyeWidth = pSharedDesc->eyeWidth;
+	*eyeHeight = pSharedDesc->eyeHeight;
+	crop[0] = (float)pSharedDesc->copyRect[0] / pSharedDesc->eyeWidth;
+	crop[1] = (float)pSharedDesc->copyRect[1] / pSharedDesc->eyeHeight;
+	crop[2] = (float)pSharedDesc->copyRect[2] / pSharedDesc->eyeWidth;
+	crop[3] = (float)pSharedDesc->copyRect[3] / pSharedDesc->eyeHeight;
+	return pSharedDesc->copyMode;
+}
+
+
+// ----------------------------------------------------------------------
+// Timing of the game side's Present hook, for the given KatangaStat.  Percentile
+// is 0 to 100, where 100 returns the max seen.  Result is in microseconds, or
+// zero if the game side has no stats, like an older game plugin.
+
+float RenderAPI_D3D11::GetHookTiming(int stat, float percentile)
+{
+	if (stat < 0 || stat >= kStatCount)
+		return 0;
+
+	// Late binding, same as the shared handle.  Not having it is not an error.
+	if (pStats == nullptr)
+	{
+		hStatsFile = OpenFileMapping(FILE_MAP_READ, FALSE, KATANGA_STATS_FILE_NAME);
+		if (hStatsFile == NULL)
+			return 0;
+
+		pStats = static_cast<KatangaStatsPage*>(MapViewOfFile(hStatsFile, FILE_MAP_READ, 0, 0, sizeof(KatangaStatsPage)));
+		if (pStats == nullptr)
+		{
+			CloseHandle(hStatsFile);
+			hStatsFile = NULL;
+			return 0;
+		}
+		Log(L"..Katanga:GetHookTiming Stats file opened: %p, DX%d\n", pStats, pStats->dxVersion);
+	}
+
+	if (!KatangaIsStatsValid(pStats))
+		return 0;
+
+	const KatangaHistogram* hist = &pStats->histograms[stat];
+	uint64_t ticks = (percentile >= 100.0f) ? hist->maxTicks.load() : KatangaPercentileTicks(hist, percentile / 100.0);
+
+	return (float)((double)ticks * 1000000.0 / (double)pStats->tickFrequency);
+}
+
+
+// ----------------------------------------------------------------------
+// Frame capture, for recording, screenshots and streaming.  StartCapture and
+// StopCapture come from C#, and only hand the sink to m_Capture, the actual
+// copies and maps happen in CaptureFrame, which C# runs on the render thread
+// with GL.IssuePluginEvent, once per Unity frame.
+//
+// sinkType is a CaptureSinkType.  path is the raw file, or the prefix of the
+// numbered .pns/.png files, and defaults to the Katanga folder if empty.  The
+// shared memory ring ignores it.  Every interval'th frame is captured.
+
+bool RenderAPI_D3D11::StartCapture(int sinkType, const wchar_t* path, int interval)
+{
+	std::wstring target = (path != nullptr) ? path : L"";
+	CaptureSink* sink = nullptr;
+
+	switch (sinkType)
+	{
+	case kCaptureSinkRaw:
+		if (target.empty())
+			target = KatangaFilePath(L"katanga_capture.raw");
+		sink = new RawCaptureSink(Utf8Path(target), OpenCaptureFile);
+		break;
+	case kCaptureSinkPng:
+		if (target.empty())
+			target = KatangaFilePath(L"katanga_capture_");
+		sink = new PngCaptureSink(Utf8Path(target), OpenCaptureFile);
+		break;
+	case kCaptureSinkSharedMemory:
+	{
+		MappedRingCaptureSink* ring = new MappedRingCaptureSink();
+		uint64_t pixelBytes = (uint64_t)gWidth * gHeight * CaptureBytesPerPixel(gFormat);
+		if (pixelBytes == 0 || !ring->Open(pixelBytes))
+		{
+			Log(L"..Katanga:StartCapture cannot make the shared ring for %d x %d: 0x%x\n", gWidth, gHeight, GetLastError());
+			delete ring;
+			return false;
+		}
+		sink = ring;
+		break;
+	}
+	default:
+		Log(L"..Katanga:StartCapture unknown sink: %d\n", sinkType);
+		return false;
+	}
+
+	Log(L"..Katanga:StartCapture sink: %d, path: %s, interval: %d\n", sinkType, target.c_str(), interval);
+	m_Capture.Request(sink, (interval > 0) ? interval : 1);
+	return true;
+}
+
+// The sink still gets whatever was already read back.
+void RenderAPI_D3D11::StopCapture()
+{
+	CaptureStats stats = m_Capture.Stats();
+	Log(L"..Katanga:StopCapture written: %llu, dropped: %llu, failed: %llu, %.1f MB/s\n", stats.written,
+		stats.dropped, stats.failed, CaptureStatValue(stats, kCaptureStatMBPerSecond));
+	m_Capture.Request(nullptr, 1);
+}
+
+// stat is a CaptureStat.
+double RenderAPI_D3D11::GetCaptureStat(int stat)
+{
+	return CaptureStatValue(m_Capture.Stats(), stat);
+}
+
+// Called under slotLock with the slot just taken, or kKatangaMaxSlots when
+// there is none, to hand that to CaptureFrame.  The references only
+// change when the slot does, not every frame.  In the other direction, this
+// is where DetectLayout's last result goes into the shared descriptor.
+
+void RenderAPI_D3D11::SetCaptureSource(UINT slot)
+{
+	ID3D11Texture2D* texture = (slot < kKatangaMaxSlots) ? pSlotTextures[slot] : nullptr;
+	bool validDesc = (pSharedDesc != nullptr && KatangaIsDescriptorValid(pSharedDesc));
+	UINT layout = validDesc ? pSharedDesc->stereoLayout : kLayoutUnknown;
+
+	ID3D11Texture2D* previous = nullptr;
+	bool found = false;
+	StereoDetection detection;
+	{
+		std::lock_guard<std::mutex> lock(captureLock);
+		captureLayout = layout;
+		found = detectPending;
+		detection = detectFound;
+		detectPending = false;
+		if (texture != captureTexture)
+		{
+			if (texture != nullptr)
+				texture->AddRef();
+			previous = captureTexture;
+			captureTexture = texture;
+		}
+	}
+	SAFE_RELEASE(previous);
+
+	if (found && validDesc)
+		KatangaPublishDetectedLayout(pSharedDesc, detection.layout, detection.confidence);
+}
+
+// The slot we are drawing this frame, as of the last TakeLatestFrame.  We take
+// our own reference under captureLock, and never look at pSlotTextures,
+// readSlot or the descriptor here, the main thread changes those as it likes.
+// The copy is queued before the next TakeLatestFrame can trade the slot back.
+
+void RenderAPI_D3D11::CaptureFrame()
+{
+	CaptureSource source = { 0, 0, 0, kLayoutUnknown, 0 };
+
+	ID3D11Texture2D* texture;
+	{
+		std::lock_guard<std::mutex> lock(captureLock);
+		texture = captureTexture;
+		if (texture != nullptr)
+			texture->AddRef();
+		source.layout = captureLayout;
+	}
+
+	if (texture != nullptr)
+	{
+		D3D11_TEXTURE2D_DESC desc;
+		texture->GetDesc(&desc);
+		source.width = desc.Width;
+		source.height = desc.Height;
+		source.format = desc.Format;
+	}
+
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	source.timestamp = now.QuadPart;
+
+	m_CaptureDevice.source = texture;
+	m_Capture.OnFrame(&m_CaptureDevice, source);
+	m_CaptureDevice.source = nullptr;
+
+	DetectLayout(texture);
+
+	SAFE_RELEASE(texture);
+}
+
+
+// ----------------------------------------------------------------------
+// About once a second, one game frame is read back the same way, and
+// StereoDetect.h works out what layout is really in it, in well under a
+// millisecond.  That goes in the shared descriptor, next to the stereoLayout
+// the game side built.  The copy is mapped with DO_NOT_WAIT on the following
+// frames, so this never waits on the GPU.
+//
+// This runs on the render thread from CaptureFrame, with its snapshot of the
+// slot texture.  The result is handed back under captureLock, and the main
+// thread publishes it, so nothing here touches the descriptor.
+
+static const UINT kDetectInterval = 90;
+
+static bool StereoFormatFor(UINT format, StereoPixelFormat* stereo)
+{
+	if (CaptureIs8Bit(format))
+		*stereo = CaptureIsBGR(format) ? kStereoBGRA8 : kStereoRGBA8;
+	else if (format == DXGI_FORMAT_R16G16B16A16_FLOAT)
+		*stereo = kStereoRGBA16Float;
+	else if (format == DXGI_FORMAT_R16G16B16A16_UNORM)
+		*stereo = kStereoRGBA16Unorm;
+	else if (format == DXGI_FORMAT_R32G32B32A32_FLOAT)
+		*stereo = kStereoRGBA32Float;
+	else
+		return false;
+	return true;
+}
+
+void RenderAPI_D3D11::DetectLayout(ID3D11Texture2D* texture)
+{
+	StereoPixelFormat format;
+
+	if (detectCopied)
+	{
+		const uint8_t* pixels = nullptr;
+		uint32_t pitch = 0;
+		CaptureMap result = m_DetectDevice.TryMap(0, &pixels, &pitch);
+		if (result == kCaptureMapPending)
+			return;
+		detectCopied = false;
+		if (result != kCaptureMapReady)
+			return;
+
+		StereoFormatFor(detectDesc.Format, &format);
+		StereoDetection found = StereoDetectPixels(pixels, detectDesc.Width, detectDesc.Height, pitch, format);
+		m_DetectDevice.Unmap(0);
+
+		if (found.layout != detectedLayout)
+			Log(L"..Katanga:DetectLayout layout: %d, confidence: %d, side by side: %.2f, over under: %.2f\n",
+				found.layout, found.confidence, found.sideBySide, found.overUnder);
+		detectedLayout = found.layout;
+
+		std::lock_guard<std::mutex> lock(captureLock);
+		detectFound = found;
+		detectPending = true;
+		return;
+	}
+
+	if (texture == nullptr || ++detectCountdown < kDetectInterval)
+		return;
+	detectCountdown = 0;
+
+	D3D11_TEXTURE2D_DESC desc;
+	texture->GetDesc(&desc);
+	if (!StereoFormatFor(desc.Format, &format) || desc.SampleDesc.Count != 1)
+		return;
+
+	if (desc.Width != detectDesc.Width || desc.Height != detectDesc.Height || desc.Format != detectDesc.Format)
+	{
+		m_DetectDevice.ReleaseStaging();
+		detectDesc = {};
+		if (!m_DetectDevice.CreateStaging(1, desc.Width, desc.Height, desc.Format))
+			return;
+		detectDesc = desc;
+	}
+
+	m_DetectDevice.source = texture;
+	detectCopied = m_DetectDevice.Copy(0);
+	m_DetectDevice.source = nullptr;
 }
 
 
@@ -560,54 +1466,234 @@ DXGI_FORMAT RenderAPI_D3D11::GetGameFormat()
 // the game side, in DX9Ex. This technique is specified in the documentation:
 // https://msdn.microsoft.com/en-us/library/windows/desktop/ff476531(v=vs.85).aspx
 // https://msdn.microsoft.com/en-us/library/windows/desktop/ee913554(v=vs.85).aspx
+//
+// If the game side published a ring of shared surfaces, we open all of them here,
+// and GetLatestSharedSurface will pick which one to draw each frame.  The input
+// HANDLE is always slot 0, and that is the view we return.
+//
+// Surfaces we already have open come from m_SurfaceCache, with no driver calls,
+// so opening the same ring again only costs a lookup.  Anything else in the
+// cache is from a ring the game side has replaced, and is released first, so
+// we do not keep the game's old surfaces alive.
 
 ID3D11ShaderResourceView* RenderAPI_D3D11::CreateSharedSurface(HANDLE shared)
 {
+	TraceScope("CreateSharedSurface");
+
 	Log(L"..Katanga:CreateSharedSurface called. shared:%p\n", shared);
 
 	if (shared == NULL) FatalExit(L"CreateSharedSurface called with NULL handle.\n", GetLastError());
 
-	// When called after a ResizeBuffers, we want to dispose the old.
-	if (pTexture2D != nullptr)
-		pTexture2D->Release();
-	if (pSRView != nullptr)
-		pSRView->Release();
+	std::lock_guard<std::mutex> lock(slotLock);
+
+	// When called after a ResizeBuffers, we want to let go of the old.  The
+	// textures and views themselves are in the cache, until pruned below.
+	if (keyedMutex)
+		consumerKeys.ReleaseSlot(&slotMutexes, readSlot);
+	keyedMutex = false;
+
+	SetCaptureSource(kKatangaMaxSlots);
 
+	for (UINT i = 0; i < kKatangaMaxSlots; i++)
+	{
+		SAFE_RELEASE(slotMutexes.mutexes[i]);
+		pSlotTextures[i] = nullptr;
+		pSlotViews[i] = nullptr;
+	}
+
+	bool validDesc = (pSharedDesc != nullptr && KatangaIsDescriptorValid(pSharedDesc));
+
+	HANDLE slotHandles[kKatangaMaxSlots] = { shared };
+	slotCount = 1;
+	if (validDesc && pSharedDesc->slotCount == kKatangaMaxSlots && pSharedDesc->slotHandles[0] == PtrToUint(shared))
+	{
+		slotCount = kKatangaMaxSlots;
+		for (UINT i = 1; i < slotCount; i++)
+			slotHandles[i] = UlongToHandle(pSharedDesc->slotHandles[i]);
+	}
+
+	// Matching the game side, which starts writing to slot 0 with slot 1 in the
+	// mailbox, this is the one left for us.
+	readSlot = slotCount - 1;
+
+	uint32_t publishedHandles[kKatangaMaxSlots];
+	for (UINT i = 0; i < slotCount; i++)
+		publishedHandles[i] = HandleToUlong(slotHandles[i]);
+	m_SurfaceCache.Retain(publishedHandles, slotCount);
 
 	HRESULT hr;
 
-	// Even though the input shared surface is a RenderTarget Surface, this
-	// Query for Texture2D still works.  Not sure if it is good or bad.
-	hr = m_Device->OpenSharedResource(shared, __uuidof(ID3D11Texture2D), (void**)(&pTexture2D));
-	Log(L"....OpenSharedResource on shared: %p, result: %d, resource: %p\n", shared, hr, pTexture2D);
+	// An older game plugin does not publish the description, then the handle
+	// alone is the key.
+	SharedSurfaceKey key = { 0, 0, 0, 0 };
+	if (validDesc)
+	{
+		key.width = pSharedDesc->width;
+		key.height = pSharedDesc->height;
+		key.format = pSharedDesc->format;
+	}
+
+	for (UINT i = 0; i < slotCount; i++)
+	{
+		key.handle = HandleToUlong(slotHandles[i]);
+		if (m_SurfaceCache.Find(key, &pSlotTextures[i], &pSlotViews[i]))
+		{
+			Log(L"....Reusing shared: %p, resource: %p, SRView: %p, cache hits: %llu\n",
+				slotHandles[i], pSlotTextures[i], pSlotViews[i], m_SurfaceCache.Hits());
+			continue;
+		}
+
+		// Even though the input shared surface is a RenderTarget Surface, this
+		// Query for Texture2D still works.  Not sure if it is good or bad.
+		{
+			TraceScope("OpenSharedResource");
+			hr = m_Device->OpenSharedResource(slotHandles[i], __uuidof(ID3D11Texture2D), (void**)(&pSlotTextures[i]));
+		}
+		Log(L"....OpenSharedResource on shared: %p, result: %d, resource: %p\n", slotHandles[i], hr, pSlotTextures[i]);
+
+		if (FAILED(hr) || (pSlotTextures[i] == nullptr)) FatalExit(L"Failed to open shared surface.", hr);
+
+		// This is theoretically the exact same surface in the video card memory,
+		// that the game's DX11 is using as the stereo shared surface. 
+		//
+		// Now we need to create a ShaderResourceView using this, because that
+		// is what Unity requires for its CreateExternalTexture.
+		//
+		// No need to change description, we want it to be the same as what the game
+		// specifies, so passing NULL to make it identical.
+
+		hr = m_Device->CreateShaderResourceView(pSlotTextures[i], NULL, &pSlotViews[i]);
+		Log(L"....CreateShaderResourceView on texture: %p, result: %d, SRView: %p\n", pSlotTextures[i], hr, pSlotViews[i]);
+		if (FAILED(hr))	FatalExit(L"Failed to CreateShaderResourceView.", hr);
+
+		m_SurfaceCache.Insert(key, pSlotTextures[i], pSlotViews[i]);
+	}
+
+	// Keyed mode only makes sense with the full ring, the keys follow the mailbox.
+	if (slotCount == kKatangaMaxSlots && (pSharedDesc->surfaceFlags & kKatangaSurfaceKeyedMutex))
+	{
+		for (UINT i = 0; i < slotCount; i++)
+		{
+			hr = pSlotTextures[i]->QueryInterface(__uuidof(IDXGIKeyedMutex), (void**)(&slotMutexes.mutexes[i]));
+			if (FAILED(hr)) FatalExit(L"Failed to QueryInterface IDXGIKeyedMutex on shared surface.", hr);
+		}
+		keyedMutex = true;
+		consumerKeys.Reset();
+	}
 
-	if (FAILED(hr) || (pTexture2D == nullptr)) FatalExit(L"Failed to open shared surface.", hr);
+	// Nothing to show in keyed mode until TakeLatestFrame holds a slot.
+	takenSlot = keyedMutex ? kKatangaMaxSlots : readSlot;
 
 	// By capturing the Width/Height/Format here, we can let Unity side
-	// know what buffer to build to match.
-	D3D11_TEXTURE2D_DESC tdesc;
-	pTexture2D->GetDesc(&tdesc);
-	gWidth = tdesc.Width;
-	gHeight = tdesc.Height;
-	gFormat = tdesc.Format;
-
-	Log(L"....Successful GetDesc on surface - Width: %d, Height: %d, Format: %d\n",
-		tdesc.Width, tdesc.Height, tdesc.Format);
-
-	// This is theoretically the exact same surface in the video card memory,
-	// that the game's DX11 is using as the stereo shared surface. 
-	//
-	// Now we need to create a ShaderResourceView using this, because that
-	// is what Unity requires for its CreateExternalTexture.
-	//
-	// No need to change description, we want it to be the same as what the game
-	// specifies, so passing NULL to make it identical.
-
-	hr = m_Device->CreateShaderResourceView(pTexture2D, NULL, &pSRView);
-	Log(L"....CreateShaderResourceView on texture: %p, result: %d, SRView: %p\n", pTexture2D, hr, pSRView);
-	if (FAILED(hr))	FatalExit(L"Failed to CreateShaderResourceView.", hr);
-
-	return pSRView;
+	// know what buffer to build to match.  The game side publishes these
+	// in the shared descriptor, so only ask the driver if the game side
+	// could not translate the format.
+	if (validDesc && pSharedDesc->format != DXGI_FORMAT_UNKNOWN)
+	{
+		gWidth = pSharedDesc->width;
+		gHeight = pSharedDesc->height;
+		gFormat = (DXGI_FORMAT)pSharedDesc->format;
+	}
+	else
+	{
+		D3D11_TEXTURE2D_DESC tdesc;
+		pSlotTextures[0]->GetDesc(&tdesc);
+		gWidth = tdesc.Width;
+		gHeight = tdesc.Height;
+		gFormat = tdesc.Format;
+	}
+
+	Log(L"....Shared surface - Width: %d, Height: %d, Format: %d, Slots: %d, KeyedMutex: %d, cached: %d, evictions: %llu\n",
+		gWidth, gHeight, gFormat, slotCount, keyedMutex, m_SurfaceCache.Count(), m_SurfaceCache.Evictions());
+
+	return pSlotViews[0];
+}
+
+// Called every frame from Update, after GrabSetupMutex, to get the view for the
+// newest complete game frame, as TakeLatestFrame last took it on the render
+// thread.  C# sends that event right after this, named for the slot we return
+// here, from GetShownSlot.
+
+ID3D11ShaderResourceView* RenderAPI_D3D11::GetLatestSharedSurface()
+{
+	shownSlot = takenSlot;
+	return (shownSlot < kKatangaMaxSlots) ? pSlotViews[shownSlot] : nullptr;
+}
+
+UINT RenderAPI_D3D11::GetShownSlot()
+{
+	return shownSlot;
+}
+
+// Called on the render thread once per Unity frame, from the event C# sends in
+// Update, after it set Unity's texture to the slot shown.  When the game side
+// has not presented since last frame, we keep the slot we have, and Unity can
+// keep drawing it.  With a single shared surface, this is always that one, and
+// we only tell the game side when we looked.
+//
+// In keyed mutex mode, the keyed mutexes are only touched here, on the render
+// thread, in order with Unity's draws.  Everything queued before this event is
+// behind us, so the slot we traded back last time can go back to the game side
+// with key 0, unless the main thread was still showing it for the frame that
+// follows.  Until then we take no fresher slot, see KatangaKeyedMutex.h.
+//
+// Whichever slot we take, CaptureFrame gets it too, from SetCaptureSource.
+
+void RenderAPI_D3D11::TakeLatestFrame(UINT shown)
+{
+	std::lock_guard<std::mutex> lock(slotLock);
+
+	if (pSharedDesc == nullptr)
+	{
+		SetCaptureSource(0);
+		takenSlot = 0;
+		return;
+	}
+
+	// Whatever we take below, tell the game side's frame pacer when we looked.
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+
+	// DX9 games have the one surface and no ring, but pace their copies too.
+	if (slotCount < kKatangaMaxSlots)
+	{
+		if (KatangaIsDescriptorValid(pSharedDesc))
+			KatangaConsumerSampled(pSharedDesc, now.QuadPart);
+		SetCaptureSource(0);
+		takenSlot = 0;
+		return;
+	}
+
+	if (!keyedMutex)
+	{
+		readSlot = KatangaAcquireLatestSlot(pSharedDesc, readSlot);
+	}
+	else
+	{
+		if (consumerKeys.Traded() != shown)
+			consumerKeys.ReleaseTraded(&slotMutexes);
+
+		// If we could not take the fresh frame, we show the one we hold again,
+		// and do not tell the pacer we have seen the new one.  Nothing at all
+		// until we hold one, the first slot was never written.
+		KatangaKeyedTake take = consumerKeys.TakeLatest(&slotMutexes, pSharedDesc, &readSlot);
+		if (take == kKeyedTakeBusy)
+			Log(L"..Katanga:TakeLatestFrame: keyed mutex not released for fresh slot, keeping %d, skips: %llu\n",
+				readSlot, consumerKeys.Skipped());
+		if (take == kKeyedTakeBusy || take == kKeyedTakeReplaced)
+		{
+			UINT held = consumerKeys.Held() ? readSlot : kKatangaMaxSlots;
+			SetCaptureSource(held);
+			takenSlot = held;
+			return;
+		}
+	}
+
+	KatangaConsumerSampled(pSharedDesc, now.QuadPart);
+
+	UINT taken = (keyedMutex && !consumerKeys.Held()) ? kKatangaMaxSlots : readSlot;
+	SetCaptureSource(taken);
+	takenSlot = taken;
 }
 
 #endif // #if SUPPORT_D3D11
@@ -2,10 +2,16 @@
 
 #include "PlatformBase.h"
 #include "RenderAPI.h"
+#include "RowPool.h"
+#include "SlideCache.h"
+#include "SlideIndex.h"
+#include "TextureGenerator.h"
 
 #include <windows.h>
 #include <assert.h>
 #include <math.h>
+#include <string>
+#include <thread>
 #include <vector>
 
 #include <d3d11.h>
@@ -56,6 +62,15 @@ static void UNITY_INTERFACE_API OnGraphicsDeviceEvent(UnityGfxDeviceEventType ev
 static IUnityInterfaces* s_UnityInterfaces = NULL;
 static IUnityGraphics* s_Graphics = NULL;
 
+// Threads for ModifyTexturePixels, stopped here at unload, not at DLL detach.
+static RowPool s_RowPool;
+
+// Same for the SlideShow decoders, see SlideCacheStart below.
+static SlideCache s_SlideCache;
+
+// And the SlideShow folder's indexer, see SlideIndexOpen.
+static SlideIndexer s_SlideIndexer;
+
 extern "C" void	UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API UnityPluginLoad(IUnityInterfaces* unityInterfaces)
 {
 	s_UnityInterfaces = unityInterfaces;
@@ -69,6 +84,9 @@ extern "C" void	UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API UnityPluginLoad(IUnit
 extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API UnityPluginUnload()
 {
 	s_Graphics->UnregisterDeviceEventCallback(OnGraphicsDeviceEvent);
+	s_RowPool.Stop();
+	s_SlideCache.Stop();
+	s_SlideIndexer.Stop();
 }
 
 
@@ -123,6 +141,10 @@ extern "C" UNITY_INTERFACE_EXPORT ID3D11ShaderResourceView* UNITY_INTERFACE_API
 {
 	return s_CurrentAPI->CreateSharedSurface(sharedHandle);
 }
+extern "C" UNITY_INTERFACE_EXPORT ID3D11ShaderResourceView* UNITY_INTERFACE_API GetLatestSharedTexture()
+{
+	return s_CurrentAPI->GetLatestSharedSurface();
+}
 
 
 extern "C" UNITY_INTERFACE_EXPORT UINT UNITY_INTERFACE_API GetGameWidth()
@@ -168,6 +190,77 @@ extern "C" UNITY_INTERFACE_EXPORT UINT UNITY_INTERFACE_API GetSharedHandleIPC()
 	return s_CurrentAPI->GetSharedHandleIPC();
 }
 
+// Count of wakeups from the game side, so C# can yield until it changes.
+extern "C" UNITY_INTERFACE_EXPORT UINT UNITY_INTERFACE_API GetNotifyGeneration()
+{
+	return s_CurrentAPI->GetNotifyGeneration();
+}
+
+// Same count, but blocks until it is not seenGeneration, or for timeoutMs.
+// Only from a thread of C#'s own, never Unity's main or render thread.
+extern "C" UNITY_INTERFACE_EXPORT UINT UNITY_INTERFACE_API WaitForNotifyGeneration(UINT seenGeneration, UINT timeoutMs)
+{
+	return s_CurrentAPI->WaitForNotifyGeneration(seenGeneration, timeoutMs);
+}
+extern "C" UNITY_INTERFACE_EXPORT void UNITY_INTERFACE_API SetFrameNotify(bool wanted)
+{
+	return s_CurrentAPI->SetFrameNotify(wanted);
+}
+
+// Copy less of the game frame, and what the game did, see CopyPlan.h in the
+// game plugin.  crop is 4 floats, x, y, width and height.
+extern "C" UNITY_INTERFACE_EXPORT void UNITY_INTERFACE_API SetCopyRequest(int mode, float x, float y, float width, float height)
+{
+	return s_CurrentAPI->SetCopyRequest(mode, x, y, width, height);
+}
+extern "C" UNITY_INTERFACE_EXPORT int UNITY_INTERFACE_API GetGameCopy(int* eyeWidth, int* eyeHeight, float* crop)
+{
+	return s_CurrentAPI->GetGameCopy(eyeWidth, eyeHeight, crop);
+}
+
+// Game side Present hook timing, stat is a KatangaStat, result in microseconds.
+extern "C" UNITY_INTERFACE_EXPORT float UNITY_INTERFACE_API GetHookTiming(int stat, float percentile)
+{
+	return s_CurrentAPI->GetHookTiming(stat, percentile);
+}
+
+// Reading game frames back to a file or shared memory, see FrameCapture.h.  The
+// frames are only taken at kCaptureFrameEvent, which C# sends every frame, and
+// which also does the stereo layout detection.
+extern "C" UNITY_INTERFACE_EXPORT bool UNITY_INTERFACE_API StartCapture(int sinkType, const wchar_t* path, int interval)
+{
+	return s_CurrentAPI->StartCapture(sinkType, path, interval);
+}
+extern "C" UNITY_INTERFACE_EXPORT void UNITY_INTERFACE_API StopCapture()
+{
+	return s_CurrentAPI->StopCapture();
+}
+extern "C" UNITY_INTERFACE_EXPORT double UNITY_INTERFACE_API GetCaptureStat(int stat)
+{
+	return s_CurrentAPI->GetCaptureStat(stat);
+}
+
+
+// The plasma fill used to be four sinf and a sqrtf per pixel, all on the render
+// thread, which at full game resolution took far longer than a VR frame.  Now
+// the generator precomputes what it can per frame, and the rows are split
+// across the RowPool.
+
+static PlasmaGenerator s_Plasma;
+static TextureGenerator* s_Generator = &s_Plasma;
+
+struct GenerateJob
+{
+	TextureGenerator* generator;
+	unsigned char* image;
+	int rowPitch;
+};
+
+static void GenerateTile(void* context, int rowBegin, int rowEnd)
+{
+	GenerateJob* job = (GenerateJob*)context;
+	job->generator->GenerateRows(job->image, job->rowPitch, rowBegin, rowEnd);
+}
 
 static void ModifyTexturePixels()
 {
@@ -182,35 +275,10 @@ static void ModifyTexturePixels()
 	if (!textureDataPtr)
 		return;
 
-	const float t = g_Time * 4.0f;
+	s_Generator->BeginFrame(width, height, g_Time);
 
-	unsigned char* dst = (unsigned char*)textureDataPtr;
-	for (int y = 0; y < height; ++y)
-	{
-		unsigned char* ptr = dst;
-		for (int x = 0; x < width; ++x)
-		{
-			// Simple "plasma effect": several combined sine waves
-			int vv = int(
-				(127.0f + (127.0f * sinf(x / 7.0f + t))) +
-				(127.0f + (127.0f * sinf(y / 5.0f - t))) +
-				(127.0f + (127.0f * sinf((x + y) / 6.0f - t))) +
-				(127.0f + (127.0f * sinf(sqrtf(float(x*x + y*y)) / 4.0f - t)))
-				) / 4;
-
-			// Write the texture pixel
-			ptr[0] = vv;
-			ptr[1] = vv;
-			ptr[2] = vv;
-			ptr[3] = vv;
-
-			// To next pixel (our pixels are 4 bpp)
-			ptr += 4;
-		}
-
-		// To next image row
-		dst += textureRowPitch;
-	}
+	GenerateJob job = { s_Generator, (unsigned char*)textureDataPtr, textureRowPitch };
+	s_RowPool.Run(height, 16, GenerateTile, &job);
 
 	s_CurrentAPI->EndModifyTexture(textureHandle, width, height, textureRowPitch, textureDataPtr);
 }
@@ -220,8 +288,12 @@ static void ModifyTexturePixels()
 // --------------------------------------------------------------------------
 // OnRenderEvent
 // This will be called for GL.IssuePluginEvent script calls; eventID will
-// be the integer passed to IssuePluginEvent. In this example, we just ignore
-// that value.
+// be the integer passed to IssuePluginEvent.  kTakeFrameEvent carries the slot
+// C# is showing in its low byte, see GetTakeFrameEvent.  Anything else is the
+// old example texture fill.
+
+static const int kCaptureFrameEvent = 1;
+static const int kTakeFrameEvent = 0x100;
 
 static void UNITY_INTERFACE_API OnRenderEvent(int eventID)
 {
@@ -229,7 +301,12 @@ static void UNITY_INTERFACE_API OnRenderEvent(int eventID)
 	if (s_CurrentAPI == NULL)
 		return;
 
-	ModifyTexturePixels();
+	if (eventID == kCaptureFrameEvent)
+		s_CurrentAPI->CaptureFrame();
+	else if ((eventID & ~0xFF) == kTakeFrameEvent)
+		s_CurrentAPI->TakeLatestFrame(eventID & 0xFF);
+	else
+		ModifyTexturePixels();
 }
 
 
@@ -241,6 +318,141 @@ extern "C" UnityRenderingEvent UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetRen
 	return OnRenderEvent;
 }
 
+// The event for C# to send right after GetLatestSharedTexture, so the slots are
+// taken and let go on the render thread, in order with the draws that use them.
+extern "C" UNITY_INTERFACE_EXPORT int UNITY_INTERFACE_API GetTakeFrameEvent()
+{
+	return kTakeFrameEvent | (int)s_CurrentAPI->GetShownSlot();
+}
+
+
+// --------------------------------------------------------------------------
+// SlideShow decoding, ahead of time on worker threads, see SlideCache.h.
+//
+// C# starts it with how many slides to decode ahead and behind, the size to
+// shrink slides to, zero for full size, and how much memory to use.  The files
+// come from SlideIndexUseForSlides below.  On each slide change C# calls
+// SlideCacheGet for the BGRA pixels, which it uploads with LoadRawTextureData,
+// and SlideCacheShow so the next ones get decoded.  None of these are on the render thread.
+
+static std::shared_ptr<const SlideImage> s_SlideShown;		// Last SlideCacheGet.
+
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SlideCacheStart(int ahead, int behind, int maxWidth, int maxHeight, int megabytes)
+{
+	extern SlideDecoder* CreateSlideDecoder_WIC();
+
+	// Leave Unity's main and render threads alone.
+	int workers = (int)std::thread::hardware_concurrency() - 2;
+	s_SlideCache.Start(CreateSlideDecoder_WIC(), workers, ahead, behind, (size_t)megabytes << 20, maxWidth, maxHeight);
+}
+
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SlideCacheStop()
+{
+	s_SlideShown.reset();
+	s_SlideCache.Stop();
+}
+
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SlideCacheShow(int index)
+{
+	s_SlideCache.Show(index);
+}
+
+// The pixels of the slide, top row first, or null if it did not decode within
+// timeoutMs.  They stay valid until the next SlideCacheGet.
+extern "C" void* UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SlideCacheGet(int index, int timeoutMs, int* width, int* height)
+{
+	s_SlideShown = s_SlideCache.Wait(index, timeoutMs);
+	if (!s_SlideShown)
+	{
+		*width = *height = 0;
+		return nullptr;
+	}
+	*width = (int)s_SlideShown->width;
+	*height = (int)s_SlideShown->height;
+	return (void*)s_SlideShown->pixels.data();
+}
+
+
+// --------------------------------------------------------------------------
+// The SlideShow folder, from an index file instead of listing it, see
+// SlideIndex.h.
+//
+// SlideIndexOpen gives the pictures the last launch knew about at once, and
+// checks the folder for changes in the background.  Whenever the list changes
+// SlideIndexGeneration does, and C# calls SlideIndexUseForSlides again, which
+// hands the list to SlideCache.  Slide numbers are in that list, the one
+// SlideCache has, which leaves out pictures that don't decode.
+
+static std::vector<std::string> s_SlidePaths;
+static std::vector<int> s_SlideEntries;			// Index entry of each slide.
+
+// Returns how many slides there are.
+extern "C" int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SlideIndexUseForSlides()
+{
+	s_SlideIndexer.Paths(&s_SlidePaths, &s_SlideEntries);
+	s_SlideShown.reset();
+	s_SlideCache.SetFiles(s_SlidePaths);
+	return (int)s_SlidePaths.size();
+}
+
+extern "C" int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SlideIndexOpen(const wchar_t* folder)
+{
+	extern SlideIndexStore* CreateSlideIndexStore_Win32(const wchar_t* folder);
+	extern SlideDecoder* CreateSlideDecoder_WIC();
+
+	s_SlideIndexer.Start(CreateSlideIndexStore_Win32(folder), CreateSlideDecoder_WIC());
+	return SlideIndexUseForSlides();
+}
+
+extern "C" unsigned int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SlideIndexGeneration()
+{
+	return s_SlideIndexer.Generation();
+}
+
+extern "C" bool UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SlideIndexScanning()
+{
+	return s_SlideIndexer.Stats().scanning;
+}
+
+// The full path of slide, for when C# has to load it itself.  Returns the
+// length, or 0 if there is no such slide or it does not fit in capacity.
+extern "C" int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SlideIndexPath(int slide, wchar_t* path, int capacity)
+{
+	if (slide < 0 || slide >= (int)s_SlidePaths.size() || capacity <= 0)
+		return 0;
+	const std::string& utf8 = s_SlidePaths[slide];
+	int length = MultiByteToWideChar(CP_UTF8, 0, utf8.c_str(), (int)utf8.size(), NULL, 0);
+	if (length >= capacity)
+		return 0;
+	MultiByteToWideChar(CP_UTF8, 0, utf8.c_str(), (int)utf8.size(), path, capacity);
+	path[length] = L'\0';
+	return length;
+}
+
+// What the index knows about slide without loading it.  Sizes are zero until
+// the background scan gets to a new picture.
+extern "C" bool UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SlideIndexInfo(int slide, int* width, int* height, int* layout)
+{
+	SlideIndexEntry entry;
+	if (slide < 0 || slide >= (int)s_SlideEntries.size() || !s_SlideIndexer.Entry(s_SlideEntries[slide], &entry))
+		return false;
+	*width = (int)entry.width;
+	*height = (int)entry.height;
+	*layout = (int)entry.layout;
+	return true;
+}
+
+// The 32 x 16 RGB565 thumbnail of one eye, top row first, for a picker.
+extern "C" bool UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SlideIndexThumbnail(int slide, uint16_t* pixels)
+{
+	SlideIndexEntry entry;
+	if (slide < 0 || slide >= (int)s_SlideEntries.size() || !s_SlideIndexer.Entry(s_SlideEntries[slide], &entry) ||
+		(entry.flags & kSlidePending))
+		return false;
+	memcpy(pixels, entry.thumbnail, sizeof(entry.thumbnail));
+	return true;
+}
+
 
 // --------------------------------------------------------------------------
 // SelectGameDialog, to use windows select dialog to choose game exe.
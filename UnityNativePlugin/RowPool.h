@@ -0,0 +1,153 @@
+#pragma once
+
+//-----------------------------------------------------------
+// Small thread pool for filling an image in bands of rows.
+//
+// Run hands out tiles of rows from a single atomic counter, so whichever thread
+// is free takes the next tile, and a thread that lands on slow rows does not hold
+// up the others.  The calling thread works on tiles too, and Run returns only
+// once every row is done, so to the caller it's just a faster loop.
+//
+// Workers are started on the first Run, so nothing is created unless some
+// generator actually runs.  Stop must be called before the DLL unloads, because
+// joining threads from DllMain deadlocks on the loader lock.
+
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class RowPool
+{
+public:
+	// Leave room for Unity's main and render threads, we are only the fallback.
+	static const int kMaxWorkers = 7;
+
+	typedef void (*RowFunc)(void* context, int rowBegin, int rowEnd);
+
+	RowPool() { }
+
+	// Same as AsyncLog, a joinable std::thread at process exit would terminate.
+	~RowPool()
+	{
+		for (std::thread& worker : workers)
+		{
+			if (worker.joinable())
+				worker.detach();
+		}
+	}
+
+	RowPool(const RowPool&) = delete;
+	RowPool& operator=(const RowPool&) = delete;
+
+	// Calls func for every tile of rows in [0, rows), from any of the threads,
+	// with no two calls overlapping the same rows.
+
+	void Run(int rows, int tileRows, RowFunc func, void* context)
+	{
+		if (!started)
+			Start();
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			jobFunc = func;
+			jobContext = context;
+			jobRows = rows;
+			jobTile = std::max(tileRows, 1);
+			nextRow.store(0, std::memory_order_relaxed);
+			pending = (int)workers.size();
+			generation++;
+		}
+		wake.notify_all();
+
+		DoTiles();
+
+		// Every worker has to check in, even if it found no rows left, so that
+		// none of them can still be looking at this job when the next one starts.
+		std::unique_lock<std::mutex> lock(mutex);
+		done.wait(lock, [this] { return pending == 0; });
+	}
+
+	void Stop()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+
+		for (std::thread& worker : workers)
+			worker.join();
+		workers.clear();
+	}
+
+	int WorkerCount() const
+	{
+		return (int)workers.size();
+	}
+
+private:
+	void Start()
+	{
+		started = true;
+
+		int cores = (int)std::thread::hardware_concurrency();
+		int count = std::min(std::max(cores - 2, 0), (int)kMaxWorkers);
+
+		for (int i = 0; i < count; i++)
+			workers.emplace_back(&RowPool::WorkerThread, this);
+	}
+
+	void WorkerThread()
+	{
+		uint64_t seen = 0;
+
+		for (;;)
+		{
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wake.wait(lock, [&] { return stopping || generation != seen; });
+				if (stopping)
+					return;
+				seen = generation;
+			}
+
+			DoTiles();
+
+			std::lock_guard<std::mutex> lock(mutex);
+			if (--pending == 0)
+				done.notify_one();
+		}
+	}
+
+	void DoTiles()
+	{
+		for (;;)
+		{
+			int row = nextRow.fetch_add(jobTile, std::memory_order_relaxed);
+			if (row >= jobRows)
+				return;
+			jobFunc(jobContext, row, std::min(row + jobTile, jobRows));
+		}
+	}
+
+	std::vector<std::thread> workers;
+	bool started = false;
+
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	uint64_t generation = 0;
+	int pending = 0;
+	bool stopping = false;
+
+	// The current job, only changed under the mutex while no worker is in DoTiles.
+	RowFunc jobFunc = nullptr;
+	void* jobContext = nullptr;
+	int jobRows = 0;
+	int jobTile = 1;
+	std::atomic<int> nextRow { 0 };
+};
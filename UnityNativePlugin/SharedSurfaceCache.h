@@ -0,0 +1,162 @@
+#pragma once
+
+//-----------------------------------------------------------
+// The shared surfaces we have open, so that CreateSharedSurface does not go
+// back to the driver for a handle we already have open.
+//
+// Each entry is the texture from OpenSharedResource and the view we made for
+// it, keyed by the shared handle and the description the game side published
+// with it.  Holding our reference keeps the game's resource alive, so its
+// handle cannot be reused for a different surface while it is in here.
+//
+// That also means an entry must not outlive its handle being published.  The
+// game side makes new surfaces, with new handles, for every resize, reset or
+// copy mode change, and releases the old ones, so nothing carries over a
+// rebuild.  A handle we still held open would only keep the game's old
+// surface alive for nothing.  So CreateSharedSurface calls Retain with the
+// handles now published first, which releases everything else, and only a
+// reopen of the same ring is a hit.  There is room for just that one ring.
+//
+// The cache holds the only reference to each, and CreateSharedSurface only
+// borrows them.  Every lookup or insert makes that entry the most recently
+// used, and a full cache releases the least recently used.
+//
+// TTexture and TView only need COM style Release, so any fake can stand in.
+
+#include <stdint.h>
+
+struct SharedSurfaceKey
+{
+	uint32_t handle;
+	uint32_t width;
+	uint32_t height;
+	uint32_t format;
+
+	bool operator==(const SharedSurfaceKey& other) const
+	{
+		return handle == other.handle && width == other.width &&
+			height == other.height && format == other.format;
+	}
+};
+
+template <class TTexture, class TView>
+class SharedSurfaceCache
+{
+public:
+	static const int kCapacity = 3;						// kKatangaMaxSlots
+
+	SharedSurfaceCache() { }
+	~SharedSurfaceCache() { Clear(); }
+
+	SharedSurfaceCache(const SharedSurfaceCache&) = delete;
+	SharedSurfaceCache& operator=(const SharedSurfaceCache&) = delete;
+
+	// Returns true with the texture and view if key is already open.  These
+	// are not AddRef'd, they stay valid until evicted or cleared.
+
+	bool Find(const SharedSurfaceKey& key, TTexture** texture, TView** view)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			if (entries[i].key == key)
+			{
+				entries[i].lastUse = ++clock;
+				*texture = entries[i].texture;
+				*view = entries[i].view;
+				hits++;
+				return true;
+			}
+		}
+
+		misses++;
+		return false;
+	}
+
+	// Takes over the caller's reference to both.  Key must not be in the cache.
+	void Insert(const SharedSurfaceKey& key, TTexture* texture, TView* view)
+	{
+		int slot = count;
+		if (count == kCapacity)
+		{
+			slot = 0;
+			for (int i = 1; i < count; i++)
+			{
+				if (entries[i].lastUse < entries[slot].lastUse)
+					slot = i;
+			}
+			ReleaseEntry(entries[slot]);
+			evictions++;
+		}
+		else
+		{
+			count++;
+		}
+
+		entries[slot].key = key;
+		entries[slot].texture = texture;
+		entries[slot].view = view;
+		entries[slot].lastUse = ++clock;
+	}
+
+	// Releases every entry whose handle is not one of the count in handles.
+
+	void Retain(const uint32_t* handles, int handleCount)
+	{
+		for (int i = 0; i < count; )
+		{
+			bool published = false;
+			for (int h = 0; h < handleCount && !published; h++)
+				published = (entries[i].key.handle == handles[h]);
+
+			if (published)
+			{
+				i++;
+				continue;
+			}
+
+			ReleaseEntry(entries[i]);
+			entries[i] = entries[--count];
+			evictions++;
+		}
+	}
+
+	void Clear()
+	{
+		for (int i = 0; i < count; i++)
+			ReleaseEntry(entries[i]);
+		count = 0;
+	}
+
+	int Count() const { return count; }
+
+	uint64_t Hits() const { return hits; }
+	uint64_t Misses() const { return misses; }
+	uint64_t Evictions() const { return evictions; }
+
+private:
+	struct Entry
+	{
+		SharedSurfaceKey key;
+		TTexture* texture;
+		TView* view;
+		uint64_t lastUse;
+	};
+
+	static void ReleaseEntry(Entry& entry)
+	{
+		if (entry.view)
+			entry.view->Release();
+		if (entry.texture)
+			entry.texture->Release();
+		entry.view = nullptr;
+		entry.texture = nullptr;
+	}
+
+	Entry entries[kCapacity] = { };
+	int count = 0;
+	uint64_t clock = 0;
+
+	uint64_t hits = 0;
+	uint64_t misses = 0;
+	uint64_t evictions = 0;
+};
@@ -0,0 +1,374 @@
+#pragma once
+
+//-----------------------------------------------------------
+// Decodes SlideShow's pictures ahead of time, on worker threads, so that
+// showing the next one is only a texture upload.
+//
+// Decoding a 3D Vision .jps, a double wide JPEG, takes tens of milliseconds,
+// which on Unity's main thread is several dropped frames in the headset, every
+// time the slide changes.  So Show tells us which slide is up, and the workers
+// decode that one and the ahead slides after it and behind before it, nearest
+// first, into a cache of ready BGRA images.  Get then hands back the image
+// with no waiting, or nullptr if it is not done yet.
+//
+// The list of slides wraps around, like the slideshow.  Skipping quickly just
+// replaces the queue, so slides we have gone past are not decoded at all, and
+// the cache is bounded in bytes, dropping the least recently used slides that
+// are outside the window first.
+//
+// The decoding itself is behind SlideDecoder, which SlideDecoder_WIC.cpp does
+// with the Windows Imaging Component and YCbCrConvert.h.
+
+#include <limits.h>
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+
+// BGRA, top row first, rows packed at width * 4.
+struct SlideImage
+{
+	uint32_t width = 0;
+	uint32_t height = 0;
+	std::vector<uint8_t> pixels;
+
+	// Size of the picture in the file, before any shrinking.
+	uint32_t sourceWidth = 0;
+	uint32_t sourceHeight = 0;
+};
+
+class SlideDecoder
+{
+public:
+	virtual ~SlideDecoder() { }
+
+	// Each worker calls these around its life, for COM.
+	virtual void BeginThread() { }
+	virtual void EndThread() { }
+
+	// Decodes the file at path, UTF-8, shrunk by halves for as long as it still
+	// covers maxWidth x maxHeight, see SlideHalvings.  Zero for full size.
+	virtual bool Decode(const std::string& path, uint32_t maxWidth, uint32_t maxHeight, SlideImage* image) = 0;
+};
+
+struct SlideCacheStats
+{
+	uint64_t hits;					// Get found the slide ready.
+	uint64_t misses;
+	uint64_t decoded;
+	uint64_t failed;
+	uint64_t evicted;
+	int64_t decodeNs;				// Total in Decode, over all workers.
+	size_t count;					// Slides in the cache now.
+	size_t bytes;
+};
+
+
+class SlideCache
+{
+public:
+	static const int kMaxWorkers = 4;
+
+	SlideCache() { }
+
+	// Same as RowPool, a joinable std::thread at process exit would terminate.
+	~SlideCache()
+	{
+		for (std::thread& worker : workers)
+		{
+			if (worker.joinable())
+				worker.detach();
+		}
+	}
+
+	SlideCache(const SlideCache&) = delete;
+	SlideCache& operator=(const SlideCache&) = delete;
+
+	// We own decoder from here on.  Starting again stops the old workers first.
+	void Start(SlideDecoder* decoder, int workerCount, int ahead, int behind, size_t maxBytes,
+		uint32_t maxWidth, uint32_t maxHeight)
+	{
+		Stop();
+
+		this->decoder.reset(decoder);
+		this->ahead = std::max(ahead, 0);
+		this->behind = std::max(behind, 0);
+		this->maxBytes = maxBytes;
+		this->maxWidth = maxWidth;
+		this->maxHeight = maxHeight;
+		stopping = false;
+
+		workerCount = std::min(std::max(workerCount, 1), (int)kMaxWorkers);
+		for (int i = 0; i < workerCount; i++)
+			workers.push_back(std::thread(&SlideCache::Worker, this));
+	}
+
+	// Waits for the decodes in progress, and drops everything.
+	void Stop()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+			queue.clear();
+		}
+		wake.notify_all();
+		for (std::thread& worker : workers)
+			worker.join();
+		workers.clear();
+
+		std::lock_guard<std::mutex> lock(mutex);
+		entries.clear();
+		bytes = 0;
+		decoder.reset();
+	}
+
+	// A new list of slides, which forgets the old ones.  Decodes still running
+	// from the old list are forgotten too, their index is some other file now,
+	// and the workers drop what they made when they see the generation moved.
+	void SetFiles(const std::vector<std::string>& paths)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		files = paths;
+		generation++;
+		entries.clear();
+		queue.clear();
+		inFlight.clear();
+		bytes = 0;
+		current = 0;
+	}
+
+	int FileCount()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return (int)files.size();
+	}
+
+	// index is now on screen.  Queues it and its neighbors, nearest first,
+	// replacing whatever was queued for the last one.
+	void Show(int index)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			int count = (int)files.size();
+			if (count == 0)
+				return;
+			current = Wrap(index, count);
+
+			queue.clear();
+			int reach = std::max(ahead, behind);
+			for (int distance = 0; distance <= reach; distance++)
+			{
+				if (distance <= ahead)
+					Enqueue(Wrap(current + distance, count));
+				if (distance > 0 && distance <= behind)
+					Enqueue(Wrap(current - distance, count));
+			}
+		}
+		wake.notify_all();
+	}
+
+	// The decoded slide, or nullptr if it's not ready or failed.  The image
+	// stays valid for as long as the caller holds on to it, even if evicted.
+	std::shared_ptr<const SlideImage> Get(int index)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return Lookup(index);
+	}
+
+	// Same, but waits up to timeoutMs for a slide that is queued or decoding.
+	std::shared_ptr<const SlideImage> Wait(int index, int timeoutMs)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		std::chrono::steady_clock::time_point until = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+		while (!stopping && !files.empty())
+		{
+			int slide = Wrap(index, (int)files.size());
+			std::unordered_map<int, Entry>::iterator found = entries.find(slide);
+			if (found != entries.end())
+				break;
+			bool pending = (inFlight.count(slide) != 0) ||
+				(std::find(queue.begin(), queue.end(), slide) != queue.end());
+			if (!pending || ready.wait_until(lock, until) == std::cv_status::timeout)
+				break;
+		}
+		return Lookup(index);
+	}
+
+	SlideCacheStats Stats()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		SlideCacheStats stats = counters;
+		stats.count = entries.size();
+		stats.bytes = bytes;
+		return stats;
+	}
+
+private:
+	// A failed decode is kept too, with no image, so it is not retried.
+	struct Entry
+	{
+		std::shared_ptr<const SlideImage> image;
+		uint64_t lastUse;
+	};
+
+	static int Wrap(int index, int count)
+	{
+		index %= count;
+		return (index < 0) ? index + count : index;
+	}
+
+	// All the rest need mutex held.
+
+	void Enqueue(int index)
+	{
+		if (entries.count(index) == 0 && inFlight.count(index) == 0 &&
+			std::find(queue.begin(), queue.end(), index) == queue.end())
+			queue.push_back(index);
+	}
+
+	std::shared_ptr<const SlideImage> Lookup(int index)
+	{
+		if (files.empty())
+			return nullptr;
+		std::unordered_map<int, Entry>::iterator found = entries.find(Wrap(index, (int)files.size()));
+		if (found == entries.end() || !found->second.image)
+		{
+			counters.misses++;
+			return nullptr;
+		}
+		counters.hits++;
+		found->second.lastUse = ++useClock;
+		return found->second.image;
+	}
+
+	// How far index is from the current slide, going the way it is queued, or
+	// -1 if it is outside the window.
+	int WindowDistance(int index) const
+	{
+		int count = (int)files.size();
+		int forward = Wrap(index - current, count);
+		int backward = Wrap(current - index, count);
+		if (forward <= ahead)
+			return forward;
+		if (backward <= behind)
+			return backward;
+		return -1;
+	}
+
+	// Outside the window, least recently used first.  Then inside, farthest
+	// first, but never the current slide.  That can be the slide just decoded,
+	// when the window is more than maxBytes holds.
+	void Evict()
+	{
+		while (bytes > maxBytes && entries.size() > 1)
+		{
+			std::unordered_map<int, Entry>::iterator victim = entries.end();
+			int victimDistance = 0;
+			for (std::unordered_map<int, Entry>::iterator it = entries.begin(); it != entries.end(); ++it)
+			{
+				if (it->first == current)
+					continue;
+				int distance = WindowDistance(it->first);
+				distance = (distance < 0) ? INT_MAX : distance;
+				if (victim == entries.end() || distance > victimDistance ||
+					(distance == victimDistance && it->second.lastUse < victim->second.lastUse))
+				{
+					victim = it;
+					victimDistance = distance;
+				}
+			}
+			if (victim == entries.end())
+				return;
+
+			if (victim->second.image)
+				bytes -= victim->second.image->pixels.size();
+			entries.erase(victim);
+			counters.evicted++;
+		}
+	}
+
+	void Worker()
+	{
+		decoder->BeginThread();
+
+		std::unique_lock<std::mutex> lock(mutex);
+		for (;;)
+		{
+			wake.wait(lock, [this] { return stopping || !queue.empty(); });
+			if (stopping)
+				break;
+
+			int index = queue.front();
+			queue.pop_front();
+			std::string path = files[index];
+			uint64_t startGeneration = generation;
+			inFlight.insert(index);
+			lock.unlock();
+
+			std::shared_ptr<SlideImage> image = std::make_shared<SlideImage>();
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			bool ok = decoder->Decode(path, maxWidth, maxHeight, image.get());
+			int64_t took = (int64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now() - start).count();
+
+			// Only ours to take out of inFlight if SetFiles has not cleared it,
+			// the same index may already be decoding again for the new list.
+			lock.lock();
+			if (generation == startGeneration)
+				inFlight.erase(index);
+			counters.decodeNs += took;
+			if (ok)
+				counters.decoded++;
+			else
+				counters.failed++;
+
+			if (generation == startGeneration)
+			{
+				Entry entry;
+				entry.image = ok ? std::shared_ptr<const SlideImage>(image) : nullptr;
+				entry.lastUse = ++useClock;
+				entries[index] = entry;
+				if (ok)
+					bytes += image->pixels.size();
+				Evict();
+			}
+			ready.notify_all();
+		}
+		lock.unlock();
+
+		decoder->EndThread();
+	}
+
+	std::unique_ptr<SlideDecoder> decoder;
+	std::vector<std::thread> workers;
+	int ahead = 0;
+	int behind = 0;
+	size_t maxBytes = 0;
+	uint32_t maxWidth = 0;
+	uint32_t maxHeight = 0;
+
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable ready;
+	bool stopping = false;
+
+	std::vector<std::string> files;
+	uint64_t generation = 0;
+	int current = 0;
+	std::deque<int> queue;
+	std::unordered_set<int> inFlight;			// Of this generation only.
+	std::unordered_map<int, Entry> entries;
+	size_t bytes = 0;
+	uint64_t useClock = 0;
+	SlideCacheStats counters = SlideCacheStats();
+};
@@ -0,0 +1,195 @@
+// Windows Imaging Component implementation of SlideDecoder, for SlideCache.h.
+//
+// JPEGs are decoded to planar Y, Cb and Cr, which WIC can also shrink by halves
+// in the DCT itself, and so almost for free.  Then YCbCrConvert.h makes the BGRA
+// with SSE2.  Anything WIC can't do planar, like a PNG, or a JPEG that is not
+// YCbCr, is decoded to BGRA by WIC, and halved by us.
+//
+// Planar decoding needs Windows 8.1, older versions just take the slow path.
+
+#include "SlideCache.h"
+#include "YCbCrConvert.h"
+
+#include <windows.h>
+#include <wincodec.h>
+
+#pragma comment(lib, "windowscodecs.lib")
+
+
+class SlideDecoder_WIC : public SlideDecoder
+{
+public:
+	// The factory is free threaded, but COM has to be started on each worker.
+	void BeginThread() override
+	{
+		HRESULT hr = CoInitializeEx(NULL, COINIT_MULTITHREADED);
+		comStarted = SUCCEEDED(hr);
+		hr = CoCreateInstance(CLSID_WICImagingFactory, NULL, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&factory));
+		if (FAILED(hr))
+			factory = nullptr;
+	}
+
+	void EndThread() override
+	{
+		if (factory != nullptr)
+			factory->Release();
+		factory = nullptr;
+		if (comStarted)
+			CoUninitialize();
+	}
+
+	bool Decode(const std::string& path, uint32_t maxWidth, uint32_t maxHeight, SlideImage* image) override
+	{
+		if (factory == nullptr)
+			return false;
+
+		std::wstring widePath = WidePath(path);
+		IWICBitmapDecoder* decoder = nullptr;
+		HRESULT hr = factory->CreateDecoderFromFilename(widePath.c_str(), NULL, GENERIC_READ,
+			WICDecodeMetadataCacheOnDemand, &decoder);
+		if (FAILED(hr))
+			return false;
+
+		IWICBitmapFrameDecode* frame = nullptr;
+		hr = decoder->GetFrame(0, &frame);
+		bool ok = false;
+		if (SUCCEEDED(hr))
+		{
+			ok = DecodePlanar(frame, maxWidth, maxHeight, image) ||
+				DecodeBGRA(frame, maxWidth, maxHeight, image);
+			frame->Release();
+		}
+		decoder->Release();
+		return ok;
+	}
+
+private:
+	// Each worker has its own factory pointer, the object is shared.
+	static thread_local IWICImagingFactory* factory;
+	static thread_local bool comStarted;
+
+	static std::wstring WidePath(const std::string& path)
+	{
+		int length = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, NULL, 0);
+		if (length <= 1)
+			return std::wstring();
+		std::wstring wide(length - 1, L'\0');
+		MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, &wide[0], length);
+		return wide;
+	}
+
+	// We only upsample chroma at full or half size, as in 4:4:4, 4:2:2 and 4:2:0.
+	static bool ChromaFits(UINT luma, UINT blue, UINT red)
+	{
+		return blue == red && (blue == luma || blue == (luma + 1) / 2);
+	}
+
+	bool DecodePlanar(IWICBitmapFrameDecode* frame, uint32_t maxWidth, uint32_t maxHeight, SlideImage* image)
+	{
+		IWICPlanarBitmapSourceTransform* planar = nullptr;
+		if (FAILED(frame->QueryInterface(IID_PPV_ARGS(&planar))))
+			return false;
+
+		UINT width, height;
+		frame->GetSize(&width, &height);
+		UINT sourceWidth = width;
+		UINT sourceHeight = height;
+		int halvings = SlideHalvings(width, height, maxWidth, maxHeight);
+		width >>= halvings;
+		height >>= halvings;
+
+		// WIC picks the nearest size it can do at or above what we ask, and
+		// tells us the plane sizes, the chroma ones are smaller when subsampled.
+		const WICPixelFormatGUID formats[3] = { GUID_WICPixelFormat8bppY, GUID_WICPixelFormat8bppCb, GUID_WICPixelFormat8bppCr };
+		WICBitmapPlaneDescription planes[3];
+		BOOL supported = FALSE;
+		HRESULT hr = planar->DoesSupportTransform(&width, &height, WICBitmapTransformRotate0, WICPlanarOptionsDefault,
+			formats, planes, 3, &supported);
+		if (FAILED(hr) || !supported || !ChromaFits(planes[0].Width, planes[1].Width, planes[2].Width) ||
+			!ChromaFits(planes[0].Height, planes[1].Height, planes[2].Height))
+		{
+			planar->Release();
+			return false;
+		}
+
+		int shiftX = (planes[1].Width < planes[0].Width) ? 1 : 0;
+		int shiftY = (planes[1].Height < planes[0].Height) ? 1 : 0;
+
+		std::vector<uint8_t> luma((size_t)planes[0].Width * planes[0].Height);
+		std::vector<uint8_t> blue((size_t)planes[1].Width * planes[1].Height);
+		std::vector<uint8_t> red((size_t)planes[2].Width * planes[2].Height);
+		WICBitmapPlane buffers[3] =
+		{
+			{ formats[0], luma.data(), planes[0].Width, (UINT)luma.size() },
+			{ formats[1], blue.data(), planes[1].Width, (UINT)blue.size() },
+			{ formats[2], red.data(), planes[2].Width, (UINT)red.size() },
+		};
+		hr = planar->CopyPixels(NULL, width, height, WICBitmapTransformRotate0, WICPlanarOptionsDefault, buffers, 3);
+		planar->Release();
+		if (FAILED(hr))
+			return false;
+
+		image->width = planes[0].Width;
+		image->height = planes[0].Height;
+		image->sourceWidth = sourceWidth;
+		image->sourceHeight = sourceHeight;
+		image->pixels.resize((size_t)image->width * image->height * 4);
+		for (UINT y = 0; y < image->height; y++)
+		{
+			size_t chromaRow = (size_t)(y >> shiftY) * planes[1].Width;
+			YCbCrRowToBGRA(&luma[(size_t)y * planes[0].Width], &blue[chromaRow], &red[chromaRow],
+				image->width, shiftX, &image->pixels[(size_t)y * image->width * 4]);
+		}
+
+		// DCT scaling stops at an eighth, anything more is ours.
+		Halve(image, SlideHalvings(image->width, image->height, maxWidth, maxHeight));
+		return true;
+	}
+
+	bool DecodeBGRA(IWICBitmapFrameDecode* frame, uint32_t maxWidth, uint32_t maxHeight, SlideImage* image)
+	{
+		IWICFormatConverter* converter = nullptr;
+		HRESULT hr = factory->CreateFormatConverter(&converter);
+		if (FAILED(hr))
+			return false;
+		hr = converter->Initialize(frame, GUID_WICPixelFormat32bppBGRA, WICBitmapDitherTypeNone, NULL, 0.0,
+			WICBitmapPaletteTypeCustom);
+
+		UINT width = 0, height = 0;
+		if (SUCCEEDED(hr))
+			hr = converter->GetSize(&width, &height);
+		if (SUCCEEDED(hr))
+		{
+			image->width = image->sourceWidth = width;
+			image->height = image->sourceHeight = height;
+			image->pixels.resize((size_t)width * height * 4);
+			hr = converter->CopyPixels(NULL, width * 4, (UINT)image->pixels.size(), image->pixels.data());
+		}
+		converter->Release();
+		if (FAILED(hr))
+			return false;
+
+		Halve(image, SlideHalvings(width, height, maxWidth, maxHeight));
+		return true;
+	}
+
+	static void Halve(SlideImage* image, int halvings)
+	{
+		for (int i = 0; i < halvings; i++)
+		{
+			HalveBGRA(image->pixels.data(), image->width, image->height, (size_t)image->width * 4, image->pixels.data());
+			image->width /= 2;
+			image->height /= 2;
+		}
+		image->pixels.resize((size_t)image->width * image->height * 4);
+	}
+};
+
+thread_local IWICImagingFactory* SlideDecoder_WIC::factory = nullptr;
+thread_local bool SlideDecoder_WIC::comStarted = false;
+
+
+SlideDecoder* CreateSlideDecoder_WIC()
+{
+	return new SlideDecoder_WIC();
+}
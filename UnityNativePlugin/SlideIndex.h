@@ -0,0 +1,524 @@
+#pragma once
+
+//-----------------------------------------------------------
+// An index of the SlideShow folder, kept in a file that is memory mapped, so a
+// launch with thousands of pictures has the list at once, and only the files
+// that changed since are looked at again.
+//
+// SlideIndexer opens the last index right away, and then on its own thread
+// lists the folder, and compares each file by name, modified time and size
+// with the index.  Unchanged files keep what the index had.  New or changed
+// ones are decoded small, for their dimensions, their stereo layout from
+// StereoDetect.h, a tiny RGB565 thumbnail, and whether they decode at all.  The index is written back as the
+// work goes, a temp file and a rename, and mapped again, so quitting midway
+// keeps what was done.  The first write, right after listing, has the new and
+// changed files as pending, so even the very first launch gets the list fast.
+//
+// The file is the header, then count fixed size entries sorted by name, then
+// the names, UTF-8 and relative to the folder.  Fixed widths and offsets only,
+// so any version of us, x32 or x64, can read it straight from the mapping.
+// Anything that does not check out is ignored, and it's rebuilt.
+//
+// The folder, the index file and the mapping are behind SlideIndexStore, which
+// SlideIndexStore_Win32.cpp implements.  The decoding is SlideCache.h's
+// SlideDecoder.
+
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "SlideCache.h"
+#include "StereoDetect.h"
+#include "../DeviarePlugin/KatangaIPC.h"
+
+
+const uint32_t kSlideIndexMagic = 0x494C534B;		// "KSLI" in memory.
+const uint32_t kSlideIndexVersion = 2;
+
+const int kSlideThumbWidth = 32;
+const int kSlideThumbHeight = 16;
+
+enum SlideIndexFlags : uint32_t
+{
+	kSlidePending = 1,					// Listed, not decoded yet.
+	kSlideFailed = 2,					// Does not decode, SlideShow skips it.
+};
+
+struct SlideIndexHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t count;
+	uint32_t entrySize;
+	uint64_t namesOffset;				// From the start of the file.
+	uint64_t namesBytes;
+};
+
+struct SlideIndexEntry
+{
+	uint32_t nameOffset;				// From namesOffset, not terminated.
+	uint32_t nameLength;
+	uint64_t modified;					// Whatever the store uses, only compared.
+	uint64_t size;
+	uint32_t width;						// Of the whole picture, both eyes.
+	uint32_t height;
+	uint32_t layout;					// KatangaStereoLayout.
+	uint32_t flags;						// SlideIndexFlags.
+	uint16_t thumbnail[kSlideThumbWidth * kSlideThumbHeight];	// RGB565, one eye, top row first.
+};
+
+struct SlideIndexFile
+{
+	std::string name;
+	uint64_t modified;
+	uint64_t size;
+};
+
+
+// Reads an index in memory, normally the mapping.  Nothing is copied.
+
+class SlideIndexView
+{
+public:
+	bool Open(const uint8_t* data, size_t size)
+	{
+		Close();
+		if (data == nullptr || size < sizeof(SlideIndexHeader))
+			return false;
+
+		const SlideIndexHeader* header = reinterpret_cast<const SlideIndexHeader*>(data);
+		uint64_t entriesEnd = sizeof(SlideIndexHeader) + (uint64_t)header->count * sizeof(SlideIndexEntry);
+		if (header->magic != kSlideIndexMagic || header->version != kSlideIndexVersion ||
+			header->entrySize != sizeof(SlideIndexEntry) || header->namesOffset < entriesEnd ||
+			header->namesOffset > size || header->namesBytes > size - header->namesOffset)
+			return false;
+
+		const SlideIndexEntry* first = reinterpret_cast<const SlideIndexEntry*>(data + sizeof(SlideIndexHeader));
+		for (uint32_t i = 0; i < header->count; i++)
+		{
+			if ((uint64_t)first[i].nameOffset + first[i].nameLength > header->namesBytes)
+				return false;
+		}
+
+		entries = first;
+		names = reinterpret_cast<const char*>(data + header->namesOffset);
+		count = header->count;
+		return true;
+	}
+
+	void Close()
+	{
+		entries = nullptr;
+		names = nullptr;
+		count = 0;
+	}
+
+	uint32_t Count() const { return count; }
+	const SlideIndexEntry& Entry(uint32_t i) const { return entries[i]; }
+
+	std::string Name(uint32_t i) const
+	{
+		return std::string(names + entries[i].nameOffset, entries[i].nameLength);
+	}
+
+	// Names are sorted, so this is a binary search.  Returns -1 if not found.
+	int Find(const std::string& name) const
+	{
+		uint32_t low = 0, high = count;
+		while (low < high)
+		{
+			uint32_t middle = low + (high - low) / 2;
+			int order = Compare(middle, name);
+			if (order == 0)
+				return (int)middle;
+			if (order < 0)
+				low = middle + 1;
+			else
+				high = middle;
+		}
+		return -1;
+	}
+
+private:
+	int Compare(uint32_t i, const std::string& name) const
+	{
+		size_t length = entries[i].nameLength;
+		int order = memcmp(names + entries[i].nameOffset, name.data(), std::min(length, name.size()));
+		if (order != 0)
+			return order;
+		return (length < name.size()) ? -1 : (length > name.size()) ? 1 : 0;
+	}
+
+	const SlideIndexEntry* entries = nullptr;
+	const char* names = nullptr;
+	uint32_t count = 0;
+};
+
+
+// The file for entries, with names[i] the name of entries[i], already sorted.
+inline std::vector<uint8_t> BuildSlideIndex(const std::vector<SlideIndexEntry>& entries, const std::vector<std::string>& names)
+{
+	size_t namesBytes = 0;
+	for (const std::string& name : names)
+		namesBytes += name.size();
+
+	SlideIndexHeader header = {};
+	header.magic = kSlideIndexMagic;
+	header.version = kSlideIndexVersion;
+	header.count = (uint32_t)entries.size();
+	header.entrySize = sizeof(SlideIndexEntry);
+	header.namesOffset = sizeof(SlideIndexHeader) + entries.size() * sizeof(SlideIndexEntry);
+	header.namesBytes = namesBytes;
+
+	std::vector<uint8_t> bytes((size_t)(header.namesOffset + namesBytes));
+	memcpy(bytes.data(), &header, sizeof(header));
+
+	SlideIndexEntry* out = reinterpret_cast<SlideIndexEntry*>(bytes.data() + sizeof(SlideIndexHeader));
+	char* nameOut = reinterpret_cast<char*>(bytes.data() + header.namesOffset);
+	uint32_t offset = 0;
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		out[i] = entries[i];
+		out[i].nameOffset = offset;
+		out[i].nameLength = (uint32_t)names[i].size();
+		memcpy(nameOut + offset, names[i].data(), names[i].size());
+		offset += (uint32_t)names[i].size();
+	}
+	return bytes;
+}
+
+
+// Until we look at the pixels, or if they don't say, the extension does.
+inline uint32_t SlideLayoutForName(const std::string& name)
+{
+	size_t dot = name.find_last_of('.');
+	std::string extension = (dot != std::string::npos) ? name.substr(dot + 1) : std::string();
+	for (char& c : extension)
+		c = (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c;
+	return (extension == "jps" || extension == "pns") ? kLayoutSideBySide : kLayoutMono;
+}
+
+// The area average of one eye, the left half of side by side, the top of over
+// under, down to kSlideThumbWidth x kSlideThumbHeight.
+inline void MakeSlideThumbnail(const SlideImage& image, uint32_t layout, uint16_t* thumbnail)
+{
+	uint32_t width = image.width;
+	uint32_t height = image.height;
+	if (layout == kLayoutSideBySide || layout == kLayoutSideBySideSwapped)
+		width /= 2;
+	else if (layout == kLayoutOverUnder)
+		height /= 2;
+
+	for (int ty = 0; ty < kSlideThumbHeight; ty++)
+	{
+		uint32_t y0 = (uint32_t)((uint64_t)ty * height / kSlideThumbHeight);
+		uint32_t y1 = std::max(y0 + 1, (uint32_t)((uint64_t)(ty + 1) * height / kSlideThumbHeight));
+		for (int tx = 0; tx < kSlideThumbWidth; tx++)
+		{
+			uint32_t x0 = (uint32_t)((uint64_t)tx * width / kSlideThumbWidth);
+			uint32_t x1 = std::max(x0 + 1, (uint32_t)((uint64_t)(tx + 1) * width / kSlideThumbWidth));
+
+			uint64_t sum[3] = { 0, 0, 0 };
+			uint64_t samples = 0;
+			for (uint32_t y = y0; y < y1 && y < image.height; y++)
+			{
+				const uint8_t* pixel = image.pixels.data() + ((size_t)y * image.width + x0) * 4;
+				for (uint32_t x = x0; x < x1 && x < image.width; x++, pixel += 4)
+				{
+					sum[0] += pixel[0];
+					sum[1] += pixel[1];
+					sum[2] += pixel[2];
+					samples++;
+				}
+			}
+			samples = std::max<uint64_t>(samples, 1);
+			uint32_t blue = (uint32_t)(sum[0] / samples), green = (uint32_t)(sum[1] / samples), red = (uint32_t)(sum[2] / samples);
+			thumbnail[ty * kSlideThumbWidth + tx] = (uint16_t)(((red >> 3) << 11) | ((green >> 2) << 5) | (blue >> 3));
+		}
+	}
+}
+
+
+// --------------------------------------------------------------------------
+
+class SlideIndexStore
+{
+public:
+	virtual ~SlideIndexStore() { }
+
+	// The pictures in the folder, names relative to it, UTF-8.  From the
+	// indexer thread only.
+	virtual bool List(std::vector<SlideIndexFile>* files) = 0;
+
+	// For the decoder, any thread.
+	virtual std::string FullPath(const std::string& name) = 0;
+
+	// Maps the index file read only, valid until Unmap.  False if there is none.
+	virtual bool Map(const uint8_t** data, size_t* size) = 0;
+	virtual void Unmap() = 0;
+
+	// Replaces the index file, all at once.  Never called while mapped.
+	virtual bool Save(const std::vector<uint8_t>& bytes) = 0;
+};
+
+struct SlideIndexStats
+{
+	uint32_t listed;
+	uint32_t unchanged;					// Taken from the last index.
+	uint32_t decoded;
+	uint32_t failed;
+	uint32_t saves;
+	bool scanning;
+};
+
+
+class SlideIndexer
+{
+public:
+	// Index writes while decoding, so a quit loses at most this many.
+	static const uint32_t kSaveEvery = 256;
+
+	SlideIndexer() { }
+
+	// Same as RowPool, a joinable std::thread at process exit would terminate.
+	~SlideIndexer()
+	{
+		if (scanner.joinable())
+			scanner.detach();
+	}
+
+	SlideIndexer(const SlideIndexer&) = delete;
+	SlideIndexer& operator=(const SlideIndexer&) = delete;
+
+	// We own store and decoder.  Whatever index the store has is usable when
+	// this returns, and the scan for changes runs in the background.
+	void Start(SlideIndexStore* store, SlideDecoder* decoder)
+	{
+		Stop();
+
+		std::lock_guard<std::mutex> lock(mutex);
+		this->store.reset(store);
+		this->decoder.reset(decoder);
+		stats = SlideIndexStats();
+		stats.scanning = true;
+		stopping.store(false);
+		MapIndex();
+		generation++;
+
+		scanner = std::thread(&SlideIndexer::Scan, this);
+	}
+
+	// Waits for the decode in progress, and closes the index.
+	void Stop()
+	{
+		stopping.store(true);
+		if (scanner.joinable())
+			scanner.join();
+
+		std::lock_guard<std::mutex> lock(mutex);
+		view.Close();
+		if (store)
+			store->Unmap();
+		store.reset();
+		decoder.reset();
+		memoryCopy.clear();
+	}
+
+	// Changes whenever the list of names does, not for thumbnails coming in.
+	uint32_t Generation()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return generation;
+	}
+
+	SlideIndexStats Stats()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return stats;
+	}
+
+	int Count()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return (int)view.Count();
+	}
+
+	// A copy, the mapping can be replaced at any time.
+	bool Entry(int index, SlideIndexEntry* entry)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (index < 0 || (uint32_t)index >= view.Count())
+			return false;
+		*entry = view.Entry(index);
+		return true;
+	}
+
+	// Full paths of the pictures, in name order, and which entry each is.
+	// Pictures that don't decode are left out.
+	void Paths(std::vector<std::string>* paths, std::vector<int>* entries)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		paths->clear();
+		entries->clear();
+		for (uint32_t i = 0; i < view.Count(); i++)
+		{
+			if (view.Entry(i).flags & kSlideFailed)
+				continue;
+			paths->push_back(store->FullPath(view.Name(i)));
+			entries->push_back((int)i);
+		}
+	}
+
+private:
+	// With mutex held.  If the file can't be used, it's like there was none.
+	void MapIndex()
+	{
+		const uint8_t* data = nullptr;
+		size_t size = 0;
+		if (store->Map(&data, &size) && view.Open(data, size))
+			return;
+		store->Unmap();
+		view.Close();
+	}
+
+	// The new index replaces the file and is mapped again.  If it can't be
+	// saved, like in a read only folder, we use it from memory.
+	void Publish(const std::vector<SlideIndexEntry>& entries, const std::vector<std::string>& names, bool namesChanged)
+	{
+		std::vector<uint8_t> bytes = BuildSlideIndex(entries, names);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		view.Close();
+		store->Unmap();
+		memoryCopy.clear();
+
+		if (store->Save(bytes))
+		{
+			stats.saves++;
+			MapIndex();
+		}
+		if (view.Count() != entries.size())
+		{
+			memoryCopy.swap(bytes);
+			view.Open(memoryCopy.data(), memoryCopy.size());
+		}
+		if (namesChanged)
+			generation++;
+	}
+
+	void Scan()
+	{
+		std::vector<SlideIndexFile> files;
+		if (!store->List(&files))
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stats.scanning = false;
+			return;
+		}
+		std::sort(files.begin(), files.end(),
+			[](const SlideIndexFile& a, const SlideIndexFile& b) { return a.name < b.name; });
+
+		std::vector<SlideIndexEntry> entries(files.size());
+		std::vector<std::string> names(files.size());
+		std::vector<size_t> pending;
+		bool namesChanged;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			namesChanged = (view.Count() != files.size());
+			for (size_t i = 0; i < files.size(); i++)
+			{
+				names[i] = files[i].name;
+				int old = view.Find(names[i]);
+				if (old >= 0 && view.Entry(old).modified == files[i].modified &&
+					view.Entry(old).size == files[i].size && !(view.Entry(old).flags & kSlidePending))
+				{
+					entries[i] = view.Entry(old);
+					stats.unchanged++;
+				}
+				else
+				{
+					entries[i] = SlideIndexEntry();
+					entries[i].modified = files[i].modified;
+					entries[i].size = files[i].size;
+					entries[i].layout = SlideLayoutForName(names[i]);
+					entries[i].flags = kSlidePending;
+					pending.push_back(i);
+				}
+				namesChanged = namesChanged || (old < 0);
+			}
+			stats.listed = (uint32_t)files.size();
+		}
+
+		if (namesChanged || !pending.empty())
+			Publish(entries, names, namesChanged);
+
+		decoder->BeginThread();
+
+		uint32_t unsaved = 0;
+		for (size_t i : pending)
+		{
+			if (stopping.load())
+				break;
+
+			// Big enough for a cell of StereoDetect's grid to be a few pixels,
+			// which is a quarter size JPEG decode for a 3D Vision screenshot.
+			SlideImage image;
+			SlideIndexEntry& entry = entries[i];
+			if (decoder->Decode(store->FullPath(names[i]), kStereoGridWidth * 2, kStereoGridHeight * 2, &image) &&
+				image.width > 0 && image.height > 0)
+			{
+				StereoDetection found = StereoDetectPixels(image.pixels.data(), image.width, image.height,
+					(size_t)image.width * 4, kStereoBGRA8);
+				if (found.confidence > kStereoSureConfidence)
+					entry.layout = found.layout;
+
+				entry.width = image.sourceWidth;
+				entry.height = image.sourceHeight;
+				MakeSlideThumbnail(image, entry.layout, entry.thumbnail);
+				entry.flags = 0;
+			}
+			else
+			{
+				entry.flags = kSlideFailed;
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if (entry.flags & kSlideFailed)
+					stats.failed++;
+				else
+					stats.decoded++;
+			}
+
+			// A picture that fails changes the list SlideShow uses.
+			if (++unsaved >= kSaveEvery || (entry.flags & kSlideFailed))
+			{
+				Publish(entries, names, (entry.flags & kSlideFailed) != 0);
+				unsaved = 0;
+			}
+		}
+		decoder->EndThread();
+		if (unsaved > 0)
+			Publish(entries, names, false);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		stats.scanning = false;
+	}
+
+	std::unique_ptr<SlideIndexStore> store;
+	std::unique_ptr<SlideDecoder> decoder;
+	std::thread scanner;
+	std::atomic<bool> stopping{ false };
+
+	std::mutex mutex;
+	SlideIndexView view;
+	std::vector<uint8_t> memoryCopy;
+	uint32_t generation = 0;
+	SlideIndexStats stats = SlideIndexStats();
+};
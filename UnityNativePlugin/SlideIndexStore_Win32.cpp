@@ -0,0 +1,153 @@
+// Win32 implementation of SlideIndexStore, for SlideIndex.h.
+//
+// The folder listing comes with each file's last write time and size, so a
+// rescan of thousands of pictures is one FindFirstFileEx loop and no opens.
+// The index lives with our other files in LocalLow\Katanga\Katanga, and is
+// replaced the same way as the game plugin's vtable cache.
+
+#include "SlideIndex.h"
+
+#include <windows.h>
+#include <shlobj_core.h>
+#include <share.h>
+#include <stdio.h>
+
+
+class SlideIndexStore_Win32 : public SlideIndexStore
+{
+public:
+	SlideIndexStore_Win32(const std::wstring& folder, const std::wstring& indexPath)
+		: folder(folder), indexPath(indexPath)
+	{
+		utf8Folder = Utf8(folder);
+	}
+
+	~SlideIndexStore_Win32()
+	{
+		Unmap();
+	}
+
+	bool List(std::vector<SlideIndexFile>* files) override
+	{
+		files->clear();
+
+		WIN32_FIND_DATAW found;
+		std::wstring pattern = folder + L"\\*.jps";
+		HANDLE search = FindFirstFileExW(pattern.c_str(), FindExInfoBasic, &found, FindExSearchNameMatch, NULL,
+			FIND_FIRST_EX_LARGE_FETCH);
+		if (search == INVALID_HANDLE_VALUE)
+			return GetLastError() == ERROR_FILE_NOT_FOUND;
+
+		do
+		{
+			if (found.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+				continue;
+
+			SlideIndexFile file;
+			file.name = Utf8(found.cFileName);
+			file.modified = ((uint64_t)found.ftLastWriteTime.dwHighDateTime << 32) | found.ftLastWriteTime.dwLowDateTime;
+			file.size = ((uint64_t)found.nFileSizeHigh << 32) | found.nFileSizeLow;
+			files->push_back(file);
+		} while (FindNextFileW(search, &found));
+
+		FindClose(search);
+		return true;
+	}
+
+	std::string FullPath(const std::string& name) override
+	{
+		return utf8Folder + "\\" + name;
+	}
+
+	bool Map(const uint8_t** data, size_t* size) override
+	{
+		Unmap();
+
+		file = CreateFileW(indexPath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+			FILE_ATTRIBUTE_NORMAL, NULL);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0 || (uint64_t)fileSize.QuadPart > SIZE_MAX)
+		{
+			Unmap();
+			return false;
+		}
+
+		mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapping != NULL)
+			view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (view == NULL)
+		{
+			Unmap();
+			return false;
+		}
+
+		*data = static_cast<const uint8_t*>(view);
+		*size = (size_t)fileSize.QuadPart;
+		return true;
+	}
+
+	void Unmap() override
+	{
+		if (view != NULL)
+			UnmapViewOfFile(view);
+		if (mapping != NULL)
+			CloseHandle(mapping);
+		if (file != INVALID_HANDLE_VALUE)
+			CloseHandle(file);
+		view = NULL;
+		mapping = NULL;
+		file = INVALID_HANDLE_VALUE;
+	}
+
+	bool Save(const std::vector<uint8_t>& bytes) override
+	{
+		std::wstring temp = indexPath + L".tmp";
+		FILE* out = _wfsopen(temp.c_str(), L"wb", _SH_DENYWR);
+		if (out == nullptr)
+			return false;
+		bool written = fwrite(bytes.data(), 1, bytes.size(), out) == bytes.size();
+		written = (fclose(out) == 0) && written;
+
+		if (!written || !MoveFileEx(temp.c_str(), indexPath.c_str(), MOVEFILE_REPLACE_EXISTING))
+		{
+			DeleteFile(temp.c_str());
+			return false;
+		}
+		return true;
+	}
+
+private:
+	static std::string Utf8(const std::wstring& wide)
+	{
+		int length = WideCharToMultiByte(CP_UTF8, 0, wide.c_str(), -1, NULL, 0, NULL, NULL);
+		if (length <= 1)
+			return std::string();
+		std::string utf8(length - 1, '\0');
+		WideCharToMultiByte(CP_UTF8, 0, wide.c_str(), -1, &utf8[0], length, NULL, NULL);
+		return utf8;
+	}
+
+	std::wstring folder;
+	std::wstring indexPath;
+	std::string utf8Folder;
+
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = NULL;
+	void* view = NULL;
+};
+
+
+// One index, for the one SlideShow folder.  A different folder just makes all
+// its names new, and the index is rebuilt for it.
+SlideIndexStore* CreateSlideIndexStore_Win32(const wchar_t* folder)
+{
+	wchar_t* localLowAppData = 0;
+	SHGetKnownFolderPath(FOLDERID_LocalAppDataLow, 0, NULL, &localLowAppData);
+	std::wstring indexPath = std::wstring(localLowAppData) + L"\\Katanga\\Katanga\\katanga_slides.idx";
+	CoTaskMemFree(localLowAppData);
+
+	return new SlideIndexStore_Win32(folder, indexPath);
+}
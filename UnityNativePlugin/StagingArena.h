@@ -0,0 +1,88 @@
+#pragma once
+
+//-----------------------------------------------------------
+// Reusable system memory for BeginModifyTexture/EndModifyTexture.
+//
+// Those used to new[] and delete[] a full frame on every render event, which at
+// double wide 1080p to 4K is an 8M to 33M heap allocation per frame, and
+// allocations that size go straight to VirtualAlloc in the CRT anyway.  This
+// keeps the pages around, and only reallocates when the frame size changes.
+//
+// There is just the one buffer.  EndModifyTexture hands it to UpdateSubresource,
+// which has taken its own copy by the time it returns, so the buffer is free
+// again before the next BeginModifyTexture, and a second one would never
+// overlap anything.
+//
+// Where the pages come from is up to the StagingPages given to the arena.  The
+// D3D11 side uses VirtualAlloc, so they are page aligned, which keeps every row
+// of a 16 byte multiple pitch aligned for SIMD fills.
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+// Source of the buffers, called only when the arena needs new ones.
+
+class StagingPages
+{
+public:
+	virtual ~StagingPages() { }
+
+	// At least 16 byte aligned, nullptr if the memory is not there.
+	virtual void* Allocate(size_t bytes) = 0;
+	virtual void Free(void* pages, size_t bytes) = 0;
+};
+
+
+class StagingArena
+{
+public:
+	explicit StagingArena(StagingPages* pages)
+		: pages(pages)
+	{
+	}
+	~StagingArena() { Release(); }
+
+	StagingArena(const StagingArena&) = delete;
+	StagingArena& operator=(const StagingArena&) = delete;
+
+	// The buffer, at least bytes long.  Returns nullptr if the pages cannot be
+	// committed, and tries again next time.  Changing size drops the old one.
+
+	void* Acquire(size_t bytes)
+	{
+		if (bytes != size)
+		{
+			Release();
+			size = bytes;
+		}
+
+		if (buffer == nullptr)
+		{
+			buffer = pages->Allocate(size);
+			if (buffer != nullptr)
+				allocations++;
+		}
+		return buffer;
+	}
+
+	void Release()
+	{
+		if (buffer)
+			pages->Free(buffer, size);
+		buffer = nullptr;
+		size = 0;
+	}
+
+	size_t Size() const { return size; }
+
+	// Number of times we actually went to the StagingPages, over the life of
+	// the arena.
+	uint64_t Allocations() const { return allocations; }
+
+private:
+	StagingPages* pages;
+	void* buffer = nullptr;
+	size_t size = 0;
+	uint64_t allocations = 0;
+};
@@ -0,0 +1,368 @@
+#pragma once
+
+//-----------------------------------------------------------
+// Works out how a frame or a picture packs its two eyes, from the pixels.
+//
+// The game plugin always builds a double width surface, and .jps files are
+// side by side by definition, but neither is a promise.  A game with 3D Vision
+// off gives us the same image twice, a .jps can have the eyes the other way
+// around, and plenty of stereo pictures are over under.
+//
+// The frame is first sampled down to a small luma grid, which is all the rest
+// looks at, so the cost is the same at any size.  Then the two candidate
+// halves, left and right, and top and bottom, are compared by the correlation
+// of their horizontal gradients, at every horizontal shift up to
+// kStereoMaxShift.  The two eyes of a stereo pair have the same edges in the
+// same rows, moved sideways by the parallax, so one of the two splits lines up
+// at some shift, and for a mono picture neither does.  Gradients rather than
+// luma, so that a plain sky on top and ground below in both halves of a mono
+// picture does not look like a match.
+//
+// The shift that matches best also gives the eye order.  Most of a stereo
+// scene is behind the screen, where the right eye sees things further right
+// than the left eye does, so for the right eye on the left half, as we use
+// everywhere, the left half matches the right half moved left.  A match the
+// other way is swapped eyes.  Over under has no swapped layout, so that is
+// only decided for side by side.
+//
+// SSE2 throughout, like YCbCrConvert.h.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <emmintrin.h>
+
+#include "../DeviarePlugin/KatangaIPC.h"
+
+
+const int kStereoGridWidth = 256;
+const int kStereoGridHeight = 128;
+
+// Largest parallax looked for, in grid cells either way, which is 1/8 of an eye
+// for side by side.
+const int kStereoMaxShift = 16;
+
+enum StereoPixelFormat
+{
+	kStereoBGRA8,
+	kStereoRGBA8,
+	kStereoRGBA16Float,					// Green only, for these.
+	kStereoRGBA16Unorm,
+	kStereoRGBA32Float,
+};
+
+struct StereoGrid
+{
+	uint8_t luma[kStereoGridHeight][kStereoGridWidth];
+};
+
+struct StereoDetection
+{
+	uint32_t layout;					// KatangaStereoLayout.
+	uint32_t confidence;				// 0 to 100.
+	float sideBySide;					// Best correlation of left and right halves.
+	float overUnder;					// Same for top and bottom.
+	float shift;						// Where the winner matched, in grid cells.
+};
+
+
+// --------------------------------------------------------------------------
+// Sampling
+
+inline float StereoHalfToFloat(uint16_t half)
+{
+	uint32_t exponent = (half >> 10) & 0x1F;
+	uint32_t mantissa = half & 0x3FF;
+	if (half & 0x8000)
+		return 0.0f;					// Negative is black to us.
+	if (exponent == 0)
+		return (float)mantissa * (1.0f / (1 << 24));
+	if (exponent == 31)
+		return 65504.0f;
+	uint32_t bits = ((exponent + 112) << 23) | (mantissa << 13);
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+inline uint8_t StereoLinearToByte(float value)
+{
+	return (uint8_t)((value <= 0.0f) ? 0 : (value >= 1.0f) ? 255 : (int)(value * 255.0f + 0.5f));
+}
+
+inline int StereoPixelLuma(const uint8_t* row, uint32_t x, StereoPixelFormat format)
+{
+	switch (format)
+	{
+	case kStereoBGRA8:
+		return (2 * row[x * 4 + 2] + 5 * row[x * 4 + 1] + row[x * 4]) >> 3;
+	case kStereoRGBA8:
+		return (2 * row[x * 4] + 5 * row[x * 4 + 1] + row[x * 4 + 2]) >> 3;
+	case kStereoRGBA16Float:
+		return StereoLinearToByte(StereoHalfToFloat(reinterpret_cast<const uint16_t*>(row)[x * 4 + 1]));
+	case kStereoRGBA16Unorm:
+		return reinterpret_cast<const uint16_t*>(row)[x * 4 + 1] >> 8;
+	case kStereoRGBA32Float:
+		return StereoLinearToByte(reinterpret_cast<const float*>(row)[x * 4 + 1]);
+	}
+	return 0;
+}
+
+// Each cell is the average of four pixels across it, on two rows, which keeps
+// a 4K frame from aliasing into noise.  It's about as much memory traffic as
+// one pixel, the four share cache lines.
+const int kStereoCellColumns = 4;
+const int kStereoCellRows = 2;
+
+inline void StereoSampleGrid(const void* pixels, uint32_t width, uint32_t height, size_t pitch,
+	StereoPixelFormat format, StereoGrid* grid)
+{
+	const int across = kStereoGridWidth * kStereoCellColumns;
+	uint32_t columns[kStereoGridWidth * kStereoCellColumns];
+	for (int i = 0; i < across; i++)
+		columns[i] = (uint32_t)(((uint64_t)(2 * i + 1) * width) / (2 * across));
+
+	const int down = kStereoGridHeight * kStereoCellRows;
+	for (int cy = 0; cy < kStereoGridHeight; cy++)
+	{
+		int sums[kStereoGridWidth] = {};
+		for (int r = 0; r < kStereoCellRows; r++)
+		{
+			int i = cy * kStereoCellRows + r;
+			uint32_t y = (uint32_t)(((uint64_t)(2 * i + 1) * height) / (2 * down));
+			const uint8_t* row = static_cast<const uint8_t*>(pixels) + (size_t)y * pitch;
+			for (int c = 0; c < across; c++)
+				sums[c / kStereoCellColumns] += StereoPixelLuma(row, columns[c], format);
+		}
+		for (int cx = 0; cx < kStereoGridWidth; cx++)
+			grid->luma[cy][cx] = (uint8_t)(sums[cx] / (kStereoCellColumns * kStereoCellRows));
+	}
+}
+
+
+// --------------------------------------------------------------------------
+// Matching
+
+// Horizontal gradient of width luma samples into gradient, the last one zero.
+// width is a multiple of 8.
+inline void StereoGradient(const uint8_t* luma, int width, int16_t* gradient)
+{
+	const __m128i zero = _mm_setzero_si128();
+	int x = 0;
+	for (; x + 8 < width; x += 8)
+	{
+		__m128i here = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(luma + x)), zero);
+		__m128i next = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(luma + x + 1)), zero);
+		_mm_storeu_si128((__m128i*)(gradient + x), _mm_sub_epi16(next, here));
+	}
+	for (; x < width - 1; x++)
+		gradient[x] = (int16_t)(luma[x + 1] - luma[x]);
+	gradient[width - 1] = 0;
+}
+
+inline int32_t StereoSum32(__m128i sum)
+{
+	sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+	sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtsi128_si32(sum);
+}
+
+// For one row of each half, adds a dot b to energy, and a against b moved by
+// each shift to curve.  b has kStereoMaxShift zeros on both sides, so a shift
+// only counts the part that overlaps.  width is a multiple of 8.
+inline void StereoMatchRow(const int16_t* a, const int16_t* paddedB, int width,
+	int64_t* energyA, int64_t* energyB, int64_t* curve)
+{
+	const int16_t* b = paddedB + kStereoMaxShift;
+
+	__m128i sumA = _mm_setzero_si128();
+	__m128i sumB = _mm_setzero_si128();
+	for (int x = 0; x < width; x += 8)
+	{
+		__m128i va = _mm_loadu_si128((const __m128i*)(a + x));
+		__m128i vb = _mm_loadu_si128((const __m128i*)(b + x));
+		sumA = _mm_add_epi32(sumA, _mm_madd_epi16(va, va));
+		sumB = _mm_add_epi32(sumB, _mm_madd_epi16(vb, vb));
+	}
+	*energyA += StereoSum32(sumA);
+	*energyB += StereoSum32(sumB);
+
+	for (int shift = -kStereoMaxShift; shift <= kStereoMaxShift; shift++)
+	{
+		__m128i cross = _mm_setzero_si128();
+		for (int x = 0; x < width; x += 8)
+		{
+			__m128i va = _mm_loadu_si128((const __m128i*)(a + x));
+			__m128i vb = _mm_loadu_si128((const __m128i*)(b + x + shift));
+			cross = _mm_add_epi32(cross, _mm_madd_epi16(va, vb));
+		}
+		curve[shift + kStereoMaxShift] += StereoSum32(cross);
+	}
+}
+
+// Mean absolute difference of two rows of bytes, width a multiple of 16.
+inline uint32_t StereoRowSad(const uint8_t* a, const uint8_t* b, int width)
+{
+	__m128i sum = _mm_setzero_si128();
+	for (int x = 0; x < width; x += 16)
+		sum = _mm_add_epi64(sum, _mm_sad_epu8(_mm_loadu_si128((const __m128i*)(a + x)), _mm_loadu_si128((const __m128i*)(b + x))));
+	return (uint32_t)(_mm_cvtsi128_si32(sum) + _mm_cvtsi128_si32(_mm_srli_si128(sum, 8)));
+}
+
+struct StereoMatch
+{
+	float correlation;					// At the best shift, -1 to 1.
+	float shift;						// Best shift, to a fraction of a cell.
+	float opposite;						// Best correlation shifted the other way.
+	float energy;						// Mean squared gradient, how much detail there is.
+	float difference;					// Mean absolute luma difference, unshifted.
+};
+
+// Compares two halves of the grid, each rows x width, starting at a and b.
+inline StereoMatch StereoMatchHalves(const StereoGrid& grid, int rowA, int columnA, int rowB, int columnB, int rows, int width)
+{
+	int16_t gradientA[kStereoGridWidth];
+	int16_t paddedB[kStereoGridWidth + 2 * kStereoMaxShift] = {};
+	int64_t curve[2 * kStereoMaxShift + 1] = {};
+	int64_t energyA = 0, energyB = 0;
+	uint64_t sad = 0;
+
+	for (int y = 0; y < rows; y++)
+	{
+		const uint8_t* a = &grid.luma[rowA + y][columnA];
+		const uint8_t* b = &grid.luma[rowB + y][columnB];
+		StereoGradient(a, width, gradientA);
+		StereoGradient(b, width, paddedB + kStereoMaxShift);
+		StereoMatchRow(gradientA, paddedB, width, &energyA, &energyB, curve);
+		sad += StereoRowSad(a, b, width);
+	}
+
+	// Ties go to the smaller shift.
+	int peak = kStereoMaxShift;
+	for (int i = 0; i <= 2 * kStereoMaxShift; i++)
+	{
+		if (curve[i] > curve[peak] || (curve[i] == curve[peak] && abs(i - kStereoMaxShift) < abs(peak - kStereoMaxShift)))
+			peak = i;
+	}
+
+	// The top of a parabola through the peak and its neighbors, for parallax
+	// under a cell, which is most of it at a distance.
+	StereoMatch match = { 0.0f, (float)(peak - kStereoMaxShift), 0.0f, 0.0f, 0.0f };
+	if (peak > 0 && peak < 2 * kStereoMaxShift)
+	{
+		double left = (double)curve[peak - 1], middle = (double)curve[peak], right = (double)curve[peak + 1];
+		double bend = left - 2.0 * middle + right;
+		if (bend < 0.0)
+			match.shift += (float)(0.5 * (left - right) / bend);
+	}
+
+	// Best of the other sign from the peak, or both sides if the peak is at zero.
+	int64_t opposite = INT64_MIN;
+	for (int i = 0; i <= 2 * kStereoMaxShift; i++)
+	{
+		int shift = i - kStereoMaxShift;
+		if ((shift < 0 && match.shift >= 0.0f) || (shift > 0 && match.shift <= 0.0f))
+			opposite = (curve[i] > opposite) ? curve[i] : opposite;
+	}
+
+	double samples = (double)rows * width;
+	double norm = sqrt((double)energyA * (double)energyB);
+	match.correlation = (norm > 0.0) ? (float)(curve[peak] / norm) : 0.0f;
+	match.opposite = (norm > 0.0) ? (float)(opposite / norm) : 0.0f;
+	match.energy = (float)((energyA + energyB) / (2.0 * samples));
+	match.difference = (float)(sad / samples);
+	return match;
+}
+
+
+// --------------------------------------------------------------------------
+// Deciding
+
+// Below this much detail, a black loading screen say, we can't tell.
+const float kStereoMinEnergy = 4.0f;
+
+// Halves this close, in luma steps, are the same image twice.
+const float kStereoSameDifference = 1.5f;
+
+// Correlation where a split starts to look like a pair, and where it is sure.
+const float kStereoMatchLow = 0.10f;
+const float kStereoMatchHigh = 0.30f;
+
+// Parallax under this, in cells, does not tell the eyes apart.
+const float kStereoMinShift = 0.25f;
+
+// Above this it's safe to act on.  On our own Stereo Pictures, each also
+// swapped, over under and mono, nothing wrong ever got above it.
+const uint32_t kStereoSureConfidence = 50;
+
+inline uint32_t StereoPercent(float value)
+{
+	return (uint32_t)((value <= 0.0f) ? 0 : (value >= 1.0f) ? 100 : (int)(value * 100.0f + 0.5f));
+}
+
+inline StereoDetection StereoDetect(const StereoGrid& grid)
+{
+	const int halfWidth = kStereoGridWidth / 2;
+	const int halfHeight = kStereoGridHeight / 2;
+	StereoMatch sideBySide = StereoMatchHalves(grid, 0, 0, 0, halfWidth, kStereoGridHeight, halfWidth);
+	StereoMatch overUnder = StereoMatchHalves(grid, 0, 0, halfHeight, 0, halfHeight, kStereoGridWidth);
+
+	StereoDetection result = { kLayoutUnknown, 0, sideBySide.correlation, overUnder.correlation, 0 };
+	if (sideBySide.energy < kStereoMinEnergy)
+		return result;
+
+	// The same picture in both halves is a mono source in a stereo surface.
+	if (sideBySide.difference < kStereoSameDifference || overUnder.difference < kStereoSameDifference)
+	{
+		result.layout = kLayoutMono;
+		result.confidence = 100;
+		return result;
+	}
+
+	bool wide = sideBySide.correlation >= overUnder.correlation;
+	const StereoMatch& best = wide ? sideBySide : overUnder;
+	const StereoMatch& other = wide ? overUnder : sideBySide;
+	if (best.correlation < kStereoMatchLow)
+	{
+		result.layout = kLayoutMono;
+		result.confidence = StereoPercent((kStereoMatchLow - best.correlation) / kStereoMatchLow + 0.5f);
+		return result;
+	}
+
+	// How well it matches, times how much better than the other split.
+	float strength = (best.correlation - kStereoMatchLow) / (kStereoMatchHigh - kStereoMatchLow);
+	float margin = (best.correlation - (other.correlation > 0.0f ? other.correlation : 0.0f)) / best.correlation;
+	float confidence = (strength < 1.0f ? strength : 1.0f) * (2.0f * margin < 1.0f ? 2.0f * margin : 1.0f);
+
+	result.shift = best.shift;
+	if (!wide)
+	{
+		result.layout = kLayoutOverUnder;
+	}
+	else
+	{
+		// The order is as sure as the match beats the best one shifted the other
+		// way, a scene with a lot popping out can have both.  Almost no parallax
+		// says nothing.  Either way, unsure is the usual order at half.
+		bool swapped = best.shift >= kStereoMinShift;
+		float order = 2.5f * (best.correlation - best.opposite) / best.correlation;
+		if (!swapped && best.shift > -kStereoMinShift)
+			order = 0.0f;
+		order = (order < 1.0f) ? order : 1.0f;
+		result.layout = swapped ? kLayoutSideBySideSwapped : kLayoutSideBySide;
+		confidence *= swapped ? order : (order > 0.5f ? order : 0.5f);
+	}
+
+	result.confidence = StereoPercent(confidence);
+	return result;
+}
+
+inline StereoDetection StereoDetectPixels(const void* pixels, uint32_t width, uint32_t height, size_t pitch,
+	StereoPixelFormat format)
+{
+	StereoGrid grid;
+	StereoSampleGrid(pixels, width, height, pitch, format, &grid);
+	return StereoDetect(grid);
+}
@@ -0,0 +1,184 @@
+#pragma once
+
+//-----------------------------------------------------------
+// CPU texture generators, for the idle screen and fallback path, which fill a
+// Unity texture through BeginModifyTexture/EndModifyTexture.
+//
+// A generator gets BeginFrame once on the render thread, and then GenerateRows
+// for bands of rows, possibly from several RowPool threads at once.  So anything
+// per frame is computed in BeginFrame, and GenerateRows must only read it.
+//
+// All images here are 4 bytes per pixel.
+
+#include <stdint.h>
+#include <math.h>
+#include <vector>
+
+#include <emmintrin.h>
+
+class TextureGenerator
+{
+public:
+	virtual ~TextureGenerator() { }
+
+	virtual void BeginFrame(int width, int height, float time) = 0;
+
+	// image is the start of the whole image, not of rowBegin.
+	virtual void GenerateRows(unsigned char* image, int rowPitch, int rowBegin, int rowEnd) = 0;
+};
+
+
+// --------------------------------------------------------------------------
+// The plasma effect, several combined sine waves, as originally written.  This
+// is four sinf and a sqrtf per pixel, and is kept as the reference that the
+// fast version below is checked against.
+
+class PlasmaReferenceGenerator : public TextureGenerator
+{
+public:
+	void BeginFrame(int width, int /*height*/, float time) override
+	{
+		this->width = width;
+		t = time * 4.0f;
+	}
+
+	void GenerateRows(unsigned char* image, int rowPitch, int rowBegin, int rowEnd) override
+	{
+		for (int y = rowBegin; y < rowEnd; ++y)
+		{
+			unsigned char* ptr = image + (size_t)y * rowPitch;
+			for (int x = 0; x < width; ++x)
+			{
+				int vv = int(
+					(127.0f + (127.0f * sinf(x / 7.0f + t))) +
+					(127.0f + (127.0f * sinf(y / 5.0f - t))) +
+					(127.0f + (127.0f * sinf((x + y) / 6.0f - t))) +
+					(127.0f + (127.0f * sinf(sqrtf(float(x*x + y*y)) / 4.0f - t)))
+					) / 4;
+
+				ptr[0] = vv;
+				ptr[1] = vv;
+				ptr[2] = vv;
+				ptr[3] = vv;
+				ptr += 4;
+			}
+		}
+	}
+
+private:
+	int width = 0;
+	float t = 0;
+};
+
+
+// --------------------------------------------------------------------------
+// Same plasma, fast.  Three of the four waves only depend on x, y, or x+y, so
+// BeginFrame makes a table of each, once per frame.  Only the radial wave needs
+// work per pixel, which is done 4 pixels at a time with SSE2 sqrt and a
+// polynomial sine.  The polynomial is good to about 2e-4, which is well under
+// one output level after the 127/4 scale.
+
+// Range reduce to [-pi, pi], fold to [0, pi/2] using sin(a) = sin(pi - a), and
+// a 7th order odd polynomial there, with the sign put back at the end.
+
+inline __m128 PlasmaSin(__m128 x)
+{
+	const __m128 twoPi = _mm_set1_ps(6.28318531f);
+	const __m128 invTwoPi = _mm_set1_ps(0.159154943f);
+	const __m128 pi = _mm_set1_ps(3.14159265f);
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+
+	__m128 k = _mm_cvtepi32_ps(_mm_cvtps_epi32(_mm_mul_ps(x, invTwoPi)));
+	x = _mm_sub_ps(x, _mm_mul_ps(k, twoPi));
+
+	__m128 sign = _mm_and_ps(x, signMask);
+	__m128 a = _mm_andnot_ps(signMask, x);
+	a = _mm_min_ps(a, _mm_sub_ps(pi, a));
+
+	__m128 a2 = _mm_mul_ps(a, a);
+	__m128 p = _mm_set1_ps(-1.0f / 5040.0f);
+	p = _mm_add_ps(_mm_mul_ps(p, a2), _mm_set1_ps(1.0f / 120.0f));
+	p = _mm_add_ps(_mm_mul_ps(p, a2), _mm_set1_ps(-1.0f / 6.0f));
+	p = _mm_add_ps(_mm_mul_ps(p, a2), _mm_set1_ps(1.0f));
+	p = _mm_mul_ps(p, a);
+
+	return _mm_xor_ps(p, sign);
+}
+
+class PlasmaGenerator : public TextureGenerator
+{
+public:
+	void BeginFrame(int width, int height, float time) override
+	{
+		this->width = width;
+		t = time * 4.0f;
+
+		// Extra 3 entries so the last partial group of 4 can load past width.
+		columnWave.resize(width + 3);
+		rowWave.resize(height);
+		diagonalWave.resize(width + height + 3);
+
+		for (int x = 0; x < width + 3; x++)
+			columnWave[x] = sinf(x / 7.0f + t);
+		for (int y = 0; y < height; y++)
+			rowWave[y] = sinf(y / 5.0f - t);
+		for (int d = 0; d < width + height + 3; d++)
+			diagonalWave[d] = sinf(d / 6.0f - t);
+	}
+
+	void GenerateRows(unsigned char* image, int rowPitch, int rowBegin, int rowEnd) override
+	{
+		const __m128 scale = _mm_set1_ps(127.0f);
+		const __m128 quarter = _mm_set1_ps(0.25f);
+		const __m128 phase = _mm_set1_ps(t);
+		const __m128 four = _mm_set1_ps(4.0f);
+
+		for (int y = rowBegin; y < rowEnd; ++y)
+		{
+			uint32_t* out = (uint32_t*)(image + (size_t)y * rowPitch);
+			const float* diagonal = &diagonalWave[y];
+
+			// The 4 * 127 offsets of all four waves, and the row's own wave.
+			const __m128 base = _mm_set1_ps(4 * 127.0f + 127.0f * rowWave[y]);
+			const __m128 ySquared = _mm_set1_ps(float(y * y));
+			__m128 xs = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+
+			for (int x = 0; x < width; x += 4)
+			{
+				__m128 waves = _mm_add_ps(_mm_loadu_ps(&columnWave[x]), _mm_loadu_ps(&diagonal[x]));
+
+				__m128 radius = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(xs, xs), ySquared));
+				waves = _mm_add_ps(waves, PlasmaSin(_mm_sub_ps(_mm_mul_ps(radius, quarter), phase)));
+
+				// Same truncation as int(sum) / 4, the sum is always positive.
+				__m128i vv = _mm_srli_epi32(_mm_cvttps_epi32(_mm_add_ps(base, _mm_mul_ps(scale, waves))), 2);
+
+				// Replicate the level into all four channels.
+				vv = _mm_or_si128(vv, _mm_slli_epi32(vv, 8));
+				vv = _mm_or_si128(vv, _mm_slli_epi32(vv, 16));
+
+				if (x + 4 <= width)
+				{
+					_mm_storeu_si128((__m128i*)(out + x), vv);
+				}
+				else
+				{
+					uint32_t tail[4];
+					_mm_storeu_si128((__m128i*)tail, vv);
+					for (int i = 0; x + i < width; i++)
+						out[x + i] = tail[i];
+				}
+
+				xs = _mm_add_ps(xs, four);
+			}
+		}
+	}
+
+private:
+	int width = 0;
+	float t = 0;
+
+	std::vector<float> columnWave;
+	std::vector<float> rowWave;
+	std::vector<float> diagonalWave;
+};
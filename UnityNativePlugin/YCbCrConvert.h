@@ -0,0 +1,183 @@
+#pragma once
+
+//-----------------------------------------------------------
+// Pixel conversions for decoded slides, from JPEG's planar YCbCr to the BGRA
+// that Unity uploads, and halving a BGRA image for a smaller screen.
+//
+// The conversion is the JFIF one, in 14 bit fixed point, and the SSE2 version
+// does 16 pixels at a time with the same math, so both give the exact same
+// bytes, and the scalar one is only for the tail of each row and for checking.
+// Chroma can be at half width, as in 4:2:2 and 4:2:0 JPEGs, and then each
+// sample is used for two pixels.  For half height the caller passes the same
+// chroma row twice.
+//
+// Like TextureGenerator.h, SSE2 is always there on our x86 and x64 targets.
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <emmintrin.h>
+
+
+// JFIF coefficients times 1 << 14.
+const int kYCbCrShift = 14;
+const int kCrToR = 22970;			// 1.402
+const int kCbToG = -5638;			// -0.344136
+const int kCrToG = -11700;			// -0.714136
+const int kCbToB = 29032;			// 1.772
+
+inline uint8_t YCbCrClamp(int value)
+{
+	return (uint8_t)((value < 0) ? 0 : (value > 255) ? 255 : value);
+}
+
+inline void YCbCrToBGRAPixel(int y, int cb, int cr, uint8_t* out)
+{
+	const int kRound = 1 << (kYCbCrShift - 1);
+	cb -= 128;
+	cr -= 128;
+	out[0] = YCbCrClamp(y + ((kCbToB * cb + kRound) >> kYCbCrShift));
+	out[1] = YCbCrClamp(y + ((kCbToG * cb + kCrToG * cr + kRound) >> kYCbCrShift));
+	out[2] = YCbCrClamp(y + ((kCrToR * cr + kRound) >> kYCbCrShift));
+	out[3] = 255;
+}
+
+inline void YCbCrRowToBGRAScalar(const uint8_t* y, const uint8_t* cb, const uint8_t* cr,
+	int begin, int end, int chromaShiftX, uint8_t* bgra)
+{
+	for (int x = begin; x < end; x++)
+		YCbCrToBGRAPixel(y[x], cb[x >> chromaShiftX], cr[x >> chromaShiftX], bgra + (size_t)x * 4);
+}
+
+
+// Eight pixels of the chroma term, (cb, cr) pairs in 16 bits, times the two
+// coefficients of one channel, back down to 16 bits.
+inline __m128i YCbCrTerm(__m128i pairsLow, __m128i pairsHigh, __m128i coefficients)
+{
+	const __m128i round = _mm_set1_epi32(1 << (kYCbCrShift - 1));
+	__m128i low = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(pairsLow, coefficients), round), kYCbCrShift);
+	__m128i high = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(pairsHigh, coefficients), round), kYCbCrShift);
+	return _mm_packs_epi32(low, high);
+}
+
+// One row of width pixels.  chromaShiftX is 1 when cb and cr are half width.
+inline void YCbCrRowToBGRA(const uint8_t* y, const uint8_t* cb, const uint8_t* cr,
+	int width, int chromaShiftX, uint8_t* bgra)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i bias = _mm_set1_epi16(128);
+	const __m128i alpha = _mm_set1_epi8((char)0xFF);
+	const __m128i toR = _mm_setr_epi16(0, kCrToR, 0, kCrToR, 0, kCrToR, 0, kCrToR);
+	const __m128i toG = _mm_setr_epi16(kCbToG, kCrToG, kCbToG, kCrToG, kCbToG, kCrToG, kCbToG, kCrToG);
+	const __m128i toB = _mm_setr_epi16(kCbToB, 0, kCbToB, 0, kCbToB, 0, kCbToB, 0);
+
+	int x = 0;
+	for (; x + 16 <= width; x += 16)
+	{
+		__m128i luma = _mm_loadu_si128((const __m128i*)(y + x));
+		__m128i blue, red;
+		if (chromaShiftX)
+		{
+			blue = _mm_loadl_epi64((const __m128i*)(cb + (x >> 1)));
+			red = _mm_loadl_epi64((const __m128i*)(cr + (x >> 1)));
+			blue = _mm_unpacklo_epi8(blue, blue);
+			red = _mm_unpacklo_epi8(red, red);
+		}
+		else
+		{
+			blue = _mm_loadu_si128((const __m128i*)(cb + x));
+			red = _mm_loadu_si128((const __m128i*)(cr + x));
+		}
+
+		__m128i channels[2][3];			// Low and high 8 pixels, of B, G, R.
+		for (int half = 0; half < 2; half++)
+		{
+			__m128i luma16 = half ? _mm_unpackhi_epi8(luma, zero) : _mm_unpacklo_epi8(luma, zero);
+			__m128i cb16 = _mm_sub_epi16(half ? _mm_unpackhi_epi8(blue, zero) : _mm_unpacklo_epi8(blue, zero), bias);
+			__m128i cr16 = _mm_sub_epi16(half ? _mm_unpackhi_epi8(red, zero) : _mm_unpacklo_epi8(red, zero), bias);
+			__m128i pairsLow = _mm_unpacklo_epi16(cb16, cr16);
+			__m128i pairsHigh = _mm_unpackhi_epi16(cb16, cr16);
+
+			channels[half][0] = _mm_add_epi16(luma16, YCbCrTerm(pairsLow, pairsHigh, toB));
+			channels[half][1] = _mm_add_epi16(luma16, YCbCrTerm(pairsLow, pairsHigh, toG));
+			channels[half][2] = _mm_add_epi16(luma16, YCbCrTerm(pairsLow, pairsHigh, toR));
+		}
+		__m128i b = _mm_packus_epi16(channels[0][0], channels[1][0]);
+		__m128i g = _mm_packus_epi16(channels[0][1], channels[1][1]);
+		__m128i r = _mm_packus_epi16(channels[0][2], channels[1][2]);
+
+		__m128i bgLow = _mm_unpacklo_epi8(b, g);
+		__m128i bgHigh = _mm_unpackhi_epi8(b, g);
+		__m128i raLow = _mm_unpacklo_epi8(r, alpha);
+		__m128i raHigh = _mm_unpackhi_epi8(r, alpha);
+
+		__m128i* out = (__m128i*)(bgra + (size_t)x * 4);
+		_mm_storeu_si128(out + 0, _mm_unpacklo_epi16(bgLow, raLow));
+		_mm_storeu_si128(out + 1, _mm_unpackhi_epi16(bgLow, raLow));
+		_mm_storeu_si128(out + 2, _mm_unpacklo_epi16(bgHigh, raHigh));
+		_mm_storeu_si128(out + 3, _mm_unpackhi_epi16(bgHigh, raHigh));
+	}
+
+	YCbCrRowToBGRAScalar(y, cb, cr, x, width, chromaShiftX, bgra);
+}
+
+
+// --------------------------------------------------------------------------
+// Downscaling.  Slides are only ever shrunk by halves, which a 2x2 box does
+// well, and we stop while the image still covers the screen, so it is never
+// blurrier than what the headset can show.
+
+// How many halvings of width x height still cover maxWidth x maxHeight.  A zero
+// max means no limit on that side.
+inline int SlideHalvings(uint32_t width, uint32_t height, uint32_t maxWidth, uint32_t maxHeight)
+{
+	if (maxWidth == 0 && maxHeight == 0)
+		return 0;
+
+	int halvings = 0;
+	while ((width / 2 >= maxWidth) && (height / 2 >= maxHeight) && width >= 2 && height >= 2)
+	{
+		width /= 2;
+		height /= 2;
+		halvings++;
+	}
+	return halvings;
+}
+
+// Halves a BGRA image into dest, which is (width / 2) x (height / 2), packed.
+// An odd last row or column is dropped.  source and dest may be the same, each
+// output row only reads rows at or below it.
+inline void HalveBGRA(const uint8_t* source, uint32_t width, uint32_t height, size_t pitch, uint8_t* dest)
+{
+	uint32_t outWidth = width / 2;
+	uint32_t outHeight = height / 2;
+	for (uint32_t y = 0; y < outHeight; y++)
+	{
+		const uint8_t* top = source + (size_t)(2 * y) * pitch;
+		const uint8_t* bottom = top + pitch;
+		uint8_t* out = dest + (size_t)y * outWidth * 4;
+
+		uint32_t x = 0;
+		for (; x + 4 <= outWidth; x += 4)
+		{
+			// Eight source pixels of each row, averaged down, then the even
+			// and odd pixels of that, which is the 2x2 box.
+			__m128i a = _mm_avg_epu8(_mm_loadu_si128((const __m128i*)(top + x * 8)),
+				_mm_loadu_si128((const __m128i*)(bottom + x * 8)));
+			__m128i b = _mm_avg_epu8(_mm_loadu_si128((const __m128i*)(top + x * 8 + 16)),
+				_mm_loadu_si128((const __m128i*)(bottom + x * 8 + 16)));
+			__m128i even = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b), _MM_SHUFFLE(2, 0, 2, 0)));
+			__m128i odd = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b), _MM_SHUFFLE(3, 1, 3, 1)));
+			_mm_storeu_si128((__m128i*)(out + x * 4), _mm_avg_epu8(even, odd));
+		}
+		for (; x < outWidth; x++)
+		{
+			for (int c = 0; c < 4; c++)
+			{
+				int vertical0 = (top[x * 8 + c] + bottom[x * 8 + c] + 1) >> 1;
+				int vertical1 = (top[x * 8 + 4 + c] + bottom[x * 8 + 4 + c] + 1) >> 1;
+				out[x * 4 + c] = (uint8_t)((vertical0 + vertical1 + 1) >> 1);
+			}
+		}
+	}
+}
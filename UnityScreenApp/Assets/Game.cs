@@ -461,7 +461,74 @@ public class Game : MonoBehaviour
 
         _gameProcess = gameProcess;
 
-        yield return null;
+        yield return WaitForSharedSurface();
+    }
+
+    // -----------------------------------------------------------------------------
+
+    // The native plugin counts every wakeup from the game side, which happens when it
+    // creates the mapped file, and whenever it publishes or retracts the shared surface.
+    // This yield instruction waits for that count to move past a generation we saw,
+    // so coroutines can wait on the game without checking the handle every frame.
+    //
+    // The wait itself is WaitForNotifyGeneration, which blocks, so it runs on a thread
+    // pool thread, and Unity only looks at the done flag.  This runtime is .NET 3.5,
+    // so a yield instruction is our await.  It gives up after a second, in case the
+    // wakeup never comes, like with an older game plugin, so the caller should check
+    // again and wait some more.  Generation is then the one to wait past next time.
+
+    [DllImport("UnityNativePlugin64")]
+    private static extern uint GetNotifyGeneration();
+    [DllImport("UnityNativePlugin64")]
+    private static extern uint WaitForNotifyGeneration(uint seenGeneration, uint timeoutMs);
+
+    public static uint NotifyGeneration()
+    {
+        return GetNotifyGeneration();
+    }
+
+    public class WaitForGameNotify : CustomYieldInstruction
+    {
+        volatile bool done;
+        volatile uint generation;
+
+        public WaitForGameNotify(uint seenGeneration)
+        {
+            generation = seenGeneration;
+            ThreadPool.QueueUserWorkItem(delegate
+            {
+                generation = WaitForNotifyGeneration(seenGeneration, 1000);
+                done = true;
+            });
+        }
+
+        public uint Generation
+        {
+            get { return generation; }
+        }
+
+        public override bool keepWaiting
+        {
+            get { return !done; }
+        }
+    }
+
+    // Once the game is hooked, wait for it to publish its first shared surface.  The
+    // generation is read before the handle, so a wakeup between them is not missed.
+
+    private IEnumerator WaitForSharedSurface()
+    {
+        print("WaitForSharedSurface...");
+
+        uint seen = GetNotifyGeneration();
+        while (GetSharedHandle() == 0 && !Exited())
+        {
+            WaitForGameNotify wait = new WaitForGameNotify(seen);
+            yield return wait;
+            seen = wait.Generation;
+        }
+
+        print("->Game published shared surface: " + GetSharedHandle().ToString("x"));
     }
 
     // -----------------------------------------------------------------------------
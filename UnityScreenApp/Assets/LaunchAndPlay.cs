@@ -23,8 +23,10 @@ public class LaunchAndPlay : MonoBehaviour
 
     // Primary Texture received from game as shared ID3D11ShaderResourceView
     // It automatically updates as the injected DLL copies the bits into the
-    // shared resource.
+    // shared resource.  For DX11 games that is a ring of shared resources,
+    // and _latestShared is the one _bothEyes is presently pointing at.
     Texture2D _bothEyes = null;
+    IntPtr _latestShared = IntPtr.Zero;
     public static System.Int32 gGameSharedHandle = 0;
     bool ownMutex = false;
 
@@ -124,6 +126,9 @@ public class LaunchAndPlay : MonoBehaviour
 
         // Start alternating drawing cycle to block mutex during drawing.
         StartCoroutine(EndOfFrame());
+
+        // And wait on the game side for shared surface changes.
+        StartCoroutine(WatchSharedSurface());
     }
 
     // -----------------------------------------------------------------------------
@@ -134,6 +139,10 @@ public class LaunchAndPlay : MonoBehaviour
     [DllImport("UnityNativePlugin64")]
     private static extern IntPtr CreateSharedTexture(int sharedHandle);
     [DllImport("UnityNativePlugin64")]
+    private static extern IntPtr GetLatestSharedTexture();
+    [DllImport("UnityNativePlugin64")]
+    private static extern int GetTakeFrameEvent();
+    [DllImport("UnityNativePlugin64")]
     private static extern int GetGameWidth();
     [DllImport("UnityNativePlugin64")]
     private static extern int GetGameHeight();
@@ -146,10 +155,9 @@ public class LaunchAndPlay : MonoBehaviour
     // PollForSharedSurface will just wait until the CreateDevice has been called in 
     // DeviarePlugin, and thus we have created a shared surface for copying game bits into.
     // This is asynchronous because it's in the game world, and we don't know when
-    // it will happen.  This is a polling mechanism, which is not
-    // great, but should be checking on a 4 byte HANDLE from the game side,
-    // once a frame, which is every 11ms.  Only worth doing something more 
-    // heroic if this proves to be a problem.
+    // it will happen.  This is still called once a frame, which is every 11ms, but
+    // it only reads the HANDLE from the mapped file after the game side has woken
+    // us through the notify event, see WatchSharedSurface.
     //
     // Once the PollForSharedSurface returns with non-null, we are ready to continue
     // with the VR side of showing those bits.  This can also happen later in the
@@ -164,7 +172,12 @@ public class LaunchAndPlay : MonoBehaviour
 
     void PollForSharedSurface()
     {
-        System.Int32 pollHandle = game.GetSharedHandle();
+        if (surfaceChanged)
+        {
+            surfaceChanged = false;
+            polledHandle = game.GetSharedHandle();
+        }
+        System.Int32 pollHandle = polledHandle;
 
         debugprint("PollForSharedSurface handle: " + pollHandle);
 
@@ -201,7 +214,15 @@ public class LaunchAndPlay : MonoBehaviour
             int gameWidth = GetGameWidth();     // double width texture
             int gameHeight = GetGameHeight();
             int format = GetGameFormat();
-            gameAspectRatio = (float)(gameWidth / 2) / (float)gameHeight;
+
+            // The texture can be less than the game's frame, see RequestCopy.  The aspect
+            // ratio is the game's own, and the shader puts a crop where it belongs.
+            int eyeWidth, eyeHeight;
+            float[] crop = new float[4];
+            int copy = GetGameCopy(out eyeWidth, out eyeHeight, crop);
+            gameAspectRatio = (float)eyeWidth / (float)eyeHeight;
+            screenRenderer.material.SetVector("_Crop", new Vector4(crop[0], crop[1], crop[2], crop[3]));
+            print("-> Copy mode: " + copy + ", crop: " + crop[0] + ", " + crop[1] + ", " + crop[2] + ", " + crop[3]);
 
             // Make aspect ratio match the game settings.  Shrink or widen width only, so that
             // the location of center does not change.  This gameWidth will also be used by the
@@ -247,6 +268,7 @@ public class LaunchAndPlay : MonoBehaviour
             // It will always be up to date with latest game image, because we pass in 'shared'.
 
             _bothEyes = Texture2D.CreateExternalTexture(gameWidth, gameHeight, TextureFormat.RGBA32, noMipMaps, colorSpace, shared);
+            _latestShared = shared;
 
             print("..eyes width: " + _bothEyes.width + " height: " + _bothEyes.height + " format: " + _bothEyes.format);
 
@@ -282,6 +304,46 @@ public class LaunchAndPlay : MonoBehaviour
             // Setting it Inactive makes it not take any drawing cycles, as opposed to an empty string.
             infoText.gameObject.SetActive(false);
         }
+
+        // Every frame, pick up the newest complete game frame from the ring of shared
+        // surfaces.  The game side never copies into the one we are drawing, so this
+        // is only a pointer swap when it has presented since last time.
+        //
+        // The plugin trades the slots on the render thread, with the event sent right
+        // after, so a slot is only handed back once the draws that sample it are done.
+        // What it takes there shows up here on the next frame.
+
+        IntPtr latest = GetLatestSharedTexture();
+        if (latest != IntPtr.Zero && latest != _latestShared)
+        {
+            _latestShared = latest;
+            _bothEyes.UpdateExternalTexture(latest);
+        }
+        GL.IssuePluginEvent(GetRenderEventFunc(), GetTakeFrameEvent());
+    }
+
+    // -----------------------------------------------------------------------------
+
+    // The game side wakes us whenever it publishes or retracts its shared surface,
+    // so this awaits that, and only then has PollForSharedSurface read the handle
+    // again.  WaitForGameNotify gives up after a second, which is the fallback for
+    // an older game plugin that never signals.  The flag is only taken in Update,
+    // under the setup mutex, so a change made while the game side holds the mutex
+    // is still there when we get it back.
+
+    bool surfaceChanged = true;
+    System.Int32 polledHandle = 0;
+
+    private IEnumerator WatchSharedSurface()
+    {
+        uint seen = Game.NotifyGeneration();
+        while (true)
+        {
+            Game.WaitForGameNotify wait = new Game.WaitForGameNotify(seen);
+            yield return wait;
+            seen = wait.Generation;
+            surfaceChanged = true;
+        }
     }
 
     // -----------------------------------------------------------------------------
@@ -292,6 +354,9 @@ public class LaunchAndPlay : MonoBehaviour
     // We are grabbing the mutex at the top of Update, then releasing at the 
     // WaitForEndOfFrame, which is after scene rendering.  This should block
     // any game side usage during the time this Unity side is drawing.
+    // Once the game is running, the native plugin does this with a busy flag
+    // in the shared mapped file, and only waits on the real mutex if the game
+    // is in the middle of rebuilding its shared surface.
 
     [DllImport("UnityNativePlugin64")]
     private static extern bool GrabSetupMutex();
@@ -306,8 +371,8 @@ public class LaunchAndPlay : MonoBehaviour
 
         debugprint("-> GrabSetupMutex, ownMutex=" + ownMutex);
 
-        // Keep checking for a change in resolution by the game. This needs to be
-        // done every frame to avoid using textures disposed by Reset.
+        // Pick up a change in resolution by the game, as soon as it has told us
+        // about one, to avoid using textures disposed by Reset.
         // During actual drawing, from yield null to yield WaitForEndOfFrame, we want
         // to lock out the game side from changing the underlying graphics.  
 
@@ -319,6 +384,10 @@ public class LaunchAndPlay : MonoBehaviour
         if (Time.frameCount % 30 == 0)
             System.GC.Collect();
 
+        // Keep the game side up to date with how much of its frame we can use.
+        if (Time.frameCount % 45 == 0)
+            RequestCopy();
+
         // On game exit, we want to switch to DesktopDuplication view, rather than exit.
         if (game.Exited())
         {
@@ -361,6 +430,12 @@ public class LaunchAndPlay : MonoBehaviour
         {
             yield return new WaitForEndOfFrame();
 
+            // The readback is queued on the render thread, after the screen
+            // was drawn from the same shared surface.  Every frame, not just
+            // while capturing, as the plugin also looks at a frame now and then
+            // for its stereo layout, see StereoDetect.h.
+            GL.IssuePluginEvent(GetRenderEventFunc(), kCaptureFrameEvent);
+
             bool release = ReleaseSetupMutex();
             debugprint("<- ReleaseSetupMutex, ownMutex=" + release);
 
@@ -369,6 +444,103 @@ public class LaunchAndPlay : MonoBehaviour
     }
 
 
+    // -----------------------------------------------------------------------------
+
+    // Recording, screenshots or streaming of the game frames, see FrameCapture.h in
+    // the native plugin.  sinkType 0 is one raw file, 1 numbered .pns/.png files,
+    // 2 the Local\KatangaCaptureRing shared memory.  An empty path means the
+    // Katanga folder next to the log.  Every interval'th frame is taken.
+
+    [DllImport("UnityNativePlugin64")]
+    private static extern IntPtr GetRenderEventFunc();
+    [DllImport("UnityNativePlugin64", CharSet = CharSet.Unicode)]
+    private static extern bool StartCapture(int sinkType, string path, int interval);
+    [DllImport("UnityNativePlugin64")]
+    private static extern void StopCapture();
+    [DllImport("UnityNativePlugin64")]
+    private static extern double GetCaptureStat(int stat);
+
+    const int kCaptureFrameEvent = 1;
+    bool capturing = false;
+
+    public bool BeginCapture(int sinkType, string path, int interval)
+    {
+        capturing = StartCapture(sinkType, path, interval);
+        print("BeginCapture sink: " + sinkType + ", started: " + capturing);
+        return capturing;
+    }
+
+    public void EndCapture()
+    {
+        if (!capturing)
+            return;
+        capturing = false;
+        StopCapture();
+        print("EndCapture written: " + GetCaptureStat(0) + ", dropped: " + GetCaptureStat(1) + ", MB/s: " + GetCaptureStat(3));
+    }
+
+    // -----------------------------------------------------------------------------
+
+    // How much of each game frame to copy, see CopyPlan.h in the game plugin.  0 is
+    // every pixel, 1 is half resolution per eye, 2 is only the part of the screen
+    // that is in view.  The game side waits for a request to hold for a moment, and
+    // shows grey while it changes over, so the crop has a margin around the view.
+
+    [DllImport("UnityNativePlugin64")]
+    private static extern void SetCopyRequest(int mode, float x, float y, float width, float height);
+    [DllImport("UnityNativePlugin64")]
+    private static extern int GetGameCopy(out int eyeWidth, out int eyeHeight, float[] crop);
+
+    const int kCopyFull = 0;
+    const int kCopyCrop = 2;
+    const float kViewMargin = 0.15f;    // Of the view, around what we can see.
+    const float kCropMargin = 0.05f;    // Of the screen, past the last vertex in view.
+
+    public void SelectCopyMode(int mode)
+    {
+        PlayerPrefs.SetInt("copy-mode", mode);
+        RequestCopy();
+    }
+
+    void RequestCopy()
+    {
+        int mode = PlayerPrefs.GetInt("copy-mode", kCopyFull);
+        if (mode != kCopyCrop)
+        {
+            SetCopyRequest(mode, 0, 0, 0, 0);
+            return;
+        }
+
+        // The screen mesh uv is the same as the uv into each eye of the texture,
+        // so the crop is the uv of every vertex near enough to the view.
+        Camera view = Camera.main;
+        if (view == null)
+            return;
+        Mesh screenMesh = screenRenderer.GetComponent<MeshFilter>().mesh;
+        Vector3[] vertices = screenMesh.vertices;
+        Vector2[] uv = screenMesh.uv;
+
+        Vector2 min = Vector2.one;
+        Vector2 max = Vector2.zero;
+        for (int i = 0; i < vertices.Length; i++)
+        {
+            Vector3 p = view.WorldToViewportPoint(screenRenderer.transform.TransformPoint(vertices[i]));
+            if (p.z > 0 && p.x > -kViewMargin && p.x < 1 + kViewMargin && p.y > -kViewMargin && p.y < 1 + kViewMargin)
+            {
+                min = Vector2.Min(min, uv[i]);
+                max = Vector2.Max(max, uv[i]);
+            }
+        }
+
+        // Looking away from the screen entirely, keep whatever we had.
+        if (min.x > max.x || min.y > max.y)
+            return;
+
+        min = Vector2.Max(Vector2.zero, min - new Vector2(kCropMargin, kCropMargin));
+        max = Vector2.Min(Vector2.one, max + new Vector2(kCropMargin, kCropMargin));
+        SetCopyRequest(kCopyCrop, min.x, min.y, max.x - min.x, max.y - min.y);
+    }
+
     // -----------------------------------------------------------------------------
 
     [DllImport("UnityNativePlugin64")]
@@ -380,6 +552,8 @@ public class LaunchAndPlay : MonoBehaviour
     {
         print("OnApplicationQuit");
 
+        EndCapture();
+
         CloseFileMappedIPC();
 
         ReleaseSetupMutex();
@@ -2,6 +2,7 @@
 using System.Collections;
 using System.IO;
 using System.Runtime.InteropServices;
+using System.Text;
 using UnityEngine;
 using UnityEngine.UI;
 using Valve.VR;
@@ -24,7 +25,20 @@ public class SlideShow : Game
     private bool playing = true;
     private bool skip = false;
     private readonly float deltaT = 0.4f;    // minimal time to show a slide.
-    private string[] stereoFiles;
+
+    // The folder comes from the plugin's index, see SlideIndex.h, so thousands
+    // of pictures don't mean listing the folder every launch.
+    private int slideCount = 0;
+    private uint slideListGeneration = 0;
+
+    // Slides are decoded ahead of time by the native plugin, see SlideCache.h.
+    // Zero max size keeps the full resolution of the pictures.
+    private readonly int slidesAhead = 3;
+    private readonly int slidesBehind = 1;
+    private readonly int maxSlideWidth = 0;
+    private readonly int maxSlideHeight = 0;
+    private readonly int slideCacheMegabytes = 512;
+    private Texture2D slideTex = null;
 
     // -----------------------------------------------------------------------------
 
@@ -62,17 +76,37 @@ public class SlideShow : Game
         // unity app. Any jps image in that folder will be part of the slide show.
         // We will ship a default set of good examples, but people can add any they like.
         string screenShotFolder = Environment.CurrentDirectory + @"\Stereo Pictures";
-        stereoFiles = Directory.GetFiles(screenShotFolder, "*.jps");
 
-        // Start with first one.
+        SlideCacheStart(slidesAhead, slidesBehind, maxSlideWidth, maxSlideHeight, slideCacheMegabytes);
+        slideCount = SlideIndexOpen(screenShotFolder);
+        slideListGeneration = SlideIndexGeneration();
+
+        // With no index yet, like the first launch, the plugin is still listing
+        // the folder.  That is quick, the thumbnails come after.
+        while (slideCount == 0 && SlideIndexScanning())
+        {
+            yield return null;
+            RefreshSlideList();
+        }
+        RefreshSlideList();
+        if (slideCount == 0)
+        {
+            infoText.text = "No .jps pictures in " + screenShotFolder;
+            yield break;
+        }
+        SlideCacheShow(index);
+
+        // Start with first one.  Nothing is on screen yet, so give it time to decode.
         float spinTime = 0;
-        LoadNextJPS();
+        LoadNextJPS(2000);
 
         // Disable "Launching..." as we start showing slides.
         infoText.gameObject.SetActive(false);
 
         while (true)
         {
+            RefreshSlideList();
+
             if (skip)
             {
                 LoadNextJPS();
@@ -149,21 +183,90 @@ public class SlideShow : Game
 
     private int index = 0;
 
-    public void LoadNextJPS()
+    // KatangaStereoLayout, for the sbsShader's _Layout.
+    const int kLayoutUnknown = 0;
+    const int kLayoutSideBySide = 1;
+
+    [DllImport("UnityNativePlugin64")]
+    private static extern void SlideCacheStart(int ahead, int behind, int maxWidth, int maxHeight, int megabytes);
+    [DllImport("UnityNativePlugin64")]
+    private static extern void SlideCacheShow(int index);
+    [DllImport("UnityNativePlugin64")]
+    private static extern IntPtr SlideCacheGet(int index, int timeoutMs, out int width, out int height);
+
+    [DllImport("UnityNativePlugin64", CharSet = CharSet.Unicode)]
+    private static extern int SlideIndexOpen(string folder);
+    [DllImport("UnityNativePlugin64")]
+    private static extern int SlideIndexUseForSlides();
+    [DllImport("UnityNativePlugin64")]
+    private static extern uint SlideIndexGeneration();
+    [DllImport("UnityNativePlugin64")]
+    [return: MarshalAs(UnmanagedType.U1)]
+    private static extern bool SlideIndexScanning();
+    [DllImport("UnityNativePlugin64", CharSet = CharSet.Unicode)]
+    private static extern int SlideIndexPath(int slide, StringBuilder path, int capacity);
+    [DllImport("UnityNativePlugin64")]
+    [return: MarshalAs(UnmanagedType.U1)]
+    private static extern bool SlideIndexInfo(int slide, out int width, out int height, out int layout);
+
+    // Pictures were added, removed or found to be broken by the background scan.
+    // The slides are renumbered, so we keep going from about the same place.
+
+    private void RefreshSlideList()
     {
-        Texture2D stereoTex = null;
-        byte[] fileData;
-        string filePath = stereoFiles[index];
+        uint generation = SlideIndexGeneration();
+        if (generation == slideListGeneration)
+            return;
 
-        if (File.Exists(filePath))
+        slideListGeneration = generation;
+        slideCount = SlideIndexUseForSlides();
+        if (slideCount > 0)
         {
-            fileData = File.ReadAllBytes(filePath);
-            stereoTex = new Texture2D(2, 2);
-            stereoTex.LoadImage(fileData);            //..this will auto-resize the texture dimensions.
+            index %= slideCount;
+            SlideCacheShow(index);
         }
+    }
+
+    // Normally the slide was decoded in the background while the last one was
+    // up, and this is only the upload.  If it is not ready within timeoutMs, or
+    // the plugin could not decode it, we decode it here like we used to.
 
+    public void LoadNextJPS(int timeoutMs = 250)
+    {
         Material screenMaterial = screen.material;
-        screenMaterial.mainTexture = stereoTex;
+        float scaleY = -1;
+
+        int width, height;
+        IntPtr pixels = SlideCacheGet(index, timeoutMs, out width, out height);
+        if (pixels != IntPtr.Zero)
+        {
+            if (slideTex == null || slideTex.width != width || slideTex.height != height || slideTex.format != TextureFormat.BGRA32)
+            {
+                if (slideTex != null)
+                    Destroy(slideTex);
+                slideTex = new Texture2D(width, height, TextureFormat.BGRA32, false);
+            }
+            slideTex.LoadRawTextureData(pixels, width * height * 4);
+            slideTex.Apply(false);
+
+            // These rows are top first, the same as the game's shared surface, so
+            // they need no flip.
+            scaleY = 1;
+        }
+        else
+        {
+            StringBuilder path = new StringBuilder(1024);
+            string filePath = (SlideIndexPath(index, path, path.Capacity) > 0) ? path.ToString() : "";
+            if (File.Exists(filePath))
+            {
+                if (slideTex != null)
+                    Destroy(slideTex);
+                slideTex = new Texture2D(2, 2);
+                slideTex.LoadImage(File.ReadAllBytes(filePath));      //..this will auto-resize the texture dimensions.
+            }
+        }
+
+        screenMaterial.mainTexture = slideTex;
 
         // The loaded image will be upside down, because JPG does not follow OpenGL coordinate
         // systems.  Invert the image in Y axis by using the TextureScale trick.
@@ -171,10 +274,18 @@ public class SlideShow : Game
         // screen needs to be dynamic for the user to specify, and if we invert
         // there we also invert the infoText.
 
-        screenMaterial.SetTextureScale("_MainTex", new Vector2(1, -1));
+        screenMaterial.SetTextureScale("_MainTex", new Vector2(1, scaleY));
+
+        // How the picture packs the eyes, which the plugin worked out when it
+        // indexed it, see StereoDetect.h.  Until then it's the usual side by side.
+        int pictureWidth, pictureHeight, layout;
+        if (!SlideIndexInfo(index, out pictureWidth, out pictureHeight, out layout) || layout == kLayoutUnknown)
+            layout = kLayoutSideBySide;
+        screenMaterial.SetFloat("_Layout", layout);
 
-        // Circular loop of stereo file name array
+        // Circular loop of stereo file name array, and have the next ones decoded.
         index += 1;
-        index %= stereoFiles.Length;
+        index %= Math.Max(slideCount, 1);
+        SlideCacheShow(index);
     }
 }
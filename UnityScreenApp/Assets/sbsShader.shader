@@ -8,6 +8,8 @@ Shader "Unlit/sbsShader"
 	Properties
 	{
 		[NoScaleOffset] _MainTex ("_bothEyes Texture", 2D) = "grey" {}
+		_Layout ("Stereo layout, a KatangaStereoLayout", Float) = 1
+		_Crop ("Part of each eye in the texture", Vector) = (0, 0, 1, 1)
 	}
 	SubShader
 	{
@@ -31,11 +33,14 @@ Shader "Unlit/sbsShader"
 			struct v2f
 			{
 				float2 uv : TEXCOORD0;
+				float2 eyeUV : TEXCOORD1;
 				float4 vertex : SV_POSITION;
 			};
 
 			sampler2D _MainTex;			
 			float4 _MainTex_ST;
+			float _Layout;
+			float4 _Crop;
 
 			v2f vert (appdata v)
 			{
@@ -52,6 +57,21 @@ Shader "Unlit/sbsShader"
 				sb.y = 1.0;									// No vertical scaling, full size.
 				sb.z = unity_StereoEyeIndex ? 0.0 : 0.5;	// Offset to half for left eye
 				sb.w = 0.0;									// No vertical offset.
+
+				// Other layouts than our usual one, see KatangaStereoLayout
+				// in KatangaIPC.h.  SlideShow sets it for each picture.
+				if (_Layout == 2)							// Swapped, right eye on the right half.
+					sb.z = unity_StereoEyeIndex ? 0.5 : 0.0;
+				else if (_Layout == 3)						// Over under, right eye on top.
+					sb = float4(1.0, 0.5, 0.0, unity_StereoEyeIndex ? 0.0 : 0.5);
+				else if (_Layout == 4)						// Mono, all of it for both eyes.
+					sb = float4(1.0, 1.0, 0.0, 0.0);
+
+				// A cropped copy from the game only has this part of each eye,
+				// see CopyPlan.h in the game plugin.  Around it, it's black.
+				o.eyeUV = v.uv;
+				v.uv = (v.uv - _Crop.xy) / _Crop.zw;
+
 				v.uv = UnityStereoScreenSpaceUVAdjust(v.uv, sb);
 					
                 o.vertex = UnityObjectToClipPos(v.vertex);
@@ -78,6 +98,9 @@ Shader "Unlit/sbsShader"
 
 			fixed4 frag (v2f i) : SV_Target
 			{
+				if (any(i.eyeUV < _Crop.xy) || any(i.eyeUV > _Crop.xy + _Crop.zw))
+					return 0;
+
 				// sample the texture
 				fixed4 col = tex2Dmultisample(_MainTex, i.uv);
 				return col;
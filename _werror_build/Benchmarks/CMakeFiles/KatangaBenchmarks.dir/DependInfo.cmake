@@ -0,0 +1,25 @@
+
+# Consider dependencies only in project.
+set(CMAKE_DEPENDS_IN_PROJECT_ONLY OFF)
+
+# The set of languages for which implicit dependencies are needed:
+set(CMAKE_DEPENDS_LANGUAGES
+  )
+
+# The set of dependency files which are needed:
+set(CMAKE_DEPENDS_DEPENDENCY_FILES
+  "/root/repo/Benchmarks/FrameCaptureBenchmark.cpp" "Benchmarks/CMakeFiles/KatangaBenchmarks.dir/FrameCaptureBenchmark.cpp.o" "gcc" "Benchmarks/CMakeFiles/KatangaBenchmarks.dir/FrameCaptureBenchmark.cpp.o.d"
+  "/root/repo/Benchmarks/HotPathBenchmark.cpp" "Benchmarks/CMakeFiles/KatangaBenchmarks.dir/HotPathBenchmark.cpp.o" "gcc" "Benchmarks/CMakeFiles/KatangaBenchmarks.dir/HotPathBenchmark.cpp.o.d"
+  "/root/repo/Benchmarks/ManagedShadowBenchmark.cpp" "Benchmarks/CMakeFiles/KatangaBenchmarks.dir/ManagedShadowBenchmark.cpp.o" "gcc" "Benchmarks/CMakeFiles/KatangaBenchmarks.dir/ManagedShadowBenchmark.cpp.o.d"
+  "/root/repo/Benchmarks/StagingArenaBenchmark.cpp" "Benchmarks/CMakeFiles/KatangaBenchmarks.dir/StagingArenaBenchmark.cpp.o" "gcc" "Benchmarks/CMakeFiles/KatangaBenchmarks.dir/StagingArenaBenchmark.cpp.o.d"
+  "/root/repo/Benchmarks/StereoPackBenchmark.cpp" "Benchmarks/CMakeFiles/KatangaBenchmarks.dir/StereoPackBenchmark.cpp.o" "gcc" "Benchmarks/CMakeFiles/KatangaBenchmarks.dir/StereoPackBenchmark.cpp.o.d"
+  "/root/repo/Benchmarks/TextureGeneratorBenchmark.cpp" "Benchmarks/CMakeFiles/KatangaBenchmarks.dir/TextureGeneratorBenchmark.cpp.o" "gcc" "Benchmarks/CMakeFiles/KatangaBenchmarks.dir/TextureGeneratorBenchmark.cpp.o.d"
+  )
+
+# Targets to which this target links.
+set(CMAKE_TARGET_LINKED_INFO_FILES
+  "/root/repo/_werror_build/CMakeFiles/KatangaPortable.dir/DependInfo.cmake"
+  )
+
+# Fortran module output directory.
+set(CMAKE_Fortran_TARGET_MODULE_DIR "")
@@ -0,0 +1,21 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/KatangaBenchmarks.dir/FrameCaptureBenchmark.cpp.o"
+  "CMakeFiles/KatangaBenchmarks.dir/FrameCaptureBenchmark.cpp.o.d"
+  "CMakeFiles/KatangaBenchmarks.dir/HotPathBenchmark.cpp.o"
+  "CMakeFiles/KatangaBenchmarks.dir/HotPathBenchmark.cpp.o.d"
+  "CMakeFiles/KatangaBenchmarks.dir/ManagedShadowBenchmark.cpp.o"
+  "CMakeFiles/KatangaBenchmarks.dir/ManagedShadowBenchmark.cpp.o.d"
+  "CMakeFiles/KatangaBenchmarks.dir/StagingArenaBenchmark.cpp.o"
+  "CMakeFiles/KatangaBenchmarks.dir/StagingArenaBenchmark.cpp.o.d"
+  "CMakeFiles/KatangaBenchmarks.dir/StereoPackBenchmark.cpp.o"
+  "CMakeFiles/KatangaBenchmarks.dir/StereoPackBenchmark.cpp.o.d"
+  "CMakeFiles/KatangaBenchmarks.dir/TextureGeneratorBenchmark.cpp.o"
+  "CMakeFiles/KatangaBenchmarks.dir/TextureGeneratorBenchmark.cpp.o.d"
+  "KatangaBenchmarks"
+  "KatangaBenchmarks.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/KatangaBenchmarks.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
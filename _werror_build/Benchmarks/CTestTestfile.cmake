@@ -0,0 +1,8 @@
+# CMake generated Testfile for 
+# Source directory: /root/repo/Benchmarks
+# Build directory: /root/repo/_werror_build/Benchmarks
+# 
+# This file includes the relevant testing commands required for 
+# testing this directory and lists subdirectories to be tested as well.
+add_test(KatangaBenchmarks "/root/repo/_werror_build/Benchmarks/KatangaBenchmarks" "--benchmark_min_time=0.001")
+set_tests_properties(KatangaBenchmarks PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/Benchmarks/CMakeLists.txt;24;add_test;/root/repo/Benchmarks/CMakeLists.txt;0;")
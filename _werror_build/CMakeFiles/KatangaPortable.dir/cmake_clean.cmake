@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/KatangaPortable.dir/DeviarePlugin/KatangaSharedMemory_Posix.cpp.o"
+  "CMakeFiles/KatangaPortable.dir/DeviarePlugin/KatangaSharedMemory_Posix.cpp.o.d"
+  "libKatangaPortable.a"
+  "libKatangaPortable.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/KatangaPortable.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,40 @@
+
+# Consider dependencies only in project.
+set(CMAKE_DEPENDS_IN_PROJECT_ONLY OFF)
+
+# The set of languages for which implicit dependencies are needed:
+set(CMAKE_DEPENDS_LANGUAGES
+  )
+
+# The set of dependency files which are needed:
+set(CMAKE_DEPENDS_DEPENDENCY_FILES
+  "/root/repo/Tests/AsyncLogTest.cpp" "Tests/CMakeFiles/KatangaTests.dir/AsyncLogTest.cpp.o" "gcc" "Tests/CMakeFiles/KatangaTests.dir/AsyncLogTest.cpp.o.d"
+  "/root/repo/Tests/CopyPlanTest.cpp" "Tests/CMakeFiles/KatangaTests.dir/CopyPlanTest.cpp.o" "gcc" "Tests/CMakeFiles/KatangaTests.dir/CopyPlanTest.cpp.o.d"
+  "/root/repo/Tests/FrameCaptureTest.cpp" "Tests/CMakeFiles/KatangaTests.dir/FrameCaptureTest.cpp.o" "gcc" "Tests/CMakeFiles/KatangaTests.dir/FrameCaptureTest.cpp.o.d"
+  "/root/repo/Tests/FramePacerTest.cpp" "Tests/CMakeFiles/KatangaTests.dir/FramePacerTest.cpp.o" "gcc" "Tests/CMakeFiles/KatangaTests.dir/FramePacerTest.cpp.o.d"
+  "/root/repo/Tests/HookSetTest.cpp" "Tests/CMakeFiles/KatangaTests.dir/HookSetTest.cpp.o" "gcc" "Tests/CMakeFiles/KatangaTests.dir/HookSetTest.cpp.o.d"
+  "/root/repo/Tests/KatangaNotifyTest.cpp" "Tests/CMakeFiles/KatangaTests.dir/KatangaNotifyTest.cpp.o" "gcc" "Tests/CMakeFiles/KatangaTests.dir/KatangaNotifyTest.cpp.o.d"
+  "/root/repo/Tests/KatangaStatsTest.cpp" "Tests/CMakeFiles/KatangaTests.dir/KatangaStatsTest.cpp.o" "gcc" "Tests/CMakeFiles/KatangaTests.dir/KatangaStatsTest.cpp.o.d"
+  "/root/repo/Tests/KatangaTraceTest.cpp" "Tests/CMakeFiles/KatangaTests.dir/KatangaTraceTest.cpp.o" "gcc" "Tests/CMakeFiles/KatangaTests.dir/KatangaTraceTest.cpp.o.d"
+  "/root/repo/Tests/KeyedMutexTest.cpp" "Tests/CMakeFiles/KatangaTests.dir/KeyedMutexTest.cpp.o" "gcc" "Tests/CMakeFiles/KatangaTests.dir/KeyedMutexTest.cpp.o.d"
+  "/root/repo/Tests/ManagedShadowTest.cpp" "Tests/CMakeFiles/KatangaTests.dir/ManagedShadowTest.cpp.o" "gcc" "Tests/CMakeFiles/KatangaTests.dir/ManagedShadowTest.cpp.o.d"
+  "/root/repo/Tests/PoolPolicyTest.cpp" "Tests/CMakeFiles/KatangaTests.dir/PoolPolicyTest.cpp.o" "gcc" "Tests/CMakeFiles/KatangaTests.dir/PoolPolicyTest.cpp.o.d"
+  "/root/repo/Tests/SetupHandshakeTest.cpp" "Tests/CMakeFiles/KatangaTests.dir/SetupHandshakeTest.cpp.o" "gcc" "Tests/CMakeFiles/KatangaTests.dir/SetupHandshakeTest.cpp.o.d"
+  "/root/repo/Tests/SharedMemoryTest.cpp" "Tests/CMakeFiles/KatangaTests.dir/SharedMemoryTest.cpp.o" "gcc" "Tests/CMakeFiles/KatangaTests.dir/SharedMemoryTest.cpp.o.d"
+  "/root/repo/Tests/SharedSurfaceCacheTest.cpp" "Tests/CMakeFiles/KatangaTests.dir/SharedSurfaceCacheTest.cpp.o" "gcc" "Tests/CMakeFiles/KatangaTests.dir/SharedSurfaceCacheTest.cpp.o.d"
+  "/root/repo/Tests/StagingArenaTest.cpp" "Tests/CMakeFiles/KatangaTests.dir/StagingArenaTest.cpp.o" "gcc" "Tests/CMakeFiles/KatangaTests.dir/StagingArenaTest.cpp.o.d"
+  "/root/repo/Tests/StereoCopyPathTest.cpp" "Tests/CMakeFiles/KatangaTests.dir/StereoCopyPathTest.cpp.o" "gcc" "Tests/CMakeFiles/KatangaTests.dir/StereoCopyPathTest.cpp.o.d"
+  "/root/repo/Tests/StereoPackTest.cpp" "Tests/CMakeFiles/KatangaTests.dir/StereoPackTest.cpp.o" "gcc" "Tests/CMakeFiles/KatangaTests.dir/StereoPackTest.cpp.o.d"
+  "/root/repo/Tests/SurfaceReplayTest.cpp" "Tests/CMakeFiles/KatangaTests.dir/SurfaceReplayTest.cpp.o" "gcc" "Tests/CMakeFiles/KatangaTests.dir/SurfaceReplayTest.cpp.o.d"
+  "/root/repo/Tests/SwapChainCacheTest.cpp" "Tests/CMakeFiles/KatangaTests.dir/SwapChainCacheTest.cpp.o" "gcc" "Tests/CMakeFiles/KatangaTests.dir/SwapChainCacheTest.cpp.o.d"
+  "/root/repo/Tests/TextureGeneratorTest.cpp" "Tests/CMakeFiles/KatangaTests.dir/TextureGeneratorTest.cpp.o" "gcc" "Tests/CMakeFiles/KatangaTests.dir/TextureGeneratorTest.cpp.o.d"
+  "/root/repo/Tests/VtableCacheTest.cpp" "Tests/CMakeFiles/KatangaTests.dir/VtableCacheTest.cpp.o" "gcc" "Tests/CMakeFiles/KatangaTests.dir/VtableCacheTest.cpp.o.d"
+  )
+
+# Targets to which this target links.
+set(CMAKE_TARGET_LINKED_INFO_FILES
+  "/root/repo/_werror_build/CMakeFiles/KatangaPortable.dir/DependInfo.cmake"
+  )
+
+# Fortran module output directory.
+set(CMAKE_Fortran_TARGET_MODULE_DIR "")
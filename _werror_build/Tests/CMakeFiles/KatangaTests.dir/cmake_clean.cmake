@@ -0,0 +1,52 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/KatangaTests.dir/AsyncLogTest.cpp.o"
+  "CMakeFiles/KatangaTests.dir/AsyncLogTest.cpp.o.d"
+  "CMakeFiles/KatangaTests.dir/CopyPlanTest.cpp.o"
+  "CMakeFiles/KatangaTests.dir/CopyPlanTest.cpp.o.d"
+  "CMakeFiles/KatangaTests.dir/FrameCaptureTest.cpp.o"
+  "CMakeFiles/KatangaTests.dir/FrameCaptureTest.cpp.o.d"
+  "CMakeFiles/KatangaTests.dir/FramePacerTest.cpp.o"
+  "CMakeFiles/KatangaTests.dir/FramePacerTest.cpp.o.d"
+  "CMakeFiles/KatangaTests.dir/HookSetTest.cpp.o"
+  "CMakeFiles/KatangaTests.dir/HookSetTest.cpp.o.d"
+  "CMakeFiles/KatangaTests.dir/KatangaNotifyTest.cpp.o"
+  "CMakeFiles/KatangaTests.dir/KatangaNotifyTest.cpp.o.d"
+  "CMakeFiles/KatangaTests.dir/KatangaStatsTest.cpp.o"
+  "CMakeFiles/KatangaTests.dir/KatangaStatsTest.cpp.o.d"
+  "CMakeFiles/KatangaTests.dir/KatangaTraceTest.cpp.o"
+  "CMakeFiles/KatangaTests.dir/KatangaTraceTest.cpp.o.d"
+  "CMakeFiles/KatangaTests.dir/KeyedMutexTest.cpp.o"
+  "CMakeFiles/KatangaTests.dir/KeyedMutexTest.cpp.o.d"
+  "CMakeFiles/KatangaTests.dir/ManagedShadowTest.cpp.o"
+  "CMakeFiles/KatangaTests.dir/ManagedShadowTest.cpp.o.d"
+  "CMakeFiles/KatangaTests.dir/PoolPolicyTest.cpp.o"
+  "CMakeFiles/KatangaTests.dir/PoolPolicyTest.cpp.o.d"
+  "CMakeFiles/KatangaTests.dir/SetupHandshakeTest.cpp.o"
+  "CMakeFiles/KatangaTests.dir/SetupHandshakeTest.cpp.o.d"
+  "CMakeFiles/KatangaTests.dir/SharedMemoryTest.cpp.o"
+  "CMakeFiles/KatangaTests.dir/SharedMemoryTest.cpp.o.d"
+  "CMakeFiles/KatangaTests.dir/SharedSurfaceCacheTest.cpp.o"
+  "CMakeFiles/KatangaTests.dir/SharedSurfaceCacheTest.cpp.o.d"
+  "CMakeFiles/KatangaTests.dir/StagingArenaTest.cpp.o"
+  "CMakeFiles/KatangaTests.dir/StagingArenaTest.cpp.o.d"
+  "CMakeFiles/KatangaTests.dir/StereoCopyPathTest.cpp.o"
+  "CMakeFiles/KatangaTests.dir/StereoCopyPathTest.cpp.o.d"
+  "CMakeFiles/KatangaTests.dir/StereoPackTest.cpp.o"
+  "CMakeFiles/KatangaTests.dir/StereoPackTest.cpp.o.d"
+  "CMakeFiles/KatangaTests.dir/SurfaceReplayTest.cpp.o"
+  "CMakeFiles/KatangaTests.dir/SurfaceReplayTest.cpp.o.d"
+  "CMakeFiles/KatangaTests.dir/SwapChainCacheTest.cpp.o"
+  "CMakeFiles/KatangaTests.dir/SwapChainCacheTest.cpp.o.d"
+  "CMakeFiles/KatangaTests.dir/TextureGeneratorTest.cpp.o"
+  "CMakeFiles/KatangaTests.dir/TextureGeneratorTest.cpp.o.d"
+  "CMakeFiles/KatangaTests.dir/VtableCacheTest.cpp.o"
+  "CMakeFiles/KatangaTests.dir/VtableCacheTest.cpp.o.d"
+  "KatangaTests"
+  "KatangaTests.pdb"
+  "KatangaTests[1]_tests.cmake"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/KatangaTests.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
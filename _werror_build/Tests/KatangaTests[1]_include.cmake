@@ -0,0 +1,5 @@
+if(EXISTS "/root/repo/_werror_build/Tests/KatangaTests[1]_tests.cmake")
+  include("/root/repo/_werror_build/Tests/KatangaTests[1]_tests.cmake")
+else()
+  add_test(KatangaTests_NOT_BUILT KatangaTests_NOT_BUILT)
+endif()
@@ -0,0 +1,407 @@
+add_test([=[AsyncLog.FormatsIntegers]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=AsyncLog.FormatsIntegers]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[AsyncLog.FormatsIntegers]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[AsyncLog.HexIsMaskedToTheCallersSize]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=AsyncLog.HexIsMaskedToTheCallersSize]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[AsyncLog.HexIsMaskedToTheCallersSize]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[AsyncLog.FormatsFloatsPointersAndChars]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=AsyncLog.FormatsFloatsPointersAndChars]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[AsyncLog.FormatsFloatsPointersAndChars]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[AsyncLog.FormatsStringsAsMSVCDoes]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=AsyncLog.FormatsStringsAsMSVCDoes]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[AsyncLog.FormatsStringsAsMSVCDoes]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[AsyncLog.MissingArgumentsDoNotCrash]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=AsyncLog.MissingArgumentsDoNotCrash]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[AsyncLog.MissingArgumentsDoNotCrash]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[AsyncLog.CopiesBuffersThatTheCallerReuses]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=AsyncLog.CopiesBuffersThatTheCallerReuses]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[AsyncLog.CopiesBuffersThatTheCallerReuses]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[AsyncLog.LongTextIsTruncated]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=AsyncLog.LongTextIsTruncated]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[AsyncLog.LongTextIsTruncated]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[AsyncLog.FlushWritesEverythingQueued]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=AsyncLog.FlushWritesEverythingQueued]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[AsyncLog.FlushWritesEverythingQueued]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[AsyncLog.ManyProducersLoseNothingUncounted]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=AsyncLog.ManyProducersLoseNothingUncounted]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[AsyncLog.ManyProducersLoseNothingUncounted]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[CopyPlanTest.NewRequestAfterItSettles]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=CopyPlanTest.NewRequestAfterItSettles]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[CopyPlanTest.NewRequestAfterItSettles]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[CopyPlanTest.SmallCropMovesAreNotAChange]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=CopyPlanTest.SmallCropMovesAreNotAChange]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[CopyPlanTest.SmallCropMovesAreNotAChange]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[CopyPlanTest.WobbleSettlesAndJumpsStartOver]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=CopyPlanTest.WobbleSettlesAndJumpsStartOver]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[CopyPlanTest.WobbleSettlesAndJumpsStartOver]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[CopyPlanTest.SteadyRequestForTheSameCopyIsKept]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=CopyPlanTest.SteadyRequestForTheSameCopyIsKept]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[CopyPlanTest.SteadyRequestForTheSameCopyIsKept]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[FrameCapture.FramesReachTheSinkInOrder]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=FrameCapture.FramesReachTheSinkInOrder]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[FrameCapture.FramesReachTheSinkInOrder]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[FrameCapture.IntervalSkipsFrames]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=FrameCapture.IntervalSkipsFrames]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[FrameCapture.IntervalSkipsFrames]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[FrameCapture.FullRingDropsFramesAndReleasesAfterTheSink]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=FrameCapture.FullRingDropsFramesAndReleasesAfterTheSink]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[FrameCapture.FullRingDropsFramesAndReleasesAfterTheSink]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[FrameCapture.PendingCopiesAreMappedInOrder]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=FrameCapture.PendingCopiesAreMappedInOrder]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[FrameCapture.PendingCopiesAreMappedInOrder]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[FrameCapture.FailedMapFreesTheSlot]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=FrameCapture.FailedMapFreesTheSlot]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[FrameCapture.FailedMapFreesTheSlot]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[FrameCapture.FailedCopyTakesNoIndex]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=FrameCapture.FailedCopyTakesNoIndex]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[FrameCapture.FailedCopyTakesNoIndex]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[FrameCapture.FailedWriteStillReleasesTheSlot]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=FrameCapture.FailedWriteStillReleasesTheSlot]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[FrameCapture.FailedWriteStillReleasesTheSlot]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[FrameCapture.FailedStagingDropsAndTriesAgain]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=FrameCapture.FailedStagingDropsAndTriesAgain]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[FrameCapture.FailedStagingDropsAndTriesAgain]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[FrameCapture.NewSizeRecreatesTheStaging]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=FrameCapture.NewSizeRecreatesTheStaging]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[FrameCapture.NewSizeRecreatesTheStaging]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[FrameCapture.NewSizeWaitsForTheSink]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=FrameCapture.NewSizeWaitsForTheSink]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[FrameCapture.NewSizeWaitsForTheSink]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[FrameCapture.NewSizeUnmapsWhatTheSinkJustFinished]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=FrameCapture.NewSizeUnmapsWhatTheSinkJustFinished]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[FrameCapture.NewSizeUnmapsWhatTheSinkJustFinished]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[FrameCapture.EmptySourceIsDropped]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=FrameCapture.EmptySourceIsDropped]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[FrameCapture.EmptySourceIsDropped]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[FrameCapture.StopAndStartAnotherSink]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=FrameCapture.StopAndStartAnotherSink]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[FrameCapture.StopAndStartAnotherSink]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[FrameCapture.LatestRequestWins]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=FrameCapture.LatestRequestWins]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[FrameCapture.LatestRequestWins]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[CaptureSinkTest.RawPacksRowsOfEveryFrame]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=CaptureSinkTest.RawPacksRowsOfEveryFrame]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[CaptureSinkTest.RawPacksRowsOfEveryFrame]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[CaptureSinkTest.RawRefusesANewSize]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=CaptureSinkTest.RawRefusesANewSize]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[CaptureSinkTest.RawRefusesANewSize]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[CaptureSinkTest.RawFailsWhenItCantOpen]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=CaptureSinkTest.RawFailsWhenItCantOpen]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[CaptureSinkTest.RawFailsWhenItCantOpen]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[CaptureSinkTest.PngHasTheFramePixels]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=CaptureSinkTest.PngHasTheFramePixels]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[CaptureSinkTest.PngHasTheFramePixels]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[CaptureSinkTest.PngSwapsHalvesAndChannels]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=CaptureSinkTest.PngSwapsHalvesAndChannels]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[CaptureSinkTest.PngSwapsHalvesAndChannels]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[CaptureSinkTest.PngFailsWhenItCantOpen]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=CaptureSinkTest.PngFailsWhenItCantOpen]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[CaptureSinkTest.PngFailsWhenItCantOpen]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[CaptureSinkTest.MemoryRingHoldsTheLatestFrame]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=CaptureSinkTest.MemoryRingHoldsTheLatestFrame]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[CaptureSinkTest.MemoryRingHoldsTheLatestFrame]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[PngCaptureSink.ChecksumsMatchKnownValues]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=PngCaptureSink.ChecksumsMatchKnownValues]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[PngCaptureSink.ChecksumsMatchKnownValues]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[PngCaptureSinkLayout.SwappedHalvesAndNames]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=PngCaptureSinkLayout.SwappedHalvesAndNames]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[PngCaptureSinkLayout.SwappedHalvesAndNames]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[MemoryRingCaptureSink.TornReadsAreRefused]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=MemoryRingCaptureSink.TornReadsAreRefused]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[MemoryRingCaptureSink.TornReadsAreRefused]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[FramePacer.CopiesEveryFrameUntilTheVRSideSamples]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=FramePacer.CopiesEveryFrameUntilTheVRSideSamples]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[FramePacer.CopiesEveryFrameUntilTheVRSideSamples]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[FramePacer.CountsOnlyCopiesThatHappened]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=FramePacer.CountsOnlyCopiesThatHappened]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[FramePacer.CountsOnlyCopiesThatHappened]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[FramePacer.RateCapHoldsCopiesBack]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=FramePacer.RateCapHoldsCopiesBack]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[FramePacer.RateCapHoldsCopiesBack]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[FramePacer.PendingCopyWaitsForTheNextSample]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=FramePacer.PendingCopyWaitsForTheNextSample]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[FramePacer.PendingCopyWaitsForTheNextSample]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[PacingSimulation.NeverTears]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=PacingSimulation.NeverTears]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[PacingSimulation.NeverTears]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[PacingSimulation.SlowGamesCopyEveryFrame]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=PacingSimulation.SlowGamesCopyEveryFrame]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[PacingSimulation.SlowGamesCopyEveryFrame]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[PacingSimulation.FastGamesCopyLessWithoutGoingStale]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=PacingSimulation.FastGamesCopyLessWithoutGoingStale]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[PacingSimulation.FastGamesCopyLessWithoutGoingStale]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[PacingSimulation.SameConfigSameReport]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=PacingSimulation.SameConfigSameReport]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[PacingSimulation.SameConfigSameReport]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[HookSetTest.InstallsOnlyTheAskedForGroups]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=HookSetTest.InstallsOnlyTheAskedForGroups]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[HookSetTest.InstallsOnlyTheAskedForGroups]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[HookSetTest.InstallingAgainOnlyAddsWhatIsMissing]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=HookSetTest.InstallingAgainOnlyAddsWhatIsMissing]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[HookSetTest.InstallingAgainOnlyAddsWhatIsMissing]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[HookSetTest.FailedHooksAreCountedAndTriedAgain]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=HookSetTest.FailedHooksAreCountedAndTriedAgain]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[HookSetTest.FailedHooksAreCountedAndTriedAgain]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[HookSetTest.NoAddressFailsWithoutHooking]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=HookSetTest.NoAddressFailsWithoutHooking]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[HookSetTest.NoAddressFailsWithoutHooking]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[HookSetTest.InstallTimeIsKept]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=HookSetTest.InstallTimeIsKept]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[HookSetTest.InstallTimeIsKept]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[HookSetTest.InstallAtAKnownAddress]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=HookSetTest.InstallAtAKnownAddress]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[HookSetTest.InstallAtAKnownAddress]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[HookSetTest.InstallAtSkipsInstalledAndFailsWithoutAnAddress]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=HookSetTest.InstallAtSkipsInstalledAndFailsWithoutAnAddress]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[HookSetTest.InstallAtSkipsInstalledAndFailsWithoutAnAddress]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[HookSetTest.CallsAreCountedFromAnyThread]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=HookSetTest.CallsAreCountedFromAnyThread]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[HookSetTest.CallsAreCountedFromAnyThread]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[KatangaNotify.NotOpenDoesNothing]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=KatangaNotify.NotOpenDoesNothing]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[KatangaNotify.NotOpenDoesNothing]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[KatangaNotify.SignalBeforeWaitIsNotLost]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=KatangaNotify.SignalBeforeWaitIsNotLost]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[KatangaNotify.SignalBeforeWaitIsNotLost]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[KatangaNotify.SignalsCollapseIntoOneWakeup]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=KatangaNotify.SignalsCollapseIntoOneWakeup]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[KatangaNotify.SignalsCollapseIntoOneWakeup]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[KatangaNotify.WaitTimesOut]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=KatangaNotify.WaitTimesOut]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[KatangaNotify.WaitTimesOut]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[KatangaNotify.SignalWakesABlockedWait]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=KatangaNotify.SignalWakesABlockedWait]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[KatangaNotify.SignalWakesABlockedWait]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[KatangaNotify.OnlyOneWaiterTakesASignal]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=KatangaNotify.OnlyOneWaiterTakesASignal]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[KatangaNotify.OnlyOneWaiterTakesASignal]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[KatangaNotify.NamesAreSeparate]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=KatangaNotify.NamesAreSeparate]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[KatangaNotify.NamesAreSeparate]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[KatangaNotify.SignalsAcrossProcesses]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=KatangaNotify.SignalsAcrossProcesses]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[KatangaNotify.SignalsAcrossProcesses]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[KatangaNotify.GenerationWaitReturnsAtOnceIfAlreadyPast]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=KatangaNotify.GenerationWaitReturnsAtOnceIfAlreadyPast]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[KatangaNotify.GenerationWaitReturnsAtOnceIfAlreadyPast]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[KatangaNotify.GenerationWaitTimesOutWithTheSeenOne]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=KatangaNotify.GenerationWaitTimesOutWithTheSeenOne]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[KatangaNotify.GenerationWaitTimesOutWithTheSeenOne]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[KatangaNotify.GenerationGatedWake]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=KatangaNotify.GenerationGatedWake]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[KatangaNotify.GenerationGatedWake]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[KatangaNotify.StopReleasesGenerationWaiters]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=KatangaNotify.StopReleasesGenerationWaiters]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[KatangaNotify.StopReleasesGenerationWaiters]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[KatangaStats.SmallValuesGetTheirOwnBucket]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=KatangaStats.SmallValuesGetTheirOwnBucket]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[KatangaStats.SmallValuesGetTheirOwnBucket]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[KatangaStats.BucketBoundaries]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=KatangaStats.BucketBoundaries]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[KatangaStats.BucketBoundaries]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[KatangaStats.EveryValueIsWithinItsBucket]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=KatangaStats.EveryValueIsWithinItsBucket]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[KatangaStats.EveryValueIsWithinItsBucket]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[KatangaStats.HugeValuesLandInTheLastBucket]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=KatangaStats.HugeValuesLandInTheLastBucket]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[KatangaStats.HugeValuesLandInTheLastBucket]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[KatangaStats.RecordCountsSumsAndMax]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=KatangaStats.RecordCountsSumsAndMax]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[KatangaStats.RecordCountsSumsAndMax]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[KatangaStats.NegativeTicksCountAsZero]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=KatangaStats.NegativeTicksCountAsZero]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[KatangaStats.NegativeTicksCountAsZero]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[KatangaStats.PercentilesOfAKnownSet]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=KatangaStats.PercentilesOfAKnownSet]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[KatangaStats.PercentilesOfAKnownSet]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[KatangaStats.PercentilesReadLowByLessThanABucket]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=KatangaStats.PercentilesReadLowByLessThanABucket]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[KatangaStats.PercentilesReadLowByLessThanABucket]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[KatangaStats.EmptyHistogramIsZero]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=KatangaStats.EmptyHistogramIsZero]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[KatangaStats.EmptyHistogramIsZero]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[KatangaStats.OverflowKeepsTheRealMax]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=KatangaStats.OverflowKeepsTheRealMax]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[KatangaStats.OverflowKeepsTheRealMax]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[KatangaStats.RecordPresentSplitsTheFrame]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=KatangaStats.RecordPresentSplitsTheFrame]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[KatangaStats.RecordPresentSplitsTheFrame]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[KatangaStats.InitValidatesThePage]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=KatangaStats.InitValidatesThePage]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[KatangaStats.InitValidatesThePage]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[KatangaStats.InitResetsAnEarlierRun]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=KatangaStats.InitResetsAnEarlierRun]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[KatangaStats.InitResetsAnEarlierRun]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[KatangaStats.PoolDecisionsAreCountedByResourceAndAction]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=KatangaStats.PoolDecisionsAreCountedByResourceAndAction]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[KatangaStats.PoolDecisionsAreCountedByResourceAndAction]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[KatangaTrace.SpanAndInstantFormat]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=KatangaTrace.SpanAndInstantFormat]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[KatangaTrace.SpanAndInstantFormat]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[KatangaTrace.InstantHasProcessScope]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=KatangaTrace.InstantHasProcessScope]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[KatangaTrace.InstantHasProcessScope]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[KatangaTrace.NestedScopesNestInTime]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=KatangaTrace.NestedScopesNestInTime]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[KatangaTrace.NestedScopesNestInTime]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[KatangaTrace.ThreadsGetTheirOwnIds]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=KatangaTrace.ThreadsGetTheirOwnIds]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[KatangaTrace.ThreadsGetTheirOwnIds]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[KatangaTrace.NamesAreEscaped]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=KatangaTrace.NamesAreEscaped]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[KatangaTrace.NamesAreEscaped]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[KatangaTrace.RingKeepsTheNewest]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=KatangaTrace.RingKeepsTheNewest]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[KatangaTrace.RingKeepsTheNewest]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[KatangaTrace.EmptyTracerHasOnlyItsName]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=KatangaTrace.EmptyTracerHasOnlyItsName]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[KatangaTrace.EmptyTracerHasOnlyItsName]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[KatangaTrace.TwoSidesMergeIntoOneFile]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=KatangaTrace.TwoSidesMergeIntoOneFile]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[KatangaTrace.TwoSidesMergeIntoOneFile]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[KatangaTrace.AppendNeedsAFile]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=KatangaTrace.AppendNeedsAFile]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[KatangaTrace.AppendNeedsAFile]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[KeyedMutexTest.TakesEachFreshFrame]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=KeyedMutexTest.TakesEachFreshFrame]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[KeyedMutexTest.TakesEachFreshFrame]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[KeyedMutexTest.BusyKeyKeepsTheHeldSlot]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=KeyedMutexTest.BusyKeyKeepsTheHeldSlot]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[KeyedMutexTest.BusyKeyKeepsTheHeldSlot]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[KeyedMutexTest.FrameReplacedBeforeTheTradeIsHandedBack]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=KeyedMutexTest.FrameReplacedBeforeTheTradeIsHandedBack]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[KeyedMutexTest.FrameReplacedBeforeTheTradeIsHandedBack]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[KeyedMutexTest.NoSlotIsEverOwnedTwice]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=KeyedMutexTest.NoSlotIsEverOwnedTwice]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[KeyedMutexTest.NoSlotIsEverOwnedTwice]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[ManagedShadow.RectBasics]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=ManagedShadow.RectBasics]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[ManagedShadow.RectBasics]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[ManagedShadow.EmptyRectsAreNotDirty]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=ManagedShadow.EmptyRectsAreNotDirty]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[ManagedShadow.EmptyRectsAreNotDirty]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[ManagedShadow.ContainedRectsAddNothing]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=ManagedShadow.ContainedRectsAddNothing]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[ManagedShadow.ContainedRectsAddNothing]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[ManagedShadow.TouchingRectsMerge]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=ManagedShadow.TouchingRectsMerge]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[ManagedShadow.TouchingRectsMerge]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[ManagedShadow.FullRegionMergesTheClosestPair]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=ManagedShadow.FullRegionMergesTheClosestPair]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[ManagedShadow.FullRegionMergesTheClosestPair]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[ManagedShadow.FindsTexturesAndSurfaces]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=ManagedShadow.FindsTexturesAndSurfaces]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[ManagedShadow.FindsTexturesAndSurfaces]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[ManagedShadow.SurfacesNeedAKnownLevel]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=ManagedShadow.SurfacesNeedAKnownLevel]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[ManagedShadow.SurfacesNeedAKnownLevel]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[ManagedShadow.RemoveHandsBackTheShadow]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=ManagedShadow.RemoveHandsBackTheShadow]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[ManagedShadow.RemoveHandsBackTheShadow]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[ManagedShadow.LevelsPastTheLimitAreDropped]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=ManagedShadow.LevelsPastTheLimitAreDropped]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[ManagedShadow.LevelsPastTheLimitAreDropped]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[ManagedShadow.UnlockUploadsTheLockedRect]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=ManagedShadow.UnlockUploadsTheLockedRect]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[ManagedShadow.UnlockUploadsTheLockedRect]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[ManagedShadow.RectsAreRoundedToBlocksAndClamped]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=ManagedShadow.RectsAreRoundedToBlocksAndClamped]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[ManagedShadow.RectsAreRoundedToBlocksAndClamped]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[ManagedShadow.WholeLevelLock]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=ManagedShadow.WholeLevelLock]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[ManagedShadow.WholeLevelLock]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[ManagedShadow.NestedLocksUploadAtTheLastUnlock]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=ManagedShadow.NestedLocksUploadAtTheLastUnlock]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[ManagedShadow.NestedLocksUploadAtTheLastUnlock]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[ManagedShadow.LevelsAreSeparate]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=ManagedShadow.LevelsAreSeparate]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[ManagedShadow.LevelsAreSeparate]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[ManagedShadow.UnknownTexturesAndLevelsAreIgnored]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=ManagedShadow.UnknownTexturesAndLevelsAreIgnored]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[ManagedShadow.UnknownTexturesAndLevelsAreIgnored]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[ManagedShadow.FailedUploadsStayDirty]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=ManagedShadow.FailedUploadsStayDirty]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[ManagedShadow.FailedUploadsStayDirty]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[ManagedShadow.RestoreUploadsEveryLevel]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=ManagedShadow.RestoreUploadsEveryLevel]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[ManagedShadow.RestoreUploadsEveryLevel]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[ManagedShadow.RestoreOfALockedLevelWaitsForItsUnlock]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=ManagedShadow.RestoreOfALockedLevelWaitsForItsUnlock]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[ManagedShadow.RestoreOfALockedLevelWaitsForItsUnlock]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[ManagedShadow.FailedRestoreIsTriedAgain]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=ManagedShadow.FailedRestoreIsTriedAgain]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[ManagedShadow.FailedRestoreIsTriedAgain]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[PoolPolicy.NotManagedPassesThrough]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=PoolPolicy.NotManagedPassesThrough]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[PoolPolicy.NotManagedPassesThrough]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[PoolPolicy.ManagedTargetsArePlainDefault]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=PoolPolicy.ManagedTargetsArePlainDefault]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[PoolPolicy.ManagedTargetsArePlainDefault]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[PoolPolicy.ManagedBuffersBySize]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=PoolPolicy.ManagedBuffersBySize]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[PoolPolicy.ManagedBuffersBySize]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[PoolPolicy.ManagedTexturesByKind]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=PoolPolicy.ManagedTexturesByKind]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[PoolPolicy.ManagedTexturesByKind]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[PoolPolicy.ParsesEveryCondition]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=PoolPolicy.ParsesEveryCondition]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[PoolPolicy.ParsesEveryCondition]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[PoolPolicy.ParsesTheShortestRules]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=PoolPolicy.ParsesTheShortestRules]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[PoolPolicy.ParsesTheShortestRules]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[PoolPolicy.RejectsMalformedRules]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=PoolPolicy.RejectsMalformedRules]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[PoolPolicy.RejectsMalformedRules]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[PoolPolicy.RuleMatchesOnlyInsideItsLimits]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=PoolPolicy.RuleMatchesOnlyInsideItsLimits]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[PoolPolicy.RuleMatchesOnlyInsideItsLimits]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[PoolPolicy.LoadsOnlyTheGameAndAnySections]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=PoolPolicy.LoadsOnlyTheGameAndAnySections]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[PoolPolicy.LoadsOnlyTheGameAndAnySections]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[PoolPolicy.GameRulesBeatAnyRulesBeatBuiltins]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=PoolPolicy.GameRulesBeatAnyRulesBeatBuiltins]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[PoolPolicy.GameRulesBeatAnyRulesBeatBuiltins]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[PoolPolicy.AnySectionFirstInTheFileStillComesSecond]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=PoolPolicy.AnySectionFirstInTheFileStillComesSecond]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[PoolPolicy.AnySectionFirstInTheFileStillComesSecond]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[PoolPolicy.SectionsCanRepeat]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=PoolPolicy.SectionsCanRepeat]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[PoolPolicy.SectionsCanRepeat]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[PoolPolicy.MalformedLinesAreSkippedAndCounted]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=PoolPolicy.MalformedLinesAreSkippedAndCounted]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[PoolPolicy.MalformedLinesAreSkippedAndCounted]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[PoolPolicy.UnclosedSectionSkipsItsRules]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=PoolPolicy.UnclosedSectionSkipsItsRules]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[PoolPolicy.UnclosedSectionSkipsItsRules]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[PoolPolicy.OverlongLineIsAnError]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=PoolPolicy.OverlongLineIsAnError]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[PoolPolicy.OverlongLineIsAnError]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[PoolPolicy.RulesPastTheLimitAreErrors]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=PoolPolicy.RulesPastTheLimitAreErrors]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[PoolPolicy.RulesPastTheLimitAreErrors]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[PoolPolicy.ReloadingReplacesTheProfile]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=PoolPolicy.ReloadingReplacesTheProfile]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[PoolPolicy.ReloadingReplacesTheProfile]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[PoolPolicy.CallsRuleSeesTheCallerCounts]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=PoolPolicy.CallsRuleSeesTheCallerCounts]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[PoolPolicy.CallsRuleSeesTheCallerCounts]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[PoolPolicy.CallerCountsArePerResource]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=PoolPolicy.CallerCountsArePerResource]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[PoolPolicy.CallerCountsArePerResource]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[PoolPolicy.FullCallerTableCountsNewCallersAsFirst]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=PoolPolicy.FullCallerTableCountsNewCallersAsFirst]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[PoolPolicy.FullCallerTableCountsNewCallersAsFirst]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[SetupHandshake.NoTornDescriptorAcrossProcesses]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=SetupHandshake.NoTornDescriptorAcrossProcesses]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[SetupHandshake.NoTornDescriptorAcrossProcesses]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[SetupHandshake.LockedOutSecondBeginKeepsFrameBusy]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=SetupHandshake.LockedOutSecondBeginKeepsFrameBusy]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[SetupHandshake.LockedOutSecondBeginKeepsFrameBusy]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[SharedMemory.CreateIsZeroFilled]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=SharedMemory.CreateIsZeroFilled]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[SharedMemory.CreateIsZeroFilled]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[SharedMemory.OpenBeforeCreateFails]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=SharedMemory.OpenBeforeCreateFails]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[SharedMemory.OpenBeforeCreateFails]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[SharedMemory.BothViewsSeeTheSameDescriptor]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=SharedMemory.BothViewsSeeTheSameDescriptor]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[SharedMemory.BothViewsSeeTheSameDescriptor]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[SharedMemory.DescriptorAcrossProcesses]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=SharedMemory.DescriptorAcrossProcesses]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[SharedMemory.DescriptorAcrossProcesses]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[SharedSurfaceCacheTest.SameRingAgainIsAllHits]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=SharedSurfaceCacheTest.SameRingAgainIsAllHits]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[SharedSurfaceCacheTest.SameRingAgainIsAllHits]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[SharedSurfaceCacheTest.NewRingReleasesTheOldOne]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=SharedSurfaceCacheTest.NewRingReleasesTheOldOne]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[SharedSurfaceCacheTest.NewRingReleasesTheOldOne]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[SharedSurfaceCacheTest.RetainKeepsOnlyPublishedHandles]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=SharedSurfaceCacheTest.RetainKeepsOnlyPublishedHandles]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[SharedSurfaceCacheTest.RetainKeepsOnlyPublishedHandles]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[SharedSurfaceCacheTest.ClearReleasesEverything]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=SharedSurfaceCacheTest.ClearReleasesEverything]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[SharedSurfaceCacheTest.ClearReleasesEverything]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[StagingArena.ReusesOneBufferWithoutReallocating]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=StagingArena.ReusesOneBufferWithoutReallocating]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[StagingArena.ReusesOneBufferWithoutReallocating]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[StagingArena.NewSizeFreesTheOldBuffer]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=StagingArena.NewSizeFreesTheOldBuffer]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[StagingArena.NewSizeFreesTheOldBuffer]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[StagingArena.FailedAllocationIsTriedAgain]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=StagingArena.FailedAllocationIsTriedAgain]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[StagingArena.FailedAllocationIsTriedAgain]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[StagingArena.ReleaseAndDestructorFreeEverything]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=StagingArena.ReleaseAndDestructorFreeEverything]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[StagingArena.ReleaseAndDestructorFreeEverything]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[StereoCopyPath.ClassifiesTheReadbacks]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=StereoCopyPath.ClassifiesTheReadbacks]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[StereoCopyPath.ClassifiesTheReadbacks]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[StereoCopyPath.EmptyReadbackIsInconclusive]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=StereoCopyPath.EmptyReadbackIsInconclusive]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[StereoCopyPath.EmptyReadbackIsInconclusive]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[StereoCopyPath.StereoProbeSwitchesToDirect]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=StereoCopyPath.StereoProbeSwitchesToDirect]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[StereoCopyPath.StereoProbeSwitchesToDirect]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[StereoCopyPath.MonoProbesKeepTheIntermediate]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=StereoCopyPath.MonoProbesKeepTheIntermediate]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[StereoCopyPath.MonoProbesKeepTheIntermediate]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[StereoCopyPath.FailedDirectCopyKeepsTheIntermediate]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=StereoCopyPath.FailedDirectCopyKeepsTheIntermediate]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[StereoCopyPath.FailedDirectCopyKeepsTheIntermediate]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[StereoCopyPath.FailedClearSkipsTheDirectCopy]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=StereoCopyPath.FailedClearSkipsTheDirectCopy]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[StereoCopyPath.FailedClearSkipsTheDirectCopy]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[StereoCopyPath.FailedReadIsTriedAgain]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=StereoCopyPath.FailedReadIsTriedAgain]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[StereoCopyPath.FailedReadIsTriedAgain]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[StereoCopyPath.InconclusiveProbesRetryThenGiveUp]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=StereoCopyPath.InconclusiveProbesRetryThenGiveUp]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[StereoCopyPath.InconclusiveProbesRetryThenGiveUp]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[StereoCopyPath.LaterStereoFrameSwitchesToDirect]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=StereoCopyPath.LaterStereoFrameSwitchesToDirect]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[StereoCopyPath.LaterStereoFrameSwitchesToDirect]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[StereoCopyPath.NewSurfacesProbeAtOnce]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=StereoCopyPath.NewSurfacesProbeAtOnce]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[StereoCopyPath.NewSurfacesProbeAtOnce]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[StereoCopyPath.DecidedPathSurvivesNewSurfaces]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=StereoCopyPath.DecidedPathSurvivesNewSurfaces]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[StereoCopyPath.DecidedPathSurvivesNewSurfaces]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[StereoCopyPath.DirectThatStopsWorkingFallsBack]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=StereoCopyPath.DirectThatStopsWorkingFallsBack]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[StereoCopyPath.DirectThatStopsWorkingFallsBack]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[StereoCopyPath.FailedIntermediateCopyIsReported]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=StereoCopyPath.FailedIntermediateCopyIsReported]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[StereoCopyPath.FailedIntermediateCopyIsReported]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[StereoCopyPath.EveryCopyMode]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=StereoCopyPath.EveryCopyMode]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[StereoCopyPath.EveryCopyMode]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[StereoCopyPath.ProbesOnceBackToFull]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=StereoCopyPath.ProbesOnceBackToFull]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[StereoCopyPath.ProbesOnceBackToFull]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[StereoPack.KernelsMatchScalar]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=StereoPack.KernelsMatchScalar]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[StereoPack.KernelsMatchScalar]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[StereoPack.OverUnderPutsTheTopEyeOnTheLeft]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=StereoPack.OverUnderPutsTheTopEyeOnTheLeft]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[StereoPack.OverUnderPutsTheTopEyeOnTheLeft]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[SwapChainCache.FindsNothingWhenEmpty]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=SwapChainCache.FindsNothingWhenEmpty]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[SwapChainCache.FindsNothingWhenEmpty]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[SwapChainCache.FindsWhatWasInserted]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=SwapChainCache.FindsWhatWasInserted]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[SwapChainCache.FindsWhatWasInserted]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[SwapChainCache.NeverTakesAReferenceOnTheSwapChain]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=SwapChainCache.NeverTakesAReferenceOnTheSwapChain]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[SwapChainCache.NeverTakesAReferenceOnTheSwapChain]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[SwapChainCache.RepeatedLookupsMakeNoRefCountCalls]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=SwapChainCache.RepeatedLookupsMakeNoRefCountCalls]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[SwapChainCache.RepeatedLookupsMakeNoRefCountCalls]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[SwapChainCache.InsertingAgainReplacesTheEntry]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=SwapChainCache.InsertingAgainReplacesTheEntry]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[SwapChainCache.InsertingAgainReplacesTheEntry]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[SwapChainCache.EvictsTheOldestWhenFull]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=SwapChainCache.EvictsTheOldestWhenFull]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[SwapChainCache.EvictsTheOldestWhenFull]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[SwapChainCache.InvalidateReleasesOnlyThatEntry]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=SwapChainCache.InvalidateReleasesOnlyThatEntry]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[SwapChainCache.InvalidateReleasesOnlyThatEntry]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[SwapChainCache.InvalidateOfAnUnknownSwapChainDoesNothing]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=SwapChainCache.InvalidateOfAnUnknownSwapChainDoesNothing]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[SwapChainCache.InvalidateOfAnUnknownSwapChainDoesNothing]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[SwapChainCache.InvalidatedAddressCanBeReused]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=SwapChainCache.InvalidatedAddressCanBeReused]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[SwapChainCache.InvalidatedAddressCanBeReused]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[SwapChainCache.ClearReleasesEverything]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=SwapChainCache.ClearReleasesEverything]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[SwapChainCache.ClearReleasesEverything]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[SwapChainCache.NullReferencesAreSkipped]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=SwapChainCache.NullReferencesAreSkipped]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[SwapChainCache.NullReferencesAreSkipped]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[TextureGenerator.PlasmaMatchesTheReference]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=TextureGenerator.PlasmaMatchesTheReference]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[TextureGenerator.PlasmaMatchesTheReference]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[TextureGenerator.PlasmaMatchesTheReferenceAtEverySize]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=TextureGenerator.PlasmaMatchesTheReferenceAtEverySize]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[TextureGenerator.PlasmaMatchesTheReferenceAtEverySize]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[TextureGenerator.PlasmaStaysInsideTheRow]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=TextureGenerator.PlasmaStaysInsideTheRow]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[TextureGenerator.PlasmaStaysInsideTheRow]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[TextureGenerator.BandsDoNotChangeTheImage]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=TextureGenerator.BandsDoNotChangeTheImage]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[TextureGenerator.BandsDoNotChangeTheImage]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[TextureGenerator.PlasmaFollowsSizeChanges]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=TextureGenerator.PlasmaFollowsSizeChanges]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[TextureGenerator.PlasmaFollowsSizeChanges]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[TextureGenerator.PlasmaIsGreyAndAnimated]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=TextureGenerator.PlasmaIsGreyAndAnimated]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[TextureGenerator.PlasmaIsGreyAndAnimated]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[VtableCache.SaveAndLoadRoundTrip]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=VtableCache.SaveAndLoadRoundTrip]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[VtableCache.SaveAndLoadRoundTrip]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[VtableCache.LoadsWindowsLineEndingsAndNoLastNewline]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=VtableCache.LoadsWindowsLineEndingsAndNoLastNewline]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[VtableCache.LoadsWindowsLineEndingsAndNoLastNewline]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[VtableCache.OtherVersionSkipsTheFile]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=VtableCache.OtherVersionSkipsTheFile]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[VtableCache.OtherVersionSkipsTheFile]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[VtableCache.BadLinesAreCountedAndSkipped]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=VtableCache.BadLinesAreCountedAndSkipped]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[VtableCache.BadLinesAreCountedAndSkipped]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[VtableCache.LoadingAgainStartsOver]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=VtableCache.LoadingAgainStartsOver]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[VtableCache.LoadingAgainStartsOver]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[VtableCache.OffsetPastTheImageIsRejected]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=VtableCache.OffsetPastTheImageIsRejected]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[VtableCache.OffsetPastTheImageIsRejected]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[VtableCache.StoreRejectsBadBuildsAndSlots]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=VtableCache.StoreRejectsBadBuildsAndSlots]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[VtableCache.StoreRejectsBadBuildsAndSlots]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[VtableCache.StoringTheSameIsNoChange]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=VtableCache.StoringTheSameIsNoChange]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[VtableCache.StoringTheSameIsNoChange]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[VtableCache.NewBuildEvictsTheOlderOne]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=VtableCache.NewBuildEvictsTheOlderOne]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[VtableCache.NewBuildEvictsTheOlderOne]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[VtableCache.LoadKeepsTheLastBuildInTheFile]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=VtableCache.LoadKeepsTheLastBuildInTheFile]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[VtableCache.LoadKeepsTheLastBuildInTheFile]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[VtableCache.FindNeedsTheExactBuild]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=VtableCache.FindNeedsTheExactBuild]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[VtableCache.FindNeedsTheExactBuild]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[VtableCache.StoreDropsTheOldestPastTheLimit]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=VtableCache.StoreDropsTheOldestPastTheLimit]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[VtableCache.StoreDropsTheOldestPastTheLimit]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[VtableCache.LoadStopsAtTheLimit]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=VtableCache.LoadStopsAtTheLimit]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[VtableCache.LoadStopsAtTheLimit]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[VtableCache.ReadsTheBuildFromPEHeaders]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=VtableCache.ReadsTheBuildFromPEHeaders]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[VtableCache.ReadsTheBuildFromPEHeaders]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[VtableCache.LongModuleNamesAreCut]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=VtableCache.LongModuleNamesAreCut]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[VtableCache.LongModuleNamesAreCut]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[VtableCache.RejectsWhatIsNotAPEImage]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=VtableCache.RejectsWhatIsNotAPEImage]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[VtableCache.RejectsWhatIsNotAPEImage]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[VtableCache.RejectsTruncatedHeaders]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=VtableCache.RejectsTruncatedHeaders]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[VtableCache.RejectsTruncatedHeaders]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[SurfaceReplay.ExpandsRunsInTimeOrder]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=SurfaceReplay.ExpandsRunsInTimeOrder]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[SurfaceReplay.ExpandsRunsInTimeOrder]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[SurfaceReplay.RejectsBadLines]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=SurfaceReplay.RejectsBadLines]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[SurfaceReplay.RejectsBadLines]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[SurfaceReplay.EachRebuildIsOneNewSetOfHandles]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=SurfaceReplay.EachRebuildIsOneNewSetOfHandles]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[SurfaceReplay.EachRebuildIsOneNewSetOfHandles]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[SurfaceReplay.FailedResizeStaysStaleUntilThePresentAfter]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=SurfaceReplay.FailedResizeStaysStaleUntilThePresentAfter]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[SurfaceReplay.FailedResizeStaysStaleUntilThePresentAfter]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[SurfaceReplay.SetupWaitsOutTheVRFrame]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=SurfaceReplay.SetupWaitsOutTheVRFrame]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[SurfaceReplay.SetupWaitsOutTheVRFrame]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[SurfaceReplay.RecreateWaitsForAPresentBetweenVRFrames]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=SurfaceReplay.RecreateWaitsForAPresentBetweenVRFrames]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[SurfaceReplay.RecreateWaitsForAPresentBetweenVRFrames]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+add_test([=[SurfaceReplay.ReplacedRingDrainsAfterTheVRSideMovesOn]=]  /root/repo/_werror_build/Tests/KatangaTests [==[--gtest_filter=SurfaceReplay.ReplacedRingDrainsAfterTheVRSideMovesOn]==] --gtest_also_run_disabled_tests)
+set_tests_properties([=[SurfaceReplay.ReplacedRingDrainsAfterTheVRSideMovesOn]=]  PROPERTIES WORKING_DIRECTORY /root/repo/_werror_build/Tests SKIP_REGULAR_EXPRESSION [==[\[  SKIPPED \]]==])
+set(  KatangaTests_TESTS AsyncLog.FormatsIntegers AsyncLog.HexIsMaskedToTheCallersSize AsyncLog.FormatsFloatsPointersAndChars AsyncLog.FormatsStringsAsMSVCDoes AsyncLog.MissingArgumentsDoNotCrash AsyncLog.CopiesBuffersThatTheCallerReuses AsyncLog.LongTextIsTruncated AsyncLog.FlushWritesEverythingQueued AsyncLog.ManyProducersLoseNothingUncounted CopyPlanTest.NewRequestAfterItSettles CopyPlanTest.SmallCropMovesAreNotAChange CopyPlanTest.WobbleSettlesAndJumpsStartOver CopyPlanTest.SteadyRequestForTheSameCopyIsKept FrameCapture.FramesReachTheSinkInOrder FrameCapture.IntervalSkipsFrames FrameCapture.FullRingDropsFramesAndReleasesAfterTheSink FrameCapture.PendingCopiesAreMappedInOrder FrameCapture.FailedMapFreesTheSlot FrameCapture.FailedCopyTakesNoIndex FrameCapture.FailedWriteStillReleasesTheSlot FrameCapture.FailedStagingDropsAndTriesAgain FrameCapture.NewSizeRecreatesTheStaging FrameCapture.NewSizeWaitsForTheSink FrameCapture.NewSizeUnmapsWhatTheSinkJustFinished FrameCapture.EmptySourceIsDropped FrameCapture.StopAndStartAnotherSink FrameCapture.LatestRequestWins CaptureSinkTest.RawPacksRowsOfEveryFrame CaptureSinkTest.RawRefusesANewSize CaptureSinkTest.RawFailsWhenItCantOpen CaptureSinkTest.PngHasTheFramePixels CaptureSinkTest.PngSwapsHalvesAndChannels CaptureSinkTest.PngFailsWhenItCantOpen CaptureSinkTest.MemoryRingHoldsTheLatestFrame PngCaptureSink.ChecksumsMatchKnownValues PngCaptureSinkLayout.SwappedHalvesAndNames MemoryRingCaptureSink.TornReadsAreRefused FramePacer.CopiesEveryFrameUntilTheVRSideSamples FramePacer.CountsOnlyCopiesThatHappened FramePacer.RateCapHoldsCopiesBack FramePacer.PendingCopyWaitsForTheNextSample PacingSimulation.NeverTears PacingSimulation.SlowGamesCopyEveryFrame PacingSimulation.FastGamesCopyLessWithoutGoingStale PacingSimulation.SameConfigSameReport HookSetTest.InstallsOnlyTheAskedForGroups HookSetTest.InstallingAgainOnlyAddsWhatIsMissing HookSetTest.FailedHooksAreCountedAndTriedAgain HookSetTest.NoAddressFailsWithoutHooking HookSetTest.InstallTimeIsKept HookSetTest.InstallAtAKnownAddress HookSetTest.InstallAtSkipsInstalledAndFailsWithoutAnAddress HookSetTest.CallsAreCountedFromAnyThread KatangaNotify.NotOpenDoesNothing KatangaNotify.SignalBeforeWaitIsNotLost KatangaNotify.SignalsCollapseIntoOneWakeup KatangaNotify.WaitTimesOut KatangaNotify.SignalWakesABlockedWait KatangaNotify.OnlyOneWaiterTakesASignal KatangaNotify.NamesAreSeparate KatangaNotify.SignalsAcrossProcesses KatangaNotify.GenerationWaitReturnsAtOnceIfAlreadyPast KatangaNotify.GenerationWaitTimesOutWithTheSeenOne KatangaNotify.GenerationGatedWake KatangaNotify.StopReleasesGenerationWaiters KatangaStats.SmallValuesGetTheirOwnBucket KatangaStats.BucketBoundaries KatangaStats.EveryValueIsWithinItsBucket KatangaStats.HugeValuesLandInTheLastBucket KatangaStats.RecordCountsSumsAndMax KatangaStats.NegativeTicksCountAsZero KatangaStats.PercentilesOfAKnownSet KatangaStats.PercentilesReadLowByLessThanABucket KatangaStats.EmptyHistogramIsZero KatangaStats.OverflowKeepsTheRealMax KatangaStats.RecordPresentSplitsTheFrame KatangaStats.InitValidatesThePage KatangaStats.InitResetsAnEarlierRun KatangaStats.PoolDecisionsAreCountedByResourceAndAction KatangaTrace.SpanAndInstantFormat KatangaTrace.InstantHasProcessScope KatangaTrace.NestedScopesNestInTime KatangaTrace.ThreadsGetTheirOwnIds KatangaTrace.NamesAreEscaped KatangaTrace.RingKeepsTheNewest KatangaTrace.EmptyTracerHasOnlyItsName KatangaTrace.TwoSidesMergeIntoOneFile KatangaTrace.AppendNeedsAFile KeyedMutexTest.TakesEachFreshFrame KeyedMutexTest.BusyKeyKeepsTheHeldSlot KeyedMutexTest.FrameReplacedBeforeTheTradeIsHandedBack KeyedMutexTest.NoSlotIsEverOwnedTwice ManagedShadow.RectBasics ManagedShadow.EmptyRectsAreNotDirty ManagedShadow.ContainedRectsAddNothing ManagedShadow.TouchingRectsMerge ManagedShadow.FullRegionMergesTheClosestPair ManagedShadow.FindsTexturesAndSurfaces ManagedShadow.SurfacesNeedAKnownLevel ManagedShadow.RemoveHandsBackTheShadow ManagedShadow.LevelsPastTheLimitAreDropped ManagedShadow.UnlockUploadsTheLockedRect ManagedShadow.RectsAreRoundedToBlocksAndClamped ManagedShadow.WholeLevelLock ManagedShadow.NestedLocksUploadAtTheLastUnlock ManagedShadow.LevelsAreSeparate ManagedShadow.UnknownTexturesAndLevelsAreIgnored ManagedShadow.FailedUploadsStayDirty ManagedShadow.RestoreUploadsEveryLevel ManagedShadow.RestoreOfALockedLevelWaitsForItsUnlock ManagedShadow.FailedRestoreIsTriedAgain PoolPolicy.NotManagedPassesThrough PoolPolicy.ManagedTargetsArePlainDefault PoolPolicy.ManagedBuffersBySize PoolPolicy.ManagedTexturesByKind PoolPolicy.ParsesEveryCondition PoolPolicy.ParsesTheShortestRules PoolPolicy.RejectsMalformedRules PoolPolicy.RuleMatchesOnlyInsideItsLimits PoolPolicy.LoadsOnlyTheGameAndAnySections PoolPolicy.GameRulesBeatAnyRulesBeatBuiltins PoolPolicy.AnySectionFirstInTheFileStillComesSecond PoolPolicy.SectionsCanRepeat PoolPolicy.MalformedLinesAreSkippedAndCounted PoolPolicy.UnclosedSectionSkipsItsRules PoolPolicy.OverlongLineIsAnError PoolPolicy.RulesPastTheLimitAreErrors PoolPolicy.ReloadingReplacesTheProfile PoolPolicy.CallsRuleSeesTheCallerCounts PoolPolicy.CallerCountsArePerResource PoolPolicy.FullCallerTableCountsNewCallersAsFirst SetupHandshake.NoTornDescriptorAcrossProcesses SetupHandshake.LockedOutSecondBeginKeepsFrameBusy SharedMemory.CreateIsZeroFilled SharedMemory.OpenBeforeCreateFails SharedMemory.BothViewsSeeTheSameDescriptor SharedMemory.DescriptorAcrossProcesses SharedSurfaceCacheTest.SameRingAgainIsAllHits SharedSurfaceCacheTest.NewRingReleasesTheOldOne SharedSurfaceCacheTest.RetainKeepsOnlyPublishedHandles SharedSurfaceCacheTest.ClearReleasesEverything StagingArena.ReusesOneBufferWithoutReallocating StagingArena.NewSizeFreesTheOldBuffer StagingArena.FailedAllocationIsTriedAgain StagingArena.ReleaseAndDestructorFreeEverything StereoCopyPath.ClassifiesTheReadbacks StereoCopyPath.EmptyReadbackIsInconclusive StereoCopyPath.StereoProbeSwitchesToDirect StereoCopyPath.MonoProbesKeepTheIntermediate StereoCopyPath.FailedDirectCopyKeepsTheIntermediate StereoCopyPath.FailedClearSkipsTheDirectCopy StereoCopyPath.FailedReadIsTriedAgain StereoCopyPath.InconclusiveProbesRetryThenGiveUp StereoCopyPath.LaterStereoFrameSwitchesToDirect StereoCopyPath.NewSurfacesProbeAtOnce StereoCopyPath.DecidedPathSurvivesNewSurfaces StereoCopyPath.DirectThatStopsWorkingFallsBack StereoCopyPath.FailedIntermediateCopyIsReported StereoCopyPath.EveryCopyMode StereoCopyPath.ProbesOnceBackToFull StereoPack.KernelsMatchScalar StereoPack.OverUnderPutsTheTopEyeOnTheLeft SwapChainCache.FindsNothingWhenEmpty SwapChainCache.FindsWhatWasInserted SwapChainCache.NeverTakesAReferenceOnTheSwapChain SwapChainCache.RepeatedLookupsMakeNoRefCountCalls SwapChainCache.InsertingAgainReplacesTheEntry SwapChainCache.EvictsTheOldestWhenFull SwapChainCache.InvalidateReleasesOnlyThatEntry SwapChainCache.InvalidateOfAnUnknownSwapChainDoesNothing SwapChainCache.InvalidatedAddressCanBeReused SwapChainCache.ClearReleasesEverything SwapChainCache.NullReferencesAreSkipped TextureGenerator.PlasmaMatchesTheReference TextureGenerator.PlasmaMatchesTheReferenceAtEverySize TextureGenerator.PlasmaStaysInsideTheRow TextureGenerator.BandsDoNotChangeTheImage TextureGenerator.PlasmaFollowsSizeChanges TextureGenerator.PlasmaIsGreyAndAnimated VtableCache.SaveAndLoadRoundTrip VtableCache.LoadsWindowsLineEndingsAndNoLastNewline VtableCache.OtherVersionSkipsTheFile VtableCache.BadLinesAreCountedAndSkipped VtableCache.LoadingAgainStartsOver VtableCache.OffsetPastTheImageIsRejected VtableCache.StoreRejectsBadBuildsAndSlots VtableCache.StoringTheSameIsNoChange VtableCache.NewBuildEvictsTheOlderOne VtableCache.LoadKeepsTheLastBuildInTheFile VtableCache.FindNeedsTheExactBuild VtableCache.StoreDropsTheOldestPastTheLimit VtableCache.LoadStopsAtTheLimit VtableCache.ReadsTheBuildFromPEHeaders VtableCache.LongModuleNamesAreCut VtableCache.RejectsWhatIsNotAPEImage VtableCache.RejectsTruncatedHeaders SurfaceReplay.ExpandsRunsInTimeOrder SurfaceReplay.RejectsBadLines SurfaceReplay.EachRebuildIsOneNewSetOfHandles SurfaceReplay.FailedResizeStaysStaleUntilThePresentAfter SurfaceReplay.SetupWaitsOutTheVRFrame SurfaceReplay.RecreateWaitsForAPresentBetweenVRFrames SurfaceReplay.ReplacedRingDrainsAfterTheVRSideMovesOn)
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/PacingSimulator.dir/PacingSimulator.cpp.o"
+  "CMakeFiles/PacingSimulator.dir/PacingSimulator.cpp.o.d"
+  "PacingSimulator"
+  "PacingSimulator.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/PacingSimulator.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/SurfaceReplay.dir/SurfaceReplay.cpp.o"
+  "CMakeFiles/SurfaceReplay.dir/SurfaceReplay.cpp.o.d"
+  "SurfaceReplay"
+  "SurfaceReplay.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/SurfaceReplay.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,10 @@
+# CMake generated Testfile for 
+# Source directory: /root/repo/Tools
+# Build directory: /root/repo/_werror_build/Tools
+# 
+# This file includes the relevant testing commands required for 
+# testing this directory and lists subdirectories to be tested as well.
+add_test(PacingSimulator "/root/repo/_werror_build/Tools/PacingSimulator" "90" "5" "10")
+set_tests_properties(PacingSimulator PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/Tools/CMakeLists.txt;8;add_test;/root/repo/Tools/CMakeLists.txt;0;")
+add_test(SurfaceReplay "/root/repo/_werror_build/Tools/SurfaceReplay" "/root/repo/Tools/Traces/WindowedDrag.trace" "500" "20")
+set_tests_properties(SurfaceReplay PROPERTIES  _BACKTRACE_TRIPLES "/root/repo/Tools/CMakeLists.txt;16;add_test;/root/repo/Tools/CMakeLists.txt;0;")